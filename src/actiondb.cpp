@@ -3,7 +3,9 @@
 #include <chainparams.h>
 #include <logging.h>
 #include <key_io.h>
+#include <undo.h>
 #include <algorithm>
+#include <set>
 
 CAction MakeBindAction(const CKeyID& from, const CKeyID& to)
 {
@@ -72,41 +74,76 @@ CAction UnserializeAction(const std::vector<unsigned char>& vch) {
     return std::move(CAction(CNilAction{}));
 }
 
-CAction DecodeAction(const CTransactionRef& tx, std::vector<unsigned char>& vchSig)
+/** 
+ * Find the action payload of tx by its structure only, an OP_RETURN push tagged as bind or unbind.
+ * This runs before any coin lookup, so plain transactions never touch the UTXO set.
+ */
+static bool FindActionPayload(const CTransaction& tx, Span<const unsigned char>& payload)
 {
-    do {
-        if (tx->IsCoinBase() || tx->IsNull() || tx->vout.size() != 2 
-            || (tx->vout[0].nValue != 0 && tx->vout[1].nValue != 0)) 
+    if (tx.IsCoinBase() || tx.IsNull() || tx.vout.size() != 2 
+        || (tx.vout[0].nValue != 0 && tx.vout[1].nValue != 0)) 
+        return false;
+
+    for (const auto& vout : tx.vout) {
+        if (vout.nValue != 0) continue;
+        const auto& script = vout.scriptPubKey;
+        if (script.empty() || script[0] != OP_RETURN) {
             continue;
+        }
+        // The payload stays in the script, only a found action copies it out.
+        CScriptBase::const_iterator pc = script.begin() + 1;
+        opcodetype opcodeRet;
+        script.GetOp(pc, opcodeRet, payload);
+        if (payload.size() < 65) continue;
+        // the tag is the serialized CAction::which(), 1 for bind and 2 for unbind.
+        return (payload[0] == 1 || payload[0] == 2) && payload[1] == 0 && payload[2] == 0 && payload[3] == 0;
+    }
+    return false;
+}
+
+static CAction DecodeAction(const CTransactionRef& tx, std::vector<unsigned char>& vchSig, const std::function<CAmount()>& valueIn)
+{
+    Span<const unsigned char> payload;
+    if (!FindActionPayload(*tx, payload))
+        return CAction(CNilAction{});
+
+    auto fee = valueIn() - tx->GetValueOut();
+    if (fee != Params().GetConsensus().nActionFee) {
+        LogPrint(BCLog::RELATION, "Action warning fees, fee=%u\n", fee);
+        return CAction(CNilAction{});
+    }
+    auto action = UnserializeAction(std::vector<unsigned char>(payload.begin(), payload.end()));
+    vchSig.clear();
+    vchSig.insert(vchSig.end(), payload.end() - 65, payload.end());
+    return action;
+}
 
+bool IsActionTx(const CTransaction& tx)
+{
+    Span<const unsigned char> payload;
+    return FindActionPayload(tx, payload);
+}
+
+CAction DecodeAction(const CTransactionRef& tx, std::vector<unsigned char>& vchSig)
+{
+    return DecodeAction(tx, vchSig, [&tx]() {
         CAmount nAmount{ 0 };
-        for (auto vin : tx->vin) {
-            auto coin = pcoinsTip->AccessCoin(vin.prevout);
-            nAmount += coin.out.nValue;
-        }
-        auto outValue = tx->GetValueOut();
-        if (nAmount - outValue != Params().GetConsensus().nActionFee) {
-            LogPrintf("Action warning fees, fee=%u\n", nAmount - outValue);
-            continue;
+        for (const auto& vin : tx->vin) {
+            nAmount += pcoinsTip->AccessCoin(vin.prevout).out.nValue;
         }
-        for (auto vout : tx->vout) {
-            if (vout.nValue != 0) continue;
-            auto script = vout.scriptPubKey;
-            CScriptBase::const_iterator pc = script.begin();
-            opcodetype opcodeRet;
-            std::vector<unsigned char> vchRet;
-            if (!script.GetOp(pc, opcodeRet, vchRet) || opcodeRet != OP_RETURN) {
-                continue;
-            }
-            script.GetOp(pc, opcodeRet, vchRet);
-            auto action = UnserializeAction(vchRet);
-            if (vchRet.size() < 65) continue;
-            vchSig.clear();
-            vchSig.insert(vchSig.end(), vchRet.end() - 65, vchRet.end());
-            return std::move(action);
+        return nAmount;
+    });
+}
+
+CAction DecodeAction(const CTransactionRef& tx, const CTxUndo& txundo, std::vector<unsigned char>& vchSig)
+{
+    return DecodeAction(tx, vchSig, [&txundo]() {
+        CAmount nAmount{ 0 };
+        for (const auto& coin : txundo.vprevout) {
+            nAmount += coin.out.nValue;
         }
-    } while (false);
-    return CAction(CNilAction{});
+        return nAmount;
+    });
 }
 
 
@@ -114,12 +151,61 @@ static const char DB_ACTIVE_ACTION_KEY = 'K';
 static const char DB_RELATIONID = 'P';
 
 CRelationView::CRelationView(size_t nCacheSize, bool fMemory, bool fWipe)
-    : CDBWrapper(GetDataDir() / "action" / "relation", nCacheSize, fMemory, fWipe) 
+    : CDBBufferedWrapper(GetDataDir() / "action" / "relation", nCacheSize, fMemory, fWipe) 
+{
+    {
+        LOCK(cs);
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(DB_RELATIONID, uint64_t(0)));
+        while (pcursor->Valid()) {
+            std::pair<char, uint64_t> key;
+            CKeyID keyID;
+            if (!pcursor->GetKey(key) || key.first != DB_RELATIONID)
+                break;
+            if (pcursor->GetValue(keyID))
+                plotIDKeyIDs[key.second] = keyID;
+            pcursor->Next();
+        }
+        LogPrint(BCLog::RELATION, "%s: loaded %u plot ids\n", __func__, plotIDKeyIDs.size());
+    }
+    PublishSnapshot(-1);
+}
+
+void CRelationView::AddPlotID(const CKeyID& keyID)
+{
+    const uint64_t plotID = keyID.GetPlotID();
+    if (plotIDKeyIDs.emplace(plotID, keyID).second)
+        Write(std::make_pair(DB_RELATIONID, plotID), keyID);
+}
+
+void CRelationView::PublishSnapshot(const int height)
+{
+    auto next = std::make_shared<CRelationSnapshot>();
+    next->nHeight = height;
+    LOCK(cs);
+    next->relations = relationKeyIDTip;
+    std::atomic_store(&snapshot, CRelationSnapshotRef(std::move(next)));
+}
+
+CKeyID CRelationSnapshot::To(const CKeyID& from) const
 {
+    auto it = relations.find(from);
+    return it != relations.end() ? it->second : CKeyID();
+}
+
+CRelationVector CRelationSnapshot::ListRelations() const
+{
+    CRelationVector vch;
+    vch.reserve(relations.size());
+    for (auto& iter : relations) {
+        vch.emplace_back(iter.first, iter.second);
+    }
+    return vch;
 }
 
 CKeyID CRelationView::To(const uint160& from, uint64_t plotid, bool poc21) const
 {
+    LOCK(cs);
     if (poc21){
         // If POC21 is actived.
         auto kv = relationKeyIDTip.find(CKeyID(from));
@@ -132,8 +218,10 @@ CKeyID CRelationView::To(const uint160& from, uint64_t plotid, bool poc21) const
     CKeyID value;
     auto key = relationTip.find(plotid);
     if(key!=relationTip.end()){
-        auto to_key = std::make_pair(DB_RELATIONID, key->second);
-        if(!Read(to_key, value)){
+        auto to = plotIDKeyIDs.find(key->second);
+        if(to!=plotIDKeyIDs.end()){
+            value = to->second;
+        }else{
             LogPrint(BCLog::RELATION, "CRelationView::To failure, can not get to plotid, from:%u\n", plotid);
         }
     }else{
@@ -143,50 +231,44 @@ CKeyID CRelationView::To(const uint160& from, uint64_t plotid, bool poc21) const
 }
 
 void CRelationView::addRelationHistory(const int height, const CKeyID& from, const CKeyID& to){
-    CPersonalRelationHistoryList personalRelationList;
-    auto iter = relationsHistoryMap.find(from);
-    if (iter != relationsHistoryMap.end()){
-        personalRelationList = relationsHistoryMap[from];
-    }
     // For one person, 
     // One height only to One action
-    personalRelationList[height] = to;
-    relationsHistoryMap[from] = personalRelationList;
+    relationsHistoryMap[from][height] = to;
 }
 
 bool CRelationView::AcceptAction(const int height, const uint256& txid, const CAction& action, std::vector<std::pair<uint256, CRelationActive>>& relations, bool poc21)
 {
-    CDBBatch batch(*this);
-    LogPrintf("AcceptAction, tx:%s\n", txid.GetHex());
+    LogPrint(BCLog::RELATION, "AcceptAction, tx:%s\n", txid.GetHex());
+    LOCK(cs);
     if (action.type() == typeid(CBindAction)) {
         auto ba = boost::get<CBindAction>(action);
         auto active = std::make_pair(txid, std::make_pair(ba.first, ba.second));
         relations.push_back(active);
         if (! poc21){
             // old poc2 need old relationMap to validate.
-            // write plotID and CKeyID into disk.
-            batch.Write(std::make_pair(DB_RELATIONID, ba.first.GetPlotID()), ba.first);
-            batch.Write(std::make_pair(DB_RELATIONID, ba.second.GetPlotID()), ba.second);
+            // keep plotID and CKeyID in memory, and write new ones into disk.
+            AddPlotID(ba.first);
+            AddPlotID(ba.second);
             // add new action at tip
             relationTip[ba.first.GetPlotID()] = ba.second.GetPlotID();
-            LogPrintf("bind action, from:%u, to:%u\n", ba.first.GetPlotID(), ba.second.GetPlotID());
+            LogPrint(BCLog::RELATION, "bind action, from:%u, to:%u\n", ba.first.GetPlotID(), ba.second.GetPlotID());
         }
         relationKeyIDTip[ba.first] = ba.second;
         // use a cache map--personalRelationsMap to record each person relations history
         addRelationHistory(height, ba.first, ba.second);
-        LogPrintf("POC2+ bind action, from address : %u, to address : %u\n", EncodeDestination(ba.first), EncodeDestination(ba.second));
+        LogPrint(BCLog::RELATION, "POC2+ bind action, from address : %u, to address : %u\n", EncodeDestination(ba.first), EncodeDestination(ba.second));
     } else if (action.type() == typeid(CUnbindAction)) {
         auto from = boost::get<CUnbindAction>(action);
         auto active = std::make_pair(txid,std::make_pair(from, CKeyID()));
         relations.push_back(active);
         if (! poc21){
-            LogPrintf("unbind action, from plotid:%u\n", from.GetPlotID());
+            LogPrint(BCLog::RELATION, "unbind action, from plotid:%u\n", from.GetPlotID());
             auto key = relationTip.find(from.GetPlotID());
             if(key!=relationTip.end()){
                 relationTip.erase(key);
             }
         }
-        LogPrintf("POC2+ unbind action, from address : %u\n", EncodeDestination(from));
+        LogPrint(BCLog::RELATION, "POC2+ unbind action, from address : %u\n", EncodeDestination(from));
         auto key = relationKeyIDTip.find(from);
         if(key!=relationKeyIDTip.end()){
             relationKeyIDTip.erase(key);
@@ -194,79 +276,112 @@ bool CRelationView::AcceptAction(const int height, const uint256& txid, const CA
         // use a cache map--personalRelationsMap to record each person relations history
         addRelationHistory(height, from, CKeyID());
     }
-    return WriteBatch(batch);
+    return true;
 }
 
-void CRelationView::ConnectBlock(const int height, const CBlock &blk, bool poc21){
+void CRelationView::ConnectBlock(const int height, const CBlock &blk, const CBlockUndo &blockundo, bool poc21, std::vector<std::pair<uint256, CRelationActive>>* accepted){
     std::vector<std::pair<uint256, CRelationActive>> relations;
-    //accept action
-    for (auto tx: blk.vtx) {
+    //accept action, the coinbase has no undo entry.
+    for (size_t i = 1; i < blk.vtx.size(); i++) {
+        const auto& tx = blk.vtx[i];
         std::vector<unsigned char> vchSig;
-        auto action = DecodeAction(tx, vchSig);
+        auto action = DecodeAction(tx, blockundo.vtxundo[i - 1], vchSig);
         if (action.type() != typeid(CNilAction)) {
-            LogPrintf("DecodeAction not nil action: %s\n", tx->GetHash().GetHex());
+            LogPrint(BCLog::RELATION, "DecodeAction not nil action: %s\n", tx->GetHash().GetHex());
             auto out = tx->vin[0].prevout;
             if (VerifyAction(out, action, vchSig)) {
                 if (!AcceptAction(height, tx->GetHash(), action, relations, poc21)) {
-                    LogPrintf("AcceptAction failure: %s\n", tx->GetHash().GetHex());
+                    LogPrint(BCLog::RELATION, "AcceptAction failure: %s\n", tx->GetHash().GetHex());
                 }
             }
             else {
-                LogPrintf("VerifyAction failure: %s\n", tx->GetHash().GetHex());
+                LogPrint(BCLog::RELATION, "VerifyAction failure: %s\n", tx->GetHash().GetHex());
             }
         }
     }
 
+    if (accepted)
+        *accepted = relations;
     if (relations.size() > 0) {
-        if (!WriteRelationsToDisk(height, relations)) {
-            LogPrint(BCLog::RELATION, "%s: WriteRelationToDisk retrun false, height:%d\n", __func__, height);
-        }
+        WriteRelationsToDisk(height, relations);
+    } else {
+        // A record left above the flushed tip by an unclean shutdown must not outlive this block.
+        Erase(std::make_pair(DB_ACTIVE_ACTION_KEY, height));
+    }
+
+    // Each time a firestone slot opens, the history from before the previous slot is compacted.
+    const int slotLength = Params().SlotLength();
+    if (height % slotLength == 0) {
+        CompactHistory(height - 2 * slotLength);
     }
 }
 
-bool CRelationView::WriteRelationsToDisk(const int height, const std::vector<std::pair<uint256, CRelationActive>>& relations)
+void CRelationView::CompactHistory(const int height)
 {
-    return Write(std::make_pair(DB_ACTIVE_ACTION_KEY, height), relations);
+    if (height <= 0)
+        return;
+    const int poc21Height = Params().GetConsensus().LVIP05Height;
+    std::map<int, std::set<CKeyID>> dropped;
+    LOCK(cs);
+    for (auto& history : relationsHistoryMap) {
+        auto& personalRelationList = history.second;
+        auto last = personalRelationList.upper_bound(height);
+        if (last == personalRelationList.begin())
+            continue;
+        --last;
+        // The plot id tip is only updated below poc2+, its last relation there is kept too.
+        auto lastBeforePoc21 = personalRelationList.lower_bound(poc21Height);
+        if (lastBeforePoc21 != personalRelationList.begin())
+            --lastBeforePoc21;
+        for (auto it = personalRelationList.begin(); it != last;) {
+            if (it == lastBeforePoc21 && it->first < poc21Height) {
+                ++it;
+                continue;
+            }
+            dropped[it->first].insert(history.first);
+            it = personalRelationList.erase(it);
+        }
+    }
+
+    // The records keep what a restart replays, the same latest relations.
+    for (auto& drop : dropped) {
+        auto key = std::make_pair(DB_ACTIVE_ACTION_KEY, drop.first);
+        std::vector<std::pair<uint256, CRelationActive>> relations;
+        if (!Read(key, relations)) {
+            LogPrint(BCLog::RELATION, "%s: Read retrun false, height:%d\n", __func__, drop.first);
+            continue;
+        }
+        relations.erase(std::remove_if(relations.begin(), relations.end(), [&drop](const std::pair<uint256, CRelationActive>& relation) {
+            return drop.second.count(relation.second.first) > 0;
+        }), relations.end());
+        if (relations.empty()) {
+            Erase(key);
+        } else {
+            Write(key, relations);
+        }
+    }
+    LogPrint(BCLog::RELATION, "%s: compacted relation history up to height:%d, records:%u\n", __func__, height, dropped.size());
 }
 
-bool sort_first_decline(const CPersonalHeightRelation & m1, const CPersonalHeightRelation & m2) {
-    // decline sort for the height
-    return m1.first > m2.first;
+void CRelationView::WriteRelationsToDisk(const int height, const std::vector<std::pair<uint256, CRelationActive>>& relations)
+{
+    Write(std::make_pair(DB_ACTIVE_ACTION_KEY, height), relations);
 }
 
 bool CRelationView::removeRelationHistory(const int height, const CKeyID& from, bool poc21){
     // remove relationsHistoryMap entry for prev relation
-    CPersonalRelationHistoryList& personalRelationList = relationsHistoryMap[from];
-    for (auto iter = personalRelationList.begin(); iter != personalRelationList.end(); ){
-        if (iter->first >= height){
-            iter = personalRelationList.erase(iter);
-        }else{
-            ++iter;
-        }
-    }
-
-    if (personalRelationList.size() == 0){
-        // the last relation has been removed,
-        // so after clearing the RelationTip, we finish the work.
-        relationsHistoryMap.erase(from);
-        // clear the relation
-        if(!poc21){
-            relationTip.erase(from.GetPlotID());
+    auto history = relationsHistoryMap.find(from);
+    if (history != relationsHistoryMap.end()){
+        auto& personalRelationList = history->second;
+        personalRelationList.erase(personalRelationList.lower_bound(height), personalRelationList.end());
+        if (personalRelationList.empty()){
+            relationsHistoryMap.erase(history);
+            history = relationsHistoryMap.end();
         }
-        relationKeyIDTip.erase(from);
-        return true;
     }
 
-    // Now, we deal with the relationTip.
-    // sort and find the first prev relation
-    CPersonalHeightRelationVec vec;
-    copy(personalRelationList.begin(), personalRelationList.end(), std::back_inserter<CPersonalHeightRelationVec>(vec));
-    sort(vec.begin(), vec.end(), sort_first_decline); 
-    auto is_first_prev = [height](const CPersonalHeightRelation& personHeightRelation)->bool{
-        return (height > personHeightRelation.first);
-    };
-    auto prevRelationIter = find_if(vec.begin(), vec.end(), is_first_prev);
-    if (prevRelationIter == vec.end()){
+    // The history is ordered by height, so the prev relation is its last entry.
+    if (history == relationsHistoryMap.end() || history->second.rbegin()->second == CKeyID()){
         // clear the relation
         if(!poc21){
             relationTip.erase(from.GetPlotID());
@@ -274,27 +389,30 @@ bool CRelationView::removeRelationHistory(const int height, const CKeyID& from,
         relationKeyIDTip.erase(from);
     }else{
         // update the tip
+        auto& prev = history->second.rbegin()->second;
         if(!poc21){
-            relationTip[from.GetPlotID()] = prevRelationIter->second.GetPlotID();
+            relationTip[from.GetPlotID()] = prev.GetPlotID();
         }
-        relationKeyIDTip[from] = prevRelationIter->second;
+        relationKeyIDTip[from] = prev;
     }
     return true;
 }
 
 void CRelationView::DisconnectBlock(const int height, const CBlock &blk, bool poc21)
 {
-    // erase disk
     LogPrint(BCLog::RELATION, "%s: height:%d, block:%s\n", __func__, height, blk.GetHash().ToString());
+    // The record of this height lists every key it changed, only those are rolled back.
     auto key = std::make_pair(DB_ACTIVE_ACTION_KEY, height);
-    Erase(key, true);
+    std::vector<std::pair<uint256, CRelationActive>> relations;
+    if (Exists(key) && !Read(key, relations)) {
+        LogPrint(BCLog::RELATION, "%s: Read retrun false, height:%d\n", __func__, height);
+    }
+    // erase disk
+    Erase(key);
 
-    for(auto historyEntry : relationsHistoryMap){
-        auto iter = historyEntry.second.find(height);
-        if (iter != historyEntry.second.end()){
-            CKeyID from = historyEntry.first;
-            removeRelationHistory(height, from, poc21);
-        }
+    LOCK(cs);
+    for (auto& relation : relations) {
+        removeRelationHistory(height, relation.second.first, poc21);
     }
 }
 
@@ -307,27 +425,30 @@ bool CRelationView::LoadRelationFromDisk(const int height, bool poc21)
             LogPrint(BCLog::RELATION, "%s: Read retrun false, height:%d\n", __func__, height);
             return false;
         }
+        LOCK(cs);
         for (auto relation : relations) {
             if (relation.second.second != CKeyID()) {
                 auto from = relation.second.first;
                 auto to   = relation.second.second;
                 if (! poc21){
                     relationTip[from.GetPlotID()] = to.GetPlotID();
-                    LogPrintf("bind action, from:%u, to:%u\n", from.GetPlotID(), to.GetPlotID());
+                    AddPlotID(from);
+                    AddPlotID(to);
+                    LogPrint(BCLog::RELATION, "bind action, from:%u, to:%u\n", from.GetPlotID(), to.GetPlotID());
                 }
                 relationKeyIDTip[from] = to;
                 addRelationHistory(height, from, to);
-                LogPrintf("POC2+ bind action, from : %u, to : %u\n", EncodeDestination(from), EncodeDestination(to));
+                LogPrint(BCLog::RELATION, "POC2+ bind action, from : %u, to : %u\n", EncodeDestination(from), EncodeDestination(to));
             } else if (relation.second.second == CKeyID()) {
                 auto from = relation.second.first;
                 if (! poc21){
-                    LogPrintf("unbind action, from:%u\n", from.GetPlotID());
+                    LogPrint(BCLog::RELATION, "unbind action, from:%u\n", from.GetPlotID());
                     auto key = relationTip.find(from.GetPlotID());
                     if(key!=relationTip.end()){
                         relationTip.erase(key);
                     }
                 }
-                LogPrintf("POC2+ unbind action, from : %u\n", EncodeDestination(from));
+                LogPrint(BCLog::RELATION, "POC2+ unbind action, from : %u\n", EncodeDestination(from));
                 auto key = relationKeyIDTip.find(from);
                 if(key!=relationKeyIDTip.end()){
                     relationKeyIDTip.erase(key);
@@ -339,8 +460,27 @@ bool CRelationView::LoadRelationFromDisk(const int height, bool poc21)
     return true;
 }
 
+std::vector<int> CRelationView::ActionHeights(const int tipHeight)
+{
+    std::vector<int> heights;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_ACTIVE_ACTION_KEY, 0));
+    while (pcursor->Valid()) {
+        std::pair<char, int> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ACTIVE_ACTION_KEY)
+            break;
+        if (key.second <= tipHeight)
+            heights.push_back(key.second);
+        pcursor->Next();
+    }
+    // heights are serialized little endian, so the cursor does not visit them in order.
+    std::sort(heights.begin(), heights.end());
+    return heights;
+}
+
 CRelationVector CRelationView::ListRelations() const
 {
+    LOCK(cs);
     CRelationVector vch;
     vch.reserve(relationKeyIDTip.size());
     for (auto& iter : relationKeyIDTip) {
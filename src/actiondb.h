@@ -8,8 +8,13 @@
 #include <streams.h>
 #include <primitives/block.h>
 
+#include <memory>
+
 #include <boost/variant.hpp>
 
+class CTxUndo;
+class CBlockUndo;
+
 typedef std::pair<CKeyID, CKeyID> CBindAction;
 typedef CKeyID CUnbindAction;
 class CNilAction {
@@ -60,6 +65,16 @@ bool VerifyAction(const COutPoint& out, const CAction& action, std::vector<unsig
 
 CAction DecodeAction(const CTransactionRef& tx, std::vector<unsigned char>& vchSig);
 
+/** 
+ * Whether the transaction carries a bind or unbind action, its fee and signature unchecked.
+ */
+bool IsActionTx(const CTransaction& tx);
+
+/** 
+ * Decode the action of a transaction being connected, the fee is taken from its spent coins in txundo.
+ */
+CAction DecodeAction(const CTransactionRef& tx, const CTxUndo& txundo, std::vector<unsigned char>& vchSig);
+
 typedef std::pair<CKeyID, CKeyID> CRelation;
 typedef std::vector<CRelation> CRelationVector;
 typedef std::pair<int32_t, CKeyID> CPersonalHeightRelation;
@@ -68,12 +83,39 @@ typedef std::map<int32_t, CKeyID> CPersonalRelationHistoryList;
 typedef std::map<CKeyID, CPersonalRelationHistoryList> CRelationsHistoryMap;
 typedef std::map<uint64_t,uint64_t> RelationMap;
 typedef std::map<CKeyID,CKeyID> RelationKeyIDMap;
+typedef std::map<uint64_t,CKeyID> PlotIDKeyIDMap;
 typedef std::pair<CKeyID, CKeyID> CRelationActive;
 
 /** 
- * Abstract view on the relation dataset. 
+ * Abstract view on the relation dataset. Its writes are buffered until the chain state
+ * is flushed, see CDBBufferedWrapper.
  */
-class CRelationView : public CDBWrapper
+/** 
+ * An immutable copy of the poc2+ bindings of CRelationView, published once the chain moved so
+ * RPC and the GUI read them without cs_main. The bindings of classic poc2 plot ids are read
+ * from the database and are only found through the view.
+ */
+class CRelationSnapshot
+{
+public:
+    /** The height of the tip the snapshot was published at, -1 before the chain is loaded.*/
+    int Height() const { return nHeight; }
+
+    /** The target bound by from, or the null key id if from is not bound.*/
+    CKeyID To(const CKeyID& from) const;
+
+    CRelationVector ListRelations() const;
+
+private:
+    friend class CRelationView;
+
+    int nHeight = -1;
+    RelationKeyIDMap relations;
+};
+
+typedef std::shared_ptr<const CRelationSnapshot> CRelationSnapshotRef;
+
+class CRelationView : public CDBBufferedWrapper
 {
 public:
     explicit CRelationView(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
@@ -87,8 +129,8 @@ public:
      */
     CKeyID To(const uint160& from, uint64_t plotid, bool poc21) const;
 
-    void addRelationHistory(const int height, const CKeyID& from, const CKeyID& to);
-    bool removeRelationHistory(const int height, const CKeyID& from, bool poc21);
+    void addRelationHistory(const int height, const CKeyID& from, const CKeyID& to) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    bool removeRelationHistory(const int height, const CKeyID& from, bool poc21) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /** 
      * Push the relation(bind and unbind), which is at the height, into relation tip set.
@@ -105,15 +147,25 @@ public:
      * @param[in]    height  the block height, at which the connecttip function calls.
      * @param[in]    poc21   wether poc2+ is actived.
      * @param[out]   blk     the block.
+     * @param[in]    blockundo  the coins spent by the block, from which action fees are taken.
+     * @param[out]   accepted   the relations of the actions accepted, if not null.
      */
-    void ConnectBlock(const int height, const CBlock &blk, bool poc21);
+    void ConnectBlock(const int height, const CBlock &blk, const CBlockUndo &blockundo, bool poc21, std::vector<std::pair<uint256, CRelationActive>>* accepted = nullptr);
 
     void DisconnectBlock(const int height, const CBlock &blk, bool poc21);
+
+    /** 
+     * Compact the history up to height: per key only the latest relation at or below it is
+     * kept, and the latest one below poc2+, in memory and in the records of the heights, which
+     * bounds what a restart replays. Blocks at or below height cannot be disconnected after.
+     * @param[in]    height  the last height compacted, ConnectBlock keeps the two slots below the open one.
+     */
+    void CompactHistory(const int height);
     
     /** 
-     * Write the relation tip set on disk.
+     * Write the relation tip set of the height, it reaches the disk with the next Flush.
      */
-    bool WriteRelationsToDisk(const int height, const std::vector<std::pair<uint256, CRelationActive>> &relations);
+    void WriteRelationsToDisk(const int height, const std::vector<std::pair<uint256, CRelationActive>> &relations);
 
     /** 
      * Init the relation tip set.
@@ -123,19 +175,47 @@ public:
      */
     bool LoadRelationFromDisk(const int height, bool poc21);
 
+    /** 
+     * List the heights, at which relations are recorded on disk.
+     * @param[in]   tipHeight  the heights above tipHeight are skipped.
+     * @return      the heights in ascending order.
+     */
+    std::vector<int> ActionHeights(const int tipHeight);
+
     /** 
     * An api call by wallet,
     * This api will show all the relation from the cache.
     * @return  all the relation set.
     */
     CRelationVector ListRelations() const;
+
+    /** Replace the snapshot with a copy of the poc2+ bindings at the tip height, called with cs_main held once the chain moved.*/
+    void PublishSnapshot(const int height);
+
+    /** The snapshot published last, read without cs_main.*/
+    CRelationSnapshotRef GetSnapshot() const { return std::atomic_load(&snapshot); }
 private:
+    /** Record the key id of a plot id bound below poc2+, on disk the first time it is seen.*/
+    void AddPlotID(const CKeyID& keyID) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Guards the relations in memory, so they are read without cs_main.*/
+    mutable CCriticalSection cs;
+
     /** Relation tip set which is push into relationMapIndex.*/
-    RelationMap relationTip;
+    RelationMap relationTip GUARDED_BY(cs);
     /** Relation KEYID tip set which is for POC21.*/
-    RelationKeyIDMap relationKeyIDTip;
+    RelationKeyIDMap relationKeyIDTip GUARDED_BY(cs);
+    /**
+     * The key ids of the plot ids bound below poc2+, all of the database records loaded at start,
+     * so To resolves the targets of relationTip without reading the database. A plot id is derived
+     * from its key id, the entries hold on any chain and are never removed.
+     */
+    PlotIDKeyIDMap plotIDKeyIDs GUARDED_BY(cs);
+
+    CRelationsHistoryMap relationsHistoryMap GUARDED_BY(cs);
 
-    CRelationsHistoryMap relationsHistoryMap;
+    /** Read and replaced with the atomic shared_ptr operations.*/
+    CRelationSnapshotRef snapshot;
 };
 
 #endif
@@ -9,11 +9,16 @@
 #include <chainparams.h>
 #include <clientversion.h>
 #include <hash.h>
+#include <logging.h>
 #include <random.h>
 #include <streams.h>
 #include <tinyformat.h>
 #include <util/system.h>
 
+#include <cstdio>
+
+static const uint64_t PEERS_JOURNAL_VERSION = 1;
+
 namespace {
 
 template <typename Stream, typename Data>
@@ -32,8 +37,12 @@ bool SerializeDB(Stream& stream, const Data& data)
     return true;
 }
 
-template <typename Data>
-bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data& data)
+/**
+ * Write the serialized header and data of ss, followed by their checksum, to a temporary file
+ * renamed over path. The data is serialized in memory first, so whatever lock it needs is
+ * released before the file is written.
+ */
+bool WriteFileDB(const std::string& prefix, const fs::path& path, const CDataStream& ss)
 {
     // Generate random temporary filename
     unsigned short randv = 0;
@@ -47,8 +56,12 @@ bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data
     if (fileout.IsNull())
         return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-    // Serialize
-    if (!SerializeDB(fileout, data)) return false;
+    try {
+        fileout.write(ss.data(), ss.size());
+        fileout << Hash(ss.begin(), ss.end());
+    } catch (const std::exception& e) {
+        return error("%s: I/O error - %s", __func__, e.what());
+    }
     if (!FileCommit(fileout.Get()))
         return error("%s: Failed to flush file %s", __func__, pathTmp.string());
     fileout.fclose();
@@ -60,6 +73,18 @@ bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data
     return true;
 }
 
+template <typename Data>
+bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data& data)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    try {
+        ss << Params().MessageStart() << data;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize error - %s", __func__, e.what());
+    }
+    return WriteFileDB(prefix, path, ss);
+}
+
 template <typename Stream, typename Data>
 bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
 {
@@ -122,6 +147,7 @@ bool CBanDB::Read(banmap_t& banSet)
 CAddrDB::CAddrDB()
 {
     pathAddr = GetDataDir() / "peers.dat";
+    pathJournal = GetDataDir() / "peers.journal";
 }
 
 bool CAddrDB::Write(const CAddrMan& addr)
@@ -129,6 +155,111 @@ bool CAddrDB::Write(const CAddrMan& addr)
     return SerializeFileDB("peers", pathAddr, addr);
 }
 
+bool CAddrDB::WriteSnapshot(CAddrMan& addr, std::vector<unsigned char>& records)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    try {
+        ss << Params().MessageStart();
+        records = addr.Snapshot(ss);
+    } catch (const std::exception& e) {
+        return error("%s: Serialize error - %s", __func__, e.what());
+    }
+    return WriteFileDB("peers", pathAddr, ss);
+}
+
+bool CAddrDB::AppendJournal(const std::vector<unsigned char>& records)
+{
+    if (records.empty())
+        return true;
+
+    // A file left empty by a crash is started over too.
+    const bool fNew = JournalSize() == 0;
+    CAutoFile file(fsbridge::fopen(pathJournal, fNew ? "wb" : "ab"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathJournal.string());
+    try {
+        if (fNew) {
+            file << PEERS_JOURNAL_VERSION;
+        }
+        file.write((const char*)records.data(), records.size());
+    } catch (const std::exception& e) {
+        return error("%s: I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(file.Get()))
+        return error("%s: Failed to flush file %s", __func__, pathJournal.string());
+    return true;
+}
+
+size_t CAddrDB::ReadJournal(CAddrMan& addr)
+{
+    CAutoFile file(fsbridge::fopen(pathJournal, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return 0;
+
+    size_t nRecords = 0;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != PEERS_JOURNAL_VERSION)
+            return 0;
+        while (true) {
+            uint8_t type;
+            file >> type;
+            if (type == CAddrMan::JOURNAL_ADD) {
+                CAddress address;
+                CNetAddr source;
+                int64_t nTimePenalty;
+                file >> address >> source >> nTimePenalty;
+                addr.Add(address, source, nTimePenalty);
+            } else if (type == CAddrMan::JOURNAL_GOOD) {
+                CService service;
+                bool test_before_evict;
+                int64_t nTime;
+                file >> service >> test_before_evict >> nTime;
+                addr.Good(service, test_before_evict, nTime);
+            } else if (type == CAddrMan::JOURNAL_ATTEMPT) {
+                CService service;
+                bool fCountFailure;
+                int64_t nTime;
+                file >> service >> fCountFailure >> nTime;
+                addr.Attempt(service, fCountFailure, nTime);
+            } else if (type == CAddrMan::JOURNAL_CONNECTED) {
+                CService service;
+                int64_t nTime;
+                file >> service >> nTime;
+                addr.Connected(service, nTime);
+            } else if (type == CAddrMan::JOURNAL_SERVICES) {
+                CService service;
+                uint64_t nServices;
+                file >> service >> nServices;
+                addr.SetServices(service, ServiceFlags(nServices));
+            } else {
+                throw std::ios_base::failure("unknown record type");
+            }
+            nRecords++;
+        }
+    } catch (const std::exception& e) {
+        // The end of the file, or a record a crash cut short.
+        if (!std::feof(file.Get())) {
+            LogPrintf("%s: Stopped reading %s: %s\n", __func__, pathJournal.string(), e.what());
+        }
+    }
+    return nRecords;
+}
+
+uint64_t CAddrDB::JournalSize() const
+{
+    boost::system::error_code ec;
+    const uint64_t size = fs::file_size(pathJournal, ec);
+    return ec ? 0 : size;
+}
+
+void CAddrDB::ResetJournal()
+{
+    boost::system::error_code ec;
+    fs::remove(pathJournal, ec);
+}
+
 bool CAddrDB::Read(CAddrMan& addr)
 {
     return DeserializeFileDB(pathAddr, addr);
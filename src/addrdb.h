@@ -11,6 +11,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 class CSubNet;
 class CAddrMan;
@@ -81,16 +82,34 @@ public:
 
 typedef std::map<CSubNet, CBanEntry> banmap_t;
 
-/** Access to the (IP) address database (peers.dat) */
+/**
+ * Access to the (IP) address database (peers.dat), and to the journal of the changes made to
+ * the address manager since peers.dat was written (peers.journal).
+ */
 class CAddrDB
 {
 private:
     fs::path pathAddr;
+    fs::path pathJournal;
 public:
     CAddrDB();
     bool Write(const CAddrMan& addr);
+    /**
+     * Write a snapshot of addr, and hand back in records the changes it recorded for the
+     * journal before the snapshot was taken. The lock of addr is only held while the snapshot
+     * is serialized in memory, not while it is written.
+     */
+    bool WriteSnapshot(CAddrMan& addr, std::vector<unsigned char>& records);
     bool Read(CAddrMan& addr);
     static bool Read(CAddrMan& addr, CDataStream& ssPeers);
+
+    /** Append records taken from CAddrMan::TakeJournal to the journal. */
+    bool AppendJournal(const std::vector<unsigned char>& records);
+    /** Replay the journal onto addr, read from peers.dat, up to a record a crash cut short, and return the records replayed. */
+    size_t ReadJournal(CAddrMan& addr);
+    uint64_t JournalSize() const;
+    /** Remove the journal, once peers.dat holds its changes. */
+    void ResetJournal();
 };
 
 /** Access to the banlist database (banlist.dat) */
@@ -6,9 +6,11 @@
 #ifndef BITCOIN_ADDRMAN_H
 #define BITCOIN_ADDRMAN_H
 
+#include <clientversion.h>
 #include <netaddress.h>
 #include <protocol.h>
 #include <random.h>
+#include <streams.h>
 #include <sync.h>
 #include <timedata.h>
 #include <util/system.h>
@@ -206,6 +208,12 @@ private:
     //! last time Good was called (memory only)
     int64_t nLastGood GUARDED_BY(cs);
 
+    //! Whether the changes are recorded in m_journal
+    bool m_journal_enabled GUARDED_BY(cs) = false;
+
+    //! The changes made since the last snapshot, serialized for the journal of peers.dat
+    std::vector<unsigned char> m_journal GUARDED_BY(cs);
+
     //! Holds addrs inserted into tried table that collide with existing entries. Test-before-evict discipline used to resolve these collisions.
     std::set<int> m_tried_collisions;
 
@@ -264,10 +272,28 @@ protected:
     //! Mark an entry as currently-connected-to.
     void Connected_(const CService &addr, int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Record a change in the journal, if it is enabled.
+    template <typename... Args>
+    void Journal(uint8_t type, const Args&... args) EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        if (m_journal_enabled) {
+            CVectorWriter(SER_DISK, CLIENT_VERSION, m_journal, m_journal.size(), type, args...);
+        }
+    }
+
     //! Update an entry's service bits.
     void SetServices_(const CService &addr, ServiceFlags nServices) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
+    //! The changes recorded in the journal of peers.dat, replayed by CAddrDB::ReadJournal.
+    enum JournalRecord : uint8_t {
+        JOURNAL_ADD = 1,       //!< followed by the address, its source and the time penalty
+        JOURNAL_GOOD = 2,      //!< followed by the service, test_before_evict and the time
+        JOURNAL_ATTEMPT = 3,   //!< followed by the service, fCountFailure and the time
+        JOURNAL_CONNECTED = 4, //!< followed by the service and the time
+        JOURNAL_SERVICES = 5,  //!< followed by the service and its service bits
+    };
+
     /**
      * serialized format:
      * * version byte (currently 1)
@@ -475,6 +501,37 @@ public:
         nLastGood = 1; //Initially at 1 so that "never" is strictly worse.
         mapInfo.clear();
         mapAddr.clear();
+        m_journal.clear();
+    }
+
+    //! Start recording the changes, for the journal of peers.dat.
+    void EnableJournal()
+    {
+        LOCK(cs);
+        m_journal_enabled = true;
+    }
+
+    //! Take the changes recorded since the last snapshot or call.
+    std::vector<unsigned char> TakeJournal()
+    {
+        LOCK(cs);
+        std::vector<unsigned char> records;
+        records.swap(m_journal);
+        return records;
+    }
+
+    /**
+     * Serialize the address manager into s, and return the changes recorded before, which the
+     * snapshot now holds. Only the serialization into memory holds the lock.
+     */
+    template<typename Stream>
+    std::vector<unsigned char> Snapshot(Stream& s)
+    {
+        LOCK(cs);
+        Serialize(s);
+        std::vector<unsigned char> records;
+        records.swap(m_journal);
+        return records;
     }
 
     CAddrMan()
@@ -514,6 +571,7 @@ public:
         bool fRet = false;
         Check();
         fRet |= Add_(addr, source, nTimePenalty);
+        Journal(JOURNAL_ADD, addr, source, nTimePenalty);
         Check();
         if (fRet) {
             LogPrint(BCLog::ADDRMAN, "Added %s from %s: %i tried, %i new\n", addr.ToStringIPPort(), source.ToString(), nTried, nNew);
@@ -527,8 +585,10 @@ public:
         LOCK(cs);
         int nAdd = 0;
         Check();
-        for (std::vector<CAddress>::const_iterator it = vAddr.begin(); it != vAddr.end(); it++)
+        for (std::vector<CAddress>::const_iterator it = vAddr.begin(); it != vAddr.end(); it++) {
             nAdd += Add_(*it, source, nTimePenalty) ? 1 : 0;
+            Journal(JOURNAL_ADD, *it, source, nTimePenalty);
+        }
         Check();
         if (nAdd) {
             LogPrint(BCLog::ADDRMAN, "Added %i addresses from %s: %i tried, %i new\n", nAdd, source.ToString(), nTried, nNew);
@@ -542,6 +602,7 @@ public:
         LOCK(cs);
         Check();
         Good_(addr, test_before_evict, nTime);
+        Journal(JOURNAL_GOOD, addr, test_before_evict, nTime);
         Check();
     }
 
@@ -551,6 +612,7 @@ public:
         LOCK(cs);
         Check();
         Attempt_(addr, fCountFailure, nTime);
+        Journal(JOURNAL_ATTEMPT, addr, fCountFailure, nTime);
         Check();
     }
 
@@ -610,6 +672,7 @@ public:
         LOCK(cs);
         Check();
         Connected_(addr, nTime);
+        Journal(JOURNAL_CONNECTED, addr, nTime);
         Check();
     }
 
@@ -618,6 +681,7 @@ public:
         LOCK(cs);
         Check();
         SetServices_(addr, nServices);
+        Journal(JOURNAL_SERVICES, addr, (uint64_t)nServices);
         Check();
     }
 
@@ -1,180 +1,584 @@
 #include <assember.h>
 #include <chainparams.h>
+#include <consensus/validation.h>
+#include <forgetrace.h>
 #include <logging.h>
+#include <metrics.h>
 #include <miner.h>
 #include <poc.h>
+#include <scheduler.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <key_io.h>
 #include <actiondb.h>
 #include <timedata.h>
+#include <txmempool.h>
 #include <fspool.h>
+#include <hash.h>
+#include <net.h>
+#include <net_processing.h>
+#include <ui_interface.h>
+#include <util/system.h>
+#include <warnings.h>
 #include <wallet/rpcwallet.h>
 
+#include <algorithm>
+#include <limits>
+
 #include <boost/bind.hpp>
 
-CPOCBlockAssember::CPOCBlockAssember()
+/** Milliseconds between reassemblies of the warm block, submissions and mempool changes in between are coalesced. */
+static const int64_t TEMPLATE_REFRESH_INTERVAL = 500;
+
+CPOCBlockAssember::CPOCBlockAssember() : scheduler(nullptr), fUncheckedFailed(false)
 {
     SetNull();
 }
 
-bool CPOCBlockAssember::UpdateDeadline(const int height, const CKeyID& keyid, const uint64_t nonce, const uint64_t deadline, const CKey& key)
+bool CPOCBlockAssember::IsCandidate(const CBlockIndex* prevIndex, const int height, const uint64_t deadline)
 {
-    auto prevIndex = chainActive.Tip();
     if (prevIndex->nHeight != (height - 1)) {
-        LogPrintf("chainActive has been update, the new index is %uul, but the height to be produced is %uul\n", prevIndex->nHeight, height);
+        LogPrint(BCLog::FORGE, "chainActive has been update, the new index is %uul, but the height to be produced is %uul\n", prevIndex->nHeight, height);
         return false;
     }
     auto params = Params();
     if (deadline / prevIndex->nBaseTarget > params.TargetDeadline()) {
-        LogPrintf("Invalid deadline %ull\n", deadline);
+        LogPrint(BCLog::FORGE, "Invalid deadline %ull\n", deadline);
         return false;
     }
 
-    if (this->deadline != 0 && deadline >= this->deadline) {
-        LogPrintf("Invalid deadline %ull\n", deadline);
+    auto current = std::atomic_load(&best);
+    if (!current || current->height != height || deadline < current->deadline)
+        return true;
+
+    // Too late to win, but it may be kept as a runner-up.
+    LOCK(cs_candidates);
+    if (runnersUp.size() + 1 >= MAX_DEADLINE_CANDIDATES && runnersUp.back()->height == height && deadline >= runnersUp.back()->deadline) {
+        LogPrint(BCLog::FORGE, "Invalid deadline %ull\n", deadline);
         return false;
     }
+    return true;
+}
 
-    auto plotID = keyid.GetPlotID();
-    uint256 generationSignature;
-    if (height >= Params().GetConsensus().LVIP05Height){
-        generationSignature = CalcGenerationSignature(prevIndex->genSign, prevIndex->nPublicKeyID);
-        if (CalcDeadline(generationSignature, height, uint160(keyid), nonce) != deadline) {
-            LogPrintf("POC2.x Deadline inconformity %uul\n", deadline);
+void CPOCBlockAssember::KeepRunnerUp(const std::shared_ptr<const CPOCDeadline>& record)
+{
+    LOCK(cs_candidates);
+    if (!runnersUp.empty()) {
+        if (record->height < runnersUp.front()->height)
+            return;
+        if (record->height > runnersUp.front()->height)
+            runnersUp.clear();
+    }
+    auto it = std::upper_bound(runnersUp.begin(), runnersUp.end(), record, [](const std::shared_ptr<const CPOCDeadline>& a, const std::shared_ptr<const CPOCDeadline>& b) {
+        return a->deadline < b->deadline;
+    });
+    runnersUp.insert(it, record);
+    if (runnersUp.size() >= MAX_DEADLINE_CANDIDATES)
+        runnersUp.resize(MAX_DEADLINE_CANDIDATES - 1);
+}
+
+bool CPOCBlockAssember::PublishDeadline(const CBlockIndex* prevIndex, const int height, const CKeyID& keyid, const uint64_t nonce, const uint64_t deadline, const uint256& genSig)
+{
+    {
+        // The deadline was verified without cs_main, against a tip that may be gone by now.
+        LOCK(cs_main);
+        if (chainActive.Tip() != prevIndex) {
+            LogPrint(BCLog::FORGE, "Stale deadline %ull for height %d\n", deadline, height);
+            return false;
+        }
+    }
+    auto ts = DeadlineWait(deadline, prevIndex->nBaseTarget, Params().GetConsensus());
+    auto record = std::make_shared<CPOCDeadline>();
+    record->height = height;
+    record->keyid = keyid;
+    record->nonce = nonce;
+    record->deadline = deadline;
+    record->genSig = genSig;
+    GetForgingKey(keyid, record->key);
+    record->dl = prevIndex->GetBlockTime() + ts;
+    std::shared_ptr<const CPOCDeadline> replacement(std::move(record));
+
+    // Publish the record unless another submission for this height won meanwhile, or one for
+    // a later height was published by a faster caller.
+    auto current = std::atomic_load(&best);
+    do {
+        if (current && current->height > height) {
+            LogPrint(BCLog::FORGE, "Stale deadline %ull for height %d\n", deadline, height);
             return false;
         }
-    }else{
-        generationSignature = CalcGenerationSignaturePoc2(prevIndex->genSign, prevIndex->nPlotID);
-        if (CalcDeadlinePoc2(generationSignature, height, plotID, nonce) != deadline) {
-            LogPrintf("POC2 Deadline inconformity %uul\n", deadline);
+        if (current && current->height == height && deadline >= current->deadline) {
+            KeepRunnerUp(replacement);
+            LogPrint(BCLog::FORGE, "Runner-up deadline %ull\n", deadline);
             return false;
         }
-    }
-    auto ts = (deadline / prevIndex->nBaseTarget);
-    LogPrintf("Update new deadline: %u, now: %u, target: %u\n", ts, GetTimeMillis() / 1000, prevIndex->nTime + ts);
+    } while (!std::atomic_compare_exchange_weak(&best, &current, replacement));
+    if (current && current->height == height)
+        KeepRunnerUp(current);
+    ScheduleForge(replacement);
+    ScheduleTemplate(replacement);
+    GetMainSignals().NewBestDeadline(replacement);
+    g_forge_trace.DeadlineUpdated(height, ts, (replacement->dl - GetTimeOffset()) * 1000000);
+
+    LogPrint(BCLog::FORGE, "Update new deadline: %u, now: %u, target: %u\n", ts, GetTimeMillis() / 1000, prevIndex->nTime + ts);
+    return true;
+}
 
+bool CPOCBlockAssember::UpdateDeadline(const int height, const CKeyID& keyid, const uint64_t nonce, const uint64_t deadline)
+{
+    const CBlockIndex* prevIndex;
     {
-        boost::lock_guard<boost::mutex> lock(mtx);
-        this->height = height;
-        this->keyid = keyid;
-        this->genSig = genSig;
-        this->nonce = nonce;
-        this->deadline = deadline;
-        this->key = key;
-        auto lastBlockTime = prevIndex->GetBlockHeader().GetBlockTime();
-        auto ts = (deadline / chainActive.Tip()->nBaseTarget);
-        this->dl = lastBlockTime + ts;
+        LOCK(cs_main);
+        prevIndex = chainActive.Tip();
     }
-    return true;
+    // Drop submissions that cannot win before doing any Shabal work.
+    if (!IsCandidate(prevIndex, height, deadline))
+        return false;
+
+    auto params = Params();
+    auto plotID = keyid.GetPlotID();
+    auto info = GetPoCTipInfo(prevIndex, params.GetConsensus().LVIP05Height);
+    if (CalcDeadline(info, uint160(keyid), plotID, nonce) != deadline) {
+        LogPrint(BCLog::FORGE, "%s Deadline inconformity %uul\n", info.fPoc2 ? "POC2" : "POC2.x", deadline);
+        return false;
+    }
+
+    return PublishDeadline(prevIndex, height, keyid, nonce, deadline, info.genSig);
 }
 
-void CPOCBlockAssember::CreateNewBlock()
+/** The key the reward of a block forged by keyid goes to: the one it is bound to, or itself. */
+static CKeyID GetRewardTarget(const CKeyID& keyid) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    int height{ 0 };
-    CKeyID from;
-    uint256 genSig;
-    uint64_t deadline{ 0 };
-    uint64_t nonce{ 0 };
+    AssertLockHeld(cs_main);
+    auto to = prelationview->To(keyid, keyid.GetPlotID(), true);
+    return to.IsNull() ? keyid : to;
+}
+
+CTicketRef CPOCBlockAssember::SelectFirestone(const CPOCDeadline& record, const CKeyID& target, CKey& keyOut)
+{
+    AssertLockHeld(cs_main);
+    std::vector<CKey> keys;
     {
-        boost::lock_guard<boost::mutex> lock(mtx);
-        height = this->height;
-        from = this->keyid;
-        genSig = this->genSig;
-        nonce = this->nonce;
-        deadline = this->deadline;
-    }
-    
+        LOCK(cs_firestone);
+        auto it = firestoneKeys.find(target);
+        if (it != firestoneKeys.end())
+            keys.push_back(it->second);
+        if (record.key.IsValid())
+            keys.push_back(record.key);
+        for (const auto& entry : firestoneKeys) {
+            if (entry.first != target)
+                keys.push_back(entry.second);
+        }
+    }
+    if (keys.empty())
+        return nullptr;
+
+    const auto& tickets = pticketview->GetTicketsBySlotIndex((record.height / pticketview->SlotLength()) - 1);
+    for (const CKey& key : keys) {
+        const CKeyID keyid = key.GetPubKey().GetID();
+        for (const auto& ticket : tickets) {
+            if (keyid == ticket->KeyID() && !pcoinsTip->AccessCoin(ticket->out).IsSpent()) {
+                keyOut = key;
+                return ticket;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/** A firestone spending transaction of the fspool usable at height, or null. */
+static CTransactionRef GetReadyFstx(const int height)
+{
+    // The fspool learns of spent firestones from the validation callbacks, which may lag
+    // behind the tip, so the coin is checked again against the tip.
+    LOCK(cs_main);
+    for (auto& fstxRef : pfspool->GetReadyFstxBySlotIndex(height / pticketview->SlotLength())) {
+        auto index = (height / pticketview->SlotLength()) - 1;
+        if (!pcoinsTip->AccessCoin(fstxRef->vin[0].prevout).IsSpent() && pticketview->GetTicket(index, fstxRef->vin[0].prevout)) {
+            // fstx is derivatived by the regular firestone in the prev slot-index
+            return fstxRef;
+        }
+    }
+    return nullptr;
+}
+
+bool CPOCBlockAssember::HasFirestone(const CPOCDeadline& record)
+{
+    if (GetReadyFstx(record.height))
+        return true;
+    LOCK(cs_main);
+    CKey key;
+    return SelectFirestone(record, GetRewardTarget(record.keyid), key) != nullptr;
+}
+
+std::shared_ptr<CBlock> CPOCBlockAssember::AssembleBlock(const CPOCDeadline& record, bool& fFirestone, bool fTestValidity)
+{
+    const int height = record.height;
+    const CKeyID& from = record.keyid;
+    const uint64_t deadline = record.deadline;
+    const uint64_t nonce = record.nonce;
+
     auto params = Params();
     uint64_t plotid = from.GetPlotID();
     if (height >= Params().GetConsensus().LVIP05Height){
         plotid = 0;
     }
-    auto to = prelationview->To(from, from.GetPlotID(), true);
-    auto target = to.IsNull() ? from : to;
     auto fstx = MakeTransactionRef();
+    CKeyID target;
+    {
+        LOCK(cs_main);
+        target = GetRewardTarget(from);
+    }
 
     // get a fstx from fspool
-    auto usableIndex = (height / pticketview->SlotLength());
-    auto FstxRefSet = pfspool->GetFstxBySlotIndex(usableIndex);
-    for (auto fstxRef:FstxRefSet){
-        if (!pcoinsTip->AccessCoin(fstxRef->vin[0].prevout).IsSpent()){
-            auto index = (height / pticketview->SlotLength()) - 1;
-            for (auto ticket : pticketview->GetTicketsBySlotIndex(index)) {
-                if (fstxRef->vin[0].prevout.hash == ticket->out->hash){
-                    // fstx is derivatived by the regular firestone in the prev slot-index
-                    fstx = fstxRef;
-                    LogPrint(BCLog::FIRESTONE, "%s: get fstx:%s from fspool.\n", __func__,fstx->GetHash().ToString());
-                    goto CREATE_WITH_COLDFS;
-                } 
-            }
+    if (auto fstxRef = GetReadyFstx(height)) {
+        fstx = fstxRef;
+        LogPrint(BCLog::FIRESTONE, "%s: get fstx:%s from fspool.\n", __func__,fstx->GetHash().ToString());
+    } else {
+        // there is no fstx in fspool.
+        // or the fstx is un-regular, which suffered blockchain-rollback 
+        // so, we use the wallet to sign a fstx.
+        LOCK(cs_main);
+        CKey fskey;
+        if (auto fs = SelectFirestone(record, target, fskey)) { //find firestone
+            LogPrint(BCLog::FIRESTONE, "%s: generate new block with firestone:%s:%d\n", __func__, fs->out.hash.ToString(), fs->out.n);
+            fstx = makeSpentTicketTx(fs, height, CTxDestination(fskey.GetPubKey().GetID()), fskey);
         }
     }
+    fFirestone = !fstx->IsNull();
+
+    auto scriptPubKeyIn = GetScriptForDestination(CTxDestination(target));
+    try {
+        // A block assembled ahead of its deadline is timed at the deadline, the earliest time it is valid.
+        auto blk = BlockAssembler(params).CreateNewBlock(scriptPubKeyIn, nonce, from, plotid, deadline, fstx, record.dl, fTestValidity);
+        if (blk)
+            return std::make_shared<CBlock>(blk->block);
+    } catch (const std::runtime_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    return nullptr;
+}
+
+/** Submit the block forged for height, whose assembly started at nStart. */
+static void SubmitBlock(const std::shared_ptr<CBlock>& pblk, int height, int64_t nStart)
+{
+    uint32_t extraNonce = 0;
+    IncrementExtraNonce(pblk.get(), chainActive.Tip(), extraNonce);
+    const uint256 hash = pblk->GetHash();
+    const int64_t nProcessStart = GetTimeMicros();
+    g_forge_trace.BlockForged(height, hash, nProcessStart - nStart);
+    if (ProcessNewBlock(Params(), pblk, true, NULL) == false) {
+        LogPrintf("ProcessNewBlock failed\n");
+    }
+    g_forge_trace.BlockProcessed(hash, GetTimeMicros() - nProcessStart);
+}
+
+/** Whether validation marked the block invalid, rather than e.g. not taking it because the tip moved. */
+static bool IsBlockFailed(const uint256& hash)
+{
+    LOCK(cs_main);
+    const CBlockIndex* pindex = LookupBlockIndex(hash);
+    return pindex && (pindex->nStatus & BLOCK_FAILED_MASK);
+}
+
+void CPOCBlockAssember::CreateNewBlock()
+{
+    static CMetricHistogram& metric = GetMetrics().Histogram("forge_createblock", "Time to assemble and submit a forged block");
+    CMetricTimer timer(metric);
+    int64_t nStart = GetTimeMicros();
+    auto current = std::atomic_load(&best);
+    if (!current)
+        return;
 
+    // With -fastforge the mempool transactions, checked as they entered it, are trusted: the block
+    // is submitted and announced without being connected first, ProcessNewBlock checks it once.
+    const bool fCheck = !gArgs.GetBoolArg("-fastforge", DEFAULT_FASTFORGE) || fUncheckedFailed;
+    auto params = Params();
+    std::shared_ptr<CBlock> pblk;
+    bool fMempoolChanged = false;
+    bool fFirestone = false;
     {
-        // there is no fstx in fspool.
-        // or the fstx is un-regular, which suffered blockchain-rollback 
-        // so, we use the wallet to sign a fstx.
+        LOCK(cs_template);
+        if (warm.record == current && warm.block) {
+            pblk = warm.block;
+            fMempoolChanged = warm.nTransactionsUpdated != mempool.GetTransactionsUpdated();
+            fFirestone = warm.fFirestone;
+        }
+        warm = CPOCTemplate();
+    }
+
+    if (pblk) {
         LOCK(cs_main);
-        CTicketRef fs;
-        auto fskey = firestoneKey.IsValid() ? firestoneKey : key;
-        if (fskey.IsValid()) {
-            auto index = (height / pticketview->SlotLength()) - 1;
-            for (auto ticket : pticketview->GetTicketsBySlotIndex(index)) {
-                if (fskey.GetPubKey().GetID() == ticket->KeyID() && !pcoinsTip->AccessCoin(*(ticket->out)).IsSpent()) {
-                    fs = ticket;
-                    LogPrint(BCLog::FIRESTONE, "%s: generate new block with firestone:%s:%d\n", __func__, fs->out->hash.ToString(), fs->out->n);
-                    break;
-                }
+        const CBlockIndex* tip = chainActive.Tip();
+        if (pblk->hashPrevBlock != tip->GetBlockHash()) {
+            pblk.reset();
+        } else {
+            // The base target follows the block time.
+            if (UpdateTime(pblk.get(), params.GetConsensus(), tip) > 0)
+                AdjustBaseTarget(tip, pblk.get());
+            // Transactions may have left the mempool since the block was assembled, check it again.
+            CValidationState state;
+            if (fMempoolChanged && fCheck && !TestBlockValidity(state, params, *pblk, chainActive.Tip(), false, false)) {
+                LogPrintf("%s: warm block is stale: %s\n", __func__, FormatStateMessage(state));
+                pblk.reset();
             }
         }
+    }
+    if (!pblk) {
+        pblk = AssembleBlock(*current, fFirestone, fCheck);
+    }
+    if (!pblk) {
+        LogPrintf("CreateNewBlock failed\n");
+        return;
+    }
+    // Without a firestone the block earns half the subsidy, forge a runner-up that has one instead.
+    if (!fFirestone && FallBack(current))
+        return;
+    SubmitBlock(pblk, current->height, nStart);
 
-        if (fs && fskey.IsValid()) { //find firestone
-            fstx = makeSpentTicketTx(fs, height, CTxDestination(fskey.GetPubKey().GetID()), fskey);
+    if (!fCheck && IsBlockFailed(pblk->GetHash())) {
+        // Something let an invalid transaction into the mempool or the candidates, stop trusting them
+        // and forge the deadline again with a checked block.
+        fUncheckedFailed = true;
+        const std::string strWarning = strprintf(_("Warning: the forged block %s was invalid, -fastforge is disabled. See debug.log for details."), pblk->GetHash().ToString());
+        SetMiscWarning(strWarning);
+        LogPrintf("*** %s\n", strWarning);
+        uiInterface.ThreadSafeMessageBox(strWarning, "", CClientUIInterface::MSG_WARNING);
+        if (g_block_candidates)
+            g_block_candidates->Clear();
+        nStart = GetTimeMicros();
+        pblk = AssembleBlock(*current, fFirestone);
+        if (pblk) {
+            SubmitBlock(pblk, current->height, nStart);
+        } else {
+            LogPrintf("CreateNewBlock failed\n");
         }
     }
-   
-CREATE_WITH_COLDFS:
-    auto scriptPubKeyIn = GetScriptForDestination(CTxDestination(target));
-    auto blk = BlockAssembler(params).CreateNewBlock(scriptPubKeyIn, nonce, from, plotid, deadline, fstx);
-    if (blk) {
-        uint32_t extraNonce = 0;
-        IncrementExtraNonce(&blk->block, chainActive.Tip(), extraNonce);
-        auto pblk = std::make_shared<CBlock>(blk->block);
-        if (ProcessNewBlock(params, pblk, true, NULL) == false) {
-            LogPrintf("ProcessNewBlock failed\n");
+}
+
+uint256 CDeadlineAnnouncement::GetSignatureHash() const
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << hashPrevBlock << nHeight << keyid << nonce << deadline << firestone;
+    return ss.GetHash();
+}
+
+bool CDeadlineAnnouncement::Sign(const CKey& key)
+{
+    return key.SignCompact(GetSignatureHash(), vchSig);
+}
+
+bool CDeadlineAnnouncement::CheckSignature() const
+{
+    CPubKey pubkey;
+    return pubkey.RecoverCompact(GetSignatureHash(), vchSig) && pubkey.GetID() == keyid;
+}
+
+/** Announce the deadline of record, whose block was just assembled, to the peers. */
+static void AnnounceDeadline(const CPOCDeadline& record, const CBlock& block, bool fFirestone)
+{
+    if (!g_connman)
+        return;
+    CDeadlineAnnouncement ann;
+    ann.hashPrevBlock = block.hashPrevBlock;
+    ann.nHeight = record.height;
+    ann.keyid = record.keyid;
+    ann.nonce = record.nonce;
+    ann.deadline = record.deadline;
+    // The firestone spend follows the coinbase.
+    if (fFirestone && block.vtx.size() > 1)
+        ann.firestone = block.vtx[1]->vin[0].prevout;
+    if (!ann.Sign(record.key))
+        return;
+    LogPrint(BCLog::FORGE, "%s: announcing deadline %u of %s at height %d\n", __func__, record.deadline, EncodeDestination(CTxDestination(record.keyid)), record.height);
+    RelayDeadlineAnnouncement(ann, g_connman.get());
+}
+
+void CPOCBlockAssember::RefreshTemplate(const std::shared_ptr<const CPOCDeadline>& record)
+{
+    uint256 tipHash;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip()->nHeight + 1 != record->height)
+            return;
+        tipHash = chainActive.Tip()->GetBlockHash();
+    }
+    auto nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    bool fresh;
+    {
+        LOCK(cs_template);
+        fresh = warm.record == record && warm.block && warm.block->hashPrevBlock == tipHash
+            && warm.nTransactionsUpdated == nTransactionsUpdated;
+    }
+    if (!fresh) {
+        bool fFirestone;
+        auto pblk = AssembleBlock(*record, fFirestone);
+        bool fAnnounce = false;
+        {
+            LOCK(cs_template);
+            if (pblk && std::atomic_load(&best) == record) {
+                warm.record = record;
+                warm.block = pblk;
+                warm.nTransactionsUpdated = nTransactionsUpdated;
+                warm.fFirestone = fFirestone;
+                // Only deadlines whose plot key is registered can be signed.
+                fAnnounce = announced != record && record->key.IsValid();
+                if (fAnnounce)
+                    announced = record;
+            }
         }
-    } else {
-        LogPrintf("CreateNewBlock failed\n");
+        if (fAnnounce)
+            AnnounceDeadline(*record, *pblk, fFirestone);
+    }
+
+    // Keep following the mempool until shortly before the deadline.
+    if (GetAdjustedTime() * 1000 + TEMPLATE_REFRESH_INTERVAL < record->dl * 1000)
+        ScheduleTemplate(record);
+}
+
+bool CPOCBlockAssember::FallBack(const std::shared_ptr<const CPOCDeadline>& current)
+{
+    std::vector<std::shared_ptr<const CPOCDeadline>> candidates;
+    {
+        LOCK(cs_candidates);
+        candidates = runnersUp;
+    }
+    for (const auto& candidate : candidates) {
+        if (candidate->height != current->height || !HasFirestone(*candidate))
+            continue;
+        auto expected = current;
+        if (!std::atomic_compare_exchange_strong(&best, &expected, candidate))
+            return false;
+        {
+            LOCK(cs_candidates);
+            runnersUp.erase(std::remove(runnersUp.begin(), runnersUp.end(), candidate), runnersUp.end());
+        }
+        LogPrint(BCLog::FORGE, "%s: no firestone for deadline %u of %s, falling back to deadline %u of %s\n", __func__,
+            current->deadline, EncodeDestination(CTxDestination(current->keyid)), candidate->deadline, EncodeDestination(CTxDestination(candidate->keyid)));
+        ScheduleForge(candidate);
+        ScheduleTemplate(candidate);
+        GetMainSignals().NewBestDeadline(candidate);
+        return true;
     }
+    return false;
 }
 
 void CPOCBlockAssember::CheckDeadline()
 {
-    if (dl == 0)
+    auto current = std::atomic_load(&best);
+    if (!current)
         return;
-    if (GetAdjustedTime() >= dl) {
+    if (GetAdjustedTime() >= current->dl) {
+        g_forge_trace.ForgeFired(current->height);
         CreateNewBlock();
-        SetNull();
+        // Only forget the record we produced, not a better one submitted meanwhile.
+        std::atomic_compare_exchange_strong(&best, &current, std::shared_ptr<const CPOCDeadline>());
+    } else {
+        // Woken early, e.g. the network time offset moved.
+        ScheduleForge(current);
     }
 }
 
+void CPOCBlockAssember::SetScheduler(CScheduler* s)
+{
+    scheduler = s;
+    auto current = std::atomic_load(&best);
+    if (current) {
+        ScheduleForge(current);
+        ScheduleTemplate(current);
+    }
+}
+
+void CPOCBlockAssember::ScheduleForge(const std::shared_ptr<const CPOCDeadline>& record)
+{
+    if (!scheduler)
+        return;
+    // dl is network adjusted time, the scheduler runs on the system clock.
+    auto when = boost::chrono::system_clock::time_point(boost::chrono::seconds(record->dl - GetTimeOffset()));
+    // There is no unschedule, so a timer whose record was replaced or forged does nothing.
+    scheduler->schedule([this, record] {
+        if (std::atomic_load(&best) == record)
+            CheckDeadline();
+    }, when, SchedulerLane::TIMING);
+}
+
+void CPOCBlockAssember::ScheduleTemplate(const std::shared_ptr<const CPOCDeadline>& record)
+{
+    if (!scheduler)
+        return;
+    // Submissions and mempool changes within one interval share a single assembly.
+    scheduler->scheduleFromNow([this, record] {
+        if (std::atomic_load(&best) == record)
+            RefreshTemplate(record);
+    }, TEMPLATE_REFRESH_INTERVAL);
+}
+
+uint64_t CPOCBlockAssember::GetBestDeadline(const int height) const
+{
+    auto current = std::atomic_load(&best);
+    if (!current || current->height != height)
+        return std::numeric_limits<uint64_t>::max();
+    return current->deadline;
+}
+
 void CPOCBlockAssember::SetNull()
 {
-    height = 0;
-    nonce = 0;
-    deadline = 0;
-    genSig = uint256();
-    keyid.SetNull();
-    dl = 0;
+    std::atomic_store(&best, std::shared_ptr<const CPOCDeadline>());
+    {
+        LOCK(cs_candidates);
+        runnersUp.clear();
+    }
+    {
+        LOCK(cs_template);
+        warm = CPOCTemplate();
+    }
     //firestoneKey = CKey();
-    //key = CKey();
 }
 
 void CPOCBlockAssember::SetFirestoneAt(const CKey& key)
 {
     if (key.IsValid()) {
-        LogPrint(BCLog::FIRESTONE, "%s: set firestone source, keyid:%s\n", __func__, EncodeDestination(CTxDestination( key.GetPubKey().GetID())));
-        firestoneKey = key;
+        const CKeyID keyid = key.GetPubKey().GetID();
+        LogPrint(BCLog::FIRESTONE, "%s: set firestone source, keyid:%s\n", __func__, EncodeDestination(CTxDestination(keyid)));
+        LOCK(cs_firestone);
+        firestoneKeys[keyid] = key;
     } 
 }
+
+bool CPOCBlockAssember::RegisterForgingKey(const CKey& key)
+{
+    if (!key.IsValid())
+        return false;
+    const CKeyID keyid = key.GetPubKey().GetID();
+    LOCK(cs_forging);
+    if (!forgingKeys.emplace(keyid, key).second)
+        return false;
+    LogPrint(BCLog::FORGE, "%s: registered forging key, keyid:%s\n", __func__, EncodeDestination(CTxDestination(keyid)));
+    return true;
+}
+
+bool CPOCBlockAssember::UnregisterForgingKey(const CKeyID& keyid)
+{
+    LOCK(cs_forging);
+    return forgingKeys.erase(keyid) > 0;
+}
+
+bool CPOCBlockAssember::GetForgingKey(const CKeyID& keyid, CKey& keyOut) const
+{
+    LOCK(cs_forging);
+    auto it = forgingKeys.find(keyid);
+    if (it == forgingKeys.end())
+        return false;
+    keyOut = it->second;
+    return true;
+}
+
+std::vector<CKeyID> CPOCBlockAssember::GetForgingKeyIDs() const
+{
+    LOCK(cs_forging);
+    std::vector<CKeyID> keyids;
+    keyids.reserve(forgingKeys.size());
+    for (const auto& entry : forgingKeys)
+        keyids.push_back(entry.first);
+    return keyids;
+}
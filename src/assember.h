@@ -5,6 +5,83 @@
 #include <script/standard.h>
 #include <key.h>
 #include <chain.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <sync.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+class CScheduler;
+
+extern CCriticalSection cs_main;
+
+/** Default for -fastforge. */
+static const bool DEFAULT_FASTFORGE = false;
+/** Most deadlines kept for a height: the best one and the runners-up forged instead when it has no firestone. */
+static const size_t MAX_DEADLINE_CANDIDATES = 8;
+
+/** The best nonce submitted for one height. Published as a whole and never modified. */
+struct CPOCDeadline
+{
+    int       height;
+    CKeyID    keyid;
+    uint64_t  nonce;
+    uint64_t  deadline;
+    uint256   genSig;
+    CKey      key;
+    int64_t   dl;         //!< time at which the block may be produced
+};
+
+/**
+ * A best deadline announced to the peers once its block is assembled, ahead of the block, so
+ * they can verify its proof of capacity and read its firestone before it arrives. Signed with
+ * the key of the plot, so no one else can announce a deadline of the plot.
+ */
+struct CDeadlineAnnouncement
+{
+    uint256 hashPrevBlock;
+    int32_t nHeight;
+    CKeyID keyid;
+    uint64_t nonce;
+    uint64_t deadline;
+    COutPoint firestone;                //!< the firestone the block spends, null if none
+    std::vector<unsigned char> vchSig;  //!< compact signature of GetSignatureHash()
+
+    CDeadlineAnnouncement() : nHeight(0), nonce(0), deadline(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashPrevBlock);
+        READWRITE(nHeight);
+        READWRITE(keyid);
+        READWRITE(nonce);
+        READWRITE(deadline);
+        READWRITE(firestone);
+        READWRITE(vchSig);
+    }
+
+    /** The hash of every field but the signature. */
+    uint256 GetSignatureHash() const;
+
+    bool Sign(const CKey& key);
+
+    /** Whether the signature is made with the key of keyid. */
+    bool CheckSignature() const;
+};
+
+/** A block pre-assembled for one deadline record, only its time and merkle root are set when it is forged. */
+struct CPOCTemplate
+{
+    std::shared_ptr<const CPOCDeadline> record;
+    std::shared_ptr<CBlock> block;
+    unsigned int nTransactionsUpdated;  //!< mempool.GetTransactionsUpdated() when the block was assembled
+    bool fFirestone;                    //!< the block spends a firestone
+};
 
 class CPOCBlockAssember
 {
@@ -13,26 +90,98 @@ public:
 
     ~CPOCBlockAssember() = default;
 
-    bool UpdateDeadline(const int height, const CKeyID& keyid, const uint64_t nonce, const uint64_t deadline, const CKey& key);
+    bool UpdateDeadline(const int height, const CKeyID& keyid, const uint64_t nonce, const uint64_t deadline);
+
+    /** Cheap checks before any Shabal work: the height follows prevIndex, the
+     *  deadline is within the target and it beats the current best, or would
+     *  be kept as a runner-up. */
+    bool IsCandidate(const CBlockIndex* prevIndex, const int height, const uint64_t deadline);
+
+    /** Make an already verified deadline the best one unless it was beaten meanwhile,
+     *  in which case it may still be kept as a runner-up. Returns whether it became the best.
+     *  A deadline is dropped if prevIndex is no longer the tip or a later height was published.
+     *  The record gets the forging key registered for keyid, if any. */
+    bool PublishDeadline(const CBlockIndex* prevIndex, const int height, const CKeyID& keyid, const uint64_t nonce, const uint64_t deadline, const uint256& genSig);
+
+    /** The deadline of the best submission for height, from any source, or the largest deadline if there is none. */
+    uint64_t GetBestDeadline(const int height) const;
 
     void CreateNewBlock();
 
     void SetNull();
 
+    /** Add a key whose firestones are spent by the forged blocks, first by those whose reward goes to it. */
     void SetFirestoneAt(const CKey& sourceKey);
 
     void CheckDeadline();
 
+    /** Register the key of a plot address, so deadlines submitted for it can spend its firestones
+     *  without the wallet. Returns false if the key is invalid or was already registered. */
+    bool RegisterForgingKey(const CKey& key);
+
+    /** Drop the key registered for keyid. Returns whether there was one. */
+    bool UnregisterForgingKey(const CKeyID& keyid);
+
+    /** Copy the key registered for keyid into keyOut. */
+    bool GetForgingKey(const CKeyID& keyid, CKey& keyOut) const;
+
+    /** The plot addresses with a registered key. */
+    std::vector<CKeyID> GetForgingKeyIDs() const;
+
+    /** Forge blocks from timers on this scheduler, armed for the exact time of each new best deadline. */
+    void SetScheduler(CScheduler* scheduler);
+
 private:
-    uint256       genSig;
-    int           height;
-    CKeyID        keyid;
-    uint64_t      nonce;
-    uint64_t      deadline;
-    uint64_t      dl;
-    CKey          key;
-    CKey          firestoneKey;
-    boost::mutex  mtx;
+    /** Arm a timer for the time at which `record` may be forged. */
+    void ScheduleForge(const std::shared_ptr<const CPOCDeadline>& record);
+
+    /** Arm a timer to assemble or refresh the warm block of `record`, after the debounce interval. */
+    void ScheduleTemplate(const std::shared_ptr<const CPOCDeadline>& record);
+
+    /** Reassemble the warm block of `record` if it is missing, stale, or the mempool changed. */
+    void RefreshTemplate(const std::shared_ptr<const CPOCDeadline>& record);
+
+    /** Select the firestone and the mempool transactions for `record` on top of the current tip,
+     *  and connect the block to check it unless fTestValidity is false. fFirestone is set to
+     *  whether the block spends a firestone. */
+    std::shared_ptr<CBlock> AssembleBlock(const CPOCDeadline& record, bool& fFirestone, bool fTestValidity = true);
+
+    /** Find an unspent ticket of the previous slot for `record`, whose reward goes to target,
+     *  and the key to spend it with: first one of target, then one of the key of the record,
+     *  then of any other firestone key. */
+    CTicketRef SelectFirestone(const CPOCDeadline& record, const CKeyID& target, CKey& keyOut) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Whether a block forged for `record` would spend a firestone. */
+    bool HasFirestone(const CPOCDeadline& record);
+
+    /** Keep `record` among the runners-up of its height, dropping those of older heights and the worst. */
+    void KeepRunnerUp(const std::shared_ptr<const CPOCDeadline>& record);
+
+    /** Make the best runner-up that has a firestone the best deadline in place of `current`, which has none. */
+    bool FallBack(const std::shared_ptr<const CPOCDeadline>& current);
+
+    /** Current best submission, read and replaced with the atomic shared_ptr
+     *  operations so that pool submissions never wait on a mutex. */
+    std::shared_ptr<const CPOCDeadline> best;
+    CCriticalSection cs_candidates;
+    /** The deadlines of the height of best that did not win, by deadline. */
+    std::vector<std::shared_ptr<const CPOCDeadline>> runnersUp GUARDED_BY(cs_candidates);
+    CCriticalSection cs_firestone;
+    /** The keys set by SetFirestoneAt, by their key id. */
+    std::map<CKeyID, CKey> firestoneKeys GUARDED_BY(cs_firestone);
+    mutable CCriticalSection cs_forging;
+    /** The keys of the plot addresses, by their key id. The secret of a CKey lives in the
+     *  locked pool (support/lockedpool.h), so it is never swapped out. */
+    std::map<CKeyID, CKey> forgingKeys GUARDED_BY(cs_forging);
+    CScheduler*   scheduler;
+    /** Set once a block forged without being checked turned out invalid, -fastforge is ignored from then on. */
+    std::atomic<bool> fUncheckedFailed;
+
+    CCriticalSection cs_template;
+    /** The block kept warm for the best record, so forging does not wait for package selection. */
+    CPOCTemplate  warm GUARDED_BY(cs_template);
+    /** The last record announced to the peers. */
+    std::shared_ptr<const CPOCDeadline> announced GUARDED_BY(cs_template);
 };
 
 #endif // BITCOIN_ASSEMBER_H
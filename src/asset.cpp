@@ -3,117 +3,96 @@
 
 CAmountMap& operator+=(CAmountMap& a, const CAmountMap& b)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it)
+    for(CAmountMap::const_iterator it = b.begin(); it != b.end(); ++it)
         a[it->first] += it->second;
     return a;
 }
 
 CAmountMap& operator-=(CAmountMap& a, const CAmountMap& b)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it)
+    for(CAmountMap::const_iterator it = b.begin(); it != b.end(); ++it)
         a[it->first] -= it->second;
     return a;
 }
 
 CAmountMap operator+(const CAmountMap& a, const CAmountMap& b)
 {
-    CAmountMap c;
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it)
-        c[it->first] += it->second;
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it)
-        c[it->first] += it->second;
-    return c;
+    CAmountMap c = a;
+    return c += b;
 }
 
 CAmountMap operator-(const CAmountMap& a, const CAmountMap& b)
 {
-    CAmountMap c;
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it)
-        c[it->first] += it->second;
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it)
-        c[it->first] -= it->second;
-    return c;
+    CAmountMap c = a;
+    return c -= b;
 }
 
-bool operator<(const CAmountMap& a, const CAmountMap& b)
+/**
+ * Walk the assets of a and b in one pass over both sorted maps, calling
+ * f(a value, b value) for each of them, an asset missing from a map has value 0.
+ * @return false as soon as f returns false.
+ */
+template <typename F>
+static bool CompareAmounts(const CAmountMap& a, const CAmountMap& b, F f)
 {
-    bool smallerElement = false;
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it) {
-        CAmount aValue = a.count(it->first) ? a.find(it->first)->second : 0;
-        if (aValue > it->second)
-            return false;
-        if (aValue < it->second)
-            smallerElement = true;
-    }
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it) {
-        CAmount bValue = b.count(it->first) ? b.find(it->first)->second : 0;
-        if (it->second > bValue)
+    CAmountMap::const_iterator ita = a.begin();
+    CAmountMap::const_iterator itb = b.begin();
+    while (ita != a.end() || itb != b.end()) {
+        bool result;
+        if (itb == b.end() || (ita != a.end() && ita->first < itb->first)) {
+            result = f(ita->second, CAmount(0));
+            ++ita;
+        } else if (ita == a.end() || itb->first < ita->first) {
+            result = f(CAmount(0), itb->second);
+            ++itb;
+        } else {
+            result = f(ita->second, itb->second);
+            ++ita;
+            ++itb;
+        }
+        if (!result)
             return false;
-        if (it->second < bValue)
-            smallerElement = true;
     }
+    return true;
+}
+
+bool operator<(const CAmountMap& a, const CAmountMap& b)
+{
+    bool smallerElement = false;
+    if (!CompareAmounts(a, b, [&smallerElement](CAmount aValue, CAmount bValue) {
+            if (aValue < bValue)
+                smallerElement = true;
+            return aValue <= bValue;
+        }))
+        return false;
     return smallerElement;
 }
 
 bool operator<=(const CAmountMap& a, const CAmountMap& b)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it) {
-        CAmount aValue = a.count(it->first) ? a.find(it->first)->second : 0;
-        if (aValue > it->second)
-            return false;
-    }
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it) {
-        CAmount bValue = b.count(it->first) ? b.find(it->first)->second : 0;
-        if (it->second > bValue)
-            return false;
-    }
-    return true;
+    return CompareAmounts(a, b, [](CAmount aValue, CAmount bValue) { return aValue <= bValue; });
 }
 
 bool operator>(const CAmountMap& a, const CAmountMap& b)
 {
     bool largerElement = false;
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it) {
-        CAmount aValue = a.count(it->first) ? a.find(it->first)->second : 0;
-        if (aValue < it->second)
-            return false;
-        if (aValue > it->second)
-            largerElement = true;
-    }
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it) {
-        CAmount bValue = b.count(it->first) ? b.find(it->first)->second : 0;
-        if (it->second < bValue)
-            return false;
-        if (it->second > bValue)
-            largerElement = true;
-    }
+    if (!CompareAmounts(a, b, [&largerElement](CAmount aValue, CAmount bValue) {
+            if (aValue > bValue)
+                largerElement = true;
+            return aValue >= bValue;
+        }))
+        return false;
     return largerElement;
 }
 
 bool operator>=(const CAmountMap& a, const CAmountMap& b)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it) {
-        if ((a.count(it->first) ? a.find(it->first)->second : 0) < it->second)
-            return false;
-    }
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it) {
-        if (it->second < (b.count(it->first) ? b.find(it->first)->second : 0))
-            return false;
-    }
-    return true;
+    return CompareAmounts(a, b, [](CAmount aValue, CAmount bValue) { return aValue >= bValue; });
 }
 
 bool operator==(const CAmountMap& a, const CAmountMap& b)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = a.begin(); it != a.end(); ++it) {
-        if ((b.count(it->first) ? b.find(it->first)->second : 0) != it->second)
-            return false;
-    }
-    for(std::map<CAsset, CAmount>::const_iterator it = b.begin(); it != b.end(); ++it) {
-        if ((a.count(it->first) ? a.find(it->first)->second : 0) != it->second)
-            return false;
-    }
-    return true;
+    return CompareAmounts(a, b, [](CAmount aValue, CAmount bValue) { return aValue == bValue; });
 }
 
 bool operator!=(const CAmountMap& a, const CAmountMap& b)
@@ -131,7 +110,7 @@ bool operator!(const CAmountMap& a)
 
 bool hasNegativeValue(const CAmountMap& amount)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = amount.begin(); it != amount.end(); ++it) {
+    for(CAmountMap::const_iterator it = amount.begin(); it != amount.end(); ++it) {
         if (it->second < 0)
             return true;
     }
@@ -140,7 +119,7 @@ bool hasNegativeValue(const CAmountMap& amount)
 
 bool hasNonPostiveValue(const CAmountMap& amount)
 {
-    for(std::map<CAsset, CAmount>::const_iterator it = amount.begin(); it != amount.end(); ++it) {
+    for(CAmountMap::const_iterator it = amount.begin(); it != amount.end(); ++it) {
         if (it->second <= 0)
             return true;
     }
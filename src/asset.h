@@ -5,8 +5,13 @@
 #include <uint256.h>
 
 #include <amount.h>
+#include <prevector.h>
 #include <serialize.h>
 
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+
 /**
  *  Native Asset Issuance
  *
@@ -57,8 +62,106 @@ struct CAsset {
     }
 };
 
-/** Used for consensus fee and general wallet accounting*/
-typedef std::map<CAsset, CAmount> CAmountMap;
+/** An entry of a CAmountMap, named like the std::pair of a std::map. */
+struct CAssetAmount {
+    CAsset first;
+    CAmount second;
+
+    CAssetAmount() : second(0) { }
+    CAssetAmount(const CAsset& assetIn, const CAmount& amountIn) : first(assetIn), second(amountIn) { }
+};
+
+/** Assets a CAmountMap holds without heap allocation, real maps hold 1-3 assets. */
+static const unsigned int AMOUNT_MAP_INLINE_ASSETS = 3;
+
+/**
+ * Used for consensus fee and general wallet accounting.
+ *
+ * A map of assets to amounts with the interface of std::map, kept as a
+ * vector sorted by asset. The entries are stored inline up to
+ * AMOUNT_MAP_INLINE_ASSETS assets, so building and merging the maps of
+ * fees and balances does not allocate in the common case.
+ */
+class CAmountMap
+{
+    // The sizes are 64 bits so the inline entries are 8-byte aligned within the packed prevector.
+    typedef prevector<AMOUNT_MAP_INLINE_ASSETS, CAssetAmount, uint64_t, int64_t> vector_type;
+    alignas(CAmount) vector_type entries;
+
+public:
+    typedef CAsset key_type;
+    typedef CAmount mapped_type;
+    typedef CAssetAmount value_type;
+    typedef vector_type::size_type size_type;
+    typedef vector_type::iterator iterator;
+    typedef vector_type::const_iterator const_iterator;
+
+    CAmountMap() { }
+    CAmountMap(std::initializer_list<value_type> init)
+    {
+        for (const value_type& entry : init)
+            insert(entry);
+    }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_type size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+
+    iterator lower_bound(const CAsset& asset)
+    {
+        return std::lower_bound(entries.begin(), entries.end(), asset, [](const value_type& entry, const CAsset& a) { return entry.first < a; });
+    }
+    const_iterator lower_bound(const CAsset& asset) const
+    {
+        return std::lower_bound(entries.begin(), entries.end(), asset, [](const value_type& entry, const CAsset& a) { return entry.first < a; });
+    }
+
+    iterator find(const CAsset& asset)
+    {
+        iterator it = lower_bound(asset);
+        return (it != end() && it->first == asset) ? it : end();
+    }
+    const_iterator find(const CAsset& asset) const
+    {
+        const_iterator it = lower_bound(asset);
+        return (it != end() && it->first == asset) ? it : end();
+    }
+
+    size_type count(const CAsset& asset) const { return find(asset) != end() ? 1 : 0; }
+
+    /** Insert entry unless its asset is already in the map, like std::map::insert. */
+    std::pair<iterator, bool> insert(const value_type& entry)
+    {
+        iterator it = lower_bound(entry.first);
+        if (it != end() && it->first == entry.first)
+            return std::make_pair(it, false);
+        return std::make_pair(entries.insert(it, entry), true);
+    }
+
+    CAmount& operator[](const CAsset& asset)
+    {
+        return insert(value_type(asset, 0)).first->second;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        const vector_type& c = entries;
+        return entries.erase(entries.begin() + (pos - c.begin()));
+    }
+    size_type erase(const CAsset& asset)
+    {
+        iterator it = find(asset);
+        if (it == end())
+            return 0;
+        entries.erase(it);
+        return 1;
+    }
+};
 
 CAmountMap& operator+=(CAmountMap& a, const CAmountMap& b);
 CAmountMap& operator-=(CAmountMap& a, const CAmountMap& b);
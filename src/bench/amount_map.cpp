@@ -0,0 +1,52 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <asset.h>
+#include <random.h>
+
+// Sum the fees of a block template paid in a few assets, as the block
+// assembler and coin selection do with one small map per transaction.
+static void AmountMapAccumulate(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<CAsset> assets;
+    for (int i = 0; i < 3; i++) {
+        assets.emplace_back(rng.rand256());
+    }
+    std::vector<CAmountMap> fees(1000);
+    for (size_t i = 0; i < fees.size(); i++) {
+        fees[i][assets[0]] = 1000 + i;
+        if (i % 4 == 0)
+            fees[i][assets[1 + i % 2]] = 10;
+    }
+    while (state.KeepRunning()) {
+        CAmountMap total;
+        for (const CAmountMap& fee : fees) {
+            total += fee;
+        }
+        assert(total > CAmountMap());
+    }
+}
+
+static void AmountMapCompare(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CAmountMap target;
+    CAmountMap value;
+    for (int i = 0; i < 3; i++) {
+        CAsset asset(rng.rand256());
+        target[asset] = 100 * COIN;
+        value[asset] = 100 * COIN + i;
+    }
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            assert(value >= target && !(value < target) && value != target);
+        }
+    }
+}
+
+BENCHMARK(AmountMapAccumulate, 2000);
+BENCHMARK(AmountMapCompare, 2000);
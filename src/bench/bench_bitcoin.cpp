@@ -5,6 +5,8 @@
 #include <bench/bench.h>
 
 #include <crypto/sha256.h>
+#include <crypto/shabal256.h>
+#include <crypto/siphash.h>
 #include <key.h>
 #include <util/system.h>
 #include <util/strencodings.h>
@@ -63,6 +65,8 @@ int main(int argc, char** argv)
     const fs::path bench_datadir{SetDataDir()};
 
     SHA256AutoDetect();
+    Shabal256AutoDetect();
+    SipHashAutoDetect();
     ECC_Start();
     SetupEnvironment();
 
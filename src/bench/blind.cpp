@@ -0,0 +1,192 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <blind.h>
+#include <confidential_validation.h>
+#include <key.h>
+#include <random.h>
+#include <script/sigcache.h>
+
+/** A transaction spending two explicit coins of asset into nBlinded blinded outputs and a fee. */
+struct BlindingCase
+{
+    std::vector<CTxOut> inputs;
+    CMutableTransaction tx;
+    std::vector<CKey> keys;     //!< the blinding keys of the outputs
+
+    BlindingCase(const CAsset& asset, int nBlinded)
+    {
+        const CAmount nAmount = 1000 * nBlinded;
+        tx.vin.resize(2);
+        for (int i = 0; i < 2; i++) {
+            tx.vin[i].prevout = COutPoint(GetRandHash(), 0);
+            inputs.emplace_back(asset, nAmount, CScript() << OP_TRUE);
+        }
+        for (int i = 0; i < nBlinded; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            keys.push_back(key);
+            tx.vout.emplace_back(asset, 2 * nAmount / nBlinded - 10, CScript() << OP_TRUE);
+        }
+        tx.vout.emplace_back(asset, 10 * nBlinded, CScript());
+    }
+
+    /** Blind tx, or a copy of it, and return the number of blinded outputs. */
+    int Blind(CMutableTransaction& blinded) const
+    {
+        std::vector<uint256> input_blinds(inputs.size()), input_asset_blinds(inputs.size());
+        std::vector<CAsset> input_assets;
+        std::vector<CAmount> input_amounts;
+        for (const CTxOut& in : inputs) {
+            input_assets.push_back(in.nAsset.GetAsset());
+            input_amounts.push_back(in.nValueCA.GetAmount());
+        }
+        std::vector<uint256> output_blinds, output_asset_blinds;
+        std::vector<CPubKey> output_pubkeys;
+        for (const CKey& key : keys) {
+            output_pubkeys.push_back(key.GetPubKey());
+        }
+        output_pubkeys.push_back(CPubKey());
+        std::vector<CKey> vDummy;
+        return BlindTransaction(input_blinds, input_asset_blinds, input_assets, input_amounts, output_blinds, output_asset_blinds, output_pubkeys, vDummy, vDummy, blinded);
+    }
+};
+
+// Blind a transaction with 2 and 8 confidential outputs, proofs included.
+static void BlindTransactionN(benchmark::State& state, int nBlinded)
+{
+    const BlindingCase blinding(CAsset(GetRandHash()), nBlinded);
+    while (state.KeepRunning()) {
+        CMutableTransaction tx = blinding.tx;
+        int blinded = blinding.Blind(tx);
+        assert(blinded == nBlinded);
+    }
+}
+
+static void BlindTransaction2(benchmark::State& state) { BlindTransactionN(state, 2); }
+static void BlindTransaction8(benchmark::State& state) { BlindTransactionN(state, 8); }
+
+// Sign the range proof of one output, on a blinded asset.
+static void RangeproofGenerate(benchmark::State& state)
+{
+    const CAsset asset(GetRandHash());
+    uint256 value_blind = GetRandHash(), asset_blind = GetRandHash();
+    CConfidentialAsset conf_asset;
+    secp256k1_generator gen;
+    BlindAsset(conf_asset, gen, asset, asset_blind.begin());
+    CConfidentialValue conf_value;
+    secp256k1_pedersen_commitment value_commit;
+    CreateValueCommitment(conf_value, value_commit, value_blind.begin(), asset, asset_blind.begin(), 1234 * COIN);
+    std::vector<unsigned char*> value_blindptrs{value_blind.begin()};
+    std::vector<const unsigned char*> asset_blindptrs{asset_blind.begin()};
+    const CScript script = CScript() << OP_TRUE;
+    const uint256 nonce = GetRandHash();
+
+    while (state.KeepRunning()) {
+        ProofData rangeproof;
+        bool ok = GenerateRangeproof(rangeproof, value_blindptrs, nonce, 1234 * COIN, script, value_commit, gen, asset, asset_blindptrs);
+        assert(ok);
+    }
+}
+
+// Prove that a blinded output is of the asset of one of 3 inputs.
+static void SurjectionproofGenerate(benchmark::State& state)
+{
+    std::vector<secp256k1_fixed_asset_tag> targets(3);
+    std::vector<secp256k1_generator> target_generators(3);
+    std::vector<uint256> target_blinders(3);
+    std::vector<CAsset> assets;
+    for (int i = 0; i < 3; i++) {
+        assets.emplace_back(GetRandHash());
+        memcpy(&targets[i], assets[i].begin(), 32);
+        CConfidentialAsset conf_asset;
+        BlindAsset(conf_asset, target_generators[i], assets[i], target_blinders[i].begin());
+    }
+    uint256 asset_blind = GetRandHash();
+    std::vector<const unsigned char*> asset_blindptrs{asset_blind.begin()};
+    CConfidentialAsset conf_asset;
+    secp256k1_generator gen;
+    BlindAsset(conf_asset, gen, assets[1], asset_blind.begin());
+    const uint256 seed = GetRandHash();
+
+    while (state.KeepRunning()) {
+        ProofData proof;
+        bool ok = SurjectOutput(proof, targets, target_generators, target_blinders, asset_blindptrs, gen, assets[1], seed);
+        assert(ok);
+    }
+}
+
+// Rewind the range proof of an output paid to us, as the wallet does for every output it sees.
+static void UnblindOutput(benchmark::State& state)
+{
+    const BlindingCase blinding(CAsset(GetRandHash()), 2);
+    CMutableTransaction tx = blinding.tx;
+    blinding.Blind(tx);
+    const CTxOut& out = tx.vout[0];
+
+    while (state.KeepRunning()) {
+        CAmount amount;
+        uint256 blinder, asset_blinder;
+        CAsset asset;
+        bool ok = UnblindConfidentialPair(blinding.keys[0], out.nValueCA, out.nAsset, out.nNonce, out.scriptPubKey, out.vchRangeproof, amount, blinder, asset, asset_blinder);
+        assert(ok);
+    }
+}
+
+// Verify the amounts of a block of 50 transactions with 2 confidential outputs each.
+static void VerifyAmountsBlock(benchmark::State& state)
+{
+    const CAsset asset(GetRandHash());
+    std::vector<std::pair<std::vector<CTxOut>, CTransaction>> block;
+    for (int i = 0; i < 50; i++) {
+        const BlindingCase blinding(asset, 2);
+        CMutableTransaction tx = blinding.tx;
+        blinding.Blind(tx);
+        block.emplace_back(blinding.inputs, CTransaction(tx));
+    }
+
+    while (state.KeepRunning()) {
+        for (const auto& entry : block) {
+            bool ok = VerifyAmounts(entry.first, entry.second, nullptr, false);
+            assert(ok);
+        }
+    }
+}
+
+// Check a range proof found in, and missing from, the range proof cache.
+static void RangeProofCache(benchmark::State& state, bool fHit)
+{
+    static bool fInit = false;
+    if (!fInit) {
+        InitRangeproofCache();
+        fInit = true;
+    }
+    const BlindingCase blinding(CAsset(GetRandHash()), 2);
+    CMutableTransaction tx = blinding.tx;
+    blinding.Blind(tx);
+    const CTxOut& out = tx.vout[0];
+    if (fHit) {
+        bool ok = CRangeCheck(&out.nValueCA, out.vchRangeproof, out.nAsset.vchCommitment, out.scriptPubKey, true)();
+        assert(ok);
+    }
+
+    while (state.KeepRunning()) {
+        bool ok = CRangeCheck(&out.nValueCA, out.vchRangeproof, out.nAsset.vchCommitment, out.scriptPubKey, fHit)();
+        assert(ok);
+    }
+}
+
+static void RangeProofCacheHit(benchmark::State& state) { RangeProofCache(state, true); }
+static void RangeProofCacheMiss(benchmark::State& state) { RangeProofCache(state, false); }
+
+BENCHMARK(BlindTransaction2, 20);
+BENCHMARK(BlindTransaction8, 5);
+BENCHMARK(RangeproofGenerate, 50);
+BENCHMARK(SurjectionproofGenerate, 500);
+BENCHMARK(UnblindOutput, 100);
+BENCHMARK(VerifyAmountsBlock, 2);
+BENCHMARK(RangeProofCacheHit, 50 * 1000);
+BENCHMARK(RangeProofCacheMiss, 200);
@@ -17,6 +17,8 @@ static const size_t BATCHES = 101;
 static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const unsigned int QUEUE_BATCH_SIZE = 128;
+static const int HEAVY_JOB_RATIO = 16;
+static const unsigned int HEAVY_JOB_COST = 64;
 
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
@@ -60,3 +62,48 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+// This Benchmark tests the CheckQueue with checks of mixed cost, where one in
+// HEAVY_JOB_RATIO checks does HEAVY_JOB_COST times the work of the others, as
+// a signature cache miss among hits would, and says so through GetCost.
+static void CCheckQueueSpeedMixedCostJob(benchmark::State& state)
+{
+    struct MixedCostJob {
+        unsigned int nCost;
+        MixedCostJob() : nCost(1) {
+        }
+        explicit MixedCostJob(FastRandomContext& insecure_rand) : nCost(insecure_rand.randrange(HEAVY_JOB_RATIO) == 0 ? HEAVY_JOB_COST : 1) {
+        }
+        bool operator()()
+        {
+            uint64_t n = nCost;
+            for (unsigned int i = 0; i < nCost * 256; i++) {
+                n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+            }
+            return n != 0;
+        }
+        unsigned int GetCost() const { return nCost; }
+        void swap(MixedCostJob& x){std::swap(nCost, x.nCost);};
+    };
+    CCheckQueue<MixedCostJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        // Make insecure_rand here so that each iteration is identical.
+        FastRandomContext insecure_rand(true);
+        CCheckQueueControl<MixedCostJob> control(&queue);
+        std::vector<std::vector<MixedCostJob>> vBatches(BATCHES);
+        for (auto& vChecks : vBatches) {
+            vChecks.reserve(BATCH_SIZE);
+            for (size_t x = 0; x < BATCH_SIZE; ++x)
+                vChecks.emplace_back(insecure_rand);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+BENCHMARK(CCheckQueueSpeedMixedCostJob, 100);
@@ -60,6 +60,42 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+// Coin selection for a send of three assets besides the policy asset, which pays the fee.
+static void MultiAssetCoinSelection(benchmark::State& state)
+{
+    auto chain = interfaces::MakeChain();
+    const CWallet wallet(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+    std::vector<std::unique_ptr<CWalletTx>> wtxs;
+    LOCK(wallet.cs_wallet);
+
+    // Add 300 coins of each asset.
+    const std::vector<CAsset> assets = {::policyAsset, CAsset(uint256S("01")), CAsset(uint256S("02")), CAsset(uint256S("03"))};
+    std::vector<OutputGroup> groups;
+    for (const CAsset& asset : assets) {
+        for (int i = 1; i <= 300; ++i) {
+            addCoin(i * COIN, wallet, wtxs);
+            CInputCoin coin = COutput(wtxs.back().get(), 0 /* iIn */, 6 * 24 /* nDepthIn */, true /* spendable */, true /* solvable */, true /* safe */).GetInputCoin();
+            coin.asset = asset;
+            groups.emplace_back(coin, 6, false, 0, 0);
+        }
+    }
+
+    const CoinEligibilityFilter filter_standard(1, 6, 0);
+    const CoinSelectionParams coin_selection_params(true, 34, 148, CFeeRate(0), 0);
+    const CAmountMap mapTargetValue = { {assets[0], 10 * COIN}, {assets[1], 1003 * COIN}, {assets[2], 17 * COIN}, {assets[3], 451 * COIN} };
+    while (state.KeepRunning()) {
+        std::set<CInputCoin> setCoinsRet;
+        bool bnb_used;
+        CAmountMap mapValueRet;
+        bool success = wallet.SelectCoinsMinConf(mapTargetValue, filter_standard, groups, setCoinsRet, mapValueRet, coin_selection_params, bnb_used);
+        assert(success);
+        assert(bnb_used);
+        for (const auto& target : mapTargetValue) {
+            assert(mapValueRet[target.first] >= target.second);
+        }
+    }
+}
+
 typedef std::set<CInputCoin> CoinSet;
 static auto testChain = interfaces::MakeChain();
 static const CWallet testWallet(*testChain, WalletLocation(), WalletDatabase::CreateDummy());
@@ -108,4 +144,5 @@ static void BnBExhaustion(benchmark::State& state)
 }
 
 BENCHMARK(CoinSelection, 650);
+BENCHMARK(MultiAssetCoinSelection, 650);
 BENCHMARK(BnBExhaustion, 650);
@@ -78,6 +78,21 @@ static void SipHash_32b(benchmark::State& state)
     }
 }
 
+/* The mempool hashes its witness hashes for a compact block by batches of this size. */
+static void SipHash_32b_Multi256(benchmark::State& state)
+{
+    std::vector<uint256> vals(256);
+    std::vector<const uint256*> ptrs;
+    for (const uint256& val : vals) {
+        ptrs.push_back(&val);
+    }
+    std::vector<uint64_t> out(vals.size());
+    uint64_t k1 = 0;
+    while (state.KeepRunning()) {
+        SipHashUint256Multi(0, ++k1, ptrs.data(), out.data(), ptrs.size());
+    }
+}
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -101,6 +116,7 @@ BENCHMARK(SHA512, 330);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
+BENCHMARK(SipHash_32b_Multi256, 400 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,58 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <dbwrapper.h>
+#include <random.h>
+#include <uint256.h>
+
+// Look up coin-like records at random in a compacted table of 50000, with a block cache
+// much smaller than the table: every lookup decodes a block, so the options trade the bytes
+// read per lookup against the CPU spent on each block.
+static void DBWrapperRandomRead(benchmark::State& state, const DBOptions& options)
+{
+    FastRandomContext rng(true);
+    CDBWrapper db(fs::path("dbwrapper_bench"), 1 << 20, true, false, false, options);
+
+    std::vector<uint256> keys(50000);
+    CDBBatch batch(db);
+    for (auto& key : keys) {
+        key = rng.rand256();
+        // A commitment that does not compress, followed by a script template that does.
+        std::vector<unsigned char> value = rng.randbytes(33);
+        value.insert(value.end(), 25, 0x76);
+        batch.Write(std::make_pair('C', key), value);
+    }
+    db.WriteBatch(batch);
+    db.CompactRange('A', 'Z');
+
+    std::vector<unsigned char> value;
+    while (state.KeepRunning()) {
+        db.Read(std::make_pair('C', keys[rng.randrange(keys.size())]), value);
+    }
+}
+
+static void DBWrapperRandomRead4K(benchmark::State& state)
+{
+    DBWrapperRandomRead(state, DBOptions());
+}
+
+static void DBWrapperRandomRead16K(benchmark::State& state)
+{
+    DBOptions options;
+    options.block_size = 16 * 1024;
+    DBWrapperRandomRead(state, options);
+}
+
+static void DBWrapperRandomReadCompressed(benchmark::State& state)
+{
+    DBOptions options;
+    options.compression = true;
+    DBWrapperRandomRead(state, options);
+}
+
+BENCHMARK(DBWrapperRandomRead4K, 100000);
+BENCHMARK(DBWrapperRandomRead16K, 100000);
+BENCHMARK(DBWrapperRandomReadCompressed, 100000);
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 #include <blockfilter.h>
+#include <random.h>
 
 static void ConstructGCSFilter(benchmark::State& state)
 {
@@ -39,5 +40,41 @@ static void MatchGCSFilter(benchmark::State& state)
     }
 }
 
+/** n random scripts of the standard sizes: P2WPKH, P2SH, P2PKH and P2WSH. */
+static GCSFilter::ElementSet RandomScripts(FastRandomContext& rng, int n)
+{
+    static const int sizes[] = {22, 23, 25, 34};
+    GCSFilter::ElementSet elements;
+    while (elements.size() < static_cast<size_t>(n)) {
+        elements.insert(rng.randbytes(sizes[rng.randrange(4)]));
+    }
+    return elements;
+}
+
+// Decode and check a block filter received from a peer.
+static void DecodeGCSFilter(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    GCSFilter filter({0, 0, 19, 784931}, RandomScripts(rng, 10000));
+
+    while (state.KeepRunning()) {
+        GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    }
+}
+
+// Scan a block filter for the scripts of a wallet of 1000 keys, as a wallet rescan does.
+static void MatchAnyGCSFilter(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    GCSFilter filter({0, 0, 19, 784931}, RandomScripts(rng, 10000));
+    const GCSFilter::ElementSet wallet = RandomScripts(rng, 1000);
+
+    while (state.KeepRunning()) {
+        filter.MatchAny(wallet);
+    }
+}
+
 BENCHMARK(ConstructGCSFilter, 1000);
 BENCHMARK(MatchGCSFilter, 50 * 1000);
+BENCHMARK(DecodeGCSFilter, 5000);
+BENCHMARK(MatchAnyGCSFilter, 500);
@@ -0,0 +1,354 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Replay a range of recorded block files on top of a chainstate snapshot, to measure the
+ * sustained cost of connecting, and with -reorgevery of disconnecting, real Lava blocks.
+ *
+ * The snapshot is the data directory of a node stopped at some height. It is copied to a
+ * temporary directory first, so the same snapshot can be replayed again and again.
+ */
+
+#include <blockcache.h>
+#include <chainparams.h>
+#include <chainparamsbase.h>
+#include <consensus/validation.h>
+#include <crypto/sha256.h>
+#include <crypto/shabal256.h>
+#include <crypto/siphash.h>
+#include <key.h>
+#include <metrics.h>
+#include <random.h>
+#include <scheduler.h>
+#include <script/sigcache.h>
+#include <txdb.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <util/strencodings.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include <boost/thread.hpp>
+
+const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
+
+static const int64_t DEFAULT_REPLAY_REORG_DEPTH = 6;
+static const int64_t DEFAULT_REPLAY_DBCACHE = 1024;
+
+/** The phases reported, by the histograms validation records their time in. */
+static const struct {
+    const char* label;
+    const char* histogram;
+} REPLAY_PHASES[] = {
+    {"connect block", "connecttip"},
+    {"  sanity checks", "connectblock_checks"},
+    {"  coins", "connectblock_connect"},
+    {"    amounts", "connectblock_amounts"},
+    {"  scripts", "connectblock_scripts"},
+    {"  undo and index", "connectblock_index"},
+    {"  firestones and bindings", "connectblock_poc"},
+    {"  flush", "connecttip_flush"},
+    {"disconnect block", "disconnecttip"},
+    {"  firestones and bindings", "disconnectblock_poc"},
+};
+
+static void SetupReplayArgs()
+{
+    SetupHelpOptions(gArgs);
+    SetupChainParamsBaseOptions();
+
+    gArgs.AddArg("-snapshot=<dir>", "Data directory of a node stopped at the height to replay from (required)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blocks=<dir>", "Directory of the blk?????.dat files to replay (required)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-first=<n>", "Number of the first block file to replay (default: 0)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-last=<n>", "Number of the last block file to replay (default: the first)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-reorgevery=<n>", "Simulate a reorg every <n> blocks connected, 0 to disable (default: 0)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-reorgdepth=<n>", strprintf("Number of blocks a simulated reorg disconnects and connects again (default: %d)", DEFAULT_REPLAY_REORG_DEPTH), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbcache=<n>", strprintf("Database cache size in MiB (default: %d)", DEFAULT_REPLAY_DBCACHE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-par=<n>", strprintf("Number of script verification threads (0 = auto, default: %d)", DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-keepdatadir", "Do not delete the copy of the snapshot the blocks were replayed on", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-printtoconsole", "Print the node log to the console", false, OptionsCategory::OPTIONS);
+}
+
+static void CopyDirectory(const fs::path& from, const fs::path& to)
+{
+    fs::create_directories(to);
+    for (fs::directory_iterator it(from), end; it != end; ++it) {
+        const fs::path target = to / it->path().filename();
+        if (fs::is_directory(it->status())) {
+            CopyDirectory(it->path(), target);
+        } else if (it->path().filename() != ".lock") {
+            fs::copy_file(it->path(), target);
+        }
+    }
+}
+
+/** Open the chain state of the data directory, as the node does when it starts. */
+static bool LoadChainState(const CChainParams& chainparams, int64_t nTotalCache)
+{
+    const int64_t nBlockTreeDBCache = nTotalCache / 8;
+    const int64_t nLavaDBCache = nTotalCache / 16;
+    const int64_t nCoinDBCache = nTotalCache / 4;
+    nCoinCacheUsage = nTotalCache - nBlockTreeDBCache - nLavaDBCache - nCoinDBCache;
+
+    prelationview.reset(new CRelationView(nLavaDBCache * 3 / 8));
+    pticketview.reset(new CTicketView(nLavaDBCache * 3 / 8));
+    pissuanceview.reset(new CIssuanceView(nLavaDBCache / 8));
+    g_blockCache.reset(new CBlockCache());
+
+    LOCK(cs_main);
+    pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, false));
+    if (!LoadBlockIndex(chainparams) || !LoadGenesisBlock(chainparams))
+        return error("%s: cannot load the block index", __func__);
+    pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, false));
+    pcoinsprefetch.reset(new CCoinsViewPrefetch(pcoinsdbview.get(), COINS_PREFETCH_THREADS));
+    if (!ReplayBlocks(chainparams, pcoinsdbview.get()))
+        return error("%s: cannot replay the blocks of an interrupted flush", __func__);
+    pcoinsdbview->StartWriteBack();
+    pcoinsTip.reset(new CCoinsViewCache(pcoinsprefetch.get()));
+    if (pcoinsTip->GetBestBlock().IsNull() || !LoadChainTip(chainparams))
+        return error("%s: the snapshot has no chain state", __func__);
+    if (!LoadTicketView() || !LoadRelationView() || !LoadIssuanceView())
+        return error("%s: cannot load the firestone, relation or issuance database", __func__);
+    g_blockCache->UpdateBestBlockIndex(chainActive.Tip());
+    pticketview->PublishSnapshot();
+    prelationview->PublishSnapshot(chainActive.Height());
+    return true;
+}
+
+/** Disconnect the last nDepth blocks of the chain and connect them again. */
+static bool SimulateReorg(const CChainParams& chainparams, int nDepth)
+{
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        if (chainActive.Height() < nDepth)
+            return true;
+        pindex = chainActive[chainActive.Height() - nDepth + 1];
+    }
+    CValidationState state;
+    if (!InvalidateBlock(state, chainparams, pindex))
+        return error("%s: cannot disconnect %s: %s", __func__, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(pindex);
+    }
+    if (!ActivateBestChain(state, chainparams))
+        return error("%s: cannot connect %s again: %s", __func__, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+    return true;
+}
+
+/** The blocks of the files, in chain order: a block read before its parent waits for it. */
+class CReplay
+{
+public:
+    CReplay(const CChainParams& chainparamsIn, int nReorgEveryIn, int nReorgDepthIn) :
+        chainparams(chainparamsIn), nReorgEvery(nReorgEveryIn), nReorgDepth(nReorgDepthIn) {}
+
+    bool ProcessBlock(const std::shared_ptr<CBlock>& pblock)
+    {
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindex = LookupBlockIndex(pblock->GetHash());
+            if (pindex && chainActive.Contains(pindex))
+                return true;
+            if (!LookupBlockIndex(pblock->hashPrevBlock)) {
+                waiting.emplace(pblock->hashPrevBlock, pblock);
+                return true;
+            }
+        }
+        std::vector<std::shared_ptr<CBlock>> queue{pblock};
+        while (!queue.empty()) {
+            std::shared_ptr<CBlock> pnext = queue.back();
+            queue.pop_back();
+            if (!ProcessNewBlock(chainparams, pnext, true, nullptr)) {
+                std::cerr << "Block " << pnext->GetHash().ToString() << " is invalid, see the log" << std::endl;
+                return false;
+            }
+            nBlocks++;
+            nTransactions += pnext->vtx.size();
+            if (nReorgEvery > 0 && nBlocks % nReorgEvery == 0) {
+                if (!SimulateReorg(chainparams, nReorgDepth))
+                    return false;
+                nReorgs++;
+            }
+            auto range = waiting.equal_range(pnext->GetHash());
+            for (auto it = range.first; it != range.second; ++it) {
+                queue.push_back(it->second);
+            }
+            waiting.erase(range.first, range.second);
+        }
+        return true;
+    }
+
+    size_t Waiting() const { return waiting.size(); }
+
+    const CChainParams& chainparams;
+    const int nReorgEvery;
+    const int nReorgDepth;
+    uint64_t nBlocks = 0;
+    uint64_t nTransactions = 0;
+    uint64_t nReorgs = 0;
+
+private:
+    std::multimap<uint256, std::shared_ptr<CBlock>> waiting;
+};
+
+static std::map<std::string, CMetricHistogram::Summary> GetPhaseSummaries()
+{
+    std::map<std::string, CMetricHistogram::Summary> summaries;
+    for (const CMetricHistogram* histogram : GetMetrics().GetHistograms()) {
+        summaries.emplace(histogram->name, histogram->GetSummary());
+    }
+    return summaries;
+}
+
+static void PrintPhases(const std::map<std::string, CMetricHistogram::Summary>& before, const std::map<std::string, CMetricHistogram::Summary>& after)
+{
+    std::cout << strprintf("%-28s %8s %10s %10s %10s %10s\n", "phase", "count", "total (s)", "avg (ms)", "p99 (ms)", "max (ms)");
+    for (const auto& phase : REPLAY_PHASES) {
+        auto it = after.find(phase.histogram);
+        if (it == after.end())
+            continue;
+        const CMetricHistogram::Summary& summary = it->second;
+        uint64_t count = summary.count, sum = summary.sum;
+        auto itBefore = before.find(phase.histogram);
+        if (itBefore != before.end()) {
+            count -= itBefore->second.count;
+            sum -= itBefore->second.sum;
+        }
+        std::cout << strprintf("%-28s %8u %10.3f %10.3f %10.3f %10.3f\n", phase.label, count, sum * 1e-6,
+            count ? sum * 1e-3 / count : 0.0, summary.Percentile(0.99) * 1e-3, summary.max * 1e-3);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    SetupReplayArgs();
+    std::string error;
+    if (!gArgs.ParseParameters(argc, argv, error)) {
+        fprintf(stderr, "Error parsing command line arguments: %s\n", error.c_str());
+        return EXIT_FAILURE;
+    }
+    if (HelpRequested(gArgs)) {
+        std::cout << "Usage: bench_lava_replay -snapshot=<dir> -blocks=<dir> [options]\n\n" << gArgs.GetHelpMessage();
+        return EXIT_SUCCESS;
+    }
+    const fs::path snapshot = fs::absolute(gArgs.GetArg("-snapshot", ""));
+    const fs::path blocks = fs::absolute(gArgs.GetArg("-blocks", ""));
+    if (!gArgs.IsArgSet("-snapshot") || !fs::is_directory(snapshot) || !gArgs.IsArgSet("-blocks") || !fs::is_directory(blocks)) {
+        fprintf(stderr, "Error: -snapshot and -blocks must be existing directories\n");
+        return EXIT_FAILURE;
+    }
+    const int nFirst = gArgs.GetArg("-first", 0);
+    const int nLast = gArgs.GetArg("-last", nFirst);
+    try {
+        SelectParams(gArgs.GetChainName());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    const CChainParams& chainparams = Params();
+
+    // Replay on a copy of the snapshot, the data directory of the chain selected.
+    const fs::path datadir = fs::temp_directory_path() / "bench_lava_replay" / fs::unique_path();
+    std::cout << "Copying " << snapshot.string() << " to " << datadir.string() << std::endl;
+    CopyDirectory(snapshot, datadir);
+    gArgs.ForceSetArg("-datadir", datadir.string());
+    ClearDatadirCache();
+
+    SetupEnvironment();
+    SHA256AutoDetect();
+    Shabal256AutoDetect();
+    SipHashAutoDetect();
+    RandomInit();
+    ECC_Start();
+    LogInstance().m_print_to_console = gArgs.GetBoolArg("-printtoconsole", false);
+    LogInstance().EnableCategory(BCLog::BENCH);
+    InitSignatureCache();
+    InitScriptExecutionCache();
+    InitRangeproofCache();
+
+    boost::thread_group threadGroup;
+    CScheduler scheduler;
+    threadGroup.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    nScriptCheckThreads = gArgs.GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+    if (nScriptCheckThreads <= 0)
+        nScriptCheckThreads += GetNumCores();
+    nScriptCheckThreads = nScriptCheckThreads <= 1 ? 0 : std::min(nScriptCheckThreads, MAX_SCRIPTCHECK_THREADS);
+    for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+        threadGroup.create_thread(&ThreadScriptCheck);
+        threadGroup.create_thread(&ThreadPoCCheck);
+    }
+
+    int ret = EXIT_SUCCESS;
+    if (!LoadChainState(chainparams, std::max<int64_t>(gArgs.GetArg("-dbcache", DEFAULT_REPLAY_DBCACHE), nMinDbCache) << 20)) {
+        fprintf(stderr, "Error: cannot load the chain state of the snapshot, see the log\n");
+        ret = EXIT_FAILURE;
+    } else {
+        int nStartHeight;
+        {
+            LOCK(cs_main);
+            nStartHeight = chainActive.Height();
+        }
+        std::cout << "Replaying blk" << nFirst << ".." << nLast << " from height " << nStartHeight << std::endl;
+
+        CReplay replay(chainparams, gArgs.GetArg("-reorgevery", 0), std::max<int64_t>(gArgs.GetArg("-reorgdepth", DEFAULT_REPLAY_REORG_DEPTH), 1));
+        const auto before = GetPhaseSummaries();
+        const int64_t nStart = GetTimeMicros();
+        for (int nFile = nFirst; nFile <= nLast && ret == EXIT_SUCCESS; nFile++) {
+            const fs::path path = blocks / strprintf("blk%05u.dat", nFile);
+            FILE* file = fsbridge::fopen(path, "rb");
+            if (!file) {
+                fprintf(stderr, "Error: cannot open %s\n", path.string().c_str());
+                ret = EXIT_FAILURE;
+                break;
+            }
+            ScanBlockFile(chainparams, file, nullptr, [&](const std::shared_ptr<CBlock>& pblock) {
+                if (!replay.ProcessBlock(pblock))
+                    ret = EXIT_FAILURE;
+                return ret == EXIT_SUCCESS;
+            });
+        }
+        SyncWithValidationInterfaceQueue();
+        const int64_t nElapsed = GetTimeMicros() - nStart;
+        const auto after = GetPhaseSummaries();
+
+        int nEndHeight;
+        {
+            LOCK(cs_main);
+            nEndHeight = chainActive.Height();
+        }
+        std::cout << strprintf("Connected %u blocks (%u transactions) from height %d to %d in %.3fs, %.1f blocks/s, %u reorgs of %d blocks\n",
+            replay.nBlocks, replay.nTransactions, nStartHeight, nEndHeight, nElapsed * 1e-6,
+            nElapsed ? replay.nBlocks * 1e6 / nElapsed : 0.0, replay.nReorgs, replay.nReorgDepth);
+        if (replay.Waiting())
+            std::cout << replay.Waiting() << " blocks were left without their parent" << std::endl;
+        PrintPhases(before, after);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    if (pcoinsTip)
+        FlushStateToDisk();
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    {
+        LOCK(cs_main);
+        UnloadBlockIndex();
+        pcoinsTip.reset();
+        pcoinsprefetch.reset();
+        pcoinsdbview.reset();
+        pblocktree.reset();
+    }
+    ECC_Stop();
+    if (!gArgs.GetBoolArg("-keepdatadir", false))
+        fs::remove_all(datadir);
+
+    return ret;
+}
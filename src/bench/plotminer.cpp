@@ -0,0 +1,58 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <plotminer.h>
+#include <random.h>
+#include <util/system.h>
+
+/** A plot file of 65536 nonces holding only its first scoop column, 4 MiB. */
+static CPlotFile MakeScoopColumn()
+{
+    CPlotFile plot;
+    plot.nonces = 65536;
+    plot.path = GetDataDir() / "plotminer_bench";
+    if (!fs::exists(plot.path)) {
+        FastRandomContext rng(true);
+        const std::vector<unsigned char> column = rng.randbytes(plot.nonces * POC_SCOOP_SIZE);
+        FILE* file = fsbridge::fopen(plot.path, "wb");
+        fwrite(column.data(), 1, column.size(), file);
+        fclose(file);
+    }
+    return plot;
+}
+
+// One scan of a scoop column and its deadlines, as in a round of the plot miner. The column
+// is in the page cache after the first run, so this is the ceiling of the read path: divide
+// 4 MiB by the time per run for the MB/s; getplotminerinfo reports the ones of real disks.
+static void ScanScoopColumn(benchmark::State& state, const bool fMmap)
+{
+    const CPlotFile plot = MakeScoopColumn();
+    const uint256 genSig = FastRandomContext(true).rand256();
+    std::vector<uint64_t> deadlines;
+    while (state.KeepRunning()) {
+        CScoopColumn column(plot, 0, DEFAULT_PLOT_READ_SIZE * 1024, fMmap);
+        while (!column.IsDone()) {
+            uint64_t first, count;
+            const uint8_t* scoops = column.Read(first, count);
+            assert(scoops);
+            deadlines.resize(count);
+            CalcScoopDeadlines(genSig, scoops, deadlines.data(), count);
+        }
+    }
+}
+
+static void PlotScanPread(benchmark::State& state)
+{
+    ScanScoopColumn(state, false);
+}
+
+static void PlotScanMmap(benchmark::State& state)
+{
+    ScanScoopColumn(state, true);
+}
+
+BENCHMARK(PlotScanPread, 10);
+BENCHMARK(PlotScanMmap, 10);
@@ -0,0 +1,124 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chain.h>
+#include <poc.h>
+#include <random.h>
+
+// A block header check, one nonce generated on its own.
+static void PoCCalcDeadline(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    const uint256 genSig = rng.rand256();
+    const uint160 keyID = uint160(std::vector<unsigned char>(20, 0x42));
+    uint64_t nonce = 0;
+    while (state.KeepRunning()) {
+        CalcDeadline(genSig, 10000, keyID, nonce++);
+    }
+}
+
+// Nonces generated side by side in the lanes of the multi-lane engine, as in a batch of headers.
+static void PoCCalcDeadlines(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    const uint256 genSig = rng.rand256();
+    const uint160 keyID = uint160(std::vector<unsigned char>(20, 0x42));
+    uint64_t nonces[16];
+    uint64_t deadlines[16];
+    uint64_t next = 0;
+    while (state.KeepRunning()) {
+        for (auto& nonce : nonces) {
+            nonce = next++;
+        }
+        CalcDeadlines(genSig, 10000, keyID, nonces, deadlines, 16);
+    }
+}
+
+// The deadlines of the scoops of one plot read, as computed by the plot miner.
+static void PoCCalcScoopDeadlines(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    const uint256 genSig = rng.rand256();
+    std::vector<uint8_t> scoops = rng.randbytes(4096 * POC_SCOOP_SIZE);
+    std::vector<uint64_t> deadlines(4096);
+    while (state.KeepRunning()) {
+        CalcScoopDeadlines(genSig, scoops.data(), deadlines.data(), deadlines.size());
+    }
+}
+
+/** Proofs of capacity of distinct plotters, as submitted to a pool. */
+static std::vector<PoCItem> MakePoCItems(const size_t count)
+{
+    FastRandomContext rng(true);
+    const uint256 genSig = rng.rand256();
+    std::vector<PoCItem> items(count);
+    for (size_t i = 0; i < count; i++) {
+        PoCItem& item = items[i];
+        item.genSig = genSig;
+        item.height = 10000;
+        item.publicKeyID = uint160(rng.randbytes(20));
+        item.nonce = rng.rand64();
+        item.baseTarget = 18325193796ULL;
+        item.deadline = CalcDeadline(item.genSig, item.height, item.publicKeyID, item.nonce);
+    }
+    return items;
+}
+
+// A batch of submitted nonces verified one by one.
+static void PoCCheckSubmissions(benchmark::State& state)
+{
+    std::vector<PoCItem> items = MakePoCItems(64);
+    while (state.KeepRunning()) {
+        for (const PoCItem& item : items) {
+            CheckProofOfCapacity(item.genSig, item.height, item.publicKeyID, item.nonce, item.baseTarget, item.deadline, 60 * 60 * 24);
+        }
+    }
+}
+
+// The same batch verified by CheckProofOfCapacityBatch, as on the CPU when no PoC batch device is set.
+static void PoCCheckSubmissionsBatch(benchmark::State& state)
+{
+    std::vector<PoCItem> items = MakePoCItems(64);
+    while (state.KeepRunning()) {
+        CheckProofOfCapacityBatch(MakeSpan(items), 60 * 60 * 24);
+    }
+}
+
+static void PoCGenerationSignature(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    uint256 genSig = rng.rand256();
+    const uint160 keyID = uint160(std::vector<unsigned char>(20, 0x42));
+    while (state.KeepRunning()) {
+        genSig = CalcGenerationSignature(genSig, keyID);
+    }
+}
+
+// Retarget on top of a chain past the averaging window, walking the last 24 blocks.
+static void PoCAdjustBaseTarget(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<CBlockIndex> chain(3000);
+    for (size_t i = 0; i < chain.size(); i++) {
+        chain[i].pprev = i > 0 ? &chain[i - 1] : nullptr;
+        chain[i].nHeight = i;
+        chain[i].nTime = 1546300800 + 240 * i + rng.randrange(120);
+        chain[i].nBaseTarget = 18325193796ULL / 2 + rng.randrange(1000000);
+    }
+    const CBlockIndex* tip = &chain.back();
+    uint32_t nTime = tip->nTime + 240;
+    while (state.KeepRunning()) {
+        AdjustBaseTarget(tip, nTime++);
+    }
+}
+
+BENCHMARK(PoCCalcDeadline, 500);
+BENCHMARK(PoCCalcDeadlines, 40);
+BENCHMARK(PoCCalcScoopDeadlines, 200);
+BENCHMARK(PoCCheckSubmissions, 10);
+BENCHMARK(PoCCheckSubmissionsBatch, 10);
+BENCHMARK(PoCGenerationSignature, 1000000);
+BENCHMARK(PoCAdjustBaseTarget, 5000000);
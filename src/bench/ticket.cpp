@@ -0,0 +1,125 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <actiondb.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <fspool.h>
+#include <random.h>
+#include <ticket.h>
+#include <txdb.h>
+#include <validation.h>
+
+static CKeyID RandomKeyID(FastRandomContext& rng)
+{
+    return CKeyID(uint160(rng.randbytes(20)));
+}
+
+/** A firestone purchase of keyID, in the layout buyfirestone creates. */
+static CTransactionRef MakeTicketTx(FastRandomContext& rng, const CKeyID& keyID, const int lockHeight)
+{
+    const CScript redeemScript = GenerateTicketScript(keyID, lockHeight);
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(rng.rand256(), 0));
+    tx.vout.emplace_back(0, CScript() << OP_RETURN << CTicket::VERSION << ToByteVector(redeemScript));
+    tx.vout.emplace_back(3000 * COIN, GetScriptForDestination(CScriptID(redeemScript)));
+    return MakeTransactionRef(tx);
+}
+
+// Connect and disconnect a run of blocks buying firestones, 32 per block from 512 owners.
+static void TicketConnectDisconnect(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    FastRandomContext rng(true);
+    CTicketView view(1 << 20, true);
+
+    std::vector<CKeyID> owners(512);
+    for (auto& owner : owners) {
+        owner = RandomKeyID(rng);
+    }
+    std::vector<CBlock> blocks(64);
+    for (auto& block : blocks) {
+        CMutableTransaction coinbase;
+        coinbase.vin.emplace_back(COutPoint());
+        block.vtx.push_back(MakeTransactionRef(coinbase));
+        for (int i = 0; i < 32; i++) {
+            block.vtx.push_back(MakeTicketTx(rng, owners[rng.randrange(owners.size())], view.LockTime()));
+        }
+    }
+    auto checkTicket = [](const int height, const CTicketRef& ticket) { return true; };
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            view.ConnectBlock(i + 1, blocks[i], checkTicket);
+        }
+        for (size_t i = blocks.size(); i > 0; i--) {
+            view.DisconnectBlock(i, blocks[i - 1]);
+        }
+    }
+}
+
+// Look up the bound target of plotters among 10000 bindings, both poc2 and poc2.x.
+static void RelationTo(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CRelationView view(1 << 20, true);
+
+    std::vector<CKeyID> from(10000);
+    std::vector<std::pair<uint256, CRelationActive>> relations;
+    for (auto& keyID : from) {
+        keyID = RandomKeyID(rng);
+        view.AcceptAction(1, rng.rand256(), MakeBindAction(keyID, RandomKeyID(rng)), relations, false);
+    }
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const CKeyID& keyID = from[i++ % from.size()];
+        view.To(keyID, keyID.GetPlotID(), true);
+        view.To(keyID, keyID.GetPlotID(), false);
+    }
+}
+
+// The ready fstx of a slot among 4 slots of 500 fstx each, as the block assembler asks for them.
+static void FSPoolReadyFstx(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    {
+        LOCK(cs_main);
+        ::pcoinsdbview.reset(new CCoinsViewDB(1 << 20, true));
+        ::pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
+    }
+    {
+        CFSPool fspool(1 << 20, true);
+        for (int slot = 0; slot < 4; slot++) {
+            for (int i = 0; i < 500; i++) {
+                // The firestone is unspent, so its fstx is ready.
+                const COutPoint firestone(rng.rand256(), 1);
+                {
+                    LOCK(cs_main);
+                    pcoinsTip->AddCoin(firestone, Coin(CTxOut(3000 * COIN, CScript() << OP_TRUE), 1, false), false);
+                }
+                CMutableTransaction tx;
+                tx.vin.emplace_back(firestone);
+                tx.vout.emplace_back(3000 * COIN, CScript() << OP_TRUE);
+                fspool.WriteFstx(CTransaction(tx), slot, tx.GetHash());
+            }
+        }
+
+        int slot = 0;
+        while (state.KeepRunning()) {
+            fspool.GetReadyFstxBySlotIndex(slot++ % 4);
+        }
+    }
+    {
+        LOCK(cs_main);
+        ::pcoinsTip.reset();
+        ::pcoinsdbview.reset();
+    }
+}
+
+BENCHMARK(TicketConnectDisconnect, 20);
+BENCHMARK(RelationTo, 500000);
+BENCHMARK(FSPoolReadyFstx, 20000);
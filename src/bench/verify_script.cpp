@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <hash.h>
 #include <key.h>
 #if defined(HAVE_CONSENSUS_LIB)
 #include <script/bitcoinconsensus.h>
@@ -106,4 +107,46 @@ static void VerifyScriptBench(benchmark::State& state)
     }
 }
 
+
+// Microbenchmark for the ECDSA checks of a block whose inputs are spent by few keys, like
+// the payouts of a pool, and of one whose inputs all have keys of their own.
+static void VerifyECDSA(benchmark::State& state, size_t nKeys)
+{
+    const size_t nSigs = 256;
+    std::vector<CPubKey> pubkeys;
+    std::vector<std::vector<unsigned char>> sigs(nSigs);
+    std::vector<uint256> hashes(nSigs);
+    std::vector<CKey> keys(nKeys);
+    for (size_t i = 0; i < nKeys; i++) {
+        std::array<unsigned char, 32> vchKey = {};
+        vchKey[30] = (i + 1) >> 8;
+        vchKey[31] = (i + 1) & 0xff;
+        keys[i].Set(vchKey.begin(), vchKey.end(), true);
+        pubkeys.push_back(keys[i].GetPubKey());
+    }
+    for (size_t i = 0; i < nSigs; i++) {
+        hashes[i] = (CHashWriter(SER_GETHASH, 0) << (uint64_t)i).GetHash();
+        keys[i % nKeys].Sign(hashes[i], sigs[i]);
+    }
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < nSigs; i++) {
+            bool success = pubkeys[i % nKeys].Verify(hashes[i], sigs[i]);
+            assert(success);
+        }
+    }
+}
+
+static void VerifyECDSASameKey(benchmark::State& state)
+{
+    VerifyECDSA(state, 1);
+}
+
+static void VerifyECDSADistinctKeys(benchmark::State& state)
+{
+    VerifyECDSA(state, 256);
+}
+
 BENCHMARK(VerifyScriptBench, 6300);
+BENCHMARK(VerifyECDSASameKey, 25);
+BENCHMARK(VerifyECDSADistinctKeys, 25);
@@ -6,30 +6,41 @@
 #include <config/bitcoin-config.h>
 #endif
 
+#include <actiondb.h>
+#include <blind.h>
+#include <chainparams.h>
 #include <clientversion.h>
 #include <coins.h>
 #include <consensus/consensus.h>
 #include <core_io.h>
+#include <issuance.h>
 #include <key_io.h>
 #include <keystore.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <rpc/util.h>
 #include <script/script.h>
 #include <script/sign.h>
+#include <ticket.h>
 #include <univalue.h>
 #include <util/system.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 
+#include <iostream>
 #include <memory>
 #include <stdio.h>
 
 #include <boost/algorithm/string.hpp>
 
 static bool fCreateBlank;
-static std::map<std::string,UniValue> registers;
+static bool fBatch;
+typedef std::map<std::string,UniValue> RegisterMap;
+static RegisterMap commandRegisters;
 static const int CONTINUE_EXECUTION=-1;
+/** Operations of a -batch read before they are run side by side. */
+static const size_t BATCH_OPERATIONS = 256;
 
 const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
 
@@ -37,6 +48,10 @@ static void SetupBitcoinTxArgs()
 {
     SetupHelpOptions(gArgs);
 
+    gArgs.AddArg("-batch", "Read operations from standard input, one JSON object per line, and write one line for each: "
+        "the resulting TX, or error: MESSAGE. An operation is {\"tx\":HEX-TX,\"commands\":[\"COMMAND=VALUE\",...],\"registers\":{NAME:JSON,...}}, "
+        "a new, empty TX when tx is left out; its registers start from those of the load and set commands given on the command line. "
+        "The operations share one secp256k1 context and are run across the cores.", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-create", "Create new, empty TX.", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-json", "Select JSON output", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-txid", "Output only the hex-encoded transaction id of the resultant transaction.", false, OptionsCategory::OPTIONS);
@@ -47,7 +62,13 @@ static void SetupBitcoinTxArgs()
     gArgs.AddArg("in=TXID:VOUT(:SEQUENCE_NUMBER)", "Add input to TX", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("locktime=N", "Set TX lock time to N", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("nversion=N", "Set TX version to N", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("blind", "Blind the outputs of TX that carry the blinding key of a confidential address. "
+        "This command requires the JSON register inputblinds=JSON array of one object per input, "
+        "{\"asset\":HEX,\"amount\":AMOUNT,\"amountblinder\":HEX,\"assetblinder\":HEX}, each field optional, the asset defaulting to the policy asset.", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("outaction=bind:FROM-ADDRESS:TO-ADDRESS|unbind:ADDRESS", "Add the OP_RETURN output of a bind or unbind action, signed over the first input of TX "
+        "with the key of FROM-ADDRESS or ADDRESS from the privatekeys register. The TX must end up with two outputs and pay the action fee.", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("outaddr=VALUE:ADDRESS", "Add address-based output to TX", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("outasset=VALUE:ASSET:ADDRESS", "Add an output of ASSET to TX, left for the blind command to blind when ADDRESS is confidential", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("outdata=[VALUE:]DATA", "Add data-based output to TX", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("outmultisig=VALUE:REQUIRED:PUBKEYS:PUBKEY1:PUBKEY2:....[:FLAGS]", "Add Pay To n-of-m Multi-sig output to TX. n = REQUIRED, m = PUBKEYS. "
         "Optionally add the \"W\" flag to produce a pay-to-witness-script-hash output. "
@@ -55,6 +76,7 @@ static void SetupBitcoinTxArgs()
     gArgs.AddArg("outpubkey=VALUE:PUBKEY[:FLAGS]", "Add pay-to-pubkey output to TX. "
         "Optionally add the \"W\" flag to produce a pay-to-witness-pubkey-hash output. "
         "Optionally add the \"S\" flag to wrap the output in a pay-to-script-hash.", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("outticket=VALUE:ADDRESS:LOCKHEIGHT", "Add the outputs of a firestone purchase to TX, locked to the key of ADDRESS until LOCKHEIGHT", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("outscript=VALUE:SCRIPT[:FLAGS]", "Add raw script output to TX. "
         "Optionally add the \"W\" flag to produce a pay-to-witness-script-hash output. "
         "Optionally add the \"S\" flag to wrap the output in a pay-to-script-hash.", false, OptionsCategory::COMMANDS);
@@ -93,13 +115,21 @@ static int AppInitRawTx(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
+    // The policy asset, as the node derives it from the genesis block
+    uint256 entropy;
+    const CBlock& genesis = Params().GenesisBlock();
+    GenerateAssetEntropy(entropy, COutPoint(genesis.vtx[0]->GetHash(), 0), genesis.GetHash());
+    CalculateAsset(policyAsset, entropy);
+
     fCreateBlank = gArgs.GetBoolArg("-create", false);
+    fBatch = gArgs.GetBoolArg("-batch", false);
 
     if (argc < 2 || HelpRequested(gArgs)) {
         // First part of help message is specific to this utility
         std::string strUsage = PACKAGE_NAME " bitcoin-tx utility version " + FormatFullVersion() + "\n\n" +
             "Usage:  bitcoin-tx [options] <hex-tx> [commands]  Update hex-encoded bitcoin transaction\n" +
             "or:     bitcoin-tx [options] -create [commands]   Create hex-encoded bitcoin transaction\n" +
+            "or:     bitcoin-tx [options] -batch [load/set commands] < operations   Create or update transactions in a batch\n" +
             "\n";
         strUsage += gArgs.GetHelpMessage();
 
@@ -114,7 +144,7 @@ static int AppInitRawTx(int argc, char* argv[])
     return CONTINUE_EXECUTION;
 }
 
-static void RegisterSetJson(const std::string& key, const std::string& rawJson)
+static void RegisterSetJson(RegisterMap& registers, const std::string& key, const std::string& rawJson)
 {
     UniValue val;
     if (!val.read(rawJson)) {
@@ -125,7 +155,7 @@ static void RegisterSetJson(const std::string& key, const std::string& rawJson)
     registers[key] = val;
 }
 
-static void RegisterSet(const std::string& strInput)
+static void RegisterSet(RegisterMap& registers, const std::string& strInput)
 {
     // separate NAME:VALUE in string
     size_t pos = strInput.find(':');
@@ -137,10 +167,10 @@ static void RegisterSet(const std::string& strInput)
     std::string key = strInput.substr(0, pos);
     std::string valStr = strInput.substr(pos + 1, std::string::npos);
 
-    RegisterSetJson(key, valStr);
+    RegisterSetJson(registers, key, valStr);
 }
 
-static void RegisterLoad(const std::string& strInput)
+static void RegisterLoad(RegisterMap& registers, const std::string& strInput)
 {
     // separate NAME:FILENAME in string
     size_t pos = strInput.find(':');
@@ -178,7 +208,7 @@ static void RegisterLoad(const std::string& strInput)
     }
 
     // evaluate as JSON buffer register
-    RegisterSetJson(key, valStr);
+    RegisterSetJson(registers, key, valStr);
 }
 
 static CAmount ExtractAndValidateValue(const std::string& strValue)
@@ -476,6 +506,114 @@ static void MutateTxAddOutScript(CMutableTransaction& tx, const std::string& str
     tx.vout.push_back(txout);
 }
 
+static void MutateTxAddOutAsset(CMutableTransaction& tx, const std::string& strInput)
+{
+    // separate VALUE:ASSET:ADDRESS
+    std::vector<std::string> vStrInputParts;
+    boost::split(vStrInputParts, strInput, boost::is_any_of(":"));
+    if (vStrInputParts.size() != 3)
+        throw std::runtime_error("TX output missing or too many separators");
+
+    // Extract and validate VALUE
+    CAmount value = ExtractAndValidateValue(vStrInputParts[0]);
+
+    // extract and validate ASSET
+    uint256 assetid;
+    if (!ParseHashStr(vStrInputParts[1], assetid))
+        throw std::runtime_error("invalid TX output asset");
+
+    // extract and validate ADDRESS
+    CTxDestination destination = DecodeDestination(vStrInputParts[2]);
+    if (!IsValidDestination(destination)) {
+        throw std::runtime_error("invalid TX output address");
+    }
+
+    // The blinding key of a confidential address is left in the nonce, where blind finds it.
+    CTxOut txout(CConfidentialAsset(CAsset(assetid)), CConfidentialValue(value), GetScriptForDestination(destination));
+    const CPubKey blinding_pubkey = GetDestinationBlindingKey(destination);
+    if (blinding_pubkey.IsFullyValid())
+        txout.nNonce.vchCommitment.assign(blinding_pubkey.begin(), blinding_pubkey.end());
+    tx.vout.push_back(txout);
+
+    // Assets and their proofs are only serialized by confidential transactions.
+    if (txout.IsCA())
+        tx.nVersion = CMutableTransaction::CONFIDENTIAL_VERSION;
+}
+
+static CKeyID DecodeKeyIDAddress(const std::string& strAddr)
+{
+    CTxDestination destination = DecodeDestination(strAddr);
+    if (destination.type() != typeid(CKeyID))
+        throw std::runtime_error("address must be a pay to public key hash address");
+    return CKeyID(uint160(boost::get<CKeyID>(destination)));
+}
+
+static void MutateTxAddOutTicket(CMutableTransaction& tx, const std::string& strInput)
+{
+    // separate VALUE:ADDRESS:LOCKHEIGHT
+    std::vector<std::string> vStrInputParts;
+    boost::split(vStrInputParts, strInput, boost::is_any_of(":"));
+    if (vStrInputParts.size() != 3)
+        throw std::runtime_error("TX output missing or too many separators");
+
+    CAmount value = ExtractAndValidateValue(vStrInputParts[0]);
+    const CKeyID keyID = DecodeKeyIDAddress(vStrInputParts[1]);
+    int32_t lockHeight;
+    if (!ParseInt32(vStrInputParts[2], &lockHeight) || lockHeight <= 0)
+        throw std::runtime_error("invalid firestone lock height");
+
+    // The firestone and the OP_RETURN carrying its redeem script, as buyfirestone makes them
+    const CScript redeemScript = GenerateTicketScript(keyID, lockHeight);
+    tx.vout.push_back(CTxOut(value, GetScriptForDestination(CScriptID(redeemScript))));
+    tx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << CTicket::VERSION << ToByteVector(redeemScript)));
+}
+
+static CKey FindRegisterKey(RegisterMap& registers, const CKeyID& keyID)
+{
+    if (!registers.count("privatekeys"))
+        throw std::runtime_error("privatekeys register variable must be set.");
+    const UniValue& keysObj = registers["privatekeys"];
+
+    for (unsigned int kidx = 0; kidx < keysObj.size(); kidx++) {
+        if (!keysObj[kidx].isStr())
+            throw std::runtime_error("privatekey not a std::string");
+        CKey key = DecodeSecret(keysObj[kidx].getValStr());
+        if (!key.IsValid()) {
+            throw std::runtime_error("privatekey not valid");
+        }
+        if (key.GetPubKey().GetID() == keyID)
+            return key;
+    }
+    throw std::runtime_error("privatekeys holds no key of " + EncodeDestination(keyID));
+}
+
+static void MutateTxAddOutAction(CMutableTransaction& tx, const std::string& strInput, RegisterMap& registers)
+{
+    // separate bind:FROM-ADDRESS:TO-ADDRESS or unbind:ADDRESS
+    std::vector<std::string> vStrInputParts;
+    boost::split(vStrInputParts, strInput, boost::is_any_of(":"));
+
+    CKeyID signer;
+    CAction action;
+    if (vStrInputParts[0] == "bind" && vStrInputParts.size() == 3) {
+        signer = DecodeKeyIDAddress(vStrInputParts[1]);
+        action = MakeBindAction(signer, DecodeKeyIDAddress(vStrInputParts[2]));
+    } else if (vStrInputParts[0] == "unbind" && vStrInputParts.size() == 2) {
+        signer = DecodeKeyIDAddress(vStrInputParts[1]);
+        action = CAction(CUnbindAction(signer));
+    } else {
+        throw std::runtime_error("action must be bind:FROM-ADDRESS:TO-ADDRESS or unbind:ADDRESS");
+    }
+
+    // The action is signed over the first input, as bindplotter signs it.
+    if (tx.vin.empty())
+        throw std::runtime_error("action requires the first input of TX");
+    std::vector<unsigned char> vch;
+    if (!SignAction(tx.vin[0].prevout, action, FindRegisterKey(registers, signer), vch))
+        throw std::runtime_error("action signing failed");
+    tx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << vch));
+}
+
 static void MutateTxDelInput(CMutableTransaction& tx, const std::string& strInIdx)
 {
     // parse requested deletion index
@@ -539,7 +677,7 @@ static CAmount AmountFromValue(const UniValue& value)
     return amount;
 }
 
-static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
+static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr, RegisterMap& registers)
 {
     int nHashType = SIGHASH_ALL;
 
@@ -655,6 +793,54 @@ static void MutateTxSign(CMutableTransaction& tx, const std::string& flagStr)
     tx = mergedTx;
 }
 
+static void MutateTxBlind(CMutableTransaction& tx, RegisterMap& registers)
+{
+    if (!registers.count("inputblinds"))
+        throw std::runtime_error("inputblinds register variable must be set.");
+    const UniValue inputBlinds = registers["inputblinds"];
+    if (!inputBlinds.isArray() || inputBlinds.size() != tx.vin.size())
+        throw std::runtime_error("inputblinds must hold one object per input");
+
+    std::vector<uint256> input_blinds(tx.vin.size());
+    std::vector<uint256> input_asset_blinds(tx.vin.size());
+    std::vector<CAsset> input_assets(tx.vin.size(), policyAsset);
+    std::vector<CAmount> input_amounts(tx.vin.size(), -1);
+    for (unsigned int i = 0; i < inputBlinds.size(); i++) {
+        const UniValue& input = inputBlinds[i];
+        if (!input.isObject())
+            throw std::runtime_error("expected inputblinds internal object");
+        if (input.exists("asset")) {
+            uint256 assetid;
+            if (!ParseHashStr(input["asset"].getValStr(), assetid))
+                throw std::runtime_error("asset must be hexadecimal string");
+            input_assets[i] = CAsset(assetid);
+        }
+        if (input.exists("amount"))
+            input_amounts[i] = AmountFromValue(input["amount"]);
+        if (input.exists("amountblinder") && !ParseHashStr(input["amountblinder"].getValStr(), input_blinds[i]))
+            throw std::runtime_error("amountblinder must be hexadecimal string");
+        if (input.exists("assetblinder") && !ParseHashStr(input["assetblinder"].getValStr(), input_asset_blinds[i]))
+            throw std::runtime_error("assetblinder must be hexadecimal string");
+    }
+
+    std::vector<uint256> output_blinds;
+    std::vector<uint256> output_asset_blinds;
+    std::vector<CPubKey> output_pubkeys;
+    RawFillBlinds(tx, output_blinds, output_asset_blinds, output_pubkeys);
+    int nToBlind = 0;
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        if (output_pubkeys[i].IsValid() && tx.vout[i].IsCA())
+            nToBlind++;
+    }
+    if (nToBlind == 0)
+        throw std::runtime_error("TX has no output to a confidential address to blind");
+
+    // The range and surjection proofs are generated across the cores.
+    const int nBlinded = BlindTransaction(input_blinds, input_asset_blinds, input_assets, input_amounts, output_blinds, output_asset_blinds, output_pubkeys, std::vector<CKey>(), std::vector<CKey>(), tx);
+    if (nBlinded != nToBlind)
+        throw std::runtime_error("Unable to blind TX, it needs a second output to blind or the blinders of a blinded input");
+}
+
 class Secp256k1Init
 {
     ECCVerifyHandle globalVerifyHandle;
@@ -668,10 +854,15 @@ public:
     }
 };
 
+/** Apply command to tx. The secp256k1 context is started for the commands needing it, unless fEccStarted. */
 static void MutateTx(CMutableTransaction& tx, const std::string& command,
-                     const std::string& commandVal)
+                     const std::string& commandVal, RegisterMap& registers, bool fEccStarted = false)
 {
     std::unique_ptr<Secp256k1Init> ecc;
+    auto startEcc = [&ecc, fEccStarted] {
+        if (!fEccStarted)
+            ecc.reset(new Secp256k1Init());
+    };
 
     if (command == "nversion")
         MutateTxVersion(tx, commandVal);
@@ -690,27 +881,40 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
         MutateTxDelOutput(tx, commandVal);
     else if (command == "outaddr")
         MutateTxAddOutAddr(tx, commandVal);
+    else if (command == "outasset")
+        MutateTxAddOutAsset(tx, commandVal);
     else if (command == "outpubkey") {
-        ecc.reset(new Secp256k1Init());
+        startEcc();
         MutateTxAddOutPubKey(tx, commandVal);
     } else if (command == "outmultisig") {
-        ecc.reset(new Secp256k1Init());
+        startEcc();
         MutateTxAddOutMultiSig(tx, commandVal);
     } else if (command == "outscript")
         MutateTxAddOutScript(tx, commandVal);
     else if (command == "outdata")
         MutateTxAddOutData(tx, commandVal);
+    else if (command == "outticket")
+        MutateTxAddOutTicket(tx, commandVal);
+    else if (command == "outaction") {
+        startEcc();
+        MutateTxAddOutAction(tx, commandVal, registers);
+    }
+
+    else if (command == "blind") {
+        startEcc();
+        MutateTxBlind(tx, registers);
+    }
 
     else if (command == "sign") {
-        ecc.reset(new Secp256k1Init());
-        MutateTxSign(tx, commandVal);
+        startEcc();
+        MutateTxSign(tx, commandVal, registers);
     }
 
     else if (command == "load")
-        RegisterLoad(commandVal);
+        RegisterLoad(registers, commandVal);
 
     else if (command == "set")
-        RegisterSet(commandVal);
+        RegisterSet(registers, commandVal);
 
     else
         throw std::runtime_error("unknown command");
@@ -749,6 +953,121 @@ static void OutputTx(const CTransaction& tx)
         OutputTxHex(tx);
 }
 
+/** The line OutputTx writes for tx, the JSON of -json kept on one line for -batch. */
+static std::string BatchTxLine(const CTransaction& tx)
+{
+    if (gArgs.GetBoolArg("-json", false)) {
+        UniValue entry(UniValue::VOBJ);
+        TxToUniv(tx, uint256(), entry);
+        return entry.write();
+    } else if (gArgs.GetBoolArg("-txid", false))
+        return tx.GetHash().GetHex();
+    else
+        return EncodeHexTx(tx);
+}
+
+/** Run one operation of -batch, and return the line written for it. */
+static std::string RunBatchOperation(const std::string& strOperation)
+{
+    try {
+        UniValue operation;
+        if (!operation.read(strOperation) || !operation.isObject())
+            throw std::runtime_error("operation is not a JSON object");
+
+        CMutableTransaction tx;
+        const UniValue& hexTx = find_value(operation, "tx");
+        if (!hexTx.isNull() && !DecodeHexTx(tx, hexTx.getValStr(), true))
+            throw std::runtime_error("invalid transaction encoding");
+
+        RegisterMap registers = commandRegisters;
+        const UniValue& registersObj = find_value(operation, "registers");
+        if (!registersObj.isNull()) {
+            if (!registersObj.isObject())
+                throw std::runtime_error("registers is not a JSON object");
+            for (const std::string& key : registersObj.getKeys()) {
+                registers[key] = registersObj[key];
+            }
+        }
+
+        const UniValue& commands = find_value(operation, "commands");
+        if (!commands.isNull() && !commands.isArray())
+            throw std::runtime_error("commands is not a JSON array");
+        for (unsigned int i = 0; i < commands.size(); i++) {
+            const std::string arg = commands[i].getValStr();
+            std::string key, value;
+            size_t eqpos = arg.find('=');
+            if (eqpos == std::string::npos)
+                key = arg;
+            else {
+                key = arg.substr(0, eqpos);
+                value = arg.substr(eqpos + 1);
+            }
+
+            MutateTx(tx, key, value, registers, true);
+        }
+
+        return BatchTxLine(CTransaction(tx));
+    } catch (const std::exception& e) {
+        return std::string("error: ") + e.what();
+    }
+}
+
+/**
+ * Run the operations of standard input, BATCH_OPERATIONS at a time across the cores, writing
+ * their lines in the order they were read. Process startup and the secp256k1 context are paid
+ * once for the whole batch rather than once per transaction.
+ */
+static int BatchRawTx(int argc, char* argv[])
+{
+    // Only the registers shared by the operations are given on the command line.
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (IsSwitchChar(arg[0]))
+            continue;
+        size_t eqpos = arg.find('=');
+        std::string key = arg.substr(0, eqpos);
+        std::string value = eqpos == std::string::npos ? "" : arg.substr(eqpos + 1);
+        if (key == "load")
+            RegisterLoad(commandRegisters, value);
+        else if (key == "set")
+            RegisterSet(commandRegisters, value);
+        else
+            throw std::runtime_error("only load and set commands may be given with -batch");
+    }
+
+    Secp256k1Init ecc;
+    int nRet = EXIT_SUCCESS;
+    std::vector<std::string> operations;
+    std::string line;
+    while (true) {
+        operations.clear();
+        while (operations.size() < BATCH_OPERATIONS && std::getline(std::cin, line)) {
+            if (!line.empty())
+                operations.push_back(line);
+        }
+        if (operations.empty())
+            break;
+
+        std::vector<std::string> results(operations.size());
+        std::vector<std::function<bool()>> jobs;
+        for (size_t i = 0; i < operations.size(); i++) {
+            jobs.emplace_back([&operations, &results, i] {
+                results[i] = RunBatchOperation(operations[i]);
+                return true;
+            });
+        }
+        RunBlindingJobs(jobs);
+
+        for (const std::string& result : results) {
+            fprintf(stdout, "%s\n", result.c_str());
+            if (result.compare(0, 7, "error: ") == 0)
+                nRet = EXIT_FAILURE;
+        }
+        fflush(stdout);
+    }
+    return nRet;
+}
+
 static std::string readStdin()
 {
     char buf[4096];
@@ -812,7 +1131,7 @@ static int CommandLineRawTx(int argc, char* argv[])
                 value = arg.substr(eqpos + 1);
             }
 
-            MutateTx(tx, key, value);
+            MutateTx(tx, key, value, commandRegisters);
         }
 
         OutputTx(CTransaction(tx));
@@ -850,6 +1169,16 @@ int main(int argc, char* argv[])
     }
 
     int ret = EXIT_FAILURE;
+    if (fBatch) {
+        try {
+            ret = BatchRawTx(argc, argv);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "error: %s\n", e.what());
+        } catch (...) {
+            PrintExceptionContinue(nullptr, "BatchRawTx()");
+        }
+        return ret;
+    }
     try {
         ret = CommandLineRawTx(argc, argv);
     }
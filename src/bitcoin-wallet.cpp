@@ -9,7 +9,9 @@
 #include <chainparams.h>
 #include <chainparamsbase.h>
 #include <consensus/consensus.h>
+#include <issuance.h>
 #include <logging.h>
+#include <policy/policy.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <wallet/wallettool.h>
@@ -25,11 +27,16 @@ static void SetupWalletToolArgs()
 
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-wallet=<wallet-name>", "Specify wallet name", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dumpfile=<file>", "File the dump command writes the records of the wallet to", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debug=<category>", "Output debugging information (default: 0).", false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printtoconsole", "Send trace/debug info to console (default: 1 when no -debug is true, 0 otherwise.", false, OptionsCategory::DEBUG_TEST);
 
     gArgs.AddArg("info", "Get wallet info", false, OptionsCategory::COMMANDS);
     gArgs.AddArg("create", "Create new wallet file", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("dump", "Write the records of the wallet file to -dumpfile, one per line in hex, without loading the wallet", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("compact", "Rewrite the wallet file, leaving out the space of deleted records", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("salvage", "Recover the readable records of a damaged wallet file to a new file, keeping the damaged one as a backup", false, OptionsCategory::COMMANDS);
+    gArgs.AddArg("rebuild-utxo", "Recompute the unspent outputs and balances of the wallet from the chainstate of the data directory, with the node stopped", false, OptionsCategory::COMMANDS);
 }
 
 static bool WalletAppInit(int argc, char* argv[])
@@ -63,6 +70,12 @@ static bool WalletAppInit(int argc, char* argv[])
     // Check for -testnet or -regtest parameter (Params() calls are only valid after this clause)
     SelectParams(gArgs.GetChainName());
 
+    // The policy asset, as the node derives it from the genesis block
+    uint256 entropy;
+    const CBlock& genesis = Params().GenesisBlock();
+    GenerateAssetEntropy(entropy, COutPoint(genesis.vtx[0]->GetHash(), 0), genesis.GetHash());
+    CalculateAsset(policyAsset, entropy);
+
     return true;
 }
 
@@ -9,8 +9,15 @@
 #include <primitives/confidential.h>
 #include <issuance.h>
 #include <random.h>
+#include <sync.h>
 #include <util/system.h>
 
+#include <secp256k1_commitment.h>
+
+#include <atomic>
+#include <list>
+#include <thread>
+
 static secp256k1_context* secp256k1_blind_context = NULL;
 
 class Blind_ECC_Init {
@@ -36,12 +43,110 @@ public:
 
 static Blind_ECC_Init ecc_init_on_load;
 
+namespace {
+class CAssetGeneratorTableCache
+{
+    typedef std::pair<CAsset, std::shared_ptr<const secp256k1_generator_table>> Entry;
+
+    Mutex cs;
+    //! Most recently used first; short enough to search through.
+    std::list<Entry> entries GUARDED_BY(cs);
+
+public:
+    std::shared_ptr<const secp256k1_generator_table> Get(const CAsset& asset)
+    {
+        {
+            LOCK(cs);
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->first == asset) {
+                    entries.splice(entries.begin(), entries, it);
+                    return it->second;
+                }
+            }
+        }
+
+        // Built outside the lock; two threads missing on the same asset both build it.
+        secp256k1_generator gen;
+        int ret = secp256k1_generator_generate(secp256k1_blind_context, &gen, asset.begin());
+        assert(ret == 1);
+        std::shared_ptr<const secp256k1_generator_table> table(secp256k1_generator_table_create(secp256k1_blind_context, &gen), [](const secp256k1_generator_table* p) {
+            secp256k1_generator_table_destroy(secp256k1_blind_context, const_cast<secp256k1_generator_table*>(p));
+        });
+        assert(table);
+
+        LOCK(cs);
+        entries.emplace_front(asset, table);
+        if (entries.size() > ASSET_GENERATOR_TABLE_CACHE_SIZE) {
+            entries.pop_back();
+        }
+        return table;
+    }
+};
+} // namespace
+
+std::shared_ptr<const secp256k1_generator_table> GetAssetGeneratorTable(const CAsset& asset)
+{
+    static CAssetGeneratorTableCache cache;
+    return cache.Get(asset);
+}
+
+int RunBlindingJobs(const std::vector<std::function<bool()>>& jobs)
+{
+    std::atomic<size_t> next(0);
+    std::atomic<int> succeeded(0);
+    auto worker = [&jobs, &next, &succeeded] {
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            if (jobs[i]())
+                succeeded++;
+        }
+    };
+    const size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), jobs.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return succeeded;
+}
+
+namespace {
+
+/**
+ * The range and surjection proofs of a transaction being blinded. They are queued while the
+ * blinding factors are chosen and generated at once across the cores afterwards: a proof only
+ * depends on the commitments of its own output, and the blinding context is only read.
+ */
+class CBlindProofs
+{
+public:
+    void Add(std::function<bool()> job)
+    {
+        jobs.push_back(std::move(job));
+    }
+
+    /** Generate the queued proofs, and return how many of them succeeded. */
+    int Run()
+    {
+        int succeeded = RunBlindingJobs(jobs);
+        jobs.clear();
+        return succeeded;
+    }
+
+private:
+    std::vector<std::function<bool()>> jobs;
+};
+
+} // namespace
+
 bool UnblindConfidentialPair(const CKey& blinding_key, const CConfidentialValue& conf_value, const CConfidentialAsset& conf_asset, const CConfidentialNonce& nonce_commitment, const CScript& committedScript, const ProofData& vchRangeproof, CAmount& amount_out, uint256& blinding_factor_out, CAsset& asset_out, uint256& asset_blinding_factor_out)
 {
     if (!blinding_key.IsValid() || vchRangeproof.size() == 0) {
         return false;
     }
-    CPubKey ephemeral_key(nonce_commitment.vchCommitment);
+    CPubKey ephemeral_key(nonce_commitment.vchCommitment.begin(), nonce_commitment.vchCommitment.end());
     if (nonce_commitment.vchCommitment.size() > 0 && !ephemeral_key.IsFullyValid()) {
         return false;
     }
@@ -120,19 +225,17 @@ bool UnblindConfidentialPair(const CKey& blinding_key, const CConfidentialValue&
 }
 
 // Create surjection proof
-bool SurjectOutput(ProofData& vchSurjectionproof, const std::vector<secp256k1_fixed_asset_tag>& surjection_targets, const std::vector<secp256k1_generator>& target_asset_generators, const std::vector<uint256 >& target_asset_blinders, const std::vector<const unsigned char*> asset_blindptrs, const secp256k1_generator& output_asset_gen, const CAsset& asset)
+bool SurjectOutput(ProofData& vchSurjectionproof, const std::vector<secp256k1_fixed_asset_tag>& surjection_targets, const std::vector<secp256k1_generator>& target_asset_generators, const std::vector<uint256 >& target_asset_blinders, const std::vector<const unsigned char*>& asset_blindptrs, const secp256k1_generator& output_asset_gen, const CAsset& asset, const uint256& randseed)
 {
     int ret;
     // 1 to 3 targets
     size_t nInputsToSelect = std::min((size_t)3, surjection_targets.size());
-    unsigned char randseed[32];
-    GetStrongRandBytes(randseed, 32);
     size_t input_index;
     secp256k1_surjectionproof proof;
     secp256k1_fixed_asset_tag tag;
     memcpy(&tag, asset.begin(), 32);
     // Find correlation between asset tag and listed input tags
-    if (secp256k1_surjectionproof_initialize(secp256k1_blind_context, &proof, &input_index, &surjection_targets[0], surjection_targets.size(), nInputsToSelect, &tag, 100, randseed) == 0) {
+    if (secp256k1_surjectionproof_initialize(secp256k1_blind_context, &proof, &input_index, &surjection_targets[0], surjection_targets.size(), nInputsToSelect, &tag, 100, randseed.begin()) == 0) {
         return false;
     }
     // Using the input chosen, build proof
@@ -158,8 +261,7 @@ uint256 GenerateOutputRangeproofNonce(CTxOut& out, const CPubKey output_pubkey)
     ephemeral_key.MakeNewKey(true);
     CPubKey ephemeral_pubkey = ephemeral_key.GetPubKey();
     assert(ephemeral_pubkey.size() == CConfidentialNonce::nCommittedSize);
-    out.nNonce.vchCommitment.resize(ephemeral_pubkey.size());
-    memcpy(&out.nNonce.vchCommitment[0], &ephemeral_pubkey[0], ephemeral_pubkey.size());
+    out.nNonce.vchCommitment.assign(ephemeral_pubkey.begin(), ephemeral_pubkey.end());
     // Generate nonce
     uint256 nonce = ephemeral_key.ECDH(output_pubkey);
     CSHA256().Write(nonce.begin(), 32).Finalize(nonce.begin());
@@ -190,17 +292,17 @@ bool GenerateRangeproof(ProofData& rangeproof, const std::vector<unsigned char*>
 void BlindAsset(CConfidentialAsset& conf_asset, secp256k1_generator& asset_gen, const CAsset& asset, const unsigned char* asset_blindptr)
 {
     conf_asset.vchCommitment.resize(CConfidentialAsset::nCommittedSize);
-    int ret = secp256k1_generator_generate_blinded(secp256k1_blind_context, &asset_gen, asset.begin(), asset_blindptr);
+    int ret = secp256k1_generator_table_blind(secp256k1_blind_context, &asset_gen, GetAssetGeneratorTable(asset).get(), asset_blindptr);
     assert(ret == 1);
     ret = secp256k1_generator_serialize(secp256k1_blind_context, conf_asset.vchCommitment.data(), &asset_gen);
     assert(ret != 0);
 }
 
-void CreateValueCommitment(CConfidentialValue& conf_value, secp256k1_pedersen_commitment& value_commit, const unsigned char* value_blindptr, const secp256k1_generator& asset_gen, const CAmount amount)
+void CreateValueCommitment(CConfidentialValue& conf_value, secp256k1_pedersen_commitment& value_commit, const unsigned char* value_blindptr, const CAsset& asset, const unsigned char* asset_blindptr, const CAmount amount)
 {
     int ret;
     conf_value.vchCommitment.resize(CConfidentialValue::nCommittedSize);
-    ret = secp256k1_pedersen_commit(secp256k1_blind_context, &value_commit, value_blindptr, amount, &asset_gen, &secp256k1_generator_const_g);
+    ret = secp256k1_pedersen_commit_table(secp256k1_blind_context, &value_commit, value_blindptr, amount, GetAssetGeneratorTable(asset).get(), asset_blindptr);
     assert(ret != 0);
     secp256k1_pedersen_commitment_serialize(secp256k1_blind_context, conf_value.vchCommitment.data(), &value_commit);
     assert(conf_value.IsValid());
@@ -268,7 +370,7 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
                 return -1;
             }
         } else {
-            ret = secp256k1_generator_generate_blinded(secp256k1_blind_context, &target_asset_generators[totalTargets], input_assets[i].begin(), input_asset_blinding_factors[i].begin());
+            ret = secp256k1_generator_table_blind(secp256k1_blind_context, &target_asset_generators[totalTargets], GetAssetGeneratorTable(input_assets[i]).get(), input_asset_blinding_factors[i].begin());
             if (ret != 1) {
                 // Possibly invalid blinding factor provided by user.
                 return -1;
@@ -389,10 +491,11 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
 
 
     //Running total of newly blinded outputs
-    static const unsigned char diff_zero[32] = {0};
     assert(num_to_blind <= 10000); // More than 10k outputs? Stop spamming.
-    unsigned char blind[10000][32];
-    unsigned char asset_blind[10000][32];
+    // On the heap, the blinders of thousands of outputs would not fit the stack of a wallet thread.
+    std::vector<uint256> blind(num_to_blind);
+    std::vector<uint256> asset_blind(num_to_blind);
+    CBlindProofs proofs;
     secp256k1_pedersen_commitment value_commit;
     secp256k1_generator asset_gen;
     CAsset asset;
@@ -433,16 +536,16 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
                 }
 
                 // Fill out the value blinders and blank asset blinder
-                GetStrongRandBytes(&blind[num_blind_attempts-1][0], 32);
+                GetStrongRandBytes(blind[num_blind_attempts-1].begin(), 32);
                 // Issuances are not asset-blinded
-                memset(&asset_blind[num_blind_attempts-1][0], 0, 32);
-                value_blindptrs.push_back(&blind[num_blind_attempts-1][0]);
-                asset_blindptrs.push_back(&asset_blind[num_blind_attempts-1][0]);
+                asset_blind[num_blind_attempts-1].SetNull();
+                value_blindptrs.push_back(blind[num_blind_attempts-1].begin());
+                asset_blindptrs.push_back(asset_blind[num_blind_attempts-1].begin());
 
                 if (num_blind_attempts == num_to_blind) {
                     // All outputs we own are unblinded, we don't support this type of blinding
                     // though it is possible. No privacy gained here, incompatible with secp api
-                    return num_blinded;
+                    return num_blinded + proofs.Run();
                 }
 
                 // Create unblinded generator. We throw away all but `asset_gen`
@@ -450,17 +553,23 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
                 BlindAsset(conf_asset, asset_gen, asset, asset_blindptrs.back());
 
                 // Create value commitment
-                CreateValueCommitment(conf_value, value_commit, value_blindptrs.back(), asset_gen, amount);
+                CreateValueCommitment(conf_value, value_commit, value_blindptrs.back(), asset, asset_blindptrs.back(), amount);
 
                 // nonce should just be blinding key
                 uint256 nonce = nPseudo ? uint256(std::vector<unsigned char>(token_blinding_privkey[nIn].begin(), token_blinding_privkey[nIn].end())) : uint256(std::vector<unsigned char>(issuance_blinding_privkey[nIn].begin(), issuance_blinding_privkey[nIn].end()));
 
                 // Generate rangeproof, no script committed for issuances
-                bool rangeresult = GenerateRangeproof((nPseudo ? tx.vin[nIn].vchInflationKeysRangeproof : tx.vin[nIn].vchIssuanceAmountRangeproof), value_blindptrs, nonce, amount, CScript(), value_commit, asset_gen, asset, asset_blindptrs);
-                assert(rangeresult);
-
-                // Successfully blinded this issuance
-                num_blinded++;
+                unsigned char* value_blindptr = value_blindptrs.back();
+                const unsigned char* asset_blindptr = asset_blindptrs.back();
+                proofs.Add([&tx, nIn, nPseudo, value_blindptr, asset_blindptr, nonce, amount, value_commit, asset_gen, asset] {
+                    std::vector<unsigned char*> value_blindptrs{value_blindptr};
+                    std::vector<const unsigned char*> asset_blindptrs{asset_blindptr};
+                    bool rangeresult = GenerateRangeproof((nPseudo ? tx.vin[nIn].vchInflationKeysRangeproof : tx.vin[nIn].vchIssuanceAmountRangeproof), value_blindptrs, nonce, amount, CScript(), value_commit, asset_gen, asset, asset_blindptrs);
+                    assert(rangeresult);
+
+                    // Successfully blinded this issuance
+                    return true;
+                });
             }
         }
     }
@@ -479,10 +588,10 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
             asset = out.nAsset.GetAsset();
             blinded_amounts.push_back(amount);
 
-            GetStrongRandBytes(&blind[num_blind_attempts-1][0], 32);
-            GetStrongRandBytes(&asset_blind[num_blind_attempts-1][0], 32);
-            value_blindptrs.push_back(&blind[num_blind_attempts-1][0]);
-            asset_blindptrs.push_back(&asset_blind[num_blind_attempts-1][0]);
+            GetStrongRandBytes(blind[num_blind_attempts-1].begin(), 32);
+            GetStrongRandBytes(asset_blind[num_blind_attempts-1].begin(), 32);
+            value_blindptrs.push_back(blind[num_blind_attempts-1].begin());
+            asset_blindptrs.push_back(asset_blind[num_blind_attempts-1].begin());
 
             // Last blinding factor r' is set as -(output's (vr + r') - input's (vr + r')).
             // Before modifying the transaction or return arguments we must
@@ -495,7 +604,7 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
                 // Adversary would need to create all input blinds
                 // therefore would already know all your summed output amount anyways.
                 if (num_blind_attempts == 1 && num_known_input_blinds == 0) {
-                    return num_blinded;
+                    return num_blinded + proofs.Run();
                 }
 
                 // Generate value we intend to insert
@@ -513,14 +622,11 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
                 // becomes just (r'), if this is 0, we can just
                 // abort and not blind and the math adds up.
                 // Count as success(to signal caller that nothing wrong) and return early
-                if (memcmp(diff_zero, &blind[num_blind_attempts-1][0], 32) == 0) {
-                    return ++num_blinded;
+                if (blind[num_blind_attempts-1].IsNull()) {
+                    return ++num_blinded + proofs.Run();
                 }
             }
 
-            ProofData& vchRangeproof = out.vchRangeproof;
-            ProofData& vchSurjectionproof = out.vchSurjectionproof;
-
             out_val_blind_factors[nOut] = uint256(std::vector<unsigned char>(value_blindptrs[value_blindptrs.size()-1], value_blindptrs[value_blindptrs.size()-1]+32));
             out_asset_blind_factors[nOut] = uint256(std::vector<unsigned char>(asset_blindptrs[asset_blindptrs.size()-1], asset_blindptrs[asset_blindptrs.size()-1]+32));
 
@@ -528,33 +634,40 @@ int BlindTransaction(std::vector<uint256 >& input_value_blinding_factors, const
             BlindAsset(conf_asset, asset_gen, asset, asset_blindptrs.back());
 
             // Create value commitment
-            CreateValueCommitment(conf_value, value_commit, value_blindptrs.back(), asset_gen, amount);
+            CreateValueCommitment(conf_value, value_commit, value_blindptrs.back(), asset, asset_blindptrs.back(), amount);
 
             // Generate nonce for rewind by owner
             uint256 nonce = GenerateOutputRangeproofNonce(out, output_pubkeys[nOut]);
 
-            // Generate rangeproof
-            bool rangeresult = GenerateRangeproof(vchRangeproof, value_blindptrs, nonce, amount, out.scriptPubKey, value_commit, asset_gen, asset, asset_blindptrs);
-            assert(rangeresult);
+            // Drawn here rather than by the proof, so the proofs do not depend on the order they are generated in
+            uint256 randseed;
+            GetStrongRandBytes(randseed.begin(), 32);
 
-            // Create surjection proof for this output
-            if (!SurjectOutput(vchSurjectionproof, surjection_targets, target_asset_generators, target_asset_blinders, asset_blindptrs, asset_gen, asset)) {
-                continue;
-            }
+            unsigned char* value_blindptr = value_blindptrs.back();
+            const unsigned char* asset_blindptr = asset_blindptrs.back();
+            proofs.Add([&tx, &surjection_targets, &target_asset_generators, &target_asset_blinders, nOut, value_blindptr, asset_blindptr, nonce, amount, value_commit, asset_gen, asset, randseed] {
+                CTxOut& out = tx.vout[nOut];
+                std::vector<unsigned char*> value_blindptrs{value_blindptr};
+                std::vector<const unsigned char*> asset_blindptrs{asset_blindptr};
+
+                // Generate rangeproof
+                bool rangeresult = GenerateRangeproof(out.vchRangeproof, value_blindptrs, nonce, amount, out.scriptPubKey, value_commit, asset_gen, asset, asset_blindptrs);
+                assert(rangeresult);
 
-            // Successfully blinded this output
-            num_blinded++;
+                // Create surjection proof for this output, it is blinded if this succeeds
+                return SurjectOutput(out.vchSurjectionproof, surjection_targets, target_asset_generators, target_asset_blinders, asset_blindptrs, asset_gen, asset, randseed);
+            });
         }
     }
 
-    return num_blinded;
+    return num_blinded + proofs.Run();
 }
 
 void RawFillBlinds(CMutableTransaction& tx, std::vector<uint256>& output_value_blinds, std::vector<uint256>& output_asset_blinds, std::vector<CPubKey>& output_pubkeys) {
     for (size_t nOut = 0; nOut < tx.vout.size(); nOut++) {
         // Any place-holder blinding pubkeys are extracted
         if (tx.vout[nOut].nValueCA.IsExplicit()) {
-            CPubKey pubkey(tx.vout[nOut].nNonce.vchCommitment);
+            CPubKey pubkey(tx.vout[nOut].nNonce.vchCommitment.begin(), tx.vout[nOut].nNonce.vchCommitment.end());
             if (pubkey.IsFullyValid()) {
                 output_pubkeys.push_back(pubkey);
             } else {
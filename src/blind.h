@@ -12,12 +12,31 @@
 
 #include <secp256k1.h>
 #include <secp256k1_bulletproofs.h>
+#include <secp256k1_generator.h>
 #include <secp256k1_surjectionproof.h>
 
+#include <functional>
+#include <memory>
+
 // 64-bit bulletproofs size
 static const size_t DEFAULT_RANGEPROOF_SIZE = 4174;
 // constant-size surjection proof
 static const size_t SURJECTION_PROOF_SIZE = 67;
+// generator tables kept by GetAssetGeneratorTable, 16 KiB each
+static const size_t ASSET_GENERATOR_TABLE_CACHE_SIZE = 32;
+
+/*
+ * Run independent blinding or unblinding jobs across the cores, and return how many of them returned true.
+ * The jobs may share the blinding context, which they only read.
+ */
+int RunBlindingJobs(const std::vector<std::function<bool()>>& jobs);
+
+/*
+ * The generator of an unblinded asset along with its precomputed multiples, from a cache of the
+ * ASSET_GENERATOR_TABLE_CACHE_SIZE most recently used assets, so the policy asset, which nearly
+ * every commitment is on, is never hashed to the curve again. The table may be used with any context.
+ */
+std::shared_ptr<const secp256k1_generator_table> GetAssetGeneratorTable(const CAsset& asset);
 
 /*
  * Unblind a pair of confidential asset and value.
@@ -31,16 +50,19 @@ bool UnblindConfidentialPair(const CKey& blinding_key, const CConfidentialValue&
 
 bool GenerateRangeproof(ProofData& rangeproof, const std::vector<unsigned char*>& value_blindptrs, const uint256& nonce, const CAmount amount, const CScript& scriptPubKey, const secp256k1_pedersen_commitment& value_commit, const secp256k1_generator& gen, const CAsset& asset, std::vector<const unsigned char*>& asset_blindptrs);
 
-bool SurjectOutput(ProofData& vchSurjectionproof, const std::vector<secp256k1_fixed_asset_tag>& surjection_targets, const std::vector<secp256k1_generator>& target_asset_generators, const std::vector<uint256 >& target_asset_blinders, const std::vector<const unsigned char*> asset_blindptrs, const secp256k1_generator& output_asset_gen, const CAsset& asset);
+bool SurjectOutput(ProofData& vchSurjectionproof, const std::vector<secp256k1_fixed_asset_tag>& surjection_targets, const std::vector<secp256k1_generator>& target_asset_generators, const std::vector<uint256 >& target_asset_blinders, const std::vector<const unsigned char*>& asset_blindptrs, const secp256k1_generator& output_asset_gen, const CAsset& asset, const uint256& randseed);
 
 uint256 GenerateOutputRangeproofNonce(CTxOut& out, const CPubKey output_pubkey);
 
 void BlindAsset(CConfidentialAsset& conf_asset, secp256k1_generator& asset_gen, const CAsset& asset, const unsigned char* asset_blindptr);
 
-void CreateValueCommitment(CConfidentialValue& conf_value, secp256k1_pedersen_commitment& value_commit, const unsigned char* value_blindptr, const secp256k1_generator& asset_gen, const CAmount amount);
+// Commit to amount on the generator of asset blinded by asset_blindptr, as BlindAsset makes it.
+void CreateValueCommitment(CConfidentialValue& conf_value, secp256k1_pedersen_commitment& value_commit, const unsigned char* value_blindptr, const CAsset& asset, const unsigned char* asset_blindptr, const CAmount amount);
 
 /* Returns the number of outputs that were successfully blinded.
  * In many cases a `0` can be fixed by adding an additional output.
+ * The range and surjection proofs are generated across the cores once all blinding factors are balanced,
+ * their random seeds are drawn beforehand so that the result does not depend on the thread scheduling.
  * @param[in]   input_blinding_factors - A vector of input blinding factors that will be used to create the balanced output blinding factors
  * @param[in]   input_asset_blinding_factors - A vector of input asset blinding factors that will be used to create the balanced output blinding factors
  * @param[in]   input_assets - the asset of each corresponding input
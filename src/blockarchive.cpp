@@ -0,0 +1,235 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <blockarchive.h>
+
+#include <blockfilemap.h>
+#include <crypto/common.h>
+#include <serialize.h>
+#include <util/system.h>
+
+#include <algorithm>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+/** Magic of the skippable frame holding the seek table */
+static const uint32_t SEEK_TABLE_FRAME_MAGIC = 0x184D2A5E;
+/** Magic closing the seek table footer */
+static const uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+/** Size of the seek table footer: number of frames, descriptor and magic */
+static const size_t SEEK_TABLE_FOOTER_SIZE = 9;
+/** Data that is not a block record is cut into frames of at most this size */
+static const size_t MAX_RAW_FRAME_SIZE = 1 << 20;
+
+#ifdef USE_ZSTD
+
+bool CanArchiveBlockFiles()
+{
+    // Block files are only mapped on 64-bit systems other than Windows, see CMappedFile.
+#ifdef WIN32
+    return false;
+#else
+    return sizeof(void*) >= 8;
+#endif
+}
+
+CArchivedBlockFile::CArchivedBlockFile(const fs::path& path)
+{
+    std::unique_ptr<CMappedFile> mapped(new CMappedFile(path));
+    if (mapped->IsNull())
+        return;
+    const Span<const uint8_t> data = mapped->Data();
+    if ((size_t)data.size() < 8 + SEEK_TABLE_FOOTER_SIZE)
+        return;
+
+    // Read the footer, then the seek table in front of it
+    const uint8_t* footer = data.data() + data.size() - SEEK_TABLE_FOOTER_SIZE;
+    if (ReadLE32(footer + 5) != SEEKABLE_MAGIC)
+        return;
+    const uint64_t nFrames = ReadLE32(footer);
+    const size_t nEntrySize = (footer[4] & 0x80) ? 12 : 8;
+    const uint64_t nTableSize = nFrames * nEntrySize + SEEK_TABLE_FOOTER_SIZE;
+    if (nTableSize + 8 > (uint64_t)data.size())
+        return;
+    const uint64_t nTablePos = data.size() - nTableSize - 8;
+    if (ReadLE32(data.data() + nTablePos) != SEEK_TABLE_FRAME_MAGIC || ReadLE32(data.data() + nTablePos + 4) != nTableSize)
+        return;
+
+    std::vector<Frame> table;
+    table.reserve(nFrames);
+    uint64_t nRawPos = 0, nPos = 0;
+    for (uint64_t i = 0; i < nFrames; i++) {
+        const uint8_t* entry = data.data() + nTablePos + 8 + i * nEntrySize;
+        Frame frame;
+        frame.nRawPos = nRawPos;
+        frame.nPos = nPos;
+        frame.nSize = ReadLE32(entry);
+        frame.nRawSize = ReadLE32(entry + 4);
+        nRawPos += frame.nRawSize;
+        nPos += frame.nSize;
+        table.push_back(frame);
+    }
+    if (nPos != nTablePos)
+        return;
+
+    frames = std::move(table);
+    file = std::move(mapped);
+}
+
+CArchivedBlockFile::~CArchivedBlockFile() {}
+
+bool CArchivedBlockFile::ReadFrame(uint64_t nPos, std::vector<uint8_t>& data, uint64_t& nStart) const
+{
+    if (!file || nPos >= RawSize())
+        return false;
+    auto it = std::upper_bound(frames.begin(), frames.end(), nPos, [](uint64_t pos, const Frame& frame) {
+        return pos < frame.nRawPos;
+    });
+    const Frame& frame = *std::prev(it);
+    data.resize(frame.nRawSize);
+    const size_t nRead = ZSTD_decompress(data.data(), data.size(), file->Data().data() + frame.nPos, frame.nSize);
+    if (ZSTD_isError(nRead) || nRead != frame.nRawSize)
+        return false;
+    nStart = frame.nRawPos;
+    return true;
+}
+
+/** Cut a block file into the spans compressed as frames: its records, then what is left. */
+static std::vector<std::pair<size_t, size_t>> SplitBlockFile(Span<const uint8_t> data)
+{
+    std::vector<std::pair<size_t, size_t>> spans;
+    size_t nPos = 0;
+    // A record is the message start, the size of the block, then the block.
+    while (data.size() - nPos >= 8) {
+        const uint32_t nSize = ReadLE32(data.data() + nPos + 4);
+        if (nSize == 0 || nSize > MAX_SIZE || nSize > data.size() - nPos - 8)
+            break;
+        spans.emplace_back(nPos, 8 + nSize);
+        nPos += 8 + nSize;
+    }
+    while (nPos < (size_t)data.size()) {
+        const size_t nSize = std::min<size_t>(data.size() - nPos, MAX_RAW_FRAME_SIZE);
+        spans.emplace_back(nPos, nSize);
+        nPos += nSize;
+    }
+    return spans;
+}
+
+/** Commit and close file, written at tmp, and rename it to path. */
+static bool CommitArchiveFile(FILE* file, const fs::path& tmp, const fs::path& path)
+{
+    bool fOk = FileCommit(file);
+    fOk &= fclose(file) == 0;
+    if (!fOk || !RenameOver(tmp, path)) {
+        fs::remove(tmp);
+        return error("%s: Failed to write %s", __func__, path.string());
+    }
+    return true;
+}
+
+bool ArchiveBlockFile(const fs::path& from, const fs::path& to, int nLevel)
+{
+    const CMappedFile mapped(from);
+    if (mapped.IsNull())
+        return error("%s: Failed to map %s", __func__, from.string());
+    const Span<const uint8_t> data = mapped.Data();
+    const std::vector<std::pair<size_t, size_t>> spans = SplitBlockFile(data);
+
+    const fs::path tmp = to.string() + ".new";
+    FILE* file = fsbridge::fopen(tmp, "wb");
+    if (!file)
+        return error("%s: Failed to open %s", __func__, tmp.string());
+
+    std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    std::vector<uint8_t> table(8);
+    std::vector<uint8_t> buffer;
+    bool fOk = cctx != nullptr;
+    for (const auto& span : spans) {
+        if (!fOk)
+            break;
+        buffer.resize(ZSTD_compressBound(span.second));
+        const size_t nSize = ZSTD_compressCCtx(cctx.get(), buffer.data(), buffer.size(), data.data() + span.first, span.second, nLevel);
+        fOk = !ZSTD_isError(nSize) && fwrite(buffer.data(), 1, nSize, file) == nSize;
+        uint8_t entry[8];
+        WriteLE32(entry, nSize);
+        WriteLE32(entry + 4, span.second);
+        table.insert(table.end(), entry, entry + 8);
+    }
+    if (!fOk) {
+        fclose(file);
+        fs::remove(tmp);
+        return error("%s: Failed to compress %s", __func__, from.string());
+    }
+
+    // The seek table, as a skippable frame, and its footer
+    const size_t nFooter = table.size();
+    table.resize(nFooter + SEEK_TABLE_FOOTER_SIZE);
+    WriteLE32(table.data() + nFooter, spans.size());
+    table[nFooter + 4] = 0; // no checksums
+    WriteLE32(table.data() + nFooter + 5, SEEKABLE_MAGIC);
+    WriteLE32(table.data(), SEEK_TABLE_FRAME_MAGIC);
+    WriteLE32(table.data() + 4, table.size() - 8);
+    if (fwrite(table.data(), 1, table.size(), file) != table.size()) {
+        fclose(file);
+        fs::remove(tmp);
+        return error("%s: Failed to write %s", __func__, tmp.string());
+    }
+    return CommitArchiveFile(file, tmp, to);
+}
+
+bool RestoreBlockFile(const fs::path& from, const fs::path& to)
+{
+    const CArchivedBlockFile archive(from);
+    if (archive.IsNull())
+        return error("%s: Failed to open %s", __func__, from.string());
+
+    const fs::path tmp = to.string() + ".new";
+    FILE* file = fsbridge::fopen(tmp, "wb");
+    if (!file)
+        return error("%s: Failed to open %s", __func__, tmp.string());
+    std::vector<uint8_t> data;
+    uint64_t nStart;
+    for (uint64_t nPos = 0; nPos < archive.RawSize(); nPos += data.size()) {
+        if (!archive.ReadFrame(nPos, data, nStart) || fwrite(data.data(), 1, data.size(), file) != data.size()) {
+            fclose(file);
+            fs::remove(tmp);
+            return error("%s: Failed to decompress %s", __func__, from.string());
+        }
+    }
+    return CommitArchiveFile(file, tmp, to);
+}
+
+#else
+
+bool CanArchiveBlockFiles()
+{
+    return false;
+}
+
+CArchivedBlockFile::CArchivedBlockFile(const fs::path& path) {}
+
+CArchivedBlockFile::~CArchivedBlockFile() {}
+
+bool CArchivedBlockFile::ReadFrame(uint64_t nPos, std::vector<uint8_t>& data, uint64_t& nStart) const
+{
+    return false;
+}
+
+bool ArchiveBlockFile(const fs::path& from, const fs::path& to, int nLevel)
+{
+    return false;
+}
+
+bool RestoreBlockFile(const fs::path& from, const fs::path& to)
+{
+    return false;
+}
+
+#endif // USE_ZSTD
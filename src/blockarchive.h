@@ -0,0 +1,82 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_BLOCKARCHIVE_H
+#define LAVA_BLOCKARCHIVE_H
+
+#include <fs.h>
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+class CMappedFile;
+
+/** Default for -archiveblocks */
+static const bool DEFAULT_ARCHIVE_BLOCKS = false;
+/** zstd level block files are archived at: they are written once and read many times. */
+static const int BLOCK_ARCHIVE_LEVEL = 9;
+/** Seconds between two block files archived in the background */
+static const int64_t BLOCK_ARCHIVE_INTERVAL = 10;
+
+/**
+ * Archival of the block files no longer written to, recompressed into blk?????.zst in
+ * the zstd seekable format: every block record is a zstd frame of its own, and a seek
+ * table in a skippable frame at the end gives the sizes of the frames. Decompressed one
+ * after the other, the frames give back the original file, so block positions keep
+ * pointing into it and the block index is left as it is. A block is read by
+ * decompressing its frame alone.
+ *
+ * Only available when built with zstd, on systems block files are mapped on, as the
+ * archives are; CanArchiveBlockFiles() is false otherwise.
+ */
+bool CanArchiveBlockFiles();
+
+/** A block file archive, mapped into memory with its seek table read. */
+class CArchivedBlockFile
+{
+public:
+    /** Open the archive at path. It is null if that fails or the archive is malformed. */
+    explicit CArchivedBlockFile(const fs::path& path);
+    ~CArchivedBlockFile();
+
+    CArchivedBlockFile(const CArchivedBlockFile&) = delete;
+    CArchivedBlockFile& operator=(const CArchivedBlockFile&) = delete;
+
+    bool IsNull() const { return file == nullptr; }
+
+    /** Size of the original block file */
+    uint64_t RawSize() const { return frames.empty() ? 0 : frames.back().nRawPos + frames.back().nRawSize; }
+
+    /**
+     * Decompress the frame holding offset nPos of the original file into data.
+     * nStart is set to the offset of the original file the frame starts at.
+     */
+    bool ReadFrame(uint64_t nPos, std::vector<uint8_t>& data, uint64_t& nStart) const;
+
+private:
+    struct Frame
+    {
+        uint64_t nRawPos;   //!< offset in the original file
+        uint64_t nPos;      //!< offset in the archive
+        uint32_t nRawSize;
+        uint32_t nSize;
+    };
+
+    std::unique_ptr<CMappedFile> file;
+    //! The frames, in the order of the original file
+    std::vector<Frame> frames;
+};
+
+/**
+ * Write the archive of the block file at from to to, a frame per block record. Data that
+ * is not a record, as the space allocated ahead at the end of the file, is cut into
+ * frames of its own. The archive is written aside and renamed into place once complete.
+ */
+bool ArchiveBlockFile(const fs::path& from, const fs::path& to, int nLevel = BLOCK_ARCHIVE_LEVEL);
+
+/** Write the original block file of the archive at from back to to, as a reindex needs. */
+bool RestoreBlockFile(const fs::path& from, const fs::path& to);
+
+#endif // LAVA_BLOCKARCHIVE_H
@@ -1,44 +1,170 @@
 #include <blockcache.h>
 #include <util/time.h>
 #include <chain.h>
+#include <chainparams.h>
 #include <logging.h>
+#include <metrics.h>
+#include <poc.h>
+#include <scheduler.h>
+#include <util/trace.h>
 
-CBlockCache::CBlockCache():prevIndex(nullptr) {}
+#include <algorithm>
+#include <set>
+
+/** Order the heap so that the block accepted first, then the one with the smaller deadline, is at the front. */
+static bool AcceptsLater(const CCachedBlock& a, const CCachedBlock& b)
+{
+    if (a.nAcceptTime != b.nAcceptTime)
+        return a.nAcceptTime > b.nAcceptTime;
+    return a.block->nDeadline > b.block->nDeadline;
+}
+
+CBlockCache::CBlockCache():tipIndex(nullptr), scheduler(nullptr) {}
 
 void CBlockCache::UpdateBestBlockIndex(const CBlockIndex* index)
 {
-    if (!blocks.empty()) {
-        LogPrintf("%s: active chain update block, cache remove %d blocks\n", __func__, blocks.size());
-        blocks.clear();
+    LOCK(cs);
+    tipIndex = index;
+    if (blocks.empty())
+        return;
+    auto front = blocks.front().block;
+    auto size = blocks.size();
+    // Children of the tip and of its competitors at the same height may still win.
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [index](const CCachedBlock& cached) {
+        return index == nullptr || cached.prevIndex->nHeight < index->nHeight;
+    }), blocks.end());
+    if (blocks.size() != size) {
+        LogPrintf("%s: active chain update block, cache remove %d blocks\n", __func__, size - blocks.size());
+        std::make_heap(blocks.begin(), blocks.end(), AcceptsLater);
     }
-    prevIndex = index;
+    if (!blocks.empty() && blocks.front().block != front)
+        SchedulePush(blocks.front());
 }
 
-void CBlockCache::AddBlock(const std::shared_ptr<const CBlock>& blk, std::function<bool()> const &func)
+void CBlockCache::AddBlock(const std::shared_ptr<const CBlock>& blk, const CBlockIndex* prevIndex, std::function<bool()> const &func,
+                           std::function<void()> const &prevalidate)
 {
-    if (blk->hashPrevBlock != prevIndex->GetBlockHash()){
-        LogPrintf("%s: AddBlock in too far away, discard from cache, block:%s", __func__, blk->GetHash().ToString());
+    const uint256 hash = blk->GetHash();
+    LOCK(cs);
+    if (tipIndex == nullptr || prevIndex->nHeight < tipIndex->nHeight){
+        LogPrintf("%s: AddBlock in too far away, discard from cache, block:%s\n", __func__, hash.ToString());
         return;
     }
-    blocks.emplace_back(std::make_shared<CBlock>(*blk));
-    static auto compare = [](const std::shared_ptr<const CBlock> blk1, const std::shared_ptr<const CBlock> blk2)->bool {
-        return blk1->nDeadline < blk2->nDeadline;
-    };
-    std::sort(blocks.begin(), blocks.end(), compare);
-    handle = func;
+
+    std::set<const CBlockIndex*> parents;
+    for (const auto& cached : blocks) {
+        if (cached.hash == hash)
+            return;
+        parents.insert(cached.prevIndex);
+    }
+    if (!parents.count(prevIndex) && parents.size() >= MAX_CACHED_PARENTS && prevIndex != tipIndex) {
+        LogPrintf("%s: too many competing parents, discard from cache, block:%s\n", __func__, hash.ToString());
+        return;
+    }
+
+    auto front = blocks.empty() ? nullptr : blocks.front().block;
+    CCachedBlock cached;
+    cached.block = blk;
+    cached.hash = hash;
+    cached.prevIndex = prevIndex;
+    cached.nAcceptTime = prevIndex->nTime + DeadlineWait(blk->nDeadline, prevIndex->nBaseTarget, Params().GetConsensus());
+    cached.nCachedTime = GetTimeMicros();
+    cached.accept = func;
+    TRACE4(blockcache, add_block, hash.begin(), prevIndex->nHeight + 1, cached.nAcceptTime, blocks.size());
+    blocks.push_back(std::move(cached));
+    std::push_heap(blocks.begin(), blocks.end(), AcceptsLater);
+
+    if (blocks.size() > MAX_CACHED_BLOCKS) {
+        // Drop the block accepted last, it is the least likely to win.
+        auto worst = std::min_element(blocks.begin(), blocks.end(), AcceptsLater);
+        blocks.erase(worst);
+        std::make_heap(blocks.begin(), blocks.end(), AcceptsLater);
+    }
+
+    if (blocks.front().block != front)
+        SchedulePush(blocks.front());
+    if (scheduler && prevalidate)
+        scheduler->schedule(prevalidate);
+}
+
+bool CBlockCache::GetBestChild(const uint256& hashPrev, uint64_t& nDeadline, int64_t& nAcceptTime)
+{
+    LOCK(cs);
+    bool fFound = false;
+    for (const CCachedBlock& cached : blocks) {
+        if (cached.block->hashPrevBlock != hashPrev)
+            continue;
+        if (!fFound || cached.block->nDeadline < nDeadline) {
+            nDeadline = cached.block->nDeadline;
+            nAcceptTime = cached.nAcceptTime;
+            fFound = true;
+        }
+    }
+    return fFound;
+}
+
+std::shared_ptr<const CBlock> CBlockCache::GetBlock(const uint256& hash)
+{
+    LOCK(cs);
+    for (const CCachedBlock& cached : blocks) {
+        if (cached.hash == hash)
+            return cached.block;
+    }
+    return nullptr;
 }
 
 void CBlockCache::PushBlock()
 {
-    if (blocks.empty()) return;
-    auto block = blocks[0];
-    auto dl = block->nDeadline / prevIndex->nBaseTarget;
-    if (GetSystemTimeInSeconds() >= dl + prevIndex->nTime) { //accept best chain
-        //pop block
-        LogPrintf("%s: accpet active chain block, block:%s\n", __func__, block->GetHash().ToString());
-        handle();
-        blocks.clear();
+    std::function<bool()> accept;
+    {
+        LOCK(cs);
+        if (blocks.empty()) return;
+        const auto& front = blocks.front();
+        if (GetSystemTimeInSeconds() < front.nAcceptTime) {
+            SchedulePush(front);
+            return;
+        }
+        //accept best chain, pop block
+        LogPrintf("%s: accpet active chain block, block:%s\n", __func__, front.hash.ToString());
+        accept = front.accept;
+        static CMetricHistogram& dwell = GetMetrics().Histogram("blockcache_dwell", "Time blocks wait in the block cache until they are accepted");
+        dwell.Record(GetTimeMicros() - front.nCachedTime);
+        TRACE3(blockcache, push_block, front.hash.begin(), front.prevIndex->nHeight + 1, GetTimeMicros() - front.nCachedTime);
+        std::pop_heap(blocks.begin(), blocks.end(), AcceptsLater);
+        blocks.pop_back();
     }
+    // Activating the chain calls back into UpdateBestBlockIndex.
+    accept();
+
+    // The block may have lost or been invalid, the next candidate keeps its turn.
+    LOCK(cs);
+    if (!blocks.empty())
+        SchedulePush(blocks.front());
+}
+
+void CBlockCache::SetScheduler(CScheduler* s)
+{
+    LOCK(cs);
+    scheduler = s;
+    if (!blocks.empty())
+        SchedulePush(blocks.front());
+}
+
+void CBlockCache::SchedulePush(const CCachedBlock& cached)
+{
+    if (!scheduler)
+        return;
+    auto when = boost::chrono::system_clock::time_point(boost::chrono::seconds(cached.nAcceptTime));
+    auto block = cached.block;
+    // There is no unschedule, so a timer whose block was replaced or pushed does nothing.
+    scheduler->schedule([this, block] {
+        {
+            LOCK(cs);
+            if (blocks.empty() || blocks.front().block != block)
+                return;
+        }
+        PushBlock();
+    }, when, SchedulerLane::TIMING);
 }
 
-std::unique_ptr<CBlockCache> g_blockCache;
\ No newline at end of file
+std::unique_ptr<CBlockCache> g_blockCache;
@@ -6,26 +6,75 @@
 #define LAVA_BLOCKCACHE_H
 
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <functional>
 #include <vector>
 
 class CBlockIndex;
+class CScheduler;
+
+/** Most parents, the tip and its competitors at the same height, whose children are cached. */
+static const size_t MAX_CACHED_PARENTS = 3;
+/** Most blocks held in the cache, the ones accepted last are dropped first. */
+static const size_t MAX_CACHED_BLOCKS = 16;
+
+/** A block received before its deadline, held until it may be accepted. */
+struct CCachedBlock
+{
+    std::shared_ptr<const CBlock> block;
+    uint256 hash;
+    const CBlockIndex* prevIndex;
+    int64_t nAcceptTime;            //!< prevIndex->nTime plus the block's deadline in seconds
+    int64_t nCachedTime;            //!< when the block entered the cache, in microseconds
+    std::function<bool()> accept;
+};
 
 class CBlockCache {
 public:
     CBlockCache();
     ~CBlockCache() = default;
 
+    /** Drop the blocks that no longer build on the height of the new tip. */
     void UpdateBestBlockIndex(const CBlockIndex* index);
 
-    void AddBlock(const std::shared_ptr<const CBlock>& blk, std::function<bool()>const &func);
+    /** 
+     * Hold a block until its deadline.
+     * @param[in]   blk        the block, shared and not copied.
+     * @param[in]   prevIndex  the parent of blk, the tip or a competitor at the tip height.
+     * @param[in]   func       activates the chain once the deadline is reached.
+     * @param[in]   prevalidate  run on the scheduler right away if the block is held, so its
+     *                           validation meanwhile fills the signature and proof caches.
+     */
+    void AddBlock(const std::shared_ptr<const CBlock>& blk, const CBlockIndex* prevIndex, std::function<bool()>const &func,
+                  std::function<void()> const &prevalidate = nullptr);
 
     void PushBlock();
 
+    /**
+     * Find the best held child of a block, a competitor of the blocks forged on top of it.
+     * @param[in]   hashPrev     the parent.
+     * @param[out]  nDeadline    the deadline of the child.
+     * @param[out]  nAcceptTime  the time at which it is accepted.
+     * @return      false if no child of hashPrev is held.
+     */
+    bool GetBestChild(const uint256& hashPrev, uint64_t& nDeadline, int64_t& nAcceptTime);
+
+    /** Return the held block with this hash, or nullptr, so it is served without reading the disk. */
+    std::shared_ptr<const CBlock> GetBlock(const uint256& hash);
+
+    /** Push cached blocks from timers on this scheduler, armed for the deadline of the best cached block. */
+    void SetScheduler(CScheduler* scheduler);
+
 private:
-    std::vector<std::shared_ptr<CBlock> > blocks;
-    const CBlockIndex* prevIndex;
-    std::function<bool()> handle;
+    /** Arm a timer for the time at which `block` may be accepted. */
+    void SchedulePush(const CCachedBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    CCriticalSection cs;
+    /** Min-heap on nAcceptTime, the front is the next block to accept. */
+    std::vector<CCachedBlock> blocks GUARDED_BY(cs);
+    const CBlockIndex* tipIndex GUARDED_BY(cs);
+    CScheduler* scheduler GUARDED_BY(cs);
 };
 
 extern std::unique_ptr<CBlockCache> g_blockCache;
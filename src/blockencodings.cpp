@@ -16,15 +16,37 @@
 
 #include <unordered_map>
 
+/**
+ * Whether the second transaction of a block is the fstx of its forger, spending the firestone
+ * the coinbase commits to as <height> <firestone txid> <firestone n> OP_0. Peers keep fstx in
+ * their fspool rather than in the mempool, so they never have it.
+ */
+static bool HasFirestoneSpend(const CBlock& block)
+{
+    if (block.vtx.size() < 2 || block.vtx[0]->vin.empty() || block.vtx[1]->vin.empty())
+        return false;
+    const CScript& scriptSig = block.vtx[0]->vin[0].scriptSig;
+    const COutPoint& out = block.vtx[1]->vin[0].prevout;
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    if (!scriptSig.GetOp(pc, opcode))
+        return false;
+    return CScript(pc, scriptSig.end()) == (CScript() << ToByteVector(out.hash) << out.n << OP_0);
+}
+
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
-        nonce(GetRand(std::numeric_limits<uint64_t>::max())),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+        nonce(GetRand(std::numeric_limits<uint64_t>::max())), header(block) {
     FillShortTxIDSelector();
-    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
-    prefilledtxn[0] = {0, block.vtx[0]};
-    for (size_t i = 1; i < block.vtx.size(); i++) {
+    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase and the fstx
+    prefilledtxn.push_back({0, block.vtx[0]});
+    if (HasFirestoneSpend(block)) {
+        // Indexes are differentially encoded, the fstx directly follows the coinbase.
+        prefilledtxn.push_back({0, block.vtx[1]});
+    }
+    shorttxids.resize(block.vtx.size() - prefilledtxn.size());
+    for (size_t i = prefilledtxn.size(); i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
+        shorttxids[i - prefilledtxn.size()] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
     }
 }
 
@@ -40,8 +62,7 @@ void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const {
 }
 
 uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
-    static_assert(SHORTTXIDS_LENGTH == 6, "shorttxids calculation assumes 6-byte shorttxids");
-    return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
+    return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & SHORTTXID_MASK;
 }
 
 
@@ -106,8 +127,10 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     {
     LOCK(pool->cs);
     const std::vector<std::pair<uint256, CTxMemPool::txiter> >& vTxHashes = pool->vTxHashes;
+    // The mempool hashes itself once per key, with the multi-lane kernel, and keeps the hashes up to date.
+    const std::vector<uint64_t>& vSipHashes = pool->GetWitnessSipHashes(cmpctblock.shorttxidk0, cmpctblock.shorttxidk1);
     for (size_t i = 0; i < vTxHashes.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(vTxHashes[i].first);
+        uint64_t shortid = vSipHashes[i] & CBlockHeaderAndShortTxIDs::SHORTTXID_MASK;
         std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
         if (idit != shorttxids.end()) {
             if (!have_txn[idit->second]) {
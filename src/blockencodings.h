@@ -138,6 +138,9 @@ private:
     friend class PartiallyDownloadedBlock;
 
     static const int SHORTTXIDS_LENGTH = 6;
+    //! The bits of a SipHash kept in a short ID
+    static const uint64_t SHORTTXID_MASK = 0xffffffffffffULL;
+    static_assert(SHORTTXIDS_LENGTH == 6, "SHORTTXID_MASK assumes 6-byte shorttxids");
 protected:
     std::vector<uint64_t> shorttxids;
     std::vector<PrefilledTransaction> prefilledtxn;
@@ -0,0 +1,41 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::CMappedFile(const fs::path& path) : data(nullptr), size(0)
+{
+#ifndef WIN32
+    // A block file does not fit the address space of a 32-bit process many times over.
+    if (sizeof(void*) < 8)
+        return;
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(addr);
+            size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+#endif
+}
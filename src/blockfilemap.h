@@ -0,0 +1,103 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_BLOCKFILEMAP_H
+#define LAVA_BLOCKFILEMAP_H
+
+#include <fs.h>
+#include <span.h>
+#include <sync.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+/** The number of block files kept mapped. */
+static const size_t MAX_MAPPED_BLOCK_FILES = 16;
+
+/** A file mapped read-only into memory, unmapped with the last reference to it. */
+class CMappedFile
+{
+public:
+    /** Map the file at path. The mapping is null if that fails. */
+    explicit CMappedFile(const fs::path& path);
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    bool IsNull() const { return data == nullptr; }
+    Span<const uint8_t> Data() const { return Span<const uint8_t>(data, size); }
+
+private:
+    const uint8_t* data;
+    size_t size;
+};
+
+/**
+ * The block files most recently read from, opened as File, which is constructed from
+ * the path of the file and is null if that fails. Only files that are no longer
+ * written to may be opened: the file being appended to grows and is truncated when
+ * it is left, which would cut a mapping short.
+ */
+template <typename File>
+class CBlockFileCache
+{
+public:
+    explicit CBlockFileCache(size_t nMaxFilesIn) : nMaxFiles(nMaxFilesIn) {}
+
+    /** Block file nFile at path, or null if it cannot be opened. */
+    std::shared_ptr<const File> Get(int nFile, const fs::path& path)
+    {
+        LOCK(cs);
+        auto it = mapFiles.find(nFile);
+        if (it != mapFiles.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->second;
+        }
+        if (nMaxFiles == 0)
+            return nullptr;
+
+        std::shared_ptr<const File> file = std::make_shared<const File>(path);
+        if (file->IsNull())
+            return nullptr;
+        lru.emplace_front(nFile, file);
+        mapFiles.emplace(nFile, lru.begin());
+        if (lru.size() > nMaxFiles) {
+            mapFiles.erase(lru.back().first);
+            lru.pop_back();
+        }
+        return file;
+    }
+
+    /** Drop nFile, as its file is deleted. Readers holding it keep it until they are done. */
+    void Forget(int nFile)
+    {
+        LOCK(cs);
+        auto it = mapFiles.find(nFile);
+        if (it != mapFiles.end()) {
+            lru.erase(it->second);
+            mapFiles.erase(it);
+        }
+    }
+
+private:
+    typedef std::list<std::pair<int, std::shared_ptr<const File>>> FileList;
+
+    const size_t nMaxFiles;
+    CCriticalSection cs;
+    //! The open files, most recently used first
+    FileList lru GUARDED_BY(cs);
+    std::map<int, typename FileList::iterator> mapFiles GUARDED_BY(cs);
+};
+
+/**
+ * The block files most recently read from, mapped into memory, so blocks are read
+ * without opening and seeking a file each time. Mapping is not supported on Windows
+ * and 32-bit systems, where Get returns null and the caller reads the file instead.
+ */
+typedef CBlockFileCache<CMappedFile> CBlockFileMap;
+
+#endif // LAVA_BLOCKFILEMAP_H
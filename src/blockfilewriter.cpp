@@ -0,0 +1,154 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilewriter.h>
+
+#include <util/system.h>
+
+#include <errno.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/** Records handed to one writev call. */
+static const int MAX_WRITE_VECTORS = 64;
+
+#ifndef WIN32
+/** Write all of the count buffers of iov, resuming after short writes. */
+static bool WriteVectors(int fd, struct iovec* iov, int count)
+{
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+#endif
+
+bool CBlockFileWriter::Write(const PendingRun& run)
+{
+#ifndef WIN32
+    int fd = open(run.path.string().c_str(), O_WRONLY | O_CREAT, 0666);
+    if (fd < 0)
+        return error("%s: cannot open %s", __func__, run.path.string());
+    bool fOk = lseek(fd, run.nStart, SEEK_SET) == (off_t)run.nStart;
+    for (size_t i = 0; fOk && i < run.records.size(); ) {
+        struct iovec iov[MAX_WRITE_VECTORS];
+        int count = 0;
+        for (; i < run.records.size() && count < MAX_WRITE_VECTORS; i++, count++) {
+            iov[count].iov_base = const_cast<uint8_t*>(run.records[i].data());
+            iov[count].iov_len = run.records[i].size();
+        }
+        fOk = WriteVectors(fd, iov, count);
+    }
+    fOk &= close(fd) == 0;
+#else
+    FILE* file = fsbridge::fopen(run.path, "rb+");
+    if (!file)
+        file = fsbridge::fopen(run.path, "wb+");
+    if (!file)
+        return error("%s: cannot open %s", __func__, run.path.string());
+    bool fOk = fseek(file, run.nStart, SEEK_SET) == 0;
+    for (size_t i = 0; fOk && i < run.records.size(); i++) {
+        fOk = fwrite(run.records[i].data(), 1, run.records[i].size(), file) == run.records[i].size();
+    }
+    fOk &= fclose(file) == 0;
+#endif
+    if (!fOk)
+        return error("%s: cannot write %u bytes at %u of %s", __func__, run.nBytes, run.nStart, run.path.string());
+    return true;
+}
+
+bool CBlockFileWriter::Append(int nFile, const fs::path& path, unsigned int nPos, std::vector<uint8_t>&& record, bool fFlush)
+{
+    LOCK(cs);
+    auto it = pending.find(nFile);
+    if (it != pending.end() && it->second.nStart + it->second.nBytes != nPos) {
+        // Not right after the pending records, which are written first.
+        const bool fOk = Write(it->second);
+        nPendingBytes -= it->second.nBytes;
+        pending.erase(it);
+        if (!fOk)
+            return false;
+        it = pending.end();
+    }
+    if (it == pending.end()) {
+        it = pending.emplace(nFile, PendingRun()).first;
+        it->second.path = path;
+        it->second.nStart = nPos;
+        it->second.nBytes = 0;
+    }
+    it->second.nBytes += record.size();
+    nPendingBytes += record.size();
+    it->second.records.push_back(std::move(record));
+
+    if (!fFlush && nPendingBytes <= nMaxPending)
+        return true;
+    bool fOk = true;
+    for (const auto& entry : pending) {
+        fOk &= Write(entry.second);
+    }
+    pending.clear();
+    nPendingBytes = 0;
+    return fOk;
+}
+
+bool CBlockFileWriter::ReadPending(int nFile, unsigned int nPos, std::vector<uint8_t>& record) const
+{
+    LOCK(cs);
+    auto it = pending.find(nFile);
+    if (it == pending.end() || nPos < it->second.nStart)
+        return false;
+    unsigned int nRecordPos = it->second.nStart;
+    for (const std::vector<uint8_t>& data : it->second.records) {
+        if (nRecordPos == nPos) {
+            record = data;
+            return true;
+        }
+        if (nRecordPos > nPos)
+            break;
+        nRecordPos += data.size();
+    }
+    return false;
+}
+
+bool CBlockFileWriter::Flush(int nFile)
+{
+    LOCK(cs);
+    auto it = pending.find(nFile);
+    if (it == pending.end())
+        return true;
+    const bool fOk = Write(it->second);
+    nPendingBytes -= it->second.nBytes;
+    pending.erase(it);
+    return fOk;
+}
+
+bool CBlockFileWriter::Flush()
+{
+    LOCK(cs);
+    bool fOk = true;
+    for (const auto& entry : pending) {
+        fOk &= Write(entry.second);
+    }
+    pending.clear();
+    nPendingBytes = 0;
+    return fOk;
+}
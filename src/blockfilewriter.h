@@ -0,0 +1,63 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_BLOCKFILEWRITER_H
+#define LAVA_BLOCKFILEWRITER_H
+
+#include <fs.h>
+#include <sync.h>
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/** The bytes of block or undo records held in memory before they are written, during initial block download. */
+static const size_t MAX_PENDING_BLOCK_FILE_BYTES = 8 << 20;
+
+/**
+ * Appends the records of blocks or of their undo data to their files. While syncing, the
+ * records of several blocks are held in memory and written with one vectored write, rather
+ * than opening, seeking and writing the file for each block. The records of a file are
+ * appended in the order of their positions. Pending records are read from memory, and
+ * written before their file is opened to be read, flushed or left; the block index that
+ * refers to them is only written after the files are flushed.
+ */
+class CBlockFileWriter
+{
+public:
+    explicit CBlockFileWriter(size_t nMaxPendingIn) : nMaxPending(nMaxPendingIn) {}
+
+    /**
+     * Queue record to be written at nPos of file nFile at path. The pending records are
+     * written at once if fFlush is set or they exceed the limit.
+     */
+    bool Append(int nFile, const fs::path& path, unsigned int nPos, std::vector<uint8_t>&& record, bool fFlush);
+
+    /** Copy the pending record starting at nPos of file nFile into record, if there is one. */
+    bool ReadPending(int nFile, unsigned int nPos, std::vector<uint8_t>& record) const;
+
+    /** Write the records pending for file nFile. */
+    bool Flush(int nFile);
+
+    /** Write all pending records. */
+    bool Flush();
+
+private:
+    /** Records to be written one after the other, from nStart of a file on. */
+    struct PendingRun {
+        fs::path path;
+        unsigned int nStart;
+        size_t nBytes;
+        std::vector<std::vector<uint8_t>> records;
+    };
+
+    static bool Write(const PendingRun& run);
+
+    const size_t nMaxPending;
+    mutable Mutex cs;
+    std::map<int, PendingRun> pending GUARDED_BY(cs);
+    size_t nPendingBytes GUARDED_BY(cs) = 0;
+};
+
+#endif // LAVA_BLOCKFILEWRITER_H
@@ -3,11 +3,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <blockfilter.h>
+#include <crypto/common.h>
 #include <crypto/siphash.h>
 #include <hash.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
 #include <streams.h>
+#include <ticket.h>
+
+#include <algorithm>
+#include <map>
 
 /// SerType used to serialize parameters in GCS filter encoding.
 static constexpr int GCS_SER_TYPE = SER_NETWORK;
@@ -32,19 +37,73 @@ static void GolombRiceEncode(BitStreamWriter<OStream>& bitwriter, uint8_t P, uin
     bitwriter.Write(x, P);
 }
 
-template <typename IStream>
-static uint64_t GolombRiceDecode(BitStreamReader<IStream>& bitreader, uint8_t P)
+/**
+ * Reads the Golomb-Rice coded values of a filter. Rather than reading a bit at a time like
+ * BitStreamReader, it keeps up to 64 bits in a buffer, counts the whole run of 1's of a quotient
+ * with one count-leading-zeros and takes the remainder with one shift.
+ */
+class GolombRiceReader
 {
-    // Read unary-encoded quotient: q 1's followed by one 0.
-    uint64_t q = 0;
-    while (bitreader.Read(1) == 1) {
-        ++q;
+private:
+    const unsigned char* m_pos;
+    const unsigned char* const m_end;
+
+    /** Unread bits, most significant first. */
+    uint64_t m_buffer{0};
+
+    /** Number of unread bits in m_buffer. */
+    int m_count{0};
+
+    void Refill()
+    {
+        while (m_count <= 56 && m_pos != m_end) {
+            m_buffer |= static_cast<uint64_t>(*m_pos++) << (56 - m_count);
+            m_count += 8;
+        }
     }
 
-    uint64_t r = bitreader.Read(P);
+    void Consume(int nbits)
+    {
+        m_buffer = nbits < 64 ? m_buffer << nbits : 0;
+        m_count -= nbits;
+    }
 
-    return (q << P) + r;
-}
+public:
+    GolombRiceReader(const unsigned char* begin, const unsigned char* end) : m_pos(begin), m_end(end) {}
+
+    uint64_t Read(uint8_t P)
+    {
+        // Read unary-encoded quotient: q 1's followed by one 0.
+        uint64_t q = 0;
+        while (true) {
+            Refill();
+            if (m_count == 0) {
+                throw std::ios_base::failure("GolombRiceReader::Read(): end of data");
+            }
+            const int ones = std::min(64 - static_cast<int>(CountBits(~m_buffer)), m_count);
+            q += ones;
+            if (ones < m_count) {
+                Consume(ones + 1);
+                break;
+            }
+            Consume(ones);
+        }
+
+        // Read the remainder in P bits.
+        if (P == 0) return q;
+        Refill();
+        if (m_count < P) {
+            throw std::ios_base::failure("GolombRiceReader::Read(): end of data");
+        }
+        uint64_t r = m_buffer >> (64 - P);
+        Consume(P);
+
+        return (q << P) + r;
+    }
+
+    /** Whether whole bytes remain unread. */
+    bool HasExcess() const { return m_pos != m_end || m_count >= 8; }
+};
 
 // Map a value x that is uniformly distributed in the range [0, 2^64) to a
 // value uniformly distributed in [0, n) by returning the upper 64 bits of
@@ -87,10 +146,21 @@ uint64_t GCSFilter::HashToRange(const Element& element) const
 
 std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
 {
-    std::vector<uint64_t> hashed_elements;
-    hashed_elements.reserve(elements.size());
+    // Scripts are mostly of a few standard sizes; hash those of each size together, several lanes
+    // at a time.
+    std::map<size_t, std::vector<const unsigned char*>> elements_by_size;
     for (const Element& element : elements) {
-        hashed_elements.push_back(HashToRange(element));
+        elements_by_size[element.size()].push_back(element.data());
+    }
+
+    std::vector<uint64_t> hashed_elements(elements.size());
+    uint64_t* out = hashed_elements.data();
+    for (const auto& group : elements_by_size) {
+        SipHashMulti(m_params.m_siphash_k0, m_params.m_siphash_k1, group.second.data(), group.first, out, group.second.size());
+        out += group.second.size();
+    }
+    for (uint64_t& hash : hashed_elements) {
+        hash = MapIntoRange(hash, m_F);
     }
     std::sort(hashed_elements.begin(), hashed_elements.end());
     return hashed_elements;
@@ -114,11 +184,11 @@ GCSFilter::GCSFilter(const Params& params, std::vector<unsigned char> encoded_fi
 
     // Verify that the encoded filter contains exactly N elements. If it has too much or too little
     // data, a std::ios_base::failure exception will be raised.
-    BitStreamReader<VectorReader> bitreader(stream);
+    GolombRiceReader reader(m_encoded.data() + GetSizeOfCompactSize(m_N), m_encoded.data() + m_encoded.size());
     for (uint64_t i = 0; i < m_N; ++i) {
-        GolombRiceDecode(bitreader, m_params.m_P);
+        reader.Read(m_params.m_P);
     }
-    if (!stream.empty()) {
+    if (reader.HasExcess()) {
         throw std::ios_base::failure("encoded_filter contains excess data");
     }
 }
@@ -155,18 +225,13 @@ GCSFilter::GCSFilter(const Params& params, const ElementSet& elements)
 
 bool GCSFilter::MatchInternal(const uint64_t* element_hashes, size_t size) const
 {
-    VectorReader stream(GCS_SER_TYPE, GCS_SER_VERSION, m_encoded, 0);
-
     // Seek forward by size of N
-    uint64_t N = ReadCompactSize(stream);
-    assert(N == m_N);
-
-    BitStreamReader<VectorReader> bitreader(stream);
+    GolombRiceReader reader(m_encoded.data() + GetSizeOfCompactSize(m_N), m_encoded.data() + m_encoded.size());
 
     uint64_t value = 0;
     size_t hashes_index = 0;
     for (uint32_t i = 0; i < m_N; ++i) {
-        uint64_t delta = GolombRiceDecode(bitreader, m_params.m_P);
+        uint64_t delta = reader.Read(m_params.m_P);
         value += delta;
 
         while (true) {
@@ -197,6 +262,28 @@ bool GCSFilter::MatchAny(const ElementSet& elements) const
     return MatchInternal(queries.data(), queries.size());
 }
 
+static const std::map<BlockFilterType, std::string> g_filter_types = {
+    {BlockFilterType::BASIC, "basic"},
+};
+
+const std::string& BlockFilterTypeName(BlockFilterType filter_type)
+{
+    static std::string unknown_retval = "";
+    auto it = g_filter_types.find(filter_type);
+    return it != g_filter_types.end() ? it->second : unknown_retval;
+}
+
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filter_type)
+{
+    for (const auto& entry : g_filter_types) {
+        if (entry.second == name) {
+            filter_type = entry.first;
+            return true;
+        }
+    }
+    return false;
+}
+
 static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
                                                  const CBlockUndo& block_undo)
 {
@@ -208,6 +295,11 @@ static GCSFilter::ElementSet BasicFilterElements(const CBlock& block,
             if (script.empty() || script[0] == OP_RETURN) continue;
             elements.emplace(script.begin(), script.end());
         }
+        // A firestone pays to the hash of its redeem script, which is what its owner knows it by.
+        if (tx->IsTicketTx()) {
+            const CScript& script = tx->Ticket()->redeemScript;
+            if (!script.empty()) elements.emplace(script.begin(), script.end());
+        }
     }
 
     for (const CTxUndo& tx_undo : block_undo.vtxundo) {
@@ -0,0 +1,62 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockio.h>
+
+#include <util/system.h>
+
+std::unique_ptr<CBlockIOQueue> g_block_io;
+
+CBlockIOQueue::CBlockIOQueue(int nThreads)
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()>>, "blockio", std::bind(&CBlockIOQueue::ThreadRead, this));
+    }
+}
+
+CBlockIOQueue::~CBlockIOQueue()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        queue.clear();
+    }
+    cond.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void CBlockIOQueue::Enqueue(std::vector<std::function<void()>>&& jobs)
+{
+    if (jobs.empty())
+        return;
+    {
+        LOCK(cs);
+        for (auto& job : jobs) {
+            queue.push_back(std::move(job));
+        }
+    }
+    if (jobs.size() == 1) {
+        cond.notify_one();
+    } else {
+        cond.notify_all();
+    }
+}
+
+void CBlockIOQueue::ThreadRead()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait(lock, [this] { return fStop || !queue.empty(); });
+            if (fStop)
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+    }
+}
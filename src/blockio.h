@@ -0,0 +1,69 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_BLOCKIO_H
+#define LAVA_BLOCKIO_H
+
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/** Default for -blockiothreads, the threads reading blocks and undo data in the background */
+static const int DEFAULT_BLOCK_IO_THREADS = 2;
+/** Maximum number of threads reading blocks in the background */
+static const int MAX_BLOCK_IO_THREADS = 16;
+
+/**
+ * A few threads the reads of block and undo records are handed to, so the validation and
+ * message handler threads go on with the block at hand while the next ones are read. The
+ * reads of one submission are queued at once, under one lock, and started in their order.
+ * Reads still queued when the queue is destroyed are dropped: their futures are broken.
+ */
+class CBlockIOQueue
+{
+public:
+    explicit CBlockIOQueue(int nThreads);
+    ~CBlockIOQueue();
+
+    CBlockIOQueue(const CBlockIOQueue&) = delete;
+    CBlockIOQueue& operator=(const CBlockIOQueue&) = delete;
+
+    /** Queue the reads, to be started in the order given. */
+    template <typename R>
+    std::vector<std::future<R>> Submit(std::vector<std::function<R()>>&& reads)
+    {
+        std::vector<std::future<R>> futures;
+        std::vector<std::function<void()>> jobs;
+        futures.reserve(reads.size());
+        jobs.reserve(reads.size());
+        for (auto& read : reads) {
+            auto task = std::make_shared<std::packaged_task<R()>>(std::move(read));
+            futures.push_back(task->get_future());
+            jobs.emplace_back([task] { (*task)(); });
+        }
+        Enqueue(std::move(jobs));
+        return futures;
+    }
+
+private:
+    void Enqueue(std::vector<std::function<void()>>&& jobs);
+    void ThreadRead();
+
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> queue GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs) = false;
+    std::vector<std::thread> threads;
+};
+
+/** The block I/O threads; without them, reads are done by the thread waiting for them. */
+extern std::unique_ptr<CBlockIOQueue> g_block_io;
+
+#endif // LAVA_BLOCKIO_H
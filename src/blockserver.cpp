@@ -0,0 +1,97 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockserver.h>
+
+#include <metrics.h>
+#include <util/system.h>
+#include <util/time.h>
+
+std::unique_ptr<CBlockServer> g_block_server;
+
+CBlockServer::CBlockServer(int nThreads, std::function<void()> fnDoneIn) : fnDone(std::move(fnDoneIn))
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()>>, "blockserve", std::bind(&CBlockServer::ThreadServe, this));
+    }
+}
+
+CBlockServer::~CBlockServer()
+{
+    Stop();
+}
+
+void CBlockServer::Stop()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        queues.clear();
+        ready.clear();
+    }
+    cond.notify_all();
+    for (std::thread& thread : threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void CBlockServer::Submit(NodeId id, std::function<void()> job)
+{
+    {
+        LOCK(cs);
+        if (fStop)
+            return;
+        std::deque<std::function<void()>>& queue = queues[id];
+        queue.push_back(std::move(job));
+        if (queue.size() > 1 || running.count(id))
+            return;
+        ready.push_back(id);
+    }
+    cond.notify_one();
+}
+
+bool CBlockServer::IsBusy(NodeId id)
+{
+    LOCK(cs);
+    return queues.count(id) || running.count(id);
+}
+
+void CBlockServer::ThreadServe()
+{
+    static CMetricHistogram& metricServe = GetMetrics().Histogram("blockserve_job_us", "Time to read a block from disk and send it, or the transactions asked from it, to a peer, in microseconds");
+
+    while (true) {
+        NodeId id;
+        std::function<void()> job;
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait(lock, [this] { return fStop || !ready.empty(); });
+            if (fStop)
+                return;
+            id = ready.front();
+            ready.pop_front();
+            auto it = queues.find(id);
+            job = std::move(it->second.front());
+            it->second.pop_front();
+            if (it->second.empty())
+                queues.erase(it);
+            running.insert(id);
+        }
+        const int64_t nStart = GetTimeMicros();
+        job();
+        metricServe.Record(GetTimeMicros() - nStart);
+        {
+            LOCK(cs);
+            running.erase(id);
+            // The peer goes to the back of the line for its next job.
+            if (queues.count(id)) {
+                ready.push_back(id);
+                cond.notify_one();
+            }
+        }
+        if (fnDone)
+            fnDone();
+    }
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_BLOCKSERVER_H
+#define LAVA_BLOCKSERVER_H
+
+#include <net.h>
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+/** Default for -blockservethreads, the threads serving blocks read from disk to peers */
+static const int DEFAULT_BLOCK_SERVE_THREADS = 2;
+/** Maximum number of threads serving blocks to peers */
+static const int MAX_BLOCK_SERVE_THREADS = 16;
+
+/**
+ * A few threads serving the blocks peers ask for that are not in memory: they are read
+ * from disk and sent without cs_main, so a peer syncing from us never holds up the message
+ * handler, and with it the relay of new blocks. Every peer has a queue of its own. The
+ * peers with jobs take turns, a job at a time, and the jobs of one peer run one after the
+ * other, in order. Jobs still queued when the server is destroyed are dropped.
+ */
+class CBlockServer
+{
+public:
+    /** fnDone is called after each job, once its peer is no longer busy with it. */
+    CBlockServer(int nThreads, std::function<void()> fnDoneIn);
+    ~CBlockServer();
+
+    CBlockServer(const CBlockServer&) = delete;
+    CBlockServer& operator=(const CBlockServer&) = delete;
+
+    /** Finish the running jobs and drop the queued ones, and those submitted later. */
+    void Stop();
+
+    /** Queue a job serving peer id, after the ones already queued for it. */
+    void Submit(NodeId id, std::function<void()> job);
+
+    /** Whether a job of peer id is queued or running. */
+    bool IsBusy(NodeId id);
+
+private:
+    void ThreadServe();
+
+    const std::function<void()> fnDone;
+    Mutex cs;
+    std::condition_variable cond;
+    std::map<NodeId, std::deque<std::function<void()>>> queues GUARDED_BY(cs);
+    //! Peers with jobs queued and none running, in the order they take their turns
+    std::deque<NodeId> ready GUARDED_BY(cs);
+    std::set<NodeId> running GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs) = false;
+    std::vector<std::thread> threads;
+};
+
+/** The block serving threads; without them, blocks are served by the message handler. */
+extern std::unique_ptr<CBlockServer> g_block_server;
+
+#endif // LAVA_BLOCKSERVER_H
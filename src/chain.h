@@ -12,6 +12,7 @@
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <memory>
 #include <vector>
 
 /**
@@ -170,6 +171,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_POC_VALID          =   256, //!< proof of capacity verified at the height of the block
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -180,8 +183,9 @@ enum BlockStatus: uint32_t {
 class CBlockIndex
 {
 public:
-    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
-    const uint256* phashBlock;
+    // The fields read while walking back through the chain (GetAncestor, GetMedianTimePast,
+    // the base target retargeting) come first, so such a walk reads one or two cache lines
+    // of each entry. The header fields only needed to rebuild the header come last.
 
     //! pointer to the index of the predecessor of this block
     CBlockIndex* pprev;
@@ -189,9 +193,35 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip;
 
+    //! block header poc
+    uint64_t nBaseTarget;
+
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
+    //! block header
+    uint32_t nTime;
+
+    //! Verification status of this block. See enum BlockStatus
+    uint32_t nStatus;
+
+    //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
+    int32_t nSequenceId;
+
+    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
+    const uint256* phashBlock;
+
+    //! (memory only) Maximum nTime in the chain up to and including this block.
+    unsigned int nTimeMax;
+
+    //! (memory only) Number of transactions in the chain up to and including this block.
+    //! This value will be non-zero only if and only if transactions for this block and all its parents are available.
+    //! Change to 64-bit type when necessary; won't happen before 2030
+    unsigned int nChainTx;
+
+    //! (memory only) Total amount of work (expected number of hashes) in the chain up to and including this block
+    arith_uint256 nCumulativeDiff;
+
     //! Which # file this block is stored in (blk?????.dat)
     int nFile;
 
@@ -201,40 +231,21 @@ public:
     //! Byte offset within rev?????.dat where this block's undo data is stored
     unsigned int nUndoPos;
 
-    //! (memory only) Total amount of work (expected number of hashes) in the chain up to and including this block
-    arith_uint256 nCumulativeDiff;
-
     //! Number of transactions in this block.
     //! Note: in a potential headers-first mode, this number cannot be relied upon
     unsigned int nTx;
 
-    //! (memory only) Number of transactions in the chain up to and including this block.
-    //! This value will be non-zero only if and only if transactions for this block and all its parents are available.
-    //! Change to 64-bit type when necessary; won't happen before 2030
-    unsigned int nChainTx;
-
-    //! Verification status of this block. See enum BlockStatus
-    uint32_t nStatus;
-
     //! block header
     int32_t nVersion;
     uint256 hashMerkleRoot;
-    uint32_t nTime;
-    uint64_t nNonce;
 
-    //! block header poc
+    //! block header poc, nPublicKeyID follows nVersion so the two fill 8-byte slots without padding
+    uint160  nPublicKeyID;
     uint256 genSign;
+    uint64_t nNonce;
     uint64_t nPlotID;
-    uint160  nPublicKeyID;
-    uint64_t nBaseTarget;
     uint64_t nDeadline;
 
-    //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
-    int32_t nSequenceId;
-
-    //! (memory only) Maximum nTime in the chain up to and including this block.
-    unsigned int nTimeMax;
-
     void SetNull()
     {
         phashBlock = nullptr;
@@ -399,6 +410,52 @@ public:
     const CBlockIndex* GetAncestor(int height) const;
 };
 
+/**
+ * Storage of the block index entries. They are allocated a chunk at a time instead of
+ * one by one, as nearly every header accepted stays in memory until the index is unloaded.
+ * The few entries freed before are reused for the next ones.
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t CHUNK_SIZE = 4096;
+
+    std::vector<std::unique_ptr<CBlockIndex[]>> chunks;
+    size_t nUsed = CHUNK_SIZE;
+    std::vector<CBlockIndex*> vFree;
+
+public:
+    //! Return a new, null entry. It stays valid until Free or Clear.
+    CBlockIndex* New()
+    {
+        if (!vFree.empty()) {
+            CBlockIndex* pindex = vFree.back();
+            vFree.pop_back();
+            *pindex = CBlockIndex();
+            return pindex;
+        }
+        if (nUsed == CHUNK_SIZE) {
+            chunks.emplace_back(new CBlockIndex[CHUNK_SIZE]);
+            nUsed = 0;
+        }
+        return &chunks.back()[nUsed++];
+    }
+
+    //! Free one entry, no longer referenced anywhere.
+    void Free(CBlockIndex* pindex)
+    {
+        vFree.push_back(pindex);
+    }
+
+    //! Free every entry at once.
+    void Clear()
+    {
+        chunks.clear();
+        vFree.clear();
+        nUsed = CHUNK_SIZE;
+    }
+};
+
 arith_uint256 GetBlockProof(const CBlockIndex& block);
 /** Return the time it would take to redo the work difference between from and to, assuming the current hashrate corresponds to the difficulty at tip, in seconds. */
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params&);
@@ -439,20 +496,40 @@ public:
             READWRITE(VARINT(nUndoPos));
 
         // block header
-        READWRITE(this->nVersion);
-        READWRITE(hashPrev);
-        READWRITE(hashMerkleRoot);
-        READWRITE(nTime);
-        READWRITE(nNonce);
-        READWRITE(genSign);
-        READWRITE(nDeadline);
-        READWRITE(nPlotID);
-        
-        if (nPlotID == 0 && !hashPrev.IsNull()){
-            // POC21
-            READWRITE(nPublicKeyID);
+        SerializationOpHeader(s, ser_action);
+    }
+
+    //! Serialized size of the header fields up to nPlotID, which tell whether nPublicKeyID follows
+    static constexpr size_t HEADER_PREFIX_SIZE = 4 + 32 + 32 + 4 + 8 + 32 + 8 + 8;
+
+    template <typename Stream>
+    void SerializationOpHeader(Stream& s, CSerActionSerialize) const
+    {
+        unsigned char buf[CBlockHeader::MAX_SERIALIZED_SIZE];
+        CHeaderFieldWriter w(buf);
+        w << nVersion << hashPrev << hashMerkleRoot << nTime << nNonce << genSign << nDeadline << nPlotID;
+        if (CBlockHeader::HasPublicKeyID(nPlotID, hashPrev)) {
+            w << nPublicKeyID;
+        }
+        w << nBaseTarget;
+        s.write((const char*)buf, w.end() - buf);
+    }
+
+    template <typename Stream>
+    void SerializationOpHeader(Stream& s, CSerActionUnserialize)
+    {
+        unsigned char buf[CBlockHeader::MAX_SERIALIZED_SIZE];
+        s.read((char*)buf, HEADER_PREFIX_SIZE);
+        CHeaderFieldReader r(buf);
+        r >> nVersion >> hashPrev >> hashMerkleRoot >> nTime >> nNonce >> genSign >> nDeadline >> nPlotID;
+        const bool fPublicKeyID = CBlockHeader::HasPublicKeyID(nPlotID, hashPrev);
+        s.read((char*)buf + HEADER_PREFIX_SIZE, (fPublicKeyID ? 20 : 0) + 8);
+        if (fPublicKeyID) {
+            r >> nPublicKeyID;
+        } else {
+            nPublicKeyID.SetNull();
         }
-        READWRITE(nBaseTarget);
+        r >> nBaseTarget;
     }
 
     uint256 GetBlockHash() const
@@ -91,6 +91,11 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nStartTime = Consensus::BIP9Deployment::ALWAYS_ACTIVE;
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout = Consensus::BIP9Deployment::NO_TIMEOUT;
 
+        // Deployment of Schnorr signatures
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].bit = 3;
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].nStartTime = 1798761600; // January 1, 2027
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].nTimeout = 1830297600; // January 1, 2028
+
         // The best chain should have at least this much work.
         // TODO: better cumulative diff?
         // minimumCumulativeDiff = initialCumulativeDiff + 1
@@ -99,7 +104,11 @@ public:
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x0000000000000000000f1c54590ee18d15ec70e68c8cd4cfbadb1b4f11697eee"); //563378
 
+        // By default assume that the proofs of capacity in ancestors of this block are valid.
+        consensus.defaultAssumePoC = uint256S("0x654dea39d44928feb1b9256ffc547330c9fd64e2f84e4ab996b77695ca790d0f"); //129000
+
         consensus.nActionFee = 16 * COIN;
+        consensus.fFastPoC = false;
         /**
          * The message start string is designed to be unlikely to occur in normal data.
          * The characters are rarely used upper ASCII, not valid as UTF-8, and produce
@@ -226,12 +235,20 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nStartTime = Consensus::BIP9Deployment::ALWAYS_ACTIVE;
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout = Consensus::BIP9Deployment::NO_TIMEOUT;
 
+        // Deployment of Schnorr signatures
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].bit = 3;
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].nStartTime = 1798761600; // January 1, 2027
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].nTimeout = 1830297600; // January 1, 2028
+
         // The best chain should have at least this much work.
         consensus.nMinimumCumulativeDiff = uint256S("0x000000000000000000000000000000000000000000000001000000004b000000");
 
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x0000000000000037a8cd3e06cd5edbfe9dd1dbcc5dacab279376ef7cfc2b4c75"); //1354312
 
+        // By default assume that the proofs of capacity in ancestors of this block are valid.
+        consensus.defaultAssumePoC = uint256S("0xc5425517b7c9dd1b1002a6604ef9eca9e222601a4dff2f4f9b9bfdb32729ab99"); //13333
+
         pchMessageStart[0] = 0x07;
         pchMessageStart[1] = 0x09;
         pchMessageStart[2] = 0x11;
@@ -277,6 +294,7 @@ public:
         fRequireStandard = false;
         fMineBlocksOnDemand = false;
         consensus.nActionFee = 16 * COIN;
+        consensus.fFastPoC = false;
 
         checkpointData = {
             {
@@ -327,6 +345,9 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].bit = 1;
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nStartTime = Consensus::BIP9Deployment::ALWAYS_ACTIVE;
         consensus.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout = Consensus::BIP9Deployment::NO_TIMEOUT;
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].bit = 3;
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].nStartTime = 0;
+        consensus.vDeployments[Consensus::DEPLOYMENT_SCHNORR].nTimeout = Consensus::BIP9Deployment::NO_TIMEOUT;
 
         // The best chain should have at least this much work.
         consensus.nMinimumCumulativeDiff = uint256S("0x00");
@@ -334,7 +355,11 @@ public:
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x00");
 
+        // By default assume that the proofs of capacity in ancestors of this block are valid.
+        consensus.defaultAssumePoC = uint256S("0x00");
+
         consensus.nActionFee = 16 * COIN;
+        consensus.fFastPoC = args.GetBoolArg("-fastpoc", false);
 
         pchMessageStart[0] = 0xfa;
         pchMessageStart[1] = 0xbf;
@@ -11,6 +11,7 @@
 #include <primitives/block.h>
 #include <protocol.h>
 
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -88,7 +89,8 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
-    uint64_t TargetDeadline() const { return 60 * 60 * 24; }
+    /** Largest deadline of a block in seconds, unbounded on fast PoC test chains. */
+    uint64_t TargetDeadline() const { return consensus.fFastPoC ? std::numeric_limits<uint64_t>::max() : 60 * 60 * 24; }
     uint32_t SlotLength() const { return nSlotLength; }
 protected:
     CChainParams() {}
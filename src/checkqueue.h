@@ -8,6 +8,7 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <stdint.h>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,6 +26,11 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * A type T may also provide an unsigned int GetCost() const, estimating
+  * its work relative to other checks; the workers then share the queued
+  * cost rather than the number of checks, so expensive checks do not end
+  * up in one batch. Checks without it cost 1.
   */
 template <typename T>
 class CCheckQueue
@@ -62,6 +68,14 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! The total cost of the queued elements.
+    uint64_t nQueueCost;
+
+    template <typename U>
+    static auto GetCheckCost(const U& check, int) -> decltype(check.GetCost(), 0U) { return std::max(1U, check.GetCost()); }
+    template <typename U>
+    static unsigned int GetCheckCost(const U& check, long) { return 1; }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
@@ -103,15 +117,22 @@ private:
                 // * Do not try to do everything at once, but aim for increasingly smaller batches so
                 //   all workers finish approximately simultaneously.
                 // * Try to account for idle jobs which will instantly start helping.
+                // * Share the cost of the queued work rather than its number of elements, so a batch
+                //   holding an expensive element stops short.
                 // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
+                const uint64_t nShare = std::max<uint64_t>(1, nQueueCost / (nTotal + nIdle + 1));
+                uint64_t nBatchCost = 0;
+                nNow = 0;
+                while (!queue.empty() && (nNow == 0 || (nNow < nBatchSize && nBatchCost < nShare))) {
+                    nBatchCost += GetCheckCost(queue.back(), 0);
                     // We want the lock on the mutex to be as short as possible, so swap jobs from the global
                     // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
+                    vChecks.emplace_back();
+                    vChecks.back().swap(queue.back());
                     queue.pop_back();
+                    nNow++;
                 }
+                nQueueCost -= nBatchCost;
                 // Check whether we need to do work at all
                 fOk = fAllOk;
             }
@@ -128,7 +149,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn), nQueueCost(0) {}
 
     //! Worker thread
     void Thread()
@@ -147,6 +168,7 @@ public:
     {
         boost::unique_lock<boost::mutex> lock(mutex);
         for (T& check : vChecks) {
+            nQueueCost += GetCheckCost(check, 0);
             queue.push_back(T());
             check.swap(queue.back());
         }
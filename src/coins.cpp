@@ -56,6 +56,8 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
 }
 
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    if (readThrough && !cacheCoins.count(outpoint))
+        return readThrough->GetCoin(outpoint, coin);
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it != cacheCoins.end()) {
         coin = it->second.coin;
@@ -115,6 +117,11 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
 static const Coin coinEmpty;
 
 const Coin& CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
+    if (readThrough) {
+        // The entries of an unordered map stay put, the reference outlives later fetches of the parent.
+        CCoinsMap::const_iterator it = cacheCoins.find(outpoint);
+        return it == cacheCoins.end() ? readThrough->AccessCoin(outpoint) : it->second.coin;
+    }
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it == cacheCoins.end()) {
         return coinEmpty;
@@ -124,6 +131,10 @@ const Coin& CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
 }
 
 bool CCoinsViewCache::HaveCoin(const COutPoint &outpoint) const {
+    if (readThrough) {
+        CCoinsMap::const_iterator it = cacheCoins.find(outpoint);
+        return it == cacheCoins.end() ? readThrough->HaveCoin(outpoint) : !it->second.coin.IsSpent();
+    }
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
@@ -204,10 +215,28 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+void CCoinsViewCache::ReallocateCache()
+{
+    // The map may have been moved to a writeback thread, which frees its nodes into the
+    // old pool; the empty map left here frees nothing, and the new one draws from a new
+    // pool. The hasher is not assignable, so the map is constructed in place.
+    assert(cacheCoins.empty());
+    cacheCoins.~CCoinsMap();
+    ::new (&cacheCoins) CCoinsMap();
+}
+
+void CCoinsViewOverlay::Reset()
+{
+    cacheCoins.clear();
+    cachedCoinsUsage = 0;
+    hashBlock.SetNull();
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -221,6 +250,15 @@ unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
 
+void CCoinsViewCache::GetCachedOutPoints(std::vector<COutPoint>& outpoints, size_t nMax) const {
+    for (const auto& entry : cacheCoins) {
+        if (outpoints.size() >= nMax)
+            return;
+        if (!entry.second.coin.IsSpent())
+            outpoints.push_back(entry.first);
+    }
+}
+
 CAmount CCoinsViewCache::GetValueIn(const CTransaction& tx) const
 {
     if (tx.IsCoinBase())
@@ -12,6 +12,7 @@
 #include <crypto/siphash.h>
 #include <memusage.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 
 #include <assert.h>
@@ -22,6 +23,9 @@
 /**
  * A UTXO entry.
  *
+ * The range and surjection proofs of the output are not kept: they are checked with the
+ * transaction creating it and not written to the database, but would dominate the cache.
+ *
  * Serialized format:
  * - VARINT((coinbase ? 1 : 0) | (height << 1))
  * - the non-spent CTxOut (via CTxOutCompressor)
@@ -39,8 +43,11 @@ public:
     uint32_t nHeight : 31;
 
     //! construct a Coin from a CTxOut and height/coinbase information.
-    Coin(CTxOut&& outIn, int nHeightIn, bool fCoinBaseIn) : out(std::move(outIn)), fCoinBase(fCoinBaseIn), nHeight(nHeightIn) {}
-    Coin(const CTxOut& outIn, int nHeightIn, bool fCoinBaseIn) : out(outIn), fCoinBase(fCoinBaseIn),nHeight(nHeightIn) {}
+    Coin(CTxOut&& outIn, int nHeightIn, bool fCoinBaseIn) : out(std::move(outIn)), fCoinBase(fCoinBaseIn), nHeight(nHeightIn) {
+        std::vector<unsigned char>().swap(out.vchSurjectionproof);
+        std::vector<unsigned char>().swap(out.vchRangeproof);
+    }
+    Coin(const CTxOut& outIn, int nHeightIn, bool fCoinBaseIn) : out(outIn.WithoutProofs()), fCoinBase(fCoinBaseIn),nHeight(nHeightIn) {}
 
     void Clear() {
         out.SetNull();
@@ -95,6 +102,7 @@ public:
     }
 
     size_t DynamicMemoryUsage() const {
+        // The commitments are stored inline and the proofs are not kept.
         return memusage::DynamicUsage(out.scriptPubKey);
     }
 };
@@ -137,7 +145,16 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The nodes of a CCoinsMap are allocated from a pool of its own (see PoolResource), so
+ * they are packed in large chunks without a malloc header each, and the whole map is
+ * given back to the heap a chunk at a time when it is destroyed.
+ */
+typedef PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                      sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>
+    CCoinsMapAllocator;
+
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -229,6 +246,15 @@ protected:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /**
+     * Set by CCoinsViewOverlay: the cache below, whose coins are read in place rather than
+     * copied into cacheCoins until they are spent.
+     */
+    const CCoinsViewCache* readThrough = nullptr;
+
+    /** Replace the emptied cacheCoins with a new map on a pool of its own, releasing the old pool. */
+    void ReallocateCache();
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -298,6 +324,9 @@ public:
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
+    //! Append the outpoints of the unspent coins in the cache, until outpoints holds nMax of them.
+    void GetCachedOutPoints(std::vector<COutPoint>& outpoints, size_t nMax) const;
+
     /**
      * Amount of bitcoins coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
@@ -315,6 +344,24 @@ private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
 };
 
+/**
+ * A copy-on-write view on top of another cache, for checks that are thrown away, such as
+ * TestBlockValidity. The coins it reads but does not modify are returned from the parent
+ * cache by reference. Only the coins it adds or spends are held, so a check copies the
+ * coins it spends, not every coin it reads. Reset() drops its changes and keeps the pool
+ * of its map, so one overlay serves repeated checks.
+ */
+class CCoinsViewOverlay final : public CCoinsViewCache
+{
+public:
+    explicit CCoinsViewOverlay(CCoinsViewCache* parentIn) : CCoinsViewCache(parentIn) { readThrough = parentIn; }
+
+    const CCoinsViewCache* Parent() const { return readThrough; }
+
+    /** Forget the changes, as if built anew on the parent. */
+    void Reset();
+};
+
 //! Utility function to add all of a transaction's outputs to a cache.
 //! When check is false, this assumes that overwrites are only possible for coinbase transactions.
 //! When check is true, the underlying view may be queried to determine whether an addition is
@@ -6,6 +6,8 @@
 
 namespace {
 static secp256k1_context *secp256k1_ctx_verify_amounts;
+// Generators of the Bulletproofs over one 64-bit value.
+static secp256k1_bulletproof_generators *secp256k1_bulletproof_gens;
 
 class CSecp256k1Init {
 public:
@@ -13,9 +15,13 @@ public:
         assert(secp256k1_ctx_verify_amounts == NULL);
         secp256k1_ctx_verify_amounts = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY | SECP256K1_CONTEXT_SIGN);
         assert(secp256k1_ctx_verify_amounts != NULL);
+        secp256k1_bulletproof_gens = secp256k1_bulletproof_generators_create(secp256k1_ctx_verify_amounts, &secp256k1_generator_const_g, 2 * 64);
+        assert(secp256k1_bulletproof_gens != NULL);
     }
     ~CSecp256k1Init() {
         assert(secp256k1_ctx_verify_amounts != NULL);
+        secp256k1_bulletproof_generators_destroy(secp256k1_ctx_verify_amounts, secp256k1_bulletproof_gens);
+        secp256k1_bulletproof_gens = NULL;
         secp256k1_context_destroy(secp256k1_ctx_verify_amounts);
         secp256k1_ctx_verify_amounts = NULL;
     }
@@ -40,6 +46,22 @@ bool CRangeCheck::operator()() {
     return true;
 };
 
+void CBulletproofCheck::Add(const std::vector<unsigned char>& rangeproof, const CCommitmentData& valueCommitment, const secp256k1_generator& gen, const CScript& scriptPubKey) {
+    rangeproofs.push_back(&rangeproof);
+    valueCommitments.push_back(valueCommitment);
+    generators.push_back(gen);
+    scriptPubKeys.push_back(scriptPubKey);
+}
+
+bool CBulletproofCheck::operator()() {
+    if (!CachingRangeProofChecker(store).VerifyBulletproofs(rangeproofs, valueCommitments, generators, scriptPubKeys, secp256k1_ctx_verify_amounts, secp256k1_bulletproof_gens)) {
+        error = SCRIPT_ERR_RANGEPROOF;
+        return false;
+    }
+
+    return true;
+}
+
 bool CBalanceCheck::operator()() {
     if (!secp256k1_pedersen_verify_tally(secp256k1_ctx_verify_amounts, vpCommitsIn.data(), vpCommitsIn.size(), vpCommitsOut.data(), vpCommitsOut.size())) {
         error = SCRIPT_ERR_PEDERSEN_TALLY;
@@ -50,7 +72,12 @@ bool CBalanceCheck::operator()() {
 }
 
 bool CSurjectionCheck::operator()() {
-    return CachingSurjectionProofChecker(store).VerifySurjectionProof(proof, vTags, gen, secp256k1_ctx_verify_amounts, wtxid);
+    for (size_t i = 0; i < vProofs.size(); i++) {
+        if (!CachingSurjectionProofChecker(store).VerifySurjectionProof(*vProofs[i], vTags, vGens[i], secp256k1_ctx_verify_amounts, wtxid)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 // Destroys the check in the case of no queue, or passes its ownership to the queue.
@@ -75,8 +102,8 @@ static bool VerifyIssuanceAmount(secp256k1_pedersen_commitment& value_commit, se
     memset(explicit_blinds, 0, sizeof(explicit_blinds));
     int ret;
 
-    ret = secp256k1_generator_generate(secp256k1_ctx_verify_amounts, &asset_gen, asset.begin());
-    assert(ret == 1);
+    const std::shared_ptr<const secp256k1_generator_table> table = GetAssetGeneratorTable(asset);
+    secp256k1_generator_table_generator(secp256k1_ctx_verify_amounts, &asset_gen, table.get());
 
     // Build value commitment
     if (value.IsExplicit()) {
@@ -88,12 +115,13 @@ static bool VerifyIssuanceAmount(secp256k1_pedersen_commitment& value_commit, se
         }
 
 
-        ret = secp256k1_pedersen_commit(secp256k1_ctx_verify_amounts, &value_commit, explicit_blinds, value.GetAmount(), &asset_gen, &secp256k1_generator_const_g);
-        // The explicit_blinds are all 0, and the amount is not 0. So secp256k1_pedersen_commit does not fail.
+        ret = secp256k1_pedersen_commit_table(secp256k1_ctx_verify_amounts, &value_commit, explicit_blinds, value.GetAmount(), table.get(), NULL);
+        // The explicit_blinds are all 0, and the amount is not 0. So secp256k1_pedersen_commit_table does not fail.
         assert(ret == 1);
     } else if (value.IsCommitment()) {
         // Verify range proof
-        std::vector<unsigned char> vchAssetCommitment(CConfidentialAsset::nExplicitSize);
+        CCommitmentData vchAssetCommitment;
+        vchAssetCommitment.resize(CConfidentialAsset::nExplicitSize);
         secp256k1_generator_serialize(secp256k1_ctx_verify_amounts, vchAssetCommitment.data(), &asset_gen);
         if (QueueCheck(checks, new CRangeCheck(&value, rangeproof, vchAssetCommitment, CScript(), store_result)) != SCRIPT_ERR_OK) {
             return false;
@@ -109,7 +137,7 @@ static bool VerifyIssuanceAmount(secp256k1_pedersen_commitment& value_commit, se
     return true;
 }
 
-bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, std::vector<CCheck*>* checks, const bool store_result) {
+bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, std::vector<CCheck*>* checks, const bool store_result, const bool fBulletproofs) {
     assert(!tx.IsCoinBase());
     assert(inputs.size() == tx.vin.size());
 
@@ -141,9 +169,11 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
         if (val.IsNull() || asset.IsNull())
             return false;
 
+        // The generators of explicit assets come with their tables, which commit to explicit values.
+        std::shared_ptr<const secp256k1_generator_table> table;
         if (asset.IsExplicit()) {
-            ret = secp256k1_generator_generate(secp256k1_ctx_verify_amounts, &gen, asset.GetAsset().begin());
-            assert(ret != 0);
+            table = GetAssetGeneratorTable(asset.GetAsset());
+            secp256k1_generator_table_generator(secp256k1_ctx_verify_amounts, &gen, table.get());
         }
         else if (asset.IsCommitment()) {
             if (secp256k1_generator_parse(secp256k1_ctx_verify_amounts, &gen, &asset.vchCommitment[0]) != 1)
@@ -160,7 +190,12 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
                 return false;
 
             // Fails if val.GetAmount() == 0
-            if (secp256k1_pedersen_commit(secp256k1_ctx_verify_amounts, &commit, explicit_blinds, val.GetAmount(), &gen, &secp256k1_generator_const_g) != 1)
+            if (table) {
+                ret = secp256k1_pedersen_commit_table(secp256k1_ctx_verify_amounts, &commit, explicit_blinds, val.GetAmount(), table.get(), NULL);
+            } else {
+                ret = secp256k1_pedersen_commit(secp256k1_ctx_verify_amounts, &commit, explicit_blinds, val.GetAmount(), &gen, &secp256k1_generator_const_g);
+            }
+            if (ret != 1)
                 return false;
         } else if (val.IsCommitment()) {
             if (secp256k1_pedersen_commitment_parse(secp256k1_ctx_verify_amounts, &commit, &val.vchCommitment[0]) != 1)
@@ -270,9 +305,11 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
         if (!tx.vout[i].nNonce.IsValid())
             return false;
 
+        // The generators of explicit assets come with their tables, which commit to explicit values.
+        std::shared_ptr<const secp256k1_generator_table> table;
         if (asset.IsExplicit()) {
-            ret = secp256k1_generator_generate(secp256k1_ctx_verify_amounts, &gen, asset.GetAsset().begin());
-            assert(ret != 0);
+            table = GetAssetGeneratorTable(asset.GetAsset());
+            secp256k1_generator_table_generator(secp256k1_ctx_verify_amounts, &gen, table.get());
         }
         else if (asset.IsCommitment()) {
             if (secp256k1_generator_parse(secp256k1_ctx_verify_amounts, &gen, &asset.vchCommitment[0]) != 1)
@@ -296,8 +333,12 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
                 }
             }
 
-            ret = secp256k1_pedersen_commit(secp256k1_ctx_verify_amounts, &commit, explicit_blinds, val.GetAmount(), &gen, &secp256k1_generator_const_g);
-            // The explicit_blinds are all 0, and the amount is not 0. So secp256k1_pedersen_commit does not fail.
+            if (table) {
+                ret = secp256k1_pedersen_commit_table(secp256k1_ctx_verify_amounts, &commit, explicit_blinds, val.GetAmount(), table.get(), NULL);
+            } else {
+                ret = secp256k1_pedersen_commit(secp256k1_ctx_verify_amounts, &commit, explicit_blinds, val.GetAmount(), &gen, &secp256k1_generator_const_g);
+            }
+            // The explicit_blinds are all 0, and the amount is not 0. So the commitment does not fail.
             assert(ret == 1);
         }
         else if (val.IsCommitment()) {
@@ -317,11 +358,12 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
         return false;
     }
 
-    // Range proofs
+    // Range proofs, the Bulletproofs are batched
+    std::unique_ptr<CBulletproofCheck> bulletproofs;
     for(const auto& out : tx.vout) {
         const CConfidentialValue& val = out.nValueCA;
         const CConfidentialAsset& asset = out.nAsset;
-        std::vector<unsigned char> vchAssetCommitment = asset.vchCommitment;
+        CCommitmentData vchAssetCommitment = asset.vchCommitment;
         if (val.IsExplicit())
         {
             if (!out.vchRangeproof.empty())
@@ -329,16 +371,32 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
             continue;
         }
         if (asset.IsExplicit()) {
-            int ret = secp256k1_generator_generate(secp256k1_ctx_verify_amounts, &gen, asset.GetAsset().begin());
-            assert(ret != 0);
+            secp256k1_generator_table_generator(secp256k1_ctx_verify_amounts, &gen, GetAssetGeneratorTable(asset.GetAsset()).get());
             secp256k1_generator_serialize(secp256k1_ctx_verify_amounts, &vchAssetCommitment[0], &gen);
         }
+        if (fBulletproofs && IsBulletproof(out.vchRangeproof)) {
+            if (secp256k1_generator_parse(secp256k1_ctx_verify_amounts, &gen, &vchAssetCommitment[0]) != 1)
+                return false;
+            if (!bulletproofs)
+                bulletproofs.reset(new CBulletproofCheck(store_result));
+            bulletproofs->Add(out.vchRangeproof, val.vchCommitment, gen, out.scriptPubKey);
+            if (bulletproofs->size() == MAX_BULLETPROOF_BATCH) {
+                if (QueueCheck(checks, bulletproofs.release()) != SCRIPT_ERR_OK) {
+                    return false;
+                }
+            }
+            continue;
+        }
         if (QueueCheck(checks, new CRangeCheck(&val, out.vchRangeproof, vchAssetCommitment, out.scriptPubKey, store_result)) != SCRIPT_ERR_OK) {
             return false;
         }
     }
+    if (bulletproofs && QueueCheck(checks, bulletproofs.release()) != SCRIPT_ERR_OK) {
+        return false;
+    }
 
-    // Surjection proofs
+    // Surjection proofs, checked together and parsed only if they are not cached
+    std::unique_ptr<CSurjectionCheck> surjections(new CSurjectionCheck(target_generators, wtxid, store_result));
     for (const auto& out : tx.vout)
     {
         const CConfidentialAsset& asset = out.nAsset;
@@ -352,13 +410,10 @@ bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, st
         if (secp256k1_generator_parse(secp256k1_ctx_verify_amounts, &gen, &asset.vchCommitment[0]) != 1)
             return false;
 
-        secp256k1_surjectionproof proof;
-        if (secp256k1_surjectionproof_parse(secp256k1_ctx_verify_amounts, &proof, &out.vchSurjectionproof[0], out.vchSurjectionproof.size()) != 1)
-            return false;
-
-        if (QueueCheck(checks, new CSurjectionCheck(proof, target_generators, gen, wtxid, store_result)) != SCRIPT_ERR_OK) {
-            return false;
-        }
+        surjections->Add(out.vchSurjectionproof, gen);
+    }
+    if (!surjections->empty() && QueueCheck(checks, surjections.release()) != SCRIPT_ERR_OK) {
+        return false;
     }
 
     return true;
@@ -9,6 +9,7 @@
 #include <primitives/transaction.h>
 #include <script/script_error.h>
 #include <secp256k1.h>
+#include <secp256k1_bulletproofs.h>
 #include <secp256k1_rangeproof.h>
 #include <secp256k1_surjectionproof.h>
 #include <uint256.h>
@@ -43,12 +44,41 @@ private:
     const CConfidentialValue* val;
     const std::vector<unsigned char>& rangeproof;
     // *Must* be a commitment, not an explicit value
-    const std::vector<unsigned char> assetCommitment;
+    const CCommitmentData assetCommitment;
     const CScript scriptPubKey;
     const bool store;
 
 public:
-    CRangeCheck(const CConfidentialValue* val_, const std::vector<unsigned char>& rangeproof_, const std::vector<unsigned char>& assetCommitment_, const CScript& scriptPubKey_, const bool storeIn) : val(val_), rangeproof(rangeproof_), assetCommitment(assetCommitment_), scriptPubKey(scriptPubKey_), store(storeIn) {}
+    CRangeCheck(const CConfidentialValue* val_, const std::vector<unsigned char>& rangeproof_, const CCommitmentData& assetCommitment_, const CScript& scriptPubKey_, const bool storeIn) : val(val_), rangeproof(rangeproof_), assetCommitment(assetCommitment_), scriptPubKey(scriptPubKey_), store(storeIn) {}
+
+    bool operator()();
+};
+
+/** Size of a Bulletproof over one 64-bit value. Once Bulletproofs are active a range proof of this size is one. */
+static const size_t BULLETPROOF_SIZE = 675;
+/** Most Bulletproofs verified by one check, more are split so that the check queue spreads them over its threads. */
+static const size_t MAX_BULLETPROOF_BATCH = 64;
+
+/** Whether a range proof is verified as a Bulletproof, rather than a Borromean proof, once they are active. */
+inline bool IsBulletproof(const std::vector<unsigned char>& rangeproof) { return rangeproof.size() == BULLETPROOF_SIZE; }
+
+/** Closure representing the batch verification of several output Bulletproofs. */
+class CBulletproofCheck : public CCheck
+{
+private:
+    std::vector<const std::vector<unsigned char>*> rangeproofs;
+    std::vector<CCommitmentData> valueCommitments;
+    std::vector<secp256k1_generator> generators;
+    std::vector<CScript> scriptPubKeys;
+    const bool store;
+
+public:
+    explicit CBulletproofCheck(const bool storeIn) : store(storeIn) {}
+
+    /** Add the proof of one output, the proof is referenced and not copied, like CRangeCheck does. */
+    void Add(const std::vector<unsigned char>& rangeproof, const CCommitmentData& valueCommitment, const secp256k1_generator& gen, const CScript& scriptPubKey);
+
+    size_t size() const { return rangeproofs.size(); }
 
     bool operator()();
 };
@@ -70,23 +100,38 @@ public:
     bool operator()();
 };
 
+/** Closure representing the surjection proof checks of all the blinded assets of one transaction. */
 class CSurjectionCheck : public CCheck
 {
 private:
-    secp256k1_surjectionproof proof;
+    std::vector<const std::vector<unsigned char>*> vProofs;
+    std::vector<secp256k1_generator> vGens;
     std::vector<secp256k1_generator> vTags;
-    secp256k1_generator gen;
     uint256 wtxid;
     const bool store;
 public:
-    CSurjectionCheck(secp256k1_surjectionproof& proof_in, std::vector<secp256k1_generator>& tags_in, secp256k1_generator& gen_in, uint256& wtxid_in, const bool store_in) : proof(proof_in), vTags(tags_in), gen(gen_in), wtxid(wtxid_in), store(store_in) {}
+    CSurjectionCheck(std::vector<secp256k1_generator>& tags_in, const uint256& wtxid_in, const bool store_in) : wtxid(wtxid_in), store(store_in) {
+        vTags.swap(tags_in);
+    }
+
+    /** Add the serialized proof of one output, referenced and not copied, and its asset generator. */
+    void Add(const std::vector<unsigned char>& proof, const secp256k1_generator& gen) {
+        vProofs.push_back(&proof);
+        vGens.push_back(gen);
+    }
+
+    bool empty() const { return vProofs.empty(); }
 
     bool operator()();
 };
 
 ScriptError QueueCheck(std::vector<CCheck*>* queue, CCheck* check);
 
-bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, std::vector<CCheck*>* pvChecks, const bool cacheStore);
+/**
+ * Verify that the amounts of a transaction balance, queueing the proof checks on pvChecks if it is set.
+ * With fBulletproofs the output Bulletproofs are verified together in batches of MAX_BULLETPROOF_BATCH.
+ */
+bool VerifyAmounts(const std::vector<CTxOut>& inputs, const CTransaction& tx, std::vector<CCheck*>* pvChecks, const bool cacheStore, const bool fBulletproofs = false);
 
 bool VerifyCoinbaseAmount(const CTransaction& tx, const CAmountMap& mapFees);
 
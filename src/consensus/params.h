@@ -19,6 +19,7 @@ enum DeploymentPos
     DEPLOYMENT_TESTDUMMY,
     DEPLOYMENT_CSV, // Deployment of BIP68, BIP112, and BIP113.
     DEPLOYMENT_SEGWIT, // Deployment of BIP141, BIP143, and BIP147.
+    DEPLOYMENT_SCHNORR, // Schnorr signatures with OP_CHECKSCHNORRVERIFY.
     // NOTE: Also add new deployments to VersionBitsDeploymentInfo in versionbits.cpp
     MAX_VERSION_BITS_DEPLOYMENTS
 };
@@ -78,7 +79,14 @@ struct Params {
     int64_t DifficultyAdjustmentInterval() const { return nPowTargetTimespan / nPowTargetSpacing; }
     uint256 nMinimumCumulativeDiff;
     uint256 defaultAssumeValid;
+    uint256 defaultAssumePoC;
     CAmount nActionFee;
+    /**
+     * Fast PoC test chains (regtest only): deadlines neither hold blocks back nor bound
+     * them, and the first nonces of every key are kept in memory, so blocks are forged
+     * and verified without generating a nonce.
+     */
+    bool fFastPoC;
 };
 } // namespace Consensus
 
@@ -214,13 +214,16 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, c
     }
 
     auto hasCA = tx.HasCAOut();
+    // The spent outputs are only needed to balance confidential amounts, and come from the
+    // coins cache without their proofs.
     std::vector<CTxOut> spent_inputs;
+    if (hasCA)
+        spent_inputs.reserve(tx.vin.size());
     CAmount nValueIn = 0;
     for (unsigned int i = 0; i < tx.vin.size(); ++i) {
         const COutPoint &prevout = tx.vin[i].prevout;
         const Coin& coin = inputs.AccessCoin(prevout);
         assert(!coin.IsSpent());
-        spent_inputs.push_back(coin.out);
         // If prev is coinbase, check that it's matured
         if (coin.IsCoinBase() && nSpendHeight - coin.nHeight < COINBASE_MATURITY) {
             return state.Invalid(false,
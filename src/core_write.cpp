@@ -318,7 +318,7 @@ void TxToUniv(const CTransaction& tx, const uint256& hashBlock, UniValue& entry,
 
             if (! txout.nNonce.IsNull()) {
                 out.pushKV("commitmentnonce", txout.nNonce.GetHex());
-                CPubKey pubkey(txout.nNonce.vchCommitment);
+                CPubKey pubkey(txout.nNonce.vchCommitment.begin(), txout.nNonce.vchCommitment.end());
                 out.pushKV("commitmentnonce_fully_valid", pubkey.IsFullyValid());
             }
         }
@@ -0,0 +1,171 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/sha256.h>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+
+/** The modulus is 2^3072 - MAX_PRIME_DIFF, the largest 3072-bit safe prime. */
+const limb_t MAX_PRIME_DIFF = 1103717;
+const limb_t LIMB_MAX = ~limb_t(0);
+
+/** The number an element of the set stands for: its SHA256 keys a ChaCha20 stream. */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hashed[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hashed);
+    unsigned char stream[Num3072::BYTE_SIZE];
+    ChaCha20(hashed, sizeof(hashed)).Output(stream, sizeof(stream));
+    return Num3072(stream);
+}
+
+} // namespace
+
+Num3072::Num3072(const unsigned char* data)
+{
+    for (size_t i = 0; i < LIMBS; i++) {
+        limbs[i] = 0;
+        for (size_t j = sizeof(limb_t); j-- > 0;) {
+            limbs[i] = (limbs[i] << 8) | data[sizeof(limb_t) * i + j];
+        }
+    }
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (size_t i = 1; i < LIMBS; i++) {
+        limbs[i] = 0;
+    }
+}
+
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] < LIMB_MAX - MAX_PRIME_DIFF + 1)
+        return false;
+    for (size_t i = 1; i < LIMBS; i++) {
+        if (limbs[i] != LIMB_MAX)
+            return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the modulus from a number below 2^3072 is adding MAX_PRIME_DIFF and
+    // dropping the carry out of the top limb.
+    double_limb_t carry = MAX_PRIME_DIFF;
+    for (size_t i = 0; i < LIMBS && carry; i++) {
+        carry += limbs[i];
+        limbs[i] = (limb_t)carry;
+        carry >>= LIMB_BITS;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t product[2 * LIMBS] = {0};
+    for (size_t i = 0; i < LIMBS; i++) {
+        double_limb_t carry = 0;
+        for (size_t j = 0; j < LIMBS; j++) {
+            carry += (double_limb_t)limbs[i] * a.limbs[j] + product[i + j];
+            product[i + j] = (limb_t)carry;
+            carry >>= LIMB_BITS;
+        }
+        product[i + LIMBS] = (limb_t)carry;
+    }
+
+    // 2^3072 is MAX_PRIME_DIFF modulo the prime, so the high half folds into the low one,
+    // and what carries out of it folds in again until nothing does.
+    double_limb_t carry = 0;
+    for (size_t i = 0; i < LIMBS; i++) {
+        carry += (double_limb_t)product[i + LIMBS] * MAX_PRIME_DIFF + product[i];
+        limbs[i] = (limb_t)carry;
+        carry >>= LIMB_BITS;
+    }
+    while (carry) {
+        carry *= MAX_PRIME_DIFF;
+        for (size_t i = 0; i < LIMBS && carry; i++) {
+            carry += limbs[i];
+            limbs[i] = (limb_t)carry;
+            carry >>= LIMB_BITS;
+        }
+    }
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // By Fermat's little theorem, the inverse is the number to the power of the prime
+    // minus 2, that is 2^3072 - 1 - (MAX_PRIME_DIFF + 1): all bits set but a few low ones.
+    Num3072 result;
+    for (size_t i = LIMBS; i-- > 0;) {
+        const limb_t exponent = i == 0 ? LIMB_MAX - (MAX_PRIME_DIFF + 1) : LIMB_MAX;
+        for (int bit = LIMB_BITS - 1; bit >= 0; bit--) {
+            result.Multiply(result);
+            if ((exponent >> bit) & 1)
+                result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+void Num3072::ToBytes(unsigned char* data) const
+{
+    Num3072 reduced = *this;
+    if (reduced.IsOverflow())
+        reduced.FullReduce();
+    for (size_t i = 0; i < LIMBS; i++) {
+        for (size_t j = 0; j < sizeof(limb_t); j++) {
+            data[sizeof(limb_t) * i + j] = reduced.limbs[i] >> (8 * j);
+        }
+    }
+}
+
+MuHash3072::MuHash3072(const unsigned char* data, size_t len) : m_numerator(ToNum3072(data, len))
+{
+}
+
+void MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    m_numerator.Multiply(ToNum3072(data, len));
+}
+
+void MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    m_denominator.Multiply(ToNum3072(data, len));
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(uint256& out) const
+{
+    Num3072 result = m_numerator;
+    result.Divide(m_denominator);
+    unsigned char data[Num3072::BYTE_SIZE];
+    result.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_CRYPTO_MUHASH_H
+#define LAVA_CRYPTO_MUHASH_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717, not always fully reduced. */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef uint64_t limb_t;
+    typedef unsigned __int128 double_limb_t;
+#else
+    typedef uint32_t limb_t;
+    typedef uint64_t double_limb_t;
+#endif
+    static constexpr int LIMB_BITS = sizeof(limb_t) * 8;
+    static constexpr size_t BYTE_SIZE = 384;
+    static constexpr size_t LIMBS = BYTE_SIZE / sizeof(limb_t);
+
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    /** Read from BYTE_SIZE bytes, least significant first. */
+    explicit Num3072(const unsigned char* data);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    /** Multiply by the inverse of a, which must not be zero. */
+    void Divide(const Num3072& a);
+    /** Write the fully reduced number to BYTE_SIZE bytes, least significant first. */
+    void ToBytes(unsigned char* data) const;
+
+private:
+    Num3072 GetInverse() const;
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A hash of a set of byte strings that is updated in constant time as elements are added
+ * to or removed from the set, and whose updates commute: the hash does not depend on the
+ * order of the changes, and two hashes of disjoint sets combine into the hash of their
+ * union. Every element is hashed to a number modulo a 3072-bit prime; the set's hash is
+ * the product of the numbers of its elements. The product of the removed elements is kept
+ * apart, so the costly division is only done once, by Finalize.
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+public:
+    /** The hash of the empty set. */
+    MuHash3072() {}
+    /** The hash of the set with a single element. */
+    MuHash3072(const unsigned char* data, size_t len);
+
+    void Insert(const unsigned char* data, size_t len);
+    void Remove(const unsigned char* data, size_t len);
+
+    /** Add the elements of another set, which must not share any with this one. */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    /** Remove the elements of another set, which must all be in this one. */
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /** The 256-bit digest of the set. */
+    void Finalize(uint256& out) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        m_numerator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+        m_denominator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        m_numerator = Num3072(data);
+        s.read((char*)data, sizeof(data));
+        m_denominator = Num3072(data);
+    }
+};
+
+#endif // LAVA_CRYPTO_MUHASH_H
@@ -0,0 +1,229 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/shabal256.h>
+
+#include <crypto/cpuid.h>
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+extern "C" {
+#include <crypto/sph_shabal.h>
+}
+
+#if defined(WIN32) && !defined(WITHOUT_ASM)
+#include <immintrin.h>
+#include <shabal/shabal.h>
+#endif
+
+namespace shabal256_sse2
+{
+void Hash_4way(unsigned char* const* out, const unsigned char* const* in, size_t len);
+}
+
+namespace shabal256_avx2
+{
+void Hash_8way(unsigned char* const* out, const unsigned char* const* in, size_t len);
+}
+
+namespace shabal256_avx512
+{
+void Hash_16way(unsigned char* const* out, const unsigned char* const* in, size_t len);
+}
+
+namespace
+{
+typedef void (*HashFn)(unsigned char* out, const unsigned char* in, size_t len);
+typedef void (*HashLanesFn)(unsigned char* const* out, const unsigned char* const* in, size_t len);
+
+void Hash_1way_standard(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_shabal256_context ctx;
+    sph_shabal256_init(&ctx);
+    sph_shabal256(&ctx, in, len);
+    sph_shabal256_close(&ctx, out);
+}
+
+#if defined(WIN32) && !defined(WITHOUT_ASM)
+/** The x64 SSE2 assembly kernel of shabal/shabal.asm, only assembled by MSVC builds. */
+void Hash_1way_asm(unsigned char* out, const unsigned char* in, size_t len)
+{
+    shabal_context ctx;
+    _mm256_zeroupper();
+    shabal_init(&ctx, 256);
+    shabal(&ctx, in, len);
+    shabal_close(&ctx, 0, 0, out);
+}
+#endif
+
+HashFn Hash_1way = Hash_1way_standard;
+HashLanesFn Hash_4way = nullptr;
+HashLanesFn Hash_8way = nullptr;
+HashLanesFn Hash_16way = nullptr;
+size_t nLanes = 1;
+
+/** Run one multi-lane kernel, padding a partial group with copies of its first lane. */
+void HashGroup(HashLanesFn fn, size_t width, unsigned char* const* out, const unsigned char* const* in, size_t len, size_t lanes)
+{
+    if (lanes == width) {
+        fn(out, in, len);
+        return;
+    }
+    unsigned char scratch[SHABAL256_MAX_LANES][32];
+    unsigned char* outs[SHABAL256_MAX_LANES];
+    const unsigned char* ins[SHABAL256_MAX_LANES];
+    for (size_t i = 0; i < width; ++i) {
+        outs[i] = i < lanes ? out[i] : scratch[i];
+        ins[i] = i < lanes ? in[i] : in[0];
+    }
+    fn(outs, ins, len);
+}
+
+bool SelfTest()
+{
+    // Messages of every length class the kernels handle: empty, partial block,
+    // exact block, and multiple blocks with a partial tail.
+    static const size_t lens[] = {0, 1, 31, 63, 64, 65, 128, 200};
+    unsigned char data[SHABAL256_MAX_LANES][256];
+    for (size_t l = 0; l < SHABAL256_MAX_LANES; ++l) {
+        for (size_t i = 0; i < 256; ++i) data[l][i] = (unsigned char)(l * 31 + i * 7 + 1);
+    }
+    const unsigned char* ins[SHABAL256_MAX_LANES];
+    for (size_t l = 0; l < SHABAL256_MAX_LANES; ++l) ins[l] = data[l];
+
+    for (size_t len : lens) {
+        unsigned char expected[SHABAL256_MAX_LANES][32];
+        for (size_t l = 0; l < SHABAL256_MAX_LANES; ++l) Hash_1way_standard(expected[l], data[l], len);
+
+        unsigned char result[SHABAL256_MAX_LANES][32];
+        unsigned char* outs[SHABAL256_MAX_LANES];
+        for (size_t l = 0; l < SHABAL256_MAX_LANES; ++l) outs[l] = result[l];
+
+        memset(result, 0, sizeof(result));
+        Hash_1way(outs[0], ins[0], len);
+        if (memcmp(result, expected, 32)) return false;
+
+        if (Hash_4way) {
+            memset(result, 0, sizeof(result));
+            Hash_4way(outs, ins, len);
+            if (memcmp(result, expected, 4 * 32)) return false;
+        }
+        if (Hash_8way) {
+            memset(result, 0, sizeof(result));
+            Hash_8way(outs, ins, len);
+            if (memcmp(result, expected, 8 * 32)) return false;
+        }
+        if (Hash_16way) {
+            memset(result, 0, sizeof(result));
+            Hash_16way(outs, ins, len);
+            if (memcmp(result, expected, 16 * 32)) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+
+std::string Shabal256AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(WIN32) && !defined(WITHOUT_ASM)
+    // Every x64 CPU has SSE2, so the assembly kernel needs no detection.
+    Hash_1way = Hash_1way_asm;
+    ret = "asm(1way)";
+#endif
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_sse2 = false;
+    bool have_avx2 = false;
+    bool have_avx512 = false;
+    bool enabled_avx = false;
+    bool enabled_avx512 = false;
+
+    (void)XCR0;
+    (void)have_sse2;
+    (void)have_avx2;
+    (void)have_avx512;
+    (void)enabled_avx;
+    (void)enabled_avx512;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_sse2 = (edx >> 26) & 1;
+    bool have_xsave = (ecx >> 27) & 1;
+    bool have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        uint32_t xcr0 = XCR0();
+        enabled_avx = (xcr0 & 0x06) == 0x06;
+        enabled_avx512 = (xcr0 & 0xe6) == 0xe6;
+    }
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    if (eax >= 7) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = have_avx && ((ebx >> 5) & 1);
+        have_avx512 = (ebx >> 16) & 1;
+    }
+
+#if defined(ENABLE_SSE2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_sse2) {
+        Hash_4way = shabal256_sse2::Hash_4way;
+        nLanes = 4;
+        ret += ",sse2(4way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        Hash_8way = shabal256_avx2::Hash_8way;
+        nLanes = 8;
+        ret += ",avx2(8way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX512) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx512 && enabled_avx512) {
+        Hash_16way = shabal256_avx512::Hash_16way;
+        nLanes = 16;
+        ret += ",avx512(16way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void Shabal256(unsigned char* out, const unsigned char* in, size_t len)
+{
+    Hash_1way(out, in, len);
+}
+
+size_t Shabal256Lanes()
+{
+    return nLanes;
+}
+
+void Shabal256Multi(unsigned char* const* out, const unsigned char* const* in, size_t len, size_t lanes)
+{
+    // Use the widest kernel that is at least half filled; leftovers go to narrower kernels.
+    while (lanes > 0) {
+        if (Hash_16way && lanes > 8) {
+            size_t n = std::min<size_t>(lanes, 16);
+            HashGroup(Hash_16way, 16, out, in, len, n);
+            out += n; in += n; lanes -= n;
+        } else if (Hash_8way && lanes > 4) {
+            size_t n = std::min<size_t>(lanes, 8);
+            HashGroup(Hash_8way, 8, out, in, len, n);
+            out += n; in += n; lanes -= n;
+        } else if (Hash_4way && lanes > 1) {
+            size_t n = std::min<size_t>(lanes, 4);
+            HashGroup(Hash_4way, 4, out, in, len, n);
+            out += n; in += n; lanes -= n;
+        } else {
+            Hash_1way(out[0], in[0], len);
+            out += 1; in += 1; lanes -= 1;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHABAL256_H
+#define BITCOIN_CRYPTO_SHABAL256_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Maximum number of messages a single multi-lane Shabal-256 kernel hashes at once. */
+static const size_t SHABAL256_MAX_LANES = 16;
+
+/** Autodetect the best available single- and multi-lane Shabal-256 implementations.
+ *  Returns the names of the implementations.
+ */
+std::string Shabal256AutoDetect();
+
+/** Number of lanes of the widest multi-lane kernel selected by Shabal256AutoDetect (1, 4, 8 or 16). */
+size_t Shabal256Lanes();
+
+/** Compute Shabal-256 of one message with the single-lane implementation selected by Shabal256AutoDetect.
+ *  out:    32-byte output buffer
+ */
+void Shabal256(unsigned char* out, const unsigned char* in, size_t len);
+
+/** Compute Shabal-256 of several messages that all have the same length.
+ *  out:    array of `lanes` pointers to 32-byte output buffers
+ *  in:     array of `lanes` pointers to `len`-byte input buffers
+ *  lanes:  the number of messages to hash.
+ */
+void Shabal256Multi(unsigned char* const* out, const unsigned char* const* in, size_t len, size_t lanes);
+
+#endif // BITCOIN_CRYPTO_SHABAL256_H
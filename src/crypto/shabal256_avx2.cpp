@@ -0,0 +1,43 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/shabal256_lanes.h>
+
+namespace shabal256_avx2 {
+namespace {
+
+struct Ops
+{
+    typedef __m256i vec;
+    static const int LANES = 8;
+
+    static inline vec K(uint32_t x) { return _mm256_set1_epi32(x); }
+    static inline vec Add(vec x, vec y) { return _mm256_add_epi32(x, y); }
+    static inline vec Sub(vec x, vec y) { return _mm256_sub_epi32(x, y); }
+    static inline vec Xor(vec x, vec y) { return _mm256_xor_si256(x, y); }
+    static inline vec AndNot(vec x, vec y) { return _mm256_andnot_si256(x, y); }
+    static inline vec Not(vec x) { return _mm256_xor_si256(x, _mm256_set1_epi32(-1)); }
+    static inline vec Mul3(vec x) { return _mm256_add_epi32(_mm256_slli_epi32(x, 1), x); }
+    static inline vec Mul5(vec x) { return _mm256_add_epi32(_mm256_slli_epi32(x, 2), x); }
+    template<int n> static inline vec RotL(vec x) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+    static inline vec Load(const uint32_t* p) { return _mm256_load_si256((const __m256i*)p); }
+    static inline void Store(uint32_t* p, vec x) { _mm256_store_si256((__m256i*)p, x); }
+};
+
+}
+
+void Hash_8way(unsigned char* const* out, const unsigned char* const* in, size_t len)
+{
+    shabal256_lanes::Hash<Ops>(out, in, len);
+    _mm256_zeroupper();
+}
+
+}
+
+#endif
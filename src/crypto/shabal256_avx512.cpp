@@ -0,0 +1,43 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX512
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/shabal256_lanes.h>
+
+namespace shabal256_avx512 {
+namespace {
+
+struct Ops
+{
+    typedef __m512i vec;
+    static const int LANES = 16;
+
+    static inline vec K(uint32_t x) { return _mm512_set1_epi32(x); }
+    static inline vec Add(vec x, vec y) { return _mm512_add_epi32(x, y); }
+    static inline vec Sub(vec x, vec y) { return _mm512_sub_epi32(x, y); }
+    static inline vec Xor(vec x, vec y) { return _mm512_xor_si512(x, y); }
+    static inline vec AndNot(vec x, vec y) { return _mm512_andnot_si512(x, y); }
+    static inline vec Not(vec x) { return _mm512_ternarylogic_epi32(x, x, x, 0x55); }
+    static inline vec Mul3(vec x) { return _mm512_add_epi32(_mm512_slli_epi32(x, 1), x); }
+    static inline vec Mul5(vec x) { return _mm512_add_epi32(_mm512_slli_epi32(x, 2), x); }
+    template<int n> static inline vec RotL(vec x) { return _mm512_rol_epi32(x, n); }
+    static inline vec Load(const uint32_t* p) { return _mm512_load_si512((const void*)p); }
+    static inline void Store(uint32_t* p, vec x) { _mm512_store_si512((void*)p, x); }
+};
+
+}
+
+void Hash_16way(unsigned char* const* out, const unsigned char* const* in, size_t len)
+{
+    shabal256_lanes::Hash<Ops>(out, in, len);
+    _mm256_zeroupper();
+}
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_SHABAL256_LANES_H
+#define BITCOIN_CRYPTO_SHABAL256_LANES_H
+
+#include <crypto/common.h>
+
+#include <stdint.h>
+#include <string.h>
+
+/** Lane-parallel Shabal-256, shared by the SSE2, AVX2 and AVX-512 kernels.
+ *
+ *  `Ops` supplies a vector type `vec` holding `Ops::LANES` 32-bit words and
+ *  the handful of primitives the permutation needs. All lanes hash messages
+ *  of the same length, so the block counter W is common to every lane.
+ */
+namespace shabal256_lanes {
+
+static const uint32_t A_init[12] = {
+    0x52F84552ul, 0xE54B7999ul, 0x2D8EE3ECul, 0xB9645191ul,
+    0xE0078B86ul, 0xBB7C44C9ul, 0xD2B5C1CAul, 0xB0D2EB8Cul,
+    0x14CE5A45ul, 0x22AF50DCul, 0xEFFDBC6Bul, 0xEB21B74Aul
+};
+
+static const uint32_t B_init[16] = {
+    0xB555C6EEul, 0x3E710596ul, 0xA72A652Ful, 0x9301515Ful,
+    0xDA28C1FAul, 0x696FD868ul, 0x9CB6BF72ul, 0x0AFE4002ul,
+    0xA6E03615ul, 0x5138C1D4ul, 0xBE216306ul, 0xB38B8890ul,
+    0x3EA8B96Bul, 0x3299ACE4ul, 0x30924DD4ul, 0x55CB34A5ul
+};
+
+static const uint32_t C_init[16] = {
+    0xB405F031ul, 0xC4233EBAul, 0xB3733979ul, 0xC0DD9D55ul,
+    0xC51C28AEul, 0xA327B8E1ul, 0x56C56167ul, 0xED614433ul,
+    0x88B59D60ul, 0x60E2CEBAul, 0x758B4B8Bul, 0x83E82A7Ful,
+    0xBC968828ul, 0xE6E00BF7ul, 0xBA839E55ul, 0x9B491C60ul
+};
+
+template<typename Ops>
+struct State
+{
+    typedef typename Ops::vec vec;
+    vec A[12], B[16], C[16], M[16];
+    uint32_t Wlow, Whigh;
+
+    State() : Wlow(1), Whigh(0)
+    {
+        for (int i = 0; i < 12; ++i) A[i] = Ops::K(A_init[i]);
+        for (int i = 0; i < 16; ++i) B[i] = Ops::K(B_init[i]);
+        for (int i = 0; i < 16; ++i) C[i] = Ops::K(C_init[i]);
+    }
+
+    /** Load one 64-byte block at `offset` of every lane's message into M. */
+    void Decode(const unsigned char* const* in, size_t offset)
+    {
+        alignas(64) uint32_t words[Ops::LANES];
+        for (int w = 0; w < 16; ++w) {
+            for (int l = 0; l < Ops::LANES; ++l) words[l] = ReadLE32(in[l] + offset + 4 * w);
+            M[w] = Ops::Load(words);
+        }
+    }
+
+    void XorW()
+    {
+        A[0] = Ops::Xor(A[0], Ops::K(Wlow));
+        A[1] = Ops::Xor(A[1], Ops::K(Whigh));
+    }
+
+    void ApplyP()
+    {
+        for (int i = 0; i < 16; ++i) B[i] = Ops::template RotL<17>(B[i]);
+        for (int j = 0; j < 48; ++j) {
+            vec& xa0 = A[j % 12];
+            const vec& xa1 = A[(j + 11) % 12];
+            vec& xb0 = B[j % 16];
+            const vec& xb1 = B[(j + 13) % 16];
+            const vec& xb2 = B[(j + 9) % 16];
+            const vec& xb3 = B[(j + 6) % 16];
+            const vec& xc = C[(24 - j % 16) % 16];
+            xa0 = Ops::Xor(Ops::Mul3(Ops::Xor(Ops::Xor(xa0, Ops::Mul5(Ops::template RotL<15>(xa1))), xc)),
+                           Ops::Xor(Ops::Xor(xb1, Ops::AndNot(xb3, xb2)), M[j % 16]));
+            xb0 = Ops::Not(Ops::Xor(Ops::template RotL<1>(xb0), xa0));
+        }
+        for (int k = 0; k < 36; ++k) {
+            A[(48 + 11 - k) % 12] = Ops::Add(A[(48 + 11 - k) % 12], C[(48 + 6 - k) % 16]);
+        }
+    }
+
+    void SwapBC()
+    {
+        for (int i = 0; i < 16; ++i) {
+            vec tmp = B[i];
+            B[i] = C[i];
+            C[i] = tmp;
+        }
+    }
+
+    void Compress()
+    {
+        for (int i = 0; i < 16; ++i) B[i] = Ops::Add(B[i], M[i]);
+        XorW();
+        ApplyP();
+        for (int i = 0; i < 16; ++i) C[i] = Ops::Sub(C[i], M[i]);
+        SwapBC();
+        if (++Wlow == 0) ++Whigh;
+    }
+};
+
+/** Hash Ops::LANES messages of `len` bytes each into 32-byte digests. */
+template<typename Ops>
+void Hash(unsigned char* const* out, const unsigned char* const* in, size_t len)
+{
+    State<Ops> st;
+    size_t offset = 0;
+    for (; offset + 64 <= len; offset += 64) {
+        st.Decode(in, offset);
+        st.Compress();
+    }
+
+    // Final block: remaining bytes, a single 0x80 byte and zero padding.
+    unsigned char tail[Ops::LANES][64];
+    const unsigned char* tails[Ops::LANES];
+    size_t rem = len - offset;
+    for (int l = 0; l < Ops::LANES; ++l) {
+        if (rem) memcpy(tail[l], in[l] + offset, rem);
+        tail[l][rem] = 0x80;
+        memset(tail[l] + rem + 1, 0, 64 - rem - 1);
+        tails[l] = tail[l];
+    }
+    st.Decode(tails, 0);
+    for (int i = 0; i < 16; ++i) st.B[i] = Ops::Add(st.B[i], st.M[i]);
+    st.XorW();
+    st.ApplyP();
+    for (int r = 0; r < 3; ++r) {
+        st.SwapBC();
+        st.XorW();
+        st.ApplyP();
+    }
+
+    alignas(64) uint32_t words[Ops::LANES];
+    for (int w = 8; w < 16; ++w) {
+        Ops::Store(words, st.B[w]);
+        for (int l = 0; l < Ops::LANES; ++l) WriteLE32(out[l] + 4 * (w - 8), words[l]);
+    }
+}
+
+} // namespace shabal256_lanes
+
+#endif // BITCOIN_CRYPTO_SHABAL256_LANES_H
@@ -0,0 +1,42 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/shabal256_lanes.h>
+
+namespace shabal256_sse2 {
+namespace {
+
+struct Ops
+{
+    typedef __m128i vec;
+    static const int LANES = 4;
+
+    static inline vec K(uint32_t x) { return _mm_set1_epi32(x); }
+    static inline vec Add(vec x, vec y) { return _mm_add_epi32(x, y); }
+    static inline vec Sub(vec x, vec y) { return _mm_sub_epi32(x, y); }
+    static inline vec Xor(vec x, vec y) { return _mm_xor_si128(x, y); }
+    static inline vec AndNot(vec x, vec y) { return _mm_andnot_si128(x, y); }
+    static inline vec Not(vec x) { return _mm_xor_si128(x, _mm_set1_epi32(-1)); }
+    static inline vec Mul3(vec x) { return _mm_add_epi32(_mm_slli_epi32(x, 1), x); }
+    static inline vec Mul5(vec x) { return _mm_add_epi32(_mm_slli_epi32(x, 2), x); }
+    template<int n> static inline vec RotL(vec x) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+    static inline vec Load(const uint32_t* p) { return _mm_load_si128((const __m128i*)p); }
+    static inline void Store(uint32_t* p, vec x) { _mm_store_si128((__m128i*)p, x); }
+};
+
+}
+
+void Hash_4way(unsigned char* const* out, const unsigned char* const* in, size_t len)
+{
+    shabal256_lanes::Hash<Ops>(out, in, len);
+}
+
+}
+
+#endif
@@ -4,6 +4,27 @@
 
 #include <crypto/siphash.h>
 
+#include <crypto/common.h>
+#include <crypto/cpuid.h>
+#include <assert.h>
+
+namespace siphash_avx2
+{
+void Uint256_8way(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out);
+void Bytes_8way(uint64_t k0, uint64_t k1, const unsigned char* const* data, size_t len, uint64_t* out);
+}
+
+namespace
+{
+typedef void (*Uint256LanesFn)(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out);
+
+typedef void (*BytesLanesFn)(uint64_t k0, uint64_t k1, const unsigned char* const* data, size_t len, uint64_t* out);
+
+Uint256LanesFn Uint256_8way = nullptr;
+BytesLanesFn Bytes_8way = nullptr;
+
+} // namespace
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
@@ -171,3 +192,95 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+static bool SelfTest()
+{
+    uint256 vals[8];
+    const uint256* ptrs[8];
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 32; j++) {
+            *(vals[i].begin() + j) = i * 32 + j;
+        }
+        ptrs[i] = &vals[i];
+    }
+    uint64_t out[8];
+    SipHashUint256Multi(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, ptrs, out, 8);
+    for (int i = 0; i < 8; i++) {
+        if (out[i] != SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, vals[i])) return false;
+    }
+    // Messages of every length up to three words, so each tail length is covered.
+    const unsigned char* data[8];
+    for (int i = 0; i < 8; i++) {
+        data[i] = vals[i].begin();
+    }
+    for (size_t len = 0; len <= 24; len++) {
+        SipHashMulti(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, data, len, out, 8);
+        for (int i = 0; i < 8; i++) {
+            if (out[i] != CSipHasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL).Write(data[i], len).Finalize()) return false;
+        }
+    }
+    return true;
+}
+
+std::string SipHashAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)XCR0;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    bool have_xsave = (ecx >> 27) & 1;
+    bool have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = (XCR0() & 0x06) == 0x06;
+    }
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    if (eax >= 7) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = have_avx && ((ebx >> 5) & 1);
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        Uint256_8way = siphash_avx2::Uint256_8way;
+        Bytes_8way = siphash_avx2::Bytes_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void SipHashUint256Multi(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t n)
+{
+    size_t i = 0;
+    if (Uint256_8way) {
+        for (; i + 8 <= n; i += 8) {
+            Uint256_8way(k0, k1, vals + i, out + i);
+        }
+    }
+    for (; i < n; i++) {
+        out[i] = SipHashUint256(k0, k1, *vals[i]);
+    }
+}
+
+void SipHashMulti(uint64_t k0, uint64_t k1, const unsigned char* const* data, size_t len, uint64_t* out, size_t n)
+{
+    size_t i = 0;
+    if (Bytes_8way) {
+        for (; i + 8 <= n; i += 8) {
+            Bytes_8way(k0, k1, data + i, len, out + i);
+        }
+    }
+    for (; i < n; i++) {
+        out[i] = CSipHasher(k0, k1).Write(data[i], len).Finalize();
+    }
+}
@@ -6,6 +6,8 @@
 #define BITCOIN_CRYPTO_SIPHASH_H
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string>
 
 #include <uint256.h>
 
@@ -44,4 +46,22 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Autodetect the best available multi-lane SipHash implementations.
+ *  Returns the names of the implementations.
+ */
+std::string SipHashAutoDetect();
+
+/** Compute SipHashUint256 of n values under the same key, several at once where the CPU allows.
+ *  vals:   array of n pointers to the values
+ *  out:    array of n hashes
+ */
+void SipHashUint256Multi(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t n);
+
+/** Compute the SipHash of n messages of the same length len under the same key, several at once
+ *  where the CPU allows. Each result is identical to CSipHasher(k0, k1).Write(data[i], len).Finalize().
+ *  data:   array of n pointers to the messages
+ *  out:    array of n hashes
+ */
+void SipHashMulti(uint64_t k0, uint64_t k1, const unsigned char* const* data, size_t len, uint64_t* out, size_t n);
+
 #endif // BITCOIN_CRYPTO_SIPHASH_H
@@ -0,0 +1,135 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+#include <crypto/siphash.h>
+
+namespace siphash_avx2 {
+namespace {
+
+__m256i inline K(uint64_t x) { return _mm256_set1_epi64x(x); }
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+template<int n> __m256i inline RotL(__m256i x) { return _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - n)); }
+/** Rotations by whole 16-bit words are shuffles. */
+template<> __m256i inline RotL<16>(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 11, 10, 9, 8, 15, 14, 5, 4, 3, 2, 1, 0, 7, 6, 13, 12, 11, 10, 9, 8, 15, 14, 5, 4, 3, 2, 1, 0, 7, 6)); }
+template<> __m256i inline RotL<32>(__m256i x) { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+
+struct State
+{
+    __m256i v0, v1, v2, v3;
+
+    State(uint64_t k0, uint64_t k1) :
+        v0(K(0x736f6d6570736575ULL ^ k0)), v1(K(0x646f72616e646f6dULL ^ k1)),
+        v2(K(0x6c7967656e657261ULL ^ k0)), v3(K(0x7465646279746573ULL ^ k1)) {}
+
+    void inline __attribute__((always_inline)) Round()
+    {
+        v0 = Add(v0, v1); v1 = RotL<13>(v1); v1 = Xor(v1, v0);
+        v0 = RotL<32>(v0);
+        v2 = Add(v2, v3); v3 = RotL<16>(v3); v3 = Xor(v3, v2);
+        v0 = Add(v0, v3); v3 = RotL<21>(v3); v3 = Xor(v3, v0);
+        v2 = Add(v2, v1); v1 = RotL<17>(v1); v1 = Xor(v1, v2);
+        v2 = RotL<32>(v2);
+    }
+
+    void inline __attribute__((always_inline)) Compress(__m256i d)
+    {
+        v3 = Xor(v3, d);
+        Round();
+        Round();
+        v0 = Xor(v0, d);
+    }
+};
+
+/** Load the 64-bit word i of the four values in the lanes of w[i]. */
+void inline Transpose(const uint256* const* vals, __m256i w[4])
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i*)vals[0]->begin());
+    __m256i r1 = _mm256_loadu_si256((const __m256i*)vals[1]->begin());
+    __m256i r2 = _mm256_loadu_si256((const __m256i*)vals[2]->begin());
+    __m256i r3 = _mm256_loadu_si256((const __m256i*)vals[3]->begin());
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1), t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3), t3 = _mm256_unpackhi_epi64(r2, r3);
+    w[0] = _mm256_permute2x128_si256(t0, t2, 0x20);
+    w[1] = _mm256_permute2x128_si256(t1, t3, 0x20);
+    w[2] = _mm256_permute2x128_si256(t0, t2, 0x31);
+    w[3] = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+/** Load the 64-bit little-endian word at offset pos of the four messages in data. */
+__m256i inline Word(const unsigned char* const* data, size_t pos)
+{
+    return _mm256_set_epi64x(ReadLE64(data[3] + pos), ReadLE64(data[2] + pos), ReadLE64(data[1] + pos), ReadLE64(data[0] + pos));
+}
+
+/** Load the last, partial word of the four messages of length len, tagged with the length. */
+__m256i inline LastWord(const unsigned char* const* data, size_t len)
+{
+    const size_t pos = len & ~(size_t)7;
+    uint64_t t[4];
+    for (int l = 0; l < 4; l++) {
+        t[l] = ((uint64_t)len) << 56;
+        for (size_t j = pos; j < len; j++) {
+            t[l] |= ((uint64_t)data[l][j]) << (8 * (j - pos));
+        }
+    }
+    return _mm256_set_epi64x(t[3], t[2], t[1], t[0]);
+}
+
+}
+
+void Bytes_8way(uint64_t k0, uint64_t k1, const unsigned char* const* data, size_t len, uint64_t* out)
+{
+    State a(k0, k1), b(k0, k1);
+    for (size_t pos = 0; pos + 8 <= len; pos += 8) {
+        a.Compress(Word(data, pos));
+        b.Compress(Word(data + 4, pos));
+    }
+    a.Compress(LastWord(data, len));
+    b.Compress(LastWord(data + 4, len));
+    a.v2 = Xor(a.v2, K(0xFF));
+    b.v2 = Xor(b.v2, K(0xFF));
+    for (int i = 0; i < 4; i++) {
+        a.Round();
+        b.Round();
+    }
+    _mm256_storeu_si256((__m256i*)out, Xor(Xor(a.v0, a.v1), Xor(a.v2, a.v3)));
+    _mm256_storeu_si256((__m256i*)(out + 4), Xor(Xor(b.v0, b.v1), Xor(b.v2, b.v3)));
+    _mm256_zeroupper();
+}
+
+void Uint256_8way(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out)
+{
+    // Two independent sets of four lanes, so one hides the latency of the other.
+    State a(k0, k1), b(k0, k1);
+    __m256i wa[4], wb[4];
+    Transpose(vals, wa);
+    Transpose(vals + 4, wb);
+    for (int i = 0; i < 4; i++) {
+        a.Compress(wa[i]);
+        b.Compress(wb[i]);
+    }
+    const __m256i len = K(((uint64_t)4) << 59);
+    a.Compress(len);
+    b.Compress(len);
+    a.v2 = Xor(a.v2, K(0xFF));
+    b.v2 = Xor(b.v2, K(0xFF));
+    for (int i = 0; i < 4; i++) {
+        a.Round();
+        b.Round();
+    }
+    _mm256_storeu_si256((__m256i*)out, Xor(Xor(a.v0, a.v1), Xor(a.v2, a.v3)));
+    _mm256_storeu_si256((__m256i*)(out + 4), Xor(Xor(b.v0, b.v1), Xor(b.v2, b.v3)));
+    _mm256_zeroupper();
+}
+
+}
+
+#endif
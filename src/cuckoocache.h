@@ -5,6 +5,8 @@
 #ifndef BITCOIN_CUCKOOCACHE_H
 #define BITCOIN_CUCKOOCACHE_H
 
+#include <support/allocators/hugepage.h>
+
 #include <array>
 #include <algorithm>
 #include <atomic>
@@ -161,7 +163,7 @@ class cache
 {
 private:
     /** table stores all the elements */
-    std::vector<Element> table;
+    std::vector<Element, LargePageAllocator<Element>> table;
 
     /** size stores the total available slots in the hash table */
     uint32_t size;
@@ -475,6 +477,18 @@ public:
             }
         return false;
     }
+
+    /** for_each calls f on every element that is not marked for garbage collection
+     *
+     * @param f called with each element held by the cache
+     */
+    template <typename F>
+    inline void for_each(F f) const
+    {
+        for (uint32_t i = 0; i < size; ++i)
+            if (!collection_flags.bit_is_set(i))
+                f(table[i]);
+    }
 };
 } // namespace CuckooCache
 
@@ -5,6 +5,7 @@
 #include <dbwrapper.h>
 
 #include <memory>
+#include <metrics.h>
 #include <random.h>
 
 #include <leveldb/cache.h>
@@ -13,6 +14,7 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <sstream>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,13 +99,20 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const DBOptions& db_options)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.write_buffer_size = db_options.write_buffer_size > 0 ? db_options.write_buffer_size : nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    options.filter_policy = db_options.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(db_options.bloom_bits) : nullptr;
+    // Without Snappy, LevelDB stores the blocks it fails to compress as they are.
+    options.compression = db_options.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.block_size = db_options.block_size;
+    options.max_file_size = db_options.max_file_size;
+    options.l0_compaction_trigger = db_options.l0_compaction_trigger;
+    options.l0_slowdown_writes_trigger = db_options.l0_slowdown_writes_trigger;
+    options.l0_stop_writes_trigger = db_options.l0_stop_writes_trigger;
+    options.max_subcompactions = db_options.max_subcompactions;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -114,7 +123,7 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const DBOptions& db_options)
     : m_name(fs::basename(path))
 {
     penv = nullptr;
@@ -122,7 +131,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, db_options);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -180,15 +189,53 @@ CDBWrapper::~CDBWrapper()
     options.env = nullptr;
 }
 
+void CDBWrapper::UpdateCompactionMetrics()
+{
+    static CMetricCounter* const counters[] = {
+        &GetMetrics().Counter("leveldb_compaction_micros", "Time LevelDB spent compacting, in microseconds"),
+        &GetMetrics().Counter("leveldb_compaction_read_bytes", "Bytes LevelDB compactions read"),
+        &GetMetrics().Counter("leveldb_compaction_written_bytes", "Bytes LevelDB compactions wrote"),
+        &GetMetrics().Counter("leveldb_subcompactions", "Subcompactions LevelDB split level-0 compactions into"),
+        &GetMetrics().Counter("leveldb_stall_micros", "Time LevelDB writes were delayed or stopped for compactions, in microseconds"),
+    };
+    std::string str;
+    if (!pdb->GetProperty("leveldb.compaction-totals", &str)) {
+        return;
+    }
+    std::vector<uint64_t> totals;
+    std::istringstream stream(str);
+    uint64_t n;
+    while (stream >> n) {
+        totals.push_back(n);
+    }
+    if (totals.size() != sizeof(counters) / sizeof(counters[0])) {
+        return;
+    }
+    LOCK(m_compaction_mutex);
+    m_compaction_totals.resize(totals.size());
+    for (size_t i = 0; i < totals.size(); i++) {
+        if (totals[i] > m_compaction_totals[i]) {
+            counters[i]->Add(totals[i] - m_compaction_totals[i]);
+            m_compaction_totals[i] = totals[i];
+        }
+    }
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
+    static CMetricHistogram& metric = GetMetrics().Histogram("leveldb_write", "Time to write a batch to LevelDB, stalls included");
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
     double mem_before = 0;
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
     }
-    leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    leveldb::Status status;
+    {
+        CMetricTimer timer(metric);
+        status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
+    }
     dbwrapper_private::HandleError(status);
+    UpdateCompactionMetrics();
     if (log_memory) {
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
         LogPrint(BCLog::LEVELDB, "WriteBatch memory usage: db=%s, before=%.1fMiB, after=%.1fMiB\n",
@@ -233,6 +280,36 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+// Prefixed with null character like OBFUSCATE_KEY_KEY, out of the way of the keys of the views.
+const std::string CDBBufferedWrapper::BEST_BLOCK_KEY("\000best_block", 11);
+
+bool CDBBufferedWrapper::Flush(const uint256& hashBlock)
+{
+    CDBBatch batch(*this);
+    LOCK(m_pending_mutex);
+    for (const auto& entry : pending) {
+        if (entry.second.first) {
+            batch.WriteSerialized(entry.first, entry.second.second);
+        } else {
+            batch.EraseSerialized(entry.first);
+        }
+    }
+    batch.Write(BEST_BLOCK_KEY, hashBlock);
+    LogPrint(BCLog::LEVELDB, "%s: %u pending changes (%.1f kB)\n", __func__, pending.size(), batch.SizeEstimate() * (1.0 / 1024.0));
+    if (!WriteBatch(batch, true))
+        return false;
+    pending.clear();
+    return true;
+}
+
+uint256 CDBBufferedWrapper::GetBestBlock() const
+{
+    uint256 hashBlock;
+    if (!CDBWrapper::Read(BEST_BLOCK_KEY, hashBlock))
+        return uint256();
+    return hashBlock;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
@@ -9,6 +9,8 @@
 #include <fs.h>
 #include <serialize.h>
 #include <streams.h>
+#include <sync.h>
+#include <uint256.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <version.h>
@@ -16,6 +18,8 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <map>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
@@ -27,6 +31,27 @@ public:
 
 class CDBWrapper;
 
+/** Storage options of one database, chosen by its owner. */
+struct DBOptions
+{
+    //! compress the table blocks with Snappy, when LevelDB is built with it
+    bool compression = false;
+    //! approximate size of the table blocks, the unit in which LevelDB reads from disk
+    size_t block_size = 4096;
+    //! bits per key of the bloom filters that let reads skip tables, 0 for none
+    int bloom_bits = 10;
+    //! size of the memtable, 0 for a quarter of the cache; up to two are held in memory
+    size_t write_buffer_size = 0;
+    //! size at which the table files are cut
+    size_t max_file_size = 2 << 20;
+    //! level-0 files at which they are compacted, writes are delayed, and writes are stopped
+    int l0_compaction_trigger = 4;
+    int l0_slowdown_writes_trigger = 8;
+    int l0_stop_writes_trigger = 12;
+    //! threads a compaction of level-0 into level-1 is split over
+    int max_subcompactions = 1;
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -111,6 +136,25 @@ public:
         ssKey.clear();
     }
 
+    /** Write a key and value that are already serialized with SER_DISK and CLIENT_VERSION. */
+    void WriteSerialized(const std::string& key, const std::string& value)
+    {
+        ssValue.write(value.data(), value.size());
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        leveldb::Slice slValue(ssValue.data(), ssValue.size());
+
+        batch.Put(key, slValue);
+        size_estimate += 3 + (key.size() > 127) + key.size() + (slValue.size() > 127) + slValue.size();
+        ssValue.clear();
+    }
+
+    /** Erase a key that is already serialized with SER_DISK and CLIENT_VERSION. */
+    void EraseSerialized(const std::string& key)
+    {
+        batch.Delete(key);
+        size_estimate += 2 + (key.size() > 127) + key.size();
+    }
+
     size_t SizeEstimate() const { return size_estimate; }
 };
 
@@ -171,6 +215,18 @@ public:
         return piter->value().size();
     }
 
+    /** Return the current key as it is stored. */
+    std::string GetKeySerialized() const {
+        return piter->key().ToString();
+    }
+
+    /** Return the current value serialized, without the obfuscation it is stored with. */
+    std::string GetValueSerialized() const {
+        CDataStream ssValue(piter->value().data(), piter->value().data() + piter->value().size(), SER_DISK, CLIENT_VERSION);
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        return ssValue.str();
+    }
+
 };
 
 class CDBWrapper
@@ -204,6 +260,13 @@ private:
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
+    //! the compaction totals of the database already added to the metrics
+    Mutex m_compaction_mutex;
+    std::vector<uint64_t> m_compaction_totals GUARDED_BY(m_compaction_mutex);
+
+    //! add what the compactions did since the last call to the metrics
+    void UpdateCompactionMetrics();
+
     //! the key under which the obfuscation key is stored
     static const std::string OBFUSCATE_KEY_KEY;
 
@@ -220,8 +283,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] db_options  Compression, block size and bloom filter of the tables.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const DBOptions& db_options = DBOptions());
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -349,4 +413,119 @@ public:
 
 };
 
+/**
+ * A CDBWrapper whose changes are kept in memory until Flush writes them in one batch,
+ * together with the hash of the block they are consistent with. Read and Exists see
+ * the pending changes, iterators only see what was flushed. The pending changes have
+ * their own lock, so a view is read while the chain state is flushed.
+ */
+class CDBBufferedWrapper : public CDBWrapper
+{
+private:
+    mutable Mutex m_pending_mutex;
+    //! serialized key -> serialized value, or nothing for a pending erase
+    std::map<std::string, std::pair<bool, std::string>> pending GUARDED_BY(m_pending_mutex);
+
+    //! the key under which the best block is stored
+    static const std::string BEST_BLOCK_KEY;
+
+    template <typename T>
+    static std::string Serialize(const T& obj)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << obj;
+        return std::string(ss.data(), ss.size());
+    }
+
+public:
+    using CDBWrapper::CDBWrapper;
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        const std::string strKey = Serialize(key);
+        std::string strValue;
+        bool fPending = false;
+        {
+            LOCK(m_pending_mutex);
+            auto it = pending.find(strKey);
+            if (it != pending.end()) {
+                if (!it->second.first)
+                    return false;
+                strValue = it->second.second;
+                fPending = true;
+            }
+        }
+        // Flushed changes are cleared only once written, so a key not pending is read from disk.
+        if (!fPending)
+            return CDBWrapper::Read(key, value);
+        try {
+            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> value;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    template <typename K>
+    bool Exists(const K& key) const
+    {
+        LOCK(m_pending_mutex);
+        auto it = pending.find(Serialize(key));
+        if (it == pending.end())
+            return CDBWrapper::Exists(key);
+        return it->second.first;
+    }
+
+    template <typename K, typename V>
+    void Write(const K& key, const V& value)
+    {
+        std::string strKey = Serialize(key);
+        std::string strValue = Serialize(value);
+        LOCK(m_pending_mutex);
+        pending[std::move(strKey)] = std::make_pair(true, std::move(strValue));
+    }
+
+    template <typename K>
+    void Erase(const K& key)
+    {
+        LOCK(m_pending_mutex);
+        pending[Serialize(key)] = std::make_pair(false, std::string());
+    }
+
+    /**
+     * The keys written since the last flush that start with prefix, which an iterator over the
+     * database does not see yet.
+     */
+    template <typename K>
+    std::vector<K> PendingKeys(const char prefix) const
+    {
+        std::vector<K> keys;
+        LOCK(m_pending_mutex);
+        for (auto it = pending.lower_bound(std::string(1, prefix)); it != pending.end() && it->first[0] == prefix; ++it) {
+            if (!it->second.first)
+                continue;
+            try {
+                CDataStream ssKey(it->first.data(), it->first.data() + it->first.size(), SER_DISK, CLIENT_VERSION);
+                K key;
+                ssKey >> key;
+                keys.push_back(key);
+            } catch (const std::exception&) {
+            }
+        }
+        return keys;
+    }
+
+    /**
+     * Write the pending changes and the best block in one synced batch.
+     * @param[in] hashBlock   the block the database is consistent with once written.
+     * @return                false if the batch cannot be written, the changes are kept.
+     */
+    bool Flush(const uint256& hashBlock);
+
+    /** Return the block the database was last flushed at, null if it never was. */
+    uint256 GetBestBlock() const;
+};
+
 #endif // BITCOIN_DBWRAPPER_H
@@ -0,0 +1,165 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fec.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+namespace {
+
+/** Log and exponent tables of GF(2^8), on the polynomial x^8 + x^4 + x^3 + x^2 + 1. */
+struct GFTables
+{
+    uint8_t exp[512];
+    uint8_t log[256];
+
+    GFTables()
+    {
+        unsigned int x = 1;
+        for (int i = 0; i < 255; i++) {
+            exp[i] = x;
+            log[x] = i;
+            x <<= 1;
+            if (x & 0x100)
+                x ^= 0x11d;
+        }
+        for (int i = 255; i < 512; i++) {
+            exp[i] = exp[i - 255];
+        }
+        log[0] = 0;
+    }
+};
+
+static const GFTables gf;
+
+static inline uint8_t GFInv(uint8_t a)
+{
+    assert(a);
+    return gf.exp[255 - gf.log[a]];
+}
+
+/** dst ^= c * src, over n bytes */
+static void GFMulAdd(uint8_t* dst, const uint8_t* src, uint8_t c, size_t n)
+{
+    if (c == 0)
+        return;
+    const unsigned int logc = gf.log[c];
+    for (size_t i = 0; i < n; i++) {
+        if (src[i])
+            dst[i] ^= gf.exp[logc + gf.log[src[i]]];
+    }
+}
+
+/** row *= c, over n bytes */
+static void GFScale(uint8_t* row, uint8_t c, size_t n)
+{
+    const unsigned int logc = gf.log[c];
+    for (size_t i = 0; i < n; i++) {
+        if (row[i])
+            row[i] = gf.exp[logc + gf.log[row[i]]];
+    }
+}
+
+} // namespace
+
+CFECCode::CFECCode(size_t nDataIn, size_t nParityIn, size_t nChunkSizeIn) : nData(nDataIn), nParity(nParityIn), nChunkSize(nChunkSizeIn)
+{
+    assert(nData > 0 && nData + nParity <= MAX_FEC_CHUNKS && nChunkSize > 0);
+}
+
+uint8_t CFECCode::Coefficient(size_t i, size_t j) const
+{
+    // Cauchy matrix 1 / (x_i + y_j), x_i = nData + i and y_j = j all distinct: every square
+    // submatrix is invertible, so any nData chunks are enough.
+    return GFInv((nData + i) ^ j);
+}
+
+std::vector<std::vector<uint8_t>> CFECCode::Encode(const std::vector<uint8_t>& data) const
+{
+    assert(data.size() <= nData * nChunkSize);
+    std::vector<std::vector<uint8_t>> chunks(nData + nParity, std::vector<uint8_t>(nChunkSize, 0));
+    for (size_t j = 0; j < nData; j++) {
+        const size_t nOffset = j * nChunkSize;
+        if (nOffset < data.size())
+            memcpy(chunks[j].data(), data.data() + nOffset, std::min(nChunkSize, data.size() - nOffset));
+    }
+    for (size_t i = 0; i < nParity; i++) {
+        for (size_t j = 0; j < nData; j++) {
+            GFMulAdd(chunks[nData + i].data(), chunks[j].data(), Coefficient(i, j), nChunkSize);
+        }
+    }
+    return chunks;
+}
+
+bool CFECCode::Decode(const std::map<size_t, std::vector<uint8_t>>& chunks, size_t nSize, std::vector<uint8_t>& data) const
+{
+    if (nSize > nData * nChunkSize || chunks.size() < nData)
+        return false;
+    for (const auto& chunk : chunks) {
+        if (chunk.first >= nData + nParity || chunk.second.size() != nChunkSize)
+            return false;
+    }
+
+    data.assign(nData * nChunkSize, 0);
+    std::vector<size_t> vMissing;
+    for (size_t j = 0; j < nData; j++) {
+        auto it = chunks.find(j);
+        if (it != chunks.end()) {
+            memcpy(data.data() + j * nChunkSize, it->second.data(), nChunkSize);
+        } else {
+            vMissing.push_back(j);
+        }
+    }
+
+    if (!vMissing.empty()) {
+        // Each parity chunk used, less the data chunks received, is a combination of the
+        // missing ones: solve for them by Gaussian elimination.
+        const size_t e = vMissing.size();
+        std::vector<std::vector<uint8_t>> matrix, rhs;
+        for (auto it = chunks.lower_bound(nData); it != chunks.end() && matrix.size() < e; ++it) {
+            const size_t i = it->first - nData;
+            std::vector<uint8_t> row(e);
+            for (size_t m = 0; m < e; m++) {
+                row[m] = Coefficient(i, vMissing[m]);
+            }
+            std::vector<uint8_t> value = it->second;
+            for (size_t j = 0; j < nData; j++) {
+                if (chunks.count(j))
+                    GFMulAdd(value.data(), data.data() + j * nChunkSize, Coefficient(i, j), nChunkSize);
+            }
+            matrix.push_back(std::move(row));
+            rhs.push_back(std::move(value));
+        }
+        if (matrix.size() < e)
+            return false;
+
+        for (size_t col = 0; col < e; col++) {
+            size_t pivot = col;
+            while (pivot < e && matrix[pivot][col] == 0)
+                pivot++;
+            if (pivot == e)
+                return false;
+            std::swap(matrix[pivot], matrix[col]);
+            std::swap(rhs[pivot], rhs[col]);
+            const uint8_t inv = GFInv(matrix[col][col]);
+            GFScale(matrix[col].data(), inv, e);
+            GFScale(rhs[col].data(), inv, nChunkSize);
+            for (size_t r = 0; r < e; r++) {
+                const uint8_t c = matrix[r][col];
+                if (r == col || c == 0)
+                    continue;
+                GFMulAdd(matrix[r].data(), matrix[col].data(), c, e);
+                GFMulAdd(rhs[r].data(), rhs[col].data(), c, nChunkSize);
+            }
+        }
+        for (size_t m = 0; m < e; m++) {
+            memcpy(data.data() + vMissing[m] * nChunkSize, rhs[m].data(), nChunkSize);
+        }
+    }
+
+    data.resize(nSize);
+    return true;
+}
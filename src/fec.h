@@ -0,0 +1,50 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_FEC_H
+#define LAVA_FEC_H
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** Most chunks, data and parity, a message is coded into: the code works on GF(2^8). */
+static const size_t MAX_FEC_CHUNKS = 256;
+
+/**
+ * Systematic Reed-Solomon erasure code over GF(2^8), with a Cauchy matrix: a message cut
+ * into nData chunks is sent along with nParity chunks computed from them, and any nData
+ * of the nData + nParity chunks received give the message back. Chunks 0 to nData - 1
+ * are the message itself, the last one padded with zeros, and cost nothing to decode.
+ */
+class CFECCode
+{
+public:
+    CFECCode(size_t nDataIn, size_t nParityIn, size_t nChunkSizeIn);
+
+    size_t Data() const { return nData; }
+    size_t Parity() const { return nParity; }
+    size_t ChunkSize() const { return nChunkSize; }
+
+    /** Cut data, at most nData * nChunkSize bytes long, into the data and parity chunks. */
+    std::vector<std::vector<uint8_t>> Encode(const std::vector<uint8_t>& data) const;
+
+    /**
+     * Rebuild the message of nSize bytes from chunks, indexed by their number, of which
+     * there must be at least nData. Data chunks are recovered from as many parity chunks
+     * as are missing.
+     */
+    bool Decode(const std::map<size_t, std::vector<uint8_t>>& chunks, size_t nSize, std::vector<uint8_t>& data) const;
+
+private:
+    /** Coefficient of data chunk j in parity chunk i */
+    uint8_t Coefficient(size_t i, size_t j) const;
+
+    const size_t nData;
+    const size_t nParity;
+    const size_t nChunkSize;
+};
+
+#endif // LAVA_FEC_H
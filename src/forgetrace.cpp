@@ -0,0 +1,106 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <forgetrace.h>
+
+#include <util/time.h>
+
+CForgeTrace g_forge_trace;
+
+CForgeTraceEntry* CForgeTrace::Find(int height)
+{
+    // Heights are traced in order, the one looked for is almost always the last.
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->height == height)
+            return &*it;
+    }
+    return nullptr;
+}
+
+CForgeTraceEntry* CForgeTrace::FindBlock(const uint256& hash)
+{
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->hash == hash)
+            return &*it;
+    }
+    return nullptr;
+}
+
+void CForgeTrace::DeadlineUpdated(int height, uint64_t nDeadline, int64_t nScheduledTime)
+{
+    LOCK(cs);
+    CForgeTraceEntry* entry = Find(height);
+    // A height forged already comes again after a reorg, trace it anew.
+    if (!entry || entry->nFiredTime != 0) {
+        entries.emplace_back();
+        if (entries.size() > MAX_ENTRIES)
+            entries.pop_front();
+        entry = &entries.back();
+        entry->height = height;
+    }
+    entry->nDeadline = nDeadline;
+    entry->nScheduledTime = nScheduledTime;
+}
+
+void CForgeTrace::ForgeFired(int height)
+{
+    const int64_t now = GetTimeMicros();
+    LOCK(cs);
+    CForgeTraceEntry* entry = Find(height);
+    if (entry && entry->nFiredTime == 0)
+        entry->nFiredTime = now;
+}
+
+void CForgeTrace::BlockForged(int height, const uint256& hash, int64_t nCreateDuration)
+{
+    LOCK(cs);
+    CForgeTraceEntry* entry = Find(height);
+    if (!entry)
+        return;
+    entry->hash = hash;
+    entry->nCreateDuration = nCreateDuration;
+    entry->nProcessDuration = 0;
+    entry->nAnnounceTime = 0;
+}
+
+void CForgeTrace::BlockProcessed(const uint256& hash, int64_t nProcessDuration)
+{
+    LOCK(cs);
+    CForgeTraceEntry* entry = FindBlock(hash);
+    if (entry)
+        entry->nProcessDuration = nProcessDuration;
+}
+
+void CForgeTrace::BlockAnnounced(const uint256& hash)
+{
+    const int64_t now = GetTimeMicros();
+    LOCK(cs);
+    CForgeTraceEntry* entry = FindBlock(hash);
+    if (entry && entry->nAnnounceTime == 0)
+        entry->nAnnounceTime = now;
+}
+
+void CForgeTrace::BlockArrived(int height, const uint256& hash, uint64_t nDeadline, int64_t nArrivalTime, bool fCached)
+{
+    LOCK(cs);
+    CForgeTraceEntry* entry = Find(height);
+    if (!entry || entry->hash == hash || entry->competitors.size() >= MAX_COMPETITORS)
+        return;
+    for (const CForgeCompetitor& competitor : entry->competitors) {
+        if (competitor.hash == hash)
+            return;
+    }
+    CForgeCompetitor competitor;
+    competitor.hash = hash;
+    competitor.nDeadline = nDeadline;
+    competitor.nArrivalTime = nArrivalTime;
+    competitor.fCached = fCached;
+    entry->competitors.push_back(competitor);
+}
+
+std::vector<CForgeTraceEntry> CForgeTrace::GetEntries() const
+{
+    LOCK(cs);
+    return std::vector<CForgeTraceEntry>(entries.begin(), entries.end());
+}
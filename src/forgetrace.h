@@ -0,0 +1,78 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_FORGETRACE_H
+#define LAVA_FORGETRACE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+/** A block of another forger for a height we had a deadline for. */
+struct CForgeCompetitor
+{
+    uint256 hash;
+    uint64_t nDeadline;         //!< in seconds
+    int64_t nArrivalTime;       //!< when ProcessNewBlock got it, in microseconds
+    bool fCached;               //!< it arrived before its deadline and waited in the block cache
+};
+
+/** How forging one height went, all times are system time in microseconds. */
+struct CForgeTraceEntry
+{
+    int height;
+    uint64_t nDeadline;         //!< our best deadline, in seconds
+    int64_t nScheduledTime;     //!< when the deadline allowed the block to be forged
+    int64_t nFiredTime;         //!< when the forge timer ran, 0 if it did not
+    int64_t nCreateDuration;    //!< how long assembling the block took
+    int64_t nProcessDuration;   //!< how long ProcessNewBlock took with it
+    int64_t nAnnounceTime;      //!< when it was first sent to a peer, 0 if it was not
+    uint256 hash;               //!< our block, null if none was forged
+    std::vector<CForgeCompetitor> competitors;
+
+    CForgeTraceEntry() : height(0), nDeadline(0), nScheduledTime(0), nFiredTime(0), nCreateDuration(0),
+        nProcessDuration(0), nAnnounceTime(0) {}
+};
+
+/**
+ * A trace of the last heights we forged or had a deadline for: how late our block went
+ * out and reached the peers, and when the competing blocks arrived, to measure the
+ * blocks lost to timer latency and block assembly.
+ */
+class CForgeTrace
+{
+public:
+    static const size_t MAX_ENTRIES = 200;
+    static const size_t MAX_COMPETITORS = 16;
+
+    /** A new best deadline for height, which may be forged at nScheduledTime. */
+    void DeadlineUpdated(int height, uint64_t nDeadline, int64_t nScheduledTime);
+    /** The forge timer of height ran. */
+    void ForgeFired(int height);
+    /** Our block for height was assembled, in nCreateDuration. */
+    void BlockForged(int height, const uint256& hash, int64_t nCreateDuration);
+    /** ProcessNewBlock returned for our block, after nProcessDuration. */
+    void BlockProcessed(const uint256& hash, int64_t nProcessDuration);
+    /** A block was announced to a peer; recorded the first time if it is ours. */
+    void BlockAnnounced(const uint256& hash);
+    /** A block arrived for height; recorded if it is not ours and we had a deadline for height. */
+    void BlockArrived(int height, const uint256& hash, uint64_t nDeadline, int64_t nArrivalTime, bool fCached);
+
+    /** The entries, oldest first. */
+    std::vector<CForgeTraceEntry> GetEntries() const;
+
+private:
+    CForgeTraceEntry* Find(int height) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    CForgeTraceEntry* FindBlock(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    mutable Mutex cs;
+    std::deque<CForgeTraceEntry> entries GUARDED_BY(cs);
+};
+
+extern CForgeTrace g_forge_trace;
+
+#endif // LAVA_FORGETRACE_H
@@ -1,4 +1,6 @@
 #include <fspool.h>
+#include <chainparams.h>
+#include <ticket.h>
 #include <validation.h>
 
 static const char FSPOOL_KEY = 'F';
@@ -6,10 +8,23 @@ static const char FSPOOL_KEY = 'F';
 std::unique_ptr<CFSPool> pfspool;
 
 CFSPool::CFSPool(size_t nCacheSize, bool fMemory, bool fWipe)
-    : CDBWrapper(GetDataDir() / "fspool", nCacheSize, fMemory, fWipe) 
+    : CDBWrapper(GetDataDir() / "fspool", nCacheSize, fMemory, fWipe),
+    nRetainedSlots(DEFAULT_FIRESTONE_SLOTS)
 {
 }
 
+void CFSPool::SetRetainedSlots(const int nSlots)
+{
+    LOCK(cs);
+    nRetainedSlots = std::max(nSlots, MIN_FIRESTONE_SLOTS);
+}
+
+int CFSPool::FirstRetainedSlot(const int slotIndex)
+{
+    LOCK(cs);
+    return std::max(slotIndex - nRetainedSlots + 1, 0);
+}
+
 bool CFSPool::ReadFreshFstx(std::vector<CTransaction>& txs, int slotindex){
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     pcursor->Seek(std::make_pair(FSPOOL_KEY,std::make_pair(slotindex, uint256())));
@@ -34,11 +49,29 @@ bool CFSPool::ReadFreshFstx(std::vector<CTransaction>& txs, int slotindex){
     return true;
 }
 
+void CFSPool::addFstx(const int slotindex, const CTransactionRef& tx)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs);
+    // A fstx of a slot only on disk is found there, see GetFstxBySlotIndex.
+    if (slotindex < firstSlot)
+        return;
+    FstxInSlot[slotindex].emplace_back(tx);
+    auto& firestone = tx->vin[0].prevout;
+    fstxByFirestone.emplace(firestone, std::make_pair(slotindex, tx));
+    if (!pcoinsTip->AccessCoin(firestone).IsSpent()) {
+        readyInSlot[slotindex][tx->GetHash()] = tx;
+    }
+}
+
 bool CFSPool::WriteFstx(CTransaction tx, int slotindex, uint256 txid){
     auto key = std::make_pair(FSPOOL_KEY, std::make_pair(slotindex, txid));
     if (!Exists(key)) {
         // add tx into cache
-        FstxInSlot[slotindex].emplace_back(MakeTransactionRef(tx));
+        {
+            LOCK2(cs_main, cs);
+            addFstx(slotindex, MakeTransactionRef(tx));
+        }
     
         // add tx into disk
         return Write(std::make_pair(FSPOOL_KEY, std::make_pair(slotindex, txid)), tx);
@@ -48,28 +81,126 @@ bool CFSPool::WriteFstx(CTransaction tx, int slotindex, uint256 txid){
 
 bool CFSPool::RemoveSlot(int slotindex){
     // clear the fstx in cache
-    FstxInSlot[slotindex].clear();
+    {
+        LOCK(cs);
+        for (auto& tx : FstxInSlot[slotindex]) {
+            auto range = fstxByFirestone.equal_range(tx->vin[0].prevout);
+            for (auto it = range.first; it != range.second; ) {
+                it = it->second.first == slotindex ? fstxByFirestone.erase(it) : std::next(it);
+            }
+        }
+        FstxInSlot.erase(slotindex);
+        readyInSlot.erase(slotindex);
+    }
 
-    // clear the disk
+    // clear the disk in one batch
+    CDBBatch batch(*this);
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
-    pcursor->Seek(std::make_pair(FSPOOL_KEY,std::make_pair(slotindex, uint256())));
+    auto begin = std::make_pair(FSPOOL_KEY, std::make_pair(slotindex, uint256()));
+    auto end = begin;
+    pcursor->Seek(begin);
 
     while (pcursor->Valid()) {
         std::pair<char, std::pair<int, uint256>> key;
         if (pcursor->GetKey(key) && key.first == FSPOOL_KEY) {
             if (key.second.first == slotindex){
-                Erase(key);
+                batch.Erase(key);
+                end = key;
             }
             pcursor->Next();
         } else {
             break;
         }
     }
+    if (!WriteBatch(batch)) {
+        return false;
+    }
+    CompactRange(begin, end);
     return true;
 }
 
 std::vector<CTransactionRef> CFSPool::GetFstxBySlotIndex(const int slotIndex){
-    return FstxInSlot[slotIndex];
+    {
+        LOCK(cs);
+        if (slotIndex >= firstSlot) {
+            auto it = FstxInSlot.find(slotIndex);
+            return it != FstxInSlot.end() ? it->second : std::vector<CTransactionRef>();
+        }
+    }
+    std::vector<CTransaction> txs;
+    ReadFreshFstx(txs, slotIndex);
+    std::vector<CTransactionRef> refs;
+    refs.reserve(txs.size());
+    for (auto& tx : txs) {
+        refs.emplace_back(MakeTransactionRef(std::move(tx)));
+    }
+    return refs;
+}
+
+void CFSPool::evictSlotsBelow(const int slotindex)
+{
+    AssertLockHeld(cs);
+    if (slotindex <= firstSlot)
+        return;
+    for (auto it = FstxInSlot.begin(); it != FstxInSlot.end() && it->first < slotindex;) {
+        for (auto& tx : it->second) {
+            auto range = fstxByFirestone.equal_range(tx->vin[0].prevout);
+            for (auto fit = range.first; fit != range.second; ) {
+                fit = fit->second.first == it->first ? fstxByFirestone.erase(fit) : std::next(fit);
+            }
+        }
+        readyInSlot.erase(it->first);
+        it = FstxInSlot.erase(it);
+    }
+    firstSlot = slotindex;
+}
+
+std::vector<CTransactionRef> CFSPool::GetReadyFstxBySlotIndex(const int slotIndex){
+    std::vector<CTransactionRef> txs;
+    LOCK(cs);
+    auto it = readyInSlot.find(slotIndex);
+    if (it != readyInSlot.end()) {
+        txs.reserve(it->second.size());
+        for (auto& ready : it->second) {
+            txs.emplace_back(ready.second);
+        }
+    }
+    return txs;
+}
+
+void CFSPool::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted)
+{
+    LOCK(cs);
+    // Once a slot opens, only the slots retained are kept in memory; a disconnect reopens the previous one at most.
+    const int slotLength = Params().SlotLength();
+    if (pindex->nHeight % slotLength == 0) {
+        evictSlotsBelow(pindex->nHeight / slotLength - nRetainedSlots + 1);
+    }
+    for (const auto& tx : block->vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const auto& in : tx->vin) {
+            auto range = fstxByFirestone.equal_range(in.prevout);
+            for (auto it = range.first; it != range.second; ++it) {
+                readyInSlot[it->second.first].erase(it->second.second->GetHash());
+            }
+        }
+    }
+}
+
+void CFSPool::BlockDisconnected(const std::shared_ptr<const CBlock> &block)
+{
+    LOCK(cs);
+    for (const auto& tx : block->vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const auto& in : tx->vin) {
+            auto range = fstxByFirestone.equal_range(in.prevout);
+            for (auto it = range.first; it != range.second; ++it) {
+                readyInSlot[it->second.first][it->second.second->GetHash()] = it->second.second;
+            }
+        }
+    }
 }
 
 bool CFSPool::LoadFstxFromDisk(const int slotindex){
@@ -79,15 +210,37 @@ bool CFSPool::LoadFstxFromDisk(const int slotindex){
         return false;
     }
     
-    if (!txs.empty()){
-        for (auto fstx:txs){
-            FstxInSlot[slotindex].emplace_back(MakeTransactionRef(fstx));
-        }
+    LOCK2(cs_main, cs);
+    for (auto& fstx : txs){
+        addFstx(slotindex, MakeTransactionRef(std::move(fstx)));
     }
 
     return true;
 }
 
+bool CFSPool::LoadAllFstxFromDisk(const int minslotindex, const int maxslotindex){
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(FSPOOL_KEY, std::make_pair(0, uint256())));
+
+    // One pass over the fspool, instead of one seek per slot.
+    LOCK2(cs_main, cs);
+    firstSlot = minslotindex;
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<int, uint256>> key;
+        if (!pcursor->GetKey(key) || key.first != FSPOOL_KEY)
+            break;
+        if (key.second.first >= minslotindex && key.second.first <= maxslotindex) {
+            CMutableTransaction transaction;
+            if (!pcursor->GetValue(transaction)) {
+                return false;
+            }
+            addFstx(key.second.first, MakeTransactionRef(std::move(transaction)));
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
 bool LoadFstx(const uint32_t slotlength)
 {
     LogPrintf("%s: Load Fstx from block database...\n", __func__);
@@ -95,15 +248,12 @@ bool LoadFstx(const uint32_t slotlength)
         // new chain
         return true;
     }else{
-        // get slot index one by one
         auto slotTip = chainActive.Height() / slotlength + 1;
-        for (auto i = 0; i <= slotTip; i++) {
-            try {
-                if (!pfspool->LoadFstxFromDisk(i))
-                    return error("%s: failed to read Fstx from disk, slot: %s", __func__, i);
-            } catch (const std::runtime_error& e) {
-                return error("%s: failure: %s", __func__, e.what());
-            }
+        try {
+            if (!pfspool->LoadAllFstxFromDisk(pfspool->FirstRetainedSlot(slotTip - 1), slotTip))
+                return error("%s: failed to read Fstx from disk", __func__);
+        } catch (const std::runtime_error& e) {
+            return error("%s: failure: %s", __func__, e.what());
         }
         return true;
     }
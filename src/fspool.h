@@ -3,12 +3,16 @@
 
 #include <dbwrapper.h>
 #include <primitives/transaction.h>
+#include <sync.h>
+#include <validationinterface.h>
+
+extern CCriticalSection cs_main;
 //#include <validation.h>
 
 /** 
 * Abstract view on the firestone used transaction dataset. 
 */
-class CFSPool : public CDBWrapper
+class CFSPool : public CDBWrapper, public CValidationInterface
 {
 public:
      CFSPool(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
@@ -38,20 +42,59 @@ public:
     */
     bool RemoveSlot(int slotindex);
 
+    /** The fstx of a slot, read from disk for the slots no longer kept in memory.*/
     std::vector<CTransactionRef> GetFstxBySlotIndex(const int slotIndex);
 
+    /** 
+    * The fstx of a slot, whose firestone is not spent on the active chain.
+    * The set is kept up to date from BlockConnected and BlockDisconnected, so no coin is looked up here.
+    * @param[in]   slotIndex       the slot, at which the fstx are USABLE.
+    */
+    std::vector<CTransactionRef> GetReadyFstxBySlotIndex(const int slotIndex);
+
     /** 
     * Load the fstx set at slotindex via fspool read.
     * @param[in]   slotindex, from which fstx is load.
     */
     bool LoadFstxFromDisk(const int slotindex);
 
+    /** 
+    * Load the fstx sets of the slots from minslotindex up to maxslotindex in one pass over the fspool.
+    * @param[in]   minslotindex, the fstx of earlier slots are left on disk.
+    * @param[in]   maxslotindex, the fstx of later slots are skipped.
+    */
+    bool LoadAllFstxFromDisk(const int minslotindex, const int maxslotindex);
+
+    /** Keep the fstx of nSlots slots up to the current one in memory, at least MIN_FIRESTONE_SLOTS.*/
+    void SetRetainedSlots(const int nSlots);
+
+    /** The first slot whose fstx are loaded, given the slot of the tip.*/
+    int FirstRetainedSlot(const int slotIndex);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block) override;
+
 private:
+    /** Index a fstx of the slot, it is ready if its firestone is unspent in pcoinsTip.*/
+    void addFstx(const int slotindex, const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs);
+
+    /** Drop the fstx of the slots below slotindex from memory, they stay on disk.*/
+    void evictSlotsBelow(const int slotindex) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    CCriticalSection cs;
     /** This map records fstx in each slot, one slot is 2048 blocks.*/
-    std::map<int, std::vector<CTransactionRef>> FstxInSlot;  
+    std::map<int, std::vector<CTransactionRef>> FstxInSlot GUARDED_BY(cs);
+    /** The fstx by the firestone they spend, with the slot they are USABLE at.*/
+    std::multimap<COutPoint, std::pair<int, CTransactionRef>> fstxByFirestone GUARDED_BY(cs);
+    /** The fstx in each slot, whose firestone is not spent, by txid.*/
+    std::map<int, std::map<uint256, CTransactionRef>> readyInSlot GUARDED_BY(cs);
+    /** The fstx of the slots below are only on disk.*/
+    int firstSlot GUARDED_BY(cs) = 0;
+    int nRetainedSlots GUARDED_BY(cs);
 };
 
-/** Global variable that points to the fspool (protected by cs_main) */
+/** Global variable that points to the fspool (set with cs_main held, the fstx in memory have their own lock) */
 extern std::unique_ptr<CFSPool> pfspool;
 
 bool LoadFstx(const uint32_t slotlength);
@@ -7,6 +7,9 @@
 #include <chainparams.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <metrics.h>
+#include <poolserver.h>
+#include <rpc/cbor.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -145,6 +148,13 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Whether the client asked for a CBOR reply in its Accept header. */
+static bool AcceptsCBOR(HTTPRequest* req)
+{
+    std::pair<bool, std::string> accept = req->GetHeader("accept");
+    return accept.first && accept.second.find(CBOR_CONTENT_TYPE) != std::string::npos;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -185,14 +195,19 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         jreq.URI = req->GetURI();
 
         std::string strReply;
+        bool fCBOR = false;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
             UniValue result = tableRPC.execute(jreq);
 
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Send reply, as CBOR to the clients accepting it
+            fCBOR = AcceptsCBOR(req);
+            if (fCBOR)
+                EncodeCBOR(JSONRPCReplyObj(result, NullUniValue, jreq.id), strReply);
+            else
+                strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
         // array of requests
         } else if (valRequest.isArray())
@@ -200,8 +215,8 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
+        req->WriteHeader("Content-Type", fCBOR ? CBOR_CONTENT_TYPE : "application/json");
+        req->WriteReply(HTTP_OK, std::move(strReply));
     } catch (const UniValue& objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
@@ -212,6 +227,45 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** How much of a request body is searched for the method called */
+static const size_t JSONRPC_CLASSIFY_PEEK_SIZE = 1024;
+
+/** Find the method a JSON-RPC request calls, the first one of a batch, without parsing the whole body. */
+static std::string FindJSONRPCMethod(const std::string& body)
+{
+    static const std::string key = "\"method\"";
+    size_t pos = body.find(key);
+    if (pos == std::string::npos)
+        return "";
+    pos = body.find_first_not_of(" \t\r\n", pos + key.size());
+    if (pos == std::string::npos || body[pos] != ':')
+        return "";
+    pos = body.find_first_not_of(" \t\r\n", pos + 1);
+    if (pos == std::string::npos || body[pos] != '"')
+        return "";
+    const size_t end = body.find('"', pos + 1);
+    if (end == std::string::npos)
+        return "";
+    return body.substr(pos + 1, end - pos - 1);
+}
+
+/** Queue the calls of wallet endpoints and methods as wallet work, the others by the category of their method. */
+static HTTPWorkClass ClassifyJSONRPC(HTTPRequest* req, const std::string &)
+{
+    if (req->GetURI().compare(0, 8, "/wallet/") == 0)
+        return HTTP_WORK_WALLET;
+    const CRPCCommand* pcmd = tableRPC[FindJSONRPCMethod(req->PeekBody(JSONRPC_CLASSIFY_PEEK_SIZE))];
+    if (!pcmd)
+        return HTTP_WORK_CHAIN;
+    if (pcmd->category == "poc" || pcmd->category == "mining")
+        return HTTP_WORK_MINING;
+    if (pcmd->category == "wallet")
+        return HTTP_WORK_WALLET;
+    if (pcmd->category == "control" || pcmd->category == "network" || pcmd->category == "hidden")
+        return HTTP_WORK_ADMIN;
+    return HTTP_WORK_CHAIN;
+}
+
 static bool InitRPCAuthentication()
 {
     if (gArgs.GetArg("-rpcpassword", "") == "")
@@ -240,9 +294,9 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, ClassifyJSONRPC);
     if (g_wallet_init_interface.HasWalletSupport()) {
-        RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
+        RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, ClassifyJSONRPC);
     }
     struct event_base* eventBase = EventBase();
     assert(eventBase);
@@ -251,6 +305,70 @@ bool StartHTTPRPC()
     return true;
 }
 
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string&)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only GET is allowed");
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, GetMetrics().ToPrometheus());
+    return true;
+}
+
+void StartHTTPMetrics()
+{
+    LogPrint(BCLog::RPC, "Starting HTTP metrics endpoint\n");
+    // Scrapes are served with the other administrative work, not ahead of the miners.
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics, [](HTTPRequest*, const std::string&) { return HTTP_WORK_ADMIN; });
+}
+
+void StopHTTPMetrics()
+{
+    UnregisterHTTPHandler("/metrics", true);
+}
+
+static bool HTTPReq_Pool(HTTPRequest* req, const std::string&)
+{
+    if (req->GetRequestMethod() != HTTPRequest::POST) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only POST is allowed");
+        return false;
+    }
+    // Pools authenticate as the JSON-RPC clients do.
+    std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
+    std::string authUser;
+    if (!authHeader.first || !RPCAuthorized(authHeader.second, authUser)) {
+        if (authHeader.first) {
+            LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", req->GetPeer().ToString());
+            MilliSleep(250);
+        }
+        req->WriteHeader("WWW-Authenticate", WWW_AUTH_HEADER_DATA);
+        req->WriteReply(HTTP_UNAUTHORIZED);
+        return false;
+    }
+
+    const std::string body = req->ReadBody();
+    if (body.empty() || body.size() % POOL_SHARE_SIZE != 0 || body.size() / POOL_SHARE_SIZE > MAX_POOL_SHARES) {
+        req->WriteReply(HTTP_BAD_REQUEST, strprintf("The body must hold 1 to %u shares of %u bytes", MAX_POOL_SHARES, POOL_SHARE_SIZE));
+        return false;
+    }
+    const std::vector<uint8_t> results = g_pool_server.SubmitShares(Span<const unsigned char>((const unsigned char*)body.data(), body.size()));
+    req->WriteHeader("Content-Type", "application/octet-stream");
+    req->WriteReply(HTTP_OK, std::string(results.begin(), results.end()));
+    return true;
+}
+
+void StartHTTPPool()
+{
+    LogPrint(BCLog::RPC, "Starting HTTP pool endpoint\n");
+    RegisterHTTPHandler("/pool", true, HTTPReq_Pool, [](HTTPRequest*, const std::string&) { return HTTP_WORK_MINING; });
+}
+
+void StopHTTPPool()
+{
+    UnregisterHTTPHandler("/pool", true);
+}
+
 void InterruptHTTPRPC()
 {
     LogPrint(BCLog::RPC, "Interrupting HTTP RPC server\n");
@@ -32,4 +32,20 @@ void InterruptREST();
  */
 void StopREST();
 
+/** Serve the metrics of the node at /metrics, in the Prometheus text format.
+ * Precondition; HTTP has been started.
+ */
+void StartHTTPMetrics();
+/** Stop serving the metrics.
+ */
+void StopHTTPMetrics();
+
+/** Accept the nonces of pool miners at /pool, see CPoolServer.
+ * Precondition; HTTP and RPC has been started.
+ */
+void StartHTTPPool();
+/** Stop accepting pool shares.
+ */
+void StopHTTPPool();
+
 #endif
@@ -8,10 +8,26 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+static const int DEFAULT_HTTP_MINING_THREADS=4;
+static const int DEFAULT_HTTP_MINING_WORKQUEUE=64;
+static const int DEFAULT_HTTP_WALLET_THREADS=2;
+static const int DEFAULT_HTTP_ADMIN_THREADS=1;
+
+/** The classes of HTTP work. Each is served by a work queue and threads of its own, so
+ * slow requests of one class neither delay nor crowd out the requests of another.
+ */
+enum HTTPWorkClass {
+    HTTP_WORK_MINING,   //!< mining info and deadline submissions, whose latency matters most
+    HTTP_WORK_CHAIN,    //!< chain, mempool and utility calls, and anything not classified
+    HTTP_WORK_WALLET,   //!< wallet calls, which may hold the wallet for long
+    HTTP_WORK_ADMIN,    //!< node control and network management
+    HTTP_WORK_CLASS_COUNT
+};
 
 struct evhttp_request;
 struct event_base;
@@ -38,11 +54,14 @@ bool UpdateHTTPServerLogging(bool enable);
 
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the work class of a request. Called on the event loop thread, so it must be cheap. */
+typedef std::function<HTTPWorkClass(HTTPRequest* req, const std::string &)> HTTPWorkClassifier;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests are queued by the class classifier picks, the
+ * chain class without one.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkClassifier &classifier = nullptr);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -60,6 +79,9 @@ private:
     struct evhttp_request* req;
     bool replySent;
 
+    /** Send the output buffer as the reply, on the main http thread. */
+    void SendReply(int nStatus);
+
 public:
     explicit HTTPRequest(struct evhttp_request* req);
     ~HTTPRequest();
@@ -98,6 +120,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Get up to max_size bytes from the start of the request body, leaving the
+     * body to be read by ReadBody.
+     */
+    std::string PeekBody(size_t max_size);
+
     /**
      * Write output header.
      *
@@ -114,6 +142,14 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+    /** Write HTTP reply, handing strReply to the output buffer without a copy. */
+    void WriteReply(int nStatus, std::string&& strReply);
+
+    /**
+     * Append data to the body of the reply without a copy; owner keeps it alive until
+     * the reply is sent. Call this before WriteReply, whose body follows the data.
+     */
+    void WriteReplyData(const std::shared_ptr<const void>& owner, const void* data, size_t size);
 };
 
 /** Event handler closure.
@@ -0,0 +1,144 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+#include <actiondb.h>
+#include <crypto/sha256.h>
+#include <script/standard.h>
+#include <ticket.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <algorithm>
+
+constexpr char DB_ADDRESS = 'a';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+uint256 GetAddressIndexScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+/** Fill value with the amount and the asset of out, as far as they are explicit. */
+static void SetOutputValue(const CTxOut& out, CAddressIndexValue& value)
+{
+    if (!out.IsCA()) {
+        value.value = out.nValue;
+        return;
+    }
+    if (out.nValueCA.IsExplicit()) {
+        value.value = out.nValueCA.GetAmount();
+    } else {
+        value.confidential = true;
+    }
+    if (out.nAsset.IsExplicit()) {
+        value.asset = out.nAsset.GetAsset();
+    } else {
+        value.confidential = true;
+    }
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    // The genesis block has no undo data, nor inputs to spend.
+    CBlockUndo block_undo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+
+    const uint256 block_hash = pindex->GetBlockHash();
+    const int height = pindex->nHeight;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransactionRef& tx = block.vtx[i];
+        const uint256& txid = tx->GetHash();
+
+        for (uint32_t n = 0; n < tx->vout.size(); n++) {
+            const CTxOut& out = tx->vout[n];
+            if (out.scriptPubKey.empty() || out.scriptPubKey.IsUnspendable())
+                continue;
+            CAddressIndexValue value;
+            value.block_hash = block_hash;
+            SetOutputValue(out, value);
+            batch.Write(std::make_pair(DB_ADDRESS, CAddressIndexKey(AddressIndexType::PAYMENT, GetAddressIndexScriptHash(out.scriptPubKey), height, txid, n, false)), value);
+        }
+
+        // The coinbase has no undo entry.
+        if (i == 0)
+            continue;
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        for (uint32_t n = 0; n < tx_undo.vprevout.size(); n++) {
+            const CTxOut& prev = tx_undo.vprevout[n].out;
+            CAddressIndexValue value;
+            value.block_hash = block_hash;
+            SetOutputValue(prev, value);
+            value.value = -value.value;
+            batch.Write(std::make_pair(DB_ADDRESS, CAddressIndexKey(AddressIndexType::PAYMENT, GetAddressIndexScriptHash(prev.scriptPubKey), height, txid, n, true)), value);
+        }
+
+        if (tx->IsTicketTx() && !tx->Ticket()->Invalid()) {
+            const CTicketRef& ticket = tx->Ticket();
+            CAddressIndexValue value;
+            value.block_hash = block_hash;
+            value.value = ticket->nValue;
+            const CScript script = GetScriptForDestination(CTxDestination(ticket->KeyID()));
+            batch.Write(std::make_pair(DB_ADDRESS, CAddressIndexKey(AddressIndexType::TICKET, GetAddressIndexScriptHash(script), height, txid, ticket->out.n, false)), value);
+        }
+
+        std::vector<unsigned char> vchSig;
+        const CAction action = DecodeAction(tx, tx_undo, vchSig);
+        if (action.type() == typeid(CNilAction) || !VerifyAction(tx->vin[0].prevout, action, vchSig))
+            continue;
+        CAddressIndexValue value;
+        value.block_hash = block_hash;
+        if (action.type() == typeid(CBindAction)) {
+            const CBindAction& bind = boost::get<CBindAction>(action);
+            batch.Write(std::make_pair(DB_ADDRESS, CAddressIndexKey(AddressIndexType::BINDING, GetAddressIndexScriptHash(GetScriptForDestination(CTxDestination(bind.first))), height, txid, 0, false)), value);
+            batch.Write(std::make_pair(DB_ADDRESS, CAddressIndexKey(AddressIndexType::BINDING, GetAddressIndexScriptHash(GetScriptForDestination(CTxDestination(bind.second))), height, txid, 1, false)), value);
+        } else {
+            // An unbind has no target.
+            const CUnbindAction& unbind = boost::get<CUnbindAction>(action);
+            batch.Write(std::make_pair(DB_ADDRESS, CAddressIndexKey(AddressIndexType::BINDING, GetAddressIndexScriptHash(GetScriptForDestination(CTxDestination(unbind))), height, txid, 0, true)), value);
+        }
+    }
+    return true;
+}
+
+bool AddressIndex::FindEntries(AddressIndexType type, const uint256& script_hash, int start_height, int end_height,
+                               std::vector<CAddressIndexEntry>& entries_out) const
+{
+    if (start_height < 0 || end_height < start_height) {
+        return error("%s: height range %d-%d is invalid", __func__, start_height, end_height);
+    }
+
+    std::unique_ptr<CDBIterator> cursor(m_db->NewIterator());
+    cursor->Seek(std::make_pair(DB_ADDRESS, CAddressIndexKey(type, script_hash, start_height, uint256(), 0, false)));
+    for (; cursor->Valid(); cursor->Next()) {
+        std::pair<char, CAddressIndexKey> key;
+        if (!cursor->GetKey(key) || key.first != DB_ADDRESS || key.second.type != type ||
+            key.second.script_hash != script_hash || key.second.height > end_height) {
+            break;
+        }
+        CAddressIndexValue value;
+        if (!cursor->GetValue(value)) {
+            return error("%s: failed to read the entry of %s at height %d", __func__, key.second.txid.ToString(), key.second.height);
+        }
+        entries_out.emplace_back(key.second, value);
+    }
+
+    // Entries are not erased when their block is disconnected, drop those of stale blocks.
+    LOCK(cs_main);
+    entries_out.erase(std::remove_if(entries_out.begin(), entries_out.end(), [](const CAddressIndexEntry& entry) {
+        const CBlockIndex* pindex = chainActive[entry.first.height];
+        return !pindex || pindex->GetBlockHash() != entry.second.block_hash;
+    }), entries_out.end());
+    return true;
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_INDEX_ADDRESSINDEX_H
+#define LAVA_INDEX_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <asset.h>
+#include <chain.h>
+#include <compat/endian.h>
+#include <index/base.h>
+#include <script/script.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <vector>
+
+/** Default for -addressindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+
+/** What an address index entry records. */
+enum class AddressIndexType : uint8_t {
+    PAYMENT = 1, //!< an output paying the script, or an input spending one
+    TICKET = 2,  //!< a firestone ticket owned by the key of the script
+    BINDING = 3, //!< a bind or unbind action of the plot of the key of the script
+};
+
+/** The hash the address index keys a script by: the single SHA256 of the script. */
+uint256 GetAddressIndexScriptHash(const CScript& script);
+
+struct CAddressIndexKey {
+    AddressIndexType type;
+    uint256 script_hash;
+    int height;
+    uint256 txid;
+    uint32_t index;  //!< the output, the input, or the party of a binding (0 from, 1 to)
+    bool spending;
+
+    CAddressIndexKey() : type(AddressIndexType::PAYMENT), height(0), index(0), spending(false) {}
+    CAddressIndexKey(AddressIndexType typeIn, const uint256& script_hashIn, int heightIn, const uint256& txidIn, uint32_t indexIn, bool spendingIn) :
+        type(typeIn), script_hash(script_hashIn), height(heightIn), txid(txidIn), index(indexIn), spending(spendingIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        // The height is big endian, so the entries of a script are in the order of the chain.
+        const uint32_t be_height = htobe32((uint32_t)height);
+        ser_writedata8(s, (uint8_t)type);
+        s << script_hash;
+        s.write((const char*)&be_height, sizeof(be_height));
+        s << txid << index << spending;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint32_t be_height;
+        type = (AddressIndexType)ser_readdata8(s);
+        s >> script_hash;
+        s.read((char*)&be_height, sizeof(be_height));
+        height = (int)be32toh(be_height);
+        s >> txid >> index >> spending;
+    }
+};
+
+struct CAddressIndexValue {
+    uint256 block_hash;
+    CAmount value;      //!< received if positive, spent if negative; 0 when confidential or not a payment
+    CAsset asset;       //!< null for the native coin
+    bool confidential;  //!< the value or the asset is blinded
+
+    CAddressIndexValue() : value(0), confidential(false) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(block_hash);
+        READWRITE(value);
+        READWRITE(asset);
+        READWRITE(confidential);
+    }
+};
+
+typedef std::pair<CAddressIndexKey, CAddressIndexValue> CAddressIndexEntry;
+
+/**
+ * AddressIndex is used to look up the payments, tickets and bindings of a script. The
+ * index is written to a LevelDB database and records one entry per output paying a
+ * script, input spending one, ticket and binding action, keyed by the type of the entry,
+ * the script hash and the height, so the entries of a script are read by a range scan.
+ * Tickets and bindings are recorded under the pay-to-pubkey-hash script of their key.
+ */
+class AddressIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /**
+     * Get the entries of a type for a script hash between two heights, inclusive, in the
+     * order of the chain. Entries of blocks no longer on the active chain are left out.
+     */
+    bool FindEntries(AddressIndexType type, const uint256& script_hash, int start_height, int end_height,
+                     std::vector<CAddressIndexEntry>& entries_out) const;
+};
+
+/// The global address index, used by the getaddressdeltas RPC. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // LAVA_INDEX_ADDRESSINDEX_H
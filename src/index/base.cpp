@@ -11,10 +11,14 @@
 #include <validation.h>
 #include <warnings.h>
 
+#include <future>
+
 constexpr char DB_BEST_BLOCK = 'B';
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+constexpr size_t SYNC_PREFETCH_BLOCKS = 32;
+constexpr size_t SYNC_BATCH_SIZE = 16 << 20; // bytes
 
 template<typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -85,6 +89,49 @@ static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev) EXCLUSIV
     return chainActive.Next(chainActive.FindFork(pindex_prev));
 }
 
+/** A block for the sync thread to read, with its position taken under cs_main. */
+typedef std::pair<const CBlockIndex*, CDiskBlockPos> SyncBlockPos;
+
+/** The blocks following pindex_prev, up to SYNC_PREFETCH_BLOCKS of them. */
+static std::vector<SyncBlockPos> NextSyncBlocks(const CBlockIndex* pindex_prev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+
+    std::vector<SyncBlockPos> blocks;
+    while (blocks.size() < SYNC_PREFETCH_BLOCKS) {
+        const CBlockIndex* pindex = NextSyncBlock(pindex_prev);
+        if (!pindex) {
+            break;
+        }
+        blocks.emplace_back(pindex, pindex->GetBlockPos());
+        pindex_prev = pindex;
+    }
+    return blocks;
+}
+
+/**
+ * Read the blocks for the sync thread. They were connected to the chain, so their proof
+ * of capacity was verified and matching the hash of the index is enough. A block that
+ * could not be read, or was not read because of an interrupt, is left null.
+ */
+static std::vector<std::shared_ptr<const CBlock>> ReadSyncBlocks(const std::vector<SyncBlockPos>& blocks, const Consensus::Params& consensus_params, const CThreadInterrupt& interrupt)
+{
+    std::vector<std::shared_ptr<const CBlock>> result(blocks.size());
+    for (size_t i = 0; i < blocks.size() && !interrupt; i++) {
+        const CBlockIndex* pindex = blocks[i].first;
+        auto block = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*block, blocks[i].second, pindex->nHeight, consensus_params, false)) {
+            break;
+        }
+        if (block->GetHash() != pindex->GetBlockHash()) {
+            error("%s: GetHash() doesn't match index for %s", __func__, pindex->ToString());
+            break;
+        }
+        result[i] = std::move(block);
+    }
+    return result;
+}
+
 void BaseIndex::ThreadSync()
 {
     const CBlockIndex* pindex = m_best_block_index.load();
@@ -93,46 +140,65 @@ void BaseIndex::ThreadSync()
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
+
+        // Blocks are read a chunk ahead of the one being indexed, and the entries of many
+        // blocks are written in one batch, with the locator of the last of them.
+        CDBBatch batch(GetDB());
+        std::vector<SyncBlockPos> next_chunk;
+        {
+            LOCK(cs_main);
+            next_chunk = NextSyncBlocks(pindex);
+        }
+        auto next_blocks = std::async(std::launch::async, ReadSyncBlocks, next_chunk, std::cref(consensus_params), std::cref(m_interrupt));
         while (true) {
+            const std::vector<SyncBlockPos> chunk = std::move(next_chunk);
+            const std::vector<std::shared_ptr<const CBlock>> blocks = next_blocks.get();
             if (m_interrupt) {
-                WriteBestBlock(pindex);
+                Commit(batch, pindex);
                 return;
             }
 
             {
                 LOCK(cs_main);
-                const CBlockIndex* pindex_next = NextSyncBlock(pindex);
-                if (!pindex_next) {
-                    WriteBestBlock(pindex);
+                if (chunk.empty() && !NextSyncBlock(pindex)) {
+                    Commit(batch, pindex);
                     m_best_block_index = pindex;
                     m_synced = true;
                     break;
                 }
-                pindex = pindex_next;
+                next_chunk = NextSyncBlocks(chunk.empty() ? pindex : chunk.back().first);
             }
+            next_blocks = std::async(std::launch::async, ReadSyncBlocks, next_chunk, std::cref(consensus_params), std::cref(m_interrupt));
 
-            int64_t current_time = GetTime();
-            if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
-                LogPrintf("Syncing %s with block chain from height %d\n",
-                          GetName(), pindex->nHeight);
-                last_log_time = current_time;
-            }
+            for (size_t i = 0; i < chunk.size() && !m_interrupt; i++) {
+                if (!blocks[i]) {
+                    FatalError("%s: Failed to read block %s from disk",
+                               __func__, chunk[i].first->GetBlockHash().ToString());
+                    return;
+                }
+                pindex = chunk[i].first;
 
-            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
-                WriteBestBlock(pindex);
-                last_locator_write_time = current_time;
-            }
+                int64_t current_time = GetTime();
+                if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
+                    LogPrintf("Syncing %s with block chain from height %d\n",
+                              GetName(), pindex->nHeight);
+                    last_log_time = current_time;
+                }
 
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-                FatalError("%s: Failed to read block %s from disk",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
-            }
-            if (!WriteBlock(block, pindex)) {
-                FatalError("%s: Failed to write block %s to index database",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
+                if (!WriteBlock(*blocks[i], pindex, batch)) {
+                    FatalError("%s: Failed to write block %s to index database",
+                               __func__, pindex->GetBlockHash().ToString());
+                    return;
+                }
+
+                if (batch.SizeEstimate() > SYNC_BATCH_SIZE || last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+                    if (!Commit(batch, pindex)) {
+                        FatalError("%s: Failed to write block %s to index database",
+                                   __func__, pindex->GetBlockHash().ToString());
+                        return;
+                    }
+                    last_locator_write_time = current_time;
+                }
             }
         }
     }
@@ -144,12 +210,16 @@ void BaseIndex::ThreadSync()
     }
 }
 
-bool BaseIndex::WriteBestBlock(const CBlockIndex* block_index)
+bool BaseIndex::Commit(CDBBatch& batch, const CBlockIndex* block_index)
 {
-    LOCK(cs_main);
-    if (!GetDB().WriteBestBlock(chainActive.GetLocator(block_index))) {
-        return error("%s: Failed to write locator to disk", __func__);
+    if (block_index) {
+        LOCK(cs_main);
+        batch.Write(DB_BEST_BLOCK, chainActive.GetLocator(block_index));
+    }
+    if (!GetDB().WriteBatch(batch)) {
+        return error("%s: Failed to write batch to disk", __func__);
     }
+    batch.Clear();
     return true;
 }
 
@@ -182,7 +252,8 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
         }
     }
 
-    if (WriteBlock(*block, pindex)) {
+    CDBBatch batch(GetDB());
+    if (WriteBlock(*block, pindex, batch) && GetDB().WriteBatch(batch)) {
         m_best_block_index = pindex;
     } else {
         FatalError("%s: Failed to write block %s to index",
@@ -262,7 +333,7 @@ void BaseIndex::Start()
 {
     // Need to register this ValidationInterface before running Init(), so that
     // callbacks are not missed if Init sets m_synced to true.
-    RegisterValidationInterface(this);
+    RegisterValidationInterface(this, GetName());
     if (!Init()) {
         FatalError("%s: %s failed to initialize", __func__, GetName());
         return;
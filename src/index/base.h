@@ -54,8 +54,8 @@ private:
     /// over and the sync thread exits.
     void ThreadSync();
 
-    /// Write the current chain block locator to the DB.
-    bool WriteBestBlock(const CBlockIndex* block_index);
+    /// Write the batch to the DB, with the current chain block locator of block_index.
+    bool Commit(CDBBatch& batch, const CBlockIndex* block_index);
 
 protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
@@ -66,8 +66,9 @@ protected:
     /// Initialize internal state from the database and block index.
     virtual bool Init();
 
-    /// Write update index entries for a newly connected block.
-    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
+    /// Write update index entries for a newly connected block to batch. While syncing,
+    /// the batch holds the entries of the previous blocks too, not yet in the DB.
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch) { return true; }
 
     virtual DB& GetDB() const = 0;
 
@@ -0,0 +1,133 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockfilterindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+constexpr char DB_FILTER = 'f';
+
+std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+namespace {
+
+struct DBVal {
+    uint256 hash;
+    uint256 header;
+    std::vector<unsigned char> encoded_filter;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(header);
+        READWRITE(encoded_filter);
+    }
+};
+
+} // namespace
+
+BlockFilterIndex::BlockFilterIndex(BlockFilterType filter_type,
+                                   size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_filter_type(filter_type)
+{
+    const std::string& filter_name = BlockFilterTypeName(filter_type);
+    if (filter_name.empty()) throw std::invalid_argument("unknown filter_type");
+
+    m_name = filter_name + " block filter index";
+    m_db = MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "blockfilter" / filter_name,
+                                     n_cache_size, f_memory, f_wipe);
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    CBlockUndo block_undo;
+    uint256 prev_header;
+
+    // The genesis block has no undo data and its filter header commits to a null one.
+    if (pindex->nHeight > 0) {
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+
+        if (pindex->pprev->GetBlockHash() == m_last_block_hash) {
+            prev_header = m_last_header;
+        } else {
+            DBVal prev;
+            if (!m_db->Read(std::make_pair(DB_FILTER, pindex->pprev->GetBlockHash()), prev)) {
+                return error("%s: previous filter of block %s not found", __func__, pindex->GetBlockHash().ToString());
+            }
+            prev_header = prev.header;
+        }
+    }
+
+    BlockFilter filter(m_filter_type, block, block_undo);
+
+    DBVal value;
+    value.hash = filter.GetHash();
+    value.header = filter.ComputeHeader(prev_header);
+    value.encoded_filter = filter.GetEncodedFilter();
+    batch.Write(std::make_pair(DB_FILTER, pindex->GetBlockHash()), value);
+
+    m_last_block_hash = pindex->GetBlockHash();
+    m_last_header = value.header;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
+{
+    DBVal value;
+    if (!m_db->Read(std::make_pair(DB_FILTER, block_index->GetBlockHash()), value)) {
+        return false;
+    }
+    filter_out = BlockFilter(m_filter_type, block_index->GetBlockHash(), std::move(value.encoded_filter));
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
+{
+    DBVal value;
+    if (!m_db->Read(std::make_pair(DB_FILTER, block_index->GetBlockHash()), value)) {
+        return false;
+    }
+    header_out = value.header;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterRange(int start_height, const CBlockIndex* stop_index,
+                                         std::vector<BlockFilter>& filters_out) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight) {
+        return error("%s: start height (%d) out of range", __func__, start_height);
+    }
+
+    // Walk back from the stop block, which may not be on the active chain.
+    filters_out.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        if (!LookupFilter(pindex, filters_out[pindex->nHeight - start_height])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
+                                             std::vector<uint256>& hashes_out) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight) {
+        return error("%s: start height (%d) out of range", __func__, start_height);
+    }
+
+    hashes_out.resize(stop_index->nHeight - start_height + 1);
+    for (const CBlockIndex* pindex = stop_index; pindex && pindex->nHeight >= start_height; pindex = pindex->pprev) {
+        DBVal value;
+        if (!m_db->Read(std::make_pair(DB_FILTER, pindex->GetBlockHash()), value)) {
+            return false;
+        }
+        hashes_out[pindex->nHeight - start_height] = value.hash;
+    }
+    return true;
+}
@@ -12,21 +12,32 @@
 #include <addrman.h>
 #include <amount.h>
 #include <banman.h>
+#include <blockarchive.h>
+#include <blockio.h>
+#include <blockserver.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <compat/sanity.h>
+#include <crypto/shabal256.h>
+#include <crypto/siphash.h>
 #include <consensus/validation.h>
 #include <issuance.h>
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
 #include <interfaces/chain.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
 #include <index/txindex.h>
 #include <key.h>
+#include <key_io.h>
 #include <validation.h>
+#include <mempooljournal.h>
+#include <netcapacity.h>
 #include <miner.h>
 #include <netbase.h>
+#include <netcompress.h>
 #include <net.h>
 #include <net_processing.h>
 #include <policy/feerate.h>
@@ -40,10 +51,14 @@
 #include <script/sigcache.h>
 #include <scheduler.h>
 #include <shutdown.h>
+#include <support/hugepages.h>
 #include <timedata.h>
 #include <txdb.h>
 #include <actiondb.h>
+#include <assember.h>
 #include <txmempool.h>
+#include <txreconciliation.h>
+#include <udprelay.h>
 #include <torcontrol.h>
 #include <ui_interface.h>
 #include <util/system.h>
@@ -55,10 +70,14 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <fspool.h>
+#include <plotminer.h>
+#include <poc.h>
+#include <poolserver.h>
 
 #ifndef WIN32
 #include <attributes.h>
 #include <cerrno>
+#include <future>
 #include <signal.h>
 #include <sys/stat.h>
 #endif
@@ -78,6 +97,7 @@
 bool fFeeEstimatesInitialized = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
+static const bool DEFAULT_METRICS_ENABLE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 
 // Dump addresses to banlist.dat every 15 minutes (900s)
@@ -180,6 +200,10 @@ static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 static boost::thread_group threadGroup;
 static CScheduler scheduler;
 
+//! The CPUs the verification and mining threads are pinned to, round robin; empty for no pinning
+static std::vector<int> g_script_check_cpus;
+static std::vector<int> g_miner_cpus;
+
 void Interrupt()
 {
     InterruptHTTPServer();
@@ -193,6 +217,15 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_blockfilterindex) {
+        g_blockfilterindex->Interrupt();
+    }
+    if (g_addressindex) {
+        g_addressindex->Interrupt();
+    }
+    if (g_plotminer) {
+        g_plotminer->Interrupt();
+    }
 }
 
 void Shutdown(InitInterfaces& interfaces)
@@ -212,6 +245,8 @@ void Shutdown(InitInterfaces& interfaces)
 
     StopHTTPRPC();
     StopREST();
+    StopHTTPMetrics();
+    StopHTTPPool();
     StopRPC();
     StopHTTPServer();
     for (const auto& client : interfaces.chain_clients) {
@@ -222,8 +257,22 @@ void Shutdown(InitInterfaces& interfaces)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    if (g_block_candidates) UnregisterValidationInterface(g_block_candidates.get());
+    if (g_network_capacity) UnregisterValidationInterface(g_network_capacity.get());
+    if (g_udp_relay) {
+        UnregisterValidationInterface(g_udp_relay.get());
+        g_udp_relay->Stop();
+    }
+    // Its jobs hold on to nodes, it stops before they are deleted.
+    if (g_block_server) g_block_server->Stop();
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (g_blockfilterindex) g_blockfilterindex->Stop();
+    if (g_addressindex) g_addressindex->Stop();
+    if (g_plotminer) {
+        g_plotminer->Stop();
+        g_plotminer.reset();
+    }
 
     StopTorControl();
 
@@ -231,17 +280,31 @@ void Shutdown(InitInterfaces& interfaces)
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    g_block_io.reset();
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     peerLogic.reset();
+    g_block_candidates.reset();
+    g_network_capacity.reset();
+    g_udp_relay.reset();
     g_connman.reset();
+    g_block_server.reset();
     g_banman.reset();
     g_txindex.reset();
+    g_blockfilterindex.reset();
+    g_addressindex.reset();
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
     }
+    if (g_is_mempool_loaded && gArgs.GetBoolArg("-persistsigcache", DEFAULT_PERSIST_SIGCACHE)) {
+        DumpSignatureCaches();
+    }
+    if (pcoinsTip != nullptr && gArgs.GetBoolArg("-persistcoinscache", DEFAULT_PERSIST_COINS_CACHE)) {
+        DumpCoinsCache();
+    }
+    g_mempool_journal.reset();
 
     if (fFeeEstimatesInitialized)
     {
@@ -277,6 +340,7 @@ void Shutdown(InitInterfaces& interfaces)
         }
         pcoinsTip.reset();
         pcoinscatcher.reset();
+        pcoinsprefetch.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
     }
@@ -306,6 +370,7 @@ void Shutdown(InitInterfaces& interfaces)
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    LogInstance().StopAsyncWriter();
 }
 
 /**
@@ -375,18 +440,35 @@ void SetupServerArgs()
         "-allowselfsignedrootcertificates", "-choosedatadir", "-lang=<lang>", "-min", "-resetguisettings", "-rootcertificates=<file>", "-splash", "-uiplatform"};
 
     gArgs.AddArg("-version", "Print version and exit", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-addressindex", strprintf("Maintain an index of the payments, tickets and bindings of every address, used by the getaddressdeltas RPC (default: %u)", DEFAULT_ADDRESSINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", false, OptionsCategory::OPTIONS);
+    if (CanArchiveBlockFiles()) {
+        gArgs.AddArg("-archiveblocks", strprintf("Recompress block files no longer written to with zstd in the background, a frame per block, for archive nodes short on disk space. Blocks are read back from them transparently. Incompatible with -prune (default: %u)", DEFAULT_ARCHIVE_BLOCKS), false, OptionsCategory::OPTIONS);
+    } else {
+        hidden_args.emplace_back("-archiveblocks");
+    }
+    gArgs.AddArg("-assumepoc=<hex>", strprintf("If this block is in the chain assume that it and its ancestors have valid proofs of capacity and potentially skip verifying them when their blocks are stored, read and connected (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumePoC.GetHex(), testnetChainParams->GetConsensus().defaultAssumePoC.GetHex()), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>", "Specify blocks directory (default: <datadir>/blocks)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockfilterindex", strprintf("Maintain an index of basic compact block filters (BIP 157/158), used by the getblockfilter RPC and -peerblockfilters (default: %u)", DEFAULT_BLOCKFILTERINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to operate in a blocks only mode (default: %u)", DEFAULT_BLOCKSONLY), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbsubcompactions=<n>", strprintf("Threads a compaction of the chainstate database from level 0 into level 1 is split over (default: %d)", DEFAULT_DB_SUBCOMPACTIONS), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-lavadbcache=<n>", strprintf("Database cache size <n> MiB shared by the firestone, relation, fspool and issuance databases, taken from -dbcache (default: 1/16 of -dbcache, at most %d)", nMaxLavaDBCache), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-feeestimatebytime", strprintf("Decay the fee estimation history by the time between blocks rather than per block (default: %u)", DEFAULT_FEE_ESTIMATE_BY_TIME), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-headersonly", strprintf("Only sync block headers, checking their proofs of capacity and base targets: no block is downloaded and no chainstate is kept. "
+                 "Implies -blocksonly and -disablewallet, and cannot forge (default: %u)", DEFAULT_HEADERSONLY), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-hugepages=<mode>", "Back the coins cache, the signature caches and the nonce scratch of the PoC checks with 2 MiB pages: "
+                 "'transparent' for transparent huge pages, 'explicit' for the reserved hugetlbfs pool, falling back to transparent ones (Linux only, default: none)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-capacitywindow=<n>", strprintf("Keep the base targets of the last <n> blocks to estimate the network capacity over (default: %d)", DEFAULT_CAPACITY_WINDOW), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-firestoneslots=<n>", strprintf("Keep the firestones and fstx of the last <n> slots in memory, older ones are read from disk when queried (minimum %d, default: %d)", MIN_FIRESTONE_SLOTS, DEFAULT_FIRESTONE_SLOTS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
@@ -395,11 +477,22 @@ void SetupServerArgs()
     gArgs.AddArg("-minimumcumulativediff=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumCumulativeDiff.GetHex(), testnetChainParams->GetConsensus().nMinimumCumulativeDiff.GetHex()), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockiothreads=<n>", strprintf("Set the number of threads reading the blocks next to be connected, disconnected or served in the background (0 to %d, 0 = none, default: %d)",
+        MAX_BLOCK_IO_THREADS, DEFAULT_BLOCK_IO_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockservethreads=<n>", strprintf("Set the number of threads serving the blocks peers ask for from disk, taking turns between peers, so the message handler goes on meanwhile (0 to %d, 0 = none, default: %d)",
+        MAX_BLOCK_SERVE_THREADS, DEFAULT_BLOCK_SERVE_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-scriptcheckcpus=<list>", "Pin the script and PoC verification threads to the CPUs of <list>, like 0-3,8, in turn, keeping their caches and scratch on the NUMA nodes of those CPUs (Linux only)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-schedulerthreads=<n>", strprintf("Set the number of threads running background tasks and the validation interface callbacks, whose subscribers run side by side (1 to %d, default: %d)",
+        MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-persistcoinscache", strprintf("Whether to save the outpoints of the coins cache and of the coins the mempool spends on shutdown, and read those coins back into the cache in the background on restart (default: %u)", DEFAULT_PERSIST_COINS_CACHE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-persistsigcache", strprintf("Whether to save the signature and proof caches on shutdown and load them on restart, along with the mempool. Their entries are trusted, so only use it if the data directory is trusted (default: %u)", DEFAULT_PERSIST_SIGCACHE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-mempooljournal", strprintf("Whether to journal the changes of the mempool between its saves, to find it again after a crash (default: %u)", DEFAULT_MEMPOOL_JOURNAL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prunestaleheaders=<n>", strprintf("Remove from the block index the header-only side branches more than <n> blocks worth of work below the tip and older than a day, hourly (0 to keep them, default: %u)", DEFAULT_PRUNE_STALE_HEADERS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", false, OptionsCategory::OPTIONS);
 #ifndef WIN32
@@ -412,6 +505,11 @@ void SetupServerArgs()
     gArgs.AddArg("-banscore=<n>", strprintf("Threshold for disconnecting misbehaving peers (default: %u)", DEFAULT_BANSCORE_THRESHOLD), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-bantime=<n>", strprintf("Number of seconds to keep misbehaving peers from reconnecting (default: %u)", DEFAULT_MISBEHAVING_BANTIME), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-bind=<addr>", "Bind to given address and always listen on it. Use [host]:port notation for IPv6", false, OptionsCategory::CONNECTION);
+    if (CanCompressMessages()) {
+        gArgs.AddArg("-compressrelay", strprintf("Compress the blocks, headers and transactions exchanged with peers supporting it, for links short on bandwidth (default: %u)", DEFAULT_COMPRESS_RELAY), false, OptionsCategory::CONNECTION);
+    } else {
+        hidden_args.emplace_back("-compressrelay");
+    }
     gArgs.AddArg("-connect=<ip>", "Connect only to the specified node; -noconnect disables automatic connections (the rules for this peer are the same as for -addnode). This option can be specified multiple times to connect to multiple nodes.", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-discover", "Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-dns", strprintf("Allow DNS lookups for -addnode, -seednode and -connect (default: %u)", DEFAULT_NAME_LOOKUP), false, OptionsCategory::CONNECTION);
@@ -426,8 +524,11 @@ void SetupServerArgs()
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-peersjournal", strprintf("Whether to journal the changes of the known addresses between the writes of peers.dat, to find them again after a crash (default: %u)", DEFAULT_PEERS_JOURNAL), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-msghandlers=<n>", strprintf("Number of threads processing the messages of peers, each peer is handled by one of them (1 to %d, default: %d)", MAX_MSG_HANDLER_THREADS, DEFAULT_MSG_HANDLER_THREADS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services, set -noonion to disable (default: -proxy)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-peerblockfilters", strprintf("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)", DEFAULT_PEERBLOCKFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-permitbaremultisig", strprintf("Relay non-P2SH multisig (default: %u)", DEFAULT_PERMIT_BAREMULTISIG), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-port=<port>", strprintf("Listen for connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort(), regtestChainParams->GetDefaultPort()), false, OptionsCategory::CONNECTION);
@@ -438,6 +539,7 @@ void SetupServerArgs()
     gArgs.AddArg("-peertimeout=<n>", strprintf("Specify p2p connection timeout in seconds. This option determines the amount of time a peer may be inactive before the connection to it is dropped. (minimum: 1, default: %d)", DEFAULT_PEER_CONNECT_TIMEOUT), true, OptionsCategory::CONNECTION);
     gArgs.AddArg("-torcontrol=<ip>:<port>", strprintf("Tor control port to use if onion listening enabled (default: %s)", DEFAULT_TOR_CONTROL), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-torpassword=<pass>", "Tor control port password (default: empty)", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-txreconciliation", strprintf("Announce transactions to outbound peers supporting it by reconciling sets of short ids instead of flooding invs (default: %u)", DEFAULT_TXRECONCILIATION), false, OptionsCategory::CONNECTION);
 #ifdef USE_UPNP
 #if USE_UPNP
     gArgs.AddArg("-upnp", "Use UPnP to map the listening port (default: 1 when listening and no -proxy)", false, OptionsCategory::CONNECTION);
@@ -447,6 +549,9 @@ void SetupServerArgs()
 #else
     hidden_args.emplace_back("-upnp");
 #endif
+    gArgs.AddArg("-udprelay=<host[:port]>", "Relay new blocks to and accept them from <host> over UDP, cut into chunks with forward error correction, for forgers in a low-latency mesh. Requires -udprelaykey. Can be specified multiple times", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-udprelaykey=<secret>", "Secret shared by the -udprelay peers, authenticating the packets they send", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-udprelayport=<port>", "Receive -udprelay packets on UDP <port> (default: the -port setting)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-whitebind=<addr>", "Bind to given address and whitelist peers connecting to it. Use [host]:port notation for IPv6", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-whitelist=<IP address or network>", "Whitelist peers connecting from the given IP address (e.g. 1.2.3.4) or CIDR notated network (e.g. 1.2.3.0/24). Can be specified multiple times."
         " Whitelisted peers cannot be DoS banned and their transactions are always relayed, even if they are already in the mempool, useful e.g. for a gateway", false, OptionsCategory::CONNECTION);
@@ -458,19 +563,39 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubmininginfo=<address>", "Enable publish poc mining info (height, generation signature, base target) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubfirestone=<address>", "Enable publish firestones bought and spent in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubbinding=<address>", "Enable publish bind and unbind actions in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubslot=<address>", "Enable publish firestone slot openings in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubdeadline=<address>", "Enable publish best deadlines for the next block in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubmininginfohwm=<n>", strprintf("Set publish poc mining info outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubfirestonehwm=<n>", strprintf("Set publish firestone outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubbindinghwm=<n>", strprintf("Set publish binding outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubslothwm=<n>", strprintf("Set publish slot outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubdeadlinehwm=<n>", strprintf("Set publish deadline outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubmininginfo=<address>");
+    hidden_args.emplace_back("-zmqpubfirestone=<address>");
+    hidden_args.emplace_back("-zmqpubbinding=<address>");
+    hidden_args.emplace_back("-zmqpubslot=<address>");
+    hidden_args.emplace_back("-zmqpubdeadline=<address>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubmininginfohwm=<n>");
+    hidden_args.emplace_back("-zmqpubfirestonehwm=<n>");
+    hidden_args.emplace_back("-zmqpubbindinghwm=<n>");
+    hidden_args.emplace_back("-zmqpubslothwm=<n>");
+    hidden_args.emplace_back("-zmqpubdeadlinehwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), true, OptionsCategory::DEBUG_TEST);
@@ -482,6 +607,7 @@ void SetupServerArgs()
         "and level 4 tries to reconnect the blocks, "
         "each level includes the checks of the previous levels "
         "(0-4, default: %u)", DEFAULT_CHECKLEVEL), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checkpocindex=<n>", strprintf("How many tip blocks to verify the proofs of capacity of in the background at startup (default: %u)", DEFAULT_CHECKPOCINDEX), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), true, OptionsCategory::DEBUG_TEST);
@@ -492,6 +618,7 @@ void SetupServerArgs()
     gArgs.AddArg("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-limitclustercount=<n>", strprintf("Do not accept transactions in cluster mode if their mempool cluster would have more than <n> transactions (default: %u)", DEFAULT_CLUSTER_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-addrmantest", "Allows to test address relay on localhost", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-debug=<category>", "Output debugging information (default: -nodebug, supplying <category> is optional). "
@@ -499,9 +626,13 @@ void SetupServerArgs()
     gArgs.AddArg("-debugexclude=<category>", strprintf("Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except one or more specified categories."), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logasync", strprintf("Write the debug log from a background thread (default: %u)", DEFAULT_LOGASYNC), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-lockprofile", strprintf("Record lock wait and hold times per acquisition site, reported by getlockprofile (default: %u)", DEFAULT_LOCK_PROFILE), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxrangeproofcachesize=<n>", "Limit the range proof cache to <n> MiB; once full, it keeps the larger proofs, which cost more to verify (default: -maxsigcachesize)", true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxsurjectionproofcachesize=<n>", "Limit the surjection proof cache to <n> MiB; once full, it keeps the larger proofs, which cost more to verify (default: -maxsigcachesize)", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtxfee=<amt>", strprintf("Maximum total fees (in %s) to use in a single wallet transaction or raw transaction; setting this too low may abort large transactions (default: %s)",
         CURRENCY_UNIT, FormatMoney(DEFAULT_TRANSACTION_MAXFEE)), false, OptionsCategory::DEBUG_TEST);
@@ -518,6 +649,7 @@ void SetupServerArgs()
     gArgs.AddArg("-bytespersigop", strprintf("Equivalent bytes per sigop in transactions for relay and mining (default: %u)", DEFAULT_BYTES_PER_SIGOP), false, OptionsCategory::NODE_RELAY);
     gArgs.AddArg("-datacarrier", strprintf("Relay and mine data carrier transactions (default: %u)", DEFAULT_ACCEPT_DATACARRIER), false, OptionsCategory::NODE_RELAY);
     gArgs.AddArg("-datacarriersize", strprintf("Maximum size of data in data carrier transactions we relay and mine (default: %u)", MAX_OP_RETURN_RELAY), false, OptionsCategory::NODE_RELAY);
+    gArgs.AddArg("-clustermempool", strprintf("Mine and evict mempool transactions by the feerate chunks of their clusters (default: %u)", DEFAULT_CLUSTER_MEMPOOL), false, OptionsCategory::NODE_RELAY);
     gArgs.AddArg("-mempoolreplacement", strprintf("Enable transaction replacement in the memory pool (default: %u)", DEFAULT_ENABLE_REPLACEMENT), false, OptionsCategory::NODE_RELAY);
     gArgs.AddArg("-minrelaytxfee=<amt>", strprintf("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)",
         CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)), false, OptionsCategory::NODE_RELAY);
@@ -528,8 +660,17 @@ void SetupServerArgs()
     gArgs.AddArg("-blockmaxweight=<n>", strprintf("Set maximum BIP141 block weight (default: %d)", DEFAULT_BLOCK_MAX_WEIGHT), false, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockmintxfee=<amt>", strprintf("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)), false, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", true, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-fastforge", strprintf("Submit forged blocks without connecting them first, trusting the mempool transactions they hold. A forged block found invalid disables it (default: %u)", DEFAULT_FASTFORGE), false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-mineraddress=<addr>", "Address whose plot files in -plotdir are mined", false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-minercpus=<list>", "Pin the threads reading plot files to the CPUs of <list>, like 0-3,8, in turn (Linux only)", false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-minerthreads=<n>", strprintf("Number of threads reading plot files, 0 for one per plot file up to the number of cores (default: %d)", DEFAULT_MINER_THREADS), false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-plotdir=<dir>", "Mine the plot files of -mineraddress found in <dir> and submit their deadlines to the block assember. This option can be specified multiple times", false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-plotmmap", strprintf("Memory map the scoop columns of the plot files instead of reading them with pread (default: %u)", DEFAULT_PLOT_MMAP), false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-plotreadsize=<n>", strprintf("Size in KiB of one read of a plot file, rounded up to the block size of its device (default: %u)", DEFAULT_PLOT_READ_SIZE), false, OptionsCategory::BLOCK_CREATION);
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
+    gArgs.AddArg("-metrics", strprintf("Serve latency histograms and counters at /metrics in the Prometheus text format, without authentication (default: %u)", DEFAULT_METRICS_ENABLE), false, OptionsCategory::RPC);
+    gArgs.AddArg("-poolserver", strprintf("Accept batches of pool shares at /pool, authenticated as JSON-RPC, checking them and feeding the best to the block assember (default: %u)", DEFAULT_POOLSERVER), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and HMAC-SHA-256 hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcauth. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost)", false, OptionsCategory::RPC);
@@ -538,9 +679,13 @@ void SetupServerArgs()
     gArgs.AddArg("-rpcport=<port>", strprintf("Listen for JSON-RPC connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort(), regtestBaseParams->RPCPort()), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcserialversion", strprintf("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)", DEFAULT_RPC_SERIALIZE_VERSION), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT), true, OptionsCategory::RPC);
-    gArgs.AddArg("-rpcthreads=<n>", strprintf("Set the number of threads to service RPC calls (default: %d)", DEFAULT_HTTP_THREADS), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcthreads=<n>", strprintf("Set the number of threads to service chain and other RPC calls (default: %d)", DEFAULT_HTTP_THREADS), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcminingthreads=<n>", strprintf("Set the number of threads to service poc and mining RPC calls (default: %d)", DEFAULT_HTTP_MINING_THREADS), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcwalletthreads=<n>", strprintf("Set the number of threads to service wallet RPC calls (default: %d)", DEFAULT_HTTP_WALLET_THREADS), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcadminthreads=<n>", strprintf("Set the number of threads to service control and network RPC calls (default: %d)", DEFAULT_HTTP_ADMIN_THREADS), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcuser=<user>", "Username for JSON-RPC connections", false, OptionsCategory::RPC);
-    gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queues to service RPC calls other than mining ones (default: %d)", DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcminingworkqueue=<n>", strprintf("Set the depth of the work queue to service poc and mining RPC calls (default: %d)", DEFAULT_HTTP_MINING_WORKQUEUE), true, OptionsCategory::RPC);
     gArgs.AddArg("-server", "Accept command line and JSON-RPC commands", false, OptionsCategory::RPC);
 
 #if HAVE_DECL_DAEMON
@@ -658,6 +803,54 @@ static void CleanupBlockRevFiles()
     }
 }
 
+/**
+ * Init steps that depend on what was loaded before them but not on each other, run
+ * concurrently, each on its own thread. Every step is timed in the log. Wait() returns once all
+ * are done, with the error of the first failed one in the order they were added.
+ */
+class CInitTasks
+{
+private:
+    struct Task
+    {
+        std::string name;
+        std::string strError;
+        std::future<bool> result;
+    };
+    std::vector<Task> tasks;
+
+public:
+    ~CInitTasks()
+    {
+        for (Task& task : tasks) {
+            if (task.result.valid()) task.result.wait();
+        }
+    }
+
+    void Add(const std::string& name, std::function<bool()> step, const std::string& strError)
+    {
+        tasks.push_back({name, strError, std::async(std::launch::async, [name, step] {
+            const int64_t nStart = GetTimeMillis();
+            const bool ret = step();
+            LogPrintf(" %s %15dms\n", name, GetTimeMillis() - nStart);
+            return ret;
+        })});
+    }
+
+    /** Wait for the steps, rethrowing the exception of the first that threw. */
+    bool Wait(std::string& strError)
+    {
+        bool ret = true;
+        for (Task& task : tasks) {
+            if (!task.result.get() && ret) {
+                strError = task.strError;
+                ret = false;
+            }
+        }
+        return ret;
+    }
+};
+
 static void ThreadImport(std::vector<fs::path> vImportFiles)
 {
     const CChainParams& chainparams = Params();
@@ -669,18 +862,8 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
-        }
+        if (!ReindexBlockFiles(chainparams))
+            return;
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -729,6 +912,9 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
     } // End scope of CImportingNow
     if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         LoadMempool();
+        if (g_mempool_journal && !ShutdownRequested()) {
+            g_mempool_journal->Connect(mempool);
+        }
     }
     g_is_mempool_loaded = !ShutdownRequested();
 }
@@ -765,6 +951,8 @@ static bool AppInitServers()
     if (!StartHTTPRPC())
         return false;
     if (gArgs.GetBoolArg("-rest", DEFAULT_REST_ENABLE)) StartREST();
+    if (gArgs.GetBoolArg("-metrics", DEFAULT_METRICS_ENABLE)) StartHTTPMetrics();
+    if (gArgs.GetBoolArg("-poolserver", DEFAULT_POOLSERVER)) StartHTTPPool();
     StartHTTPServer();
     return true;
 }
@@ -820,6 +1008,16 @@ void InitParameterInteraction()
             LogPrintf("%s: parameter interaction: -externalip set -> setting -discover=0\n", __func__);
     }
 
+    // a headers only node has no chainstate to check transactions against
+    if (gArgs.GetBoolArg("-headersonly", DEFAULT_HEADERSONLY)) {
+        if (gArgs.SoftSetBoolArg("-blocksonly", true))
+            LogPrintf("%s: parameter interaction: -headersonly=1 -> setting -blocksonly=1\n", __func__);
+        if (gArgs.SoftSetBoolArg("-disablewallet", true))
+            LogPrintf("%s: parameter interaction: -headersonly=1 -> setting -disablewallet=1\n", __func__);
+        if (gArgs.SoftSetArg("-dbcache", std::to_string(nMinDbCache)))
+            LogPrintf("%s: parameter interaction: -headersonly=1 -> setting -dbcache=%d\n", __func__, nMinDbCache);
+    }
+
     // disable whitelistrelay in blocksonly mode
     if (gArgs.GetBoolArg("-blocksonly", DEFAULT_BLOCKSONLY)) {
         if (gArgs.SoftSetBoolArg("-whitelistrelay", false))
@@ -872,6 +1070,7 @@ void InitLogging()
     LogInstance().m_log_time_micros = gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
 
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
+    g_lock_profile = gArgs.GetBoolArg("-lockprofile", DEFAULT_LOCK_PROFILE);
 
     std::string version_string = FormatFullVersion();
 #ifdef DEBUG
@@ -1019,12 +1218,23 @@ bool AppInitParameterInteraction()
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
+    if (chainparams.GetConsensus().fFastPoC) {
+        SetNonceTableSize(FAST_POC_NONCES);
+        LogPrintf("Fast PoC test chain, deadlines are not waited for\n");
+    }
+
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
         LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
     else
         LogPrintf("Validating signatures for all blocks.\n");
 
+    hashAssumePoC = uint256S(gArgs.GetArg("-assumepoc", chainparams.GetConsensus().defaultAssumePoC.GetHex()));
+    if (!hashAssumePoC.IsNull())
+        LogPrintf("Assuming ancestors of block %s have valid proofs of capacity.\n", hashAssumePoC.GetHex());
+    else
+        LogPrintf("Validating proofs of capacity for all blocks.\n");
+
     if (gArgs.IsArgSet("-minimumcumulativediff")) {
         const std::string minCumulativeDiffStr = gArgs.GetArg("-minimumcumulativediff", "");
         if (!IsHexNumber(minCumulativeDiffStr)) {
@@ -1063,6 +1273,22 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    if (gArgs.IsArgSet("-scriptcheckcpus") && !ParseCPUList(gArgs.GetArg("-scriptcheckcpus", ""), g_script_check_cpus)) {
+        return InitError(strprintf(_("Invalid CPU list for -scriptcheckcpus: '%s'"), gArgs.GetArg("-scriptcheckcpus", "")));
+    }
+    if (gArgs.IsArgSet("-minercpus") && !ParseCPUList(gArgs.GetArg("-minercpus", ""), g_miner_cpus)) {
+        return InitError(strprintf(_("Invalid CPU list for -minercpus: '%s'"), gArgs.GetArg("-minercpus", "")));
+    }
+
+    // Huge pages must be chosen before the caches allocate their tables, as blocks are freed the way they were allocated.
+    HugePageMode hugePageMode = HugePageMode::NONE;
+    if (gArgs.IsArgSet("-hugepages") && !ParseHugePageMode(gArgs.GetArg("-hugepages", ""), hugePageMode)) {
+        return InitError(strprintf(_("Unknown -hugepages mode '%s'"), gArgs.GetArg("-hugepages", "")));
+    }
+    if (!SetHugePageMode(hugePageMode)) {
+        InitWarning(_("Huge pages are not supported on this platform, -hugepages is ignored."));
+    }
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1081,6 +1307,22 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    if (gArgs.GetBoolArg("-archiveblocks", DEFAULT_ARCHIVE_BLOCKS)) {
+        if (!CanArchiveBlockFiles())
+            return InitError(_("Cannot set -archiveblocks, this build has no zstd support or this platform no file mapping."));
+        if (fPruneMode)
+            return InitError(_("Cannot set -archiveblocks together with -prune."));
+    }
+
+    fHeadersOnly = gArgs.GetBoolArg("-headersonly", DEFAULT_HEADERSONLY);
+    if (fHeadersOnly) {
+        if (gArgs.IsArgSet("-plotdir") || gArgs.GetBoolArg("-poolserver", DEFAULT_POOLSERVER))
+            return InitError(_("Cannot forge in -headersonly mode, -plotdir and -poolserver need the chainstate."));
+        if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("-headersonly is incompatible with -blockfilterindex."));
+        LogPrintf("Headers only mode: blocks are neither downloaded nor connected.\n");
+    }
+
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -1156,6 +1398,18 @@ bool AppInitParameterInteraction()
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+
+    if (gArgs.GetBoolArg("-compressrelay", DEFAULT_COMPRESS_RELAY)) {
+        if (!CanCompressMessages())
+            return InitError(_("Cannot set -compressrelay, this build has no zstd support."));
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPRESS);
+    }
+
     if (gArgs.GetArg("-rpcserialversion", DEFAULT_RPC_SERIALIZE_VERSION) < 0)
         return InitError("rpcserialversion must be non-negative.");
 
@@ -1164,6 +1418,8 @@ bool AppInitParameterInteraction()
 
     nMaxTipAge = gArgs.GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
+    fClusterMempool = gArgs.GetBoolArg("-clustermempool", DEFAULT_CLUSTER_MEMPOOL);
+
     fEnableReplacement = gArgs.GetBoolArg("-mempoolreplacement", DEFAULT_ENABLE_REPLACEMENT);
     if ((!fEnableReplacement) && gArgs.IsArgSet("-mempoolreplacement")) {
         // Minimal effort at forwards compatibility
@@ -1196,6 +1452,10 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string shabal256_algo = Shabal256AutoDetect();
+    LogPrintf("Using the '%s' Shabal256 implementation\n", shabal256_algo);
+    std::string siphash_algo = SipHashAutoDetect();
+    LogPrintf("Using the '%s' SipHash implementation\n", siphash_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1240,6 +1500,8 @@ bool AppInitMain(InitInterfaces& interfaces)
             return InitError(strprintf("Could not open debug log file %s",
                 LogInstance().m_file_path.string()));
         }
+        if (gArgs.GetBoolArg("-logasync", DEFAULT_LOGASYNC))
+            LogInstance().StartAsyncWriter();
     }
 
     if (!LogInstance().m_log_timestamps)
@@ -1270,20 +1532,51 @@ bool AppInitMain(InitInterfaces& interfaces)
             gArgs.GetArg("-datadir", ""), fs::current_path().string());
     }
 
+    if (GetHugePageMode() != HugePageMode::NONE) {
+        LogPrintf("Backing the caches with %s huge pages\n", GetHugePageMode() == HugePageMode::EXPLICIT ? "explicit" : "transparent");
+    }
     InitSignatureCache();
     InitScriptExecutionCache();
     InitRangeproofCache();
     InitSurjectionproofCache();
+    if (gArgs.GetBoolArg("-persistsigcache", DEFAULT_PERSIST_SIGCACHE)) {
+        LoadSignatureCaches();
+    }
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
-            threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
+            const int cpu = g_script_check_cpus.empty() ? -1 : g_script_check_cpus[i % g_script_check_cpus.size()];
+            threadGroup.create_thread([cpu] { if (cpu >= 0) SetThreadAffinity(cpu); ThreadScriptCheck(); });
+            threadGroup.create_thread([cpu] { if (cpu >= 0) SetThreadAffinity(cpu); ThreadPoCCheck(); });
+        }
+    }
+
+    const int nBlockIOThreads = std::max(0, std::min<int>(gArgs.GetArg("-blockiothreads", DEFAULT_BLOCK_IO_THREADS), MAX_BLOCK_IO_THREADS));
+    if (nBlockIOThreads > 0) {
+        LogPrintf("Using %d threads for reading blocks ahead\n", nBlockIOThreads);
+        g_block_io = MakeUnique<CBlockIOQueue>(nBlockIOThreads);
     }
 
-    // Start the lightweight task scheduler thread
+    const int nBlockServeThreads = std::max(0, std::min<int>(gArgs.GetArg("-blockservethreads", DEFAULT_BLOCK_SERVE_THREADS), MAX_BLOCK_SERVE_THREADS));
+    if (nBlockServeThreads > 0) {
+        LogPrintf("Using %d threads for serving blocks to peers\n", nBlockServeThreads);
+        // The message handler goes back to a peer once the block served to it is sent.
+        g_block_server = MakeUnique<CBlockServer>(nBlockServeThreads, [] {
+            if (g_connman) g_connman->WakeMessageHandler();
+        });
+    }
+
+    // Start the lightweight task scheduler threads
+    const int nSchedulerThreads = std::max(1, std::min<int>(gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++) {
+        const std::string name = i == 0 ? "scheduler" : strprintf("scheduler.%d", i);
+        threadGroup.create_thread([name, serviceLoop] { TraceThread(name.c_str(), serviceLoop); });
+    }
+    // and the one keeping the forging and held block timers on time
+    CScheduler::Function serviceTimingLoop = std::bind(&CScheduler::serviceTimingQueue, &scheduler);
+    threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "schedtiming", serviceTimingLoop));
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
@@ -1310,6 +1603,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     const auto& genesis = chainparams.GenesisBlock();
     GenerateAssetEntropy(entropy,  COutPoint(uint256(genesis.vtx[0]->GetHash()), 0), genesis.GetHash());
     CalculateAsset(policyAsset, entropy);
+    InitMessageCompression();
 
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
@@ -1342,7 +1636,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     g_connman = std::unique_ptr<CConnman>(new CConnman(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())));
 
     peerLogic.reset(new PeerLogicValidation(g_connman.get(), g_banman.get(), scheduler, gArgs.GetBoolArg("-enablebip61", DEFAULT_ENABLE_BIP61)));
-    RegisterValidationInterface(peerLogic.get());
+    RegisterValidationInterface(peerLogic.get(), "net");
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1434,7 +1728,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
+        RegisterValidationInterface(g_zmq_notification_interface, "zmq");
     }
 #endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
@@ -1457,6 +1751,22 @@ bool AppInitMain(InitInterfaces& interfaces)
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, nMaxTxIndexCache << 20);
     nTotalCache -= nTxIndexCache;
+    int64_t nFilterIndexCache = 0;
+    if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        nFilterIndexCache = std::min(nTotalCache / 8, nMaxFilterIndexCache << 20);
+        nTotalCache -= nFilterIndexCache;
+    }
+    int64_t nAddressIndexCache = 0;
+    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        nAddressIndexCache = std::min(nTotalCache / 8, nMaxAddressIndexCache << 20);
+        nTotalCache -= nAddressIndexCache;
+    }
+    int64_t nLavaDBCache = std::min(nTotalCache / 16, nMaxLavaDBCache << 20);
+    if (gArgs.IsArgSet("-lavadbcache")) {
+        nLavaDBCache = std::max<int64_t>(gArgs.GetArg("-lavadbcache", 0), 0) << 20;
+        nLavaDBCache = std::min(nLavaDBCache, nTotalCache / 2); // leave the coins cache at least half of the rest
+    }
+    nTotalCache -= nLavaDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1465,13 +1775,29 @@ bool AppInitMain(InitInterfaces& interfaces)
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
+    if (nFilterIndexCache > 0) {
+        LogPrintf("* Using %.1f MiB for block filter index database\n", nFilterIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (nAddressIndexCache > 0) {
+        LogPrintf("* Using %.1f MiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    }
+    LogPrintf("* Using %.1f MiB for firestone, relation, fspool and issuance databases\n", nLavaDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
-    prelationview.reset(new CRelationView(0));
-    pticketview.reset(new CTicketView(0));
+    // The firestone and relation databases are read at every startup and reorg, they get most of the share.
+    prelationview.reset(new CRelationView(nLavaDBCache * 3 / 8));
+    pticketview.reset(new CTicketView(nLavaDBCache * 3 / 8));
+    pticketview->SetRetainedSlots(gArgs.GetArg("-firestoneslots", DEFAULT_FIRESTONE_SLOTS));
+    pissuanceview.reset(new CIssuanceView(nLavaDBCache / 8));
     g_blockCache.reset(new CBlockCache());
-    pfspool.reset(new CFSPool(0));
+    pfspool.reset(new CFSPool(nLavaDBCache / 8));
+    pfspool->SetRetainedSlots(gArgs.GetArg("-firestoneslots", DEFAULT_FIRESTONE_SLOTS));
+    RegisterValidationInterface(pfspool.get(), "fspool");
+    g_block_candidates.reset(new CBlockCandidates());
+    RegisterValidationInterface(g_block_candidates.get(), "blockcandidates");
+    g_network_capacity.reset(new CNetworkCapacity(gArgs.GetArg("-capacitywindow", DEFAULT_CAPACITY_WINDOW)));
+    RegisterValidationInterface(g_network_capacity.get(), "netcapacity");
 
     bool fLoaded = false;
     while (!fLoaded && !ShutdownRequested()) {
@@ -1487,8 +1813,9 @@ bool AppInitMain(InitInterfaces& interfaces)
                 LOCK(cs_main);
                 UnloadBlockIndex();
                 pcoinsTip.reset();
-                pcoinsdbview.reset();
                 pcoinscatcher.reset();
+                pcoinsprefetch.reset();
+                pcoinsdbview.reset();
                 // new CBlockTreeDB tries to delete the existing file, which
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
@@ -1503,6 +1830,16 @@ bool AppInitMain(InitInterfaces& interfaces)
 
                 if (ShutdownRequested()) break;
 
+                // The chainstate database is opened, and upgraded if needed, while the block
+                // index loads, neither needs the other.
+                CInitTasks coinsdb;
+                coinsdb.Add("chainstate db", [&] {
+                    pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
+                    // If necessary, upgrade from older database format.
+                    // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
+                    return pcoinsdbview->Upgrade();
+                }, _("Error upgrading chainstate database"));
+
                 // LoadBlockIndex will load fHavePruned if we've ever removed a
                 // block file from disk.
                 // Note that it also sets fReindex based on the disk flag!
@@ -1537,15 +1874,11 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
-                pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
-                pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
-
-                // If necessary, upgrade from older database format.
-                // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
-                if (!pcoinsdbview->Upgrade()) {
-                    strLoadError = _("Error upgrading chainstate database");
+                if (!coinsdb.Wait(strLoadError)) {
                     break;
                 }
+                pcoinsprefetch.reset(new CCoinsViewPrefetch(pcoinsdbview.get(), COINS_PREFETCH_THREADS));
+                pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsprefetch.get()));
 
                 // ReplayBlocks is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
                 if (!ReplayBlocks(chainparams, pcoinsdbview.get())) {
@@ -1553,7 +1886,8 @@ bool AppInitMain(InitInterfaces& interfaces)
                     break;
                 }
 
-                // The on-disk coinsdb is now in a good state, create the cache
+                // The on-disk coinsdb is now in a good state, flush it in the background and create the cache
+                pcoinsdbview->StartWriteBack();
                 pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
 
                 is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
@@ -1573,27 +1907,48 @@ bool AppInitMain(InitInterfaces& interfaces)
                     }
                     assert(chainActive.Tip() != nullptr);
                 }
-                // Load ticket from disk
-                if (!LoadTicketView()) {
-                    strLoadError = _("Error opening ticket database");
-                    break;
-                }
 
                 // Load blockcache best block.
                 g_blockCache->UpdateBestBlockIndex(chainActive.Tip());
+            } catch (const std::exception& e) {
+                LogPrintf("%s\n", e.what());
+                strLoadError = _("Error opening block database");
+                break;
+            }
 
-                // Load relation from disk
-                if (!LoadRelationView()) {
-                    strLoadError = _("Error opening relation database");
-                    break;
-                }
+            try {
+                // The firestone, relation and issuance views each replay their own database up to
+                // the tip, so they load side by side. cs_main is only taken around the fspool,
+                // as the issuance index takes it to read blocks. The best block of pcoinsTip is read
+                // in first, so the views only read it from the cache.
+                pcoinsTip->GetBestBlock();
+                CInitTasks views;
+                views.Add("firestones", [] {
+                    if (!LoadTicketView()) return false;
+                    pticketview->PublishSnapshot();
+                    return true;
+                }, _("Error opening ticket database"));
+                views.Add("relations", [] {
+                    if (!LoadRelationView()) return false;
+                    prelationview->PublishSnapshot(chainActive.Height());
+                    return true;
+                }, _("Error opening relation database"));
+                // Sync the issuance index to the chain tip
+                views.Add("issuances", LoadIssuanceView, _("Error opening issuance database"));
 
                 // Load Fstx from disk
-                if (!LoadFstx(Params().SlotLength())) {
+                bool fFstxLoaded;
+                {
+                    LOCK(cs_main);
+                    fFstxLoaded = LoadFstx(Params().SlotLength());
+                }
+                if (!views.Wait(strLoadError)) {
+                    break;
+                }
+                if (!fFstxLoaded) {
                     strLoadError = _("Error read fstx from fspool");
                     break;
                 }
-
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1673,28 +2028,56 @@ bool AppInitMain(InitInterfaces& interfaces)
         return false;
     }
 
+    const int nCheckPoCIndex = gArgs.GetArg("-checkpocindex", DEFAULT_CHECKPOCINDEX);
+    if (nCheckPoCIndex > 0) {
+        threadGroup.create_thread(std::bind(&ThreadCheckPoCIndex, nCheckPoCIndex));
+    }
+    if (gArgs.GetBoolArg("-persistcoinscache", DEFAULT_PERSIST_COINS_CACHE)) {
+        threadGroup.create_thread(&ThreadLoadCoinsCache);
+    }
+    if (!LoadUTXOStats()) {
+        threadGroup.create_thread(&ThreadRebuildUTXOStats);
+    }
+
     fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
     if (!est_filein.IsNull())
         ::feeEstimator.Read(est_filein);
+    ::feeEstimator.SetDecayByTime(gArgs.GetBoolArg("-feeestimatebytime", DEFAULT_FEE_ESTIMATE_BY_TIME));
     fFeeEstimatesInitialized = true;
 
     // ********************************************************* Step 8: start indexers
     g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
     g_txindex->Start();
+    if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        g_blockfilterindex = MakeUnique<BlockFilterIndex>(BlockFilterType::BASIC, nFilterIndexCache, false, fReindex);
+        g_blockfilterindex->Start();
+    }
+    if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        g_addressindex = MakeUnique<AddressIndex>(nAddressIndexCache, false, fReindex);
+        g_addressindex->Start();
+    }
 
     // ********************************************************* Step 9: load wallet
+    // The wallets are loaded before the mempool is, in ThreadImport, or they would miss the
+    // notifications of the transactions paying to them.
+    const int64_t load_wallets_start_time = GetTimeMillis();
     for (const auto& client : interfaces.chain_clients) {
         if (!client->load()) {
             return false;
         }
     }
+    LogPrintf(" wallets %15dms\n", GetTimeMillis() - load_wallets_start_time);
 
     // ********************************************************* Step 10: data directory maintenance
 
     // if pruning, unset the service bit and perform the initial blockstore prune
     // after any wallet rescanning has taken place.
+    if (fHeadersOnly) {
+        LogPrintf("Unsetting NODE_NETWORK and NODE_NETWORK_LIMITED on headers only mode\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~(NODE_NETWORK | NODE_NETWORK_LIMITED));
+    }
     if (fPruneMode) {
         LogPrintf("Unsetting NODE_NETWORK on prune mode\n");
         nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
@@ -1726,6 +2109,10 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     // Either install a handler to notify us when genesis activates, or set fHaveGenesis directly.
     // No locking, as this happens before any background thread is started.
+    {
+        LOCK(cs_main);
+        g_network_capacity->Reset(chainActive.Tip());
+    }
     if (chainActive.Tip() == nullptr) {
         uiInterface.NotifyBlockTip_connect(BlockNotifyGenesisWait);
     } else {
@@ -1740,6 +2127,10 @@ bool AppInitMain(InitInterfaces& interfaces)
         vImportFiles.push_back(strFile);
     }
 
+    if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL) && gArgs.GetBoolArg("-mempooljournal", DEFAULT_MEMPOOL_JOURNAL)) {
+        g_mempool_journal = MakeUnique<CMempoolJournal>(GetMempoolJournalPath());
+    }
+
     threadGroup.create_thread(std::bind(&ThreadImport, vImportFiles));
 
     // Wait for genesis block to be processed
@@ -1792,6 +2183,8 @@ bool AppInitMain(InitInterfaces& interfaces)
     connOptions.m_msgproc = peerLogic.get();
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMsgHandlerThreads = gArgs.GetArg("-msghandlers", DEFAULT_MSG_HANDLER_THREADS);
+    connOptions.m_use_addr_journal = gArgs.GetBoolArg("-peersjournal", DEFAULT_PEERS_JOURNAL);
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
@@ -1838,6 +2231,27 @@ bool AppInitMain(InitInterfaces& interfaces)
         return false;
     }
 
+    if (gArgs.IsArgSet("-udprelay")) {
+        if (gArgs.GetArg("-udprelaykey", "").empty()) {
+            return InitError(_("Need to specify a shared secret with -udprelaykey to use -udprelay."));
+        }
+        const uint16_t nRelayPort = gArgs.GetArg("-udprelayport", GetListenPort());
+        std::vector<CService> vRelayPeers;
+        for (const std::string& strPeer : gArgs.GetArgs("-udprelay")) {
+            CService addrPeer;
+            if (!Lookup(strPeer.c_str(), addrPeer, nRelayPort, fNameLookup)) {
+                return InitError(ResolveErrMsg("udprelay", strPeer));
+            }
+            vRelayPeers.push_back(addrPeer);
+        }
+        g_udp_relay.reset(new CUDPRelay(vRelayPeers, nRelayPort, gArgs.GetArg("-udprelaykey", "")));
+        std::string strError;
+        if (!g_udp_relay->Start(strError)) {
+            return InitError(strError);
+        }
+        RegisterValidationInterface(g_udp_relay.get(), "udprelay");
+    }
+
     // ********************************************************* Step 13: finished
 
     SetRPCWarmupFinished();
@@ -1851,7 +2265,40 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL * 1000);
 
-    scheduler.scheduleEvery([] {blockAssember.CheckDeadline(); }, 200);
-    scheduler.scheduleEvery([] {g_blockCache->PushBlock(); }, 200);
+    if (gArgs.GetBoolArg("-archiveblocks", DEFAULT_ARCHIVE_BLOCKS)) {
+        scheduler.scheduleEvery(ArchiveBlockFiles, BLOCK_ARCHIVE_INTERVAL * 1000);
+    }
+
+    if (g_mempool_journal) {
+        scheduler.scheduleEvery([]{
+            g_mempool_journal->Flush();
+            if (g_is_mempool_loaded && g_mempool_journal->Size() > MAX_MEMPOOL_JOURNAL_SIZE) {
+                DumpMempool();
+            }
+        }, MEMPOOL_JOURNAL_FLUSH_INTERVAL * 1000);
+    }
+
+    blockAssember.SetScheduler(&scheduler);
+    g_blockCache->SetScheduler(&scheduler);
+
+    if (gArgs.IsArgSet("-plotdir")) {
+        CTxDestination dest = DecodeDestination(gArgs.GetArg("-mineraddress", ""));
+        if (dest.type() != typeid(CKeyID)) {
+            return InitError(strprintf(_("Invalid -mineraddress: '%s'"), gArgs.GetArg("-mineraddress", "")));
+        }
+        const CKeyID keyid = boost::get<CKeyID>(dest);
+        std::vector<CPlotFile> plots;
+        for (const std::string& strDir : gArgs.GetArgs("-plotdir")) {
+            fs::path dir = fs::system_complete(strDir);
+            if (!fs::is_directory(dir)) {
+                return InitError(strprintf(_("Specified -plotdir \"%s\" does not exist."), strDir));
+            }
+            auto found = FindPlotFiles(dir, keyid);
+            plots.insert(plots.end(), found.begin(), found.end());
+        }
+        const size_t readSize = std::max<int64_t>(gArgs.GetArg("-plotreadsize", DEFAULT_PLOT_READ_SIZE), 1) * 1024;
+        g_plotminer = MakeUnique<CPlotMiner>(keyid, std::move(plots), readSize, gArgs.GetBoolArg("-plotmmap", DEFAULT_PLOT_MMAP));
+        g_plotminer->Start(gArgs.GetArg("-minerthreads", DEFAULT_MINER_THREADS), g_miner_cpus);
+    }
     return true;
 }
@@ -126,7 +126,7 @@ WalletTxOut MakeWalletTxOut(interfaces::Chain::Lock& locked_chain,
     int depth) EXCLUSIVE_LOCKS_REQUIRED(wallet.cs_wallet)
 {
     WalletTxOut result;
-    result.txout = wtx.tx->vout[n];
+    result.txout = wtx.tx->vout[n].WithoutProofs();
     result.time = wtx.GetTxTime();
     result.depth_in_main_chain = depth;
     result.is_spent = wallet.IsSpent(locked_chain, wtx.GetHash(), n);
@@ -326,6 +326,16 @@ public:
         }
         return result;
     }
+    std::vector<WalletTx> getWalletTxs(const uint256& after, size_t count) override
+    {
+        auto locked_chain = m_wallet->chain().lock();
+        LOCK(m_wallet->cs_wallet);
+        std::vector<WalletTx> result;
+        for (auto it = m_wallet->mapWallet.upper_bound(after); it != m_wallet->mapWallet.end() && result.size() < count; ++it) {
+            result.emplace_back(MakeWalletTx(*locked_chain, *m_wallet, it->second));
+        }
+        return result;
+    }
     bool tryGetTxStatus(const uint256& txid,
         interfaces::WalletTxStatus& tx_status,
         int& num_blocks,
@@ -177,6 +177,10 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    //! Get up to count wallet transactions with txid greater than after, in
+    //! txid order. Pass a null txid for the first page.
+    virtual std::vector<WalletTx> getWalletTxs(const uint256& after, size_t count) = 0;
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
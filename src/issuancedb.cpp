@@ -0,0 +1,141 @@
+#include <issuancedb.h>
+#include <issuance.h>
+#include <logging.h>
+#include <util/system.h>
+
+static const char DB_ISSUANCE = 'i';
+static const char DB_REISSUANCE = 'r';
+static const char DB_SYNCED_BLOCK = 'B';
+
+CIssuanceView::CIssuanceView(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CDBWrapper(GetDataDir() / "issuance", nCacheSize, fMemory, fWipe)
+{
+}
+
+void CIssuanceView::ConnectBlock(const int height, const CBlock &blk)
+{
+    CDBBatch batch(*this);
+    for (const auto& tx : blk.vtx) {
+        for (uint32_t i = 0; i < tx->vin.size(); i++) {
+            const CAssetIssuance& issuance = tx->vin[i].assetIssuance;
+            if (issuance.IsNull())
+                continue;
+            CAsset asset;
+            if (issuance.assetBlindingNonce.IsNull()) {
+                CIssuanceInfo info;
+                GenerateAssetEntropy(info.entropy, tx->vin[i].prevout, issuance.assetEntropy);
+                CalculateAsset(asset, info.entropy);
+                CalculateReissuanceToken(info.token, info.entropy, issuance.nAmount.IsCommitment());
+                info.txid = tx->GetHash();
+                info.nIn = i;
+                info.nHeight = height;
+                batch.Write(std::make_pair(DB_ISSUANCE, asset), info);
+            } else {
+                CalculateAsset(asset, issuance.assetEntropy);
+                batch.Write(std::make_pair(DB_REISSUANCE, std::make_pair(asset, tx->GetHash())), height);
+            }
+        }
+    }
+    batch.Write(DB_SYNCED_BLOCK, blk.GetHash());
+    if (!WriteBatch(batch)) {
+        LogPrintf("%s: WriteBatch failure, height:%d\n", __func__, height);
+    }
+}
+
+void CIssuanceView::DisconnectBlock(const int height, const CBlock &blk)
+{
+    CDBBatch batch(*this);
+    for (const auto& tx : blk.vtx) {
+        for (const auto& txin : tx->vin) {
+            const CAssetIssuance& issuance = txin.assetIssuance;
+            if (issuance.IsNull())
+                continue;
+            CAsset asset;
+            if (issuance.assetBlindingNonce.IsNull()) {
+                uint256 entropy;
+                GenerateAssetEntropy(entropy, txin.prevout, issuance.assetEntropy);
+                CalculateAsset(asset, entropy);
+                batch.Erase(std::make_pair(DB_ISSUANCE, asset));
+            } else {
+                CalculateAsset(asset, issuance.assetEntropy);
+                batch.Erase(std::make_pair(DB_REISSUANCE, std::make_pair(asset, tx->GetHash())));
+            }
+        }
+    }
+    batch.Write(DB_SYNCED_BLOCK, blk.hashPrevBlock);
+    if (!WriteBatch(batch)) {
+        LogPrintf("%s: WriteBatch failure, height:%d\n", __func__, height);
+    }
+}
+
+bool CIssuanceView::GetIssuance(const CAsset& asset, CIssuanceInfo& info) const
+{
+    return Read(std::make_pair(DB_ISSUANCE, asset), info);
+}
+
+std::vector<uint256> CIssuanceView::GetReissuances(const CAsset& asset) const
+{
+    std::vector<uint256> txids;
+    std::unique_ptr<CDBIterator> pcursor(const_cast<CIssuanceView*>(this)->NewIterator());
+    pcursor->Seek(std::make_pair(DB_REISSUANCE, asset));
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<CAsset, uint256>> key;
+        if (!pcursor->GetKey(key) || key.first != DB_REISSUANCE || key.second.first != asset)
+            break;
+        txids.push_back(key.second.second);
+        pcursor->Next();
+    }
+    return txids;
+}
+
+std::vector<std::pair<CAsset, CIssuanceInfo>> CIssuanceView::ListIssuances() const
+{
+    std::vector<std::pair<CAsset, CIssuanceInfo>> issuances;
+    std::unique_ptr<CDBIterator> pcursor(const_cast<CIssuanceView*>(this)->NewIterator());
+    pcursor->Seek(std::make_pair(DB_ISSUANCE, CAsset()));
+    while (pcursor->Valid()) {
+        std::pair<char, CAsset> key;
+        CIssuanceInfo info;
+        if (!pcursor->GetKey(key) || key.first != DB_ISSUANCE)
+            break;
+        if (!pcursor->GetValue(info)) {
+            LogPrintf("%s: cannot read the issuance of %s\n", __func__, key.second.GetHex());
+            break;
+        }
+        issuances.emplace_back(key.second, info);
+        pcursor->Next();
+    }
+    return issuances;
+}
+
+uint256 CIssuanceView::SyncedBlock() const
+{
+    uint256 hash;
+    if (!Read(DB_SYNCED_BLOCK, hash))
+        hash.SetNull();
+    return hash;
+}
+
+bool CIssuanceView::Clear()
+{
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_ISSUANCE, CAsset()));
+    while (pcursor->Valid()) {
+        std::pair<char, CAsset> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ISSUANCE)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+    pcursor->Seek(std::make_pair(DB_REISSUANCE, CAsset()));
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<CAsset, uint256>> key;
+        if (!pcursor->GetKey(key) || key.first != DB_REISSUANCE)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+    batch.Erase(DB_SYNCED_BLOCK);
+    return WriteBatch(batch, true);
+}
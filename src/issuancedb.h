@@ -0,0 +1,86 @@
+#ifndef LAVA_ISSUANCE_DB_H
+#define LAVA_ISSUANCE_DB_H
+
+#include <asset.h>
+#include <dbwrapper.h>
+#include <primitives/block.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <utility>
+#include <vector>
+
+/**
+ * The initial issuance of an asset, as it is kept by the issuance index.
+ */
+struct CIssuanceInfo
+{
+    uint256 entropy;
+    CAsset token;
+    uint256 txid;
+    uint32_t nIn;
+    int32_t nHeight;
+
+    CIssuanceInfo() : nIn(0), nHeight(-1) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(entropy);
+        READWRITE(token);
+        READWRITE(txid);
+        READWRITE(nIn);
+        READWRITE(nHeight);
+    }
+};
+
+/**
+ * Index of the assets issued on the active chain: asset -> entropy, issuance txid and
+ * reissuance token, plus the txids reissuing each asset. The ids are hashed once when
+ * the block is connected, instead of on every lookup by the wallet and the RPCs.
+ */
+class CIssuanceView : public CDBWrapper
+{
+public:
+    explicit CIssuanceView(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    ~CIssuanceView() = default;
+
+    /**
+     * ConnectBlock records the issuances of a block, which is called by ConnectBlock of the chain state.
+     * @param[in]    height  the block height.
+     * @param[in]    blk     the block being connected.
+     */
+    void ConnectBlock(const int height, const CBlock &blk);
+
+    /**
+     * DisconnectBlock removes the issuances of the block, which must be the tip.
+     * @param[in]    height  the block height.
+     * @param[in]    blk     the block being disconnected.
+     */
+    void DisconnectBlock(const int height, const CBlock &blk);
+
+    /**
+     * Find the initial issuance of an asset.
+     * @return      false if the asset was not issued on the active chain.
+     */
+    bool GetIssuance(const CAsset& asset, CIssuanceInfo& info) const;
+
+    /** List the txids of the reissuances of an asset. */
+    std::vector<uint256> GetReissuances(const CAsset& asset) const;
+
+    /** List the initial issuances of all assets. */
+    std::vector<std::pair<CAsset, CIssuanceInfo>> ListIssuances() const;
+
+    /** Return the hash of the block the index was last synced to, null if it never was. */
+    uint256 SyncedBlock() const;
+
+    /**
+     * Drop the whole index, so it can be rebuilt by connecting the active chain again.
+     * @return      false if the entries cannot be erased.
+     */
+    bool Clear();
+};
+
+#endif // LAVA_ISSUANCE_DB_H
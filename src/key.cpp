@@ -13,6 +13,7 @@
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 #include <secp256k1_ecdh.h>
+#include <secp256k1_schnorrsig.h>
 
 static secp256k1_context* secp256k1_context_sign = nullptr;
 
@@ -263,6 +264,18 @@ bool CKey::SignCompact(const uint256 &hash, std::vector<unsigned char>& vchSig)
     return true;
 }
 
+bool CKey::SignSchnorr(const uint256 &hash, std::vector<unsigned char>& vchSig) const {
+    if (!fValid)
+        return false;
+    vchSig.resize(CPubKey::SCHNORR_SIGNATURE_SIZE);
+    secp256k1_schnorrsig sig;
+    int ret = secp256k1_schnorrsig_sign(secp256k1_context_sign, &sig, nullptr, hash.begin(), begin(), nullptr, nullptr);
+    assert(ret);
+    ret = secp256k1_schnorrsig_serialize(secp256k1_context_sign, vchSig.data(), &sig);
+    assert(ret);
+    return true;
+}
+
 bool CKey::Load(const CPrivKey &privkey, const CPubKey &vchPubKey, bool fSkipCheck=false) {
     if (!ec_privkey_import_der(secp256k1_context_sign, (unsigned char*)begin(), privkey.data(), privkey.size()))
         return false;
@@ -0,0 +1,261 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <chainparams.h>
+#include <chainparamsbase.h>
+#include <clientversion.h>
+#include <crypto/shabal256.h>
+#include <fs.h>
+#include <key_io.h>
+#include <poc.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
+
+/** Default for -batch: the nonces generated before they are written, 128 MiB of them. */
+static const uint64_t DEFAULT_PLOTTER_BATCH = 512;
+
+static void SetupPlotterArgs()
+{
+    SetupHelpOptions(gArgs);
+    SetupChainParamsBaseOptions();
+
+    gArgs.AddArg("-address=<addr>", "Address whose poc2.x nonces are plotted", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-startnonce=<n>", "First nonce of the plot file (default: 0)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-nonces=<n>", "Number of nonces of the plot file, 256 KiB each", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-plotdir=<dir>", "Directory the plot file is written to (default: the current directory)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-threads=<n>", "Number of threads generating nonces, 0 for one per core (default: 0)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-batch=<n>", strprintf("Number of nonces generated before they are written; two batches are held in memory (default: %u)", DEFAULT_PLOTTER_BATCH), false, OptionsCategory::OPTIONS);
+}
+
+/** The plot being written, under a name the plot miner ignores until it is complete. */
+struct CPlotJob
+{
+    CKeyID keyID;
+    uint64_t startNonce;
+    uint64_t nonces;
+    fs::path path;          //!< the name of the complete plot file
+    fs::path pathPartial;   //!< the name while it is written
+    fs::path pathProgress;  //!< the number of nonces written so far, for resuming
+};
+
+/** Read how many nonces of an interrupted plot were written, 0 to start over. */
+static uint64_t ReadProgress(const CPlotJob& job)
+{
+    if (!fs::exists(job.pathPartial))
+        return 0;
+    FILE* file = fsbridge::fopen(job.pathProgress, "r");
+    if (!file)
+        return 0;
+    char buf[32] = {};
+    const size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    uint64_t done;
+    if (!ParseUInt64(std::string(buf, len), &done) || done > job.nonces)
+        return 0;
+    return done;
+}
+
+static bool WriteProgress(const CPlotJob& job, const uint64_t done)
+{
+    const fs::path pathTmp = job.pathProgress.string() + ".new";
+    FILE* file = fsbridge::fopen(pathTmp, "w");
+    if (!file)
+        return false;
+    const std::string str = strprintf("%u", done);
+    const bool fOk = fwrite(str.data(), 1, str.size(), file) == str.size() && FileCommit(file);
+    fclose(file);
+    return fOk && RenameOver(pathTmp, job.pathProgress);
+}
+
+static bool Seek(FILE* file, const uint64_t pos)
+{
+#ifdef WIN32
+    return _fseeki64(file, pos, SEEK_SET) == 0;
+#else
+    return fseeko(file, pos, SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * Write the scoops of nonces first to first + count - 1, held column by column in batch, to their
+ * place in each of the scoop columns of the plot file, and commit them to disk.
+ */
+static bool WriteBatch(FILE* file, const CPlotJob& job, const std::vector<uint8_t>& batch, const size_t columnStride, const uint64_t first, const uint64_t count)
+{
+    for (size_t s = 0; s < POC_SCOOP_COUNT; s++) {
+        const uint64_t pos = (s * job.nonces + first) * POC_SCOOP_SIZE;
+        if (!Seek(file, pos) || fwrite(&batch[s * columnStride], POC_SCOOP_SIZE, count, file) != count)
+            return false;
+    }
+    return FileCommit(file);
+}
+
+/** Generate nonces first to first + count - 1 of the plot into batch, spread over nThreads threads. */
+static void GenerateBatch(const CPlotJob& job, std::vector<uint8_t>& batch, const size_t columnStride, const uint64_t first, const uint64_t count, const int nThreads)
+{
+    // Hand out whole lane groups, so no thread runs the engine half empty but the last.
+    const uint64_t width = std::max<size_t>(Shabal256Lanes(), 1);
+    const uint64_t groups = (count + width - 1) / width;
+    const uint64_t perThread = (groups + nThreads - 1) / nThreads * width;
+    std::vector<std::thread> threads;
+    for (uint64_t begin = 0; begin < count; begin += perThread) {
+        const uint64_t n = std::min(perThread, count - begin);
+        threads.emplace_back([&job, &batch, columnStride, first, begin, n] {
+            GenerateNonceScoops(job.keyID, job.startNonce + first + begin, n, &batch[begin * POC_SCOOP_SIZE], columnStride);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+static bool Plot(const CPlotJob& job, const int nThreads, const uint64_t nBatch)
+{
+    uint64_t done = ReadProgress(job);
+    FILE* file = fsbridge::fopen(job.pathPartial, done > 0 ? "rb+" : "wb");
+    if (!file) {
+        fprintf(stderr, "Error: cannot open %s\n", job.pathPartial.string().c_str());
+        return false;
+    }
+    if (done > 0) {
+        fprintf(stdout, "%s", strprintf("Resuming %s at nonce %u of %u\n", job.path.filename().string(), done, job.nonces).c_str());
+    }
+
+    // One batch is generated while the other is written.
+    const size_t columnStride = nBatch * POC_SCOOP_SIZE;
+    std::vector<uint8_t> batches[2];
+    batches[0].resize(POC_SCOOP_COUNT * columnStride);
+    batches[1].resize(POC_SCOOP_COUNT * columnStride);
+    std::thread writer;
+    std::atomic<bool> fWriteFailed(false);
+    const int64_t nStart = GetTimeMillis();
+    const uint64_t nResumed = done;
+    for (int k = 0; done < job.nonces; k ^= 1) {
+        const uint64_t count = std::min(nBatch, job.nonces - done);
+        GenerateBatch(job, batches[k], columnStride, done, count, nThreads);
+        if (writer.joinable())
+            writer.join();
+        if (fWriteFailed)
+            break;
+        writer = std::thread([&job, &batches, &fWriteFailed, file, columnStride, k, done, count] {
+            if (!WriteBatch(file, job, batches[k], columnStride, done, count) || !WriteProgress(job, done + count))
+                fWriteFailed = true;
+        });
+        done += count;
+        const int64_t nElapsed = std::max<int64_t>(GetTimeMillis() - nStart, 1);
+        fprintf(stdout, "%s", strprintf("\r%u of %u nonces, %u nonces/min", done, job.nonces, (done - nResumed) * 60000 / nElapsed).c_str());
+        fflush(stdout);
+    }
+    if (writer.joinable())
+        writer.join();
+    fprintf(stdout, "\n");
+    fclose(file);
+    if (fWriteFailed) {
+        fprintf(stderr, "Error: cannot write %s, run again to resume\n", job.pathPartial.string().c_str());
+        return false;
+    }
+
+    if (!RenameOver(job.pathPartial, job.path)) {
+        fprintf(stderr, "Error: cannot rename %s\n", job.pathPartial.string().c_str());
+        return false;
+    }
+    fs::remove(job.pathProgress);
+    fprintf(stdout, "Plotted %s\n", job.path.string().c_str());
+    return true;
+}
+
+static bool PlotterAppInit(int argc, char* argv[], CPlotJob& job)
+{
+    SetupPlotterArgs();
+    std::string error_message;
+    if (!gArgs.ParseParameters(argc, argv, error_message)) {
+        fprintf(stderr, "Error parsing command line arguments: %s\n", error_message.c_str());
+        return false;
+    }
+    if (argc < 2 || HelpRequested(gArgs)) {
+        std::string usage = strprintf("%s lava-plotter version", PACKAGE_NAME) + " " + FormatFullVersion() + "\n\n" +
+                                      "lava-plotter writes the poc2.x plot file <keyid>_<startnonce>_<nonces> of an address,\n" +
+                                      "laid out scoop by scoop as the plot miner of -plotdir reads it. An interrupted plot is\n" +
+                                      "resumed by running the same command again.\n\n" +
+                                      "Usage:\n" +
+                                      "  lava-plotter -address=<addr> -nonces=<n> [options]\n\n" +
+                                      gArgs.GetHelpMessage();
+        fprintf(stdout, "%s", usage.c_str());
+        return false;
+    }
+    // Check for -testnet or -regtest parameter (Params() calls are only valid after this clause)
+    SelectParams(gArgs.GetChainName());
+
+    const CTxDestination dest = DecodeDestination(gArgs.GetArg("-address", ""));
+    if (dest.type() != typeid(CKeyID)) {
+        fprintf(stderr, "Error: -address must be a pay to public key hash address\n");
+        return false;
+    }
+    job.keyID = boost::get<CKeyID>(dest);
+    if (!ParseUInt64(gArgs.GetArg("-startnonce", "0"), &job.startNonce) || !ParseUInt64(gArgs.GetArg("-nonces", ""), &job.nonces) || job.nonces == 0) {
+        fprintf(stderr, "Error: -startnonce and -nonces must be numbers, -nonces above 0\n");
+        return false;
+    }
+    if (job.startNonce + job.nonces < job.startNonce) {
+        fprintf(stderr, "Error: the nonces run past the last nonce\n");
+        return false;
+    }
+    const fs::path dir = fs::absolute(gArgs.GetArg("-plotdir", "."));
+    if (!fs::is_directory(dir)) {
+        fprintf(stderr, "Error: plot directory %s does not exist\n", dir.string().c_str());
+        return false;
+    }
+    // The key id is named as ParsePlotFile reads it.
+    job.path = dir / strprintf("%s_%u_%u", job.keyID.GetHex(), job.startNonce, job.nonces);
+    job.pathPartial = job.path.string() + ".plotting";
+    job.pathProgress = job.path.string() + ".progress";
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef WIN32
+    util::WinCmdLineArgs winArgs;
+    std::tie(argc, argv) = winArgs.get();
+#endif
+    SetupEnvironment();
+    CPlotJob job;
+    try {
+        if (!PlotterAppInit(argc, argv, job)) return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "PlotterAppInit()");
+        return EXIT_FAILURE;
+    }
+
+    const std::string strEngine = Shabal256AutoDetect();
+    int nThreads = gArgs.GetArg("-threads", 0);
+    if (nThreads <= 0)
+        nThreads = std::max(GetNumCores(), 1);
+    const uint64_t nBatch = std::max<int64_t>(gArgs.GetArg("-batch", DEFAULT_PLOTTER_BATCH), 1);
+    if (fs::exists(job.path)) {
+        fprintf(stdout, "%s is already plotted\n", job.path.string().c_str());
+        return EXIT_SUCCESS;
+    }
+    fprintf(stdout, "%s", strprintf("Plotting %u nonces with %d threads, Shabal engine %s\n", job.nonces, nThreads, strEngine).c_str());
+    try {
+        if (!Plot(job, nThreads, nBatch)) return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "Plot()");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
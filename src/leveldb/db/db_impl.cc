@@ -5,10 +5,12 @@
 #include "db/db_impl.h"
 
 #include <algorithm>
+#include <atomic>
 #include <set>
 #include <string>
 #include <stdint.h>
 #include <stdio.h>
+#include <thread>
 #include <vector>
 #include "db/builder.h"
 #include "db/db_iter.h"
@@ -71,13 +73,28 @@ struct DBImpl::CompactionState {
 
   uint64_t total_bytes;
 
+  // The user keys [start, end) a subcompaction merges; a missing bound
+  // leaves the range open on that side.
+  bool has_start;
+  std::string start;
+  bool has_end;
+  std::string end;
+
+  // Position of the pass over the range
+  Compaction::Cursor cursor;
+
+  // Result of a subcompaction run on a thread of its own
+  Status status;
+
   Output* current_output() { return &outputs[outputs.size()-1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
         outfile(NULL),
         builder(NULL),
-        total_bytes(0) {
+        total_bytes(0),
+        has_start(false),
+        has_end(false) {
   }
 };
 
@@ -98,6 +115,10 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64<<10,                      1<<30);
   ClipToRange(&result.max_file_size,     1<<20,                       1<<30);
   ClipToRange(&result.block_size,        1<<10,                       4<<20);
+  ClipToRange(&result.l0_compaction_trigger, 1,                       1<<10);
+  ClipToRange(&result.l0_slowdown_writes_trigger, result.l0_compaction_trigger, 1<<10);
+  ClipToRange(&result.l0_stop_writes_trigger, result.l0_slowdown_writes_trigger, 1<<10);
+  ClipToRange(&result.max_subcompactions, 1,                          64);
   if (result.info_log == NULL) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -134,7 +155,9 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       seed_(0),
       tmp_batch_(new WriteBatch),
       bg_compaction_scheduled_(false),
-      manual_compaction_(NULL) {
+      manual_compaction_(NULL),
+      subcompactions_(0),
+      stall_micros_(0) {
   has_imm_.Release_Store(NULL);
 
   // Reserve ten files or so for other uses and give the rest to TableCache.
@@ -884,6 +907,53 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
+void DBImpl::SplitCompaction(CompactionState* compact,
+                             std::vector<CompactionState*>* subs) {
+  Compaction* const c = compact->compaction;
+  const int inputs = c->num_input_files(1);
+  const int parts = std::min(options_.max_subcompactions, inputs);
+  if (c->level() != 0 || parts < 2) {
+    return;
+  }
+
+  // Cut at the smallest keys of evenly spaced level-1 inputs.  Every entry
+  // of a user key falls in one range, so dropping the entries it hides
+  // works as in a single pass.
+  std::vector<std::string> bounds;
+  for (int i = 1; i < parts; i++) {
+    const Slice key = c->input(1, i * inputs / parts)->smallest.user_key();
+    if (bounds.empty() || user_comparator()->Compare(key, bounds.back()) > 0) {
+      bounds.push_back(key.ToString());
+    }
+  }
+  for (size_t i = 0; i <= bounds.size(); i++) {
+    CompactionState* sub = new CompactionState(c);
+    sub->smallest_snapshot = compact->smallest_snapshot;
+    if (i > 0) {
+      sub->has_start = true;
+      sub->start = bounds[i - 1];
+    }
+    if (i < bounds.size()) {
+      sub->has_end = true;
+      sub->end = bounds[i];
+    }
+    subs->push_back(sub);
+  }
+}
+
+void DBImpl::CompactImmutableMemTable(int64_t* imm_micros) {
+  if (has_imm_.NoBarrier_Load() != NULL) {
+    const uint64_t imm_start = env_->NowMicros();
+    mutex_.Lock();
+    if (imm_ != NULL) {
+      CompactMemTable();
+      bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
+    }
+    mutex_.Unlock();
+    *imm_micros += (env_->NowMicros() - imm_start);
+  }
+}
+
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
   int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
@@ -903,11 +973,92 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->number_;
   }
 
+  std::vector<CompactionState*> subs;
+  SplitCompaction(compact, &subs);
+  if (!subs.empty()) {
+    subcompactions_ += subs.size();
+    Log(options_.info_log, "Split into %d subcompactions",
+        static_cast<int>(subs.size()));
+  }
+
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  Status status;
+  if (subs.empty()) {
+    status = DoSubcompactionWork(compact, &imm_micros);
+  } else {
+    // This thread takes the first range, and keeps the memtable flowing
+    // until the other ranges are done.
+    std::atomic<size_t> running(subs.size() - 1);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < subs.size(); i++) {
+      CompactionState* sub = subs[i];
+      threads.emplace_back([this, sub, &running] {
+        sub->status = DoSubcompactionWork(sub, NULL);
+        running--;
+      });
+    }
+    subs[0]->status = DoSubcompactionWork(subs[0], &imm_micros);
+    while (running.load() > 0) {
+      CompactImmutableMemTable(&imm_micros);
+      env_->SleepForMicroseconds(1000);
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+  }
+
+  mutex_.Lock();
+  // The outputs of the ranges are in key order, as if written in one pass.
+  for (size_t i = 0; i < subs.size(); i++) {
+    CompactionState* sub = subs[i];
+    if (status.ok()) {
+      status = sub->status;
+    }
+    compact->outputs.insert(compact->outputs.end(), sub->outputs.begin(),
+                            sub->outputs.end());
+    compact->total_bytes += sub->total_bytes;
+    sub->outputs.clear();
+    CleanupCompaction(sub);
+  }
+  mutex_.Unlock();
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size;
+  }
+
+  mutex_.Lock();
+  stats_[compact->compaction->level() + 1].Add(stats);
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log,
+      "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+Status DBImpl::DoSubcompactionWork(CompactionState* compact,
+                                   int64_t* imm_micros) {
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
-  input->SeekToFirst();
+  if (compact->has_start) {
+    InternalKey start(compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst();
+  }
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
@@ -915,19 +1066,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
     // Prioritize immutable compaction work
-    if (has_imm_.NoBarrier_Load() != NULL) {
-      const uint64_t imm_start = env_->NowMicros();
-      mutex_.Lock();
-      if (imm_ != NULL) {
-        CompactMemTable();
-        bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
-      }
-      mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+    if (imm_micros != NULL) {
+      CompactImmutableMemTable(imm_micros);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (compact->has_end && key.size() >= 8 &&
+        user_comparator()->Compare(ExtractUserKey(key),
+                                   Slice(compact->end)) >= 0) {
+      break;
+    }
+    if (compact->compaction->ShouldStopBefore(key, &compact->cursor) &&
         compact->builder != NULL) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
@@ -957,7 +1106,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;    // (A)
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->cursor)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -976,7 +1126,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         "%d smallest_snapshot: %d",
         ikey.user_key.ToString().c_str(),
         (int)ikey.sequence, ikey.type, kTypeValue, drop,
-        compact->compaction->IsBaseLevelForKey(ikey.user_key),
+        compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                               &compact->cursor),
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
@@ -1018,30 +1169,6 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   }
   delete input;
   input = NULL;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log,
-      "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1327,17 +1454,19 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       break;
     } else if (
         allow_delay &&
-        versions_->NumLevelFiles(0) >= config::kL0_SlowdownWritesTrigger) {
+        versions_->NumLevelFiles(0) >= options_.l0_slowdown_writes_trigger) {
       // We are getting close to hitting a hard limit on the number of
       // L0 files.  Rather than delaying a single write by several
       // seconds when we hit the hard limit, start delaying each
       // individual write by 1ms to reduce latency variance.  Also,
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
+      const uint64_t stall_start = env_->NowMicros();
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
+      stall_micros_ += env_->NowMicros() - stall_start;
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
@@ -1346,11 +1475,15 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       bg_cv_.Wait();
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
+      stall_micros_ += env_->NowMicros() - stall_start;
+    } else if (versions_->NumLevelFiles(0) >= options_.l0_stop_writes_trigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       bg_cv_.Wait();
+      stall_micros_ += env_->NowMicros() - stall_start;
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1424,6 +1557,20 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
       }
     }
     return true;
+  } else if (in == "compaction-totals") {
+    CompactionStats total;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      total.Add(stats_[level]);
+    }
+    char buf[200];
+    snprintf(buf, sizeof(buf), "%llu %llu %llu %llu %llu",
+             static_cast<unsigned long long>(total.micros),
+             static_cast<unsigned long long>(total.bytes_read),
+             static_cast<unsigned long long>(total.bytes_written),
+             static_cast<unsigned long long>(subcompactions_),
+             static_cast<unsigned long long>(stall_micros_));
+    value->append(buf);
+    return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
@@ -113,6 +113,19 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Split a level-0 compaction into subcompactions over disjoint user key
+  // ranges, or leave *subs empty to compact it in a single pass.
+  void SplitCompaction(CompactionState* compact,
+                       std::vector<CompactionState*>* subs);
+
+  // Merge the input keys of the range of compact into its outputs.  Only
+  // the pass handed imm_micros compacts the immutable memtable meanwhile.
+  Status DoSubcompactionWork(CompactionState* compact, int64_t* imm_micros);
+
+  // Compact the immutable memtable, if there is one, ahead of the
+  // compaction running without mutex_.
+  void CompactImmutableMemTable(int64_t* imm_micros);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
@@ -190,6 +203,12 @@ class DBImpl : public DB {
   };
   CompactionStats stats_[config::kNumLevels];
 
+  // Number of subcompactions level-0 compactions were split into.
+  uint64_t subcompactions_;
+
+  // Time writers were delayed or stopped for the compactions to catch up.
+  uint64_t stall_micros_;
+
   // No copying allowed
   DBImpl(const DBImpl&);
   void operator=(const DBImpl&);
@@ -113,6 +113,10 @@ class DB {
   //     where <N> is an ASCII representation of a level number (e.g. "0").
   //  "leveldb.stats" - returns a multi-line string that describes statistics
   //     about the internal operation of the DB.
+  //  "leveldb.compaction-totals" - returns the totals since the DB was
+  //     opened of the compaction time in micros, the bytes compactions read
+  //     and wrote, the number of subcompactions, and the micros writes were
+  //     delayed or stopped, separated by spaces.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
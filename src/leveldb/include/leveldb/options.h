@@ -124,6 +124,30 @@ struct Options {
   // Default: 2MB
   size_t max_file_size;
 
+  // Number of level-0 files that triggers their compaction into level-1.
+  //
+  // Default: 4
+  int l0_compaction_trigger;
+
+  // Number of level-0 files at which each write is delayed by 1ms, to
+  // hand the compaction some room before writes are stopped.
+  //
+  // Default: 8
+  int l0_slowdown_writes_trigger;
+
+  // Number of level-0 files at which writes are stopped until the
+  // compaction catches up.
+  //
+  // Default: 12
+  int l0_stop_writes_trigger;
+
+  // Number of threads a compaction of level-0 into level-1 is split over.
+  // The key range is cut at the boundaries of the level-1 input files, so
+  // a compaction with fewer level-1 inputs runs on fewer threads.
+  //
+  // Default: 1
+  int max_subcompactions;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
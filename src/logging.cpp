@@ -4,10 +4,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <logging.h>
+#include <util/system.h>
 #include <util/time.h>
 
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
+/** Size of the lines buffered for the writer thread past which logging waits for it. */
+static const size_t MAX_LOG_BUFFER = 16 * 1024 * 1024;
+
 BCLog::Logger& LogInstance()
 {
 /**
@@ -127,6 +131,7 @@ const CLogCategoryDesc LogCategories[] =
     {BCLog::LEVELDB, "leveldb"},
     {BCLog::FIRESTONE, "firestone"},
     {BCLog::RELATION, "relation"},
+    {BCLog::FORGE, "forge"},
     {BCLog::ALL, "1"},
     {BCLog::ALL, "all"},
 };
@@ -216,6 +221,19 @@ void BCLog::Logger::LogPrintStr(const std::string &str)
         fflush(stdout);
     }
     if (m_print_to_file) {
+        if (m_async.load(std::memory_order_relaxed)) {
+            std::unique_lock<std::mutex> lock(m_buffer_mutex);
+            // Wait for the writer rather than let the buffer grow without bound.
+            m_buffer_cond.wait(lock, [this] { return m_buffer.size() < MAX_LOG_BUFFER || !m_async; });
+            // The writer may have stopped meanwhile, the line is then written directly.
+            if (m_async) {
+                if (m_buffer.empty())
+                    m_buffer_cond.notify_all();
+                m_buffer += strTimestamped;
+                return;
+            }
+        }
+
         std::lock_guard<std::mutex> scoped_lock(m_file_mutex);
 
         // buffer if we haven't opened the log yet
@@ -224,19 +242,73 @@ void BCLog::Logger::LogPrintStr(const std::string &str)
         }
         else
         {
-            // reopen the log file, if requested
-            if (m_reopen_file) {
-                m_reopen_file = false;
-                FILE* new_fileout = fsbridge::fopen(m_file_path, "a");
-                if (new_fileout) {
-                    setbuf(new_fileout, nullptr); // unbuffered
-                    fclose(m_fileout);
-                    m_fileout = new_fileout;
-                }
+            WriteToFile(strTimestamped);
+        }
+    }
+}
+
+void BCLog::Logger::WriteToFile(const std::string& str)
+{
+    // reopen the log file, if requested
+    if (m_reopen_file) {
+        m_reopen_file = false;
+        FILE* new_fileout = fsbridge::fopen(m_file_path, "a");
+        if (new_fileout) {
+            setbuf(new_fileout, nullptr); // unbuffered
+            fclose(m_fileout);
+            m_fileout = new_fileout;
+        }
+    }
+    FileWriteStr(str, m_fileout);
+}
+
+void BCLog::Logger::WriterThread()
+{
+    RenameThread("bitcoin-logger");
+    std::string buffer;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_buffer_mutex);
+            m_buffer_cond.wait(lock, [this] { return !m_buffer.empty() || m_writer_stop; });
+            if (m_buffer.empty()) {
+                // Stopping with everything written: lines from now on are written directly,
+                // after all the buffered ones.
+                m_async = false;
+                m_buffer_cond.notify_all();
+                return;
             }
-            FileWriteStr(strTimestamped, m_fileout);
+            buffer.swap(m_buffer);
+            m_buffer_cond.notify_all();
+        }
+        {
+            std::lock_guard<std::mutex> scoped_lock(m_file_mutex);
+            WriteToFile(buffer);
         }
+        buffer.clear();
+    }
+}
+
+void BCLog::Logger::StartAsyncWriter()
+{
+    std::lock_guard<std::mutex> scoped_lock(m_file_mutex);
+    // The lines from before the file is opened are kept until it is.
+    if (m_fileout == nullptr || m_writer.joinable())
+        return;
+    m_writer_stop = false;
+    m_async = true;
+    m_writer = std::thread(&BCLog::Logger::WriterThread, this);
+}
+
+void BCLog::Logger::StopAsyncWriter()
+{
+    if (!m_writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_buffer_mutex);
+        m_writer_stop = true;
     }
+    m_buffer_cond.notify_all();
+    m_writer.join();
 }
 
 void BCLog::Logger::ShrinkDebugFile()
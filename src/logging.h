@@ -10,15 +10,18 @@
 #include <tinyformat.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+static const bool DEFAULT_LOGASYNC      = true;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fLogIPs;
@@ -55,6 +58,7 @@ namespace BCLog {
         LEVELDB     = (1 << 20),
         FIRESTONE   = (1 << 21),
         RELATION    = (1 << 22),
+        FORGE       = (1 << 23),
         ALL         = ~(uint32_t)0,
     };
 
@@ -75,7 +79,18 @@ namespace BCLog {
         /** Log categories bitfield. */
         std::atomic<uint32_t> m_categories{0};
 
+        /** Lines waiting for the writer thread, while it runs. */
+        std::mutex m_buffer_mutex;
+        std::condition_variable m_buffer_cond;
+        std::string m_buffer;
+        std::atomic<bool> m_async{false};
+        bool m_writer_stop = false;
+        std::thread m_writer;
+
         std::string LogTimestampStr(const std::string& str);
+        /** Write to the file, reopening it if requested. Called with m_file_mutex held. */
+        void WriteToFile(const std::string& str);
+        void WriterThread();
 
     public:
         bool m_print_to_console = false;
@@ -96,6 +111,11 @@ namespace BCLog {
         bool OpenDebugLog();
         void ShrinkDebugFile();
 
+        /** Write the debug log from a background thread, so logging only appends to a buffer. */
+        void StartAsyncWriter();
+        /** Write out the buffered lines and stop the writer thread, later lines are written directly. */
+        void StopAsyncWriter();
+
         uint32_t GetCategoryMask() const { return m_categories.load(); }
 
         void EnableCategory(LogFlags flag);
@@ -146,12 +166,13 @@ static inline void LogPrintf(const char* fmt, const Args&... args)
     }
 }
 
-template <typename... Args>
-static inline void LogPrint(const BCLog::LogFlags& category, const Args&... args)
-{
-    if (LogAcceptCategory((category))) {
-        LogPrintf(args...);
-    }
-}
+// Use a macro instead of a function for conditional logging to prevent
+// evaluating arguments when logging for the category is not enabled.
+#define LogPrint(category, ...)              \
+    do {                                     \
+        if (LogAcceptCategory((category))) { \
+            LogPrintf(__VA_ARGS__);          \
+        }                                    \
+    } while (0)
 
 #endif // BITCOIN_LOGGING_H
@@ -0,0 +1,158 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooljournal.h>
+
+#include <clientversion.h>
+#include <logging.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <cstdio>
+
+static const uint64_t MEMPOOL_JOURNAL_VERSION = 1;
+
+std::unique_ptr<CMempoolJournal> g_mempool_journal;
+
+fs::path GetMempoolJournalPath()
+{
+    return GetDataDir() / "mempool.journal";
+}
+
+CMempoolJournal::CMempoolJournal(const fs::path& pathIn) : path(pathIn), nFileSize(0), fCompacting(false), nCompactionMark(0)
+{
+    boost::system::error_code ec;
+    const uint64_t size = fs::file_size(path, ec);
+    if (!ec) {
+        nFileSize = size;
+    }
+}
+
+void CMempoolJournal::Connect(CTxMemPool& pool)
+{
+    connAdded = pool.NotifyEntryAdded.connect(std::bind(&CMempoolJournal::TransactionAdded, this, std::placeholders::_1));
+    connRemoved = pool.NotifyEntryRemoved.connect(std::bind(&CMempoolJournal::TransactionRemoved, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void CMempoolJournal::TransactionAdded(const CTransactionRef& tx)
+{
+    LOCK(cs_buffer);
+    CVectorWriter(SER_DISK, CLIENT_VERSION, vBuffer, vBuffer.size(), (uint8_t)ADD, tx, GetTime());
+}
+
+void CMempoolJournal::TransactionRemoved(const CTransactionRef& tx, MemPoolRemovalReason reason)
+{
+    LOCK(cs_buffer);
+    CVectorWriter(SER_DISK, CLIENT_VERSION, vBuffer, vBuffer.size(), (uint8_t)REMOVE, tx->GetHash());
+}
+
+bool CMempoolJournal::Flush()
+{
+    LOCK(cs_file);
+    std::vector<unsigned char> vData;
+    {
+        LOCK(cs_buffer);
+        if (fCompacting || vBuffer.empty())
+            return true;
+        vData.swap(vBuffer);
+    }
+
+    // A file left empty by a crash is started over too.
+    CAutoFile file(fsbridge::fopen(path, nFileSize == 0 ? "wb" : "ab"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("%s: Failed to open %s\n", __func__, path.string());
+        return false;
+    }
+    try {
+        if (nFileSize == 0) {
+            file << MEMPOOL_JOURNAL_VERSION;
+            nFileSize = sizeof(MEMPOOL_JOURNAL_VERSION);
+        }
+        file.write((const char*)vData.data(), vData.size());
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+    } catch (const std::exception& e) {
+        LogPrintf("%s: Failed to write mempool journal: %s\n", __func__, e.what());
+        return false;
+    }
+    nFileSize += vData.size();
+    return true;
+}
+
+uint64_t CMempoolJournal::Size() const
+{
+    LOCK(cs_file);
+    return nFileSize;
+}
+
+void CMempoolJournal::BeginCompaction()
+{
+    LOCK(cs_buffer);
+    fCompacting = true;
+    nCompactionMark = vBuffer.size();
+}
+
+void CMempoolJournal::EndCompaction(bool fDumped)
+{
+    LOCK(cs_file);
+    {
+        LOCK(cs_buffer);
+        if (!fCompacting)
+            return;
+        fCompacting = false;
+        if (fDumped) {
+            vBuffer.erase(vBuffer.begin(), vBuffer.begin() + nCompactionMark);
+        }
+    }
+    if (fDumped) {
+        // Flush starts the file over.
+        boost::system::error_code ec;
+        fs::remove(path, ec);
+        nFileSize = 0;
+    }
+    Flush();
+}
+
+bool ReadMempoolJournal(const fs::path& path, const std::function<void(CMempoolJournal::RecordType type, const CTransactionRef& tx, const uint256& txid, int64_t nTime)>& fn)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return false;
+
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_JOURNAL_VERSION)
+            return false;
+    } catch (const std::exception& e) {
+        return false;
+    }
+
+    try {
+        while (true) {
+            uint8_t type;
+            file >> type;
+            if (type == CMempoolJournal::ADD) {
+                CTransactionRef tx;
+                int64_t nTime;
+                file >> tx >> nTime;
+                fn(CMempoolJournal::ADD, tx, tx->GetHash(), nTime);
+            } else if (type == CMempoolJournal::REMOVE) {
+                uint256 txid;
+                file >> txid;
+                fn(CMempoolJournal::REMOVE, nullptr, txid, 0);
+            } else {
+                throw std::ios_base::failure("unknown record type");
+            }
+        }
+    } catch (const std::exception& e) {
+        // The end of the file, or a record a crash cut short.
+        if (!std::feof(file.Get())) {
+            LogPrintf("%s: Stopped reading mempool journal: %s\n", __func__, e.what());
+        }
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_MEMPOOLJOURNAL_H
+#define LAVA_MEMPOOLJOURNAL_H
+
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/signals2/connection.hpp>
+
+class CTxMemPool;
+enum class MemPoolRemovalReason;
+
+/** Default for -mempooljournal */
+static const bool DEFAULT_MEMPOOL_JOURNAL = true;
+/** How often the changes of the mempool are written to the journal, in seconds. */
+static const int64_t MEMPOOL_JOURNAL_FLUSH_INTERVAL = 5;
+/** Size of the journal past which it is folded into mempool.dat. */
+static const uint64_t MAX_MEMPOOL_JOURNAL_SIZE = 64 * 1024 * 1024;
+
+/**
+ * A journal of the transactions added to and removed from the mempool since mempool.dat
+ * was last written, so a node that crashes finds its mempool again on restart. The changes
+ * are buffered in memory and appended to the file every MEMPOOL_JOURNAL_FLUSH_INTERVAL.
+ * DumpMempool compacts the journal: the changes it wrote to mempool.dat are dropped and the
+ * file starts over.
+ */
+class CMempoolJournal
+{
+public:
+    enum RecordType : uint8_t {
+        ADD = 1,    //!< followed by the transaction and the time it was added
+        REMOVE = 2, //!< followed by the txid
+    };
+
+    explicit CMempoolJournal(const fs::path& pathIn);
+
+    /** Start recording the changes of pool. */
+    void Connect(CTxMemPool& pool);
+
+    /** Append the buffered changes to the file. Returns false if they could not be written. */
+    bool Flush();
+
+    /** The size of the file, in bytes. */
+    uint64_t Size() const;
+
+    /** Mark the changes buffered so far as part of the mempool being dumped. Called with the snapshot taken. */
+    void BeginCompaction();
+
+    /** Once the dump is written (fDumped), start the file over with the changes made since its snapshot. */
+    void EndCompaction(bool fDumped);
+
+private:
+    void TransactionAdded(const CTransactionRef& tx);
+    void TransactionRemoved(const CTransactionRef& tx, MemPoolRemovalReason reason);
+
+    const fs::path path;
+
+    //! Serializes the writers of the file
+    mutable CCriticalSection cs_file;
+    uint64_t nFileSize GUARDED_BY(cs_file);
+
+    //! Guards the buffer, which the mempool appends to with its own lock held
+    mutable CCriticalSection cs_buffer;
+    std::vector<unsigned char> vBuffer GUARDED_BY(cs_buffer);
+    //! While compacting, the end of the changes that are part of the dump; nothing is written meanwhile
+    bool fCompacting GUARDED_BY(cs_buffer);
+    size_t nCompactionMark GUARDED_BY(cs_buffer);
+
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+};
+
+/**
+ * Read the journal at path, passing each record to fn: the transaction and its time for
+ * an ADD, the txid for a REMOVE. A damaged tail, as a crash may leave, ends the reading.
+ * Returns false if the file is missing or not a journal.
+ */
+bool ReadMempoolJournal(const fs::path& path, const std::function<void(CMempoolJournal::RecordType type, const CTransactionRef& tx, const uint256& txid, int64_t nTime)>& fn);
+
+/** The path of the mempool journal in the data directory. */
+fs::path GetMempoolJournalPath();
+
+extern std::unique_ptr<CMempoolJournal> g_mempool_journal;
+
+#endif // LAVA_MEMPOOLJOURNAL_H
@@ -6,6 +6,8 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <prevector.h>
+#include <support/allocators/pool.h>
 
 #include <stdlib.h>
 
@@ -165,6 +167,15 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template<typename X, typename Y, typename Z, typename P, std::size_t MAX_BLOCK_SIZE, std::size_t ALIGN>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, P, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE, ALIGN> >& m)
+{
+    // The nodes, and a bucket array small enough, are in the chunks of the pool.
+    const auto& resource = *m.get_allocator().resource();
+    const size_t bucket_bytes = sizeof(void*) * m.bucket_count();
+    return MallocUsage(resource.ChunkSizeBytes()) * resource.NumAllocatedChunks() + (bucket_bytes > MAX_BLOCK_SIZE ? MallocUsage(bucket_bytes) : 0);
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
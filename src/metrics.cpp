@@ -0,0 +1,208 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <metrics.h>
+
+#include <tinyformat.h>
+
+#include <algorithm>
+
+/** The bucket bounds reported to Prometheus, in microseconds; finer buckets are summed into them. */
+static const uint64_t PROMETHEUS_BOUNDS[] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+};
+
+CMetricHistogram::CMetricHistogram(const std::string& nameIn, const std::string& helpIn) :
+    name(nameIn), help(helpIn), count(0), sum(0), max(0)
+{
+    for (std::atomic<uint64_t>& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+int CMetricHistogram::BucketIndex(uint64_t value)
+{
+    if (value < (uint64_t)SUB_BUCKETS)
+        return (int)value;
+    int exponent = 63;
+    while (!(value >> exponent))
+        exponent--;
+    const int sub = (int)((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t CMetricHistogram::BucketUpperBound(int index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+    const int shift = index / SUB_BUCKETS - 1;
+    const uint64_t lower = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void CMetricHistogram::Record(uint64_t value)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = max.load(std::memory_order_relaxed);
+    while (value > prev && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+}
+
+CMetricHistogram::Summary CMetricHistogram::GetSummary() const
+{
+    Summary summary;
+    summary.buckets.resize(BUCKETS);
+    summary.count = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        summary.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        summary.count += summary.buckets[i];
+    }
+    // The count is that of the buckets, which records may have updated meanwhile
+    summary.sum = sum.load(std::memory_order_relaxed);
+    summary.max = max.load(std::memory_order_relaxed);
+    return summary;
+}
+
+uint64_t CMetricHistogram::Summary::Percentile(double q) const
+{
+    if (count == 0)
+        return 0;
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(BucketUpperBound(i), max);
+    }
+    return max;
+}
+
+uint64_t CMetricHistogram::Summary::CountAtOrBelow(uint64_t bound) const
+{
+    uint64_t n = 0;
+    for (size_t i = 0; i < buckets.size() && BucketUpperBound(i) <= bound; i++)
+        n += buckets[i];
+    return n;
+}
+
+CMetricCounter& CMetricsRegistry::Counter(const std::string& name, const std::string& help)
+{
+    LOCK(cs);
+    std::unique_ptr<CMetricCounter>& counter = counters[name];
+    if (!counter)
+        counter.reset(new CMetricCounter(name, help));
+    return *counter;
+}
+
+CMetricHistogram& CMetricsRegistry::Histogram(const std::string& name, const std::string& help)
+{
+    LOCK(cs);
+    std::unique_ptr<CMetricHistogram>& histogram = histograms[name];
+    if (!histogram)
+        histogram.reset(new CMetricHistogram(name, help));
+    return *histogram;
+}
+
+std::vector<const CMetricCounter*> CMetricsRegistry::GetCounters() const
+{
+    LOCK(cs);
+    std::vector<const CMetricCounter*> result;
+    for (const auto& entry : counters)
+        result.push_back(entry.second.get());
+    return result;
+}
+
+std::vector<const CMetricHistogram*> CMetricsRegistry::GetHistograms() const
+{
+    LOCK(cs);
+    std::vector<const CMetricHistogram*> result;
+    for (const auto& entry : histograms)
+        result.push_back(entry.second.get());
+    return result;
+}
+
+std::string CMetricsRegistry::ToPrometheus() const
+{
+    std::string out;
+    for (const CMetricCounter* counter : GetCounters()) {
+        const std::string name = "lava_" + counter->name + "_total";
+        out += strprintf("# HELP %s %s\n# TYPE %s counter\n%s %u\n", name, counter->help, name, name, counter->Get());
+    }
+    for (const CMetricHistogram* histogram : GetHistograms()) {
+        const std::string name = "lava_" + histogram->name + "_seconds";
+        const CMetricHistogram::Summary summary = histogram->GetSummary();
+        out += strprintf("# HELP %s %s\n# TYPE %s histogram\n", name, histogram->help, name);
+        for (uint64_t bound : PROMETHEUS_BOUNDS) {
+            out += strprintf("%s_bucket{le=\"%g\"} %u\n", name, bound / 1e6, summary.CountAtOrBelow(bound));
+        }
+        out += strprintf("%s_bucket{le=\"+Inf\"} %u\n", name, summary.count);
+        out += strprintf("%s_sum %g\n%s_count %u\n", name, summary.sum / 1e6, name, summary.count);
+    }
+    return out;
+}
+
+std::atomic<bool> g_lock_profile(DEFAULT_LOCK_PROFILE);
+
+namespace {
+/** Guards the map of sites; a std::mutex, as a profiled Mutex would profile itself. */
+std::mutex cs_lock_profile;
+std::map<std::pair<std::string, int>, std::unique_ptr<LockProfileSite>>& LockProfileSites()
+{
+    // Never destroyed, as the metrics registry
+    static auto* sites = new std::map<std::pair<std::string, int>, std::unique_ptr<LockProfileSite>>();
+    return *sites;
+}
+
+LockProfileSite* GetLockProfileSite(const char* pszName, const char* pszFile, int nLine)
+{
+    std::lock_guard<std::mutex> lock(cs_lock_profile);
+    std::unique_ptr<LockProfileSite>& site = LockProfileSites()[std::make_pair(std::string(pszFile), nLine)];
+    if (!site)
+        site.reset(new LockProfileSite(pszName, pszFile, nLine));
+    return site.get();
+}
+} // namespace
+
+int64_t LockProfileClock()
+{
+    return GetTimeMicros();
+}
+
+LockProfileSite* LockProfileAcquired(const char* pszName, const char* pszFile, int nLine, int64_t nWaitStart, int64_t& nHoldStart)
+{
+    static thread_local unsigned int nAcquisitions = 0;
+    const bool fSample = ++nAcquisitions % LOCK_PROFILE_HOLD_SAMPLE == 0;
+    if (!nWaitStart && !fSample)
+        return nullptr;
+    const int64_t nNow = GetTimeMicros();
+    LockProfileSite* site = GetLockProfileSite(pszName, pszFile, nLine);
+    if (nWaitStart)
+        site->wait.Record(std::max<int64_t>(nNow - nWaitStart, 0));
+    if (!fSample)
+        return nullptr;
+    nHoldStart = nNow;
+    return site;
+}
+
+void LockProfileReleased(LockProfileSite* site, int64_t nHoldStart)
+{
+    site->hold.Record(std::max<int64_t>(GetTimeMicros() - nHoldStart, 0));
+}
+
+std::vector<const LockProfileSite*> GetLockProfileSites()
+{
+    std::lock_guard<std::mutex> lock(cs_lock_profile);
+    std::vector<const LockProfileSite*> result;
+    for (const auto& entry : LockProfileSites())
+        result.push_back(entry.second.get());
+    return result;
+}
+
+CMetricsRegistry& GetMetrics()
+{
+    // Never destroyed, threads may still record while the process exits
+    static CMetricsRegistry* registry = new CMetricsRegistry();
+    return *registry;
+}
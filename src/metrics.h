@@ -0,0 +1,136 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_METRICS_H
+#define LAVA_METRICS_H
+
+#include <sync.h>
+#include <util/time.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** A count of events, updated without locks. */
+class CMetricCounter
+{
+public:
+    const std::string name;
+    const std::string help;
+
+    CMetricCounter(const std::string& nameIn, const std::string& helpIn) : name(nameIn), help(helpIn), value(0) {}
+
+    void Add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+/**
+ * A histogram of durations in microseconds, updated without locks. The buckets are
+ * log-linear, as in HDR histograms: every power of two is split in SUB_BUCKETS buckets,
+ * so a value is known to within 1/SUB_BUCKETS of itself.
+ */
+class CMetricHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    /** A copy of the histogram, consistent enough to report. */
+    struct Summary {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        std::vector<uint64_t> buckets;
+
+        /** The upper bound of the bucket the fraction q of the values are at or below. */
+        uint64_t Percentile(double q) const;
+        /** The count of the values at or below bound, as far as the buckets tell. */
+        uint64_t CountAtOrBelow(uint64_t bound) const;
+    };
+
+    const std::string name;
+    const std::string help;
+
+    CMetricHistogram(const std::string& nameIn, const std::string& helpIn);
+
+    void Record(uint64_t value);
+    Summary GetSummary() const;
+
+    static int BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(int index);
+
+private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[BUCKETS];
+};
+
+/** Records the time from its construction to its destruction in a histogram. */
+class CMetricTimer
+{
+public:
+    explicit CMetricTimer(CMetricHistogram& histogramIn) : histogram(histogramIn), nStart(GetTimeMicros()) {}
+    ~CMetricTimer() { histogram.Record(GetTimeMicros() - nStart); }
+
+private:
+    CMetricHistogram& histogram;
+    const int64_t nStart;
+};
+
+/**
+ * The metrics of the node, by name. Metrics are registered once, usually into a static
+ * reference at their call site, and are never removed, so references to them stay valid.
+ */
+class CMetricsRegistry
+{
+public:
+    CMetricCounter& Counter(const std::string& name, const std::string& help);
+    CMetricHistogram& Histogram(const std::string& name, const std::string& help);
+
+    std::vector<const CMetricCounter*> GetCounters() const;
+    std::vector<const CMetricHistogram*> GetHistograms() const;
+
+    /** The metrics in the Prometheus text exposition format, durations in seconds. */
+    std::string ToPrometheus() const;
+
+private:
+    mutable Mutex cs;
+    std::map<std::string, std::unique_ptr<CMetricCounter>> counters GUARDED_BY(cs);
+    std::map<std::string, std::unique_ptr<CMetricHistogram>> histograms GUARDED_BY(cs);
+};
+
+CMetricsRegistry& GetMetrics();
+
+/** One in this many acquisitions of a lock site has its hold time recorded by -lockprofile. */
+static const unsigned int LOCK_PROFILE_HOLD_SAMPLE = 16;
+
+/**
+ * The contention of the LOCK statements at one source line, recorded with -lockprofile.
+ * Every acquisition that had to wait records its wait; the hold time is sampled, and runs
+ * until the end of the scope of the lock, including time spent waiting on a condition.
+ */
+struct LockProfileSite
+{
+    const std::string name;
+    const std::string file;
+    const int line;
+    CMetricHistogram wait;
+    CMetricHistogram hold;
+
+    LockProfileSite(const std::string& nameIn, const std::string& fileIn, int lineIn) :
+        name(nameIn), file(fileIn), line(lineIn), wait(name, "Wait to acquire"), hold(name, "Time held, sampled") {}
+};
+
+/** The sites recorded so far; like metrics, they are never removed. */
+std::vector<const LockProfileSite*> GetLockProfileSites();
+
+#endif // LAVA_METRICS_H
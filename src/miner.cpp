@@ -21,6 +21,7 @@
 #include <pow.h>
 #include <primitives/transaction.h>
 #include <script/standard.h>
+#include <ticket.h>
 #include <timedata.h>
 #include <util/moneystr.h>
 #include <util/system.h>
@@ -83,12 +84,15 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    fBlockFull = false;
+    packageFeeRateFloor = CFeeRate(MAX_MONEY);
 }
 
 Optional<int64_t> BlockAssembler::m_last_block_num_txs{nullopt};
 Optional<int64_t> BlockAssembler::m_last_block_weight{nullopt};
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, const uint64_t nonce, const CKeyID& nPublicKeyID, const uint64_t plotID, const uint64_t deadline, const CTransactionRef& tx)
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, const uint64_t nonce, const CKeyID& nPublicKeyID, const uint64_t plotID, const uint64_t deadline, const CTransactionRef& tx, const int64_t nMinTime, const bool fTestValidity)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -128,7 +132,21 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    const bool fCandidates = g_block_candidates && addCandidateTxs(pindexPrev->GetBlockHash());
+    if (!fCandidates) {
+        const size_t nFirstTx = pblock->vtx.size();
+        if (fClusterMempool) {
+            addClusterTxs(nPackagesSelected);
+        } else {
+            addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+        }
+        if (g_block_candidates) {
+            const std::vector<CTransactionRef> vtx(pblock->vtx.begin() + nFirstTx, pblock->vtx.end());
+            const std::vector<int64_t> vTxSigOpsCost(pblocktemplate->vTxSigOpsCost.end() - vtx.size(), pblocktemplate->vTxSigOpsCost.end());
+            g_block_candidates->Set(pindexPrev->GetBlockHash(), nHeight, nLockTimeCutoff, nBlockMaxWeight, blockMinFeeRate,
+                                    vtx, vTxSigOpsCost, nBlockWeight, nBlockSigOpsCost, fBlockFull, packageFeeRateFloor);
+        }
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -159,6 +177,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     // Fill in header
     pblock->hashPrevBlock = pindexPrev->GetBlockHash();
     UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
+    pblock->nTime = std::max<int64_t>(pblock->nTime, nMinTime);
     if (nHeight >= chainparams.GetConsensus().LVIP05Height){
         pblock->genSign = CalcGenerationSignature(pindexPrev->genSign, pindexPrev->nPublicKeyID);
     }else{
@@ -175,12 +194,18 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
 
     CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+    if (fTestValidity && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        if (g_block_candidates)
+            g_block_candidates->Clear();
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    if (fCandidates) {
+        LogPrint(BCLog::BENCH, "CreateNewBlock() kept candidates: %.2fms, validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    } else {
+        LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    }
 
     return std::move(pblocktemplate);
 }
@@ -310,6 +335,8 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
     // Keep track of entries that failed inclusion, to avoid duplicate work
     CTxMemPool::setEntries failedTx;
 
+    addTicketPackages(nPackagesSelected);
+
     // Start by adding all descendants of previously added txs to mapModifiedTx
     // and modifying them for their already included ancestors
     UpdatePackagesForAdded(inBlock, mapModifiedTx);
@@ -376,6 +403,7 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fBlockFull = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -425,12 +453,264 @@ void BlockAssembler::addPackageTxs(int& nPackagesSelected, int& nDescendantsUpda
         }
 
         ++nPackagesSelected;
+        packageFeeRateFloor = std::min(packageFeeRateFloor, CFeeRate(packageFees, packageSize));
 
         // Update transactions that depend on each of these
         nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
 }
 
+void BlockAssembler::addClusterTxs(int& nPackagesSelected)
+{
+    addTicketPackages(nPackagesSelected);
+
+    // Chunks with a parent left out of the block are left out too
+    CTxMemPool::setEntries failedTx;
+
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+
+    for (const CTxMemPool::Chunk& chunk : mempool.GetChunks()) {
+        if (chunk.nFee < blockMinFeeRate.GetFee(chunk.nSize)) {
+            // Everything else we might consider has a lower fee rate
+            return;
+        }
+
+        // The firestone purchases may have taken part of the chunk already
+        CTxMemPool::setEntries package(chunk.txs.begin(), chunk.txs.end());
+        onlyUnconfirmed(package);
+        if (package.empty())
+            continue;
+
+        uint64_t packageSize = 0;
+        CAmount packageFees = 0;
+        int64_t packageSigOpsCost = 0;
+        bool fFailedParent = false;
+        for (CTxMemPool::txiter it : package) {
+            packageSize += it->GetTxSize();
+            packageFees += it->GetModifiedFee();
+            packageSigOpsCost += it->GetSigOpCost();
+            for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+                fFailedParent |= failedTx.count(parent) > 0;
+            }
+        }
+        if (fFailedParent) {
+            failedTx.insert(package.begin(), package.end());
+            continue;
+        }
+
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fBlockFull = true;
+            failedTx.insert(package.begin(), package.end());
+
+            ++nConsecutiveFailed;
+
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockWeight >
+                                                                     nBlockMaxWeight - 4000) {
+                // Give up if we're close to full and haven't succeeded in a while
+                break;
+            }
+            continue;
+        }
+
+        if (!TestPackageTransactions(package)) {
+            failedTx.insert(package.begin(), package.end());
+            continue;
+        }
+
+        nConsecutiveFailed = 0;
+
+        for (CTxMemPool::txiter it : chunk.txs) {
+            if (package.count(it))
+                AddToBlock(it);
+        }
+
+        ++nPackagesSelected;
+        packageFeeRateFloor = std::min(packageFeeRateFloor, CFeeRate(packageFees, packageSize));
+    }
+}
+
+void BlockAssembler::addTicketPackages(int& nPackagesSelected)
+{
+    if (!pticketview)
+        return;
+    std::vector<CTxMemPool::txiter> tickets = mempool.GetTicketTxs(pticketview->LockTime(nHeight / pticketview->SlotLength()));
+    std::sort(tickets.begin(), tickets.end(), [](CTxMemPool::txiter a, CTxMemPool::txiter b) {
+        return CompareTxMemPoolEntryByAncestorFee()(*a, *b);
+    });
+
+    for (CTxMemPool::txiter iter : tickets) {
+        if (inBlock.count(iter))
+            continue;
+
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
+
+        // The ancestors shared with a purchase added before are in the block already.
+        uint64_t packageSize = 0;
+        CAmount packageFees = 0;
+        int64_t packageSigOpsCost = 0;
+        for (CTxMemPool::txiter it : ancestors) {
+            packageSize += it->GetTxSize();
+            packageFees += it->GetModifiedFee();
+            packageSigOpsCost += it->GetSigOpCost();
+        }
+        if (packageFees < blockMinFeeRate.GetFee(packageSize))
+            continue;
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fBlockFull = true;
+            continue;
+        }
+        if (!TestPackageTransactions(ancestors))
+            continue;
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+        for (CTxMemPool::txiter it : sortedEntries) {
+            AddToBlock(it);
+        }
+        ++nPackagesSelected;
+        packageFeeRateFloor = std::min(packageFeeRateFloor, CFeeRate(packageFees, packageSize));
+    }
+}
+
+bool BlockAssembler::addCandidateTxs(const uint256& hashTip)
+{
+    std::vector<CTransactionRef> vtx;
+    if (!g_block_candidates->Get(hashTip, nBlockMaxWeight, blockMinFeeRate, vtx))
+        return false;
+
+    // The mempool events reach the candidates late, check they are all still there, after their parents.
+    std::vector<CTxMemPool::txiter> entries;
+    entries.reserve(vtx.size());
+    CTxMemPool::setEntries selected;
+    for (const CTransactionRef& tx : vtx) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end())
+            return false;
+        for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+            if (!selected.count(parent))
+                return false;
+        }
+        selected.insert(it);
+        entries.push_back(it);
+    }
+    for (CTxMemPool::txiter it : entries) {
+        AddToBlock(it);
+    }
+    return true;
+}
+
+std::unique_ptr<CBlockCandidates> g_block_candidates;
+
+bool CBlockCandidates::Get(const uint256& hashTipIn, size_t nBlockMaxWeightIn, const CFeeRate& blockMinFeeRateIn, std::vector<CTransactionRef>& vtx) const
+{
+    LOCK(cs);
+    if (fStale || hashTip.IsNull() || hashTip != hashTipIn || nBlockMaxWeight != nBlockMaxWeightIn || blockMinFeeRate != blockMinFeeRateIn)
+        return false;
+    vtx.clear();
+    vtx.reserve(lSelected.size());
+    for (const Candidate& candidate : lSelected) {
+        vtx.push_back(candidate.tx);
+    }
+    return true;
+}
+
+void CBlockCandidates::Set(const uint256& hashTipIn, int nHeightIn, int64_t nLockTimeCutoffIn, size_t nBlockMaxWeightIn, const CFeeRate& blockMinFeeRateIn,
+                           const std::vector<CTransactionRef>& vtx, const std::vector<int64_t>& vTxSigOpsCost, uint64_t nWeightIn, int64_t nSigOpsCostIn, bool fFullIn, const CFeeRate& feeRateFloorIn)
+{
+    LOCK(cs);
+    hashTip = hashTipIn;
+    nHeight = nHeightIn;
+    nLockTimeCutoff = nLockTimeCutoffIn;
+    nBlockMaxWeight = nBlockMaxWeightIn;
+    blockMinFeeRate = blockMinFeeRateIn;
+    lSelected.clear();
+    mapSelected.clear();
+    for (size_t i = 0; i < vtx.size(); i++) {
+        lSelected.push_back({vtx[i], GetTransactionWeight(*vtx[i]), vTxSigOpsCost[i]});
+        mapSelected.emplace(vtx[i]->GetHash(), std::prev(lSelected.end()));
+    }
+    nWeight = nWeightIn;
+    nSigOpsCost = nSigOpsCostIn;
+    fFull = fFullIn;
+    feeRateFloor = feeRateFloorIn;
+    fStale = false;
+}
+
+void CBlockCandidates::Clear()
+{
+    LOCK(cs);
+    hashTip.SetNull();
+    lSelected.clear();
+    mapSelected.clear();
+}
+
+void CBlockCandidates::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    LOCK(cs);
+    // The selection may already have been made for the new tip.
+    if (hashTip != pindexNew->GetBlockHash())
+        Clear();
+}
+
+void CBlockCandidates::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    LOCK2(mempool.cs, cs);
+    if (hashTip.IsNull() || fStale || mapSelected.count(ptx->GetHash()))
+        return;
+    CTxMemPool::txiter it = mempool.mapTx.find(ptx->GetHash());
+    if (it == mempool.mapTx.end())
+        return;
+
+    for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+        if (!mapSelected.count(parent->GetTx().GetHash())) {
+            // Its package was left out, only a new selection can tell whether it pays for it now.
+            const CFeeRate packageFeeRate(it->GetModFeesWithAncestors(), it->GetSizeWithAncestors());
+            if (packageFeeRate >= blockMinFeeRate && (!fFull || packageFeeRate > feeRateFloor))
+                fStale = true;
+            return;
+        }
+    }
+
+    const CFeeRate feeRate(it->GetModifiedFee(), it->GetTxSize());
+    if (feeRate < blockMinFeeRate || !IsFinalTx(*ptx, nHeight, nLockTimeCutoff))
+        return;
+    // The same limits as BlockAssembler::TestPackage.
+    if (nWeight + WITNESS_SCALE_FACTOR * it->GetTxSize() >= nBlockMaxWeight ||
+        nSigOpsCost + it->GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST) {
+        if (feeRate > feeRateFloor)
+            fStale = true;
+        fFull = true;
+        return;
+    }
+
+    lSelected.push_back({ptx, static_cast<int64_t>(it->GetTxWeight()), it->GetSigOpCost()});
+    mapSelected.emplace(ptx->GetHash(), std::prev(lSelected.end()));
+    nWeight += it->GetTxWeight();
+    nSigOpsCost += it->GetSigOpCost();
+}
+
+void CBlockCandidates::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    LOCK(cs);
+    auto it = mapSelected.find(ptx->GetHash());
+    if (it == mapSelected.end())
+        return;
+    nWeight -= it->second->nWeight;
+    nSigOpsCost -= it->second->nSigOpCost;
+    lSelected.erase(it->second);
+    mapSelected.erase(it);
+    // Its descendants leave the mempool with it. The room it leaves in a full block is
+    // better filled by a new selection.
+    if (fFull)
+        fStale = true;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, uint64_t nExtraNonce)
 {
     // Update nExtraNonce
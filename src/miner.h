@@ -10,10 +10,13 @@
 #include <primitives/block.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <key.h>
 
+#include <list>
 #include <memory>
 #include <stdint.h>
+#include <unordered_map>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -142,6 +145,10 @@ private:
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    // Whether a package was left out for lack of room
+    bool fBlockFull;
+    // The lowest feerate of the packages in the block
+    CFeeRate packageFeeRateFloor;
 
     // Chain context for the block
     int nHeight;
@@ -158,8 +165,9 @@ public:
     explicit BlockAssembler(const CChainParams& params);
     BlockAssembler(const CChainParams& params, const Options& options);
 
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
-    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, const uint64_t nonce, const CKeyID& nPublicKeyID, const uint64_t plotID, const uint64_t deadline, const CTransactionRef& tx);
+    /** Construct a new block template with coinbase to scriptPubKeyIn, timed no earlier than nMinTime.
+      * Without fTestValidity the template is not connected first, for callers that submit it right away. */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, const uint64_t nonce, const CKeyID& nPublicKeyID, const uint64_t plotID, const uint64_t deadline, const CTransactionRef& tx, const int64_t nMinTime = 0, const bool fTestValidity = true);
 
     static Optional<int64_t> m_last_block_num_txs;
     static Optional<int64_t> m_last_block_weight;
@@ -175,7 +183,16 @@ private:
     /** Add transactions based on feerate including unconfirmed ancestors
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
       * statistics from the package selection (for logging statistics). */
-    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+    /** Add transactions by the chunks of the linearized mempool clusters, best feerate first,
+      * the order in which cluster mode also evicts them, last first. */
+    void addClusterTxs(int &nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+    /** Add the firestone purchases of the slot of the block with their unconfirmed ancestors, ahead of
+      * the other transactions: they buy no firestone once the slot is over. */
+    void addTicketPackages(int &nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(cs_main, mempool.cs);
+    /** Add the transactions kept by g_block_candidates for this tip, if they are current
+      * and still valid in the mempool. Returns false, having added none, otherwise. */
+    bool addCandidateTxs(const uint256& hashTip) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
@@ -198,6 +215,63 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
+/**
+ * The transactions of the next block, kept up to date with the mempool events so that
+ * CreateNewBlock does not need to select them from the whole mempool every time. A
+ * transaction entering the mempool is appended when its parents are selected already
+ * and it fits, one leaving it is dropped. The selection is made again from the whole
+ * mempool after the tip changes, or when the events left it worse than a new one: a
+ * transaction paying more than the selected ones did not fit, or a full block lost one.
+ */
+class CBlockCandidates : public CValidationInterface
+{
+public:
+    /** The selected transactions in block order, if the selection for this tip and these limits is current. */
+    bool Get(const uint256& hashTip, size_t nBlockMaxWeight, const CFeeRate& blockMinFeeRate, std::vector<CTransactionRef>& vtx) const;
+
+    /**
+     * Replace the selection with one BlockAssembler made from the whole mempool. nWeight and
+     * nSigOpsCost are the totals of the block, including what is reserved for the coinbase.
+     */
+    void Set(const uint256& hashTip, int nHeight, int64_t nLockTimeCutoff, size_t nBlockMaxWeight, const CFeeRate& blockMinFeeRate,
+             const std::vector<CTransactionRef>& vtx, const std::vector<int64_t>& vTxSigOpsCost, uint64_t nWeight, int64_t nSigOpsCost, bool fFull, const CFeeRate& feeRateFloor);
+
+    /** Forget the selection, so that the next one is made from the whole mempool. */
+    void Clear();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx) override;
+
+private:
+    struct Candidate {
+        CTransactionRef tx;
+        int64_t nWeight;
+        int64_t nSigOpCost;
+    };
+
+    mutable CCriticalSection cs;
+    //! The tip the selection was made for, null if there is none.
+    uint256 hashTip GUARDED_BY(cs);
+    int nHeight GUARDED_BY(cs);
+    int64_t nLockTimeCutoff GUARDED_BY(cs);
+    size_t nBlockMaxWeight GUARDED_BY(cs);
+    CFeeRate blockMinFeeRate GUARDED_BY(cs);
+    std::list<Candidate> lSelected GUARDED_BY(cs);
+    std::unordered_map<uint256, std::list<Candidate>::iterator, SaltedTxidHasher> mapSelected GUARDED_BY(cs);
+    uint64_t nWeight GUARDED_BY(cs);
+    int64_t nSigOpsCost GUARDED_BY(cs);
+    //! Whether a transaction was left out for lack of room.
+    bool fFull GUARDED_BY(cs);
+    //! The lowest feerate of the packages selected from the whole mempool.
+    CFeeRate feeRateFloor GUARDED_BY(cs);
+    //! Whether a selection from the whole mempool would be better.
+    bool fStale GUARDED_BY(cs);
+};
+
+extern std::unique_ptr<CBlockCandidates> g_block_candidates;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, uint64_t nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
@@ -17,9 +17,11 @@
 #include <crypto/sha256.h>
 #include <primitives/transaction.h>
 #include <netbase.h>
+#include <netcompress.h>
 #include <scheduler.h>
 #include <ui_interface.h>
 #include <util/strencodings.h>
+#include <util/trace.h>
 
 #ifdef WIN32
 #include <string.h>
@@ -31,6 +33,10 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -45,6 +51,12 @@
 // Dump addresses to peers.dat every 15 minutes (900s)
 static constexpr int DUMP_PEERS_INTERVAL = 15 * 60;
 
+// Append the changes of the address manager to peers.journal every 10 seconds
+static constexpr int PEERS_JOURNAL_FLUSH_INTERVAL = 10;
+
+// Write peers.dat before its interval once peers.journal grows past 4 MiB
+static constexpr uint64_t MAX_PEERS_JOURNAL_SIZE = 4 << 20;
+
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
@@ -70,6 +82,11 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+// Most ready sockets handled per loop, the others stay ready for the next one
+static const int MAX_EPOLL_EVENTS = 1024;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -605,6 +622,13 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+char* CNode::GetRecvBuffer(unsigned int& nBytes)
+{
+    if (vRecvMsg.empty() || !vRecvMsg.back().in_data || vRecvMsg.back().complete())
+        return nullptr;
+    return vRecvMsg.back().PrepareData(nBytes);
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -665,21 +689,31 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 
 int CNetMessage::readData(const char *pch, unsigned int nBytes)
 {
-    unsigned int nRemaining = hdr.nMessageSize - nDataPos;
-    unsigned int nCopy = std::min(nRemaining, nBytes);
-
-    if (vRecv.size() < nDataPos + nCopy) {
-        // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
-    }
+    unsigned int nCopy = nBytes;
+    char* dest = PrepareData(nCopy);
 
     hasher.Write((const unsigned char*)pch, nCopy);
-    memcpy(&vRecv[nDataPos], pch, nCopy);
+    // Data received in place is already there.
+    if (pch != dest)
+        memcpy(dest, pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+char* CNetMessage::PrepareData(unsigned int& nBytes)
+{
+    nBytes = std::min(hdr.nMessageSize - nDataPos, nBytes);
+
+    if (vRecv.size() < nDataPos + nBytes) {
+        // Allocate up to 256 KiB ahead, or double what was allocated so a large message is
+        // moved a few times rather than every 256 KiB, but never more than the total message size.
+        vRecv.resize(std::min<size_t>(hdr.nMessageSize, std::max<size_t>(nDataPos + nBytes + 256 * 1024, 2 * vRecv.size())));
+    }
+
+    return &vRecv[nDataPos];
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -688,32 +722,109 @@ const uint256& CNetMessage::GetMessageHash() const
     return data_hash;
 }
 
+SendPriority GetSendPriority(const std::string& command)
+{
+    if (command == NetMsgType::BLOCK || command == NetMsgType::CMPCTBLOCK || command == NetMsgType::BLOCKTXN)
+        return SEND_PRIORITY_BLOCK;
+    if (command == NetMsgType::TX || command == NetMsgType::INV || command == NetMsgType::NOTFOUND ||
+        command == NetMsgType::MERKLEBLOCK || command == NetMsgType::SKETCH || command == NetMsgType::RECONCILDIFF)
+        return SEND_PRIORITY_TX;
+    if (command == NetMsgType::ADDR)
+        return SEND_PRIORITY_ADDR;
+    return SEND_PRIORITY_HEADERS;
+}
+
+void CSendQueue::push_back(SendPriority priority, std::vector<unsigned char>&& header, std::vector<unsigned char>&& data)
+{
+    queues[priority].push_back(Msg{std::move(header), std::move(data)});
+    nBytes[priority] += queues[priority].back().Size();
+}
+
+int CSendQueue::FrontQueue() const
+{
+    if (nCurrent >= 0)
+        return nCurrent;
+    for (int i = 0; i < NUM_SEND_PRIORITIES; i++) {
+        if (!queues[i].empty())
+            return i;
+    }
+    return -1;
+}
+
+const CSendQueue::Msg* CSendQueue::Front() const
+{
+    const int i = FrontQueue();
+    return i >= 0 ? &queues[i].front() : nullptr;
+}
+
+bool CSendQueue::Advance(size_t nBytesSent)
+{
+    const int i = FrontQueue();
+    assert(i >= 0);
+    const size_t nSize = queues[i].front().Size();
+    nOffset += nBytesSent;
+    assert(nOffset <= nSize);
+    if (nOffset < nSize) {
+        nCurrent = i;
+        return false;
+    }
+    nBytes[i] -= nSize;
+    queues[i].pop_front();
+    nCurrent = -1;
+    nOffset = 0;
+    return true;
+}
+
+bool CSendQueue::empty() const
+{
+    return FrontQueue() < 0;
+}
+
+size_t CSendQueue::size() const
+{
+    size_t n = 0;
+    for (const auto& queue : queues) {
+        n += queue.size();
+    }
+    return n;
+}
+
+void CSendQueue::clear()
+{
+    for (int i = 0; i < NUM_SEND_PRIORITIES; i++) {
+        queues[i].clear();
+        nBytes[i] = 0;
+    }
+    nCurrent = -1;
+    nOffset = 0;
+}
+
 size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend)
 {
-    auto it = pnode->vSendMsg.begin();
     size_t nSentSize = 0;
 
-    while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+    while (const CSendQueue::Msg* msg = pnode->vSendMsg.Front()) {
+        // Send what is left of the header, then of the payload.
+        const size_t nOffset = pnode->vSendMsg.Offset();
+        const bool fHeader = nOffset < msg->header.size();
+        const std::vector<unsigned char>& data = fHeader ? msg->header : msg->data;
+        const size_t nDataOffset = fHeader ? nOffset : nOffset - msg->header.size();
+        const size_t nSize = msg->Size();
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + nDataOffset, data.size() - nDataOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
-                pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+            if (pnode->vSendMsg.Advance(nBytes)) {
+                pnode->nSendSize -= nSize;
                 pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
-                it++;
-            } else {
+            } else if (nDataOffset + nBytes < data.size()) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -732,11 +843,9 @@ size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pno
         }
     }
 
-    if (it == pnode->vSendMsg.end()) {
-        assert(pnode->nSendOffset == 0);
+    if (pnode->vSendMsg.empty()) {
         assert(pnode->nSendSize == 0);
     }
-    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     return nSentSize;
 }
 
@@ -1129,7 +1238,96 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
     return !recv_set.empty() || !send_set.empty() || !error_set.empty();
 }
 
-#ifdef USE_POLL
+#ifdef USE_EPOLL
+void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+{
+    if (epoll_fd < 0) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            LogPrintf("epoll_create1 failed: %s\n", NetworkErrorString(errno));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+            return;
+        }
+    }
+
+    // The sockets stay registered between loops, only a change of what one waits for is passed
+    // to the kernel. A socket is registered again if its number now belongs to another node, as
+    // closing the old one removed it. Readiness is level-triggered: a loop reads at most one buffer
+    // per socket and stops reading from paused peers, so an edge could be lost.
+    nEpollGeneration++;
+    auto update = [this](SOCKET socket, NodeId owner, uint32_t events) {
+        auto it = mapEpollSockets.find(socket);
+        if (it != mapEpollSockets.end() && it->second.owner == owner) {
+            it->second.generation = nEpollGeneration;
+            if (it->second.events == events)
+                return;
+            it->second.events = events;
+            struct epoll_event event = {};
+            event.events = events;
+            event.data.fd = socket;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, socket, &event) < 0)
+                LogPrint(BCLog::NET, "epoll_ctl modify failed: %s\n", NetworkErrorString(errno));
+            return;
+        }
+        struct epoll_event event = {};
+        event.events = events;
+        event.data.fd = socket;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket, &event) < 0 &&
+                (errno != EEXIST || epoll_ctl(epoll_fd, EPOLL_CTL_MOD, socket, &event) < 0)) {
+            LogPrint(BCLog::NET, "epoll_ctl add failed: %s\n", NetworkErrorString(errno));
+            return;
+        }
+        mapEpollSockets[socket] = EpollRegistration{owner, events, nEpollGeneration};
+    };
+
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        update(hListenSocket.socket, -1, EPOLLIN);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            // Same logic as GenerateSelectSet: drain the send buffer first, then receive if there is room.
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            // Errors and hang-ups are always reported.
+            const uint32_t events = select_send ? static_cast<uint32_t>(EPOLLOUT) : (select_recv ? static_cast<uint32_t>(EPOLLIN) : 0);
+            update(pnode->hSocket, pnode->GetId(), events);
+        }
+    }
+
+    // The sockets not seen are closed, which removed them from epoll.
+    for (auto it = mapEpollSockets.begin(); it != mapEpollSockets.end();) {
+        if (it->second.generation != nEpollGeneration)
+            it = mapEpollSockets.erase(it);
+        else
+            ++it;
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, SELECT_TIMEOUT_MILLISECONDS);
+    if (nEvents < 0) return;
+
+    if (interruptNet) return;
+
+    for (int i = 0; i < nEvents; i++) {
+        const SOCKET socket = events[i].data.fd;
+        if (events[i].events & EPOLLIN)               recv_set.insert(socket);
+        if (events[i].events & EPOLLOUT)              send_set.insert(socket);
+        if (events[i].events & (EPOLLERR|EPOLLHUP))   error_set.insert(socket);
+    }
+}
+#elif defined(USE_POLL)
 void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
     std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
@@ -1298,17 +1496,24 @@ void CConnman::SocketHandler()
         {
             // typical socket buffer is 8K-64K
             char pchBuf[0x10000];
+            // The data of a message goes straight into it, only the headers go through pchBuf.
+            unsigned int nRecvSize = sizeof(pchBuf);
+            char* pchRecv = pnode->GetRecvBuffer(nRecvSize);
+            if (pchRecv == nullptr) {
+                pchRecv = pchBuf;
+                nRecvSize = sizeof(pchBuf);
+            }
             int nBytes = 0;
             {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                nBytes = recv(pnode->hSocket, pchRecv, nRecvSize, MSG_DONTWAIT);
             }
             if (nBytes > 0)
             {
                 bool notify = false;
-                if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+                if (!pnode->ReceiveMsgBytes(pchRecv, nBytes, notify))
                     pnode->CloseSocketDisconnect();
                 RecordBytesRecv(nBytes);
                 if (notify) {
@@ -1384,9 +1589,9 @@ void CConnman::WakeMessageHandler()
 {
     {
         std::lock_guard<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = true;
+        nMsgProcWake++;
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
 }
 
 
@@ -1599,15 +1804,36 @@ void CConnman::ThreadDNSAddressSeed()
 
 void CConnman::DumpAddresses()
 {
+    LOCK(cs_addr_db);
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
+    std::vector<unsigned char> records;
+    if (adb.WriteSnapshot(addrman, records)) {
+        adb.ResetJournal();
+    } else {
+        // The journal still goes with the peers.dat left in place.
+        adb.AppendJournal(records);
+    }
 
     LogPrint(BCLog::NET, "Flushed %d addresses to peers.dat  %dms\n",
            addrman.size(), GetTimeMillis() - nStart);
 }
 
+void CConnman::FlushAddressJournal()
+{
+    uint64_t nJournalSize;
+    {
+        LOCK(cs_addr_db);
+        CAddrDB adb;
+        adb.AppendJournal(addrman.TakeJournal());
+        nJournalSize = adb.JournalSize();
+    }
+    if (nJournalSize > MAX_PEERS_JOURNAL_SIZE) {
+        DumpAddresses();
+    }
+}
+
 void CConnman::ProcessOneShot()
 {
     std::string strDest;
@@ -1944,15 +2170,22 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     }
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int nWorker)
 {
+    uint64_t nWake;
+    {
+        LOCK(mutexMsgProc);
+        nWake = nMsgProcWake;
+    }
     while (!flagInterruptMsgProc)
     {
         std::vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy) {
+            for (CNode* pnode : vNodes) {
+                if (pnode->GetId() % nMsgHandlerThreads != nWorker)
+                    continue;
+                vNodesCopy.push_back(pnode);
                 pnode->AddRef();
             }
         }
@@ -1987,9 +2220,9 @@ void CConnman::ThreadMessageHandler()
 
         WAIT_LOCK(mutexMsgProc, lock);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
+            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this, nWake] { return nMsgProcWake != nWake; });
         }
-        fMsgProcWake = false;
+        nWake = nMsgProcWake;
     }
 }
 
@@ -2211,13 +2444,23 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     int64_t nStart = GetTimeMillis();
     {
         CAddrDB adb;
-        if (adb.Read(addrman))
+        const bool fLoaded = adb.Read(addrman);
+        if (fLoaded) {
             LogPrintf("Loaded %i addresses from peers.dat  %dms\n", addrman.size(), GetTimeMillis() - nStart);
-        else {
+            if (m_use_addr_journal) {
+                const size_t nRecords = adb.ReadJournal(addrman);
+                if (nRecords > 0)
+                    LogPrintf("Replayed %u changes from peers.journal\n", nRecords);
+            }
+        } else {
             addrman.Clear(); // Addrman can be in an inconsistent state after failure, reset it
             LogPrintf("Invalid or missing peers.dat; recreating\n");
-            DumpAddresses();
         }
+        // Start the journal over from a peers.dat holding the replayed changes.
+        if (!fLoaded || adb.JournalSize() > 0)
+            DumpAddresses();
+        if (m_use_addr_journal)
+            addrman.EnableJournal();
     }
 
     uiInterface.InitMessage(_("Starting network threads..."));
@@ -2243,7 +2486,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     {
         LOCK(mutexMsgProc);
-        fMsgProcWake = false;
+        nMsgProcWake = 0;
     }
 
     // Send and receive from sockets, accept connections
@@ -2269,10 +2512,14 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMsgHandlerThreads; i++) {
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, i)));
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000);
+    if (m_use_addr_journal)
+        scheduler.scheduleEvery(std::bind(&CConnman::FlushAddressJournal, this), PEERS_JOURNAL_FLUSH_INTERVAL * 1000);
 
     return true;
 }
@@ -2318,8 +2565,11 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (auto& thread : threadMessageHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageHandlers.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2353,6 +2603,13 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    mapEpollSockets.clear();
+#endif
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -2691,9 +2948,19 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
+    // Ranked by the command it wraps if compressed below.
+    const SendPriority priority = GetSendPriority(msg.command);
+    if (pnode->fCompress && msg.data.size() >= MIN_COMPRESS_SIZE && IsCompressibleCommand(msg.command)) {
+        std::vector<unsigned char> payload;
+        if (CompressMessage(msg.command, Span<const unsigned char>(msg.data.data(), msg.data.size()), payload)) {
+            msg.command = NetMsgType::COMPRESSED;
+            msg.data = std::move(payload);
+        }
+    }
     size_t nMessageSize = msg.data.size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
+    TRACE3(net, outbound_message, pnode->GetId(), msg.command.c_str(), nMessageSize);
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
@@ -2706,6 +2973,11 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
+        // Address gossip is best effort, don't let it pile up behind a busy link.
+        if (priority == SEND_PRIORITY_ADDR && pnode->vSendMsg.Bytes(priority) + nTotalSize > MAX_ADDR_SEND_QUEUE_SIZE) {
+            LogPrint(BCLog::NET, "dropping %s (%d bytes) peer=%d\n", SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
+            return;
+        }
         bool optimisticSend(pnode->vSendMsg.empty());
 
         //log total amount of bytes per command
@@ -2714,9 +2986,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.push_back(priority, std::move(serializedHeader), std::move(msg.data));
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
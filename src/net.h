@@ -29,6 +29,7 @@
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <unordered_map>
 
 #ifndef WIN32
 #include <arpa/inet.h>
@@ -81,10 +82,18 @@ static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
+/** -msghandlers default, the threads processing the messages of the peers */
+static const int DEFAULT_MSG_HANDLER_THREADS = 1;
+/** Maximum number of message handler threads */
+static const int MAX_MSG_HANDLER_THREADS = 16;
+/** -peersjournal default, journaling the changes of the address manager between the writes of peers.dat */
+static const bool DEFAULT_PEERS_JOURNAL = true;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Most bytes of addr messages queued for a peer, further ones are dropped. */
+static const size_t MAX_ADDR_SEND_QUEUE_SIZE = 100 * 1000;
 
 typedef int64_t NodeId;
 
@@ -141,10 +150,12 @@ public:
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        int nMsgHandlerThreads = DEFAULT_MSG_HANDLER_THREADS;
         std::vector<std::string> vSeedNodes;
         std::vector<CSubNet> vWhitelistedRange;
         std::vector<CService> vBinds, vWhiteBinds;
         bool m_use_addrman_outgoing = true;
+        bool m_use_addr_journal = DEFAULT_PEERS_JOURNAL;
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
     };
@@ -154,6 +165,7 @@ public:
         nMaxConnections = connOptions.nMaxConnections;
         nMaxOutbound = std::min(connOptions.nMaxOutbound, connOptions.nMaxConnections);
         m_use_addrman_outgoing = connOptions.m_use_addrman_outgoing;
+        m_use_addr_journal = connOptions.m_use_addr_journal;
         nMaxAddnode = connOptions.nMaxAddnode;
         nMaxFeeler = connOptions.nMaxFeeler;
         nBestHeight = connOptions.nBestHeight;
@@ -163,6 +175,7 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = connOptions.m_peer_connect_timeout;
+        nMsgHandlerThreads = std::max(1, std::min(connOptions.nMsgHandlerThreads, MAX_MSG_HANDLER_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -331,7 +344,7 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(int nWorker);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
@@ -359,6 +372,7 @@ private:
 
     size_t SocketSendData(CNode *pnode) const;
     void DumpAddresses();
+    void FlushAddressJournal();
 
     // Network stats
     void RecordBytesRecv(uint64_t bytes);
@@ -413,6 +427,9 @@ private:
     int nMaxAddnode;
     int nMaxFeeler;
     bool m_use_addrman_outgoing;
+    bool m_use_addr_journal;
+    //! Orders the writes of peers.dat and its journal
+    CCriticalSection cs_addr_db;
     std::atomic<int> nBestHeight;
     CClientUIInterface* clientInterface;
     NetEventsInterface* m_msgproc;
@@ -421,8 +438,13 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
+    /**
+     * Bumped to wake the message processors, each of which remembers the last value it saw.
+     * Peers are spread over nMsgHandlerThreads processors by id, so the messages of a peer
+     * are handled in order and its state is only touched by one of them.
+     */
+    uint64_t nMsgProcWake GUARDED_BY(mutexMsgProc);
+    int nMsgHandlerThreads;
 
     std::condition_variable condMsgProc;
     Mutex mutexMsgProc;
@@ -430,11 +452,24 @@ private:
 
     CThreadInterrupt interruptNet;
 
+#ifdef USE_EPOLL
+    /** What a socket registered with epoll belongs to and waits for. */
+    struct EpollRegistration {
+        NodeId owner;           //!< -1 for the listening sockets
+        uint32_t events;
+        uint64_t generation;    //!< last SocketEvents that saw the socket
+    };
+    //! Only used by ThreadSocketHandler
+    int epoll_fd = -1;
+    std::unordered_map<SOCKET, EpollRegistration> mapEpollSockets;
+    uint64_t nEpollGeneration = 0;
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -576,6 +611,59 @@ public:
 
 
 
+/** Priority classes of the messages sent to a peer, the highest first. */
+enum SendPriority : int {
+    SEND_PRIORITY_BLOCK = 0,    //!< blocks, compact blocks and their transactions
+    SEND_PRIORITY_HEADERS,      //!< headers and the other control messages
+    SEND_PRIORITY_TX,           //!< transactions and inventory
+    SEND_PRIORITY_ADDR,         //!< address gossip
+    NUM_SEND_PRIORITIES
+};
+
+/** The priority class of a message command. */
+SendPriority GetSendPriority(const std::string& command);
+
+/**
+ * The messages queued for a peer, in one queue per priority class. The next message
+ * is taken from the highest class that has one, but a message that started going out
+ * is always finished first, so messages never interleave on the wire.
+ */
+class CSendQueue
+{
+public:
+    struct Msg
+    {
+        std::vector<unsigned char> header;
+        std::vector<unsigned char> data;
+
+        size_t Size() const { return header.size() + data.size(); }
+    };
+
+    void push_back(SendPriority priority, std::vector<unsigned char>&& header, std::vector<unsigned char>&& data);
+
+    /** The message going out, or the next one, or nullptr if the queues are empty. */
+    const Msg* Front() const;
+    /** How much of the front message is sent already. */
+    size_t Offset() const { return nOffset; }
+    /** Record that nBytes more of the front message were sent. Returns whether it is complete, and then drops it. */
+    bool Advance(size_t nBytes);
+
+    bool empty() const;
+    /** Number of queued messages. */
+    size_t size() const;
+    void clear();
+    /** Bytes queued in a priority class. */
+    size_t Bytes(SendPriority priority) const { return nBytes[priority]; }
+
+private:
+    std::deque<Msg> queues[NUM_SEND_PRIORITIES];
+    size_t nBytes[NUM_SEND_PRIORITIES] = {};
+    //! The class of the message going out, or -1 if none started.
+    int nCurrent{-1};
+    size_t nOffset{0};
+
+    int FrontQueue() const;
+};
 
 class CNetMessage {
 private:
@@ -618,6 +706,12 @@ public:
 
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
+
+    /**
+     * Make room for the next data of the message and return where it goes, so it can be
+     * received in place. nBytes is lowered to what is left of the message.
+     */
+    char* PrepareData(unsigned int& nBytes);
 };
 
 
@@ -630,9 +724,8 @@ public:
     std::atomic<ServiceFlags> nServices{NODE_NONE};
     SOCKET hSocket GUARDED_BY(cs_hSocket);
     size_t nSendSize{0}; // total size of all vSendMsg entries
-    size_t nSendOffset{0}; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    CSendQueue vSendMsg GUARDED_BY(cs_vSend);
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -688,6 +781,8 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
+    //! Both ends advertise NODE_COMPRESS, block and transaction messages are sent compressed
+    std::atomic_bool fCompress{false};
 
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -697,9 +792,10 @@ public:
     uint256 hashContinue;
     std::atomic<int> nStartingHeight{-1};
 
-    // flood relay
-    std::vector<CAddress> vAddrToSend;
-    CRollingBloomFilter addrKnown;
+    // flood relay, the addresses are also pushed by the message handlers of other peers
+    CCriticalSection cs_vAddrToSend;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(cs_vAddrToSend);
+    CRollingBloomFilter addrKnown GUARDED_BY(cs_vAddrToSend);
     bool fGetAddr{false};
     std::set<uint256> setKnown;
     int64_t nNextAddrSend GUARDED_BY(cs_sendProcessing){0};
@@ -791,6 +887,13 @@ public:
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
 
+    /**
+     * Where up to nBytes of the message being received may be received in place, skipping
+     * the copy by ReceiveMsgBytes. nullptr between messages, as a header comes next.
+     * Used only by SocketHandler thread.
+     */
+    char* GetRecvBuffer(unsigned int& nBytes);
+
     void SetRecvVersion(int nVersionIn)
     {
         nRecvVersion = nVersionIn;
@@ -821,11 +924,13 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_vAddrToSend);
         addrKnown.insert(_addr.GetKey());
     }
 
     void PushAddress(const CAddress& _addr, FastRandomContext &insecure_rand)
     {
+        LOCK(cs_vAddrToSend);
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
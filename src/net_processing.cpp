@@ -8,14 +8,22 @@
 #include <addrman.h>
 #include <banman.h>
 #include <arith_uint256.h>
+#include <assember.h>
+#include <blockcache.h>
 #include <blockencodings.h>
+#include <blockserver.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <forgetrace.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <validation.h>
 #include <merkleblock.h>
+#include <metrics.h>
 #include <netmessagemaker.h>
 #include <netbase.h>
+#include <netcompress.h>
+#include <poc.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
@@ -24,11 +32,14 @@
 #include <reverse_iterator.h>
 #include <scheduler.h>
 #include <tinyformat.h>
+#include <txdb.h>
 #include <txmempool.h>
+#include <txreconciliation.h>
 #include <ui_interface.h>
 #include <util/system.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
+#include <util/trace.h>
 
 #include <memory>
 
@@ -64,6 +75,12 @@ static constexpr int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 /// Age after which a block is considered historical for purposes of rate
 /// limiting block relay. Set to one week, denominated in seconds.
 static constexpr int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
+/** Most proofs of capacity of unsolicited headers and blocks a peer may make us verify at once */
+static constexpr int MAX_POC_BUDGET = 16;
+/** Seconds for one proof of capacity to be added back to the budget of a peer */
+static constexpr int64_t POC_BUDGET_INTERVAL = 15;
+/** Seconds after a getheaders during which the headers of the peer count as solicited */
+static constexpr int64_t HEADERS_RESPONSE_TIME = 2 * 60;
 
 struct COrphanTx {
     // When modifying, adapt the copy of this definition in tests/DoS_tests.
@@ -94,6 +111,24 @@ static constexpr unsigned int INVENTORY_BROADCAST_MAX = 7 * INVENTORY_BROADCAST_
 static constexpr unsigned int AVG_FEEFILTER_BROADCAST_INTERVAL = 10 * 60;
 /** Maximum feefilter broadcast delay after significant change. */
 static constexpr unsigned int MAX_FEEFILTER_CHANGE_DELAY = 5 * 60;
+/** Number of peers we ask to announce new blocks with cmpctblock, as per BIP152. */
+static constexpr size_t MAX_HB_PEERS = 3;
+/** Number of block announcement delays kept per peer to rank it as a high-bandwidth peer. */
+static constexpr size_t BLOCK_ANNOUNCE_SAMPLES = 32;
+/** Number of announcement delays after which a peer is ranked by them rather than by its ping. */
+static constexpr size_t MIN_BLOCK_ANNOUNCE_SAMPLES = 4;
+/** How much better (in microseconds) a peer must rank to take the place of a high-bandwidth peer. */
+static constexpr int64_t HB_SWITCH_MARGIN = 50 * 1000;
+/** Interval in seconds between the high-bandwidth trials given to the best other peer. */
+static constexpr int64_t HB_PROBE_INTERVAL = 10 * 60;
+/** Interval in seconds between the removals of stale header-only side branches from the block index. */
+static constexpr int64_t STALE_HEADERS_PRUNE_INTERVAL = 60 * 60;
+/** Number of recent new blocks whose first announcement time is kept. */
+static constexpr size_t MAX_BLOCK_FIRST_SEEN = 16;
+/** Most bytes of serialized transactions and blocks kept to answer getdata, shared by all peers. */
+static constexpr size_t MAX_SERIALIZED_CACHE_BYTES = 64 * 1024 * 1024;
+/** Number of the blocks a peer asked for next that are read ahead of the one served. */
+static constexpr size_t BLOCK_SERVE_READ_AHEAD = 4;
 
 // Internal stuff
 namespace {
@@ -142,6 +177,10 @@ namespace {
     /** Stack of nodes which we have set to announce using compact blocks */
     std::list<NodeId> lNodesAnnouncingHeaderAndIDs GUARDED_BY(cs_main);
 
+    /** When the recent new blocks were first announced to us by any peer, in microseconds. */
+    std::map<uint256, int64_t> mapBlockFirstSeen GUARDED_BY(cs_main);
+    std::deque<uint256> qBlockFirstSeen GUARDED_BY(cs_main);
+
     /** Number of preferable block download peers. */
     int nPreferredDownload GUARDED_BY(cs_main) = 0;
 
@@ -160,6 +199,71 @@ namespace {
     /** Expiration-time ordered list of (expire time, relay map entry) pairs. */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration GUARDED_BY(cs_main);
 
+    /**
+     * The serialized bytes of the transactions and blocks sent last, with and without witness,
+     * so one requested by many peers is serialized once. Transactions are keyed by wtxid when
+     * serialized with witness, so a malleated witness is not served for another. The entries
+     * added first are dropped first once MAX_SERIALIZED_CACHE_BYTES is exceeded.
+     */
+    class CSerializedCache
+    {
+    public:
+        typedef std::shared_ptr<const std::vector<unsigned char>> Bytes;
+
+        Bytes Get(const CTransaction& tx, bool fWitness)
+        {
+            return Get(fWitness ? tx.GetWitnessHash() : tx.GetHash(), fWitness, tx);
+        }
+
+        Bytes Get(const CBlock& block, bool fWitness)
+        {
+            return Get(block.GetHash(), fWitness, block);
+        }
+
+    private:
+        typedef std::pair<uint256, bool> Key;
+
+        template <typename T>
+        Bytes Get(const uint256& hash, bool fWitness, const T& obj)
+        {
+            static CMetricCounter& hits = GetMetrics().Counter("net_serialized_cache_hits", "Transactions and blocks sent to peers from the serialized cache");
+            static CMetricCounter& misses = GetMetrics().Counter("net_serialized_cache_misses", "Transactions and blocks serialized to be sent to peers");
+            const Key key(hash, fWitness);
+            {
+                LOCK(cs);
+                auto it = entries.find(key);
+                if (it != entries.end()) {
+                    hits.Add();
+                    return it->second;
+                }
+            }
+            misses.Add();
+            // Serialized outside the lock, a peer asking at the same time may do it twice.
+            auto bytes = std::make_shared<std::vector<unsigned char>>();
+            CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | (fWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS), *bytes, 0, obj);
+            if (bytes->size() > MAX_SERIALIZED_CACHE_BYTES / 4)
+                return bytes;
+            LOCK(cs);
+            if (!entries.emplace(key, bytes).second)
+                return bytes;
+            order.push_back(key);
+            nBytes += bytes->size();
+            while (nBytes > MAX_SERIALIZED_CACHE_BYTES) {
+                auto it = entries.find(order.front());
+                nBytes -= it->second->size();
+                entries.erase(it);
+                order.pop_front();
+            }
+            return bytes;
+        }
+
+        Mutex cs;
+        std::map<Key, Bytes> entries GUARDED_BY(cs);
+        std::deque<Key> order GUARDED_BY(cs);
+        size_t nBytes GUARDED_BY(cs) = 0;
+    };
+    CSerializedCache serializedCache;
+
     std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
 
     struct IteratorComparator
@@ -214,6 +318,12 @@ struct CNodeState {
     const CBlockIndex *pindexBestHeaderSent;
     //! Length of current-streak of unconnecting headers announcements
     int nUnconnectingHeaders;
+    //! Proofs of capacity of unsolicited headers and blocks we may still verify for this peer.
+    double nPoCBudget;
+    //! When nPoCBudget was last refilled.
+    int64_t nPoCBudgetTime;
+    //! When we last sent this peer a getheaders.
+    int64_t nLastGetHeadersTime;
     //! Whether we've started headers synchronization with this peer.
     bool fSyncStarted;
     //! When to potentially disconnect peer for stalling headers download
@@ -225,6 +335,15 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Number and total size of the requested blocks this peer delivered.
+    uint64_t nBlocksDownloaded;
+    uint64_t nBlockBytesDownloaded;
+    //! Moving average of the time this peer took to deliver a requested block (in microseconds), or 0.
+    int64_t nBlockTimeAvg;
+    //! When this peer last delivered a requested block (in microseconds).
+    int64_t nLastBlockReceived;
+    //! How many blocks we keep in flight from this peer, see RecordBlockDownload.
+    int nBlockWindow;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -277,6 +396,16 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! How long after the first peer this peer announced the recent new blocks, in microseconds.
+    std::deque<int64_t> m_announce_delays;
+    //! The last block whose announcement delay was recorded, so it is recorded once.
+    uint256 m_last_announce_timed;
+
+    //! The salt we sent in "sendrecon", or 0 if we did not offer reconciliation.
+    uint64_t m_recon_salt;
+    //! The reconciliation of transaction announcements, once both sides offered it.
+    std::unique_ptr<TxReconciliationState> m_recon;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -286,18 +415,27 @@ struct CNodeState {
         pindexLastCommonBlock = nullptr;
         pindexBestHeaderSent = nullptr;
         nUnconnectingHeaders = 0;
+        nPoCBudget = MAX_POC_BUDGET;
+        nPoCBudgetTime = GetTime();
+        nLastGetHeadersTime = 0;
         fSyncStarted = false;
         nHeadersSyncTimeout = 0;
         nStallingSince = 0;
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlocksDownloaded = 0;
+        nBlockBytesDownloaded = 0;
+        nBlockTimeAvg = 0;
+        nLastBlockReceived = 0;
+        nBlockWindow = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
         fProvidesHeaderAndIDs = false;
         fHaveWitness = false;
         fWantsCmpctWitness = false;
+        m_recon_salt = 0;
         fSupportsDesiredCmpctVersion = false;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
@@ -370,6 +508,41 @@ static bool MarkBlockAsReceived(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs
     return false;
 }
 
+/** Announce transactions the peer misses after a reconciliation with an inv at its next trickle. */
+static void AnnounceReconciled(CNode* pnode, TxReconciliationState& recon, const std::vector<uint256>& vTxid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    LOCK(pnode->cs_inventory);
+    for (const uint256& txid : vTxid) {
+        recon.setAnnounce.insert(txid);
+        pnode->setInventoryTxToSend.insert(txid);
+    }
+}
+
+/**
+ * Record the delivery of a block requested from nodeid, and size the download window of the peer
+ * after it: enough blocks to keep the peer busy during one round trip, as measured by nPingUsec,
+ * on top of MAX_BLOCKS_IN_TRANSIT_PER_PEER.
+ */
+static void RecordBlockDownload(NodeId nodeid, const uint256& hash, size_t nBytes, int64_t nPingUsec) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+
+    // Blocks are delivered in order, so the block took from when it or the block before it arrived.
+    const int64_t nNow = GetTimeMicros();
+    const int64_t nTime = std::max<int64_t>(nNow - std::max(state->nLastBlockReceived, state->nDownloadingSince), 1);
+    state->nBlockTimeAvg = state->nBlockTimeAvg == 0 ? nTime : (state->nBlockTimeAvg * 7 + nTime) / 8;
+    state->nLastBlockReceived = nNow;
+    state->nBlocksDownloaded++;
+    state->nBlockBytesDownloaded += nBytes;
+
+    state->nBlockWindow = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    if (nPingUsec > 0 && nPingUsec < std::numeric_limits<int64_t>::max()) {
+        state->nBlockWindow += std::min<int64_t>(nPingUsec / state->nBlockTimeAvg, MAX_BLOCKS_IN_TRANSIT_PER_PEER_FAST - MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    }
+}
+
 // returns false, still setting pit, if the block was already in flight from the same peer
 // pit will only be valid as long as the same cs_main lock is being held
 static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex* pindex = nullptr, std::list<QueuedBlock>::iterator** pit = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
@@ -441,50 +614,126 @@ static void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) EXCLUSIV
 }
 
 /**
- * When a peer sends us a valid block, instruct it to announce blocks to us
- * using CMPCTBLOCK if possible by adding its nodeid to the end of
- * lNodesAnnouncingHeaderAndIDs, and keeping that list under a certain size by
- * removing the first element if necessary.
+ * Record how long after the first announcement of a new block nodeid announced it. Only a
+ * block that was unknown so far, as told by fNew, starts the clock.
  */
-static void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman* connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+static void RecordBlockAnnouncement(NodeId nodeid, const uint256& hash, bool fNew) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (IsInitialBlockDownload())
+        return;
+    CNodeState* state = State(nodeid);
+    if (!state || state->m_last_announce_timed == hash)
+        return;
+    const int64_t nNow = GetTimeMicros();
+    auto it = mapBlockFirstSeen.find(hash);
+    if (it == mapBlockFirstSeen.end()) {
+        if (!fNew)
+            return;
+        it = mapBlockFirstSeen.emplace(hash, nNow).first;
+        qBlockFirstSeen.push_back(hash);
+        if (qBlockFirstSeen.size() > MAX_BLOCK_FIRST_SEEN) {
+            mapBlockFirstSeen.erase(qBlockFirstSeen.front());
+            qBlockFirstSeen.pop_front();
+        }
+    }
+    state->m_last_announce_timed = hash;
+    state->m_announce_delays.push_back(nNow - it->second);
+    if (state->m_announce_delays.size() > BLOCK_ANNOUNCE_SAMPLES)
+        state->m_announce_delays.pop_front();
+}
+
+/** A percentile of the block announcement delays of a peer, or -1 if it announced none. */
+static int64_t BlockAnnouncePercentile(const CNodeState& state, int percentile)
+{
+    if (state.m_announce_delays.empty())
+        return -1;
+    std::vector<int64_t> vDelays(state.m_announce_delays.begin(), state.m_announce_delays.end());
+    auto nth = vDelays.begin() + (vDelays.size() - 1) * percentile / 100;
+    std::nth_element(vDelays.begin(), nth, vDelays.end());
+    return *nth;
+}
+
+/** Ask a peer to announce new blocks with cmpctblock or to stop, as per BIP152. */
+static void SetPeerAnnouncingHeaderAndIDs(NodeId nodeid, bool fAnnounce, CConnman* connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    connman->ForNode(nodeid, [connman, fAnnounce](CNode* pnode){
+        AssertLockHeld(cs_main);
+        uint64_t nCMPCTBLOCKVersion = (pnode->GetLocalServices() & NODE_WITNESS) ? 2 : 1;
+        connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/fAnnounce, nCMPCTBLOCKVersion));
+        return true;
+    });
+}
+
+/**
+ * Choose the peers we ask to announce new blocks with cmpctblock (lNodesAnnouncingHeaderAndIDs)
+ * by how soon they announced the recent blocks: the median delay after the first announcement,
+ * plus half a ping for the block to reach us. Peers that announced too few blocks rank after
+ * the others, by ping. A peer takes the place of the worst one only if it ranks HB_SWITCH_MARGIN
+ * better, except in a probe, which gives the best other peer a trial, as peers announce sooner
+ * in high-bandwidth mode.
+ */
+static void UpdatePeersAnnouncingHeaderAndIDs(CConnman* connman, bool fProbe) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
-    CNodeState* nodestate = State(nodeid);
-    if (!nodestate || !nodestate->fSupportsDesiredCmpctVersion) {
+    struct Candidate {
+        NodeId id;
+        bool fMeasured;
+        int64_t nRank;
+    };
+    std::vector<Candidate> vCandidates;
+    connman->ForEachNode([&vCandidates](CNode* pnode) {
+        AssertLockHeld(cs_main);
+        CNodeState* state = State(pnode->GetId());
         // Never ask from peers who can't provide witnesses.
-        return;
+        if (!state || !state->fSupportsDesiredCmpctVersion || !state->fProvidesHeaderAndIDs)
+            return;
+        const int64_t nPing = pnode->nMinPingUsecTime;
+        const int64_t nHalfPing = nPing < std::numeric_limits<int64_t>::max() ? nPing / 2 : std::numeric_limits<int64_t>::max() / 2;
+        const bool fMeasured = state->m_announce_delays.size() >= MIN_BLOCK_ANNOUNCE_SAMPLES;
+        vCandidates.push_back({pnode->GetId(), fMeasured, (fMeasured ? BlockAnnouncePercentile(*state, 50) : 0) + nHalfPing});
+    });
+    auto fnBetter = [](const Candidate& a, const Candidate& b) {
+        return a.fMeasured != b.fMeasured ? a.fMeasured : a.nRank < b.nRank;
+    };
+    std::sort(vCandidates.begin(), vCandidates.end(), fnBetter);
+
+    // Forget the peers that went away.
+    std::map<NodeId, const Candidate*> mapCandidates;
+    for (const Candidate& candidate : vCandidates) {
+        mapCandidates.emplace(candidate.id, &candidate);
     }
-    if (nodestate->fProvidesHeaderAndIDs) {
-        for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
-            if (*it == nodeid) {
-                lNodesAnnouncingHeaderAndIDs.erase(it);
-                lNodesAnnouncingHeaderAndIDs.push_back(nodeid);
-                return;
-            }
+    lNodesAnnouncingHeaderAndIDs.remove_if([&mapCandidates](NodeId id) { return !mapCandidates.count(id); });
+
+    for (const Candidate& candidate : vCandidates) {
+        if (std::find(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(), candidate.id) != lNodesAnnouncingHeaderAndIDs.end())
+            continue;
+        if (lNodesAnnouncingHeaderAndIDs.size() < MAX_HB_PEERS) {
+            SetPeerAnnouncingHeaderAndIDs(candidate.id, true, connman);
+            lNodesAnnouncingHeaderAndIDs.push_back(candidate.id);
+            continue;
         }
-        connman->ForNode(nodeid, [connman](CNode* pfrom){
-            AssertLockHeld(cs_main);
-            uint64_t nCMPCTBLOCKVersion = (pfrom->GetLocalServices() & NODE_WITNESS) ? 2 : 1;
-            if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
-                // As per BIP152, we only get 3 of our peers to announce
-                // blocks using compact encodings.
-                connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){
-                    AssertLockHeld(cs_main);
-                    connman->PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/false, nCMPCTBLOCKVersion));
-                    return true;
-                });
-                lNodesAnnouncingHeaderAndIDs.pop_front();
-            }
-            connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/true, nCMPCTBLOCKVersion));
-            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
-            return true;
+        auto itWorst = std::max_element(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(), [&](NodeId a, NodeId b) {
+            return fnBetter(*mapCandidates[a], *mapCandidates[b]);
         });
+        const Candidate& worst = *mapCandidates[*itWorst];
+        const bool fBetter = !worst.fMeasured || candidate.nRank + HB_SWITCH_MARGIN < worst.nRank;
+        // The candidates are sorted, so none of the next ones would do better.
+        if (!candidate.fMeasured || (!fBetter && !fProbe))
+            break;
+        LogPrint(BCLog::NET, "high-bandwidth peer=%d replaces peer=%d%s\n", candidate.id, worst.id, fBetter ? "" : " for a trial");
+        SetPeerAnnouncingHeaderAndIDs(worst.id, false, connman);
+        SetPeerAnnouncingHeaderAndIDs(candidate.id, true, connman);
+        *itWorst = candidate.id;
+        fProbe = false;
     }
 }
 
 static bool TipMayBeStale(const Consensus::Params &consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
+    // The tip of a headers only node never moves.
+    if (fHeadersOnly)
+        return false;
     if (g_last_tip_update == 0) {
         g_last_tip_update = GetTime();
     }
@@ -507,8 +756,9 @@ static bool PeerHasHeader(CNodeState *state, const CBlockIndex *pindex) EXCLUSIV
 }
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
-static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+ *  at most count entries. When the window is blocked by nodeStaller, ppindexStalled is set to the
+ *  block we are waiting for. */
+static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams, const CBlockIndex** ppindexStalled = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (count == 0)
         return;
@@ -545,6 +795,7 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* pindexWaitingFor = nullptr;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -580,6 +831,8 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        if (ppindexStalled)
+                            *ppindexStalled = pindexWaitingFor;
                     }
                     return;
                 }
@@ -590,6 +843,7 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
@@ -672,6 +926,13 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksDownloaded = state->nBlocksDownloaded;
+    stats.nBlockBytesDownloaded = state->nBlockBytesDownloaded;
+    stats.nBlockTimeAvg = state->nBlockTimeAvg;
+    stats.nBlockWindow = state->nBlockWindow;
+    stats.fHighBandwidth = std::find(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(), nodeid) != lNodesAnnouncingHeaderAndIDs.end();
+    stats.nBlockAnnounceP50 = BlockAnnouncePercentile(*state, 50);
+    stats.nBlockAnnounceP90 = BlockAnnouncePercentile(*state, 90);
     return true;
 }
 
@@ -847,10 +1108,26 @@ void Misbehaving(NodeId pnode, int howmuch, const std::string& message) EXCLUSIV
 // active chain if they are no more than a month older (both in time, and in
 // best equivalent proof of work) than the best header chain we know about and
 // we fully-validated them at some point.
+/** Time at which a block may be accepted, once its deadline has elapsed since its parent. */
+static int64_t BlockAcceptTime(const CBlockIndex* pindex)
+{
+    return pindex->pprev->nTime + DeadlineWait(pindex->nDeadline, pindex->pprev->nBaseTarget, Params().GetConsensus());
+}
+
+/** A child of the tip we have the data of, whose deadline has not elapsed yet. */
+static bool IsPendingBlock(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    return pindex->pprev != nullptr && pindex->pprev == chainActive.Tip() && (pindex->nStatus & BLOCK_HAVE_DATA) &&
+        pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && BlockAcceptTime(pindex) > GetSystemTimeInSeconds();
+}
+
 static bool BlockRequestAllowed(const CBlockIndex* pindex, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
     if (chainActive.Contains(pindex)) return true;
+    // A child of the tip held until its deadline is relayed while it waits.
+    if (IsPendingBlock(pindex)) return true;
     return pindex->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != nullptr) &&
         (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() < STALE_RELAY_AGE_LIMIT) &&
         (GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) < STALE_RELAY_AGE_LIMIT);
@@ -868,6 +1145,36 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, BanMan* banman, CS
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
     scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::ProbeHighBandwidthPeers, this), HB_PROBE_INTERVAL * 1000);
+    const int nStaleHeadersDepth = gArgs.GetArg("-prunestaleheaders", DEFAULT_PRUNE_STALE_HEADERS);
+    if (nStaleHeadersDepth > 0) {
+        scheduler.scheduleEvery(std::bind(&PeerLogicValidation::PruneStaleHeaders, this, nStaleHeadersDepth), STALE_HEADERS_PRUNE_INTERVAL * 1000);
+    }
+}
+
+void PeerLogicValidation::ProbeHighBandwidthPeers()
+{
+    LOCK(cs_main);
+    UpdatePeersAnnouncingHeaderAndIDs(connman, true);
+}
+
+void PeerLogicValidation::PruneStaleHeaders(int nDepth)
+{
+    LOCK(cs_main);
+    // The entries the peers' state points to are kept, whatever branch they are on.
+    std::set<const CBlockIndex*> setKeep;
+    for (const auto& entry : mapNodeState) {
+        const CNodeState& state = entry.second;
+        setKeep.insert(state.pindexBestKnownBlock);
+        setKeep.insert(state.pindexLastCommonBlock);
+        setKeep.insert(state.pindexBestHeaderSent);
+        setKeep.insert(state.m_chain_sync.m_work_header);
+        for (const QueuedBlock& queued : state.vBlocksInFlight) {
+            setKeep.insert(queued.pindex);
+        }
+    }
+    setKeep.erase(nullptr);
+    ::PruneStaleHeaders(setKeep, nDepth, STALE_HEADERS_MIN_AGE);
 }
 
 /**
@@ -923,10 +1230,17 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
     LOCK(cs_main);
 
+    // Competing blocks at the same height are announced again if they may be accepted earlier,
+    // as the one accepted first wins.
     static int nHighestFastAnnounce = 0;
-    if (pindex->nHeight <= nHighestFastAnnounce)
+    static int64_t nFastAnnounceAcceptTime = 0;
+    const int64_t nAcceptTime = BlockAcceptTime(pindex);
+    if (pindex->nHeight < nHighestFastAnnounce ||
+        (pindex->nHeight == nHighestFastAnnounce && nAcceptTime >= nFastAnnounceAcceptTime))
         return;
     nHighestFastAnnounce = pindex->nHeight;
+    nFastAnnounceAcceptTime = nAcceptTime;
+    const bool fPending = IsPendingBlock(pindex);
 
     bool fWitnessEnabled = IsWitnessEnabled(pindex->pprev, Params().GetConsensus());
     uint256 hashBlock(pblock->GetHash());
@@ -939,25 +1253,41 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
+    bool fAnnounced = false;
+    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, fPending, &hashBlock, &fAnnounced](CNode* pnode) {
         AssertLockHeld(cs_main);
 
-        // TODO: Avoid the repeated-serialization here
-        if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
+        if (pnode->fDisconnect)
             return;
         ProcessBlockAvailability(pnode->GetId());
         CNodeState &state = *State(pnode->GetId());
         // If the peer has, or we announced to them the previous block already,
         // but we don't think they have this one, go ahead and announce it
-        if (state.fPreferHeaderAndIDs && (!fWitnessEnabled || state.fWantsCmpctWitness) &&
-                !PeerHasHeader(&state, pindex) && PeerHasHeader(&state, pindex->pprev)) {
-
+        if (PeerHasHeader(&state, pindex) || !PeerHasHeader(&state, pindex->pprev))
+            return;
+        // TODO: Avoid the repeated-serialization here
+        if (pnode->nVersion >= INVALID_CB_NO_BAN_VERSION && state.fPreferHeaderAndIDs && (!fWitnessEnabled || state.fWantsCmpctWitness)) {
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
             connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
             state.pindexBestHeaderSent = pindex;
+            fAnnounced = true;
+        } else if (fPending) {
+            // The other peers would only hear of a block waiting for its deadline once it is
+            // connected; announce it now so they can fetch it during the wait.
+            LogPrint(BCLog::NET, "%s announcing pending block %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
+                    hashBlock.ToString(), pnode->GetId());
+            if (state.fPreferHeaders) {
+                connman->PushMessage(pnode, msgMaker.Make(NetMsgType::HEADERS, std::vector<CBlock>{pindex->GetBlockHeader()}));
+                state.pindexBestHeaderSent = pindex;
+            } else {
+                pnode->PushInventory(CInv(MSG_BLOCK, hashBlock));
+            }
+            fAnnounced = true;
         }
     });
+    if (fAnnounced)
+        g_forge_trace.BlockAnnounced(hashBlock);
 }
 
 /**
@@ -1025,9 +1355,7 @@ void PeerLogicValidation::BlockChecked(const CBlock& block, const CValidationSta
     else if (state.IsValid() &&
              !IsInitialBlockDownload() &&
              mapBlocksInFlight.count(hash) == mapBlocksInFlight.size()) {
-        if (it != mapBlockSource.end()) {
-            MaybeSetPeerAsAnnouncingHeaderAndIDs(it->second.first, connman);
-        }
+        UpdatePeersAnnouncingHeaderAndIDs(connman, false);
     }
     if (it != mapBlockSource.end())
         mapBlockSource.erase(it);
@@ -1084,6 +1412,63 @@ static void RelayTransaction(const CTransaction& tx, CConnman* connman)
     });
 }
 
+void RelayPackage(const std::vector<CTransactionRef>& package, CConnman* connman, NodeId from)
+{
+    LOCK(cs_main);
+    connman->ForEachNode([&package, connman, from](CNode* pnode)
+    {
+        AssertLockHeld(cs_main);
+        if (pnode->GetId() == from)
+            return;
+        bool fPackage = pnode->nVersion >= PACKAGE_RELAY_VERSION;
+        {
+            LOCK(pnode->cs_filter);
+            fPackage = fPackage && pnode->fRelayTxes && !pnode->pfilter;
+        }
+        CNodeState* state = State(pnode->GetId());
+        if (fPackage && state) {
+            for (const CTransactionRef& tx : package) {
+                pnode->AddInventoryKnown(CInv(MSG_TX, tx->GetHash()));
+            }
+            const int nSendFlags = state->fHaveWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+            connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(nSendFlags, NetMsgType::PKGTXNS, package));
+        } else {
+            for (const CTransactionRef& tx : package) {
+                pnode->PushInventory(CInv(MSG_TX, tx->GetHash()));
+            }
+        }
+    });
+}
+
+/** The tip of the best deadline announcement relayed so far, and its deadline. */
+static uint256 hashAnnouncedPrev GUARDED_BY(cs_main);
+static uint64_t nAnnouncedDeadline GUARDED_BY(cs_main) = 0;
+
+/** Whether ann is for the block on top of the tip and beats the best announcement relayed for it. */
+static bool IsBetterAnnouncement(const CDeadlineAnnouncement& ann) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (!pindexTip || ann.hashPrevBlock != pindexTip->GetBlockHash() || ann.nHeight != pindexTip->nHeight + 1)
+        return false;
+    return hashAnnouncedPrev != ann.hashPrevBlock || ann.deadline < nAnnouncedDeadline;
+}
+
+bool RelayDeadlineAnnouncement(const CDeadlineAnnouncement& ann, CConnman* connman, NodeId from)
+{
+    LOCK(cs_main);
+    if (!IsBetterAnnouncement(ann))
+        return false;
+    hashAnnouncedPrev = ann.hashPrevBlock;
+    nAnnouncedDeadline = ann.deadline;
+    connman->ForEachNode([&ann, connman, from](CNode* pnode)
+    {
+        if (pnode->GetId() == from || pnode->nVersion < DEADLINE_ANNOUNCE_VERSION || !pnode->fSuccessfullyConnected)
+            return;
+        connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::DEADLINE, ann));
+    });
+    return true;
+}
+
 static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connman)
 {
     unsigned int nRelayNodes = fReachable ? 2 : 1; // limited relaying of addresses outside our network(s)
@@ -1120,6 +1505,101 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/**
+ * Run a job serving a block to pfrom on the block serving threads, or right away without
+ * them. The messages of the peer wait for the job, so its responses keep their order.
+ */
+static void ServeBlockJob(CNode* pfrom, std::function<void()> job)
+{
+    if (!g_block_server) {
+        job();
+        return;
+    }
+    pfrom->AddRef();
+    g_block_server->Submit(pfrom->GetId(), [pfrom, job] {
+        if (!pfrom->fDisconnect)
+            job();
+        pfrom->Release();
+    });
+}
+
+/**
+ * Read a block to serve to pfrom from disk, and deserialize it into block unless it is
+ * null. It was checked when it was stored, its proof of capacity is not checked again.
+ * A block that can no longer be read, pruned meanwhile, disconnects the peer waiting for it.
+ */
+static bool ReadServedBlock(CNode* pfrom, const CBlockIndex* pindex, const CChainParams& chainparams, RawBlockData& block_data, CBlock* block)
+{
+    try {
+        if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart()))
+            throw std::runtime_error("cannot read block from disk");
+        if (block)
+            SpanReader(SER_DISK, CLIENT_VERSION, block_data.data) >> *block;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: block %s for peer=%d: %s\n", __func__, pindex->GetBlockHash().ToString(), pfrom->GetId(), e.what());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
+/** Send block to pfrom as inv asks, as a compact block if fCompact allows it. Needs no cs_main. */
+static void SendBlock(CNode* pfrom, const CInv& inv, const CBlock& block, const bool fPeerWantsWitness, const bool fCompact, CConnman* connman)
+{
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    if (inv.type == MSG_BLOCK || inv.type == MSG_WITNESS_BLOCK)
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(*serializedCache.Get(block, inv.type == MSG_WITNESS_BLOCK))));
+    else if (inv.type == MSG_FILTERED_BLOCK)
+    {
+        bool sendMerkleBlock = false;
+        CMerkleBlock merkleBlock;
+        {
+            LOCK(pfrom->cs_filter);
+            if (pfrom->pfilter) {
+                sendMerkleBlock = true;
+                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+            }
+        }
+        if (sendMerkleBlock) {
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
+            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+            // This avoids hurting performance by pointlessly requiring a round-trip
+            // Note that there is currently no way for a node to request any single transactions we didn't send here -
+            // they must either disconnect and retry or request the full block.
+            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+            // however we MUST always provide at least what the remote peer needs
+            typedef std::pair<unsigned int, uint256> PairType;
+            for (PairType& pair : merkleBlock.vMatchedTxn)
+                connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *block.vtx[pair.first]));
+        }
+        // else
+            // no response
+    }
+    else if (inv.type == MSG_CMPCT_BLOCK)
+    {
+        int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+        if (fCompact) {
+            CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
+            connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+        } else {
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(*serializedCache.Get(block, fPeerWantsWitness))));
+        }
+    }
+}
+
+/** Follow the last block of a getblocks batch with the tip, so the peer asks for the next batch. */
+static void PushContinueInventory(CNode* pfrom, const uint256& hashContinueTip, CConnman* connman)
+{
+    if (hashContinueTip.IsNull())
+        return;
+    // Bypass PushInventory, this must send even if redundant,
+    // and we want it right after the last block so they don't
+    // wait for other stuff first.
+    std::vector<CInv> vInv;
+    vInv.push_back(CInv(MSG_BLOCK, hashContinueTip));
+    connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::INV, vInv));
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
 {
     bool send = false;
@@ -1190,95 +1670,84 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     // it's available before trying to send.
     if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
     {
+        // If a peer is asking for old blocks, we're almost guaranteed
+        // they won't have a useful mempool to match against a compact block,
+        // and we don't feel like constructing the object for them, so
+        // instead we respond with the full, non-compact block.
+        const bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+        const bool fCompact = CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+
+        // Trigger the peer node to send a getblocks request for the next batch of inventory
+        uint256 hashContinueTip;
+        if (inv.hash == pfrom->hashContinue) {
+            hashContinueTip = chainActive.Tip()->GetBlockHash();
+            pfrom->hashContinue.SetNull();
+        }
+
         std::shared_ptr<const CBlock> pblock;
-        if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
+        if (inv.type == MSG_CMPCT_BLOCK && fCompact && (fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) &&
+            a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
+            int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+            connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+            PushContinueInventory(pfrom, hashContinueTip, connman);
+        } else if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
-        } else if (inv.type == MSG_WITNESS_BLOCK) {
-            // Fast-path: in this case it is possible to serve the block directly from disk,
-            // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
-            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
-                assert(!"cannot load block from disk");
-            }
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
-            // Don't set pblock as we've sent the block
+        } else if ((pblock = g_blockCache->GetBlock(pindex->GetBlockHash()))) {
+            // Held until its deadline, its competitors are asked for as well.
         } else {
-            // Send block from disk
-            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
-                assert(!"cannot load block from disk");
-            pblock = pblockRead;
-        }
-        if (pblock) {
-            if (inv.type == MSG_BLOCK)
-                connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
-            else if (inv.type == MSG_WITNESS_BLOCK)
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
-            else if (inv.type == MSG_FILTERED_BLOCK)
-            {
-                bool sendMerkleBlock = false;
-                CMerkleBlock merkleBlock;
-                {
-                    LOCK(pfrom->cs_filter);
-                    if (pfrom->pfilter) {
-                        sendMerkleBlock = true;
-                        merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
-                    }
-                }
-                if (sendMerkleBlock) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
-                    // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                    // This avoids hurting performance by pointlessly requiring a round-trip
-                    // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                    // they must either disconnect and retry or request the full block.
-                    // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                    // however we MUST always provide at least what the remote peer needs
-                    typedef std::pair<unsigned int, uint256> PairType;
-                    for (PairType& pair : merkleBlock.vMatchedTxn)
-                        connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *pblock->vtx[pair.first]));
-                }
-                // else
-                    // no response
-            }
-            else if (inv.type == MSG_CMPCT_BLOCK)
-            {
-                // If a peer is asking for old blocks, we're almost guaranteed
-                // they won't have a useful mempool to match against a compact block,
-                // and we don't feel like constructing the object for them, so
-                // instead we respond with the full, non-compact block.
-                bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
-                int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-                if (CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                    if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
-                    } else {
-                        CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
-                    }
+            // Read from disk on the block serving threads, without cs_main.
+            ServeBlockJob(pfrom, [pfrom, inv, pindex, fPeerWantsWitness, fCompact, hashContinueTip, &chainparams, connman] {
+                RawBlockData block_data;
+                if (inv.type == MSG_WITNESS_BLOCK) {
+                    // Fast-path: in this case it is possible to serve the block directly from disk,
+                    // as the network format matches the format on disk
+                    if (!ReadServedBlock(pfrom, pindex, chainparams, block_data, nullptr))
+                        return;
+                    connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::BLOCK, block_data.data));
                 } else {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
+                    CBlock block;
+                    if (!ReadServedBlock(pfrom, pindex, chainparams, block_data, &block))
+                        return;
+                    SendBlock(pfrom, inv, block, fPeerWantsWitness, fCompact, connman);
                 }
-            }
+                PushContinueInventory(pfrom, hashContinueTip, connman);
+            });
         }
-
-        // Trigger the peer node to send a getblocks request for the next batch of inventory
-        if (inv.hash == pfrom->hashContinue)
-        {
-            // Bypass PushInventory, this must send even if redundant,
-            // and we want it right after the last block so they don't
-            // wait for other stuff first.
-            std::vector<CInv> vInv;
-            vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
-            pfrom->hashContinue.SetNull();
+        if (pblock) {
+            SendBlock(pfrom, inv, *pblock, fPeerWantsWitness, fCompact, connman);
+            PushContinueInventory(pfrom, hashContinueTip, connman);
         }
     }
 }
 
+/**
+ * Have the blocks asked for after the one being served read from disk in the background.
+ * One served block moves the window by one, the blocks already in it are cheap to read again.
+ */
+static void PrefetchGetBlockData(std::deque<CInv>::const_iterator it, std::deque<CInv>::const_iterator end) LOCKS_EXCLUDED(cs_main)
+{
+    if (it == end || (it->type != MSG_BLOCK && it->type != MSG_FILTERED_BLOCK && it->type != MSG_WITNESS_BLOCK))
+        return;
+    LOCK(cs_main);
+    std::vector<const CBlockIndex*> blocks;
+    for (; it != end && blocks.size() < BLOCK_SERVE_READ_AHEAD; ++it) {
+        if (it->type != MSG_BLOCK && it->type != MSG_FILTERED_BLOCK && it->type != MSG_WITNESS_BLOCK)
+            break;
+        const CBlockIndex* pindex = LookupBlockIndex(it->hash);
+        if (pindex && (pindex->nStatus & BLOCK_HAVE_DATA))
+            blocks.push_back(pindex);
+    }
+    PrefetchBlocksFromDisk(blocks);
+}
+
 void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc) LOCKS_EXCLUDED(cs_main)
 {
     AssertLockNotHeld(cs_main);
 
+    // The rest waits for the block being served, to be sent after it.
+    if (g_block_server && g_block_server->IsBusy(pfrom->GetId()))
+        return;
+
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
     std::vector<CInv> vNotFound;
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1298,16 +1767,16 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             // Send stream from relay memory
             bool push = false;
             auto mi = mapRelay.find(inv.hash);
-            int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
+            const bool fWitness = inv.type == MSG_WITNESS_TX;
             if (mi != mapRelay.end()) {
-                connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, MakeSpan(*serializedCache.Get(*mi->second, fWitness))));
                 push = true;
             } else if (pfrom->timeLastMempoolReq) {
                 auto txinfo = mempool.info(inv.hash);
                 // To protect privacy, do not answer getdata using the mempool when
                 // that TX couldn't have been INVed in reply to a MEMPOOL request.
                 if (txinfo.tx && txinfo.nTime <= pfrom->timeLastMempoolReq) {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *txinfo.tx));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, MakeSpan(*serializedCache.Get(*txinfo.tx, fWitness))));
                     push = true;
                 }
             }
@@ -1321,6 +1790,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
         const CInv &inv = *it;
         if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK || inv.type == MSG_WITNESS_BLOCK) {
             it++;
+            PrefetchGetBlockData(it, pfrom->vRecvGetData.end());
             ProcessGetBlockData(pfrom, chainparams, inv, connman);
         }
     }
@@ -1363,6 +1833,34 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+/** Ask pnode for headers, after which its headers are solicited for HEADERS_RESPONSE_TIME. */
+static void PushGetHeaders(CConnman* connman, CNode* pnode, const CBlockLocator& locator, const uint256& hashStop) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    State(pnode->GetId())->nLastGetHeadersTime = GetTime();
+    connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::GETHEADERS, locator, hashStop));
+}
+
+/**
+ * Take nProofs from the budget of proofs of capacity pnode may make us verify for unsolicited
+ * headers and blocks, which refills by one every POC_BUDGET_INTERVAL seconds up to MAX_POC_BUDGET.
+ * A peer over budget is scored, and its message is ignored before any Shabal work.
+ */
+static bool ConsumePoCBudget(CNode* pnode, int nProofs) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (nProofs <= 0 || pnode->fWhitelisted)
+        return true;
+    CNodeState* state = State(pnode->GetId());
+    const int64_t nNow = GetTime();
+    state->nPoCBudget = std::min<double>(MAX_POC_BUDGET, state->nPoCBudget + (double)(nNow - state->nPoCBudgetTime) / POC_BUDGET_INTERVAL);
+    state->nPoCBudgetTime = nNow;
+    if (state->nPoCBudget < nProofs) {
+        Misbehaving(pnode->GetId(), 10, strprintf("%d unsolicited proofs of capacity over budget", nProofs));
+        return false;
+    }
+    state->nPoCBudget -= nProofs;
+    return true;
+}
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1374,6 +1872,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     }
 
     bool received_new_header = false;
+    bool fRequestedMore = false;
     const CBlockIndex *pindexLast = nullptr;
     {
         LOCK(cs_main);
@@ -1389,7 +1888,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         //   nUnconnectingHeaders gets reset back to 0.
         if (!LookupBlockIndex(headers[0].hashPrevBlock) && nCount < MAX_BLOCKS_TO_ANNOUNCE) {
             nodestate->nUnconnectingHeaders++;
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256()));
+            PushGetHeaders(connman, pfrom, chainActive.GetLocator(pindexBestHeader), uint256());
             LogPrint(BCLog::NET, "received header %s: missing prev block %s, sending getheaders (%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
                     headers[0].GetHash().ToString(),
                     headers[0].hashPrevBlock.ToString(),
@@ -1407,19 +1906,38 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         }
 
         uint256 hashLastBlock;
+        int nNewHeaders = 0;
         for (const CBlockHeader& header : headers) {
             if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
                 Misbehaving(pfrom->GetId(), 20, "non-continuous headers sequence");
                 return false;
             }
             hashLastBlock = header.GetHash();
+            if (!LookupBlockIndex(hashLastBlock))
+                nNewHeaders++;
         }
 
+        // Replies to our getheaders are verified in full, the proofs of unsolicited ones are rationed.
+        if (GetTime() - nodestate->nLastGetHeadersTime > HEADERS_RESPONSE_TIME && !ConsumePoCBudget(pfrom, nNewHeaders))
+            return true;
+
         // If we don't have the last header, then they'll have given us
         // something new (if these headers are valid).
         if (!LookupBlockIndex(hashLastBlock)) {
             received_new_header = true;
         }
+
+        // Headers message had its maximum size; the peer may have more headers.
+        // Ask for them before verifying these, so the peer answers while we check
+        // the proofs of capacity. Its reply is processed after this message.
+        const CBlockIndex* pindexPrev = LookupBlockIndex(headers[0].hashPrevBlock);
+        if (nCount == MAX_HEADERS_RESULTS && pindexPrev) {
+            CBlockLocator locator = chainActive.GetLocator(pindexPrev);
+            locator.vHave.insert(locator.vHave.begin(), hashLastBlock);
+            LogPrint(BCLog::NET, "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexPrev->nHeight + nCount, pfrom->GetId(), pfrom->nStartingHeight);
+            PushGetHeaders(connman, pfrom, locator, uint256());
+            fRequestedMore = true;
+        }
     }
 
     CValidationState state;
@@ -1489,13 +2007,16 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         if (received_new_header && pindexLast->nCumulativeDiff > chainActive.Tip()->nCumulativeDiff) {
             nodestate->m_last_block_announcement = GetTime();
         }
+        if (nCount <= MAX_BLOCKS_TO_ANNOUNCE) {
+            RecordBlockAnnouncement(pfrom->GetId(), pindexLast->GetBlockHash(), received_new_header);
+        }
 
-        if (nCount == MAX_HEADERS_RESULTS) {
+        if (nCount == MAX_HEADERS_RESULTS && !fRequestedMore) {
             // Headers message had its maximum size; the peer may have more headers.
             // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
             // from there instead.
             LogPrint(BCLog::NET, "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->GetId(), pfrom->nStartingHeight);
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexLast), uint256()));
+            PushGetHeaders(connman, pfrom, chainActive.GetLocator(pindexLast), uint256());
         }
 
         bool fCanDirectFetch = CanDirectFetch(chainparams.GetConsensus());
@@ -1505,7 +2026,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
             std::vector<const CBlockIndex*> vToFetch;
             const CBlockIndex *pindexWalk = pindexLast;
             // Calculate all the blocks we'd need to switch to pindexLast, up to a limit.
-            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= (size_t)nodestate->nBlockWindow) {
                 if (!(pindexWalk->nStatus & BLOCK_HAVE_DATA) &&
                         !mapBlocksInFlight.count(pindexWalk->GetBlockHash()) &&
                         (!IsWitnessEnabled(pindexWalk->pprev, chainparams.GetConsensus()) || State(pfrom->GetId())->fHaveWitness)) {
@@ -1526,7 +2047,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
                 std::vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 for (const CBlockIndex *pindex : reverse_iterate(vToFetch)) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= nodestate->nBlockWindow) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -1645,6 +2166,136 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+
+/**
+ * Validate a getcfilters or getcfheaders request and find its stop block. A peer
+ * asking for filters we do not serve, or for a range that is too large or upside
+ * down, is disconnected.
+ *
+ * @return  true if the request can be served
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chainparams,
+                                      BlockFilterType filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index)
+{
+    const bool supported_filter_type = (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) &&
+        g_blockfilterindex && filter_type == g_blockfilterindex->GetFilterType();
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), static_cast<uint8_t>(filter_type));
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chainparams.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with " /* Continued */
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    return true;
+}
+
+/** Answer a getcfilters request with a cfilter message per block. */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!g_blockfilterindex->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const BlockFilter& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/** Answer a getcfheaders request with the filter header before the range and the filter hashes in it. */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block = stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!g_blockfilterindex->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!g_blockfilterindex->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    CSerializedNetMsg msg = CNetMsgMaker(pfrom->GetSendVersion())
+        .Make(NetMsgType::CFHEADERS,
+              filter_type_ser,
+              stop_index->GetBlockHash(),
+              prev_header,
+              filter_hashes);
+    connman->PushMessage(pfrom, std::move(msg));
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -1808,6 +2459,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             State(pfrom->GetId())->fHaveWitness = true;
         }
 
+        pfrom->fCompress = (nServices & NODE_COMPRESS) && (pfrom->GetLocalServices() & NODE_COMPRESS) && nVersion >= COMPRESS_VERSION;
+
         // Potentially mark this peer as a preferred download peer.
         {
         LOCK(cs_main);
@@ -1911,6 +2564,16 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             nCMPCTBLOCKVersion = 1;
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
         }
+        if (pfrom->nVersion >= TXRECON_VERSION && gArgs.GetBoolArg("-txreconciliation", DEFAULT_TXRECONCILIATION)) {
+            // Offer to reconcile transaction announcements, which takes
+            // effect once the peer offers it as well.
+            const uint64_t nSalt = GetRand(std::numeric_limits<uint64_t>::max() - 1) + 1;
+            {
+                LOCK(cs_main);
+                State(pfrom->GetId())->m_recon_salt = nSalt;
+            }
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDRECON, TXRECON_PROTOCOL_VERSION, nSalt));
+        }
         pfrom->fSuccessfullyConnected = true;
         return true;
     }
@@ -2002,6 +2665,80 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::SENDRECON) {
+        uint32_t nReconVersion = 0;
+        uint64_t nSalt = 0;
+        vRecv >> nReconVersion >> nSalt;
+        LOCK(cs_main);
+        CNodeState* nodestate = State(pfrom->GetId());
+        if (nodestate->m_recon || nodestate->m_recon_salt == 0 || nReconVersion < TXRECON_PROTOCOL_VERSION)
+            return true;
+        // The outbound side requests the reconciliations.
+        nodestate->m_recon.reset(new TxReconciliationState(!pfrom->fInbound, nodestate->m_recon_salt, nSalt));
+        nodestate->m_recon->nNextRequest = PoissonNextSend(GetTimeMicros(), RECON_REQUEST_INTERVAL);
+        LogPrint(BCLog::NET, "reconciling transactions with peer=%d\n", pfrom->GetId());
+        return true;
+    }
+
+    if (strCommand == NetMsgType::REQRECON) {
+        uint16_t nSetSize = 0;
+        vRecv >> nSetSize;
+        LOCK(cs_main);
+        TxReconciliationState* recon = State(pfrom->GetId())->m_recon.get();
+        if (!recon || recon->fInitiator)
+            return true;
+        recon->Snapshot();
+        const CTxReconSketch sketch = recon->SketchSnapshot(EstimateSketchCells(recon->mapSnapshot.size(), nSetSize));
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SKETCH, sketch));
+        return true;
+    }
+
+    if (strCommand == NetMsgType::SKETCH) {
+        CTxReconSketch sketch;
+        vRecv >> sketch;
+        LOCK(cs_main);
+        TxReconciliationState* recon = State(pfrom->GetId())->m_recon.get();
+        if (!recon || !recon->fInitiator || recon->nRequestTime == 0)
+            return true;
+        if (!sketch.IsValid()) {
+            Misbehaving(pfrom->GetId(), 20, strprintf("sketch of %u cells", sketch.CellCount()));
+            return false;
+        }
+        recon->nRequestTime = 0;
+        sketch.Subtract(recon->SketchSnapshot(sketch.CellCount()));
+        std::vector<uint32_t> vWanted, vMissing;
+        const bool fDecoded = sketch.Decode(vWanted, vMissing);
+        LogPrint(BCLog::NET, "reconciled %u cells with peer=%d: %s, %u wanted, %u missing\n", sketch.CellCount(), pfrom->GetId(),
+            fDecoded ? "decoded" : "failed", vWanted.size(), vMissing.size());
+        if (fDecoded) {
+            AnnounceReconciled(pfrom, *recon, recon->LookupSnapshot(vMissing));
+            recon->TakeSnapshot();
+        } else {
+            // Fall back to announcing the whole set, as does the peer.
+            vWanted.clear();
+            AnnounceReconciled(pfrom, *recon, recon->TakeSnapshot());
+        }
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::RECONCILDIFF, fDecoded, vWanted));
+        return true;
+    }
+
+    if (strCommand == NetMsgType::RECONCILDIFF) {
+        bool fDecoded = false;
+        std::vector<uint32_t> vWanted;
+        vRecv >> fDecoded >> vWanted;
+        LOCK(cs_main);
+        TxReconciliationState* recon = State(pfrom->GetId())->m_recon.get();
+        if (!recon || recon->fInitiator)
+            return true;
+        if (fDecoded) {
+            AnnounceReconciled(pfrom, *recon, recon->LookupSnapshot(vWanted));
+            recon->TakeSnapshot();
+        } else {
+            AnnounceReconciled(pfrom, *recon, recon->TakeSnapshot());
+        }
+        return true;
+    }
+
     if (strCommand == NetMsgType::INV) {
         std::vector<CInv> vInv;
         vRecv >> vInv;
@@ -2036,13 +2773,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
+                RecordBlockAnnouncement(pfrom->GetId(), inv.hash, !fAlreadyHave);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
                     // We used to request the full block here, but since headers-announcements are now the
                     // primary method of announcement on the network, and since, in the case that a node
                     // fell back to inv we probably have a reorg which we should get the headers for first,
                     // we now only provide a getheaders response here. When we receive the headers, we will
                     // then ask for the blocks we need.
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), inv.hash));
+                    PushGetHeaders(connman, pfrom, chainActive.GetLocator(pindexBestHeader), inv.hash);
                     LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->GetId());
                 }
             }
@@ -2189,11 +2927,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        CBlock block;
-        bool ret = ReadBlockFromDisk(block, pindex, chainparams.GetConsensus());
-        assert(ret);
-
-        SendBlockTransactions(block, req, pfrom, connman);
+        ServeBlockJob(pfrom, [pfrom, pindex, req, &chainparams, connman] {
+            RawBlockData block_data;
+            CBlock block;
+            if (ReadServedBlock(pfrom, pindex, chainparams, block_data, &block))
+                SendBlockTransactions(block, req, pfrom, connman);
+        });
         return true;
     }
 
@@ -2413,6 +3152,125 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::DEADLINE) {
+        CDeadlineAnnouncement ann;
+        vRecv >> ann;
+
+        LOCK(cs_main);
+        // Stale, early or beaten announcements are dropped before any work, they are not
+        // misbehavior: they cross the blocks and the better announcements on the wire.
+        if (!IsBetterAnnouncement(ann))
+            return true;
+        const PoCTipInfo info = GetPoCTipInfo(chainActive.Tip(), chainparams.GetConsensus().LVIP05Height);
+        // Classic poc2 plots are not signed by the key of their plot.
+        if (info.fPoc2)
+            return true;
+        if (!ConsumePoCBudget(pfrom, 1))
+            return true;
+        if (!ann.CheckSignature()) {
+            Misbehaving(pfrom->GetId(), 100, "deadline announcement with a bad signature");
+            return false;
+        }
+        if (CalcDeadline(info, uint160(ann.keyid), 0, ann.nonce) != ann.deadline) {
+            Misbehaving(pfrom->GetId(), 50, "deadline announcement with a wrong deadline");
+            return false;
+        }
+
+        PoCItem item;
+        item.genSig = info.genSig;
+        item.height = info.height;
+        item.publicKeyID = uint160(ann.keyid);
+        item.nonce = ann.nonce;
+        item.deadline = ann.deadline;
+        AddPreverifiedProof(item);
+        if (!ann.firestone.IsNull() && pcoinsprefetch)
+            pcoinsprefetch->Prefetch(ann.firestone);
+
+        LogPrint(BCLog::NET, "deadline %u at height %d announced by peer=%d\n", ann.deadline, ann.nHeight, pfrom->GetId());
+        RelayDeadlineAnnouncement(ann, connman, pfrom->GetId());
+        return true;
+    }
+
+    if (strCommand == NetMsgType::PKGTXNS) {
+        if (!fRelayTxes && (!pfrom->fWhitelisted || !gArgs.GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY)))
+        {
+            LogPrint(BCLog::NET, "package sent in violation of protocol peer=%d\n", pfrom->GetId());
+            return true;
+        }
+
+        std::vector<CTransactionRef> package;
+        vRecv >> package;
+        if (package.empty() || package.size() > MAX_PACKAGE_COUNT) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, strprintf("pkgtxns message size = %u", package.size()));
+            return false;
+        }
+
+        for (const CTransactionRef& tx : package) {
+            pfrom->AddInventoryKnown(CInv(MSG_TX, tx->GetHash()));
+        }
+
+        LOCK2(cs_main, g_cs_orphans);
+
+        for (const CTransactionRef& tx : package) {
+            pfrom->setAskFor.erase(tx->GetHash());
+            mapAlreadyAskedFor.erase(tx->GetHash());
+        }
+
+        bool fMissingInputs = false;
+        CValidationState state;
+        if (AcceptPackageToMemoryPool(mempool, state, package, &fMissingInputs, 0 /* nAbsurdFee */)) {
+            mempool.check(pcoinsTip.get());
+            RelayPackage(package, connman, pfrom->GetId());
+            for (const CTransactionRef& tx : package) {
+                EraseOrphanTx(tx->GetHash());
+                for (unsigned int i = 0; i < tx->vout.size(); i++) {
+                    auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(tx->GetHash(), i));
+                    if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                        for (const auto& elem : it_by_prev->second) {
+                            pfrom->orphan_work_set.insert(elem->first);
+                        }
+                    }
+                }
+            }
+
+            pfrom->nLastTXTime = GetTime();
+
+            LogPrint(BCLog::MEMPOOL, "AcceptPackageToMemoryPool: peer=%d: accepted %u txn ending with %s (poolsz %u txn, %u kB)\n",
+                pfrom->GetId(),
+                package.size(), package.back()->GetHash().ToString(),
+                mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+
+            // Process the orphans that were waiting for the package
+            std::list<CTransactionRef> lRemovedTxn;
+            ProcessOrphanTx(connman, pfrom->orphan_work_set, lRemovedTxn);
+            for (const CTransactionRef& removedTx : lRemovedTxn)
+                AddToCompactExtraTransactions(removedTx);
+        } else {
+            int nDoS = 0;
+            if (state.IsInvalid(nDoS)) {
+                LogPrint(BCLog::MEMPOOLREJ, "package ending with %s from peer=%d was not accepted: %s\n",
+                    package.back()->GetHash().ToString(),
+                    pfrom->GetId(),
+                    FormatStateMessage(state));
+                if (nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS);
+                }
+            }
+        }
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
     if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         CBlockHeaderAndShortTxIDs cmpctblock;
@@ -2426,12 +3284,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (!LookupBlockIndex(cmpctblock.header.hashPrevBlock)) {
             // Doesn't connect (or is genesis), instead of DoSing in AcceptBlockHeader, request deeper headers
             if (!IsInitialBlockDownload())
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256()));
+                PushGetHeaders(connman, pfrom, chainActive.GetLocator(pindexBestHeader), uint256());
             return true;
         }
 
         if (!LookupBlockIndex(cmpctblock.header.GetHash())) {
             received_new_header = true;
+            if (!ConsumePoCBudget(pfrom, 1))
+                return true;
         }
         }
 
@@ -2450,6 +3310,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
         }
 
+        // A headers only node has nothing to reconstruct the block with, nor a chain to connect it to.
+        if (fHeadersOnly)
+            return true;
+
         // When we succeed in decoding a block's txids from a cmpctblock
         // message we typically jump to the BLOCKTXN handling code, with a
         // dummy (empty) BLOCKTXN message, to re-use the logic there in
@@ -2479,6 +3343,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (received_new_header && pindex->nCumulativeDiff > chainActive.Tip()->nCumulativeDiff) {
             nodestate->m_last_block_announcement = GetTime();
         }
+        RecordBlockAnnouncement(pfrom->GetId(), pindex->GetBlockHash(), received_new_header);
 
         std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator blockInFlightIt = mapBlocksInFlight.find(pindex->GetBlockHash());
         bool fAlreadyInFlight = blockInFlightIt != mapBlocksInFlight.end();
@@ -2737,14 +3602,29 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        const size_t nBlockSize = vRecv.size();
         vRecv >> *pblock;
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
+        {
+            LOCK(cs_main);
+            if (!mapBlocksInFlight.count(pblock->GetHash()) && !ConsumePoCBudget(pfrom, 1))
+                return true;
+        }
+
+        // Blocks are never requested in headers only mode, only the header of an unsolicited one is kept.
+        if (fHeadersOnly) {
+            CValidationState state;
+            ProcessNewBlockHeaders({pblock->GetBlockHeader()}, state, chainparams);
+            return true;
+        }
+
         bool forceProcessing = false;
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
+            RecordBlockDownload(pfrom->GetId(), hash, nBlockSize, pfrom->nMinPingUsecTime);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
             forceProcessing |= MarkBlockAsReceived(hash);
@@ -2782,7 +3662,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_vAddrToSend);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr) {
@@ -3029,7 +3912,8 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     if (pfrom->fDisconnect)
         return false;
 
-    // this maintains the order of responses
+    // this maintains the order of responses, nothing is done for the peer while a block is served to it
+    if (g_block_server && g_block_server->IsBusy(pfrom->GetId())) return false;
     if (!pfrom->vRecvGetData.empty()) return true;
     if (!pfrom->orphan_work_set.empty()) return true;
 
@@ -3082,8 +3966,23 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return fMoreWork;
     }
 
+    if (strCommand == NetMsgType::COMPRESSED) {
+        std::vector<unsigned char> data;
+        if (!pfrom->fCompress || !DecompressMessage(Span<const unsigned char>((const unsigned char*)vRecv.data(), vRecv.size()), strCommand, data)) {
+            LogPrint(BCLog::NET, "%s: invalid compressed message (%u bytes) peer=%d\n", __func__, nMessageSize, pfrom->GetId());
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, "invalid compressed message");
+            return fMoreWork;
+        }
+        vRecv = CDataStream(data, vRecv.GetType(), vRecv.GetVersion());
+        nMessageSize = vRecv.size();
+    }
+
     // Process message
+    TRACE3(net, inbound_message, pfrom->GetId(), strCommand.c_str(), nMessageSize);
     bool fRet = false;
+    static CMetricHistogram& metric = GetMetrics().Histogram("net_processmessage", "Time to process a message from a peer");
+    CMetricTimer timer(metric);
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
@@ -3172,7 +4071,7 @@ void PeerLogicValidation::ConsiderEviction(CNode *pto, int64_t time_in_seconds)
             } else {
                 assert(state.m_chain_sync.m_work_header);
                 LogPrint(BCLog::NET, "sending getheaders to outbound peer=%d to verify chain work (current best known block:%s, benchmark blockhash: %s)\n", pto->GetId(), state.pindexBestKnownBlock != nullptr ? state.pindexBestKnownBlock->GetBlockHash().ToString() : "<none>", state.m_chain_sync.m_work_header->GetBlockHash().ToString());
-                connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(state.m_chain_sync.m_work_header->pprev), uint256()));
+                PushGetHeaders(connman, pto, chainActive.GetLocator(state.m_chain_sync.m_work_header->pprev), uint256());
                 state.m_chain_sync.m_sent_getheaders = true;
                 constexpr int64_t HEADERS_RESPONSE_TIME = 120; // 2 minutes
                 // Bump the timeout to allow a response, which could clear the timeout
@@ -3344,6 +4243,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->cs_vAddrToSend);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend)
@@ -3389,7 +4289,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 if (pindexStart->pprev)
                     pindexStart = pindexStart->pprev;
                 LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->GetId(), pto->nStartingHeight);
-                connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), uint256()));
+                PushGetHeaders(connman, pto, chainActive.GetLocator(pindexStart), uint256());
             }
         }
 
@@ -3497,6 +4397,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                     }
                     state.pindexBestHeaderSent = pBestIndex;
+                    g_forge_trace.BlockAnnounced(pBestIndex->GetBlockHash());
                 } else if (state.fPreferHeaders) {
                     if (vHeaders.size() > 1) {
                         LogPrint(BCLog::NET, "%s: %u headers, range (%s, %s), to peer=%d\n", __func__,
@@ -3509,6 +4410,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     }
                     connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
                     state.pindexBestHeaderSent = pBestIndex;
+                    g_forge_trace.BlockAnnounced(pBestIndex->GetBlockHash());
                 } else
                     fRevertToInv = true;
             }
@@ -3534,6 +4436,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         pto->PushInventory(CInv(MSG_BLOCK, hashToAnnounce));
                         LogPrint(BCLog::NET, "%s: sending inv peer=%d hash=%s\n", __func__,
                             pto->GetId(), hashToAnnounce.ToString());
+                        g_forge_trace.BlockAnnounced(hashToAnnounce);
                     }
                 }
             }
@@ -3638,6 +4541,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     uint256 hash = *it;
                     // Remove it from the to-be-sent set
                     pto->setInventoryTxToSend.erase(it);
+                    const bool fReconciled = state.m_recon && state.m_recon->setAnnounce.erase(hash);
                     // Check if not in the filter already
                     if (pto->filterInventoryKnown.contains(hash)) {
                         continue;
@@ -3651,6 +4555,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         continue;
                     }
                     if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                    // Leave it to the next reconciliation, unless it comes out of one.
+                    if (state.m_recon && !fReconciled && state.m_recon->AddToSet(hash)) continue;
                     // Send
                     vInv.push_back(CInv(MSG_TX, hash));
                     nRelayedTransactions++;
@@ -3678,6 +4584,25 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         if (!vInv.empty())
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
 
+        //
+        // Message: reqrecon
+        //
+        if (state.m_recon && state.m_recon->fInitiator) {
+            TxReconciliationState& recon = *state.m_recon;
+            if (recon.nRequestTime && recon.nRequestTime < nNow - RECON_TIMEOUT * 1000000) {
+                LogPrint(BCLog::NET, "reconciliation timed out, announcing %u transactions to peer=%d\n", recon.mapSnapshot.size(), pto->GetId());
+                AnnounceReconciled(pto, recon, recon.TakeSnapshot());
+                recon.nRequestTime = 0;
+            }
+            if (recon.nRequestTime == 0 && recon.nNextRequest < nNow) {
+                recon.Snapshot();
+                const uint16_t nSetSize = std::min<size_t>(recon.mapSnapshot.size(), std::numeric_limits<uint16_t>::max());
+                connman->PushMessage(pto, msgMaker.Make(NetMsgType::REQRECON, nSetSize));
+                recon.nRequestTime = nNow;
+                recon.nNextRequest = PoissonNextSend(nNow, RECON_REQUEST_INTERVAL);
+            }
+        }
+
         // Detect whether we're stalling
         nNow = GetTimeMicros();
         if (state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
@@ -3743,10 +4668,11 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fClient && !fHeadersOnly && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlockWindow) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            const CBlockIndex* pindexStalled = nullptr;
+            FindNextBlocksToDownload(pto->GetId(), state.nBlockWindow - state.nBlocksInFlight, vToDownload, staller, consensusParams, &pindexStalled);
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -3755,9 +4681,17 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     pindex->nHeight, pto->GetId());
             }
             if (state.nBlocksInFlight == 0 && staller != -1) {
-                if (State(staller)->nStallingSince == 0) {
-                    State(staller)->nStallingSince = nNow;
+                CNodeState *stallerState = State(staller);
+                if (stallerState->nStallingSince == 0) {
+                    stallerState->nStallingSince = nNow;
                     LogPrint(BCLog::NET, "Stall started peer=%d\n", staller);
+                } else if (pindexStalled && stallerState->nStallingSince < nNow - 500000 * BLOCK_STALLING_TIMEOUT) {
+                    // The staller had half its timeout and we are idle: ask us for the block it holds up,
+                    // which moves the request over so the window can move whichever of the two delivers.
+                    vGetData.push_back(CInv(MSG_BLOCK | GetFetchFlags(pto), pindexStalled->GetBlockHash()));
+                    MarkBlockAsInFlight(pto->GetId(), pindexStalled->GetBlockHash(), pindexStalled);
+                    LogPrint(BCLog::NET, "Requesting stalled block %s (%d) from peer=%d instead of peer=%d\n", pindexStalled->GetBlockHash().ToString(),
+                        pindexStalled->nHeight, pto->GetId(), staller);
                 }
             }
         }
@@ -3797,7 +4731,13 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             if (timeNow > pto->nextSendTimeFeeFilter) {
                 static CFeeRate default_feerate(DEFAULT_MIN_RELAY_TX_FEE);
                 static FeeFilterRounder filterRounder(default_feerate);
-                CAmount filterToSend = filterRounder.round(currentFilter);
+                // Shared by the message handlers, and its rounding draws from a random context.
+                static Mutex cs_filterRounder;
+                CAmount filterToSend;
+                {
+                    LOCK(cs_filterRounder);
+                    filterToSend = filterRounder.round(currentFilter);
+                }
                 // We always have a fee filter of at least minRelayTxFee
                 filterToSend = std::max(filterToSend, ::minRelayTxFee.GetFeePerK());
                 if (filterToSend != pto->lastSentFeeFilter) {
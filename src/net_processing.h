@@ -71,6 +71,10 @@ public:
     void CheckForStaleTipAndEvictPeers(const Consensus::Params &consensusParams);
     /** If we have extra outbound peers, try to disconnect the one with the oldest block announcement */
     void EvictExtraOutboundPeers(int64_t time_in_seconds) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Give the best peer that does not announce blocks with cmpctblock a trial at it */
+    void ProbeHighBandwidthPeers();
+    /** Remove the stale header-only side branches from the block index, but those the peers' state points to */
+    void PruneStaleHeaders(int nDepth);
 
 private:
     int64_t m_stale_tip_check_time; //!< Next time to check for stale tip
@@ -84,9 +88,31 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    uint64_t nBlocksDownloaded = 0;
+    uint64_t nBlockBytesDownloaded = 0;
+    int64_t nBlockTimeAvg = 0;
+    int nBlockWindow = 0;
+    bool fHighBandwidth = false;
+    int64_t nBlockAnnounceP50 = -1;
+    int64_t nBlockAnnounceP90 = -1;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 
+/**
+ * Relay a package accepted to the mempool: peers speaking package relay get it in one
+ * "pkgtxns" message, the others an inv of each transaction. The peer it came from is skipped.
+ */
+void RelayPackage(const std::vector<CTransactionRef>& package, CConnman* connman, NodeId from = -1);
+
+struct CDeadlineAnnouncement;
+
+/**
+ * Relay a deadline announcement for the block on top of the tip to the peers speaking
+ * deadline announcements, unless one with a better deadline was relayed already. The peer
+ * it came from is skipped. Returns whether it was relayed.
+ */
+bool RelayDeadlineAnnouncement(const CDeadlineAnnouncement& ann, CConnman* connman, NodeId from = -1);
+
 #endif // BITCOIN_NET_PROCESSING_H
@@ -0,0 +1,83 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <netcapacity.h>
+
+#include <chain.h>
+#include <chainparams.h>
+
+#include <algorithm>
+#include <vector>
+
+std::unique_ptr<CNetworkCapacity> g_network_capacity;
+
+/** The capacity in MiB that forges blocks of this base target in the target spacing. */
+static uint64_t CapacityMiB(uint64_t nBaseTarget)
+{
+    return (Params().GenesisBlock().nBaseTarget << 20) / std::max<uint64_t>(nBaseTarget, 1);
+}
+
+CNetworkCapacity::CNetworkCapacity(int nWindowIn) : nWindow(std::max(nWindowIn, 1)), nTipHeight(-1)
+{
+}
+
+void CNetworkCapacity::Reset(const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    sums.clear();
+    nTipHeight = -1;
+    if (pindex == nullptr)
+        return;
+    // Start one block before the window, its own estimate is never part of an average.
+    const CBlockIndex* pfirst = pindex->GetAncestor(std::max(pindex->nHeight - nWindow, 0));
+    nTipHeight = pfirst->nHeight;
+    sums.push_back(0);
+    Append(pindex);
+}
+
+void CNetworkCapacity::Append(const CBlockIndex* pindex)
+{
+    std::vector<const CBlockIndex*> blocks;
+    for (; pindex != nullptr && pindex->nHeight > nTipHeight; pindex = pindex->pprev)
+        blocks.push_back(pindex);
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+        sums.push_back(sums.back() + CapacityMiB((*it)->nBaseTarget));
+        if (sums.size() > (size_t)nWindow + 1)
+            sums.pop_front();
+    }
+    if (!blocks.empty())
+        nTipHeight = blocks.front()->nHeight;
+}
+
+void CNetworkCapacity::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    const int nForkHeight = pindexFork ? pindexFork->nHeight : -1;
+    {
+        LOCK(cs);
+        // Drop the blocks that were disconnected, unless that leaves none.
+        const int nDrop = nTipHeight - nForkHeight;
+        if (nTipHeight >= 0 && nDrop >= 0 && (size_t)nDrop < sums.size()) {
+            sums.resize(sums.size() - nDrop);
+            nTipHeight = nForkHeight;
+        }
+        if (nTipHeight >= 0 && nTipHeight == nForkHeight) {
+            Append(pindexNew);
+            return;
+        }
+    }
+    // The reorg was deeper than the window, or the sums were never loaded.
+    Reset(pindexNew);
+}
+
+bool CNetworkCapacity::GetCapacity(int& nBlocks, double& capacity, int& nHeight) const
+{
+    LOCK(cs);
+    if (sums.size() < 2)
+        return false;
+    const size_t n = std::min<size_t>(std::max(nBlocks, 1), sums.size() - 1);
+    capacity = (double)(sums.back() - sums[sums.size() - 1 - n]) / n / (1 << 20);
+    nBlocks = n;
+    nHeight = nTipHeight;
+    return true;
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_NETCAPACITY_H
+#define LAVA_NETCAPACITY_H
+
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <deque>
+#include <memory>
+#include <stdint.h>
+
+class CBlockIndex;
+
+/** Default for -capacitywindow, a week of blocks. */
+static const int DEFAULT_CAPACITY_WINDOW = 7 * 24 * 15;
+/** Default number of blocks getnetworkcapacity averages over, a day of blocks. */
+static const int DEFAULT_CAPACITY_BLOCKS = 24 * 15;
+
+/**
+ * The plotted capacity of the network, estimated from the base targets of the last blocks:
+ * the genesis base target is that of one TiB, and the capacity is inversely proportional to
+ * the base target. The running sums of the estimates of the last blocks of the active chain
+ * are kept up to date as the tip moves, so the average over any number of blocks up to the
+ * window is read in constant time.
+ */
+class CNetworkCapacity : public CValidationInterface
+{
+public:
+    explicit CNetworkCapacity(int nWindow);
+
+    /** Forget the estimates and take those of the window of blocks ending at pindex. */
+    void Reset(const CBlockIndex* pindex);
+
+    /** The average capacity in TiB of the last nBlocks blocks up to the tip, and the height
+     *  of that tip. nBlocks is lowered to the blocks known. Returns false if there are none. */
+    bool GetCapacity(int& nBlocks, double& capacity, int& nHeight) const;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+private:
+    /** Append the estimates of the blocks after the tip up to pindex. */
+    void Append(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    const int nWindow;
+    mutable CCriticalSection cs;
+    /** The height of the last block summed, -1 if there is none. */
+    int nTipHeight GUARDED_BY(cs);
+    /** The running sums, in MiB, of the blocks up to nTipHeight: the last is that of the
+     *  tip. They wrap around, only their differences over the window are meaningful. */
+    std::deque<uint64_t> sums GUARDED_BY(cs);
+};
+
+extern std::unique_ptr<CNetworkCapacity> g_network_capacity;
+
+#endif // LAVA_NETCAPACITY_H
@@ -0,0 +1,143 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <netcompress.h>
+
+#include <metrics.h>
+#include <net.h>
+#include <policy/policy.h>
+#include <primitives/confidential.h>
+#include <protocol.h>
+#include <script/script.h>
+#include <streams.h>
+#include <sync.h>
+#include <version.h>
+
+#include <algorithm>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+/** zstd level, a fast one: the links it is meant for are slow, but not that slow. */
+static const int COMPRESS_LEVEL = 3;
+
+bool IsCompressibleCommand(const std::string& command)
+{
+    return command == NetMsgType::BLOCK || command == NetMsgType::BLOCKTXN ||
+           command == NetMsgType::HEADERS || command == NetMsgType::TX;
+}
+
+#ifdef USE_ZSTD
+
+static Mutex cs_compress;
+static std::vector<unsigned char> dictionary GUARDED_BY(cs_compress);
+static ZSTD_CCtx* cctx GUARDED_BY(cs_compress) = nullptr;
+static ZSTD_CDict* cdict GUARDED_BY(cs_compress) = nullptr;
+static ZSTD_DCtx* dctx GUARDED_BY(cs_compress) = nullptr;
+static ZSTD_DDict* ddict GUARDED_BY(cs_compress) = nullptr;
+
+bool CanCompressMessages()
+{
+    return true;
+}
+
+void InitMessageCompression()
+{
+    // zstd matches the end of a raw dictionary best, so the native asset tag, in every
+    // output that is not blinded, goes last.
+    std::vector<unsigned char> dict;
+    CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, dict, 0);
+    const std::vector<unsigned char> hash160(20, 0);
+    const std::vector<unsigned char> hash256(32, 0);
+    writer << (CScript() << OP_HASH160 << hash160 << OP_EQUAL);
+    writer << (CScript() << OP_DUP << OP_HASH160 << hash160 << OP_EQUALVERIFY << OP_CHECKSIG);
+    writer << (CScript() << OP_0 << hash256) << (CScript() << OP_0 << hash160);
+    for (int i = 0; i < 4; i++) {
+        writer << CConfidentialAsset(::policyAsset) << CConfidentialValue(0) << (CScript() << OP_0 << hash160);
+    }
+
+    LOCK(cs_compress);
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+    dictionary = std::move(dict);
+    cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), COMPRESS_LEVEL);
+    ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    if (!cctx)
+        cctx = ZSTD_createCCtx();
+    if (!dctx)
+        dctx = ZSTD_createDCtx();
+}
+
+bool CompressMessage(const std::string& command, Span<const unsigned char> data, std::vector<unsigned char>& payload)
+{
+    static CMetricCounter& saved = GetMetrics().Counter("net_compress_saved_bytes", "Bytes saved by compressing the messages sent to peers");
+    payload.clear();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, payload, 0, command);
+    const size_t nHeader = payload.size();
+    payload.resize(nHeader + ZSTD_compressBound(data.size()));
+    size_t nFrame;
+    {
+        LOCK(cs_compress);
+        if (!cdict || !cctx)
+            return false;
+        nFrame = ZSTD_compress_usingCDict(cctx, payload.data() + nHeader, payload.size() - nHeader, data.data(), data.size(), cdict);
+    }
+    if (ZSTD_isError(nFrame) || nHeader + nFrame >= (size_t)data.size())
+        return false;
+    payload.resize(nHeader + nFrame);
+    saved.Add(data.size() - payload.size());
+    return true;
+}
+
+bool DecompressMessage(Span<const unsigned char> payload, std::string& command, std::vector<unsigned char>& data)
+{
+    try {
+        // The command is short, only its bytes are copied to be read.
+        const std::vector<unsigned char> head(payload.begin(), payload.begin() + std::min<std::ptrdiff_t>(payload.size(), 1 + CMessageHeader::COMMAND_SIZE));
+        VectorReader reader(SER_NETWORK, PROTOCOL_VERSION, head, 0);
+        LimitedString<CMessageHeader::COMMAND_SIZE> limited(command);
+        reader >> limited;
+        if (!IsCompressibleCommand(command))
+            return false;
+        const Span<const unsigned char> frame = payload.subspan(head.size() - reader.size());
+        // The frame header states the size, which must be set, so a bomb is refused unread.
+        const unsigned long long nSize = ZSTD_getFrameContentSize(frame.data(), frame.size());
+        if (nSize == ZSTD_CONTENTSIZE_UNKNOWN || nSize == ZSTD_CONTENTSIZE_ERROR || nSize > MAX_PROTOCOL_MESSAGE_LENGTH)
+            return false;
+        data.resize(nSize);
+        LOCK(cs_compress);
+        if (!ddict || !dctx)
+            return false;
+        const size_t nRead = ZSTD_decompress_usingDDict(dctx, data.data(), data.size(), frame.data(), frame.size(), ddict);
+        return !ZSTD_isError(nRead) && nRead == nSize;
+    } catch (const std::ios_base::failure&) {
+        return false;
+    }
+}
+
+#else
+
+bool CanCompressMessages()
+{
+    return false;
+}
+
+void InitMessageCompression() {}
+
+bool CompressMessage(const std::string& command, Span<const unsigned char> data, std::vector<unsigned char>& payload)
+{
+    return false;
+}
+
+bool DecompressMessage(Span<const unsigned char> payload, std::string& command, std::vector<unsigned char>& data)
+{
+    return false;
+}
+
+#endif // USE_ZSTD
@@ -0,0 +1,49 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_NETCOMPRESS_H
+#define LAVA_NETCOMPRESS_H
+
+#include <span.h>
+
+#include <string>
+#include <vector>
+
+/** Default for -compressrelay */
+static const bool DEFAULT_COMPRESS_RELAY = false;
+/** Messages shorter than this are sent as they are, compressing them saves little. */
+static const size_t MIN_COMPRESS_SIZE = 512;
+
+/**
+ * Compression of the block, blocktxn, headers and tx messages sent to peers that both
+ * advertise NODE_COMPRESS and speak COMPRESS_VERSION, for links short on bandwidth.
+ * Such a message is wrapped into a "compressed" message carrying its command and a
+ * zstd frame of its payload. Both ends prime zstd with the same dictionary, made of the
+ * native asset tag and the output scripts repeated by every confidential output, so even
+ * a single transaction compresses. Changing it requires a new protocol version.
+ *
+ * Only available when built with zstd, CanCompressMessages() is false otherwise.
+ */
+bool CanCompressMessages();
+
+/** Build the dictionary, once ::policyAsset is known. */
+void InitMessageCompression();
+
+/** Whether messages of this command are compressed for the peers that negotiated it. */
+bool IsCompressibleCommand(const std::string& command);
+
+/**
+ * Build the payload of the "compressed" message wrapping a message of command.
+ * @return false if the message does not get smaller, then it is sent as it is.
+ */
+bool CompressMessage(const std::string& command, Span<const unsigned char> data, std::vector<unsigned char>& payload);
+
+/**
+ * Unwrap the payload of a "compressed" message into the command and payload of the
+ * message it wraps, which is at most MAX_PROTOCOL_MESSAGE_LENGTH bytes long.
+ * @return false if it is malformed or wraps a command that is never compressed.
+ */
+bool DecompressMessage(Span<const unsigned char> payload, std::string& command, std::vector<unsigned char>& data);
+
+#endif // LAVA_NETCOMPRESS_H
@@ -5,6 +5,7 @@
 
 #include <consensus/validation.h>
 #include <net.h>
+#include <net_processing.h>
 #include <txmempool.h>
 #include <validation.h>
 #include <validationinterface.h>
@@ -107,3 +108,52 @@ TransactionError BroadcastTransaction(const CTransactionRef tx, uint256& hashTx,
 
     return TransactionError::OK;
 }
+
+TransactionError BroadcastPackage(const std::vector<CTransactionRef>& package, std::string& err_string, const CAmount& highfee)
+{
+    std::promise<void> promise;
+    assert(!package.empty());
+    const uint256& hashLast = package.back()->GetHash();
+
+    { // cs_main scope
+    LOCK(cs_main);
+    CCoinsViewCache &view = *pcoinsTip;
+    bool fHaveChain = false;
+    for (size_t o = 0; !fHaveChain && o < package.back()->vout.size(); o++) {
+        const Coin& existingCoin = view.AccessCoin(COutPoint(hashLast, o));
+        fHaveChain = !existingCoin.IsSpent();
+    }
+    if (fHaveChain) {
+        return TransactionError::ALREADY_IN_CHAIN;
+    }
+    CValidationState state;
+    bool fMissingInputs;
+    if (!AcceptPackageToMemoryPool(mempool, state, package, &fMissingInputs, highfee)) {
+        if (state.IsInvalid()) {
+            err_string = FormatStateMessage(state);
+            return TransactionError::MEMPOOL_REJECTED;
+        } else {
+            if (fMissingInputs) {
+                return TransactionError::MISSING_INPUTS;
+            }
+            err_string = FormatStateMessage(state);
+            return TransactionError::MEMPOOL_ERROR;
+        }
+    }
+    // Let the wallets see the package first, as BroadcastTransaction does.
+    CallFunctionInValidationInterfaceQueue([&promise] {
+        promise.set_value();
+    });
+
+    } // cs_main
+
+    promise.get_future().wait();
+
+    if (!g_connman) {
+        return TransactionError::P2P_DISABLED;
+    }
+
+    RelayPackage(package, g_connman.get());
+
+    return TransactionError::OK;
+}
@@ -9,6 +9,8 @@
 #include <primitives/transaction.h>
 #include <uint256.h>
 
+#include <vector>
+
 enum class TransactionError {
     OK, //!< No error
     MISSING_INPUTS,
@@ -37,4 +39,14 @@ std::string TransactionErrorString(const TransactionError error);
  */
 NODISCARD TransactionError BroadcastTransaction(CTransactionRef tx, uint256& txid, std::string& err_string, const CAmount& highfee);
 
+/**
+ * Broadcast a package of transactions, sorted parents first, which are accepted together
+ *
+ * @param[in]  package the transactions to broadcast
+ * @param[out] &err_string reference to std::string to fill with error string if available
+ * @param[in]  highfee Reject txs with fees higher than this (if 0, accept any fee)
+ * return error
+ */
+NODISCARD TransactionError BroadcastPackage(const std::vector<CTransactionRef>& package, std::string& err_string, const CAmount& highfee);
+
 #endif // BITCOIN_NODE_TRANSACTION_H
@@ -0,0 +1,369 @@
+#include <plotminer.h>
+#include <assember.h>
+#include <blockcache.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <logging.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/algorithm/string.hpp>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<CPlotMiner> g_plotminer;
+
+bool ParsePlotFile(const fs::path& path, CPlotFile& plot)
+{
+    std::vector<std::string> parts;
+    boost::split(parts, path.filename().string(), boost::is_any_of("_"));
+    if (parts.size() != 3)
+        return false;
+    if (!ParseUInt64(parts[1], &plot.startNonce) || !ParseUInt64(parts[2], &plot.nonces) || plot.nonces == 0)
+        return false;
+    if (parts[0].size() == 2 * sizeof(uint160) && IsHex(parts[0])) {
+        plot.fPoc2 = false;
+        plot.keyID.SetHex(parts[0]);
+    } else if (ParseUInt64(parts[0], &plot.plotID)) {
+        plot.fPoc2 = true;
+    } else {
+        return false;
+    }
+    plot.path = path;
+    return true;
+}
+
+std::vector<CPlotFile> FindPlotFiles(const fs::path& dir, const CKeyID& keyid)
+{
+    std::vector<CPlotFile> plots;
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it) {
+        CPlotFile plot;
+        if (!fs::is_regular_file(it->status()) || !ParsePlotFile(it->path(), plot))
+            continue;
+        if (plot.fPoc2 ? plot.plotID != keyid.GetPlotID() : plot.keyID != keyid)
+            continue;
+        // A plot still being written has holes in all its scoop columns.
+        if (fs::file_size(plot.path) != plot.nonces * POC_SCOOP_COUNT * POC_SCOOP_SIZE) {
+            LogPrintf("%s: skip incomplete plot file %s\n", __func__, plot.path.string());
+            continue;
+        }
+        plots.push_back(plot);
+    }
+    return plots;
+}
+
+CScoopColumn::CScoopColumn(const CPlotFile& plot, const uint32_t scoop, const size_t readSizeIn, const bool fMmap) :
+    nonces(plot.nonces), offset(scoop * plot.nonces * POC_SCOOP_SIZE), next(0), nBytesRead(0)
+{
+    // Whole scoops per read, at least one.
+    readSize = std::max<uint64_t>(readSizeIn / POC_SCOOP_SIZE, 1) * POC_SCOOP_SIZE;
+#ifdef WIN32
+    file = fsbridge::fopen(plot.path, "rb");
+#else
+    map = nullptr;
+    fd = open(plot.path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+    fileSize = st.st_size;
+    page = sysconf(_SC_PAGESIZE);
+    if (fMmap) {
+        // Map the column from the page it starts in.
+        mapOffset = offset % page;
+        mapLength = mapOffset + nonces * POC_SCOOP_SIZE;
+        void* addr = mmap(nullptr, mapLength, PROT_READ, MAP_SHARED, fd, offset - mapOffset);
+        if (addr != MAP_FAILED) {
+            map = static_cast<uint8_t*>(addr);
+            madvise(map, mapLength, MADV_SEQUENTIAL);
+            return;
+        }
+    }
+    // A block holds whole scoops on any device the plots are kept on, else fall back to the page.
+    blockSize = st.st_blksize > 0 && st.st_blksize % POC_SCOOP_SIZE == 0 ? st.st_blksize : page;
+    readSize = (readSize + blockSize - 1) / blockSize * blockSize;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, offset, nonces * POC_SCOOP_SIZE, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+}
+
+CScoopColumn::~CScoopColumn()
+{
+#ifdef WIN32
+    if (file)
+        fclose(file);
+#else
+    if (map)
+        munmap(map, mapLength);
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+bool CScoopColumn::IsNull() const
+{
+#ifdef WIN32
+    return file == nullptr;
+#else
+    return fd < 0;
+#endif
+}
+
+const uint8_t* CScoopColumn::Read(uint64_t& first, uint64_t& count)
+{
+    first = next;
+#ifdef WIN32
+    count = std::min(readSize / POC_SCOOP_SIZE, nonces - first);
+    buffer.resize(count * POC_SCOOP_SIZE);
+    if (_fseeki64(file, offset + first * POC_SCOOP_SIZE, SEEK_SET) != 0 || fread(buffer.data(), POC_SCOOP_SIZE, count, file) != count)
+        return nullptr;
+    nBytesRead += count * POC_SCOOP_SIZE;
+    next += count;
+    return buffer.data();
+#else
+    if (map) {
+        count = std::min(readSize / POC_SCOOP_SIZE, nonces - first);
+        next += count;
+        if (next < nonces) {
+            const uint64_t begin = mapOffset + next * POC_SCOOP_SIZE;
+            const uint64_t end = mapOffset + std::min(next + count, nonces) * POC_SCOOP_SIZE;
+            madvise(map + begin - begin % page, end - (begin - begin % page), MADV_WILLNEED);
+        }
+        nBytesRead += count * POC_SCOOP_SIZE;
+        return map + mapOffset + first * POC_SCOOP_SIZE;
+    }
+
+    // Reads start and end on blocks, and all but the first one on multiples of readSize, so a
+    // scan of the column is one sequential run of requests the size the device is best read at.
+    const uint64_t pos = offset + first * POC_SCOOP_SIZE;
+    const uint64_t end = std::min(offset + nonces * POC_SCOOP_SIZE, (pos / readSize + 1) * readSize);
+    const uint64_t readBegin = pos - pos % blockSize;
+    const uint64_t readEnd = std::min((end + blockSize - 1) / blockSize * blockSize, fileSize);
+    buffer.resize(readEnd - readBegin);
+    for (uint64_t done = 0; done < buffer.size();) {
+        const ssize_t ret = pread(fd, buffer.data() + done, buffer.size() - done, readBegin + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return nullptr;
+        done += ret;
+    }
+    nBytesRead += buffer.size();
+    count = (end - pos) / POC_SCOOP_SIZE;
+    next += count;
+#ifdef POSIX_FADV_WILLNEED
+    if (next < nonces) {
+        posix_fadvise(fd, end - end % blockSize, std::min<uint64_t>(readSize, (nonces - next) * POC_SCOOP_SIZE + blockSize), POSIX_FADV_WILLNEED);
+    }
+#endif
+    return buffer.data() + (pos - readBegin);
+#endif
+}
+
+CPlotMiner::CPlotMiner(const CKeyID& keyidIn, std::vector<CPlotFile> plotsIn, const size_t readSizeIn, const bool fMmapIn) :
+    keyid(keyidIn), plots(std::move(plotsIn)), readSize(readSizeIn), fMmap(fMmapIn), generation(0), nextPlot(plots.size()), fInterrupted(false)
+{
+    order.resize(plots.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    nonceRates.resize(plots.size(), 0.0);
+}
+
+void CPlotMiner::Start(int nThreads, const std::vector<int>& cpus)
+{
+    if (nThreads <= 0)
+        nThreads = std::min<int>(plots.size(), GetNumCores());
+    nThreads = std::max(nThreads, 1);
+
+    RegisterValidationInterface(this, "plotminer");
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    if (tip && !IsInitialBlockDownload())
+        NewRound(tip);
+
+    LogPrintf("Mining %u plot files with %d threads, %s reads of %u KiB\n", plots.size(), nThreads, fMmap ? "mmap" : "pread", readSize / 1024);
+    for (int i = 0; i < nThreads; i++) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        threads.emplace_back(&TraceThread<std::function<void()>>, "plotminer", [this, cpu] {
+            if (cpu >= 0) SetThreadAffinity(cpu);
+            ThreadMine();
+        });
+    }
+}
+
+void CPlotMiner::Interrupt()
+{
+    {
+        LOCK(cs);
+        fInterrupted = true;
+    }
+    ++generation;
+    cond.notify_all();
+}
+
+void CPlotMiner::Stop()
+{
+    UnregisterValidationInterface(this);
+    Interrupt();
+    for (auto& thread : threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threads.clear();
+}
+
+void CPlotMiner::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == nullptr)
+        return;
+    NewRound(pindexNew);
+}
+
+void CPlotMiner::NewRound(const CBlockIndex* pindexPrev)
+{
+    auto info = GetPoCTipInfo(pindexPrev, Params().GetConsensus().LVIP05Height);
+    {
+        LOCK(cs);
+        if (round.hashTip == info.hashTip)
+            return;
+        round = info;
+        nextPlot = 0;
+        ++generation;
+        // The files read fastest go first, so the best deadline the later ones are held to drops early.
+        // A file not scanned yet goes before all others, to learn its rate.
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) EXCLUSIVE_LOCKS_REQUIRED(cs) {
+            return (nonceRates[a] == 0.0 && nonceRates[b] != 0.0) || (nonceRates[b] != 0.0 && nonceRates[a] > nonceRates[b]);
+        });
+        roundRead = CPlotRound();
+        roundRead.height = info.height;
+        roundRead.nPlots = plots.size();
+        roundRead.nStartMicros = GetTimeMicros();
+    }
+    cond.notify_all();
+}
+
+void CPlotMiner::ThreadMine()
+{
+    while (true) {
+        PoCTipInfo info;
+        uint64_t gen;
+        size_t index;
+        const CPlotFile* plot;
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait(lock, [this] { return fInterrupted || nextPlot < plots.size(); });
+            if (fInterrupted)
+                return;
+            index = order[nextPlot++];
+            plot = &plots[index];
+            info = round;
+            gen = generation;
+        }
+        int64_t nStart = GetTimeMicros();
+        uint64_t nBytes = 0;
+        if (!ScanPlot(*plot, info, gen, nBytes))
+            continue;
+        const int64_t nTime = GetTimeMicros();
+        LogPrint(BCLog::BENCH, "    - Scan plot %s: %.2fms (%.1f MB/s)\n", plot->path.filename().string(), (nTime - nStart) * 0.001, nBytes / (double)std::max<int64_t>(nTime - nStart, 1));
+
+        LOCK(cs);
+        if (nBytes > 0)
+            nonceRates[index] = plot->nonces / (double)std::max<int64_t>(nTime - nStart, 1);
+        if (generation != gen)
+            continue;
+        roundRead.nBytes += nBytes;
+        if (--roundRead.nPlots == 0) {
+            roundRead.nElapsedMicros = std::max<int64_t>(nTime - roundRead.nStartMicros, 1);
+            lastRoundRead = roundRead;
+            LogPrint(BCLog::BENCH, "- Round at height %d: %.2fMB of %u plot files in %.2fms (%.1f MB/s)\n", roundRead.height,
+                roundRead.nBytes * 0.000001, plots.size(), roundRead.nElapsedMicros * 0.001, roundRead.nBytes / (double)roundRead.nElapsedMicros);
+        }
+    }
+}
+
+CPlotRound CPlotMiner::GetLastRound() const
+{
+    LOCK(cs);
+    return lastRoundRead;
+}
+
+bool CPlotMiner::ScanPlot(const CPlotFile& plot, const PoCTipInfo& info, const uint64_t gen, uint64_t& nBytes)
+{
+    // Classic poc2 plots are only mined below LVIP05, poc2.x plots from then on.
+    if (plot.fPoc2 != info.fPoc2)
+        return true;
+    CScoopColumn column(plot, info.scoop, readSize, fMmap);
+    if (column.IsNull()) {
+        LogPrintf("%s: cannot open plot file %s\n", __func__, plot.path.string());
+        return true;
+    }
+
+    std::vector<uint64_t> deadlines;
+    uint64_t bestDeadline = std::numeric_limits<uint64_t>::max();
+    while (!column.IsDone()) {
+        if (generation != gen)
+            return false;
+        // Only a deadline below the best one of the height can win: ours, one submitted by a pool or
+        // over RPC, or that of a competing block already held for the tip.
+        uint64_t bound = std::min(bestDeadline, blockAssember.GetBestDeadline(info.height));
+        uint64_t competing;
+        int64_t nAcceptTime;
+        if (g_blockCache && g_blockCache->GetBestChild(info.hashTip, competing, nAcceptTime)) {
+            // The competing block is due, whatever the rest of the file holds would be broadcast after it.
+            if (GetSystemTimeInSeconds() >= nAcceptTime) {
+                LogPrint(BCLog::FORGE, "%s: stop scanning %s, a competing block is due\n", __func__, plot.path.filename().string());
+                return false;
+            }
+            bound = std::min(bound, competing);
+        }
+        uint64_t first, count;
+        const uint8_t* scoops = column.Read(first, count);
+        nBytes = column.BytesRead();
+        if (!scoops) {
+            LogPrintf("%s: cannot read plot file %s\n", __func__, plot.path.string());
+            return true;
+        }
+        deadlines.resize(count);
+        CalcScoopDeadlines(info.genSig, scoops, deadlines.data(), count);
+
+        // Submit a better deadline as soon as it is found, the block assember keeps the best one.
+        uint64_t best = 0;
+        for (uint64_t i = 1; i < count; i++) {
+            if (deadlines[i] < deadlines[best])
+                best = i;
+        }
+        // The block assember would hash a nonce that cannot win again only to reject it.
+        if (deadlines[best] < bound) {
+            bestDeadline = deadlines[best];
+            Submit(info, plot.startNonce + first + best, bestDeadline);
+        }
+    }
+    return true;
+}
+
+void CPlotMiner::Submit(const PoCTipInfo& info, const uint64_t nonce, const uint64_t deadline)
+{
+    if (deadline / info.baseTarget > Params().TargetDeadline())
+        return;
+    // The assember verifies the deadline again from the nonce, so a damaged plot cannot forge a block.
+    // Firestones are taken from the key set with setfsowner, the miner holds no wallet key.
+    if (blockAssember.UpdateDeadline(info.height, keyid, nonce, deadline)) {
+        LogPrintf("%s: height %d, nonce %u, deadline %u\n", __func__, info.height, nonce, deadline / info.baseTarget);
+    }
+}
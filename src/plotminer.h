@@ -0,0 +1,184 @@
+#ifndef LAVA_PLOTMINER_H
+#define LAVA_PLOTMINER_H
+
+#include <fs.h>
+#include <poc.h>
+#include <script/standard.h>
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/** Default for -minerthreads, 0 means one thread per plot file, at most one per core. */
+static const int DEFAULT_MINER_THREADS = 0;
+/** Default for -plotreadsize, in KiB: the size of one read of a scoop column, its scoops are hashed while the next read is ahead. */
+static const unsigned int DEFAULT_PLOT_READ_SIZE = 4096;
+/** Default for -plotmmap */
+static const bool DEFAULT_PLOT_MMAP = false;
+
+/**
+ * A plot file named <id>_<start nonce>_<nonces>, laid out scoop by scoop in the PoC2 order.
+ * The id is the numeric plot id of a classic poc2 plot or the hex key id of a poc2.x plot.
+ */
+struct CPlotFile
+{
+    fs::path path;
+    bool fPoc2;
+    uint64_t plotID;
+    CKeyID keyID;
+    uint64_t startNonce;
+    uint64_t nonces;
+
+    CPlotFile() : fPoc2(false), plotID(0), startNonce(0), nonces(0) {}
+};
+
+/**
+ * Parse the name of a plot file.
+ * @param[in]   path  the plot file.
+ * @param[out]  plot  the plot described by the file name.
+ * @return      false if the name is not one of a plot file.
+ */
+bool ParsePlotFile(const fs::path& path, CPlotFile& plot);
+
+/** List the complete plot files of keyid in dir, of both plot formats. */
+std::vector<CPlotFile> FindPlotFiles(const fs::path& dir, const CKeyID& keyid);
+
+/**
+ * The scoop column of a plot file for one round, the scoop of every nonce back to back, read from
+ * front to back. It is read with pread in requests of readSize bytes, aligned to the blocks of the
+ * device, and the kernel is told to read the next request ahead while the current one is hashed.
+ * With fMmap the column is memory mapped instead. Where neither is available it is read with stdio.
+ */
+class CScoopColumn
+{
+public:
+    CScoopColumn(const CPlotFile& plot, const uint32_t scoop, const size_t readSize, const bool fMmap);
+    ~CScoopColumn();
+
+    CScoopColumn(const CScoopColumn&) = delete;
+    CScoopColumn& operator=(const CScoopColumn&) = delete;
+
+    bool IsNull() const;
+
+    /** Whether the whole column was read. */
+    bool IsDone() const { return next == nonces; }
+
+    /**
+     * Read the next scoops of the column.
+     * @param[out]  first  the index in the plot file of the first nonce read.
+     * @param[out]  count  the number of nonces read.
+     * @return      the scoops of the nonces, or nullptr on a read error.
+     */
+    const uint8_t* Read(uint64_t& first, uint64_t& count);
+
+    /** The bytes read from the plot file so far, with the ones the aligned reads take along. */
+    uint64_t BytesRead() const { return nBytesRead; }
+
+private:
+    const uint64_t nonces;
+    const uint64_t offset;         //!< position of the column in the file
+    uint64_t readSize;             //!< bytes per read, a multiple of the block size
+    uint64_t next;                 //!< the nonce the next read starts at
+    uint64_t nBytesRead;
+    std::vector<uint8_t> buffer;
+#ifdef WIN32
+    FILE* file;
+#else
+    int fd;
+    uint64_t blockSize;            //!< the block size of the device, reads start and end on it
+    uint64_t fileSize;
+    uint8_t* map;
+    uint64_t page;
+    uint64_t mapOffset;            //!< position of the column in the map
+    uint64_t mapLength;
+#endif
+};
+
+/** Reading the plot files for one tip: how many bytes were read and how long it took. */
+struct CPlotRound
+{
+    int height;
+    size_t nPlots;                 //!< plot files of the round still being scanned
+    uint64_t nBytes;
+    int64_t nStartMicros;
+    int64_t nElapsedMicros;        //!< 0 until the last plot file of the round was scanned
+
+    CPlotRound() : height(0), nPlots(0), nBytes(0), nStartMicros(0), nElapsedMicros(0) {}
+};
+
+/**
+ * Mine the plot files of one address: on every new tip the active scoop of each file is read
+ * and its deadlines are computed with the multi-lane Shabal engine, across a pool of threads.
+ * The best deadlines are handed to the block assember, just like submitnonce does.
+ */
+class CPlotMiner : public CValidationInterface
+{
+public:
+    CPlotMiner(const CKeyID& keyid, std::vector<CPlotFile> plots, const size_t readSize, const bool fMmap);
+
+    ~CPlotMiner() = default;
+
+    /** Start nThreads mining threads, pinned to cpus in turn if any, and start mining on top of the current tip. */
+    void Start(int nThreads, const std::vector<int>& cpus = {});
+
+    /** Make the mining threads return, a scan in progress stops after its current read. */
+    void Interrupt();
+
+    /** Interrupt and join the mining threads. */
+    void Stop();
+
+    size_t GetPlotCount() const { return plots.size(); }
+
+    bool IsMmap() const { return fMmap; }
+
+    /** The last round all plot files were scanned in, a null round if none was yet. */
+    CPlotRound GetLastRound() const;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+private:
+    /** Start a round of all plot files on top of pindexPrev. */
+    void NewRound(const CBlockIndex* pindexPrev);
+
+    void ThreadMine();
+
+    /**
+     * Read the active scoop of a plot file and submit its best deadline.
+     * @param[out]  nBytes  the bytes read from the file.
+     * @return      false if the round was replaced before the whole file was read.
+     */
+    bool ScanPlot(const CPlotFile& plot, const PoCTipInfo& info, const uint64_t generation, uint64_t& nBytes);
+
+    /** Hand a deadline over to the block assember if it is within the target deadline. */
+    void Submit(const PoCTipInfo& info, const uint64_t nonce, const uint64_t deadline);
+
+    const CKeyID keyid;
+    const std::vector<CPlotFile> plots;
+    const size_t readSize;
+    const bool fMmap;
+    std::vector<std::thread> threads;
+
+    mutable Mutex cs;
+    std::condition_variable cond;
+    PoCTipInfo round GUARDED_BY(cs);
+    CPlotRound roundRead GUARDED_BY(cs);
+    CPlotRound lastRoundRead GUARDED_BY(cs);
+    /** Bumped on every new round, a scan of an older round stops early. */
+    std::atomic<uint64_t> generation;
+    /** Next plot file of the round to be scanned, an index into order. */
+    size_t nextPlot GUARDED_BY(cs);
+    /** The indexes of the plot files in the order they are scanned in a round. */
+    std::vector<size_t> order GUARDED_BY(cs);
+    /** The nonces per microsecond the last complete scan of each plot file read, 0 until it was scanned. */
+    std::vector<double> nonceRates GUARDED_BY(cs);
+    bool fInterrupted GUARDED_BY(cs);
+};
+
+extern std::unique_ptr<CPlotMiner> g_plotminer;
+
+#endif // LAVA_PLOTMINER_H
@@ -1,33 +1,21 @@
 #include <poc.h>
 #include <chain.h>
-
+#include <crypto/shabal256.h>
+#include <hash.h>
+#include <metrics.h>
+#include <support/allocators/hugepage.h>
+#include <util/trace.h>
+#include <sync.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <map>
 #include <vector>
 
 using namespace std;
 
-#if defined(WIN32) && !defined(WITHOUT_ASM)
-#include <immintrin.h>
-#include <shabal/shabal.h>
-#define CONTEXT               shabal_context
-#define INIT(sc)              shabal_init(sc, 256)
-#define SHABAL(sc, data, len) shabal(sc, data, len)
-#define CLOSE(sc, dst)        shabal_close(sc, 0, 0, dst)
-#define MMZEROUPPER()         _mm256_zeroupper()
-#else
-#ifdef __cplusplus
-extern "C" {
-#endif
-#include <crypto/sph_shabal.h>
-#ifdef __cplusplus
-}
-#endif
-#define CONTEXT               sph_shabal256_context
-#define INIT(sc)              sph_shabal256_init(sc)
-#define SHABAL(sc, data, len) sph_shabal256(sc, data, len)
-#define CLOSE(sc, dst)        sph_shabal256_close(sc, dst)
-#define MMZEROUPPER()
-#endif
-
 #define HASH_SIZE 32
 #define HASH_CAP 4096
 #define SCOOP_SIZE 64
@@ -41,189 +29,454 @@ const uint64_t MAX_BASE_TARGET = 18325193796L;
 
 uint256 CalcGenerationSignaturePoc2(const uint256& lastSig, uint64_t lastPlotID)
 {
-    vector<unsigned char> signature(lastSig.size() + sizeof(lastPlotID));
+    unsigned char signature[32 + sizeof(lastPlotID)];
     memcpy(&signature[0], lastSig.begin(), lastSig.size());
     unsigned char* vx = (unsigned char*)&lastPlotID;
-    for (auto i = 0; i < sizeof(lastPlotID); i++) {
+    for (size_t i = 0; i < sizeof(lastPlotID); i++) {
         signature[lastSig.size() + i] = *(vx + 7 - i);
     }
-    CONTEXT ctx;
-    INIT(&ctx);
-    SHABAL(&ctx, &signature[0], signature.size());
-    vector<unsigned char> res(32);
-    CLOSE(&ctx, &res[0]);
-    return uint256(res);
+    uint256 res;
+    Shabal256(res.begin(), &signature[0], sizeof(signature));
+    return res;
 }
 
 uint256 CalcGenerationSignature(const uint256& lastSig, const uint160& publicKeyID)
 {
-    vector<unsigned char> signature(lastSig.size() + sizeof(publicKeyID));
+    unsigned char signature[32 + sizeof(publicKeyID)];
     memcpy(&signature[0], lastSig.begin(), lastSig.size());
     unsigned char* vx = (unsigned char*)&publicKeyID;
-    for (auto i = 0; i < sizeof(publicKeyID); i++) {
+    for (size_t i = 0; i < sizeof(publicKeyID); i++) {
         signature[lastSig.size() + i] = *(vx + 19 - i);
     }
-    CONTEXT ctx;
-    INIT(&ctx);
-    SHABAL(&ctx, &signature[0], signature.size());
-    vector<unsigned char> res(32);
-    CLOSE(&ctx, &res[0]);
-    return uint256(res);
+    uint256 res;
+    Shabal256(res.begin(), &signature[0], sizeof(signature));
+    return res;
+}
+
+/** Generate `lanes` nonces side by side with the multi-lane Shabal engine.
+ *  Each genData[l] holds PLOT_SIZE + seedLength bytes with the seed already
+ *  stored at offset PLOT_SIZE. On return the first PLOT_SIZE bytes hold the
+ *  unshuffled nonce before its XOR with final[l]: hash h sits at h * HASH_SIZE
+ *  for even h and at PLOT_SIZE - h * HASH_SIZE for odd h (the PoC2 mirroring).
+ *  Callers only XOR the hashes they read.
+ */
+static void genNonceLanes(uint8_t* const* genData, const size_t seedLength, const size_t lanes, uint8_t (*final)[HASH_SIZE])
+{
+    assert(lanes <= SHABAL256_MAX_LANES);
+    unsigned char* out[SHABAL256_MAX_LANES];
+    const unsigned char* in[SHABAL256_MAX_LANES];
+
+    for (auto i = PLOT_SIZE; i > 0; i -= HASH_SIZE) {
+        size_t len = PLOT_SIZE + seedLength - i;
+        if (len > HASH_CAP) len = HASH_CAP;
+        for (size_t l = 0; l < lanes; l++) {
+            in[l] = &genData[l][i];
+            out[l] = &genData[l][i - HASH_SIZE];
+        }
+        Shabal256Multi(out, in, len, lanes);
+    }
+
+    for (size_t l = 0; l < lanes; l++) {
+        in[l] = &genData[l][0];
+        out[l] = final[l];
+    }
+    Shabal256Multi(out, in, PLOT_SIZE + seedLength, lanes);
 }
 
-vector<uint8_t> genNonceChunkPoc2(const uint64_t plotID, const uint64_t nonce)
+/** Put the PoC2 seed (plotID, nonce) at `seed`. */
+static void putSeedPoc2(uint8_t* seed, const uint64_t plotID, const uint64_t nonce)
 {
-    CONTEXT ctx;
-    MMZEROUPPER();
-    vector<uint8_t> genData(16 + PLOT_SIZE);
     //put plotID
     uint8_t* xv = (uint8_t*)&plotID;
     for (size_t i = 0; i < 8; i++) {
-        genData[PLOT_SIZE + i] = xv[7 - i];
+        seed[i] = xv[7 - i];
     }
     //put nonce
     xv = (uint8_t*)&nonce;
     for (size_t i = 8; i < 16; i++) {
-        genData[PLOT_SIZE + i] = xv[15 - i];
-    }
-    for (auto i = PLOT_SIZE; i > 0; i -= HASH_SIZE) {
-        INIT(&ctx);
-        auto len = PLOT_SIZE + 16 - i;
-        if (len > HASH_CAP) len = HASH_CAP;
-        SHABAL(&ctx, &genData[i], len);
-        CLOSE(&ctx, &genData[i - HASH_SIZE]);
-    }
-    INIT(&ctx);
-    SHABAL(&ctx, &genData[0], 16 + PLOT_SIZE);
-    vector<uint8_t> final(32);
-    CLOSE(&ctx, &final[0]);
-    // XOR with final
-    for (size_t i = 0; i < PLOT_SIZE; i++) {
-        genData[i] ^= (final[i % HASH_SIZE]);
-    }
-
-    vector<uint8_t> data(PLOT_SIZE);
-    for (size_t i = 0; i < PLOT_SIZE; i += HASH_SIZE) {
-        if ((i / HASH_SIZE) % 2 == 0) {
-            memmove(&data[i], &genData[i], HASH_SIZE);
-        } else {
-            memmove(&data[i], &genData[PLOT_SIZE - i], HASH_SIZE);
-        }
+        seed[i] = xv[15 - i];
     }
-    return std::move(data);
 }
 
-vector<uint8_t> genNonceChunk(const uint160& publicKeyID, const uint64_t nonce)
+/** Put the PoC2.x seed (nonce, publicKeyID, LAVA label) at `seed`. */
+static void putSeed(uint8_t* seed, const uint160& publicKeyID, const uint64_t nonce)
 {
-    CONTEXT ctx;
-    MMZEROUPPER();
-    vector<uint8_t> genData(SEED_LENGTH + PLOT_SIZE);
     //put nonce
     uint8_t* xv = (uint8_t*)&nonce;
     for (size_t i = 0; i < 8; i++) {
-        genData[PLOT_SIZE + i] = xv[7 - i];
+        seed[i] = xv[7 - i];
     }
-    //put nonce
+    //put publicKeyID
     xv = (uint8_t*)&publicKeyID;
     for (size_t i = 0; i < 20; i++) {
-        genData[PLOT_SIZE + 8 + i] = xv[19 - i];
+        seed[8 + i] = xv[19 - i];
     }
     //put LAVA label
     for (size_t i = 0; i < 3; i++) {
-        genData[PLOT_SIZE + 28 + i] = SEED_MAGIC[i];
+        seed[28 + i] = SEED_MAGIC[i];
     }
+}
 
-    for (auto i = PLOT_SIZE; i > 0; i -= HASH_SIZE) {
-        INIT(&ctx);
-        auto len = PLOT_SIZE + SEED_LENGTH - i;
-        if (len > HASH_CAP) len = HASH_CAP;
-        SHABAL(&ctx, &genData[i], len);
-        CLOSE(&ctx, &genData[i - HASH_SIZE]);
-    }
-    INIT(&ctx);
-    SHABAL(&ctx, &genData[0], SEED_LENGTH + PLOT_SIZE);
-    vector<uint8_t> final(32);
-    CLOSE(&ctx, &final[0]);
-    // XOR with final
-    for (size_t i = 0; i < PLOT_SIZE; i++) {
-        genData[i] ^= (final[i % HASH_SIZE]);
-    }
-
-    vector<uint8_t> data(PLOT_SIZE);
-    for (size_t i = 0; i < PLOT_SIZE; i += HASH_SIZE) {
-        if ((i / HASH_SIZE) % 2 == 0) {
-            memmove(&data[i], &genData[i], HASH_SIZE);
-        } else {
-            memmove(&data[i], &genData[PLOT_SIZE - i], HASH_SIZE);
-        }
+/** Scratch space for generating `lanes` nonces side by side. It is kept per
+ *  thread and only ever grows, so the deadline paths stop allocating once warm.
+ *  Being first written by its own thread, it sits on that thread's NUMA node.
+ */
+static uint8_t* nonceScratch(const size_t lanes)
+{
+    static thread_local vector<uint8_t, LargePageAllocator<uint8_t>> scratch;
+    if (scratch.size() < lanes * (PLOT_SIZE + SEED_LENGTH)) {
+        scratch.resize(lanes * (PLOT_SIZE + SEED_LENGTH));
     }
-    return std::move(data);
+    return scratch.data();
 }
 
-uint64_t CalcDeadlinePoc2(const uint256& genSig, const uint64_t height, const uint64_t plotID, const uint64_t nonce)
+/** Select the scoop of every nonce that is checked at `height`. */
+static uint32_t calcScoop(const uint256& genSig, const uint64_t height)
 {
-    vector<uint8_t> scoopGen(40);
+    uint8_t scoopGen[40];
     memcpy(&scoopGen[0], genSig.begin(), genSig.size());
     const uint8_t* mov = (uint8_t*)&height;
-    scoopGen[32] = mov[7];
-    scoopGen[33] = mov[6];
-    scoopGen[34] = mov[5];
-    scoopGen[35] = mov[4];
-    scoopGen[36] = mov[3];
-    scoopGen[37] = mov[2];
-    scoopGen[38] = mov[1];
-    scoopGen[39] = mov[0];
-    CONTEXT ctx;
-    MMZEROUPPER();
-    INIT(&ctx);
-    SHABAL(&ctx, &scoopGen[0], 40);
-    char genHash[32];
-    CLOSE(&ctx, genHash);
-    uint32_t scoop = (((unsigned char)genHash[31]) + 256 * (unsigned char)genHash[30]) % 4096;
-
-    auto chunk = genNonceChunkPoc2(plotID, nonce);
-    vector<uint8_t> sig(32 + 64);
-    memcpy(&sig[0], genSig.begin(), genSig.size());
-    memcpy(&sig[32], &chunk[scoop * 64], sizeof(uint8_t) * 64);
-    INIT(&ctx);
-    SHABAL(&ctx, &sig[0], 64 + 32);
-    vector<uint8_t> res(32);
-    CLOSE(&ctx, &res[0]);
-    uint64_t* wertung = (uint64_t*)&res[0];
-    return *wertung;
+    for (size_t i = 0; i < 8; i++) {
+        scoopGen[32 + i] = mov[7 - i];
+    }
+    unsigned char genHash[32];
+    Shabal256(genHash, &scoopGen[0], 40);
+    return ((genHash[31]) + 256 * genHash[30]) % 4096;
+}
+
+/** Finish `lanes` nonces whose seeds are already stored in genData: generate
+ *  them, then hash the selected scoop of each lane with its generation signature.
+ */
+static void calcDeadlineLanes(uint8_t* const* genData, const size_t seedLength, const uint256* const* genSigs, const uint32_t* scoops, uint64_t* deadlines, const size_t lanes)
+{
+    uint8_t final[SHABAL256_MAX_LANES][HASH_SIZE];
+    genNonceLanes(genData, seedLength, lanes, final);
+
+    // The scoop is hash 2*scoop followed by its mirrored partner 2*scoop+1,
+    // read straight from the unshuffled nonce.
+    unsigned char sig[SHABAL256_MAX_LANES][32 + 64];
+    unsigned char res[SHABAL256_MAX_LANES][32];
+    unsigned char* out[SHABAL256_MAX_LANES];
+    const unsigned char* in[SHABAL256_MAX_LANES];
+    for (size_t l = 0; l < lanes; l++) {
+        memcpy(&sig[l][0], genSigs[l]->begin(), genSigs[l]->size());
+        memcpy(&sig[l][32], genData[l] + scoops[l] * SCOOP_SIZE, HASH_SIZE);
+        memcpy(&sig[l][32 + HASH_SIZE], genData[l] + PLOT_SIZE - (scoops[l] * SCOOP_SIZE + HASH_SIZE), HASH_SIZE);
+        // XOR with final
+        for (size_t i = 0; i < 64; i++) {
+            sig[l][32 + i] ^= final[l][i % HASH_SIZE];
+        }
+        in[l] = sig[l];
+        out[l] = res[l];
+    }
+    Shabal256Multi(out, in, 32 + 64, lanes);
+    for (size_t l = 0; l < lanes; l++) {
+        memcpy(&deadlines[l], res[l], sizeof(uint64_t));
+    }
+}
+
+static uint64_t calcDeadlinePoc2(const uint256& genSig, const uint32_t scoop, const uint64_t plotID, const uint64_t nonce)
+{
+    uint8_t* genData = nonceScratch(1);
+    putSeedPoc2(genData + PLOT_SIZE, plotID, nonce);
+    const uint256* genSigs = &genSig;
+    uint64_t deadline;
+    calcDeadlineLanes(&genData, 16, &genSigs, &scoop, &deadline, 1);
+    return deadline;
+}
+
+static uint64_t calcDeadline(const uint256& genSig, const uint32_t scoop, const uint160& publicKeyID, const uint64_t nonce)
+{
+    uint8_t* genData = nonceScratch(1);
+    putSeed(genData + PLOT_SIZE, publicKeyID, nonce);
+    const uint256* genSigs = &genSig;
+    uint64_t deadline;
+    calcDeadlineLanes(&genData, SEED_LENGTH, &genSigs, &scoop, &deadline, 1);
+    return deadline;
+}
+
+static Mutex cs_nonceTables;
+static std::atomic<size_t> nNonceTableSize{0};
+/** The scoops of the nonces of SetNonceTableSize by key, laid out by GenerateNonceScoops, and their keys oldest first. */
+static std::map<uint160, std::shared_ptr<const vector<uint8_t>>> nonceTables GUARDED_BY(cs_nonceTables);
+static std::deque<uint160> nonceTableOrder GUARDED_BY(cs_nonceTables);
+
+void SetNonceTableSize(const size_t nNonces)
+{
+    LOCK(cs_nonceTables);
+    nonceTables.clear();
+    nonceTableOrder.clear();
+    nNonceTableSize = nNonces;
+}
+
+/** Compute the deadline of a nonce from the table of its key, generated on first use, if the nonce is in it. */
+static bool lookupNonceTable(const uint256& genSig, const uint64_t height, const uint160& publicKeyID, const uint64_t nonce, uint64_t& deadline)
+{
+    const size_t nNonces = nNonceTableSize.load(std::memory_order_relaxed);
+    if (nonce >= nNonces)
+        return false;
+    std::shared_ptr<const vector<uint8_t>> table;
+    {
+        LOCK(cs_nonceTables);
+        auto it = nonceTables.find(publicKeyID);
+        if (it != nonceTables.end())
+            table = it->second;
+    }
+    if (!table) {
+        auto scoops = std::make_shared<vector<uint8_t>>(POC_SCOOP_COUNT * nNonces * SCOOP_SIZE);
+        GenerateNonceScoops(publicKeyID, 0, nNonces, scoops->data(), nNonces * SCOOP_SIZE);
+        table = scoops;
+        LOCK(cs_nonceTables);
+        if (nonceTables.emplace(publicKeyID, table).second) {
+            nonceTableOrder.push_back(publicKeyID);
+            if (nonceTableOrder.size() > MAX_NONCE_TABLES) {
+                nonceTables.erase(nonceTableOrder.front());
+                nonceTableOrder.pop_front();
+            }
+        }
+    }
+    // The table may predate a change of size.
+    const size_t nTableNonces = table->size() / (POC_SCOOP_COUNT * SCOOP_SIZE);
+    if (nonce >= nTableNonces)
+        return false;
+    CalcScoopDeadlines(genSig, table->data() + (calcScoop(genSig, height) * nTableNonces + nonce) * SCOOP_SIZE, &deadline, 1);
+    return true;
+}
+
+uint64_t CalcDeadlinePoc2(const uint256& genSig, const uint64_t height, const uint64_t plotID, const uint64_t nonce)
+{
+    return calcDeadlinePoc2(genSig, calcScoop(genSig, height), plotID, nonce);
 }
 
 uint64_t CalcDeadline(const uint256& genSig, const uint64_t height, const uint160& publicKeyID, const uint64_t nonce)
 {
-    vector<uint8_t> scoopGen(40);
-    memcpy(&scoopGen[0], genSig.begin(), genSig.size());
-    const uint8_t* mov = (uint8_t*)&height;
-    scoopGen[32] = mov[7];
-    scoopGen[33] = mov[6];
-    scoopGen[34] = mov[5];
-    scoopGen[35] = mov[4];
-    scoopGen[36] = mov[3];
-    scoopGen[37] = mov[2];
-    scoopGen[38] = mov[1];
-    scoopGen[39] = mov[0];
-    CONTEXT ctx;
-    MMZEROUPPER();
-    INIT(&ctx);
-    SHABAL(&ctx, &scoopGen[0], 40);
-    char genHash[32];
-    CLOSE(&ctx, genHash);
-    uint32_t scoop = (((unsigned char)genHash[31]) + 256 * (unsigned char)genHash[30]) % 4096;
-
-    auto chunk = genNonceChunk(publicKeyID, nonce);
-    vector<uint8_t> sig(32 + 64);
-    memcpy(&sig[0], genSig.begin(), genSig.size());
-    memcpy(&sig[32], &chunk[scoop * 64], sizeof(uint8_t) * 64);
-    INIT(&ctx);
-    SHABAL(&ctx, &sig[0], 64 + 32);
-    vector<uint8_t> res(32);
-    CLOSE(&ctx, &res[0]);
-    uint64_t* wertung = (uint64_t*)&res[0];
-    return *wertung;
+    uint64_t deadline;
+    if (lookupNonceTable(genSig, height, publicKeyID, nonce, deadline))
+        return deadline;
+    return calcDeadline(genSig, calcScoop(genSig, height), publicKeyID, nonce);
+}
+
+static Mutex cs_tipInfo;
+static PoCTipInfo tipInfo GUARDED_BY(cs_tipInfo);
+
+PoCTipInfo GetPoCTipInfo(const CBlockIndex* pindexPrev, const int nLVIP05Height)
+{
+    const uint256 hashTip = pindexPrev->GetBlockHash();
+    {
+        LOCK(cs_tipInfo);
+        if (tipInfo.hashTip == hashTip) return tipInfo;
+    }
+
+    PoCTipInfo info;
+    info.hashTip = hashTip;
+    info.height = pindexPrev->nHeight + 1;
+    info.fPoc2 = info.height < nLVIP05Height;
+    if (info.fPoc2) {
+        info.genSig = CalcGenerationSignaturePoc2(pindexPrev->genSign, pindexPrev->nPlotID);
+    } else {
+        info.genSig = CalcGenerationSignature(pindexPrev->genSign, pindexPrev->nPublicKeyID);
+    }
+    info.scoop = calcScoop(info.genSig, info.height);
+    info.baseTarget = pindexPrev->nBaseTarget;
+
+    LOCK(cs_tipInfo);
+    tipInfo = info;
+    return info;
+}
+
+uint64_t CalcDeadline(const PoCTipInfo& info, const uint160& publicKeyID, const uint64_t plotID, const uint64_t nonce)
+{
+    static CMetricHistogram& metric = GetMetrics().Histogram("poc_deadline", "Time to calculate the deadline of a nonce");
+    CMetricTimer timer(metric);
+    TRACE3(poc, calc_deadline_enter, plotID, nonce, info.fPoc2);
+    const uint64_t deadline = info.fPoc2 ? calcDeadlinePoc2(info.genSig, info.scoop, plotID, nonce)
+                                         : calcDeadline(info.genSig, info.scoop, publicKeyID, nonce);
+    TRACE3(poc, calc_deadline_exit, plotID, nonce, deadline);
+    return deadline;
+}
+
+void CalcDeadlines(const uint256& genSig, const uint64_t height, const uint160& publicKeyID, const uint64_t* nonces, uint64_t* deadlines, const size_t count)
+{
+    const uint32_t scoop = calcScoop(genSig, height);
+    const size_t width = std::min<size_t>(std::max<size_t>(Shabal256Lanes(), 1), count);
+    uint8_t* scratch = nonceScratch(width);
+    uint8_t* genData[SHABAL256_MAX_LANES];
+    const uint256* genSigs[SHABAL256_MAX_LANES];
+    uint32_t scoops[SHABAL256_MAX_LANES];
+    for (size_t l = 0; l < width; l++) {
+        genData[l] = &scratch[l * (PLOT_SIZE + SEED_LENGTH)];
+        genSigs[l] = &genSig;
+        scoops[l] = scoop;
+    }
+
+    for (size_t first = 0; first < count; first += width) {
+        const size_t lanes = std::min(width, count - first);
+        for (size_t l = 0; l < lanes; l++) {
+            putSeed(genData[l] + PLOT_SIZE, publicKeyID, nonces[first + l]);
+        }
+        calcDeadlineLanes(genData, SEED_LENGTH, genSigs, scoops, &deadlines[first], lanes);
+    }
+}
+
+void GenerateNonceScoops(const uint160& publicKeyID, const uint64_t startNonce, const size_t count, uint8_t* scoops, const size_t columnStride)
+{
+    const size_t width = std::min<size_t>(std::max<size_t>(Shabal256Lanes(), 1), count);
+    uint8_t* scratch = nonceScratch(width);
+    uint8_t* genData[SHABAL256_MAX_LANES];
+    for (size_t l = 0; l < width; l++) {
+        genData[l] = &scratch[l * (PLOT_SIZE + SEED_LENGTH)];
+    }
+
+    uint8_t final[SHABAL256_MAX_LANES][HASH_SIZE];
+    for (size_t first = 0; first < count; first += width) {
+        const size_t lanes = std::min(width, count - first);
+        for (size_t l = 0; l < lanes; l++) {
+            putSeed(genData[l] + PLOT_SIZE, publicKeyID, startNonce + first + l);
+        }
+        genNonceLanes(genData, SEED_LENGTH, lanes, final);
+        // Scoop s is hash 2*s followed by its mirrored partner, as calcDeadlineLanes reads it.
+        for (size_t l = 0; l < lanes; l++) {
+            for (size_t s = 0; s < POC_SCOOP_COUNT; s++) {
+                uint8_t* out = scoops + s * columnStride + (first + l) * SCOOP_SIZE;
+                const uint8_t* lo = genData[l] + s * SCOOP_SIZE;
+                const uint8_t* hi = genData[l] + PLOT_SIZE - (s * SCOOP_SIZE + HASH_SIZE);
+                for (size_t i = 0; i < HASH_SIZE; i++) {
+                    out[i] = lo[i] ^ final[l][i];
+                    out[HASH_SIZE + i] = hi[i] ^ final[l][i];
+                }
+            }
+        }
+    }
+}
+
+void CalcScoopDeadlines(const uint256& genSig, const uint8_t* scoops, uint64_t* deadlines, const size_t count)
+{
+    const size_t width = std::max<size_t>(Shabal256Lanes(), 1);
+    unsigned char sig[SHABAL256_MAX_LANES][32 + SCOOP_SIZE];
+    unsigned char res[SHABAL256_MAX_LANES][32];
+    unsigned char* out[SHABAL256_MAX_LANES];
+    const unsigned char* in[SHABAL256_MAX_LANES];
+    for (size_t l = 0; l < width; l++) {
+        memcpy(&sig[l][0], genSig.begin(), genSig.size());
+        in[l] = sig[l];
+        out[l] = res[l];
+    }
+
+    for (size_t first = 0; first < count; first += width) {
+        const size_t lanes = std::min(width, count - first);
+        for (size_t l = 0; l < lanes; l++) {
+            memcpy(&sig[l][32], scoops + (first + l) * SCOOP_SIZE, SCOOP_SIZE);
+        }
+        Shabal256Multi(out, in, 32 + SCOOP_SIZE, lanes);
+        for (size_t l = 0; l < lanes; l++) {
+            memcpy(&deadlines[first + l], res[l], sizeof(uint64_t));
+        }
+    }
+}
+
+static Mutex cs_preverified;
+/** The deadlines of AddPreverifiedProof by proofKey, and their keys oldest first. */
+static std::map<uint256, uint64_t> preverified GUARDED_BY(cs_preverified);
+static std::deque<uint256> preverifiedOrder GUARDED_BY(cs_preverified);
+
+static uint256 proofKey(const uint256& genSig, const uint64_t height, const bool fPoc2, const uint64_t plotID, const uint160& publicKeyID, const uint64_t nonce)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << genSig << height << fPoc2 << nonce;
+    if (fPoc2)
+        ss << plotID;
+    else
+        ss << publicKeyID;
+    return ss.GetHash();
+}
+
+void AddPreverifiedProof(const PoCItem& item)
+{
+    const uint256 key = proofKey(item.genSig, item.height, item.fPoc2, item.plotID, item.publicKeyID, item.nonce);
+    LOCK(cs_preverified);
+    if (!preverified.emplace(key, item.deadline).second)
+        return;
+    preverifiedOrder.push_back(key);
+    if (preverifiedOrder.size() > MAX_PREVERIFIED_PROOFS) {
+        preverified.erase(preverifiedOrder.front());
+        preverifiedOrder.pop_front();
+    }
+}
+
+static bool lookupPreverified(const uint256& key, uint64_t& deadline)
+{
+    LOCK(cs_preverified);
+    auto it = preverified.find(key);
+    if (it == preverified.end())
+        return false;
+    deadline = it->second;
+    return true;
+}
+
+bool CheckProofOfCapacityBatch(Span<PoCItem> items, const uint64_t targetDeadline)
+{
+    const size_t width = std::min<size_t>(std::max<size_t>(Shabal256Lanes(), 1), items.size());
+    uint8_t* scratch = nonceScratch(width);
+    uint8_t* genData[SHABAL256_MAX_LANES];
+    for (size_t l = 0; l < width; l++) {
+        genData[l] = &scratch[l * (PLOT_SIZE + SEED_LENGTH)];
+    }
+
+    bool fAllValid = true;
+    PoCItem* batch[SHABAL256_MAX_LANES];
+    size_t lanes = 0;
+    // Lanes of one group must share the seed length, so the two plot formats go in separate groups.
+    auto flush = [&](const bool fPoc2) {
+        const uint256* genSigs[SHABAL256_MAX_LANES];
+        uint32_t scoops[SHABAL256_MAX_LANES];
+        uint64_t deadlines[SHABAL256_MAX_LANES];
+        for (size_t l = 0; l < lanes; l++) {
+            const PoCItem& item = *batch[l];
+            if (fPoc2) {
+                putSeedPoc2(genData[l] + PLOT_SIZE, item.plotID, item.nonce);
+            } else {
+                putSeed(genData[l] + PLOT_SIZE, item.publicKeyID, item.nonce);
+            }
+            genSigs[l] = &item.genSig;
+            scoops[l] = calcScoop(item.genSig, item.height);
+        }
+        calcDeadlineLanes(genData, fPoc2 ? 16 : SEED_LENGTH, genSigs, scoops, deadlines, lanes);
+        for (size_t l = 0; l < lanes; l++) {
+            PoCItem& item = *batch[l];
+            const uint64_t dl = deadlines[l];
+            item.fValid = (dl == item.deadline) && (targetDeadline >= dl / item.baseTarget);
+            fAllValid &= item.fValid;
+        }
+        lanes = 0;
+    };
+    for (const bool fPoc2 : {false, true}) {
+        for (PoCItem& item : items) {
+            if (item.fPoc2 != fPoc2) continue;
+            uint64_t dl;
+            if (lookupPreverified(proofKey(item.genSig, item.height, fPoc2, item.plotID, item.publicKeyID, item.nonce), dl) ||
+                (!fPoc2 && lookupNonceTable(item.genSig, item.height, item.publicKeyID, item.nonce, dl))) {
+                item.fValid = (dl == item.deadline) && (targetDeadline >= dl / item.baseTarget);
+                fAllValid &= item.fValid;
+                continue;
+            }
+            batch[lanes++] = &item;
+            if (lanes == width) flush(fPoc2);
+        }
+        if (lanes > 0) flush(fPoc2);
+    }
+    return fAllValid;
+}
+
+static std::shared_ptr<PoCBatchVerifier> g_poc_batch_verifier;
+
+void SetPoCBatchVerifier(std::shared_ptr<PoCBatchVerifier> verifier)
+{
+    std::atomic_store(&g_poc_batch_verifier, std::move(verifier));
+}
+
+std::shared_ptr<PoCBatchVerifier> GetPoCBatchVerifier()
+{
+    return std::atomic_load(&g_poc_batch_verifier);
 }
 
 uint64_t CalcDeadlinePoc2(const CBlockHeader* block, const CBlockIndex* prevBlock)
@@ -240,57 +493,69 @@ uint64_t CalcDeadline(const CBlockHeader* block, const CBlockIndex* prevBlock)
 
 bool CheckProofOfCapacityPoc2(const uint256& genSig, const uint64_t height, const uint64_t plotID, const uint64_t nonce, const uint64_t baseTarget, const uint64_t deadline, const uint64_t targetDeadline)
 {
-    auto dl = CalcDeadlinePoc2(genSig, height, plotID, nonce);
+    uint64_t dl;
+    if (!lookupPreverified(proofKey(genSig, height, true, plotID, uint160(), nonce), dl))
+        dl = CalcDeadlinePoc2(genSig, height, plotID, nonce);
     return (dl == deadline) && (targetDeadline >= dl / baseTarget);
 }
 
 bool CheckProofOfCapacity(const uint256& genSig, const uint64_t height, const uint160& publicKeyID, const uint64_t nonce, const uint64_t baseTarget, const uint64_t deadline, const uint64_t targetDeadline)
 {
-    auto dl = CalcDeadline(genSig, height, publicKeyID, nonce);
+    uint64_t dl;
+    if (!lookupPreverified(proofKey(genSig, height, false, 0, publicKeyID, nonce), dl))
+        dl = CalcDeadline(genSig, height, publicKeyID, nonce);
     return (dl == deadline) && (targetDeadline >= dl / baseTarget);
 }
 
-uint64_t AdjustBaseTarget(const CBlockIndex* prevBlock, const uint32_t nTime)
+uint64_t DeadlineWait(const uint64_t deadline, const uint64_t baseTarget, const Consensus::Params& params)
 {
-    if (prevBlock == nullptr) 
-        return INITIAL_BASE_TARGET;
-    auto height = prevBlock->nHeight + 1;
-    if (height < 4) {
-        return INITIAL_BASE_TARGET;
-    }
-    if (height < 2700) {
-        auto itBlock = prevBlock;
-        uint64_t avgBaseTarget = itBlock->nBaseTarget;
+    return params.fFastPoC ? 0 : deadline / baseTarget;
+}
 
-        do {
-            itBlock = itBlock->pprev;
-            avgBaseTarget += itBlock->nBaseTarget;
-        } while (itBlock->nHeight > height - 4);
+/** Retarget from the plain average of the last 4 base targets, used below height 2700. */
+static uint64_t AdjustBaseTargetAverage(const CBlockIndex* prevBlock, const uint32_t nTime)
+{
+    auto height = prevBlock->nHeight + 1;
+    auto itBlock = prevBlock;
+    uint64_t avgBaseTarget = itBlock->nBaseTarget;
 
-        avgBaseTarget = avgBaseTarget / 4;
+    do {
+        itBlock = itBlock->pprev;
+        avgBaseTarget += itBlock->nBaseTarget;
+    } while (itBlock->nHeight > height - 4);
 
-        uint64_t difTime = nTime - itBlock->nTime;
+    avgBaseTarget = avgBaseTarget / 4;
 
-        uint64_t curBaseTarget = avgBaseTarget;
-        uint64_t newBaseTarget = curBaseTarget * difTime / (240 * 4);
+    uint64_t difTime = nTime - itBlock->nTime;
 
-        if (newBaseTarget < 0 || newBaseTarget > MAX_BASE_TARGET) {
-            newBaseTarget = MAX_BASE_TARGET;
-        }
+    uint64_t curBaseTarget = avgBaseTarget;
+    uint64_t newBaseTarget = curBaseTarget * difTime / (240 * 4);
 
-        if (newBaseTarget == 0) {
-            newBaseTarget = 1;
-        }
+    if (newBaseTarget < 0 || newBaseTarget > MAX_BASE_TARGET) {
+        newBaseTarget = MAX_BASE_TARGET;
+    }
 
-        // Adjust range should at [0.9, 1.1]
-        if (newBaseTarget < (curBaseTarget * 9 / 10)) {
-            newBaseTarget = curBaseTarget * 9 / 10;
-        } else if (newBaseTarget > (curBaseTarget * 11 / 10)) {
-            newBaseTarget = curBaseTarget * 11 / 10;
-        }
+    if (newBaseTarget == 0) {
+        newBaseTarget = 1;
+    }
 
-        return newBaseTarget; 
+    // Adjust range should at [0.9, 1.1]
+    if (newBaseTarget < (curBaseTarget * 9 / 10)) {
+        newBaseTarget = curBaseTarget * 9 / 10;
+    } else if (newBaseTarget > (curBaseTarget * 11 / 10)) {
+        newBaseTarget = curBaseTarget * 11 / 10;
     }
+
+    return newBaseTarget;
+}
+
+/**
+ * Retarget from the expected value of the last 24 base targets. The average is folded
+ * from the newest block backwards and truncated at every step, so it is not derived
+ * from the parent's average and the window is walked again for each block.
+ */
+static uint64_t AdjustBaseTargetExpected(const CBlockIndex* prevBlock, const uint32_t nTime)
+{
     auto itBlock = prevBlock;
     uint64_t expBaseTarget = itBlock->nBaseTarget;
     int blockCounter = 1;
@@ -329,94 +594,25 @@ uint64_t AdjustBaseTarget(const CBlockIndex* prevBlock, const uint32_t nTime)
     }
 
     return newBaseTarget;
-
 }
 
-void AdjustBaseTarget(const CBlockIndex* prevBlock, CBlock* block)
+uint64_t AdjustBaseTarget(const CBlockIndex* prevBlock, const uint32_t nTime)
 {
     // 1. Gensis block
-    auto height = 0;
-    if (prevBlock != nullptr) {
-        height = prevBlock->nHeight + 1;
-    }
-    if (prevBlock == nullptr || height == 0) {
-        block->nBaseTarget = INITIAL_BASE_TARGET;
-        // 2. First 4 blocks
-    } else if (height < 4) {
-        block->nBaseTarget = INITIAL_BASE_TARGET;
-        // 3. First 2700 blocks
-    } else if (height < 2700) {
-        auto itBlock = prevBlock;
-        uint64_t avgBaseTarget = itBlock->nBaseTarget;
-
-        do {
-            itBlock = itBlock->pprev;
-            avgBaseTarget += itBlock->nBaseTarget;
-        } while (itBlock->nHeight > height - 4);
-
-        avgBaseTarget = avgBaseTarget / 4;
-
-        uint64_t difTime = block->nTime - itBlock->nTime;
-
-        uint64_t curBaseTarget = avgBaseTarget;
-        uint64_t newBaseTarget = curBaseTarget * difTime / (240 * 4);
-
-        if (newBaseTarget < 0 || newBaseTarget > MAX_BASE_TARGET) {
-            newBaseTarget = MAX_BASE_TARGET;
-        }
-
-        if (newBaseTarget == 0) {
-            newBaseTarget = 1;
-        }
-
-        // Adjust range should at [0.9, 1.1]
-        if (newBaseTarget < (curBaseTarget * 9 / 10)) {
-            newBaseTarget = curBaseTarget * 9 / 10;
-        } else if (newBaseTarget > (curBaseTarget * 11 / 10)) {
-            newBaseTarget = curBaseTarget * 11 / 10;
-        }
-
-        block->nBaseTarget = newBaseTarget;
-    } else { // 4. Later blocks
-        auto itBlock = prevBlock;
-        uint64_t expBaseTarget = itBlock->nBaseTarget;
-        int blockCounter = 1;
-
-        // Calculate EV of last 30 blocks
-        do {
-            itBlock = itBlock->pprev;
-            blockCounter++;
-            expBaseTarget = (expBaseTarget * blockCounter + itBlock->nBaseTarget) / (blockCounter + 1);
-        } while (blockCounter < 24);
-
-        uint64_t difTime = block->nTime - itBlock->nTime;
-        uint64_t targetTimespan = 24 * 4 * 60;
-
-        if (difTime < targetTimespan / 2) {
-            difTime = targetTimespan / 2;
-        }
-
-        if (difTime > targetTimespan * 2) {
-            difTime = targetTimespan * 2;
-        }
-
-        uint64_t curBaseTarget = prevBlock->nBaseTarget;
-        uint64_t newBaseTarget = expBaseTarget * difTime / targetTimespan;
-
-        if (newBaseTarget < 0 || newBaseTarget > MAX_BASE_TARGET) {
-            newBaseTarget = MAX_BASE_TARGET;
-        }
-
-        if (newBaseTarget == 0) {
-            newBaseTarget = 1;
-        }
-
-        if (newBaseTarget < (curBaseTarget * 8 / 10)) {
-            newBaseTarget = curBaseTarget * 8 / 10;
-        } else if (newBaseTarget > (curBaseTarget * 12 / 10)) {
-            newBaseTarget = curBaseTarget * 12 / 10;
-        }
+    if (prevBlock == nullptr) 
+        return INITIAL_BASE_TARGET;
+    auto height = prevBlock->nHeight + 1;
+    // 2. First 4 blocks
+    if (height < 4)
+        return INITIAL_BASE_TARGET;
+    // 3. First 2700 blocks
+    if (height < 2700)
+        return AdjustBaseTargetAverage(prevBlock, nTime);
+    // 4. Later blocks
+    return AdjustBaseTargetExpected(prevBlock, nTime);
+}
 
-        block->nBaseTarget = newBaseTarget;
-    }
+void AdjustBaseTarget(const CBlockIndex* prevBlock, CBlock* block)
+{
+    block->nBaseTarget = AdjustBaseTarget(prevBlock, block->nTime);
 }
@@ -2,8 +2,11 @@
 #define COMMON_POC_H
 
 #include "uint256.h"
+#include <consensus/params.h>
+#include <memory>
 #include <string>
 #include <pubkey.h>
+#include <span.h>
 
 using namespace std;
 
@@ -27,8 +30,118 @@ uint64_t CalcDeadline(const uint256& genSig, const uint64_t height, const uint16
 
 uint64_t CalcDeadline(const CBlockHeader* block, const CBlockIndex* prevBlock);
 
+/** Compute the deadlines of several nonces of one plotter for the same generation signature.
+ *  The nonces are generated side by side in the lanes of the multi-lane Shabal engine.
+ */
+void CalcDeadlines(const uint256& genSig, const uint64_t height, const uint160& publicKeyID, const uint64_t* nonces, uint64_t* deadlines, const size_t count);
+
+/** Size of a scoop, the part of a nonce that is read for one block. */
+static const size_t POC_SCOOP_SIZE = 64;
+/** Number of scoops in a nonce. */
+static const size_t POC_SCOOP_COUNT = 4096;
+
+/** Generate the poc2.x nonces startNonce to startNonce + count - 1 of publicKeyID, in the layout of a
+ *  plot file: scoop s of the i-th nonce goes to scoops + s * columnStride + i * POC_SCOOP_SIZE, in the
+ *  PoC2 order. The nonces are generated side by side in the lanes of the multi-lane Shabal engine.
+ */
+void GenerateNonceScoops(const uint160& publicKeyID, const uint64_t startNonce, const size_t count, uint8_t* scoops, const size_t columnStride);
+
+/** Compute the deadlines of `count` scoops read from a PoC2 plot file, stored back to back
+ *  POC_SCOOP_SIZE bytes each, for the same generation signature.
+ */
+void CalcScoopDeadlines(const uint256& genSig, const uint8_t* scoops, uint64_t* deadlines, const size_t count);
+
 bool CheckProofOfCapacity(const uint256& genSig, const uint64_t height, const uint160& publicKeyID, const uint64_t nonce, const uint64_t baseTarget, const uint64_t deadline, const uint64_t targetDeadline);
 
+/** Seconds a block waits after its parent for its deadline to elapse, none on fast PoC test chains. */
+uint64_t DeadlineWait(const uint64_t deadline, const uint64_t baseTarget, const Consensus::Params& params);
+
+/** Nonces of every key kept in memory on fast PoC test chains, blocks are forged from them. */
+static const size_t FAST_POC_NONCES = 16;
+/** Most keys whose nonce tables are kept, the oldest one is dropped first. */
+static const size_t MAX_NONCE_TABLES = 16;
+
+/** Keep the scoops of the poc2.x nonces 0 to nNonces - 1 of a key in memory once one of them
+ *  is needed, so their deadlines are read from the table instead of generating the nonce.
+ *  Zero, the default, keeps none. */
+void SetNonceTableSize(const size_t nNonces);
+
+/** Mining parameters of the block on top of one tip. */
+struct PoCTipInfo
+{
+    uint256 hashTip;      //!< the tip these parameters build on
+    int height;           //!< height of the next block
+    bool fPoc2;           //!< the next block uses a classic poc2 plot
+    uint256 genSig;       //!< generation signature of the next block
+    uint32_t scoop;       //!< scoop every nonce is read at for the next block
+    uint64_t baseTarget;  //!< base target of the tip
+
+    PoCTipInfo() : height(0), fPoc2(false), scoop(0), baseTarget(0) {}
+};
+
+/** Return the mining parameters of the block following pindexPrev. They are
+ *  cached for the most recently requested tip, so mining RPCs polled many times
+ *  per block only hash the generation signature and scoop once.
+ */
+PoCTipInfo GetPoCTipInfo(const CBlockIndex* pindexPrev, const int nLVIP05Height);
+
+/** Compute the deadline of a nonce for the block described by `info`, using publicKeyID (poc2.x) or plotID (poc2). */
+uint64_t CalcDeadline(const PoCTipInfo& info, const uint160& publicKeyID, const uint64_t plotID, const uint64_t nonce);
+
+/** One proof of capacity to verify, as carried by a block header at `height`. */
+struct PoCItem
+{
+    uint256 genSig;
+    uint64_t height;
+    bool fPoc2;           //!< classic poc2 plot identified by plotID instead of publicKeyID
+    uint64_t plotID;
+    uint160 publicKeyID;
+    uint64_t nonce;
+    uint64_t baseTarget;
+    uint64_t deadline;
+    bool fValid;          //!< result, set by CheckProofOfCapacityBatch
+
+    PoCItem() : height(0), fPoc2(false), plotID(0), nonce(0), baseTarget(0), deadline(0), fValid(false) {}
+};
+
+/** Most deadlines kept by AddPreverifiedProof. */
+static const size_t MAX_PREVERIFIED_PROOFS = 64;
+
+/** Remember the deadline of a proof computed ahead of its block, e.g. from a deadline
+ *  announcement, so verifying the block header needs no Shabal work. Only the fields that
+ *  select the nonce and item.deadline, the computed deadline, are used. */
+void AddPreverifiedProof(const PoCItem& item);
+
+/** Verify many proofs of capacity on the calling thread, generating their nonces
+ *  side by side in the lanes of the multi-lane Shabal engine. Sets fValid of
+ *  every item and returns whether all of them are valid.
+ */
+bool CheckProofOfCapacityBatch(Span<PoCItem> items, const uint64_t targetDeadline);
+
+/**
+ * A device verifying proofs of capacity in bulk, such as a GPU, for the large batches of
+ * nonces submitted by the miners of a pool. Blocks and headers are always verified on the CPU.
+ */
+class PoCBatchVerifier
+{
+public:
+    virtual ~PoCBatchVerifier() {}
+
+    virtual std::string Name() const = 0;
+
+    /** The smallest batch worth the transfer to the device, smaller ones are verified on the CPU. */
+    virtual size_t MinBatchSize() const = 0;
+
+    /** Set fValid of every item as CheckProofOfCapacityBatch does. Returns false if the
+     *  device failed, the items are then verified on the CPU. */
+    virtual bool Verify(Span<PoCItem> items, const uint64_t targetDeadline) = 0;
+};
+
+/** Install the device used to verify submitted nonces, or remove it with nullptr. */
+void SetPoCBatchVerifier(std::shared_ptr<PoCBatchVerifier> verifier);
+
+std::shared_ptr<PoCBatchVerifier> GetPoCBatchVerifier();
+
 void AdjustBaseTarget(const CBlockIndex* prevBlock, CBlock* block);
 
 uint64_t AdjustBaseTarget(const CBlockIndex* prevBlock, const uint32_t nTime);
@@ -12,6 +12,8 @@
 #include <txmempool.h>
 #include <util/system.h>
 
+#include <cmath>
+
 static constexpr double INF_FEERATE = 1e99;
 
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon) {
@@ -140,8 +142,8 @@ public:
                   unsigned int bucketIndex, bool inBlock);
 
     /** Update our estimates by decaying our historical moving average and updating
-        with the data gathered from the current block */
-    void UpdateMovingAverages();
+        with the data gathered from the current block, which counts as decayScale blocks */
+    void UpdateMovingAverages(double decayScale = 1);
 
     /**
      * Calculate a feerate estimate.  Find the lowest value bucket (or range of buckets
@@ -228,15 +230,16 @@ void TxConfirmStats::Record(int blocksToConfirm, double val)
     avg[bucketindex] += val;
 }
 
-void TxConfirmStats::UpdateMovingAverages()
+void TxConfirmStats::UpdateMovingAverages(double decayScale)
 {
+    const double blockDecay = decayScale == 1 ? decay : std::pow(decay, decayScale);
     for (unsigned int j = 0; j < buckets.size(); j++) {
         for (unsigned int i = 0; i < confAvg.size(); i++)
-            confAvg[i][j] = confAvg[i][j] * decay;
+            confAvg[i][j] = confAvg[i][j] * blockDecay;
         for (unsigned int i = 0; i < failAvg.size(); i++)
-            failAvg[i][j] = failAvg[i][j] * decay;
-        avg[j] = avg[j] * decay;
-        txCtAvg[j] = txCtAvg[j] * decay;
+            failAvg[i][j] = failAvg[i][j] * blockDecay;
+        avg[j] = avg[j] * blockDecay;
+        txCtAvg[j] = txCtAvg[j] * blockDecay;
     }
 }
 
@@ -525,7 +528,7 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
 }
 
 CBlockPolicyEstimator::CBlockPolicyEstimator()
-    : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), trackedTxs(0), untrackedTxs(0)
+    : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), fDecayByTime(false), nLastBlockTime(0), trackedTxs(0), untrackedTxs(0)
 {
     static_assert(MIN_BUCKET_FEERATE > 0, "Min feerate must be nonzero");
     size_t bucketIndex = 0;
@@ -612,8 +615,14 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     return true;
 }
 
+void CBlockPolicyEstimator::SetDecayByTime(bool fDecayByTimeIn)
+{
+    LOCK(m_cs_fee_estimator);
+    fDecayByTime = fDecayByTimeIn;
+}
+
 void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
-                                         std::vector<const CTxMemPoolEntry*>& entries)
+                                         std::vector<const CTxMemPoolEntry*>& entries, int64_t nBlockTime)
 {
     LOCK(m_cs_fee_estimator);
     if (nBlockHeight <= nBestSeenHeight) {
@@ -635,10 +644,19 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     shortStats->ClearCurrent(nBlockHeight);
     longStats->ClearCurrent(nBlockHeight);
 
-    // Decay all exponential averages
-    feeStats->UpdateMovingAverages();
-    shortStats->UpdateMovingAverages();
-    longStats->UpdateMovingAverages();
+    // Decay all exponential averages, by the time since the last block if we know it.
+    // Block times are not monotonic, and a single long wait is bounded so that it
+    // doesn't wipe out the history.
+    double decayScale = 1;
+    if (fDecayByTime && nBlockTime > 0 && nLastBlockTime > 0) {
+        const int64_t nInterval = std::min(std::max<int64_t>(nBlockTime - nLastBlockTime, 0), MAX_DECAY_INTERVAL);
+        decayScale = (double)nInterval / DECAY_BLOCK_INTERVAL;
+    }
+    if (nBlockTime > 0)
+        nLastBlockTime = nBlockTime;
+    feeStats->UpdateMovingAverages(decayScale);
+    shortStats->UpdateMovingAverages(decayScale);
+    longStats->UpdateMovingAverages(decayScale);
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
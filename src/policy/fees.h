@@ -22,6 +22,9 @@ class CTxMemPoolEntry;
 class CTxMemPool;
 class TxConfirmStats;
 
+/** Default for -feeestimatebytime */
+static const bool DEFAULT_FEE_ESTIMATE_BY_TIME = true;
+
 /* Identifier for each of the 3 different TxConfirmStats which will track
  * history over different time horizons. */
 enum class FeeEstimateHorizon {
@@ -184,14 +187,24 @@ private:
      */
     static constexpr double FEE_SPACING = 1.05;
 
+    /** The block interval the decays above are tuned for, in seconds */
+    static constexpr int64_t DECAY_BLOCK_INTERVAL = 600;
+    /** Longest interval a single block decays the averages for, in seconds */
+    static constexpr int64_t MAX_DECAY_INTERVAL = 6 * DECAY_BLOCK_INTERVAL;
+
 public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator();
     ~CBlockPolicyEstimator();
 
-    /** Process all the transactions that have been included in a block */
+    /** Process all the transactions that have been included in a block, timed nBlockTime if known */
     void processBlock(unsigned int nBlockHeight,
-                      std::vector<const CTxMemPoolEntry*>& entries);
+                      std::vector<const CTxMemPoolEntry*>& entries, int64_t nBlockTime = 0);
+
+    /** Decay the averages by the time between blocks rather than per block. PoC blocks
+     *  follow the deadlines of the plots, every 4 minutes on average, so this keeps the
+     *  horizons of the estimates as long in time as the decays were tuned for. */
+    void SetDecayByTime(bool fDecayByTimeIn);
 
     /** Process a transaction accepted to the mempool*/
     void processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate);
@@ -250,6 +263,9 @@ private:
     std::unique_ptr<TxConfirmStats> shortStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> longStats PT_GUARDED_BY(m_cs_fee_estimator);
 
+    bool fDecayByTime GUARDED_BY(m_cs_fee_estimator);
+    int64_t nLastBlockTime GUARDED_BY(m_cs_fee_estimator);
+
     unsigned int trackedTxs GUARDED_BY(m_cs_fee_estimator);
     unsigned int untrackedTxs GUARDED_BY(m_cs_fee_estimator);
 
@@ -0,0 +1,99 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <poolserver.h>
+
+#include <assember.h>
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <key.h>
+#include <logging.h>
+#include <metrics.h>
+#include <poc.h>
+#include <util/trace.h>
+#include <validation.h>
+
+#include <string.h>
+
+CPoolServer g_pool_server;
+
+std::vector<uint8_t> CPoolServer::SubmitShares(Span<const unsigned char> body)
+{
+    static CMetricHistogram& metric = GetMetrics().Histogram("pool_submit", "Time to check a batch of pool shares");
+    static CMetricCounter& counted = GetMetrics().Counter("pool_shares", "Valid pool shares counted");
+    CMetricTimer timer(metric);
+
+    assert(body.size() % POOL_SHARE_SIZE == 0);
+    const size_t count = body.size() / POOL_SHARE_SIZE;
+    std::vector<uint8_t> results(count, (uint8_t)PoolShareResult::REJECTED);
+    std::vector<CKeyID> keyids(count);
+    std::vector<PoCItem> items;
+    std::vector<size_t> itemOf;
+
+    const CBlockIndex* prevIndex;
+    {
+        LOCK(cs_main);
+        prevIndex = chainActive.Tip();
+    }
+    const auto& params = Params();
+    const uint64_t targetDeadline = params.TargetDeadline();
+    const PoCTipInfo info = GetPoCTipInfo(prevIndex, params.GetConsensus().LVIP05Height);
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* p = body.data() + i * POOL_SHARE_SIZE;
+        memcpy(keyids[i].begin(), p, 20);
+        PoCItem item;
+        item.nonce = ReadLE64(p + 20);
+        item.deadline = ReadLE64(p + 28);
+        const int height = (int)ReadLE32(p + 36);
+        // Shares only count for the next block, and only when they could make it.
+        if (height != info.height || item.deadline > targetDeadline) {
+            TRACE4(poc, submitnonce_rejected, height, keyids[i].GetPlotID(), item.nonce, item.deadline);
+            continue;
+        }
+        item.genSig = info.genSig;
+        item.height = height;
+        item.fPoc2 = info.fPoc2;
+        item.plotID = keyids[i].GetPlotID();
+        item.publicKeyID = uint160(keyids[i]);
+        item.baseTarget = prevIndex->nBaseTarget;
+        items.push_back(item);
+        itemOf.push_back(i);
+    }
+
+    CheckSubmittedProofsOfCapacity(MakeSpan(items), targetDeadline);
+
+    LOCK(cs);
+    for (size_t n = 0; n < items.size(); n++) {
+        const PoCItem& item = items[n];
+        const size_t i = itemOf[n];
+        if (!item.fValid) {
+            TRACE4(poc, submitnonce_rejected, item.height, item.plotID, item.nonce, item.deadline);
+            LogPrint(BCLog::FORGE, "%s: invalid share of %s, deadline %u\n", __func__, keyids[i].ToString(), item.deadline);
+            continue;
+        }
+        CPoolAccount& account = accounts[keyids[i]];
+        account.nShares++;
+        if (account.nBestHeight != (int)item.height || item.deadline < account.nBestDeadline) {
+            account.nBestHeight = item.height;
+            account.nBestNonce = item.nonce;
+            account.nBestDeadline = item.deadline;
+        }
+        results[i] = (uint8_t)PoolShareResult::SHARE;
+        counted.Add();
+
+        // The pool forges with the key set by setfsowner, as the plot miner does.
+        if (blockAssember.IsCandidate(prevIndex, item.height, item.deadline) &&
+            blockAssember.PublishDeadline(prevIndex, item.height, keyids[i], item.nonce, item.deadline, info.genSig)) {
+            TRACE4(poc, submitnonce_accepted, item.height, item.plotID, item.nonce, item.deadline);
+            results[i] = (uint8_t)PoolShareResult::BEST;
+        }
+    }
+    return results;
+}
+
+std::map<CKeyID, CPoolAccount> CPoolServer::GetAccounts() const
+{
+    LOCK(cs);
+    return accounts;
+}
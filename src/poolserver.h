@@ -0,0 +1,62 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_POOLSERVER_H
+#define LAVA_POOLSERVER_H
+
+#include <pubkey.h>
+#include <span.h>
+#include <sync.h>
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/** Default for -poolserver */
+static const bool DEFAULT_POOLSERVER = false;
+/** Size of a share of the pool protocol: the key id of the account, then the nonce, the deadline and the height, little endian. */
+static const size_t POOL_SHARE_SIZE = 20 + 8 + 8 + 4;
+/** Most shares a request to /pool may carry. */
+static const size_t MAX_POOL_SHARES = 4096;
+
+/** What became of a share, one byte per share in the reply to /pool. */
+enum class PoolShareResult : uint8_t {
+    REJECTED = 0, //!< stale, out of the target deadline, or not a valid proof
+    SHARE = 1,    //!< a valid proof, counted for its account
+    BEST = 2,     //!< a valid proof that became the best deadline of the block assember
+};
+
+/** The shares of an account since the node started, and its best deadline at the last height it submitted for. */
+struct CPoolAccount
+{
+    uint64_t nShares;
+    int nBestHeight;
+    uint64_t nBestNonce;
+    uint64_t nBestDeadline;
+
+    CPoolAccount() : nShares(0), nBestHeight(0), nBestNonce(0), nBestDeadline(0) {}
+};
+
+/**
+ * The pool endpoint of the node. Miners of a pool submit their nonces in batches of
+ * fixed size records; the proofs are checked side by side by the multi-lane Shabal
+ * engine, counted for the account that submitted them, and the best one feeds the
+ * block assember, so a pool needs no proxy verifying the shares a second time.
+ */
+class CPoolServer
+{
+public:
+    /** Check and count the shares of body, a multiple of POOL_SHARE_SIZE bytes, and return one PoolShareResult per share. */
+    std::vector<uint8_t> SubmitShares(Span<const unsigned char> body);
+
+    std::map<CKeyID, CPoolAccount> GetAccounts() const;
+
+private:
+    mutable CCriticalSection cs;
+    std::map<CKeyID, CPoolAccount> accounts GUARDED_BY(cs);
+};
+
+extern CPoolServer g_pool_server;
+
+#endif // LAVA_POOLSERVER_H
@@ -6,10 +6,60 @@
 #ifndef BITCOIN_PRIMITIVES_BLOCK_H
 #define BITCOIN_PRIMITIVES_BLOCK_H
 
+#include <crypto/common.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
 #include <uint256.h>
 
+#include <string.h>
+
+/**
+ * Writes the fixed-size fields of a header to a buffer in their serialized form, so a
+ * header reaches its stream in one write instead of one per field.
+ */
+class CHeaderFieldWriter
+{
+    unsigned char* p;
+
+public:
+    explicit CHeaderFieldWriter(unsigned char* pIn) : p(pIn) {}
+
+    CHeaderFieldWriter& operator<<(int32_t v) { WriteLE32(p, (uint32_t)v); p += 4; return *this; }
+    CHeaderFieldWriter& operator<<(uint32_t v) { WriteLE32(p, v); p += 4; return *this; }
+    CHeaderFieldWriter& operator<<(uint64_t v) { WriteLE64(p, v); p += 8; return *this; }
+
+    template <unsigned int BITS>
+    CHeaderFieldWriter& operator<<(const base_blob<BITS>& v)
+    {
+        memcpy(p, v.begin(), v.size());
+        p += v.size();
+        return *this;
+    }
+
+    const unsigned char* end() const { return p; }
+};
+
+/** Reads the fixed-size fields of a header from a buffer filled by one stream read. */
+class CHeaderFieldReader
+{
+    const unsigned char* p;
+
+public:
+    explicit CHeaderFieldReader(const unsigned char* pIn) : p(pIn) {}
+
+    CHeaderFieldReader& operator>>(int32_t& v) { v = (int32_t)ReadLE32(p); p += 4; return *this; }
+    CHeaderFieldReader& operator>>(uint32_t& v) { v = ReadLE32(p); p += 4; return *this; }
+    CHeaderFieldReader& operator>>(uint64_t& v) { v = ReadLE64(p); p += 8; return *this; }
+
+    template <unsigned int BITS>
+    CHeaderFieldReader& operator>>(base_blob<BITS>& v)
+    {
+        memcpy(v.begin(), p, v.size());
+        p += v.size();
+        return *this;
+    }
+};
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -39,25 +89,46 @@ public:
         SetNull();
     }
 
-    ADD_SERIALIZE_METHODS;
+    //! Serialized size of the fields up to nPlotID, which tell whether nPublicKeyID follows
+    static constexpr size_t PREFIX_SIZE = 4 + 32 + 32 + 4 + 8 + 32 + 8;
+    //! Serialized size of a header with nPublicKeyID
+    static constexpr size_t MAX_SERIALIZED_SIZE = PREFIX_SIZE + 20 + 8 + 8;
 
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(this->nVersion);
-        READWRITE(hashPrevBlock);
-        READWRITE(hashMerkleRoot);
-        READWRITE(nTime);
-        READWRITE(nNonce);
-        
-        READWRITE(genSign);
+    /** Whether nPublicKeyID is part of the header: POC2x, PID is null. */
+    static bool HasPublicKeyID(uint64_t nPlotID, const uint256& hashPrevBlock)
+    {
+        return nPlotID == 0 && !hashPrevBlock.IsNull();
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char buf[MAX_SERIALIZED_SIZE];
+        CHeaderFieldWriter w(buf);
+        w << nVersion << hashPrevBlock << hashMerkleRoot << nTime << nNonce << genSign << nPlotID;
+        if (HasPublicKeyID(nPlotID, hashPrevBlock)) {
+            w << nPublicKeyID;
+        }
+        w << nBaseTarget << nDeadline;
+        s.write((const char*)buf, w.end() - buf);
+    }
 
-        READWRITE(nPlotID);    
-        if (nPlotID == 0 && !hashPrevBlock.IsNull()){
-            // POC2x, PID is null.
-            READWRITE(nPublicKeyID);
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        // The prefix tells which of the two layouts the rest has.
+        unsigned char buf[MAX_SERIALIZED_SIZE];
+        s.read((char*)buf, PREFIX_SIZE);
+        CHeaderFieldReader r(buf);
+        r >> nVersion >> hashPrevBlock >> hashMerkleRoot >> nTime >> nNonce >> genSign >> nPlotID;
+        const bool fPublicKeyID = HasPublicKeyID(nPlotID, hashPrevBlock);
+        s.read((char*)buf + PREFIX_SIZE, (fPublicKeyID ? 20 : 0) + 8 + 8);
+        if (fPublicKeyID) {
+            r >> nPublicKeyID;
+        } else {
+            nPublicKeyID.SetNull();
         }
-        READWRITE(nBaseTarget);
-        READWRITE(nDeadline);
+        r >> nBaseTarget >> nDeadline;
     }
 
     void SetNull()
@@ -10,6 +10,99 @@
 #include <uint256.h>
 #include <util/strencodings.h>
 
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * The bytes of a commitment: null, an explicit value or a 33-byte commitment. They are
+ * kept inline with a length, rather than in a vector, so a confidential output costs no
+ * allocations to deserialize, copy or add to the coins cache. The interface is the
+ * subset of std::vector the commitments are used with.
+ */
+class CCommitmentData
+{
+public:
+    static const size_t MAX_SIZE = 33;
+
+    typedef unsigned char value_type;
+    typedef unsigned char* iterator;
+    typedef const unsigned char* const_iterator;
+
+private:
+    uint8_t nSize;
+    unsigned char vch[MAX_SIZE];
+
+public:
+    CCommitmentData() : nSize(0) {}
+    CCommitmentData(const std::vector<unsigned char>& v) { assign(v.begin(), v.end()); }
+
+    CCommitmentData& operator=(const std::vector<unsigned char>& v)
+    {
+        assign(v.begin(), v.end());
+        return *this;
+    }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+    unsigned char* data() { return vch; }
+    const unsigned char* data() const { return vch; }
+    unsigned char* begin() { return vch; }
+    const unsigned char* begin() const { return vch; }
+    unsigned char* end() { return vch + nSize; }
+    const unsigned char* end() const { return vch + nSize; }
+    unsigned char& operator[](size_t pos) { return vch[pos]; }
+    const unsigned char& operator[](size_t pos) const { return vch[pos]; }
+
+    void clear() { nSize = 0; }
+    void resize(size_t n)
+    {
+        assert(n <= MAX_SIZE);
+        if (n > nSize) {
+            memset(vch + nSize, 0, n - nSize);
+        }
+        nSize = n;
+    }
+    void assign(size_t n, unsigned char value)
+    {
+        assert(n <= MAX_SIZE);
+        memset(vch, value, n);
+        nSize = n;
+    }
+    template <typename InputIt, typename = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+    void assign(InputIt first, InputIt last)
+    {
+        nSize = 0;
+        insert(end(), first, last);
+    }
+    template <typename InputIt>
+    void insert(unsigned char* pos, InputIt first, InputIt last)
+    {
+        assert(pos == end());
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+    void push_back(unsigned char value)
+    {
+        assert(nSize < MAX_SIZE);
+        vch[nSize++] = value;
+    }
+
+    std::vector<unsigned char> ToVector() const { return std::vector<unsigned char>(begin(), end()); }
+
+    friend bool operator==(const CCommitmentData& a, const CCommitmentData& b)
+    {
+        return a.nSize == b.nSize && memcmp(a.vch, b.vch, a.nSize) == 0;
+    }
+
+    friend bool operator!=(const CCommitmentData& a, const CCommitmentData& b)
+    {
+        return !(a == b);
+    }
+};
+
 /**
  * Confidential assets, values, and nonces all share enough code in common
  * that it makes sense to define a common abstract base class. */
@@ -19,8 +112,9 @@ class CConfidentialCommitment
 public:
     static const size_t nExplicitSize = ExplicitSize;
     static const size_t nCommittedSize = 33;
+    static_assert(ExplicitSize <= CCommitmentData::MAX_SIZE, "explicit data must fit in a commitment");
 
-    std::vector<unsigned char> vchCommitment;
+    CCommitmentData vchCommitment;
 
     CConfidentialCommitment() { SetNull(); }
 
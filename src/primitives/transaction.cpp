@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <primitives/transaction.h>
+#include <ticket.h>
 #include <core_io.h>
 #include <hash.h>
 #include <tinyformat.h>
@@ -113,12 +114,36 @@ uint256 CTransaction::ComputeWitnessHash() const
     return SerializeHash(*this, SER_GETHASH, 0);
 }
 
+uint256 CTransaction::ComputeHash(const CReadTransaction& read) const
+{
+    // Without optional data, the bytes read are the serialization without witness.
+    if (read.flags == 0) {
+        return read.hash;
+    }
+    return ComputeHash();
+}
+
+uint256 CTransaction::ComputeWitnessHash(const CReadTransaction& read) const
+{
+    if (!HasWitness()) {
+        return hash;
+    }
+    // The bytes read are the serialization with witness if they carry the flags it is written with.
+    const unsigned char flags = 1 | (IsVersionCA() ? 2 : 0);
+    if (read.flags == flags) {
+        return read.hash;
+    }
+    return ComputeWitnessHash();
+}
+
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
-CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash{}, m_witness_hash{} {}
+CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash{}, m_witness_hash{}, m_ticket{} {}
 CTransaction::CTransaction(const CMutableTransaction& tx) :
-        vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
+        vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()}, m_ticket{ComputeTicket()} {}
 CTransaction::CTransaction(CMutableTransaction&& tx) :
-        vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()} {}
+        vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash{ComputeHash()}, m_witness_hash{ComputeWitnessHash()}, m_ticket{ComputeTicket()} {}
+CTransaction::CTransaction(CReadTransaction&& read) :
+        vin(std::move(read.tx.vin)), vout(std::move(read.tx.vout)), nVersion(read.tx.nVersion), nLockTime(read.tx.nLockTime), hash{ComputeHash(read)}, m_witness_hash{ComputeWitnessHash(read)}, m_ticket{ComputeTicket()} {}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -155,17 +180,21 @@ std::string CTransaction::ToString() const
 }
 
 // check the tx's ticket vout
-bool IsTicketVout(const CScript script, CScriptID &scriptID)
+bool IsTicketVout(const CScript& script, CScriptID &scriptID)
 {
+    if (script.IsPayToScriptHash()) {
+        memcpy(scriptID.begin(), script.data() + 2, 20);
+        return true;
+    }
+
     CScriptBase::const_iterator pc = script.begin();
     opcodetype opcodeRet;
-    std::vector<unsigned char> vchRet;
-    if (script.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_HASH160) {
-        vchRet.clear();
-        if (script.GetOp(pc, opcodeRet, vchRet)) {
-            scriptID = CScriptID(uint160(vchRet));
-            if (script.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_EQUAL) {
-                vchRet.clear();
+    Span<const unsigned char> data;
+    if (script.GetOp(pc, opcodeRet, data) && opcodeRet == OP_HASH160) {
+        // A hash pushed in any other size is not a script id.
+        if (script.GetOp(pc, opcodeRet, data) && data.size() == 20) {
+            memcpy(scriptID.begin(), data.data(), 20);
+            if (script.GetOp(pc, opcodeRet) && opcodeRet == OP_EQUAL) {
                 return true;
             }
         }
@@ -173,68 +202,40 @@ bool IsTicketVout(const CScript script, CScriptID &scriptID)
     return false;
 }
 
-bool CTransaction::IsTicketTx() const
+CTicketRef CTransaction::ComputeTicket() const
 {
     // check the vout size is 2 or 3.
     if(vout.size()!=2 && vout.size()!=3){
-        return false;
+        return nullptr;
     }
 
-    CScript redeemscript;
+    // the 0 value vout carries the redeemScript, the last P2SH vout must pay to it.
+    const CTxOut* zeroOut = nullptr;
     CScriptID scriptID;
-    CScript scriptzero;
     bool HasTicketVout = false;
-    for (size_t i = 0; i < vout.size(); i++){
-        if (vout[i].nValue == 0){
-            // from 0 value vout's script decode the redeemScript.
-            CScript script = vout[i].scriptPubKey;
-            scriptzero = script;
-            if (!GetRedeemFromScript(script,redeemscript)){
-                return false;
-            }
+    for (const auto& out : vout) {
+        if (out.nValue == 0) {
+            if (zeroOut)
+                return nullptr;
+            zeroOut = &out;
         }
-
-        auto ticketScript = vout[i].scriptPubKey;
-        if (IsTicketVout(ticketScript, scriptID)){
-            HasTicketVout=true;
+        if (IsTicketVout(out.scriptPubKey, scriptID)) {
+            HasTicketVout = true;
         }
     }
+    if (!zeroOut || !HasTicketVout)
+        return nullptr;
 
-    if (!HasTicketVout) 
-        return false;
-
-    // parese the dest from redeemscript
-    CScriptID dest = CScriptID(redeemscript);
-
-    if (dest == scriptID){
-        return true;
-    }
-
-    return false;
-}
-
-CTicketRef CTransaction::Ticket() const
-{
-    auto ticket = CTicketRef();
-    if (!IsTicketTx()) 
-        return ticket;
     CScript redeemScript;
+    if (!GetRedeemFromScript(zeroOut->scriptPubKey, redeemScript) || CScriptID(redeemScript) != scriptID)
+        return nullptr;
+
     CScript ticketScript;
-    for (size_t i = 0; i < vout.size(); i++) {
-        auto out = vout[i];
-        if (out.nValue == 0) { // op_return script
-            if (!GetRedeemFromScript(out.scriptPubKey, redeemScript)) {
-                //TODO: logging
-                break;
-            }
-            ticketScript << OP_HASH160 << ToByteVector(CScriptID(redeemScript)) << OP_EQUAL;
-        } 
-    }
-    for (size_t i = 0; i < vout.size(); i++) {
-        auto out = vout[i];
-        if (out.nValue != 0 && ticketScript == out.scriptPubKey) {
-            ticket.reset(new CTicket(COutPoint(hash, i), out.nValue, redeemScript, ticketScript));
+    ticketScript << OP_HASH160 << ToByteVector(scriptID) << OP_EQUAL;
+    for (size_t i = vout.size(); i-- > 0;) {
+        if (vout[i].nValue != 0 && vout[i].scriptPubKey == ticketScript) {
+            return std::make_shared<const CTicket>(COutPoint(hash, i), vout[i].nValue, redeemScript, ticketScript);
         }
     }
-    return ticket;
+    return nullptr;
 }
@@ -8,14 +8,17 @@
 
 #include <stdint.h>
 #include <amount.h>
+#include <hash.h>
 #include <script/script.h>
 #include <serialize.h>
 #include <uint256.h>
-#include <ticket.h>
 #include <primitives/confidential.h>
 
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
 class CTransaction;
+struct CReadTransaction;
+class CTicket;
+typedef std::shared_ptr<const CTicket> CTicketRef;
 
 /** An outpoint - a combination of a transaction hash and an index n into its vout */
 class COutPoint
@@ -282,6 +285,16 @@ public:
         return flags == 1;
     }
 
+    /**
+     * A copy of the output without its range and surjection proofs. Once the transaction is
+     * validated only its creator needs the proofs, so the coins cache and the wallet keep
+     * these copies and read the proofs from the transaction when they need them.
+     */
+    CTxOut WithoutProofs() const
+    {
+        return CTxOut(nValue, scriptPubKey, nAsset, nValueCA, nNonce, flags);
+    }
+
     friend bool operator==(const CTxOut& a, const CTxOut& b)
     {
         return (a.nAsset == b.nAsset &&
@@ -319,7 +332,7 @@ struct CMutableTransaction;
  * - uint32_t nLockTime
  */
 template<typename Stream, typename TxType>
-inline void UnserializeTransaction(TxType& tx, Stream& s) {
+inline void UnserializeTransaction(TxType& tx, Stream& s, unsigned char* flags_out = nullptr) {
     const bool fAllowWitness = !(s.GetVersion() & SERIALIZE_TRANSACTION_NO_WITNESS);
 
     s >> tx.nVersion;
@@ -364,6 +377,8 @@ inline void UnserializeTransaction(TxType& tx, Stream& s) {
         throw std::ios_base::failure("Unknown transaction optional data");
     }
     s >> tx.nLockTime;
+    if (flags_out)
+        *flags_out = flags;
 }
 
 template<typename Stream, typename TxType>
@@ -446,9 +461,18 @@ private:
     /** Memory only. */
     const uint256 hash;
     const uint256 m_witness_hash;
+    /** The firestone bought by this transaction, or null. */
+    const CTicketRef m_ticket;
 
     uint256 ComputeHash() const;
     uint256 ComputeWitnessHash() const;
+    CTicketRef ComputeTicket() const;
+
+    /** The hashes of a transaction read from a stream, taken from the bytes read where they can be. */
+    uint256 ComputeHash(const CReadTransaction& read) const;
+    uint256 ComputeWitnessHash(const CReadTransaction& read) const;
+
+    explicit CTransaction(CReadTransaction&& read);
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -466,7 +490,7 @@ public:
     /** This deserializing constructor is provided instead of an Unserialize method.
      *  Unserialize is not possible, since it would require overwriting const fields. */
     template <typename Stream>
-    CTransaction(deserialize_type, Stream& s) : CTransaction(CMutableTransaction(deserialize, s)) {}
+    CTransaction(deserialize_type, Stream& s) : CTransaction(CReadTransaction(s)) {}
 
     bool IsNull() const {
         return vin.empty() && vout.empty();
@@ -543,9 +567,9 @@ public:
         return nVersion == CTransaction::CONFIDENTIAL_VERSION;
     }
 
-    bool IsTicketTx() const;
+    bool IsTicketTx() const { return m_ticket != nullptr; }
 
-    CTicketRef Ticket() const;
+    const CTicketRef& Ticket() const { return m_ticket; }
 };
 
 /** A mutable version of CTransaction. */
@@ -634,6 +658,30 @@ struct CMutableTransaction
     }
 };
 
+/**
+ * A transaction read from a stream, with the hash of the bytes it was read from. Those bytes
+ * are the serialization the txid or the witness hash commits to, unless the optional data
+ * flags read are not the ones the transaction serializes with, so hashing them as they are
+ * read saves serializing the transaction again to compute its hashes.
+ */
+struct CReadTransaction
+{
+    CMutableTransaction tx;
+    unsigned char flags = 0; //!< the optional data flags read, 0 if there were none
+    uint256 hash;
+
+    template <typename Stream>
+    explicit CReadTransaction(Stream& s)
+    {
+        CHashVerifier<Stream> verifier(&s);
+        UnserializeTransaction(tx, verifier, &flags);
+        // Whatever follows in the stream is read with the flags of this transaction, as if it
+        // had been read from the stream directly.
+        s.SetExtra(verifier.GetExtra());
+        hash = verifier.GetHash();
+    }
+};
+
 typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
@@ -238,6 +238,76 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70014 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * Contains a 4-byte reconciliation protocol version and an 8-byte salt.
+ * Indicates that a node is willing to reconcile transaction announcements
+ * on this connection instead of flooding invs, see TxReconciliationState.
+ * @since protocol version 90024
+ */
+extern const char *SENDRECON;
+/**
+ * Contains the 2-byte size of the reconciliation set of the outbound side
+ * of a connection, which asks for a "sketch" of the set of the other side.
+ * @since protocol version 90024
+ */
+extern const char *REQRECON;
+/**
+ * Contains a CTxReconSketch of the reconciliation set of the sender.
+ * Sent in response to a "reqrecon" message.
+ * @since protocol version 90024
+ */
+extern const char *SKETCH;
+/**
+ * Contains a 1-byte bool telling whether the sketch could be decoded and the
+ * 4-byte short ids of the transactions the sender misses. Sent in response to
+ * a "sketch" message; each side then announces what the other one misses.
+ * @since protocol version 90024
+ */
+extern const char *RECONCILDIFF;
+/**
+ * Contains a vector of transactions sorted parents first, which the receiver
+ * evaluates together, so a child paying for its parent can carry it into the
+ * mempool.
+ * @since protocol version 90025
+ */
+extern const char *PKGTXNS;
+/**
+ * Contains a CDeadlineAnnouncement: the best deadline a forger found for the
+ * block on top of the tip, relayed before the block so its proof of capacity
+ * is verified and its firestone read in advance.
+ * @since protocol version 90026
+ */
+extern const char *DEADLINE;
+/**
+ * Contains the command of a block, blocktxn, headers or tx message and a zstd
+ * frame of its payload, compressed with the dictionary of netcompress.h.
+ * Only sent to peers advertising NODE_COMPRESS.
+ * @since protocol version 90027
+ */
+extern const char *COMPRESSED;
+/**
+ * getcfilters requests the compact filters of a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is a response to a getcfilters request containing a single compact
+ * filter.
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests the filter hashes of a range of blocks, and the filter
+ * header of the block before them.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is a response to a getcfheaders request containing a filter header
+ * and a vector of filter hashes for each subsequent block in the requested range.
+ */
+extern const char *CFHEADERS;
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -264,10 +334,16 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_FILTERS means the node will service basic block filter requests.
+    // See BIP157 and BIP158 for details on how this is implemented.
+    NODE_COMPACT_FILTERS = (1 << 6),
     // NODE_NETWORK_LIMITED means the same as NODE_NETWORK with the limitation of only
     // serving the last 288 (2 day) blocks
     // See BIP159 for details on how this is implemented.
     NODE_NETWORK_LIMITED = (1 << 10),
+    // NODE_COMPRESS means the node accepts and sends block and transaction messages
+    // compressed with zstd, see netcompress.h.
+    NODE_COMPRESS = (1 << 11),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
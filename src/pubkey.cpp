@@ -8,11 +8,48 @@
 
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
+#include <secp256k1_schnorrsig.h>
 
 namespace
 {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context* secp256k1_context_verify = nullptr;
+
+/* Scratch space for one batch of Schnorr signatures. */
+const size_t SCHNORR_BATCH_SCRATCH_SIZE = 4 << 20;
+
+/* Number of parsed public keys each thread keeps, a power of two. */
+const size_t PARSED_PUBKEY_CACHE_SIZE = 64;
+
+struct ParsedPubKey {
+    unsigned int size = 0;
+    unsigned char vch[CPubKey::PUBLIC_KEY_SIZE];
+    secp256k1_pubkey pubkey;
+};
+
+/**
+ * Parse a valid key, reusing the parse of the same key by this thread if it is still in
+ * its cache. The signatures of a key that spends many outputs of a block, as a pool paying
+ * out or a firestone owner redeeming tickets does, then share the decompression of the
+ * key. The cache is direct mapped on the x coordinate of the keys.
+ */
+bool ParsePubKey(const CPubKey& key, secp256k1_pubkey& pubkey)
+{
+    static thread_local ParsedPubKey cache[PARSED_PUBKEY_CACHE_SIZE];
+    const unsigned char* vch = key.begin();
+    ParsedPubKey& entry = cache[(vch[1] | (vch[2] << 8)) & (PARSED_PUBKEY_CACHE_SIZE - 1)];
+    if (entry.size == key.size() && memcmp(entry.vch, vch, entry.size) == 0) {
+        pubkey = entry.pubkey;
+        return true;
+    }
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, vch, key.size())) {
+        return false;
+    }
+    entry.size = key.size();
+    memcpy(entry.vch, vch, entry.size);
+    entry.pubkey = pubkey;
+    return true;
+}
 } // namespace
 
 /** This function is taken from the libsecp256k1 distribution and implements
@@ -176,7 +213,7 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
         return false;
     secp256k1_pubkey pubkey;
     secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, vch, size())) {
+    if (!ParsePubKey(*this, pubkey)) {
         return false;
     }
     if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, vchSig.data(), vchSig.size())) {
@@ -188,6 +225,49 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
     return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
 }
 
+bool CPubKey::VerifySchnorr(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
+    if (!IsValid() || vchSig.size() != SCHNORR_SIGNATURE_SIZE)
+        return false;
+    secp256k1_pubkey pubkey;
+    secp256k1_schnorrsig sig;
+    if (!ParsePubKey(*this, pubkey)) {
+        return false;
+    }
+    if (!secp256k1_schnorrsig_parse(secp256k1_context_verify, &sig, vchSig.data())) {
+        return false;
+    }
+    return secp256k1_schnorrsig_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
+}
+
+bool CPubKey::VerifySchnorrBatch(const std::vector<std::vector<unsigned char>>& vchSigs, const std::vector<uint256>& hashes, const std::vector<CPubKey>& pubkeys) {
+    assert(vchSigs.size() == hashes.size() && vchSigs.size() == pubkeys.size());
+    if (vchSigs.empty())
+        return true;
+    std::vector<secp256k1_pubkey> keys(pubkeys.size());
+    std::vector<secp256k1_schnorrsig> sigs(vchSigs.size());
+    std::vector<const secp256k1_pubkey*> keyptrs;
+    std::vector<const secp256k1_schnorrsig*> sigptrs;
+    std::vector<const unsigned char*> msgptrs;
+    for (size_t i = 0; i < vchSigs.size(); i++) {
+        if (!pubkeys[i].IsValid() || vchSigs[i].size() != SCHNORR_SIGNATURE_SIZE)
+            return false;
+        if (!ParsePubKey(pubkeys[i], keys[i]))
+            return false;
+        if (!secp256k1_schnorrsig_parse(secp256k1_context_verify, &sigs[i], vchSigs[i].data()))
+            return false;
+        keyptrs.push_back(&keys[i]);
+        sigptrs.push_back(&sigs[i]);
+        msgptrs.push_back(hashes[i].begin());
+    }
+    // The multi-exponentiation runs in chunks that fit the scratch space.
+    secp256k1_scratch_space* scratch = secp256k1_scratch_space_create(secp256k1_context_verify, SCHNORR_BATCH_SCRATCH_SIZE);
+    if (!scratch)
+        return false;
+    int ret = secp256k1_schnorrsig_verify_batch(secp256k1_context_verify, scratch, sigptrs.data(), msgptrs.data(), keyptrs.data(), sigptrs.size());
+    secp256k1_scratch_space_destroy(scratch);
+    return ret;
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE)
         return false;
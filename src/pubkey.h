@@ -30,6 +30,7 @@ public:
     static constexpr unsigned int COMPRESSED_PUBLIC_KEY_SIZE  = 33;
     static constexpr unsigned int SIGNATURE_SIZE              = 72;
     static constexpr unsigned int COMPACT_SIGNATURE_SIZE      = 65;
+    static constexpr unsigned int SCHNORR_SIGNATURE_SIZE      = 64;
     /**
      * see www.keylength.com
      * script supports up to 75 for single byte push
@@ -178,6 +179,18 @@ public:
      */
     bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
 
+    /**
+     * Verify a BIP-schnorr signature (64 bytes).
+     * If this public key is not fully valid, the return value will be false.
+     */
+    bool VerifySchnorr(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
+
+    /**
+     * Verify Schnorr signatures at once, entry i of each vector is one signature.
+     * Faster than one VerifySchnorr per signature, but it does not tell which one is invalid.
+     */
+    static bool VerifySchnorrBatch(const std::vector<std::vector<unsigned char>>& vchSigs, const std::vector<uint256>& hashes, const std::vector<CPubKey>& pubkeys);
+
     /**
      * Check whether a signature is normalized (lower-S).
      */
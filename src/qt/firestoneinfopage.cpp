@@ -71,14 +71,13 @@ void FirestoneInfoPage::on_btnQuery_clicked()
 
 FirestoneInfoPage::FirestoneInfo FirestoneInfoPage::getFirestoneInfo(const CKeyID &key)
 {
-    std::vector<CTicketRef> alltickets;
+    std::vector<CTicketRef> alltickets = pticketview->GetSnapshot()->FindeTickets(key);
     {
       //
       // scope to limit the lock scope...
       LOCK(cs_main);
-      alltickets = pticketview->FindeTickets(key);
       auto end = std::remove_if(alltickets.begin(), alltickets.end(), [](const CTicketRef& ticket) {
-        return pcoinsTip->AccessCoin(COutPoint(ticket->out->hash, ticket->out->n)).IsSpent();
+        return pcoinsTip->AccessCoin(COutPoint(ticket->out.hash, ticket->out.n)).IsSpent();
       });
       alltickets.erase(end, alltickets.end());
     }
@@ -210,21 +209,23 @@ void FirestoneInfoPage::on_btnRelease_clicked()
       return;
     }
 
-    std::vector<CTicketRef> alltickets;
-    {
-      LOCK(cs_main);
-      alltickets = pticketview->FindeTickets(boost::get<CKeyID>(relDest));
-    }
+    const CTicketSnapshotRef snapshot = pticketview->GetSnapshot();
+    const std::vector<CTicketRef>& alltickets = snapshot->FindeTickets(boost::get<CKeyID>(relDest));
 
     std::vector<CTicketRef> tickets;
-    for(size_t i=0;i < alltickets.size(); i++){
-        auto ticket = alltickets[i];
-        auto out = *(ticket->out);
-        if (!pcoinsTip->AccessCoin(out).IsSpent() && !mempool.isSpent(out)){
-            tickets.push_back(ticket);
-            if (tickets.size() > 4)
-                break;
-        }
+    int nHeight;
+    {
+      LOCK2(cs_main, mempool.cs);
+      nHeight = chainActive.Height();
+      for(size_t i=0;i < alltickets.size(); i++){
+          auto ticket = alltickets[i];
+          auto out = ticket->out;
+          if (!pcoinsTip->AccessCoin(out).IsSpent() && !mempool.isSpent(out)){
+              tickets.push_back(ticket);
+              if (tickets.size() > 4)
+                  break;
+          }
+      }
     }
     if(tickets.empty()) {
       QMessageBox::information(this, windowTitle(), tr("No firestones in this address"), QMessageBox::Ok, QMessageBox::Ok);
@@ -238,11 +239,11 @@ void FirestoneInfoPage::on_btnRelease_clicked()
     std::vector<CTxOut> outs;
     UniValue ticketids(UniValue::VARR);
     for(auto iter = tickets.begin(); iter!=tickets.end(); iter++){
-      auto state = (*iter)->State(chainActive.Height());
+      auto state = (*iter)->State(nHeight);
       if (state == CTicket::CTicketState::OVERDUE){
         auto ticket = (*iter);
-        uint256 txid = ticket->out->hash;
-        uint32_t n = ticket->out->n;
+        uint256 txid = ticket->out.hash;
+        uint32_t n = ticket->out.n;
         CScript redeemScript = ticket->redeemScript;
         ticketids.push_back(txid.ToString() + ":" + itostr(n));
 
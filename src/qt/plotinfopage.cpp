@@ -162,8 +162,13 @@ Optional<QPair<PlotInfoPage::AddressInfo, PlotInfoPage::AddressInfo>> PlotInfoPa
     Optional<QPair<PlotInfoPage::AddressInfo, PlotInfoPage::AddressInfo>> ret;
 
     auto& wallet = _walletModel->wallet();
-    LOCK(cs_main);
-    auto to = prelationview->To(from, from.GetPlotID(), wallet.isPoc2x());
+    CKeyID to;
+    if (wallet.isPoc2x()) {
+        to = prelationview->GetSnapshot()->To(from);
+    } else {
+        LOCK(cs_main);
+        to = prelationview->To(from, from.GetPlotID(), false);
+    }
     if (to == CKeyID()) {
         return ret;
     }
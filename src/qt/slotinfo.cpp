@@ -3,12 +3,12 @@
 
 SlotInfo SlotInfo::currentSlotInfo()
 {
-    LOCK(cs_main);
+    const CTicketSnapshotRef tickets = pticketview->GetSnapshot();
 
-    int index = pticketview->SlotIndex();
-    auto price = pticketview->TicketPriceInSlot(index);
-    auto count = (uint64_t)pticketview->GetTicketsBySlotIndex(index).size();
-    auto lockTime = pticketview->LockTime(index);
+    int index = tickets->SlotIndex();
+    auto price = tickets->TicketPriceInSlot(index);
+    auto count = (uint64_t)tickets->TicketCountInSlot(index);
+    auto lockTime = tickets->LockTime(index);
 
     return SlotInfo {
         index, lockTime, price, count
@@ -30,6 +30,18 @@
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+#include <QTimer>
+
+#include <atomic>
+#include <deque>
+#include <thread>
+
+/** Number of wallet transactions fetched and decomposed at a time by the background loader */
+static const size_t TX_LOAD_PAGE_SIZE = 1000;
+/** Above this many updates in one batch, reset the model rather than signalling row by row */
+static const size_t MAX_INCREMENTAL_UPDATES = 100;
+/** Show balloons for at most this many transactions of a batch */
+static const size_t MAX_BATCH_BALLOONS = 10;
 
 
 // Amount column is right-aligned it contains numbers
@@ -59,6 +71,22 @@ struct TxLessThan
     }
 };
 
+// Transaction added, removed or changed in the core, waiting to be applied to the model
+struct TransactionNotification
+{
+    uint256 hash;
+    ChangeType status;
+    bool showTransaction;
+};
+
+// Transaction records decomposed by the background loader, up to and including txid last
+struct TransactionPage
+{
+    uint256 last;
+    QList<TransactionRecord> records;
+    bool fLast;
+};
+
 // Private implementation
 class TransactionTablePriv
 {
@@ -66,6 +94,15 @@ public:
     explicit TransactionTablePriv(TransactionTableModel *_parent) :
         parent(_parent)
     {
+        updateTimer = new QTimer(parent);
+        updateTimer->setSingleShot(true);
+        updateTimer->setInterval(MODEL_UPDATE_DELAY);
+        QObject::connect(updateTimer, &QTimer::timeout, parent, &TransactionTableModel::processPendingUpdates);
+    }
+
+    ~TransactionTablePriv()
+    {
+        stopLoading();
     }
 
     TransactionTableModel *parent;
@@ -76,27 +113,154 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Loading state, only touched from the GUI thread. Pages are appended in txid
+     * order, so the cache holds every transaction up to loadedUpTo; notifications
+     * beyond it are deferred until the loader has passed them.
+     */
+    bool fLoading = false;
+    uint256 loadedUpTo;
+    std::vector<TransactionNotification> deferred;
+
+    std::thread loader;
+    std::atomic<bool> fInterruptLoad{false};
+
+    /* Work handed to the GUI thread by the loader and the core notification
+     * handlers, applied in one batch when updateTimer fires.
+     */
+    Mutex cs_pending;
+    std::vector<TransactionNotification> pendingNotifications GUARDED_BY(cs_pending);
+    std::deque<TransactionPage> pendingPages GUARDED_BY(cs_pending);
+    bool fUpdateScheduled GUARDED_BY(cs_pending) = false;
+    bool fHoldUpdates GUARDED_BY(cs_pending) = false;
+    QTimer *updateTimer;
+
+    /* Start loading the wallet from core. Records are decomposed a page at a time on
+     * a background thread and appended to the model as they become available, so the
+     * table opens at once and fills in behind the visible rows.
+     */
+    void startLoading(interfaces::Wallet& wallet)
+    {
+        qDebug() << "TransactionTablePriv::startLoading";
+        fLoading = true;
+        loader = std::thread([this, &wallet] { loadWallet(wallet); });
+    }
+
+    void stopLoading()
+    {
+        fInterruptLoad = true;
+        if (loader.joinable()) loader.join();
+    }
+
+    void loadWallet(interfaces::Wallet& wallet)
+    {
+        RenameThread("lava-txtable");
+        uint256 after;
+        while (!fInterruptLoad) {
+            std::vector<interfaces::WalletTx> wtxs = wallet.getWalletTxs(after, TX_LOAD_PAGE_SIZE);
+            TransactionPage page;
+            page.fLast = wtxs.size() < TX_LOAD_PAGE_SIZE;
+            page.last = wtxs.empty() ? after : wtxs.back().tx->GetHash();
+            if (TransactionRecord::showTransaction()) {
+                for (const auto& wtx : wtxs) {
+                    page.records.append(TransactionRecord::decomposeTransaction(wtx));
+                }
+            }
+            after = page.last;
+            {
+                LOCK(cs_pending);
+                pendingPages.push_back(std::move(page));
+                scheduleUpdate();
+            }
+            if (wtxs.size() < TX_LOAD_PAGE_SIZE) break;
+        }
+    }
+
+    /* Queue a notification from the core, to be applied with the next batch. */
+    void queueNotification(const TransactionNotification& notification)
+    {
+        LOCK(cs_pending);
+        pendingNotifications.push_back(notification);
+        scheduleUpdate();
+    }
+
+    /* Hold notifications back while the core reports progress, e.g. during a rescan,
+     * and release them as one batch when it is done.
      */
-    void refreshWallet(interfaces::Wallet& wallet)
+    void holdUpdates(bool fHold)
+    {
+        LOCK(cs_pending);
+        fHoldUpdates = fHold;
+        scheduleUpdate();
+    }
+
+    void scheduleUpdate() EXCLUSIVE_LOCKS_REQUIRED(cs_pending)
+    {
+        if (fUpdateScheduled || fHoldUpdates) return;
+        if (pendingNotifications.empty() && pendingPages.empty()) return;
+        fUpdateScheduled = true;
+        QMetaObject::invokeMethod(updateTimer, "start", Qt::QueuedConnection);
+    }
+
+    /* Apply the pages and notifications received since the last batch. */
+    void processPending(interfaces::Wallet& wallet)
     {
-        qDebug() << "TransactionTablePriv::refreshWallet";
-        cachedWallet.clear();
+        std::vector<TransactionNotification> notifications;
+        std::deque<TransactionPage> pages;
         {
-            for (const auto& wtx : wallet.getWalletTxs()) {
-                if (TransactionRecord::showTransaction()) {
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wtx));
+            LOCK(cs_pending);
+            notifications.swap(pendingNotifications);
+            pages.swap(pendingPages);
+            fUpdateScheduled = false;
+        }
+
+        for (TransactionPage& page : pages) {
+            if (!page.records.isEmpty()) {
+                parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + page.records.size() - 1);
+                cachedWallet.append(page.records);
+                parent->endInsertRows();
+            }
+            loadedUpTo = page.last;
+            if (page.fLast) {
+                qDebug() << "TransactionTablePriv::processPending: loaded" << cachedWallet.size() << "records";
+                fLoading = false;
+            }
+        }
+
+        if (fLoading) {
+            std::vector<TransactionNotification> ready;
+            for (const TransactionNotification& notification : notifications) {
+                if (loadedUpTo < notification.hash) {
+                    deferred.push_back(notification);
+                } else {
+                    ready.push_back(notification);
                 }
             }
+            notifications.swap(ready);
+        } else if (!deferred.empty()) {
+            notifications.insert(notifications.begin(), deferred.begin(), deferred.end());
+            std::vector<TransactionNotification>().swap(deferred);
+        }
+        if (notifications.empty()) return;
+
+        const bool fReset = notifications.size() > MAX_INCREMENTAL_UPDATES;
+        if (fReset) parent->beginResetModel();
+        for (size_t i = 0; i < notifications.size(); i++) {
+            // prevent balloon spam, show maximum MAX_BATCH_BALLOONS balloons
+            parent->setProcessingQueuedTransactions(notifications.size() - i > MAX_BATCH_BALLOONS);
+            const TransactionNotification& notification = notifications[i];
+            updateWallet(wallet, notification.hash, notification.status, notification.showTransaction, !fReset);
         }
+        parent->setProcessingQueuedTransactions(false);
+        if (fReset) parent->endResetModel();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
        with that of the core.
 
-       Call with transaction that was added, removed or changed.
+       Call with transaction that was added, removed or changed. Row signals are left to
+       the caller when fSignal is false, as when the whole batch resets the model.
      */
-    void updateWallet(interfaces::Wallet& wallet, const uint256 &hash, int status, bool showTransaction)
+    void updateWallet(interfaces::Wallet& wallet, const uint256 &hash, int status, bool showTransaction, bool fSignal)
     {
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
@@ -143,14 +307,14 @@ public:
                         TransactionRecord::decomposeTransaction(wtx);
                 if(!toInsert.isEmpty()) /* only if something to insert */
                 {
-                    parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
+                    if (fSignal) parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
                     int insert_idx = lowerIndex;
                     for (const TransactionRecord &rec : toInsert)
                     {
                         cachedWallet.insert(insert_idx, rec);
                         insert_idx += 1;
                     }
-                    parent->endInsertRows();
+                    if (fSignal) parent->endInsertRows();
                 }
             }
             break;
@@ -161,9 +325,9 @@ public:
                 break;
             }
             // Removed -- remove entire transaction from table
-            parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
+            if (fSignal) parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
             cachedWallet.erase(lower, upper);
-            parent->endRemoveRows();
+            if (fSignal) parent->endRemoveRows();
             break;
         case CT_UPDATED:
             // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
@@ -229,11 +393,11 @@ TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle
         platformStyle(_platformStyle)
 {
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Label") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
-    priv->refreshWallet(walletModel->wallet());
 
     connect(walletModel->getOptionsModel(), &OptionsModel::displayUnitChanged, this, &TransactionTableModel::updateDisplayUnit);
 
     subscribeToCoreSignals();
+    priv->startLoading(walletModel->wallet());
 }
 
 TransactionTableModel::~TransactionTableModel()
@@ -242,6 +406,11 @@ TransactionTableModel::~TransactionTableModel()
     delete priv;
 }
 
+bool TransactionTableModel::processingQueuedTransactions() const
+{
+    return fProcessingQueuedTransactions || priv->fLoading;
+}
+
 /** Updates the column title to "Amount (DisplayUnit)" and emits headerDataChanged() signal for table headers to react. */
 void TransactionTableModel::updateAmountColumnTitle()
 {
@@ -254,7 +423,12 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     uint256 updated;
     updated.SetHex(hash.toStdString());
 
-    priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
+    priv->queueNotification({updated, static_cast<ChangeType>(status), showTransaction});
+}
+
+void TransactionTableModel::processPendingUpdates()
+{
+    priv->processPending(walletModel->wallet());
 }
 
 void TransactionTableModel::updateConfirmations()
@@ -683,74 +857,30 @@ void TransactionTableModel::updateDisplayUnit()
     Q_EMIT dataChanged(index(0, Amount), index(priv->size()-1, Amount));
 }
 
-// queue notifications to show a non freezing progress dialog e.g. for rescan
-struct TransactionNotification
-{
-public:
-    TransactionNotification() {}
-    TransactionNotification(uint256 _hash, ChangeType _status, bool _showTransaction):
-        hash(_hash), status(_status), showTransaction(_showTransaction) {}
-
-    void invoke(QObject *ttm)
-    {
-        QString strHash = QString::fromStdString(hash.GetHex());
-        qDebug() << "NotifyTransactionChanged: " + strHash + " status= " + QString::number(status);
-        QMetaObject::invokeMethod(ttm, "updateTransaction", Qt::QueuedConnection,
-                                  Q_ARG(QString, strHash),
-                                  Q_ARG(int, status),
-                                  Q_ARG(bool, showTransaction));
-    }
-private:
-    uint256 hash;
-    ChangeType status;
-    bool showTransaction;
-};
-
-static bool fQueueNotifications = false;
-static std::vector< TransactionNotification > vQueueNotifications;
-
-static void NotifyTransactionChanged(TransactionTableModel *ttm, const uint256 &hash, ChangeType status)
+static void NotifyTransactionChanged(TransactionTablePriv *priv, const uint256 &hash, ChangeType status)
 {
-    // Find transaction in wallet
     // Determine whether to show transaction or not (determine this here so that no relocking is needed in GUI thread)
     bool showTransaction = TransactionRecord::showTransaction();
 
-    TransactionNotification notification(hash, status, showTransaction);
-
-    if (fQueueNotifications)
-    {
-        vQueueNotifications.push_back(notification);
-        return;
-    }
-    notification.invoke(ttm);
+    // Queue rather than invoke, so that bursts such as a block connect reach the model as one batch
+    priv->queueNotification({hash, status, showTransaction});
 }
 
-static void ShowProgress(TransactionTableModel *ttm, const std::string &title, int nProgress)
+// hold notifications to show a non freezing progress dialog e.g. for rescan
+static void ShowProgress(TransactionTablePriv *priv, const std::string &title, int nProgress)
 {
     if (nProgress == 0)
-        fQueueNotifications = true;
+        priv->holdUpdates(true);
 
     if (nProgress == 100)
-    {
-        fQueueNotifications = false;
-        if (vQueueNotifications.size() > 10) // prevent balloon spam, show maximum 10 balloons
-            QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, true));
-        for (unsigned int i = 0; i < vQueueNotifications.size(); ++i)
-        {
-            if (vQueueNotifications.size() - i <= 10)
-                QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
-
-            vQueueNotifications[i].invoke(ttm);
-        }
-        std::vector<TransactionNotification >().swap(vQueueNotifications); // clear
-    }
+        priv->holdUpdates(false);
 }
 
 void TransactionTableModel::subscribeToCoreSignals()
 {
     // Connect signals to wallet
-    m_handler_transaction_changed = walletModel->wallet().handleTransactionChanged(std::bind(NotifyTransactionChanged, this, std::placeholders::_1, std::placeholders::_2));
-    m_handler_show_progress = walletModel->wallet().handleShowProgress(std::bind(ShowProgress, this, std::placeholders::_1, std::placeholders::_2));
+    m_handler_transaction_changed = walletModel->wallet().handleTransactionChanged(std::bind(NotifyTransactionChanged, priv, std::placeholders::_1, std::placeholders::_2));
+    m_handler_show_progress = walletModel->wallet().handleShowProgress(std::bind(ShowProgress, priv, std::placeholders::_1, std::placeholders::_2));
 }
 
 void TransactionTableModel::unsubscribeFromCoreSignals()
@@ -81,7 +81,8 @@ public:
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
-    bool processingQueuedTransactions() const { return fProcessingQueuedTransactions; }
+    /** Whether rows are being inserted in bulk, from the initial load or a batch of updates, rather than for a new transaction */
+    bool processingQueuedTransactions() const;
 
 private:
     WalletModel *walletModel;
@@ -110,6 +111,8 @@ private:
 public Q_SLOTS:
     /* New transaction, or transaction changed status */
     void updateTransaction(const QString &hash, int status, bool showTransaction);
+    /* Apply the batch of loaded pages and transaction changes queued since the last one */
+    void processPendingUpdates();
     void updateConfirmations();
     void updateDisplayUnit();
     /** Updates the column title to "Amount (DisplayUnit)" and emits headerDataChanged() signal for table headers to react. */
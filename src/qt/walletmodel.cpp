@@ -55,6 +55,9 @@ WalletModel::WalletModel(std::unique_ptr<interfaces::Wallet> wallet, interfaces:
 WalletModel::~WalletModel()
 {
     unsubscribeFromCoreSignals();
+    // The transaction table loads through m_wallet on a background thread, stop it first
+    delete transactionTableModel;
+    transactionTableModel = nullptr;
 }
 
 void WalletModel::updateStatus()
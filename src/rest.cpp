@@ -3,28 +3,39 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <actiondb.h>
 #include <attributes.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <coins.h>
 #include <core_io.h>
 #include <httpserver.h>
 #include <index/txindex.h>
+#include <key_io.h>
+#include <poc.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
+#include <ticket.h>
 #include <txmempool.h>
 #include <util/strencodings.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <version.h>
 
+#include <atomic>
+#include <memory>
+
 #include <boost/algorithm/string.hpp>
 
 #include <univalue.h>
 
-static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once in the URI
+static const size_t MAX_GETUTXOS_POST_OUTPOINTS = 4096; //and of 4096 in a posted batch
+static const int MAX_REST_BLOCKS = 500; //allow a max of 500 blocks to be fetched at once
 
 enum class RetFormat {
     UNDEF,
@@ -62,6 +73,119 @@ struct CCoin {
     }
 };
 
+/** How long clients and proxies may cache the PoC state, which changes with every block */
+static const int REST_POC_MAX_AGE = 10;
+
+/** The state of a firestone slot, as getslotinfo reports it. */
+struct CRESTSlot {
+    int index;
+    CAmount price;
+    uint64_t count;
+    int locktime;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(index);
+        READWRITE(price);
+        READWRITE(count);
+        READWRITE(locktime);
+    }
+};
+
+struct CRESTTicket {
+    CTicketRef ticket;
+    bool fSpent;
+};
+
+/**
+ * An immutable copy of the PoC state at a tip: mining info, slots, firestones and bindings.
+ * REST readers share it without locks; it is rebuilt, under cs_main, by the first reader
+ * after the tip changes.
+ */
+struct CRESTPoCSnapshot {
+    //! The value of g_rest_poc_generation the copy was taken at
+    uint64_t generation;
+    uint256 hashTip;
+    int height;
+    PoCTipInfo mining;
+    std::string cumulativeDiff;
+    std::vector<CRESTSlot> slots;
+    std::map<CKeyID, std::vector<CRESTTicket>> tickets;
+    //! The bindings by plot key; before LVIP05 they are looked up in the relation view instead
+    std::map<CKeyID, CKeyID> bindings;
+    bool fPocx;
+};
+
+//! Bumped when the tip changes, which makes the snapshot stale
+static std::atomic<uint64_t> g_rest_poc_generation{0};
+static std::shared_ptr<const CRESTPoCSnapshot> g_rest_poc_snapshot;
+//! Serializes the builders of snapshots, so the state is copied once per tip
+static Mutex g_rest_poc_build_mutex;
+
+class CRESTNotifications final : public CValidationInterface
+{
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override
+    {
+        ++g_rest_poc_generation;
+    }
+};
+
+static std::unique_ptr<CRESTNotifications> g_rest_notifications;
+
+static std::shared_ptr<const CRESTPoCSnapshot> BuildPoCSnapshot(uint64_t generation) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    auto snapshot = std::make_shared<CRESTPoCSnapshot>();
+    const CBlockIndex* tip = chainActive.Tip();
+    const Consensus::Params& consensus = Params().GetConsensus();
+    snapshot->generation = generation;
+    snapshot->hashTip = tip->GetBlockHash();
+    snapshot->height = tip->nHeight;
+    snapshot->mining = GetPoCTipInfo(tip, consensus.LVIP05Height);
+    snapshot->cumulativeDiff = tip->nCumulativeDiff.GetHex();
+    for (int index = 0; index <= pticketview->SlotIndex(); index++) {
+        snapshot->slots.push_back(CRESTSlot{index, pticketview->TicketPriceInSlot(index),
+            (uint64_t)pticketview->TicketCountInSlot(index), pticketview->LockTime(index)});
+    }
+    for (const auto& entry : pticketview->TicketsByAddress()) {
+        std::vector<CRESTTicket>& tickets = snapshot->tickets[entry.first];
+        tickets.reserve(entry.second.size());
+        for (const CTicketRef& ticket : entry.second) {
+            tickets.push_back(CRESTTicket{ticket, pcoinsTip->AccessCoin(ticket->out).IsSpent()});
+        }
+    }
+    snapshot->fPocx = tip->nHeight >= consensus.LVIP05Height;
+    if (snapshot->fPocx) {
+        for (const CRelation& relation : prelationview->ListRelations()) {
+            snapshot->bindings.emplace(relation.first, relation.second);
+        }
+    }
+    return snapshot;
+}
+
+/** The snapshot of the PoC state at the tip, taken now if the last one is stale. */
+static std::shared_ptr<const CRESTPoCSnapshot> GetPoCSnapshot()
+{
+    const uint64_t generation = g_rest_poc_generation;
+    std::shared_ptr<const CRESTPoCSnapshot> snapshot = std::atomic_load(&g_rest_poc_snapshot);
+    if (snapshot && snapshot->generation == generation)
+        return snapshot;
+
+    LOCK(g_rest_poc_build_mutex);
+    snapshot = std::atomic_load(&g_rest_poc_snapshot);
+    if (snapshot && snapshot->generation == generation)
+        return snapshot;
+    {
+        LOCK(cs_main);
+        snapshot = BuildPoCSnapshot(generation);
+    }
+    std::atomic_store(&g_rest_poc_snapshot, snapshot);
+    return snapshot;
+}
+
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string message)
 {
     req->WriteHeader("Content-Type", "text/plain");
@@ -205,8 +329,11 @@ static bool rest_block(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
     CBlock block;
+    RawBlockData block_data;
     CBlockIndex* pblockindex = nullptr;
     CBlockIndex* tip = nullptr;
+    // The blocks are stored as serialized with witness, so they are served as they are unless asked otherwise.
+    const bool fRaw = (rf == RetFormat::BINARY || rf == RetFormat::HEX) && !(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS);
     {
         LOCK(cs_main);
         tip = chainActive.Tip();
@@ -218,24 +345,26 @@ static bool rest_block(HTTPRequest* req,
         if (IsBlockPruned(pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        if (fRaw ? !ReadRawBlockFromDisk(block_data, pblockindex, Params().MessageStart()) : !ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
+    if (!fRaw && rf != RetFormat::JSON) {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
+        block_data.buffer.assign(ssBlock.begin(), ssBlock.end());
+        block_data.data = Span<const uint8_t>(block_data.buffer.data(), block_data.buffer.size());
+    }
 
     switch (rf) {
     case RetFormat::BINARY: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string binaryBlock = ssBlock.str();
+        std::string binaryBlock(block_data.data.begin(), block_data.data.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RetFormat::HEX: {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::string strHex = HexStr(block_data.data.begin(), block_data.data.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -255,6 +384,73 @@ static bool rest_block(HTTPRequest* req,
     }
 }
 
+static bool rest_blocks(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RetFormat::BINARY && rf != RetFormat::HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    int32_t start, count;
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block count specified. Use /rest/blocks/<start>/<count>.<ext>.");
+    if (!ParseInt32(path[0], &start) || start < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(path[0]));
+    if (!ParseInt32(path[1], &count) || count < 1 || count > MAX_REST_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + SanitizeString(path[1]));
+
+    // The blocks are read once, under one lock, and their bytes handed to the reply as they are mapped
+    std::vector<std::shared_ptr<const RawBlockData>> blocks;
+    const bool fRaw = !(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS);
+    {
+        LOCK(cs_main);
+        if (start > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+        const int end = std::min(start + count - 1, chainActive.Height());
+        blocks.reserve(end - start + 1);
+        for (int height = start; height <= end; height++) {
+            const CBlockIndex* pblockindex = chainActive[height];
+            if (IsBlockPruned(pblockindex))
+                return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block at height %d not available (pruned data)", height));
+            auto block_data = std::make_shared<RawBlockData>();
+            if (fRaw) {
+                if (!ReadRawBlockFromDisk(*block_data, pblockindex, Params().MessageStart()))
+                    return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block at height %d not found", height));
+            } else {
+                CBlock block;
+                if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+                    return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block at height %d not found", height));
+                CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+                ssBlock << block;
+                block_data->buffer.assign(ssBlock.begin(), ssBlock.end());
+                block_data->data = Span<const uint8_t>(block_data->buffer.data(), block_data->buffer.size());
+            }
+            blocks.push_back(std::move(block_data));
+        }
+    }
+
+    // The blocks follow one another, as they do in the block files
+    if (rf == RetFormat::BINARY) {
+        for (const auto& block_data : blocks) {
+            req->WriteReplyData(block_data, block_data->data.data(), block_data->data.size());
+        }
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK);
+    } else {
+        std::string strHex;
+        for (const auto& block_data : blocks) {
+            strHex += HexStr(block_data->data.begin(), block_data->data.end()) + "\n";
+        }
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, std::move(strHex));
+    }
+    return true;
+}
+
 static bool rest_block_extended(HTTPRequest* req, const std::string& strURIPart)
 {
     return rest_block(req, strURIPart, true);
@@ -479,23 +675,32 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
     }
 
-    // limit max outpoints
-    if (vOutPoints.size() > MAX_GETUTXOS_OUTPOINTS)
-        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_GETUTXOS_OUTPOINTS, vOutPoints.size()));
+    // limit max outpoints, batches posted in binary may be larger than URIs
+    const size_t nMaxOutPoints = fInputParsed ? MAX_GETUTXOS_OUTPOINTS : MAX_GETUTXOS_POST_OUTPOINTS;
+    if (vOutPoints.size() > nMaxOutPoints)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", nMaxOutPoints, vOutPoints.size()));
 
     // check spentness and form a bitmap (as well as a JSON capable human-readable string representation)
     std::vector<unsigned char> bitmap;
     std::vector<CCoin> outs;
     std::string bitmapStringRepresentation;
     std::vector<bool> hits;
+    int nChainHeight;
+    uint256 hashChainTip;
     bitmap.resize((vOutPoints.size() + 7) / 8);
     {
-        auto process_utxos = [&vOutPoints, &outs, &hits](const CCoinsView& view, const CTxMemPool& mempool) {
-            for (const COutPoint& vOutPoint : vOutPoints) {
-                Coin coin;
-                bool hit = !mempool.isSpent(vOutPoint) && view.GetCoin(vOutPoint, coin);
-                hits.push_back(hit);
-                if (hit) outs.emplace_back(std::move(coin));
+        // The coins are looked up in the order of their outpoints, as the database keeps them,
+        // and handed back in the order they were asked for.
+        std::vector<size_t> order(vOutPoints.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&vOutPoints](size_t a, size_t b) { return vOutPoints[a] < vOutPoints[b]; });
+
+        std::vector<Coin> coins(vOutPoints.size());
+        hits.resize(vOutPoints.size());
+        auto process_utxos = [&vOutPoints, &order, &coins, &hits](const CCoinsView& view, const CTxMemPool& mempool) {
+            for (size_t i : order) {
+                hits[i] = !mempool.isSpent(vOutPoints[i]) && view.GetCoin(vOutPoints[i], coins[i]);
             }
         };
 
@@ -505,13 +710,18 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
             CCoinsViewCache& viewChain = *pcoinsTip;
             CCoinsViewMemPool viewMempool(&viewChain, mempool);
             process_utxos(viewMempool, mempool);
+            nChainHeight = chainActive.Height();
+            hashChainTip = chainActive.Tip()->GetBlockHash();
         } else {
             LOCK(cs_main);  // no need to lock mempool!
             process_utxos(*pcoinsTip, CTxMemPool());
+            nChainHeight = chainActive.Height();
+            hashChainTip = chainActive.Tip()->GetBlockHash();
         }
 
         for (size_t i = 0; i < hits.size(); ++i) {
             const bool hit = hits[i];
+            if (hit) outs.emplace_back(std::move(coins[i]));
             bitmapStringRepresentation.append(hit ? "1" : "0"); // form a binary string representation (human-readable for json output)
             bitmap[i / 8] |= ((uint8_t)hit) << (i % 8);
         }
@@ -522,7 +732,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         // serialize data
         // use exact same output as mentioned in Bip64
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nChainHeight << hashChainTip << bitmap << outs;
         std::string ssGetUTXOResponseString = ssGetUTXOResponse.str();
 
         req->WriteHeader("Content-Type", "application/octet-stream");
@@ -532,7 +742,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
     case RetFormat::HEX: {
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nChainHeight << hashChainTip << bitmap << outs;
         std::string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
 
         req->WriteHeader("Content-Type", "text/plain");
@@ -545,8 +755,8 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
         // pack in some essentials
         // use more or less the same output as mentioned in Bip64
-        objGetUTXOResponse.pushKV("chainHeight", chainActive.Height());
-        objGetUTXOResponse.pushKV("chaintipHash", chainActive.Tip()->GetBlockHash().GetHex());
+        objGetUTXOResponse.pushKV("chainHeight", nChainHeight);
+        objGetUTXOResponse.pushKV("chaintipHash", hashChainTip.GetHex());
         objGetUTXOResponse.pushKV("bitmap", bitmapStringRepresentation);
 
         UniValue utxos(UniValue::VARR);
@@ -621,12 +831,198 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+/** Write a reply of the PoC state, which may be cached for REST_POC_MAX_AGE and is tagged by the tip. */
+static void WritePoCReply(HTTPRequest* req, const CRESTPoCSnapshot& snapshot, const char* contentType, std::string&& body)
+{
+    req->WriteHeader("Content-Type", contentType);
+    req->WriteHeader("Cache-Control", strprintf("public, max-age=%d", REST_POC_MAX_AGE));
+    req->WriteHeader("ETag", "\"" + snapshot.hashTip.GetHex() + "\"");
+    req->WriteReply(HTTP_OK, std::move(body));
+}
+
+/** Write the PoC state serialized in ss in the format asked for, or json, built by fn. */
+template <typename F>
+static bool WritePoCData(HTTPRequest* req, RetFormat rf, const CRESTPoCSnapshot& snapshot, const CDataStream& ss, F json)
+{
+    switch (rf) {
+    case RetFormat::BINARY:
+        WritePoCReply(req, snapshot, "application/octet-stream", ss.str());
+        return true;
+    case RetFormat::HEX:
+        WritePoCReply(req, snapshot, "text/plain", HexStr(ss.begin(), ss.end()) + "\n");
+        return true;
+    case RetFormat::JSON: {
+        std::string strJSON;
+        json().write(strJSON);
+        strJSON += "\n";
+        WritePoCReply(req, snapshot, "application/json", std::move(strJSON));
+        return true;
+    }
+    default:
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+}
+
+/** Parse the pay-to-pubkey-hash address the PoC state is keyed by. */
+static bool ParsePoCAddress(HTTPRequest* req, const std::string& str, CKeyID& keyID)
+{
+    const CTxDestination dest = DecodeDestination(str);
+    if (!IsValidDestination(dest) || dest.type() != typeid(CKeyID)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + SanitizeString(str));
+    }
+    keyID = boost::get<CKeyID>(dest);
+    return true;
+}
+
+static bool rest_slot(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    auto snapshot = GetPoCSnapshot();
+
+    int32_t index = snapshot->slots.size() - 1;
+    if (!param.empty() && (!ParseInt32(param, &index) || index < 0)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid slot index: " + SanitizeString(param));
+    }
+    if (index >= (int32_t)snapshot->slots.size()) {
+        return RESTERR(req, HTTP_NOT_FOUND, "Slot index out of range");
+    }
+    const CRESTSlot& slot = snapshot->slots[index];
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << slot;
+    return WritePoCData(req, rf, *snapshot, ss, [&] {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("index", slot.index);
+        obj.pushKV("price", slot.price);
+        obj.pushKV("count", slot.count);
+        obj.pushKV("locktime", slot.locktime);
+        return obj;
+    });
+}
+
+static bool rest_tickets(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    CKeyID keyID;
+    if (!ParsePoCAddress(req, param, keyID))
+        return false;
+    auto snapshot = GetPoCSnapshot();
+
+    static const std::vector<CRESTTicket> noTickets;
+    auto it = snapshot->tickets.find(keyID);
+    const std::vector<CRESTTicket>& tickets = it != snapshot->tickets.end() ? it->second : noTickets;
+    // Each firestone as its outpoint, value, lock height and whether it is spent
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, tickets.size());
+    for (const CRESTTicket& entry : tickets) {
+        ss << entry.ticket->out << entry.ticket->nValue << entry.ticket->LockTime() << entry.fSpent;
+    }
+    return WritePoCData(req, rf, *snapshot, ss, [&] {
+        UniValue results(UniValue::VARR);
+        for (const CRESTTicket& entry : tickets) {
+            std::string state;
+            switch (entry.ticket->State(snapshot->height)) {
+            case CTicket::CTicketState::IMMATURATE:
+                state = "IMMATURATE";
+                break;
+            case CTicket::CTicketState::USEABLE:
+                state = "USEABLE";
+                break;
+            case CTicket::CTicketState::OVERDUE:
+                state = "OVERDUE";
+                break;
+            case CTicket::CTicketState::UNKNOW:
+                state = "UNKNOW";
+                break;
+            }
+            UniValue obj(UniValue::VOBJ);
+            obj.pushKV("outpoint", entry.ticket->out.hash.ToString() + ":" + itostr(entry.ticket->out.n));
+            obj.pushKV("value", ValueFromAmount(entry.ticket->nValue));
+            obj.pushKV("lockheight", entry.ticket->LockTime());
+            obj.pushKV("state", state);
+            obj.pushKV("isSpent", entry.fSpent);
+            results.push_back(obj);
+        }
+        return results;
+    });
+}
+
+static bool rest_binding(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    CKeyID from;
+    if (!ParsePoCAddress(req, param, from))
+        return false;
+    auto snapshot = GetPoCSnapshot();
+
+    CKeyID to;
+    if (snapshot->fPocx) {
+        auto it = snapshot->bindings.find(from);
+        if (it != snapshot->bindings.end())
+            to = it->second;
+    } else {
+        LOCK(cs_main);
+        to = prelationview->To(from, from.GetPlotID(), false);
+    }
+    // Whether the plot is bound, and the key it is bound to
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << !to.IsNull() << to;
+    return WritePoCData(req, rf, *snapshot, ss, [&] {
+        auto keyToJSON = [](const CKeyID& key) {
+            UniValue val(UniValue::VOBJ);
+            val.pushKV("address", EncodeDestination(CTxDestination(key)));
+            val.pushKV("plotid", key.GetPlotID());
+            val.pushKV("publickeyid", key.ToString());
+            return val;
+        };
+        UniValue result(UniValue::VOBJ);
+        if (to.IsNull())
+            return result;
+        result.pushKV("from", keyToJSON(from));
+        result.pushKV("to", keyToJSON(to));
+        return result;
+    });
+}
+
+static bool rest_mininginfo(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    auto snapshot = GetPoCSnapshot();
+
+    const PoCTipInfo& info = snapshot->mining;
+    const uint64_t targetDeadline = Params().TargetDeadline();
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << info.hashTip << info.height << info.genSig << info.baseTarget << targetDeadline;
+    return WritePoCData(req, rf, *snapshot, ss, [&] {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("height", info.height);
+        obj.pushKV("tipHash", info.hashTip.GetHex());
+        obj.pushKV("generationSignature", HexStr<uint256>(info.genSig));
+        obj.pushKV("cumulativeDiff", snapshot->cumulativeDiff);
+        obj.pushKV("baseTarget", info.baseTarget);
+        obj.pushKV("targetDeadline", targetDeadline);
+        return obj;
+    });
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
 } uri_prefixes[] = {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
+      {"/rest/blocks/", rest_blocks},
       {"/rest/block/", rest_block_extended},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
@@ -634,10 +1030,16 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/slot/", rest_slot},
+      {"/rest/tickets/", rest_tickets},
+      {"/rest/binding/", rest_binding},
+      {"/rest/mininginfo", rest_mininginfo},
 };
 
 void StartREST()
 {
+    g_rest_notifications.reset(new CRESTNotifications());
+    RegisterValidationInterface(g_rest_notifications.get(), "rest");
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
 }
@@ -650,4 +1052,9 @@ void StopREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         UnregisterHTTPHandler(uri_prefixes[i].prefix, false);
+    if (g_rest_notifications) {
+        UnregisterValidationInterface(g_rest_notifications.get());
+        g_rest_notifications.reset();
+    }
+    std::atomic_store(&g_rest_poc_snapshot, std::shared_ptr<const CRESTPoCSnapshot>());
 }
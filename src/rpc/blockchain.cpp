@@ -7,6 +7,8 @@
 
 #include <amount.h>
 #include <base58.h>
+#include <blind.h>
+#include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -14,21 +16,25 @@
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
-#include <policy/rbf.h>
 #include <primitives/transaction.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <script/sigcache.h>
 #include <streams.h>
 #include <sync.h>
+#include <ticket.h>
 #include <txdb.h>
 #include <txmempool.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <utxostats.h>
 #include <validation.h>
 #include <validationinterface.h>
 #include <versionbitsinfo.h>
@@ -44,6 +50,7 @@
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 struct CUpdatedBlock
 {
@@ -447,35 +454,32 @@ static std::string EntryDescriptionString()
            "    \"bip125-replaceable\" : true|false,  (boolean) Whether this transaction could be replaced due to BIP125 (replace-by-fee)\n";
 }
 
-static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCKS_REQUIRED(::mempool.cs)
+static void entryToJSON(UniValue &info, const TxMempoolSnapshotEntry &e)
 {
-    AssertLockHeld(mempool.cs);
-
     UniValue fees(UniValue::VOBJ);
-    fees.pushKV("base", ValueFromAmount(e.GetFee()));
-    fees.pushKV("modified", ValueFromAmount(e.GetModifiedFee()));
-    fees.pushKV("ancestor", ValueFromAmount(e.GetModFeesWithAncestors()));
-    fees.pushKV("descendant", ValueFromAmount(e.GetModFeesWithDescendants()));
+    fees.pushKV("base", ValueFromAmount(e.nFee));
+    fees.pushKV("modified", ValueFromAmount(e.nModFee));
+    fees.pushKV("ancestor", ValueFromAmount(e.nModFeesWithAncestors));
+    fees.pushKV("descendant", ValueFromAmount(e.nModFeesWithDescendants));
     info.pushKV("fees", fees);
 
-    info.pushKV("size", (int)e.GetTxSize());
-    info.pushKV("fee", ValueFromAmount(e.GetFee()));
-    info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
-    info.pushKV("time", e.GetTime());
-    info.pushKV("height", (int)e.GetHeight());
-    info.pushKV("descendantcount", e.GetCountWithDescendants());
-    info.pushKV("descendantsize", e.GetSizeWithDescendants());
-    info.pushKV("descendantfees", e.GetModFeesWithDescendants());
-    info.pushKV("ancestorcount", e.GetCountWithAncestors());
-    info.pushKV("ancestorsize", e.GetSizeWithAncestors());
-    info.pushKV("ancestorfees", e.GetModFeesWithAncestors());
-    info.pushKV("wtxid", mempool.vTxHashes[e.vTxHashesIdx].first.ToString());
-    const CTransaction& tx = e.GetTx();
+    info.pushKV("size", (int)e.nTxSize);
+    info.pushKV("fee", ValueFromAmount(e.nFee));
+    info.pushKV("modifiedfee", ValueFromAmount(e.nModFee));
+    info.pushKV("time", e.nTime);
+    info.pushKV("height", (int)e.nHeight);
+    info.pushKV("descendantcount", e.nCountWithDescendants);
+    info.pushKV("descendantsize", e.nSizeWithDescendants);
+    info.pushKV("descendantfees", e.nModFeesWithDescendants);
+    info.pushKV("ancestorcount", e.nCountWithAncestors);
+    info.pushKV("ancestorsize", e.nSizeWithAncestors);
+    info.pushKV("ancestorfees", e.nModFeesWithAncestors);
+    info.pushKV("wtxid", e.wtxid.ToString());
+
     std::set<std::string> setDepends;
-    for (const CTxIn& txin : tx.vin)
+    for (const uint256& parent : e.vParents)
     {
-        if (mempool.exists(txin.prevout.hash))
-            setDepends.insert(txin.prevout.hash.ToString());
+        setDepends.insert(parent.ToString());
     }
 
     UniValue depends(UniValue::VARR);
@@ -487,54 +491,93 @@ static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCK
     info.pushKV("depends", depends);
 
     UniValue spent(UniValue::VARR);
-    const CTxMemPool::txiter &it = mempool.mapTx.find(tx.GetHash());
-    const CTxMemPool::setEntries &setChildren = mempool.GetMemPoolChildren(it);
-    for (CTxMemPool::txiter childiter : setChildren) {
-        spent.push_back(childiter->GetTx().GetHash().ToString());
+    for (const uint256& child : e.vChildren) {
+        spent.push_back(child.ToString());
     }
 
     info.pushKV("spentby", spent);
 
     // Add opt-in RBF status
-    bool rbfStatus = false;
-    RBFTransactionState rbfState = IsRBFOptIn(tx, mempool);
-    if (rbfState == RBFTransactionState::UNKNOWN) {
-        throw JSONRPCError(RPC_MISC_ERROR, "Transaction is not in mempool");
-    } else if (rbfState == RBFTransactionState::REPLACEABLE_BIP125) {
-        rbfStatus = true;
-    }
-
-    info.pushKV("bip125-replaceable", rbfStatus);
+    info.pushKV("bip125-replaceable", e.fReplaceable);
 }
 
 UniValue mempoolToJSON(bool fVerbose)
 {
+    // Read from a snapshot, so explorers polling the mempool don't hold up transaction acceptance
+    const MempoolSnapshotRef snapshot = mempool.GetSnapshot();
     if (fVerbose)
     {
-        LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx)
+        for (const TxMempoolSnapshotEntry& e : snapshot->entries)
         {
-            const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
             entryToJSON(info, e);
-            o.pushKV(hash.ToString(), info);
+            o.pushKV(e.tx->GetHash().ToString(), info);
         }
         return o;
     }
     else
     {
-        std::vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
-
         UniValue a(UniValue::VARR);
-        for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
+        for (const TxMempoolSnapshotEntry& e : snapshot->entries)
+            a.push_back(e.tx->GetHash().ToString());
 
         return a;
     }
 }
 
+/** The in-mempool ancestors (fAncestors) or descendants of e in snapshot by txid, e excluded. */
+static std::map<uint256, const TxMempoolSnapshotEntry*> SnapshotRelatives(const CTxMemPoolSnapshot& snapshot, const TxMempoolSnapshotEntry& e, bool fAncestors)
+{
+    std::map<uint256, const TxMempoolSnapshotEntry*> mapRelatives;
+    std::vector<const TxMempoolSnapshotEntry*> stage{&e};
+    while (!stage.empty()) {
+        const TxMempoolSnapshotEntry* entry = stage.back();
+        stage.pop_back();
+        for (const uint256& txid : fAncestors ? entry->vParents : entry->vChildren) {
+            const TxMempoolSnapshotEntry* relative = snapshot.Find(txid);
+            if (relative && mapRelatives.emplace(txid, relative).second) {
+                stage.push_back(relative);
+            }
+        }
+    }
+    return mapRelatives;
+}
+
+static UniValue getmempoolrelatives(const JSONRPCRequest& request, bool fAncestors)
+{
+    bool fVerbose = false;
+    if (!request.params[1].isNull())
+        fVerbose = request.params[1].get_bool();
+
+    uint256 hash = ParseHashV(request.params[0], "parameter 1");
+
+    const MempoolSnapshotRef snapshot = mempool.GetSnapshot();
+    const TxMempoolSnapshotEntry* e = snapshot->Find(hash);
+    if (!e) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
+    }
+
+    const std::map<uint256, const TxMempoolSnapshotEntry*> mapRelatives = SnapshotRelatives(*snapshot, *e, fAncestors);
+
+    if (!fVerbose) {
+        UniValue o(UniValue::VARR);
+        for (const auto& relative : mapRelatives) {
+            o.push_back(relative.first.ToString());
+        }
+
+        return o;
+    } else {
+        UniValue o(UniValue::VOBJ);
+        for (const auto& relative : mapRelatives) {
+            UniValue info(UniValue::VOBJ);
+            entryToJSON(info, *relative.second);
+            o.pushKV(relative.first.ToString(), info);
+        }
+        return o;
+    }
+}
+
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -602,42 +645,7 @@ static UniValue getmempoolancestors(const JSONRPCRequest& request)
             }.ToString());
     }
 
-    bool fVerbose = false;
-    if (!request.params[1].isNull())
-        fVerbose = request.params[1].get_bool();
-
-    uint256 hash = ParseHashV(request.params[0], "parameter 1");
-
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
-    }
-
-    CTxMemPool::setEntries setAncestors;
-    uint64_t noLimit = std::numeric_limits<uint64_t>::max();
-    std::string dummy;
-    mempool.CalculateMemPoolAncestors(*it, setAncestors, noLimit, noLimit, noLimit, noLimit, dummy, false);
-
-    if (!fVerbose) {
-        UniValue o(UniValue::VARR);
-        for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            o.push_back(ancestorIt->GetTx().GetHash().ToString());
-        }
-
-        return o;
-    } else {
-        UniValue o(UniValue::VOBJ);
-        for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            const CTxMemPoolEntry &e = *ancestorIt;
-            const uint256& _hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.pushKV(_hash.ToString(), info);
-        }
-        return o;
-    }
+    return getmempoolrelatives(request, true);
 }
 
 static UniValue getmempooldescendants(const JSONRPCRequest& request)
@@ -672,42 +680,7 @@ static UniValue getmempooldescendants(const JSONRPCRequest& request)
             }.ToString());
     }
 
-    bool fVerbose = false;
-    if (!request.params[1].isNull())
-        fVerbose = request.params[1].get_bool();
-
-    uint256 hash = ParseHashV(request.params[0], "parameter 1");
-
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
-    }
-
-    CTxMemPool::setEntries setDescendants;
-    mempool.CalculateDescendants(it, setDescendants);
-    // CTxMemPool::CalculateDescendants will include the given tx
-    setDescendants.erase(it);
-
-    if (!fVerbose) {
-        UniValue o(UniValue::VARR);
-        for (CTxMemPool::txiter descendantIt : setDescendants) {
-            o.push_back(descendantIt->GetTx().GetHash().ToString());
-        }
-
-        return o;
-    } else {
-        UniValue o(UniValue::VOBJ);
-        for (CTxMemPool::txiter descendantIt : setDescendants) {
-            const CTxMemPoolEntry &e = *descendantIt;
-            const uint256& _hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.pushKV(_hash.ToString(), info);
-        }
-        return o;
-    }
+    return getmempoolrelatives(request, false);
 }
 
 static UniValue getmempoolentry(const JSONRPCRequest& request)
@@ -733,16 +706,14 @@ static UniValue getmempoolentry(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    const MempoolSnapshotRef snapshot = mempool.GetSnapshot();
+    const TxMempoolSnapshotEntry* e = snapshot->Find(hash);
+    if (!e) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    const CTxMemPoolEntry &e = *it;
     UniValue info(UniValue::VOBJ);
-    entryToJSON(info, e);
+    entryToJSON(info, *e);
     return info;
 }
 
@@ -774,6 +745,176 @@ static UniValue getblockhash(const JSONRPCRequest& request)
     return pblockindex->GetBlockHash().GetHex();
 }
 
+static UniValue getaddressdeltas(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
+        throw std::runtime_error(
+            RPCHelpMan{"getaddressdeltas",
+                "\nReturns the payments, tickets or bindings of an address on the active chain, from the address index.\n"
+                "Requires -addressindex.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address"},
+                    {"type", RPCArg::Type::STR, /* default */ "payment", "The entries to return: \"payment\", \"ticket\" or \"binding\""},
+                    {"start", RPCArg::Type::NUM, /* default */ "0", "The first height"},
+                    {"end", RPCArg::Type::NUM, /* default */ "the tip", "The last height"},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"txid\" : \"hash\",        (string) The transaction id\n"
+            "    \"index\" : n,             (numeric) The output, the input if spending, or 0 for the bound and 1 for the target of a binding\n"
+            "    \"height\" : n,            (numeric) The block height\n"
+            "    \"blockhash\" : \"hash\",   (string) The block hash\n"
+            "    \"spending\" : true|false, (boolean) Whether the entry is an input, or an unbind for bindings\n"
+            "    \"value\" : x.xxx,         (numeric) The amount received (positive) or spent (negative), 0 when blinded\n"
+            "    \"asset\" : \"hex\",        (string, optional) The asset, when it is not the native coin\n"
+            "    \"confidential\" : true|false, (boolean) Whether the amount or the asset is blinded\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddressdeltas", "\"17VkcJoDJEHyuCKgGyky8CGNnb1kPgbwr4\" \"ticket\"")
+            + HelpExampleRpc("getaddressdeltas", "\"17VkcJoDJEHyuCKgGyky8CGNnb1kPgbwr4\", \"ticket\"")
+                },
+            }.ToString());
+
+    if (!g_addressindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The address index is not enabled, start with -addressindex");
+    }
+
+    CTxDestination dest = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(dest)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    AddressIndexType type = AddressIndexType::PAYMENT;
+    if (!request.params[1].isNull()) {
+        const std::string& type_name = request.params[1].get_str();
+        if (type_name == "ticket") {
+            type = AddressIndexType::TICKET;
+        } else if (type_name == "binding") {
+            type = AddressIndexType::BINDING;
+        } else if (type_name != "payment") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown type " + type_name);
+        }
+    }
+
+    int start = request.params[2].isNull() ? 0 : request.params[2].get_int();
+    int end;
+    {
+        LOCK(cs_main);
+        end = chainActive.Height();
+    }
+    if (!request.params[3].isNull()) {
+        end = std::min(end, request.params[3].get_int());
+    }
+    if (start < 0 || start > end) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    }
+
+    g_addressindex->BlockUntilSyncedToCurrentChain();
+
+    std::vector<CAddressIndexEntry> entries;
+    if (!g_addressindex->FindEntries(type, GetAddressIndexScriptHash(GetScriptForDestination(dest)), start, end, entries)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to read the address index");
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const CAddressIndexEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("txid", entry.first.txid.GetHex());
+        obj.pushKV("index", (int64_t)entry.first.index);
+        obj.pushKV("height", entry.first.height);
+        obj.pushKV("blockhash", entry.second.block_hash.GetHex());
+        obj.pushKV("spending", entry.first.spending);
+        obj.pushKV("value", ValueFromAmount(entry.second.value));
+        if (!entry.second.asset.IsNull()) {
+            obj.pushKV("asset", entry.second.asset.GetHex());
+        }
+        obj.pushKV("confidential", entry.second.confidential);
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getblockfilter",
+                "\nRetrieve a BIP 157 content filter for a particular block.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The hash of the block"},
+                    {"filtertype", RPCArg::Type::STR, /* default */ "basic", "The type name of the filter"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+                },
+            }.ToString());
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    if (!g_blockfilterindex || g_blockfilterindex->GetFilterType() != filtertype) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = g_blockfilterindex->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!g_blockfilterindex->LookupFilter(block_index, filter) ||
+        !g_blockfilterindex->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
 static UniValue getblockheader(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
@@ -947,6 +1088,19 @@ static UniValue getblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
 
+    // Blocks are stored serialized with witness, so return them as they are unless asked otherwise.
+    if (verbosity <= 0 && !(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS))
+    {
+        if (IsBlockPruned(pblockindex)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        }
+        RawBlockData block_data;
+        if (!ReadRawBlockFromDisk(block_data, pblockindex, Params().MessageStart())) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        }
+        return HexStr(block_data.data.begin(), block_data.data.end());
+    }
+
     const CBlock block = GetBlockChecked(pblockindex);
 
     if (verbosity <= 0)
@@ -965,13 +1119,12 @@ struct CCoinsStats
     int nHeight;
     uint256 hashBlock;
     uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nBogoSize;
     uint256 hashSerialized;
     uint64_t nDiskSize;
-    CAmount nTotalAmount;
+    //! The statistics kept up to date block by block, from the scan
+    CUTXOStats utxo;
 
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
+    CCoinsStats() : nHeight(0), nTransactions(0), nDiskSize(0) {}
 };
 
 static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
@@ -984,17 +1137,12 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
         ss << VARINT(output.first + 1);
         ss << output.second.out.scriptPubKey;
         ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
-        stats.nTransactionOutputs++;
         if (output.second.out.IsCA()) {
             ss << output.second.out.nValue;
             ss << output.second.out.nAsset;
             ss << output.second.out.nNonce;
-            if (output.second.out.nValueCA.IsExplicit()) {
-                stats.nTotalAmount += output.second.out.nValueCA.GetAmount();
-            }
         }
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        stats.utxo.AddCoin(COutPoint(hash, output.first), output.second);
     }
     ss << VARINT(0u);
 }
@@ -1012,6 +1160,7 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
     }
     ss << stats.hashBlock;
+    stats.utxo.hashBlock = stats.hashBlock;
     uint256 prevkey;
     std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
@@ -1091,51 +1240,222 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
     return uint64_t(height);
 }
 
+/** Add the statistics kept up to date block by block to ret. */
+static void PushUTXOStats(UniValue& ret, const CUTXOStats& stats)
+{
+    uint256 muhash;
+    stats.muhash.Finalize(muhash);
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    ret.pushKV("muhash", muhash.GetHex());
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    CAmountMap amounts = stats.assetAmounts;
+    amounts[::policyAsset] = stats.nTotalAmount;
+    ret.pushKV("amounts", AmountMapToUniv(amounts, CAsset()));
+    ret.pushKV("confidential_txouts", (int64_t)stats.nConfidentialOutputs);
+}
+
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {},
+                "The statistics are kept up to date as blocks are connected, unless hash_type is hash_serialized_2,\n"
+                "which reads the whole set and may take some time.\n",
+                {
+                    {"hash_type", RPCArg::Type::STR, /* default */ "muhash", "Which UTXO set hash should be calculated. Options: 'muhash', 'hash_serialized_2'."},
+                },
                 RPCResult{
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (only with hash_serialized_2)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only with hash_serialized_2)\n"
+            "  \"muhash\": \"hash\",       (string) The MuHash of the set, the same for both hash types\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"total_amount\": x.xxx   (numeric) The total amount of LV\n"
+            "  \"amounts\": {            (json object) The total explicit amount of each asset\n"
+            "     \"asset\": x.xxx,      (numeric) The amount of the asset, LV or the hex of an issued asset\n"
+            "     ...\n"
+            "  },\n"
+            "  \"confidential_txouts\": n (numeric) The outputs of issued assets whose asset or amount is blinded, left out of amounts\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"hash_serialized_2\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
                 },
             }.ToString());
 
+    const std::string hash_type = request.params[0].isNull() ? "muhash" : request.params[0].get_str();
+    if (hash_type != "muhash" && hash_type != "hash_serialized_2")
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type));
+
     UniValue ret(UniValue::VOBJ);
 
+    if (hash_type == "muhash") {
+        CUTXOStats stats;
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            if (!GetUTXOStatsAtTip(stats))
+                throw JSONRPCError(RPC_MISC_ERROR, "The UTXO set statistics are being rebuilt, try again later or use hash_serialized_2");
+            pindex = LookupBlockIndex(stats.hashBlock);
+        }
+        ret.pushKV("height", pindex ? pindex->nHeight : -1);
+        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+        PushUTXOStats(ret, stats);
+        ret.pushKV("disk_size", pcoinsdbview->EstimateSize());
+        return ret;
+    }
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview.get(), stats)) {
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+        PushUTXOStats(ret, stats.utxo);
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
         ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
     return ret;
 }
 
+/** Magic bytes opening a chainstate snapshot written by dumptxoutset. */
+static const unsigned char SNAPSHOT_MAGIC[4] = {'l', 'v', 's', 's'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+/** Writes the records of a snapshot to its file and into the hash committing to them. */
+class SnapshotWriter
+{
+private:
+    CAutoFile& file;
+    CHashWriter hasher;
+
+public:
+    explicit SnapshotWriter(CAutoFile& fileIn) : file(fileIn), hasher(SER_DISK, CLIENT_VERSION) {}
+
+    template <typename T>
+    SnapshotWriter& operator<<(const T& obj)
+    {
+        file << obj;
+        hasher << obj;
+        return *this;
+    }
+
+    uint256 GetHash() { return hasher.GetHash(); }
+};
+
+/** Write every record of a view database as a run of serialized key/value pairs, closed by a false flag. */
+static uint64_t WriteSnapshotRecords(SnapshotWriter& writer, CDBIterator& cursor)
+{
+    uint64_t count = 0;
+    for (cursor.SeekToFirst(); cursor.Valid(); cursor.Next()) {
+        boost::this_thread::interruption_point();
+        writer << true << cursor.GetKeySerialized() << cursor.GetValueSerialized();
+        count++;
+    }
+    writer << false;
+    return count;
+}
+
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"dumptxoutset",
+                "\nWrite the unspent transaction output set, the firestones and the relations at the tip to a snapshot file.\n"
+                "The coins are written in their compressed database form, and the file ends with a hash committing to its content.\n"
+                "Note this call may take some time.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "Path to the output file. If relative, will be prefixed by datadir."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"coins_written\": n,       (numeric) The number of coins written\n"
+            "  \"firestone_records\": n,   (numeric) The number of firestone database records written\n"
+            "  \"relation_records\": n,    (numeric) The number of relation database records written\n"
+            "  \"base_hash\": \"hash\",      (string) The hash of the block the snapshot was taken at\n"
+            "  \"base_height\": n,         (numeric) The height of the block the snapshot was taken at\n"
+            "  \"path\": \"path\",           (string) The absolute path of the snapshot\n"
+            "  \"hash\": \"hash\"            (string) The hash of the snapshot content, as written at its end\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+                },
+            }.ToString());
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary path first, so a partial snapshot is never mistaken for a whole one.
+    const fs::path temppath = fs::absolute(request.params[0].get_str() + ".incomplete", GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. If you are sure this is what you want, move it out of the way first");
+    }
+
+    // The chainstate and the views are flushed together, then read from cursors on that flush.
+    FlushStateToDisk();
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::unique_ptr<CDBIterator> pticketcursor;
+    std::unique_ptr<CDBIterator> prelationcursor;
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        pcursor.reset(pcoinsdbview->Cursor());
+        tip = LookupBlockIndex(pcursor->GetBestBlock());
+        if (tip == nullptr || pticketview->GetBestBlock() != tip->GetBlockHash() || prelationview->GetBestBlock() != tip->GetBlockHash()) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "The chainstate and the firestone and relation databases are not flushed at the same block");
+        }
+        pticketcursor.reset(pticketview->NewIterator());
+        prelationcursor.reset(prelationview->NewIterator());
+    }
+
+    CAutoFile afile(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + temppath.string() + " for writing.");
+    }
+    SnapshotWriter writer(afile);
+    writer << SNAPSHOT_MAGIC << SNAPSHOT_VERSION << tip->GetBlockHash() << tip->nHeight;
+
+    uint64_t nCoins = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        writer << true << key << coin;
+        nCoins++;
+    }
+    writer << false;
+    const uint64_t nTicketRecords = WriteSnapshotRecords(writer, *pticketcursor);
+    const uint64_t nRelationRecords = WriteSnapshotRecords(writer, *prelationcursor);
+
+    const uint256 hash = writer.GetHash();
+    afile << hash;
+    afile.fclose();
+    fs::rename(temppath, path);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("coins_written", nCoins);
+    result.pushKV("firestone_records", nTicketRecords);
+    result.pushKV("relation_records", nRelationRecords);
+    result.pushKV("base_hash", tip->GetBlockHash().ToString());
+    result.pushKV("base_height", tip->nHeight);
+    result.pushKV("path", path.string());
+    result.pushKV("hash", hash.ToString());
+    return result;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1352,6 +1672,7 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"chainwork\": \"xxxx\"           (string) total amount of work in active chain, in hexadecimal\n"
             "  \"size_on_disk\": xxxxxx,       (numeric) the estimated size of the block and undo files on disk\n"
             "  \"pruned\": xx,                 (boolean) if the blocks are subject to pruning\n"
+            "  \"headersonly\": xx,            (boolean) if only headers are synced, as with -headersonly\n"
             "  \"pruneheight\": xxxxxx,        (numeric) lowest-height complete block stored (only present if pruning is enabled)\n"
             "  \"automatic_pruning\": xx,      (boolean) whether automatic pruning is enabled (only present if pruning is enabled)\n"
             "  \"prune_target_size\": xxxxxx,  (numeric) the target size used by pruning (only present if automatic pruning is enabled)\n"
@@ -1404,6 +1725,7 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     obj.pushKV("cumulativeDiff",        tip->nCumulativeDiff.GetHex());
     obj.pushKV("size_on_disk",          CalculateCurrentUsage());
     obj.pushKV("pruned",                fPruneMode);
+    obj.pushKV("headersonly",           fHeadersOnly);
     if (fPruneMode) {
         const CBlockIndex* block = tip;
         assert(block);
@@ -1568,6 +1890,12 @@ UniValue mempoolInfoToJSON()
     ret.pushKV("maxmempool", (int64_t) maxmempool);
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(mempool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    ret.pushKV("firestones", (int64_t) mempool.TicketTxCount());
+    {
+        LOCK2(cs_main, mempool.cs);
+        const int nHeight = chainActive.Height() + 1;
+        ret.pushKV("firestones_in_slot", (int64_t) mempool.GetTicketTxs(pticketview->LockTime(nHeight / pticketview->SlotLength())).size());
+    }
 
     return ret;
 }
@@ -1587,6 +1915,8 @@ static UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
+            "  \"firestones\": xxxxx          (numeric) Number of firestone purchases\n"
+            "  \"firestones_in_slot\": xxxxx  (numeric) Number of firestone purchases that buy their firestone if mined in the slot of the next block\n"
             "}\n"
                 },
                 RPCExamples{
@@ -2142,35 +2472,160 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
-//! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
+static UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            RPCHelpMan{"getsigcacheinfo",
+                "\nReturns the use of the signature, range proof and surjection proof caches since startup.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"name\": {               (json object) The cache, by name\n"
+            "    \"capacity\": n,        (numeric) The room for entries\n"
+            "    \"entries\": n,         (numeric) An estimate of the entries held\n"
+            "    \"hits\": n,            (numeric) The verifications found in the cache\n"
+            "    \"misses\": n,          (numeric) The verifications not found\n"
+            "    \"hitrate\": x.xxx,     (numeric) The share of lookups that were hits\n"
+            "    \"rejected\": n,        (numeric) The entries left out of the full cache, as cheaper to verify again than the average\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+                },
+            }.ToString());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    for (const SignatureCacheStats& stats : GetSignatureCacheStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("capacity", (uint64_t)stats.nCapacity);
+        obj.pushKV("entries", (uint64_t)stats.nEntries);
+        obj.pushKV("hits", stats.nHits);
+        obj.pushKV("misses", stats.nMisses);
+        const uint64_t nLookups = stats.nHits + stats.nMisses;
+        obj.pushKV("hitrate", nLookups ? (double)stats.nHits / nLookups : 0.0);
+        obj.pushKV("rejected", stats.nRejected);
+        result.pushKV(stats.name, obj);
+    }
+    return result;
+}
+
+//! The number of ranges of the UTXO keyspace a scan hands out to its threads
+static const int SCAN_TXOUTSET_SHARDS = 64;
+
+//! The first txid byte of the given range of the UTXO keyspace
+static int ScanShardBegin(int shard)
+{
+    return shard * 256 / SCAN_TXOUTSET_SHARDS;
+}
+
+//! Search for a given set of pubkey scripts, given a cursor at the beginning of each range
+//! of the UTXO keyspace. The ranges are scanned on a thread per core, each keeping its own
+//! matches, which are merged once all are done.
+bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, const std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     scan_progress = 0;
     count = 0;
-    while (cursor->Valid()) {
-        COutPoint key;
-        Coin coin;
-        if (!cursor->GetKey(key) || !cursor->GetValue(coin)) return false;
-        if (++count % 8192 == 0) {
-            boost::this_thread::interruption_point();
+    std::vector<std::map<COutPoint, Coin>> vResults(cursors.size());
+    std::atomic<size_t> nNext{0};
+    std::atomic<int64_t> nCount{0};
+    // How far the scan is, in two-byte txid prefixes of the 65536 there are
+    std::atomic<uint32_t> nPrefixesDone{0};
+    std::atomic<bool> fStop{false};
+    // Only the calling thread may be interrupted.
+    auto fnScan = [&](bool fInterruptible) {
+        while (!fStop) {
             if (should_abort) {
-                // allow to abort the scan via the abort reference
-                return false;
+                fStop = true;
+                return;
             }
+            const size_t i = nNext++;
+            if (i >= cursors.size())
+                return;
+            CCoinsViewCursor* cursor = cursors[i].get();
+            const uint32_t nEnd = 0x100 * ScanShardBegin(i + 1);
+            uint32_t nPos = 0x100 * ScanShardBegin(i);
+            int64_t n = 0;
+            for (; cursor->Valid() && !fStop; cursor->Next()) {
+                COutPoint key;
+                Coin coin;
+                if (!cursor->GetKey(key) || !cursor->GetValue(coin)) {
+                    fStop = true;
+                    break;
+                }
+                const uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
+                if (high >= nEnd)
+                    break;
+                if (++n % 256 == 0) {
+                    nPrefixesDone += high - nPos;
+                    nPos = high;
+                    scan_progress = (int)(nPrefixesDone * 100.0 / 65536.0 + 0.5);
+                }
+                if (n % 8192 == 0) {
+                    // allow to abort the scan via the abort reference
+                    if (should_abort || (fInterruptible && boost::this_thread::interruption_requested()))
+                        fStop = true;
+                }
+                if (needles.count(coin.out.scriptPubKey)) {
+                    vResults[i].emplace(key, coin);
+                }
+            }
+            nPrefixesDone += nEnd - nPos;
+            nCount += n;
         }
-        if (count % 256 == 0) {
-            // update progress reference every 256 item
-            uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
-        }
-        if (needles.count(coin.out.scriptPubKey)) {
-            out_results.emplace(key, coin);
-        }
-        cursor->Next();
+    };
+    std::vector<std::thread> threads;
+    const size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), cursors.size());
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.emplace_back(fnScan, false);
+    }
+    fnScan(true);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    boost::this_thread::interruption_point();
+    count = nCount;
+    if (fStop)
+        return false;
+    for (std::map<COutPoint, Coin>& results : vResults) {
+        out_results.insert(results.begin(), results.end());
     }
     scan_progress = 100;
     return true;
 }
 
+/**
+ * Add the amount and asset of a blinded output found by scantxoutset, and their blinding
+ * factors, if the blinding key rewinds its rangeproof. The chainstate keeps neither the
+ * nonce nor the rangeproof, so they are read from the block of the output, if it is on disk.
+ */
+static void PushUnblindedOutput(UniValue& unspent, const CKey& blinding_key, const COutPoint& outpoint, const Coin& coin)
+{
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = chainActive[coin.nHeight];
+    }
+    CTransactionRef tx;
+    uint256 hash_block;
+    if (!pindex || !GetTransaction(outpoint.hash, tx, Params().GetConsensus(), hash_block, pindex) || outpoint.n >= tx->vout.size())
+        return;
+    const CTxOut& txo = tx->vout[outpoint.n];
+    CAmount amount;
+    uint256 amount_blinder;
+    CAsset asset;
+    uint256 asset_blinder;
+    if (!UnblindConfidentialPair(blinding_key, coin.out.nValueCA, coin.out.nAsset, txo.nNonce, coin.out.scriptPubKey, txo.vchRangeproof, amount, amount_blinder, asset, asset_blinder))
+        return;
+    unspent.pushKV("amount", ValueFromAmount(amount));
+    unspent.pushKV("asset", asset.GetHex());
+    unspent.pushKV("amountblinder", amount_blinder.GetHex());
+    unspent.pushKV("assetblinder", asset_blinder.GetHex());
+}
+
 /** RAII object to prevent concurrency issue when scanning the txout set */
 static std::mutex g_utxosetscan;
 static std::atomic<int> g_scan_progress;
@@ -2219,6 +2674,7 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                 "or more path elements separated by \"/\", and optionally ending in \"/*\" (unhardened), or \"/*'\" or \"/*h\" (hardened) to specify all\n"
                 "unhardened or hardened child keys.\n"
                 "In the latter case, a range needs to be specified by below if different from 1000.\n"
+                "The outputs whose asset or amount is blinded are unblinded if the blinding key of their descriptor is given.\n"
                 "For more information on output descriptors, see the documentation in the doc/descriptors.md file.\n",
                 {
                     {"action", RPCArg::Type::STR, RPCArg::Optional::NO, "The action to execute\n"
@@ -2233,6 +2689,7 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                                 {
                                     {"desc", RPCArg::Type::STR, RPCArg::Optional::NO, "An output descriptor"},
                                     {"range", RPCArg::Type::RANGE, /* default */ "1000", "The range of HD chain indexes to explore (either end or [begin,end])"},
+                                    {"blindingkey", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "The private blinding key in hex of the outputs to the descriptor"},
                                 },
                             },
                         },
@@ -2247,6 +2704,11 @@ UniValue scantxoutset(const JSONRPCRequest& request)
             "    \"scriptPubKey\" : \"script\",    (string) the script key\n"
             "    \"desc\" : \"descriptor\",        (string) A specialized descriptor for the matched scriptPubKey\n"
             "    \"amount\" : x.xxx,             (numeric) The total amount in " + CURRENCY_UNIT + " of the unspent output\n"
+            "    \"amountcommitment\" : \"hex\",   (string) The commitment to the amount, if it is blinded\n"
+            "    \"asset\" : \"hex\",              (string) The asset of an output of an issued asset\n"
+            "    \"assetcommitment\" : \"hex\",    (string) The commitment to the asset, if it is blinded\n"
+            "    \"amountblinder\" : \"hex\",      (string) The blinding factor of the amount, if it was unblinded\n"
+            "    \"assetblinder\" : \"hex\",       (string) The blinding factor of the asset, if it was unblinded\n"
             "    \"height\" : n,                 (numeric) Height of the unspent transaction output\n"
             "   }\n"
             "   ,...], \n"
@@ -2284,12 +2746,14 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         }
         std::set<CScript> needles;
         std::map<CScript, std::string> descriptors;
+        std::map<CScript, CKey> blinding_keys;
         CAmount total_in = 0;
 
         // loop through the scan objects
         for (const UniValue& scanobject : request.params[1].get_array().getValues()) {
             std::string desc_str;
             std::pair<int64_t, int64_t> range = {0, 1000};
+            CKey blinding_key;
             if (scanobject.isStr()) {
                 desc_str = scanobject.get_str();
             } else if (scanobject.isObject()) {
@@ -2301,6 +2765,13 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                     range = ParseRange(range_uni);
                     if (range.first < 0 || (range.second >> 31) != 0 || range.second >= range.first + 1000000) throw JSONRPCError(RPC_INVALID_PARAMETER, "range out of range");
                 }
+                UniValue key_uni = find_value(scanobject, "blindingkey");
+                if (!key_uni.isNull()) {
+                    std::vector<unsigned char> keydata = ParseHexV(key_uni, "blindingkey");
+                    if (keydata.size() != 32) throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid hexadecimal key length");
+                    blinding_key.Set(keydata.begin(), keydata.end(), true);
+                    if (!blinding_key.IsValid()) throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid blinding key");
+                }
             } else {
                 throw JSONRPCError(RPC_INVALID_PARAMETER, "Scan object needs to be either a string or an object");
             }
@@ -2322,6 +2793,7 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                 for (const auto& script : scripts) {
                     std::string inferred = InferDescriptor(script, provider)->ToString();
                     needles.emplace(script);
+                    if (blinding_key.IsValid()) blinding_keys[script] = blinding_key;
                     descriptors.emplace(std::move(script), std::move(inferred));
                 }
             }
@@ -2334,14 +2806,19 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         g_should_abort_scan = false;
         g_scan_progress = 0;
         int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         {
             LOCK(cs_main);
             FlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
-            assert(pcursor);
+            // The cursors are all made before the set changes again, so they read the same state.
+            for (int i = 0; i < SCAN_TXOUTSET_SHARDS; i++) {
+                uint256 start;
+                *start.begin() = ScanShardBegin(i);
+                cursors.emplace_back(pcoinsdbview->Cursor(start));
+                assert(cursors.back());
+            }
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins);
+        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, cursors, needles, coins);
         result.pushKV("success", res);
         result.pushKV("searched_items", count);
 
@@ -2368,6 +2845,10 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                 } else {
                     unspent.pushKV("assetcommitment", HexStr(txo.nAsset.vchCommitment));
                 }
+                auto key_it = blinding_keys.find(txo.scriptPubKey);
+                if (key_it != blinding_keys.end() && (!txo.nValueCA.IsExplicit() || !txo.nAsset.IsExplicit())) {
+                    PushUnblindedOutput(unspent, key_it->second, outpoint, coin);
+                }
             } else {
                 unspent.pushKV("amount", ValueFromAmount(txo.nValue));
             }
@@ -2396,6 +2877,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
+    { "blockchain",         "getaddressdeltas",       &getaddressdeltas,       {"address","type","start","end"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash","filtertype"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
@@ -2403,14 +2886,16 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
+    { "blockchain",         "getsigcacheinfo",        &getsigcacheinfo,        {} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
-    //{ "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
+    { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
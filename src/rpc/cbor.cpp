@@ -0,0 +1,112 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/cbor.h>
+
+#include <util/strencodings.h>
+
+#include <univalue.h>
+
+#include <string.h>
+
+enum CBORMajorType : uint8_t {
+    CBOR_UNSIGNED = 0,
+    CBOR_NEGATIVE = 1,
+    CBOR_TEXT = 3,
+    CBOR_ARRAY = 4,
+    CBOR_MAP = 5,
+    CBOR_SIMPLE = 7,
+};
+
+static const uint8_t CBOR_FALSE = 20;
+static const uint8_t CBOR_TRUE = 21;
+static const uint8_t CBOR_NULL = 22;
+static const uint8_t CBOR_DOUBLE = 27;
+
+/** Append the head of an item: its major type and argument, in the shortest form. */
+static void WriteHead(CBORMajorType type, uint64_t arg, std::string& out)
+{
+    const char major = (char)(type << 5);
+    int bytes;
+    if (arg < 24) {
+        out += (char)(major | arg);
+        return;
+    } else if (arg <= 0xff) {
+        out += (char)(major | 24);
+        bytes = 1;
+    } else if (arg <= 0xffff) {
+        out += (char)(major | 25);
+        bytes = 2;
+    } else if (arg <= 0xffffffff) {
+        out += (char)(major | 26);
+        bytes = 4;
+    } else {
+        out += (char)(major | 27);
+        bytes = 8;
+    }
+    for (int i = bytes - 1; i >= 0; i--)
+        out += (char)((arg >> (8 * i)) & 0xff);
+}
+
+static void WriteText(const std::string& str, std::string& out)
+{
+    WriteHead(CBOR_TEXT, str.size(), out);
+    out += str;
+}
+
+static void WriteNumber(const std::string& str, std::string& out)
+{
+    uint64_t u;
+    int64_t n;
+    double d;
+    if (ParseUInt64(str, &u)) {
+        WriteHead(CBOR_UNSIGNED, u, out);
+    } else if (ParseInt64(str, &n)) {
+        // A negative integer is encoded as -1 - arg
+        WriteHead(CBOR_NEGATIVE, (uint64_t)(-(n + 1)), out);
+    } else if (ParseDouble(str, &d)) {
+        uint64_t bits;
+        static_assert(sizeof(bits) == sizeof(d), "double is not 64 bits");
+        memcpy(&bits, &d, sizeof(bits));
+        out += (char)((CBOR_SIMPLE << 5) | CBOR_DOUBLE);
+        for (int i = 7; i >= 0; i--)
+            out += (char)((bits >> (8 * i)) & 0xff);
+    } else {
+        // Not a number univalue writes, keep its text
+        WriteText(str, out);
+    }
+}
+
+void EncodeCBOR(const UniValue& value, std::string& out)
+{
+    switch (value.getType()) {
+    case UniValue::VNULL:
+        WriteHead(CBOR_SIMPLE, CBOR_NULL, out);
+        break;
+    case UniValue::VBOOL:
+        WriteHead(CBOR_SIMPLE, value.get_bool() ? CBOR_TRUE : CBOR_FALSE, out);
+        break;
+    case UniValue::VNUM:
+        WriteNumber(value.getValStr(), out);
+        break;
+    case UniValue::VSTR:
+        WriteText(value.get_str(), out);
+        break;
+    case UniValue::VARR:
+        WriteHead(CBOR_ARRAY, value.size(), out);
+        for (const UniValue& item : value.getValues())
+            EncodeCBOR(item, out);
+        break;
+    case UniValue::VOBJ: {
+        const std::vector<std::string>& keys = value.getKeys();
+        const std::vector<UniValue>& values = value.getValues();
+        WriteHead(CBOR_MAP, keys.size(), out);
+        for (size_t i = 0; i < keys.size(); i++) {
+            WriteText(keys[i], out);
+            EncodeCBOR(values[i], out);
+        }
+        break;
+    }
+    }
+}
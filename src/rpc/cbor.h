@@ -0,0 +1,22 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_RPC_CBOR_H
+#define LAVA_RPC_CBOR_H
+
+#include <string>
+
+class UniValue;
+
+/** The media type of CBOR encoded replies */
+static const char* const CBOR_CONTENT_TYPE = "application/cbor";
+
+/**
+ * Encode a JSON value as CBOR (RFC 7049), appending it to out. Integral numbers become
+ * CBOR integers and other numbers doubles; strings, arrays and objects map to text
+ * strings, arrays and maps of definite length.
+ */
+void EncodeCBOR(const UniValue& value, std::string& out);
+
+#endif // LAVA_RPC_CBOR_H
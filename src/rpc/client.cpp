@@ -71,7 +71,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendmany", 5 , "replaceable" },
     { "sendmany", 6 , "conf_target" },
     { "deriveaddresses", 1, "range" },
-    //{ "scantxoutset", 1, "scanobjects" },
+    { "scantxoutset", 1, "scanobjects" },
     { "addmultisigaddress", 0, "nrequired" },
     { "addmultisigaddress", 1, "keys" },
     { "createmultisig", 0, "nrequired" },
@@ -96,6 +96,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "signrawtransactionwithkey", 2, "prevtxs" },
     { "signrawtransactionwithwallet", 1, "prevtxs" },
     { "sendrawtransaction", 1, "allowhighfees" },
+    { "submitpackage", 0, "rawtxs" },
+    { "submitpackage", 1, "allowhighfees" },
     { "testmempoolaccept", 0, "rawtxs" },
     { "testmempoolaccept", 1, "allowhighfees" },
     //{ "combinerawtransaction", 0, "txs" },
@@ -130,6 +132,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importmulti", 1, "options" },
     { "verifychain", 0, "checklevel" },
     { "verifychain", 1, "nblocks" },
+    { "getaddressdeltas", 2, "start" },
+    { "getaddressdeltas", 3, "end" },
     { "getblockstats", 0, "hash_or_height" },
     { "getblockstats", 1, "stats" },
     { "pruneblockchain", 0, "height" },
@@ -148,6 +152,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "bumpfee", 1, "options" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
+    { "getlockprofile", 0, "count" },
     { "disconnectnode", 1, "nodeid" },
     // Echo with conversion (For testing only)
     { "echojson", 0, "arg0" },
@@ -167,6 +172,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getnodeaddresses", 0, "count"},
     { "stop", 0, "wait" },
     { "getmineraddress", 0, "new" },
+    { "getmininginfo", 1, "timeout" },
+    { "getforginginfo", 0, "count" },
+    { "getnetworkcapacity", 0, "nblocks" },
+    { "submitnonces", 0, "submissions" },
+    { "buyfirestones", 2, "count" },
+    { "presignfstx", 0, "slotindex" },
     { "listslotfs", 0, "index" },
     { "listslotfs", 1, "all" },
     { "getfirestone", 1, "all" },
@@ -125,10 +125,21 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount
-            && !CheckProofOfCapacity(pblock->genSign, nHeight, pblock->nPublicKeyID, pblock->nNonce, pblock->nBaseTarget, pblock->nDeadline, params.TargetDeadline())) {
-                ++pblock->nNonce;
-                --nMaxTries;
+        if (params.GetConsensus().fFastPoC) {
+            // Forge with the best of the nonces kept in memory, any deadline is valid.
+            for (uint64_t nonce = 0; nonce < FAST_POC_NONCES; nonce++) {
+                const uint64_t deadline = CalcDeadline(pblock->genSign, nHeight + 1, pblock->nPublicKeyID, nonce);
+                if (nonce == 0 || deadline < pblock->nDeadline) {
+                    pblock->nNonce = nonce;
+                    pblock->nDeadline = deadline;
+                }
+            }
+        } else {
+            while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount
+                && !CheckProofOfCapacity(pblock->genSign, nHeight, pblock->nPublicKeyID, pblock->nNonce, pblock->nBaseTarget, pblock->nDeadline, params.TargetDeadline())) {
+                    ++pblock->nNonce;
+                    --nMaxTries;
+            }
         }
         if (nMaxTries == 0) {
             break;
@@ -757,7 +768,7 @@ static UniValue submitblock(const JSONRPCRequest& request)
 
     bool new_block;
     submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
+    RegisterValidationInterface(&sc, "submitblock");
     bool accepted = ProcessNewBlock(Params(), blockptr, /* fForceProcessing */ true, /* fNewBlock */ &new_block);
     UnregisterValidationInterface(&sc);
     if (!new_block && accepted) {
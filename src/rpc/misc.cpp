@@ -10,6 +10,7 @@
 #include <key_io.h>
 #include <validation.h>
 #include <httpserver.h>
+#include <metrics.h>
 #include <net.h>
 #include <netbase.h>
 #include <outputtype.h>
@@ -772,6 +773,143 @@ UniValue logging(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue getmetrics(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getmetrics",
+                "\nReturns the counters and latency histograms of the node. Durations are in microseconds,\n"
+                "a percentile is the upper bound of the bucket it falls in, within 1/8 of the value.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"counters\": {            (json object) The counters, by name\n"
+            "    \"name\": n,             (numeric) The count\n"
+            "    ...\n"
+            "  },\n"
+            "  \"histograms\": {          (json object) The latency histograms, by name\n"
+            "    \"name\": {\n"
+            "      \"count\": n,          (numeric) The number of durations recorded\n"
+            "      \"sum\": n,            (numeric) Their sum\n"
+            "      \"max\": n,            (numeric) The longest\n"
+            "      \"p50\": n,            (numeric) The median\n"
+            "      \"p90\": n,            (numeric) The 90th percentile\n"
+            "      \"p99\": n,            (numeric) The 99th percentile\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getmetrics", "")
+            + HelpExampleRpc("getmetrics", "")
+                },
+            }.ToString());
+
+    UniValue counters(UniValue::VOBJ);
+    for (const CMetricCounter* counter : GetMetrics().GetCounters()) {
+        counters.pushKV(counter->name, counter->Get());
+    }
+    UniValue histograms(UniValue::VOBJ);
+    for (const CMetricHistogram* histogram : GetMetrics().GetHistograms()) {
+        const CMetricHistogram::Summary summary = histogram->GetSummary();
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", summary.count);
+        obj.pushKV("sum", summary.sum);
+        obj.pushKV("max", summary.max);
+        obj.pushKV("p50", summary.Percentile(0.5));
+        obj.pushKV("p90", summary.Percentile(0.9));
+        obj.pushKV("p99", summary.Percentile(0.99));
+        histograms.pushKV(histogram->name, obj);
+    }
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("counters", counters);
+    result.pushKV("histograms", histograms);
+    return result;
+}
+
+static UniValue LockProfileSummaryToJSON(const CMetricHistogram::Summary& summary)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", summary.count);
+    obj.pushKV("sum", summary.sum);
+    obj.pushKV("max", summary.max);
+    obj.pushKV("p50", summary.Percentile(0.5));
+    obj.pushKV("p99", summary.Percentile(0.99));
+    return obj;
+}
+
+static UniValue getlockprofile(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getlockprofile",
+                "\nReturns the lock acquisition sites recorded with -lockprofile, the longest total wait first.\n"
+                "Every acquisition that waited records its wait; the hold time is sampled, one in " + std::to_string(LOCK_PROFILE_HOLD_SAMPLE) + "\n"
+                "acquisitions, and includes time spent waiting on a condition. Durations are in microseconds.\n",
+                {
+                    {"count", RPCArg::Type::NUM, /* default */ "20", "The number of sites to return, 0 for all"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"enabled\": true|false,   (boolean) Whether -lockprofile is recording\n"
+            "  \"sites\": [\n"
+            "    {\n"
+            "      \"lock\": \"name\",      (string) The lock, as named at the site\n"
+            "      \"site\": \"file:line\", (string) Where it is acquired\n"
+            "      \"wait\": {             (json object) The waits to acquire it\n"
+            "        \"count\": n,         (numeric) The number of acquisitions that waited\n"
+            "        \"sum\": n,           (numeric) Their total wait\n"
+            "        \"max\": n,           (numeric) The longest\n"
+            "        \"p50\": n,           (numeric) The median\n"
+            "        \"p99\": n,           (numeric) The 99th percentile\n"
+            "      },\n"
+            "      \"hold\": {...}         (json object) The sampled hold times, as wait\n"
+            "    },\n"
+            "    ...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockprofile", "")
+            + HelpExampleRpc("getlockprofile", "50")
+                },
+            }.ToString());
+
+    const int count = request.params[0].isNull() ? 20 : request.params[0].get_int();
+    if (count < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+
+    struct SiteSummary {
+        const LockProfileSite* site;
+        CMetricHistogram::Summary wait;
+        CMetricHistogram::Summary hold;
+    };
+    std::vector<SiteSummary> summaries;
+    for (const LockProfileSite* site : GetLockProfileSites()) {
+        summaries.push_back(SiteSummary{site, site->wait.GetSummary(), site->hold.GetSummary()});
+    }
+    std::sort(summaries.begin(), summaries.end(), [](const SiteSummary& a, const SiteSummary& b) {
+        return a.wait.sum > b.wait.sum;
+    });
+    if (count > 0 && summaries.size() > (size_t)count)
+        summaries.resize(count);
+
+    UniValue sites(UniValue::VARR);
+    for (const SiteSummary& summary : summaries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("lock", summary.site->name);
+        obj.pushKV("site", strprintf("%s:%d", summary.site->file, summary.site->line));
+        obj.pushKV("wait", LockProfileSummaryToJSON(summary.wait));
+        obj.pushKV("hold", LockProfileSummaryToJSON(summary.hold));
+        sites.push_back(obj);
+    }
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("enabled", g_lock_profile.load());
+    result.pushKV("sites", sites);
+    return result;
+}
+
 static UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -882,6 +1020,8 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
+    { "control",            "getmetrics",             &getmetrics,             {} },
+    { "control",            "getlockprofile",         &getlockprofile,         {"count"} },
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
     { "util",               "deriveaddresses",        &deriveaddresses,        {"descriptor", "range"} },
@@ -110,6 +110,13 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"blocks_downloaded\": n,    (numeric) The number of requested blocks this peer delivered\n"
+            "    \"block_download_bytes\": n, (numeric) The total size of those blocks\n"
+            "    \"block_time\": n,           (numeric) The average time in milliseconds this peer took to deliver a block\n"
+            "    \"block_window\": n,         (numeric) The number of blocks we keep in flight from this peer\n"
+            "    \"highbandwidth\": true|false, (boolean) Whether we asked this peer to announce new blocks with cmpctblock\n"
+            "    \"block_announce_p50\": n,   (numeric, optional) The median delay in milliseconds after which this peer announced recent new blocks, counted from their first announcement by any peer\n"
+            "    \"block_announce_p90\": n,   (numeric, optional) The 90th percentile of that delay\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"minfeefilter\": n,         (numeric) The minimum fee rate for transactions this peer accepts\n"
             "    \"bytessent_per_msg\": {\n"
@@ -183,6 +190,15 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("blocks_downloaded", statestats.nBlocksDownloaded);
+            obj.pushKV("block_download_bytes", statestats.nBlockBytesDownloaded);
+            obj.pushKV("block_time", statestats.nBlockTimeAvg / 1000.0);
+            obj.pushKV("block_window", statestats.nBlockWindow);
+            obj.pushKV("highbandwidth", statestats.fHighBandwidth);
+            if (statestats.nBlockAnnounceP50 >= 0) {
+                obj.pushKV("block_announce_p50", statestats.nBlockAnnounceP50 / 1000.0);
+                obj.pushKV("block_announce_p90", statestats.nBlockAnnounceP90 / 1000.0);
+            }
         }
         obj.pushKV("whitelisted", stats.fWhitelisted);
         obj.pushKV("minfeefilter", ValueFromAmount(stats.minFeeFilter));
@@ -6,16 +6,23 @@
 #include "poc.h"
 #include "../poc.h"
 #include "chainparams.h"
+#include "forgetrace.h"
 #include "key_io.h"
 #include "keystore.h"
+#include "metrics.h"
+#include "netcapacity.h"
+#include "plotminer.h"
+#include "poolserver.h"
 #include "sync.h"
 #include "util.h"
 #include "util/strencodings.h"
+#include "util/trace.h"
 #include "wallet/coincontrol.h"
 #include "wallet/wallet.h"
 
 #include <algorithm>
 #include <queue>
+#include <set>
 #include <wallet/rpcwallet.h>
 #include <ticket.h>
 #include <consensus/tx_verify.h>
@@ -68,51 +75,127 @@ UniValue getAddressPlotId(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getnetworkcapacity(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "getnetworkcapacity",
+                "\nReturns the plotted capacity of the network, estimated from the base targets of the last blocks.\n"
+                "The estimates are kept as blocks are connected, up to -capacitywindow blocks.\n",
+                {{"nblocks", RPCArg::Type::NUM, /* default */ strprintf("%d", DEFAULT_CAPACITY_BLOCKS), "The number of blocks to average over, at most -capacitywindow."},},
+                RPCResult{
+                    "{\n"
+                    "  \"height\": nnn,       (numeric) the height of the last block averaged\n"
+                    "  \"blocks\": nnn,       (numeric) the number of blocks averaged\n"
+                    "  \"capacity\": x.xxx,   (numeric) the estimated capacity in TiB\n"
+                    "}\n"},
+                RPCExamples{
+                    HelpExampleCli("getnetworkcapacity", "") + HelpExampleCli("getnetworkcapacity", "2520") + HelpExampleRpc("getnetworkcapacity", "15")},
+            }
+                .ToString());
+
+    int nBlocks = request.params[0].isNull() ? DEFAULT_CAPACITY_BLOCKS : request.params[0].get_int();
+    if (nBlocks < 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "nblocks must be positive");
+    if (!g_network_capacity)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "No capacity estimator");
+    double capacity = 0;
+    int nHeight = -1;
+    UniValue obj(UniValue::VOBJ);
+    if (!g_network_capacity->GetCapacity(nBlocks, capacity, nHeight))
+        nBlocks = 0;
+    obj.pushKV("height", nHeight);
+    obj.pushKV("blocks", nBlocks);
+    obj.pushKV("capacity", capacity);
+    return obj;
+}
+
 UniValue getMiningInfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0) {
+    if (request.fHelp || request.params.size() > 2) {
         throw std::runtime_error(
             RPCHelpMan{
                 "getmininginfo",
-                "\nReturns info for poc mining.",
-                {},
+                "\nReturns info for poc mining.\n"
+                "\nIf tiphash is given, waits until the tip differs from it or the timeout passes."
+                "\nOn a -headersonly node the tip is the best header.",
+                {{"tiphash", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "The tipHash of the last reply, to long-poll for the next block."},
+                    {"timeout", RPCArg::Type::NUM, /* default */ "0", "Time in milliseconds to wait for a new tip. 0 indicates no timeout."},},
                 RPCResult{
                     "{\n"
                     "  \"height\": nnn\n"
+                    "  \"tipHash\": \"xxx\"\n"
                     "  \"generationSignature\": \"xxx\"\n"
                     "  \"cumulativeDiff\": \"xxx\"\n"
                     "  \"basetarget\": nnn\n"
                     "  \"targetDeadline\": nnn\n"
                     "}\n"},
                 RPCExamples{
-                    HelpExampleCli("getmininginfo", "") + HelpExampleRpc("getmininginfo", "")},
+                    HelpExampleCli("getmininginfo", "") + HelpExampleCli("getmininginfo", "\"0000000000079f8ef3d2c688c244eb7a4570b24c9ed7b4a8c619eb02596f8862\" 30000") + HelpExampleRpc("getmininginfo", "")},
             }
                 .ToString());
     }
-    LOCK(cs_main);
+    if (!request.params[0].isNull()) {
+        const uint256 hashWatched = ParseHashV(request.params[0], "tiphash");
+        int timeout = 0;
+        if (!request.params[1].isNull())
+            timeout = request.params[1].get_int();
 
-    auto height = chainActive.Height() + 1;
-    auto diff = chainActive.Tip()->nCumulativeDiff;
-    auto block = chainActive.Tip()->GetBlockHeader();
-    uint256 generationSignature;
-    if (height >= Params().GetConsensus().LVIP05Height){
-        generationSignature = CalcGenerationSignature(block.genSign, block.nPublicKeyID);
-    }else{
-        generationSignature = CalcGenerationSignaturePoc2(block.genSign, block.nPlotID);
+        // Wait without cs_main; g_best_block is updated when the tip changes.
+        WAIT_LOCK(g_best_block_mutex, lock);
+        if (timeout)
+            g_best_block_cv.wait_for(lock, std::chrono::milliseconds(timeout), [&hashWatched]{return g_best_block != hashWatched || !IsRPCRunning();});
+        else
+            g_best_block_cv.wait(lock, [&hashWatched]{return g_best_block != hashWatched || !IsRPCRunning();});
+        if (!IsRPCRunning())
+            throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
     }
-    auto nBaseTarget = block.nBaseTarget;
+    LOCK(cs_main);
+
     auto param = Params();
+    const CBlockIndex* tip = fHeadersOnly ? pindexBestHeader : chainActive.Tip();
+    auto diff = tip->nCumulativeDiff;
+    auto info = GetPoCTipInfo(tip, param.GetConsensus().LVIP05Height);
     UniValue obj(UniValue::VOBJ);
-    obj.pushKV("height", height);
-    obj.pushKV("generationSignature", HexStr<uint256>(generationSignature));
+    obj.pushKV("height", info.height);
+    obj.pushKV("tipHash", info.hashTip.GetHex());
+    obj.pushKV("generationSignature", HexStr<uint256>(info.genSig));
     obj.pushKV("cumulativeDiff", diff.GetHex());
-    obj.pushKV("baseTarget", nBaseTarget);
+    obj.pushKV("baseTarget", info.baseTarget);
     obj.pushKV("targetDeadline", param.TargetDeadline());
     return obj;
 }
 
+/** Register the key of keyid from the first loaded wallet that can give it. Each key id is tried
+ *  once, so later submissions for it never take the wallet locks; a key that was not available
+ *  then, for example because its wallet was locked, is registered with addforgingkey. */
+static void LoadForgingKey(const CKeyID& keyid)
+{
+    static CCriticalSection cs_tried;
+    static std::set<CKeyID> tried;
+    CKey key;
+    if (blockAssember.GetForgingKey(keyid, key))
+        return;
+    {
+        LOCK(cs_tried);
+        if (!tried.insert(keyid).second)
+            return;
+    }
+    for (const std::shared_ptr<CWallet>& wallet : GetWallets()) {
+        auto locked_chain = wallet->chain().lock();
+        LOCK(wallet->cs_wallet);
+        if (!wallet->IsLocked() && wallet->GetKey(keyid, key)) {
+            blockAssember.RegisterForgingKey(key);
+            return;
+        }
+    }
+}
+
 UniValue submitNonce(const JSONRPCRequest& request)
 {
+    static CMetricHistogram& metric = GetMetrics().Histogram("rpc_submitnonce", "Time to handle a submitnonce call");
+    CMetricTimer timer(metric);
     if (request.fHelp || request.params.size() != 4) {
         throw std::runtime_error(
             RPCHelpMan{
@@ -132,14 +215,6 @@ UniValue submitNonce(const JSONRPCRequest& request)
             }
                 .ToString());
     }
-    std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
-    auto wallet = wallets.size() == 1 || (request.fHelp && wallets.size() > 0) ? wallets[0] : nullptr;
-    if (wallet == nullptr) {
-        return NullUniValue;
-    }
-    CWallet* const pwallet = wallet.get();
-    auto locked_chain = pwallet->chain().lock();
-
     std::string strAddress = request.params[0].get_str();
     CTxDestination dest = DecodeDestination(strAddress);
     if (!IsValidDestination(dest) && dest.type() != typeid(CKeyID)) {
@@ -154,23 +229,217 @@ UniValue submitNonce(const JSONRPCRequest& request)
     }
     uint64_t deadline = request.params[2].get_int64();
     int height = request.params[3].get_int();
-    CKey key;
-    LOCK(pwallet->cs_wallet);
-    if (!pwallet->IsLocked()) {
-        pwallet->GetKey(keyid, key);
-    }
+    LoadForgingKey(keyid);
+    // Verified without the wallet or chain locks held.
     UniValue obj(UniValue::VOBJ);
-    if (blockAssember.UpdateDeadline(height, keyid, nonce, deadline, key)) {
+    if (blockAssember.UpdateDeadline(height, keyid, nonce, deadline)) {
+        TRACE4(poc, submitnonce_accepted, height, plotID, nonce, deadline);
         obj.pushKV("plotid", plotID);
         obj.pushKV("deadline", deadline);
         auto params = Params();
         obj.pushKV("targetdeadline", params.TargetDeadline());
     } else {
+        TRACE4(poc, submitnonce_rejected, height, plotID, nonce, deadline);
         obj.pushKV("accept", false);
     }
     return obj;
 }
 
+UniValue submitNonces(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{
+                "submitnonces",
+                "\nSubmit many nonces at once. Stale heights and deadlines that can neither beat the current best\n"
+                "nor be kept as a runner-up are rejected without verification, the rest are verified together.",
+                {
+                    {"submissions", RPCArg::Type::ARR, RPCArg::Optional::NO, "The nonces found on disk",
+                        {
+                            {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                                {
+                                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "Your miner address"},
+                                    {"nonce", RPCArg::Type::STR, RPCArg::Optional::NO, "The nonce you found on disk"},
+                                    {"deadline", RPCArg::Type::NUM, RPCArg::Optional::NO, "When the next block will be generate"},
+                                    {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The block height you want to mine"},
+                                },
+                            },
+                        },
+                    },
+                },
+                RPCResult{
+                    "[                   (json array) One result per submission, in order, as returned by submitnonce\n"
+                    "  {\n"
+                    "    \"accept\": false        (boolean) Present if the submission was not accepted\n"
+                    "    \"error\": \"xxx\"       (string, optional) Why a malformed submission was skipped\n"
+                    "    \"plotid\": nnn\n"
+                    "    \"deadline\": nnn\n"
+                    "    \"targetdeadline\": nnn\n"
+                    "  }\n"
+                    "  ,...\n"
+                    "]\n"},
+                RPCExamples{
+                    HelpExampleCli("submitnonces", "\"[{\\\"address\\\":\\\"3MhzFQAXQMsmtTmdkciLE3EJsgAQkzR4Sg\\\",\\\"nonce\\\":\\\"15032170525642997731\\\",\\\"deadline\\\":6170762982435,\\\"height\\\":100}]\"")
+                    + HelpExampleRpc("submitnonces", "[{\"address\":\"3MhzFQAXQMsmtTmdkciLE3EJsgAQkzR4Sg\",\"nonce\":\"15032170525642997731\",\"deadline\":6170762982435,\"height\":100}]")},
+            }
+                .ToString());
+    }
+    const UniValue& submissions = request.params[0].get_array();
+    const size_t count = submissions.size();
+    std::vector<UniValue> results(count, UniValue(UniValue::VOBJ));
+    std::vector<CKeyID> keyids(count);
+    std::vector<PoCItem> items;
+    std::vector<size_t> itemOf;
+
+    const CBlockIndex* prevIndex;
+    {
+        LOCK(cs_main);
+        prevIndex = chainActive.Tip();
+    }
+    auto params = Params();
+    auto info = GetPoCTipInfo(prevIndex, params.GetConsensus().LVIP05Height);
+    for (size_t i = 0; i < count; i++) {
+        const UniValue& submission = submissions[i].get_obj();
+        RPCTypeCheckObj(submission,
+            {
+                {"address", UniValueType(UniValue::VSTR)},
+                {"nonce", UniValueType(UniValue::VSTR)},
+                {"deadline", UniValueType(UniValue::VNUM)},
+                {"height", UniValueType(UniValue::VNUM)},
+            });
+        results[i].pushKV("accept", false);
+        CTxDestination dest = DecodeDestination(find_value(submission, "address").get_str());
+        if (!IsValidDestination(dest) || dest.type() != typeid(CKeyID)) {
+            results[i].pushKV("error", "Invalid Bitcoin address");
+            continue;
+        }
+        uint64_t nonce = 0;
+        if (!ParseUInt64(find_value(submission, "nonce").get_str(), &nonce)) {
+            results[i].pushKV("error", "Invalid nonce");
+            continue;
+        }
+        uint64_t deadline = find_value(submission, "deadline").get_int64();
+        int height = find_value(submission, "height").get_int();
+        if (!blockAssember.IsCandidate(prevIndex, height, deadline)) {
+            TRACE4(poc, submitnonce_rejected, height, boost::get<CKeyID>(dest).GetPlotID(), nonce, deadline);
+            continue;
+        }
+
+        keyids[i] = boost::get<CKeyID>(dest);
+        PoCItem item;
+        item.genSig = info.genSig;
+        item.height = height;
+        item.fPoc2 = info.fPoc2;
+        item.plotID = keyids[i].GetPlotID();
+        item.publicKeyID = uint160(keyids[i]);
+        item.nonce = nonce;
+        item.baseTarget = prevIndex->nBaseTarget;
+        item.deadline = deadline;
+        items.push_back(item);
+        itemOf.push_back(i);
+    }
+
+    // Verify the candidates in the lanes of the Shabal engine over the PoC check threads, or on the batch device.
+    CheckSubmittedProofsOfCapacity(MakeSpan(items), params.TargetDeadline());
+
+    for (size_t n = 0; n < items.size(); n++) {
+        const PoCItem& item = items[n];
+        const size_t i = itemOf[n];
+        if (!item.fValid) {
+            TRACE4(poc, submitnonce_rejected, item.height, item.plotID, item.nonce, item.deadline);
+            LogPrint(BCLog::FORGE, "%s Deadline inconformity %uul\n", info.fPoc2 ? "POC2" : "POC2.x", item.deadline);
+            continue;
+        }
+        LoadForgingKey(keyids[i]);
+        // Publish in submission order, which gives the same results as one submitnonce call each.
+        if (blockAssember.PublishDeadline(prevIndex, item.height, keyids[i], item.nonce, item.deadline, info.genSig)) {
+            TRACE4(poc, submitnonce_accepted, item.height, item.plotID, item.nonce, item.deadline);
+            results[i] = UniValue(UniValue::VOBJ);
+            results[i].pushKV("plotid", item.plotID);
+            results[i].pushKV("deadline", item.deadline);
+            results[i].pushKV("targetdeadline", params.TargetDeadline());
+        } else {
+            TRACE4(poc, submitnonce_rejected, item.height, item.plotID, item.nonce, item.deadline);
+        }
+    }
+
+    UniValue ret(UniValue::VARR);
+    for (UniValue& result : results) {
+        ret.push_back(result);
+    }
+    return ret;
+}
+
+UniValue getpoolinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            RPCHelpMan{ "getpoolinfo",
+                "Returns the shares submitted to the pool endpoint of -poolserver, by account.\n",
+                {},
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"address\": \"xxx\",             (string) the account the shares were submitted for\n"
+            "    \"plotid\": nnn,                (numeric) the plot id of the account\n"
+            "    \"shares\": nnn,                (numeric) the valid shares of the account since the node started\n"
+            "    \"bestheight\": nnn,            (numeric) the last height the account submitted for\n"
+            "    \"bestnonce\": \"nnn\",          (string) the nonce of its best deadline at that height\n"
+            "    \"bestdeadline\": nnn,          (numeric) its best deadline at that height\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n" },
+                RPCExamples{
+                    HelpExampleCli("getpoolinfo", "") + HelpExampleRpc("getpoolinfo", "")
+                },
+            }.ToString());
+    UniValue ret(UniValue::VARR);
+    for (const auto& entry : g_pool_server.GetAccounts()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("address", EncodeDestination(CTxDestination(entry.first)));
+        obj.pushKV("plotid", entry.first.GetPlotID());
+        obj.pushKV("shares", entry.second.nShares);
+        obj.pushKV("bestheight", entry.second.nBestHeight);
+        obj.pushKV("bestnonce", std::to_string(entry.second.nBestNonce));
+        obj.pushKV("bestdeadline", entry.second.nBestDeadline);
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue getplotminerinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            RPCHelpMan{ "getplotminerinfo",
+                "Returns how fast the plot files of -plotdir were read in the last round all of them were scanned.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"plotfiles\": nnn,             (numeric) the plot files mined\n"
+            "  \"io\": \"xxx\",                 (string) how the plot files are read, pread or mmap\n"
+            "  \"height\": nnn,                (numeric) the height of the last round, 0 if none was completed yet\n"
+            "  \"bytes\": nnn,                 (numeric) the bytes read in the round\n"
+            "  \"roundtime\": nnn,             (numeric) the milliseconds from the tip to the last plot file scanned\n"
+            "  \"throughput\": x.xxx,          (numeric) the MB per second read in the round\n"
+            "}\n" },
+                RPCExamples{
+                    HelpExampleCli("getplotminerinfo", "") + HelpExampleRpc("getplotminerinfo", "")
+                },
+            }.ToString());
+    if (!g_plotminer)
+        throw JSONRPCError(RPC_MISC_ERROR, "Error: plot files are not mined, see -plotdir");
+    const CPlotRound round = g_plotminer->GetLastRound();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("plotfiles", (uint64_t)g_plotminer->GetPlotCount());
+    obj.pushKV("io", g_plotminer->IsMmap() ? "mmap" : "pread");
+    obj.pushKV("height", round.height);
+    obj.pushKV("bytes", round.nBytes);
+    obj.pushKV("roundtime", round.nElapsedMicros / 1000);
+    obj.pushKV("throughput", round.nElapsedMicros > 0 ? round.nBytes / (double)round.nElapsedMicros : 0.0);
+    return obj;
+}
+
 UniValue getslotinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -191,22 +460,108 @@ UniValue getslotinfo(const JSONRPCRequest& request)
                     HelpExampleCli("getslotinfo", "") + HelpExampleCli("getslotinfo", "2")
                 },
             }.ToString());
-    LOCK(cs_main);
-    int index = pticketview->SlotIndex();
+    const CTicketSnapshotRef tickets = pticketview->GetSnapshot();
+    int index = tickets->SlotIndex();
     if (!request.params[0].isNull()) {
         index = request.params[0].get_int();
     }
-    if (index < 0 || index > pticketview->SlotIndex()) {
+    if (index < 0 || index > tickets->SlotIndex()) {
         throw JSONRPCError(RPC_TYPE_ERROR, "Invalid slot index");
     }
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("index", index);
-    obj.pushKV("price", pticketview->TicketPriceInSlot(index));
-    obj.pushKV("count", (uint64_t)pticketview->GetTicketsBySlotIndex(index).size());
-    obj.pushKV("locktime", pticketview->LockTime(index));
+    obj.pushKV("price", tickets->TicketPriceInSlot(index));
+    obj.pushKV("count", (uint64_t)tickets->TicketCountInSlot(index));
+    obj.pushKV("locktime", tickets->LockTime(index));
     return obj;
 }
 
+/** Microseconds since the scheduled time, in milliseconds, or null if the event did not happen. */
+static UniValue ForgeDelay(int64_t nTime, int64_t nScheduledTime)
+{
+    if (nTime == 0)
+        return NullUniValue;
+    return (nTime - nScheduledTime) / 1000.0;
+}
+
+UniValue getforginginfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{ "getforginginfo",
+                "Returns the trace of the last heights this node had a deadline for: how late its block was\n"
+                "forged and announced, and when the competing blocks arrived. Delays are in milliseconds\n"
+                "from the time the deadline allowed the block to be forged.\n",
+                {
+                    {"count", RPCArg::Type::NUM, /* default */ "all", "The number of most recent heights to return."},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"height\": xx,              (numeric) the height\n"
+            "    \"deadline\": xx,            (numeric) our best deadline, in seconds\n"
+            "    \"scheduled\": xx,           (numeric) the time the block could be forged, in seconds since epoch\n"
+            "    \"fired\": x.xxx,            (numeric) delay of the forge timer, null if it did not run\n"
+            "    \"create\": x.xxx,           (numeric) time taken to assemble the block\n"
+            "    \"process\": x.xxx,          (numeric) time ProcessNewBlock took with it\n"
+            "    \"announced\": x.xxx,        (numeric) delay until it was first sent to a peer, null if it was not\n"
+            "    \"hash\": \"hash\",           (string) our block, if one was forged\n"
+            "    \"won\": true|false,         (boolean) whether our block is on the active chain\n"
+            "    \"competitors\": [           (array) the blocks of other forgers for the height\n"
+            "      {\n"
+            "        \"hash\": \"hash\",       (string) the block\n"
+            "        \"deadline\": xx,        (numeric) its deadline, in seconds\n"
+            "        \"arrived\": x.xxx,      (numeric) delay until it arrived\n"
+            "        \"cached\": true|false,  (boolean) it arrived before its deadline\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n" },
+                RPCExamples{
+                    HelpExampleCli("getforginginfo", "") + HelpExampleCli("getforginginfo", "10") + HelpExampleRpc("getforginginfo", "10")
+                },
+            }.ToString());
+
+    std::vector<CForgeTraceEntry> entries = g_forge_trace.GetEntries();
+    if (!request.params[0].isNull()) {
+        const int count = request.params[0].get_int();
+        if (count < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+        if ((size_t)count < entries.size())
+            entries.erase(entries.begin(), entries.end() - count);
+    }
+
+    UniValue result(UniValue::VARR);
+    LOCK(cs_main);
+    for (const CForgeTraceEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("height", entry.height);
+        obj.pushKV("deadline", entry.nDeadline);
+        obj.pushKV("scheduled", entry.nScheduledTime / 1000000);
+        obj.pushKV("fired", ForgeDelay(entry.nFiredTime, entry.nScheduledTime));
+        if (!entry.hash.IsNull()) {
+            const CBlockIndex* pindex = chainActive[entry.height];
+            obj.pushKV("create", entry.nCreateDuration / 1000.0);
+            obj.pushKV("process", entry.nProcessDuration / 1000.0);
+            obj.pushKV("announced", ForgeDelay(entry.nAnnounceTime, entry.nScheduledTime));
+            obj.pushKV("hash", entry.hash.GetHex());
+            obj.pushKV("won", pindex && pindex->GetBlockHash() == entry.hash);
+        }
+        UniValue competitors(UniValue::VARR);
+        for (const CForgeCompetitor& competitor : entry.competitors) {
+            UniValue c(UniValue::VOBJ);
+            c.pushKV("hash", competitor.hash.GetHex());
+            c.pushKV("deadline", competitor.nDeadline);
+            c.pushKV("arrived", ForgeDelay(competitor.nArrivalTime, entry.nScheduledTime));
+            c.pushKV("cached", competitor.fCached);
+            competitors.push_back(c);
+        }
+        obj.pushKV("competitors", competitors);
+        result.push_back(obj);
+    }
+    return result;
+}
+
 UniValue setfsowner(const JSONRPCRequest& request){
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
     CWallet* const pwallet = wallet.get();
@@ -219,7 +574,8 @@ UniValue setfsowner(const JSONRPCRequest& request){
         throw std::runtime_error(
         RPCHelpMan{
             "setfsowner",
-            "\nset the mining fs user.\n",
+            "\nAdd a mining fs user. Forged blocks spend a firestone of the address their reward goes to first,\n"
+            "then one of the miner, then one of any other address set.\n",
         {
             {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to use fs(only keyid)."},
         },
@@ -254,14 +610,124 @@ UniValue setfsowner(const JSONRPCRequest& request){
     return true;
 }
 
+UniValue addforgingkey(const JSONRPCRequest& request)
+{
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+        RPCHelpMan{
+            "addforgingkey",
+            "\nCopy the key of a plot address from this wallet into the forging key registry, in locked memory.\n"
+            "Deadlines submitted for the address then spend its firestones without the wallet, which can be locked again.\n",
+        {
+            {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The plot address (only keyid)."},
+        },
+        RPCResult{
+            "true|false        (boolean) Returns false if the key was already registered\n"
+        },
+        RPCExamples{
+            HelpExampleCli("addforgingkey", "\"1M72Sfpbz1BPpXFHz9m3CdqATR44Jvaydd\"")},
+        }
+    .ToString());
+
+    CTxDestination dest = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(dest)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+    if (dest.type() != typeid(CKeyID)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Only support PUBKEYHASH");
+    }
+    CKey key;
+    {
+        auto locked_chain = pwallet->chain().lock();
+        LOCK(pwallet->cs_wallet);
+        EnsureWalletIsUnlocked(pwallet);
+        if (!pwallet->GetKey(boost::get<CKeyID>(dest), key)) {
+            throw JSONRPCError(RPC_WALLET_ERROR, "Private key for address is not known");
+        }
+    }
+    return blockAssember.RegisterForgingKey(key);
+}
+
+UniValue removeforgingkey(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+        RPCHelpMan{
+            "removeforgingkey",
+            "\nDrop the key of a plot address from the forging key registry.\n",
+        {
+            {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The plot address (only keyid)."},
+        },
+        RPCResult{
+            "true|false        (boolean) Returns whether the key was registered\n"
+        },
+        RPCExamples{
+            HelpExampleCli("removeforgingkey", "\"1M72Sfpbz1BPpXFHz9m3CdqATR44Jvaydd\"")},
+        }
+    .ToString());
+
+    CTxDestination dest = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(dest) || dest.type() != typeid(CKeyID)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+    return blockAssember.UnregisterForgingKey(boost::get<CKeyID>(dest));
+}
+
+UniValue listforgingkeys(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+        RPCHelpMan{
+            "listforgingkeys",
+            "\nList the plot addresses in the forging key registry.\n",
+            {},
+        RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"address\": \"xxx\",    (string) the plot address\n"
+            "    \"plotid\": nnn,       (numeric) its plot id\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+        },
+        RPCExamples{
+            HelpExampleCli("listforgingkeys", "") + HelpExampleRpc("listforgingkeys", "")},
+        }
+    .ToString());
+
+    UniValue result(UniValue::VARR);
+    for (const CKeyID& keyid : blockAssember.GetForgingKeyIDs()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("address", EncodeDestination(CTxDestination(keyid)));
+        obj.pushKV("plotid", keyid.GetPlotID());
+        result.push_back(obj);
+    }
+    return result;
+}
+
 // clang-format off
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
-    { "poc",               "getmininginfo",           &getMiningInfo,          {} },
+    { "poc",               "getmininginfo",           &getMiningInfo,          {"tiphash", "timeout"} },
     { "poc",               "submitnonce",             &submitNonce,            {"address", "nonce", "deadline"} },
+    { "poc",               "submitnonces",            &submitNonces,           {"submissions"} },
 	{ "poc",               "getaddressplotid",        &getAddressPlotId,       {"address"} },
+    { "poc",               "getpoolinfo",             &getpoolinfo,            {} },
+    { "poc",               "getplotminerinfo",        &getplotminerinfo,       {} },
     { "poc",               "getslotinfo",             &getslotinfo,            {"index"} },
+    { "poc",               "getforginginfo",          &getforginginfo,         {"count"} },
+    { "poc",               "getnetworkcapacity",      &getnetworkcapacity,     {"nblocks"} },
+    { "poc",               "removeforgingkey",        &removeforgingkey,       {"address"} },
+    { "poc",               "listforgingkeys",         &listforgingkeys,        {} },
+    { "wallet",            "addforgingkey",           &addforgingkey,          {"address"} },
     { "wallet",            "setfsowner",             &setfsowner,            {"address"} },    
 };
 
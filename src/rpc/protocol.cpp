@@ -45,7 +45,10 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id)
 {
     UniValue reply = JSONRPCReplyObj(result, error, id);
-    return reply.write() + "\n";
+    std::string strReply;
+    reply.write(strReply);
+    strReply += "\n";
+    return strReply;
 }
 
 UniValue JSONRPCError(int code, const std::string& message)
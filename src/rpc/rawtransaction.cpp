@@ -893,32 +893,54 @@ UniValue SignTransaction(interfaces::Chain& chain, CMutableTransaction& mtx, con
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mtx);
-    // Sign what we can:
+    const PrecomputedTransactionData txdata(mtx, true);
+
+    // The coins are looked up first, as the view can't be read from several threads.
+    std::vector<Coin> coins;
+    coins.reserve(mtx.vin.size());
+    for (const CTxIn& txin : mtx.vin) {
+        coins.push_back(view.AccessCoin(txin.prevout));
+    }
+
+    // Sign and verify what we can, each input on its own, and apply the results in order.
+    // The key origins are not needed, and the wallet takes cs_wallet to look them up.
+    const HidingSigningProvider provider(keystore, false, true);
+    std::vector<SignatureData> sigdatas(mtx.vin.size());
+    std::vector<ScriptError> serrors(mtx.vin.size(), SCRIPT_ERR_OK);
+    SignInputsParallel(mtx.vin.size(), [&](size_t i) {
+        const Coin& coin = coins[i];
+        if (coin.IsSpent()) return;
+        const CAmount& amount = coin.out.nValue;
+
+        sigdatas[i] = DataFromTransaction(mtx, i, coin.out);
+        // Only sign SIGHASH_SINGLE if there's a corresponding output:
+        if (!fHashSingle || (i < mtx.vout.size())) {
+            ProduceSignature(provider, MutableTransactionSignatureCreator(&mtx, i, amount, nHashType, &txdata), coin.out.scriptPubKey, sigdatas[i]);
+        }
+
+        CTxIn txin;
+        UpdateInput(txin, sigdatas[i]);
+        VerifyScript(txin.scriptSig, coin.out.scriptPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount, txdata), &serrors[i]);
+    });
+
     for (unsigned int i = 0; i < mtx.vin.size(); i++) {
         CTxIn& txin = mtx.vin[i];
-        const Coin& coin = view.AccessCoin(txin.prevout);
+        const Coin& coin = coins[i];
         if (coin.IsSpent()) {
             TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
             continue;
         }
-        const CScript& prevPubKey = coin.out.scriptPubKey;
         const CAmount& amount = coin.out.nValue;
 
-        SignatureData sigdata = DataFromTransaction(mtx, i, coin.out);
-        // Only sign SIGHASH_SINGLE if there's a corresponding output:
-        if (!fHashSingle || (i < mtx.vout.size())) {
-            ProduceSignature(*keystore, MutableTransactionSignatureCreator(&mtx, i, amount, nHashType), prevPubKey, sigdata);
-        }
-
-        UpdateInput(txin, sigdata);
+        UpdateInput(txin, sigdatas[i]);
 
         // amount must be specified for valid segwit signature
         if (amount == MAX_MONEY && !txin.scriptWitness.IsNull()) {
             throw JSONRPCError(RPC_TYPE_ERROR, strprintf("Missing amount for %s", coin.out.ToString()));
         }
 
-        ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount), &serror)) {
+        const ScriptError serror = serrors[i];
+        if (serror != SCRIPT_ERR_OK) {
             if (serror == SCRIPT_ERR_INVALID_STACK_OPERATION) {
                 // Unable to sign input and verification failed (possible attempt to partially sign).
                 TxInErrorToJSON(txin, vErrors, "Unable to sign input, invalid stack size (possibly missing key)");
@@ -1077,6 +1099,65 @@ static UniValue sendrawtransaction(const JSONRPCRequest& request)
     return txid.GetHex();
 }
 
+static UniValue submitpackage(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"submitpackage",
+                "\nSubmits a package of raw transactions (serialized, hex-encoded) to local node and network.\n"
+                "\nThe transactions are accepted together, so a child can pay for a parent whose own fee is too low.\n"
+                "Parents must come before their children, and the package may not replace transactions of the mempool.\n",
+                {
+                    {"rawtxs", RPCArg::Type::ARR, RPCArg::Optional::NO, "An array of hex strings of raw transactions, parents first.",
+                        {
+                            {"rawtx", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, ""},
+                        },
+                        },
+                    {"allowhighfees", RPCArg::Type::BOOL, /* default */ "false", "Allow high fees"},
+                },
+                RPCResult{
+            "[                   (array) The transaction hashes of the package in hex\n"
+            "  \"hex\",\n"
+            "  ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("submitpackage", "'[\"parenthex\", \"childhex\"]'") +
+                    HelpExampleRpc("submitpackage", "[\"parenthex\", \"childhex\"]")
+                },
+            }.ToString());
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+
+    const UniValue& rawtxs = request.params[0].get_array();
+    if (rawtxs.empty() || rawtxs.size() > MAX_PACKAGE_COUNT) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Package must hold 1 to %u transactions.", MAX_PACKAGE_COUNT));
+    }
+
+    std::vector<CTransactionRef> package;
+    for (unsigned int i = 0; i < rawtxs.size(); i++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, rawtxs[i].get_str()))
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %u", i));
+        package.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    bool allowhighfees = false;
+    if (!request.params[1].isNull()) allowhighfees = request.params[1].get_bool();
+    const CAmount highfee{allowhighfees ? 0 : ::maxTxFee};
+    std::string err_string;
+    const TransactionError err = BroadcastPackage(package, err_string, highfee);
+    if (TransactionError::OK != err) {
+        throw JSONRPCTransactionError(err, err_string);
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const CTransactionRef& tx : package) {
+        result.push_back(tx->GetHash().GetHex());
+    }
+    return result;
+}
+
 static UniValue testmempoolaccept(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -2107,6 +2188,7 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring","iswitness"} },
     { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",           &sendrawtransaction,        {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "submitpackage",                &submitpackage,             {"rawtxs","allowhighfees"} },
     //{ "rawtransactions",    "combinerawtransaction",        &combinerawtransaction,     {"txs"} },
     { "hidden",             "signrawtransaction",           &signrawtransaction,        {"hexstring","prevtxs","privkeys","sighashtype"} },
     { "rawtransactions",    "signrawtransactionwithkey",    &signrawtransactionwithkey, {"hexstring","privkeys","prevtxs","sighashtype"} },
@@ -708,7 +708,7 @@ UniValue AmountMapToUniv(const CAmountMap& balanceOrig, const CAsset& asset)
     }
 
     UniValue obj(UniValue::VOBJ);
-    for(std::map<CAsset, CAmount>::const_iterator it = balance.begin(); it != balance.end(); ++it) {
+    for(CAmountMap::const_iterator it = balance.begin(); it != balance.end(); ++it) {
         // Unknown assets
         if (it->first.IsNull())
             continue;
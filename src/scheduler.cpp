@@ -4,6 +4,7 @@
 
 #include <scheduler.h>
 
+#include <metrics.h>
 #include <random.h>
 #include <reverselock.h>
 
@@ -29,8 +30,43 @@ static boost::system_time toPosixTime(const boost::chrono::system_clock::time_po
 }
 #endif
 
+bool CScheduler::isEmpty() const
+{
+    for (const TaskQueue& queue : taskQueue) {
+        if (!queue.empty())
+            return false;
+    }
+    return true;
+}
+
+CScheduler::TaskQueue* CScheduler::nextTaskQueue(bool fTimingOnly)
+{
+    // On a tie the timing lane goes first.
+    TaskQueue* next = nullptr;
+    for (int lane = (int)SchedulerLane::TIMING; lane >= (fTimingOnly ? (int)SchedulerLane::TIMING : 0); lane--) {
+        TaskQueue& queue = taskQueue[lane];
+        if (!queue.empty() && (!next || queue.begin()->first < next->begin()->first))
+            next = &queue;
+    }
+    return next;
+}
+
 void CScheduler::serviceQueue()
 {
+    serviceLanes(false);
+}
+
+void CScheduler::serviceTimingQueue()
+{
+    serviceLanes(true);
+}
+
+void CScheduler::serviceLanes(bool fTimingOnly)
+{
+    static CMetricHistogram& lagNormal = GetMetrics().Histogram("scheduler_lag", "Delay of scheduler tasks past their time");
+    static CMetricHistogram& lagTiming = GetMetrics().Histogram("scheduler_timing_lag", "Delay of consensus timing tasks past their time");
+    static CMetricHistogram& runNormal = GetMetrics().Histogram("scheduler_run", "Time scheduler tasks run");
+
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
     ++nThreadsServicingQueue;
 
@@ -39,47 +75,58 @@ void CScheduler::serviceQueue()
     // is called.
     while (!shouldStop()) {
         try {
-            if (!shouldStop() && taskQueue.empty()) {
+            if (!shouldStop() && !nextTaskQueue(fTimingOnly)) {
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
                 // Use this chance to get more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
+            while (!shouldStop() && !nextTaskQueue(fTimingOnly)) {
                 // Wait until there is something to do.
                 newTaskScheduled.wait(lock);
             }
 
             // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            // the time of the first item on the queues:
 
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
+            while (!shouldStop() && nextTaskQueue(fTimingOnly) &&
+                   newTaskScheduled.timed_wait(lock, toPosixTime(nextTaskQueue(fTimingOnly)->begin()->first))) {
                 // Keep waiting until timeout
             }
 #else
             // Some boost versions have a conflicting overload of wait_until that returns void.
             // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
+            while (!shouldStop() && nextTaskQueue(fTimingOnly)) {
+                boost::chrono::system_clock::time_point timeToWaitFor = nextTaskQueue(fTimingOnly)->begin()->first;
                 if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
                     break; // Exit loop after timeout, it means we reached the time of the event
             }
 #endif
             // If there are multiple threads, the queue can empty while we're waiting (another
             // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+            TaskQueue* queue = nextTaskQueue(fTimingOnly);
+            if (shouldStop() || !queue)
                 continue;
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            const bool fTiming = queue == &taskQueue[(int)SchedulerLane::TIMING];
+            const boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            if (queue->begin()->first > now)
+                continue; // Woken up early, the task is not due yet
+            Function f = queue->begin()->second;
+            (fTiming ? lagTiming : lagNormal).Record(boost::chrono::duration_cast<boost::chrono::microseconds>(now - queue->begin()->first).count());
+            queue->erase(queue->begin());
 
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                if (fTiming) {
+                    f();
+                } else {
+                    CMetricTimer timer(runNormal);
+                    f();
+                }
             }
         } catch (...) {
             --nThreadsServicingQueue;
@@ -87,7 +134,7 @@ void CScheduler::serviceQueue()
         }
     }
     --nThreadsServicingQueue;
-    newTaskScheduled.notify_one();
+    newTaskScheduled.notify_all();
 }
 
 void CScheduler::stop(bool drain)
@@ -102,18 +149,19 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, SchedulerLane lane)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue[(int)lane].insert(std::make_pair(t, f));
     }
-    newTaskScheduled.notify_one();
+    // The threads service different lanes, any of them may be the one to wake.
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, SchedulerLane lane)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), lane);
 }
 
 static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
@@ -131,10 +179,15 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+    size_t result = 0;
+    for (const TaskQueue& queue : taskQueue) {
+        if (queue.empty())
+            continue;
+        if (result == 0 || queue.begin()->first < first)
+            first = queue.begin()->first;
+        if (result == 0 || queue.rbegin()->first > last)
+            last = queue.rbegin()->first;
+        result += queue.size();
     }
     return result;
 }
@@ -34,6 +34,16 @@
 // delete s; // Must be done after thread is interrupted/joined.
 //
 
+/** The lanes of a CScheduler, each with a queue of its own. */
+enum class SchedulerLane {
+    NORMAL = 0, //!< background work and the validation interface callbacks
+    TIMING = 1, //!< consensus timing, forging deadlines and held blocks, which a slow callback must not delay
+};
+static const int SCHEDULER_LANES = 2;
+/** Default for -schedulerthreads, the threads running the normal lane, and with it the validation interface subscribers side by side */
+static const int DEFAULT_SCHEDULER_THREADS = 4;
+static const int MAX_SCHEDULER_THREADS = 16;
+
 class CScheduler
 {
 public:
@@ -43,10 +53,10 @@ public:
     typedef std::function<void()> Function;
 
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(), SchedulerLane lane=SchedulerLane::NORMAL);
 
     // Convenience method: call f once deltaMilliSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, SchedulerLane lane=SchedulerLane::NORMAL);
 
     // Another convenience method: call f approximately
     // every deltaMilliSeconds forever, starting deltaMilliSeconds from now.
@@ -59,8 +69,13 @@ public:
 
     // Services the queue 'forever'. Should be run in a thread,
     // and interrupted using boost::interrupt_thread
+    // Tasks of every lane are serviced, the due ones of the timing lane first.
     void serviceQueue();
 
+    // Services only the tasks of the timing lane, so they run on time while
+    // the threads running serviceQueue are busy with slow tasks.
+    void serviceTimingQueue();
+
     // Tell any threads running serviceQueue to stop as soon as they're
     // done servicing whatever task they're currently servicing (drain=false)
     // or when there is no work left to be done (drain=true)
@@ -75,13 +90,20 @@ public:
     bool AreThreadsServicingQueue() const;
 
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    typedef std::multimap<boost::chrono::system_clock::time_point, Function> TaskQueue;
+
+    void serviceLanes(bool fTimingOnly);
+    // The queue holding the next task a thread servicing the lanes runs, nullptr if there is none
+    TaskQueue* nextTaskQueue(bool fTimingOnly);
+    bool isEmpty() const;
+
+    TaskQueue taskQueue[SCHEDULER_LANES];
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
-    bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool shouldStop() const { return stopRequested || (stopWhenEmpty && isEmpty()); }
 };
 
 /**
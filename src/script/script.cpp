@@ -131,7 +131,7 @@ const char* GetOpName(opcodetype opcode)
     case OP_NOP1                   : return "OP_NOP1";
     case OP_CHECKLOCKTIMEVERIFY    : return "OP_CHECKLOCKTIMEVERIFY";
     case OP_CHECKSEQUENCEVERIFY    : return "OP_CHECKSEQUENCEVERIFY";
-    case OP_NOP4                   : return "OP_NOP4";
+    case OP_CHECKSCHNORRVERIFY     : return "OP_CHECKSCHNORRVERIFY";
     case OP_NOP5                   : return "OP_NOP5";
     case OP_NOP6                   : return "OP_NOP6";
     case OP_NOP7                   : return "OP_NOP7";
@@ -194,6 +194,19 @@ unsigned int CScript::GetSigOpCount(const CScript& scriptSig) const
     return subscript.GetSigOpCount(true);
 }
 
+bool CScript::GetOp(const_iterator& pc, opcodetype& opcodeRet, Span<const unsigned char>& data) const
+{
+    data = Span<const unsigned char>();
+    const const_iterator start = pc;
+    if (!GetScriptOp(pc, end(), opcodeRet, nullptr))
+        return false;
+    if (opcodeRet <= OP_PUSHDATA4) {
+        const std::ptrdiff_t header = opcodeRet < OP_PUSHDATA1 ? 1 : opcodeRet == OP_PUSHDATA1 ? 2 : opcodeRet == OP_PUSHDATA2 ? 3 : 5;
+        data = Span<const unsigned char>(&*start + header, (pc - start) - header);
+    }
+    return true;
+}
+
 bool CScript::IsPayToScriptHash() const
 {
     // Extra-fast test for pay-to-script-hash CScripts:
@@ -9,6 +9,7 @@
 #include <crypto/common.h>
 #include <prevector.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <assert.h>
 #include <climits>
@@ -179,7 +180,8 @@ enum opcodetype
     OP_NOP2 = OP_CHECKLOCKTIMEVERIFY,
     OP_CHECKSEQUENCEVERIFY = 0xb2,
     OP_NOP3 = OP_CHECKSEQUENCEVERIFY,
-    OP_NOP4 = 0xb3,
+    OP_CHECKSCHNORRVERIFY = 0xb3,
+    OP_NOP4 = OP_CHECKSCHNORRVERIFY,
     OP_NOP5 = 0xb4,
     OP_NOP6 = 0xb5,
     OP_NOP7 = 0xb6,
@@ -504,6 +506,9 @@ public:
         return GetScriptOp(pc, end(), opcodeRet, nullptr);
     }
 
+    /** Like GetOp, but points data at the pushed bytes in the script instead of copying them. */
+    bool GetOp(const_iterator& pc, opcodetype& opcodeRet, Span<const unsigned char>& data) const;
+
 
     /** Encode/decode small integers: */
     static int DecodeOP_N(opcodetype opcode)
@@ -51,6 +51,10 @@ const char* ScriptErrorString(const ScriptError serror)
             return "Negative locktime";
         case SCRIPT_ERR_UNSATISFIED_LOCKTIME:
             return "Locktime requirement not satisfied";
+        case SCRIPT_ERR_SCHNORR_SIG_SIZE:
+            return "Schnorr signature is not 64 bytes followed by a hash type";
+        case SCRIPT_ERR_CHECKSCHNORRVERIFY:
+            return "Script failed an OP_CHECKSCHNORRVERIFY operation";
         case SCRIPT_ERR_SIG_HASHTYPE:
             return "Signature hash type missing or not understood";
         case SCRIPT_ERR_SIG_DER:
@@ -5,11 +5,16 @@
 
 #include <script/sigcache.h>
 
+#include <clientversion.h>
+#include <fs.h>
 #include <memusage.h>
+#include <metrics.h>
 #include <pubkey.h>
 #include <random.h>
+#include <streams.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/time.h>
 
 #include <cuckoocache.h>
 #include <boost/thread.hpp>
@@ -29,8 +34,38 @@ private:
     map_type setValid;
     boost::shared_mutex cs_sigcache;
 
+    const std::string name;
+    CMetricCounter& hits;
+    CMetricCounter& misses;
+    CMetricCounter& rejected;
+    //! The room for entries, and an estimate of how many are held: inserts less erasing hits
+    uint32_t nCapacity = 0;
+    std::atomic<uint32_t> nLive{0};
+    //! The moving average cost of the entries offered while the cache is full
+    uint64_t nCostAverage = 0;
+    FastRandomContext rng;
+
+    /**
+     * Whether to insert an entry saving a verification of the given cost. Once the cache is
+     * full every insertion evicts an entry; an entry cheaper than the average one offered
+     * is then only let in with the probability cost / average, so the entries that are the
+     * most expensive to verify again are the ones that stay. A cost of 0 is always let in.
+     */
+    bool Admit(uint64_t cost)
+    {
+        if (cost == 0 || nLive < nCapacity)
+            return true;
+        nCostAverage = nCostAverage == 0 ? cost : (nCostAverage * 15 + cost) / 16;
+        return cost >= nCostAverage || rng.randrange(nCostAverage) < cost;
+    }
+
 public:
-    CSignatureCache()
+    explicit CSignatureCache(const std::string& nameIn)
+        : name(nameIn),
+          hits(GetMetrics().Counter("sigcache_" + nameIn + "_hits", "Verifications found in the " + nameIn + " cache")),
+          misses(GetMetrics().Counter("sigcache_" + nameIn + "_misses", "Verifications not found in the " + nameIn + " cache")),
+          rejected(GetMetrics().Counter("sigcache_" + nameIn + "_rejected", "Verifications left out of the full " + nameIn + " cache as cheaper than the average one")),
+          rng(true)
     {
         GetRandBytes(nonce.begin(), 32);
     }
@@ -41,7 +76,14 @@ public:
         CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
     }
 
-    void ComputeEntry(uint256& entry, const std::vector<unsigned char>& proof, const std::vector<unsigned char>& commitment) {
+    //! Schnorr entries also hash a tag, so they never match the entry of an ECDSA signature with the same bytes.
+    void ComputeSchnorrEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+    {
+        static const unsigned char tag = 'S';
+        CSHA256().Write(nonce.begin(), 32).Write(&tag, 1).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
+    }
+
+    void ComputeEntry(uint256& entry, const std::vector<unsigned char>& proof, const CCommitmentData& commitment) {
         CSHA256().Write(nonce.begin(), nonce.size()).Write(proof.data(), proof.size()).Write(commitment.data(), commitment.size()).Finalize(entry.begin());
     }
     void ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& proof, const std::vector<unsigned char>& commitment) {
@@ -52,17 +94,76 @@ public:
     Get(const uint256& entry, const bool erase)
     {
         boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.contains(entry, erase);
+        if (!setValid.contains(entry, erase)) {
+            misses.Add();
+            return false;
+        }
+        hits.Add();
+        if (erase) {
+            uint32_t n = nLive.load(std::memory_order_relaxed);
+            while (n > 0 && !nLive.compare_exchange_weak(n, n - 1, std::memory_order_relaxed)) {}
+        }
+        return true;
     }
 
-    void Set(uint256& entry)
+    //! Insert entry, saving a verification of the given cost, if it is admitted.
+    void Set(uint256& entry, uint64_t cost = 0)
     {
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        if (!Admit(cost)) {
+            rejected.Add();
+            return;
+        }
         setValid.insert(entry);
+        if (nLive < nCapacity)
+            nLive++;
     }
     uint32_t setup_bytes(size_t n)
     {
-        return setValid.setup_bytes(n);
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        nCapacity = setValid.setup_bytes(n);
+        nLive = 0;
+        return nCapacity;
+    }
+
+    SignatureCacheStats GetStats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        SignatureCacheStats stats;
+        stats.name = name;
+        stats.nCapacity = nCapacity;
+        stats.nEntries = nLive;
+        stats.nHits = hits.Get();
+        stats.nMisses = misses.Get();
+        stats.nRejected = rejected.Get();
+        return stats;
+    }
+
+    //! Write the nonce and the entries, returning how many were written.
+    uint64_t Dump(CAutoFile& file)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        uint64_t nEntries = 0;
+        setValid.for_each([&nEntries](const uint256&) { nEntries++; });
+        file << nonce << nEntries;
+        setValid.for_each([&file](const uint256& entry) { file << entry; });
+        return nEntries;
+    }
+
+    //! Read what Dump wrote, the entries only match under its nonce.
+    uint64_t Load(CAutoFile& file)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        uint64_t nEntries;
+        file >> nonce >> nEntries;
+        for (uint64_t i = 0; i < nEntries; i++) {
+            uint256 entry;
+            file >> entry;
+            setValid.insert(entry);
+            if (nLive < nCapacity)
+                nLive++;
+        }
+        return nEntries;
     }
 };
 
@@ -72,10 +173,49 @@ public:
  * call overhead associated with local static variables even though
  * signatureCache could be made local to VerifySignature.
 */
-static CSignatureCache signatureCache;
+static CSignatureCache signatureCache("signature");
 
-static CSignatureCache rangeProofCache;
-static CSignatureCache surjectionProofCache;
+static CSignatureCache rangeProofCache("rangeproof");
+static CSignatureCache surjectionProofCache("surjectionproof");
+
+/** Size cache from -arg in MiB, or -maxsigcachesize if that is not set. */
+static void InitProofCache(CSignatureCache& cache, const std::string& arg, const std::string& description)
+{
+    // nMaxCacheSize is unsigned. If the size is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    const int64_t nSize = gArgs.GetArg(arg, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE));
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, nSize), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = cache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for %s cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, description, nElems);
+}
+
+/**
+ * Most memory the frames of a Bulletproof verification may take. A full batch of 64-bit
+ * proofs needs about 300 KiB, so it is verified in one multi-multiplication.
+ */
+static const size_t BULLETPROOF_SCRATCH_SIZE = 1 << 20;
+
+/** The scratch space of the Bulletproof verifications of a thread, reused by all its batches. */
+class BulletproofScratch
+{
+private:
+    secp256k1_scratch_space* scratch = nullptr;
+
+public:
+    ~BulletproofScratch()
+    {
+        if (scratch)
+            secp256k1_scratch_space_destroy(scratch);
+    }
+
+    secp256k1_scratch_space* Get(const secp256k1_context* ctx)
+    {
+        if (!scratch)
+            scratch = secp256k1_scratch_space_create(ctx, BULLETPROOF_SCRATCH_SIZE);
+        return scratch;
+    }
+};
 
 } // namespace
 
@@ -104,29 +244,64 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
     return true;
 }
 
+bool CachingTransactionSignatureChecker::VerifySchnorrSignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+{
+    uint256 entry;
+    signatureCache.ComputeSchnorrEntry(entry, sighash, vchSig, pubkey);
+    if (signatureCache.Get(entry, !store))
+        return true;
+    if (schnorrBatch) {
+        schnorrBatch->Add(vchSig, pubkey, sighash);
+        return true;
+    }
+    if (!TransactionSignatureChecker::VerifySchnorrSignature(vchSig, pubkey, sighash))
+        return false;
+    if (store)
+        signatureCache.Set(entry);
+    return true;
+}
+
+void CSchnorrBatch::Add(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    vchSigs.push_back(vchSig);
+    pubkeys.push_back(pubkey);
+    hashes.push_back(sighash);
+}
+
+bool CSchnorrBatch::Verify()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (!CPubKey::VerifySchnorrBatch(vchSigs, hashes, pubkeys))
+        return false;
+    if (store) {
+        for (size_t i = 0; i < vchSigs.size(); i++) {
+            uint256 entry;
+            signatureCache.ComputeSchnorrEntry(entry, hashes[i], vchSigs[i], pubkeys[i]);
+            signatureCache.Set(entry);
+        }
+    }
+    return true;
+}
+
 // To be called once in AppInit2/TestingSetup to initialize the rangeproof cache
 void InitRangeproofCache()
 {
-    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-    size_t nElems = rangeProofCache.setup_bytes(nMaxCacheSize);
-    LogPrintf("Using %zu MiB out of %zu requested for rangeproof cache, able to store %zu elements\n",
-            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+    InitProofCache(rangeProofCache, "-maxrangeproofcachesize", "rangeproof");
 }
 
 // To be called once in AppInit2/TestingSetup to initialize the surjectionrproof cache
 void InitSurjectionproofCache()
 {
-    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
-    // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-    size_t nElems = surjectionProofCache.setup_bytes(nMaxCacheSize);
-    LogPrintf("Using %zu MiB out of %zu requested for surjectionproof cache, able to store %zu elements\n",
-            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+    InitProofCache(surjectionProofCache, "-maxsurjectionproofcachesize", "surjectionproof");
 }
 
-bool CachingRangeProofChecker::VerifyRangeProof(const std::vector<unsigned char>& vchRangeProof, const std::vector<unsigned char>& vchValueCommitment, const std::vector<unsigned char>& vchAssetCommitment, const CScript& scriptPubKey, const secp256k1_context* secp256k1_ctx_verify_amounts) const
+std::vector<SignatureCacheStats> GetSignatureCacheStats()
+{
+    return {signatureCache.GetStats(), rangeProofCache.GetStats(), surjectionProofCache.GetStats()};
+}
+
+bool CachingRangeProofChecker::VerifyRangeProof(const std::vector<unsigned char>& vchRangeProof, const CCommitmentData& vchValueCommitment, const CCommitmentData& vchAssetCommitment, const CScript& scriptPubKey, const secp256k1_context* secp256k1_ctx_verify_amounts) const
 {
     uint256 entry;
     rangeProofCache.ComputeEntry(entry, vchRangeProof, vchValueCommitment);
@@ -162,21 +337,74 @@ bool CachingRangeProofChecker::VerifyRangeProof(const std::vector<unsigned char>
     }
 
     if (store) {
-        rangeProofCache.Set(entry);
+        rangeProofCache.Set(entry, vchRangeProof.size());
     }
 
     return true;
 }
 
-bool CachingSurjectionProofChecker::VerifySurjectionProof(secp256k1_surjectionproof& proof, std::vector<secp256k1_generator>& vTags, secp256k1_generator& gen, const secp256k1_context* secp256k1_ctx_verify_amounts, const uint256& wtxid) const
+bool CachingRangeProofChecker::VerifyBulletproofs(const std::vector<const std::vector<unsigned char>*>& vRangeProofs, const std::vector<CCommitmentData>& vValueCommitments, const std::vector<secp256k1_generator>& vGenerators, const std::vector<CScript>& vScriptPubKeys, const secp256k1_context* secp256k1_ctx_verify_amounts, const secp256k1_bulletproof_generators* gens) const
 {
+    std::vector<uint256> entries;
+    std::vector<const unsigned char*> proofs;
+    std::vector<secp256k1_pedersen_commitment> commits;
+    std::vector<secp256k1_generator> generators;
+    std::vector<uint64_t> min_values;
+    std::vector<const unsigned char*> extra_commits;
+    std::vector<size_t> extra_commit_lens;
+    for (size_t i = 0; i < vRangeProofs.size(); i++) {
+        uint256 entry;
+        rangeProofCache.ComputeEntry(entry, *vRangeProofs[i], vValueCommitments[i]);
+        if (rangeProofCache.Get(entry, !store)) {
+            continue;
+        }
+
+        secp256k1_pedersen_commitment commit;
+        if (secp256k1_pedersen_commitment_parse(secp256k1_ctx_verify_amounts, &commit, &vValueCommitments[i][0]) != 1)
+            return false;
 
-    // Serialize proof
-    std::vector<unsigned char> vchproof;
-    size_t proof_len = secp256k1_surjectionproof_serialized_size(secp256k1_ctx_verify_amounts, &proof);
-    vchproof.resize(proof_len);
-    assert(secp256k1_surjectionproof_serialize(secp256k1_ctx_verify_amounts, vchproof.data(), &proof_len, &proof) == 1);
+        entries.push_back(entry);
+        proofs.push_back(vRangeProofs[i]->data());
+        commits.push_back(commit);
+        generators.push_back(vGenerators[i]);
+        // Like a Borromean proof, a spendable output has to prove a value of at least 1.
+        min_values.push_back(vScriptPubKeys[i].IsUnspendable() ? 0 : 1);
+        extra_commits.push_back(vScriptPubKeys[i].size() ? &vScriptPubKeys[i].front() : NULL);
+        extra_commit_lens.push_back(vScriptPubKeys[i].size());
+    }
+    if (entries.empty()) {
+        return true;
+    }
+
+    // One commitment per proof.
+    std::vector<const uint64_t*> min_value_ptrs;
+    std::vector<const secp256k1_pedersen_commitment*> commit_ptrs;
+    for (size_t i = 0; i < entries.size(); i++) {
+        min_value_ptrs.push_back(&min_values[i]);
+        commit_ptrs.push_back(&commits[i]);
+    }
 
+    static thread_local BulletproofScratch scratch;
+    secp256k1_scratch_space* space = scratch.Get(secp256k1_ctx_verify_amounts);
+    if (!space) {
+        return false;
+    }
+    int ret = secp256k1_bulletproof_rangeproof_verify_multi(secp256k1_ctx_verify_amounts, space, gens, proofs.data(), proofs.size(), vRangeProofs[0]->size(), min_value_ptrs.data(), commit_ptrs.data(), 1, 64, generators.data(), extra_commits.data(), extra_commit_lens.data());
+    if (ret != 1) {
+        return false;
+    }
+
+    if (store) {
+        for (auto& entry : entries) {
+            rangeProofCache.Set(entry, vRangeProofs[0]->size());
+        }
+    }
+
+    return true;
+}
+
+bool CachingSurjectionProofChecker::VerifySurjectionProof(const std::vector<unsigned char>& vchproof, const std::vector<secp256k1_generator>& vTags, const secp256k1_generator& gen, const secp256k1_context* secp256k1_ctx_verify_amounts, const uint256& wtxid) const
+{
     // wtxid commits to all data including surj targets
     // we need to specify the proof and output asset point to be unique
     uint256 entry;
@@ -186,13 +414,68 @@ bool CachingSurjectionProofChecker::VerifySurjectionProof(secp256k1_surjectionpr
         return true;
     }
 
+    secp256k1_surjectionproof proof;
+    if (vchproof.empty() || secp256k1_surjectionproof_parse(secp256k1_ctx_verify_amounts, &proof, vchproof.data(), vchproof.size()) != 1) {
+        return false;
+    }
+
     if (secp256k1_surjectionproof_verify(secp256k1_ctx_verify_amounts, &proof, vTags.data(), vTags.size(), &gen) != 1) {
         return false;
     }
 
     if (store) {
-        surjectionProofCache.Set(entry);
+        surjectionProofCache.Set(entry, vchproof.size());
+    }
+
+    return true;
+}
+static const uint64_t SIGCACHE_DUMP_VERSION = 1;
+
+bool DumpSignatureCaches()
+{
+    int64_t start = GetTimeMicros();
+    try {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "sigcache.dat.new", "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return false;
+        }
+        file << SIGCACHE_DUMP_VERSION;
+        uint64_t nEntries = signatureCache.Dump(file);
+        nEntries += rangeProofCache.Dump(file);
+        nEntries += surjectionProofCache.Dump(file);
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        RenameOver(GetDataDir() / "sigcache.dat.new", GetDataDir() / "sigcache.dat");
+        LogPrintf("Dumped %u signature cache entries in %.3fs\n", nEntries, (GetTimeMicros() - start) * 0.000001);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump signature caches: %s. Continuing anyway.\n", e.what());
+        return false;
     }
+    return true;
+}
 
+bool LoadSignatureCaches()
+{
+    int64_t start = GetTimeMicros();
+    CAutoFile file(fsbridge::fopen(GetDataDir() / "sigcache.dat", "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return false;
+    }
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != SIGCACHE_DUMP_VERSION) {
+            return false;
+        }
+        uint64_t nEntries = signatureCache.Load(file);
+        nEntries += rangeProofCache.Load(file);
+        nEntries += surjectionProofCache.Load(file);
+        LogPrintf("Loaded %u signature cache entries in %.3fs\n", nEntries, (GetTimeMicros() - start) * 0.000001);
+    } catch (const std::exception& e) {
+        // The entries read before the damage are still valid under the nonce read with them.
+        LogPrintf("Failed to load signature caches: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
     return true;
-}
\ No newline at end of file
+}
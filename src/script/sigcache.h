@@ -6,11 +6,16 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include <primitives/confidential.h>
+#include <pubkey.h>
 #include <script/interpreter.h>
 
 #include <secp256k1.h>
+#include <secp256k1_bulletproofs.h>
 #include <secp256k1_rangeproof.h>
 #include <secp256k1_surjectionproof.h>
+#include <mutex>
+#include <string>
 #include <vector>
 
 // DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
@@ -19,8 +24,8 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
-
-class CPubKey;
+// Default for -persistsigcache
+static const bool DEFAULT_PERSIST_SIGCACHE = false;
 
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
@@ -43,15 +48,41 @@ public:
     }
 };
 
+/**
+ * Schnorr signatures collected from the script checks of a block, to be verified in one batch
+ * once all of them are in. Scripts on the check queue threads add to it concurrently.
+ */
+class CSchnorrBatch
+{
+private:
+    bool store;
+    std::mutex cs;
+    std::vector<std::vector<unsigned char>> vchSigs;
+    std::vector<uint256> hashes;
+    std::vector<CPubKey> pubkeys;
+
+public:
+    explicit CSchnorrBatch(bool storeIn) : store(storeIn) {}
+
+    void Add(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash);
+
+    /** Verify the collected signatures, and add them to the signature cache if they are valid. */
+    bool Verify();
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
     bool store;
+    CSchnorrBatch* schnorrBatch;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CConfidentialValue& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CConfidentialValue& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn, CSchnorrBatch* schnorrBatchIn = nullptr) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn), schnorrBatch(schnorrBatchIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
+
+    /** Uncached Schnorr signatures are deferred to schnorrBatch if there is one, and reported valid here. */
+    bool VerifySchnorrSignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
 
 void InitSignatureCache();
@@ -65,7 +96,10 @@ public:
         store = storeIn;
     };
 
-    bool VerifyRangeProof(const std::vector<unsigned char>& vchRangeProof, const std::vector<unsigned char>& vchValueCommitment, const std::vector<unsigned char>& vchAssetCommitment, const CScript& scriptPubKey, const secp256k1_context* ctx) const;
+    bool VerifyRangeProof(const std::vector<unsigned char>& vchRangeProof, const CCommitmentData& vchValueCommitment, const CCommitmentData& vchAssetCommitment, const CScript& scriptPubKey, const secp256k1_context* ctx) const;
+
+    /** Verify the Bulletproofs that are not cached yet in a single batch, entry i of each vector describes one output. */
+    bool VerifyBulletproofs(const std::vector<const std::vector<unsigned char>*>& vRangeProofs, const std::vector<CCommitmentData>& vValueCommitments, const std::vector<secp256k1_generator>& vGenerators, const std::vector<CScript>& vScriptPubKeys, const secp256k1_context* ctx, const secp256k1_bulletproof_generators* gens) const;
 
 };
 
@@ -78,11 +112,38 @@ public:
         store = storeIn;
     };
 
-    bool VerifySurjectionProof(secp256k1_surjectionproof& proof, std::vector<secp256k1_generator>& vTags, secp256k1_generator& gen, const secp256k1_context* ctx, const uint256& wtxid) const;
+    /** Verify a serialized surjection proof, it is only parsed if it is not cached. */
+    bool VerifySurjectionProof(const std::vector<unsigned char>& vchproof, const std::vector<secp256k1_generator>& vTags, const secp256k1_generator& gen, const secp256k1_context* ctx, const uint256& wtxid) const;
 
 };
 
+/**
+ * Size the range proof and surjection proof caches from -maxrangeproofcachesize and
+ * -maxsurjectionproofcachesize, each -maxsigcachesize if not set. Once full, they favour
+ * the largest proofs, whose verification costs the most (see CSignatureCache::Admit).
+ */
 void InitRangeproofCache();
 void InitSurjectionproofCache();
 
+/** The use of one of the signature and proof caches. */
+struct SignatureCacheStats
+{
+    std::string name;
+    uint32_t nCapacity = 0;     //!< the room for entries
+    uint32_t nEntries = 0;      //!< an estimate of the entries held
+    uint64_t nHits = 0;
+    uint64_t nMisses = 0;
+    uint64_t nRejected = 0;     //!< entries left out of the full cache as cheap to verify again
+};
+
+std::vector<SignatureCacheStats> GetSignatureCacheStats();
+
+/** Write the signature, range proof and surjection proof caches, with their nonces, to sigcache.dat. */
+bool DumpSignatureCaches();
+/**
+ * Fill the caches from sigcache.dat, taking over the nonces it was written with. To be called
+ * once the caches are initialized and before anything is verified.
+ */
+bool LoadSignatureCaches();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
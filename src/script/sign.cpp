@@ -10,13 +10,18 @@
 #include <primitives/transaction.h>
 #include <script/standard.h>
 #include <uint256.h>
+#include <util/system.h>
 
 #include <chainparams.h>
 
+#include <algorithm>
+#include <future>
+
 typedef std::vector<unsigned char> valtype;
 
-MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CConfidentialValue& amountIn, int nHashTypeIn)
-    : txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), checker(txTo, nIn, amountIn) {}
+MutableTransactionSignatureCreator::MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CConfidentialValue& amountIn, int nHashTypeIn, const PrecomputedTransactionData* txdataIn)
+    : txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), txdata(txdataIn),
+      checker(txdataIn ? MutableTransactionSignatureChecker(txTo, nIn, amountIn, *txdataIn) : MutableTransactionSignatureChecker(txTo, nIn, amountIn)) {}
 
 bool MutableTransactionSignatureCreator::CreateSig(const SigningProvider& provider, std::vector<unsigned char>& vchSig, const CKeyID& address, const CScript& scriptCode, SigVersion sigversion) const
 {
@@ -28,7 +33,7 @@ bool MutableTransactionSignatureCreator::CreateSig(const SigningProvider& provid
     if (sigversion == SigVersion::WITNESS_V0 && !key.IsCompressed())
         return false;
 
-    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion);
+    uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion, txdata);
     if (!key.Sign(hash, vchSig))
         return false;
     vchSig.push_back((unsigned char)nHashType);
@@ -508,3 +513,22 @@ FlatSigningProvider Merge(const FlatSigningProvider& a, const FlatSigningProvide
     ret.origins.insert(b.origins.begin(), b.origins.end());
     return ret;
 }
+
+void SignInputsParallel(size_t nInputs, const std::function<void(size_t)>& sign)
+{
+    auto signRange = [&sign](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sign(i);
+        }
+    };
+    const size_t nThreads = nInputs < PARALLEL_SIGN_INPUTS_MIN_COUNT ? 1 : std::max(GetNumCores(), 1);
+    const size_t nChunk = (nInputs + nThreads - 1) / nThreads;
+    std::vector<std::future<void>> signing;
+    for (size_t begin = nChunk; begin < nInputs; begin += nChunk) {
+        signing.push_back(std::async(std::launch::async, signRange, begin, std::min(begin + nChunk, nInputs)));
+    }
+    signRange(0, std::min(nChunk, nInputs));
+    for (auto& done : signing) {
+        done.get();
+    }
+}
@@ -12,6 +12,8 @@
 #include <script/interpreter.h>
 #include <streams.h>
 
+#include <functional>
+
 class CKey;
 class CKeyID;
 class CScript;
@@ -104,10 +106,12 @@ class MutableTransactionSignatureCreator : public BaseSignatureCreator {
     unsigned int nIn;
     int nHashType;
     CConfidentialValue amount;
+    const PrecomputedTransactionData* txdata;
     const MutableTransactionSignatureChecker checker;
 
 public:
-    MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CConfidentialValue& amountIn, int nHashTypeIn = SIGHASH_ALL);
+    /** txdataIn: the signature hash data of txToIn shared by the creators of its inputs, or nullptr. */
+    MutableTransactionSignatureCreator(const CMutableTransaction* txToIn, unsigned int nInIn, const CConfidentialValue& amountIn, int nHashTypeIn = SIGHASH_ALL, const PrecomputedTransactionData* txdataIn = nullptr);
     const BaseSignatureChecker& Checker() const override { return checker; }
     bool CreateSig(const SigningProvider& provider, std::vector<unsigned char>& vchSig, const CKeyID& keyid, const CScript& scriptCode, SigVersion sigversion) const override;
 };
@@ -226,6 +230,17 @@ bool SignSignature(const SigningProvider &provider, const CTransaction& txFrom,
 SignatureData DataFromTransaction(const CMutableTransaction& tx, unsigned int nIn, const CTxOut& txout);
 void UpdateInput(CTxIn& input, const SignatureData& data);
 
+/** Minimum number of inputs for SignInputsParallel to use more than one thread. */
+static const size_t PARALLEL_SIGN_INPUTS_MIN_COUNT = 8;
+
+/**
+ * Call sign(i) for each input i < nInputs, on as many threads as there are cores once there are
+ * PARALLEL_SIGN_INPUTS_MIN_COUNT inputs. sign may only write what belongs to its own input, for the
+ * caller to apply in input order afterwards. Its provider must not take locks the caller holds, like
+ * CWallet::GetKeyOrigin does cs_wallet; sign through a HidingSigningProvider that hides the origins.
+ */
+void SignInputsParallel(size_t nInputs, const std::function<void(size_t)>& sign);
+
 /* Check whether we know how to sign for an output like this, assuming we
  * have all private keys. While this function does not need private keys, the passed
  * provider is used to look up public keys and redeemscripts by hash.
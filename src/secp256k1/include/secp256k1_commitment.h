@@ -81,6 +81,31 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_pedersen_commit(
   const secp256k1_generator *blind_gen
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(5) SECP256K1_ARG_NONNULL(6);
 
+/** Generate a Pedersen commitment on the generator of a table, blinding factor generator 'g'.
+ *  Returns 1: Commitment successfully created.
+ *          0: Error. A blinding factor is larger than the group order
+ *             (probability for random 32 byte number < 2^-127) or results in the
+ *             point at infinity. Retry with a different factor.
+ *  In:     ctx:             pointer to a context object, initialized for signing (cannot be NULL)
+ *          blind:           pointer to a 32-byte blinding factor (cannot be NULL)
+ *          value:           unsigned 64-bit integer value to commit to.
+ *          value_table:     the table of the value generator 'h' (cannot be NULL)
+ *          value_gen_blind: pointer to the 32-byte factor 'h' was blinded with by
+ *                           secp256k1_generator_table_blind, NULL for 'h' itself
+ *  Out:    commit:          pointer to the commitment (cannot be NULL)
+ *
+ *  The commitment equals that of secp256k1_pedersen_commit with the (blinded) generator,
+ *  but takes the multiples of 'h' from the table and those of 'g' from the context.
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_pedersen_commit_table(
+  const secp256k1_context* ctx,
+  secp256k1_pedersen_commitment *commit,
+  const unsigned char *blind,
+  uint64_t value,
+  const secp256k1_generator_table *value_table,
+  const unsigned char *value_gen_blind
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(5);
+
 /** Generate a Pedersen commitment from two blinding factors.
  *  Returns 1: Commitment successfully created.
  *          0: Error. The blinding factor is larger than the group order
@@ -92,6 +92,64 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_generator_generate_blin
     const unsigned char *blind32
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
 
+/** Opaque structure holding a generator along with precomputed multiples of it, which
+ *  commit to values with secp256k1_pedersen_commit_table without a generic multiplication.
+ *  A table is immutable once created, and may be shared between threads and contexts.
+ */
+typedef struct secp256k1_generator_table secp256k1_generator_table;
+
+/** Allocate and precompute the table of a generator, 16 KiB.
+ *
+ *  Returns: the table, or NULL if allocation failed.
+ *  Args: ctx:     a secp256k1 context object
+ *  In:   gen:     the generator, usually that of an asset often committed to
+ */
+SECP256K1_API secp256k1_generator_table* secp256k1_generator_table_create(
+    const secp256k1_context* ctx,
+    const secp256k1_generator* gen
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2);
+
+/** Destroy a table created by secp256k1_generator_table_create.
+ *
+ *  Args:    ctx:      a secp256k1 context object
+ *  In:      table:    the table to free, may be NULL
+ */
+SECP256K1_API void secp256k1_generator_table_destroy(
+    const secp256k1_context* ctx,
+    secp256k1_generator_table* table
+) SECP256K1_ARG_NONNULL(1);
+
+/** Get the generator of a table.
+ *
+ *  Args: ctx:     a secp256k1 context object
+ *  Out:  gen:     the generator the table was created for
+ *  In:   table:   the table
+ */
+SECP256K1_API void secp256k1_generator_table_generator(
+    const secp256k1_context* ctx,
+    secp256k1_generator* gen,
+    const secp256k1_generator_table* table
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3);
+
+/** Blind the generator of a table.
+ *
+ *  Returns: 0 when blind is out of range. 1 otherwise.
+ *  Args: ctx:     a secp256k1 context object, initialized for signing
+ *  Out:  gen:     a generator object
+ *  In:   table:   the table of the generator to blind
+ *        blind32: a 32-byte secret value to blind the generator with.
+ *
+ *  If the generator of the table came from secp256k1_generator_generate with a seed, the
+ *  result equals that of secp256k1_generator_generate_blinded with the seed and blind32,
+ *  without hashing the seed to the curve again.
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_generator_table_blind(
+    const secp256k1_context* ctx,
+    secp256k1_generator* gen,
+    const secp256k1_generator_table* table,
+    const unsigned char *blind32
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
+
 # ifdef __cplusplus
 }
 # endif
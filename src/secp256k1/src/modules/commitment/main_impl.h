@@ -77,6 +77,44 @@ int secp256k1_pedersen_commitment_serialize(const secp256k1_context* ctx, unsign
     return 1;
 }
 
+/* rj += sec * G, with the precomputed multiples of G of the context. */
+static void secp256k1_pedersen_ecmult_gen_add(const secp256k1_context* ctx, secp256k1_gej *rj, const secp256k1_scalar *sec) {
+    secp256k1_gej bj;
+    secp256k1_ge bp;
+
+    /* zero blinding factor indicates that we are not trying to be zero-knowledge,
+     * so not being constant-time in this case is OK. */
+    if (secp256k1_scalar_is_zero(sec)) {
+        return;
+    }
+    secp256k1_ecmult_gen(&ctx->ecmult_gen_ctx, &bj, sec);
+    secp256k1_ge_set_gej(&bp, &bj);
+    secp256k1_gej_add_ge(rj, rj, &bp);
+
+    secp256k1_gej_clear(&bj);
+    secp256k1_ge_clear(&bp);
+}
+
+/* rj = value * gen, from the precomputed multiples of gen in its table, in constant time. */
+static void secp256k1_pedersen_ecmult_table(secp256k1_gej *rj, const secp256k1_generator_table *table, uint64_t value) {
+    secp256k1_ge_storage adds;
+    secp256k1_ge add;
+    int w, i, bits;
+
+    memset(&adds, 0, sizeof(adds));
+    secp256k1_gej_set_infinity(rj);
+    for (w = 0; w < SECP256K1_GENERATOR_TABLE_WINDOWS; w++) {
+        bits = (value >> (4 * w)) & 15;
+        for (i = 0; i < SECP256K1_GENERATOR_TABLE_POINTS; i++) {
+            secp256k1_ge_storage_cmov(&adds, &table->prec[w][i], i == bits);
+        }
+        secp256k1_ge_from_storage(&add, &adds);
+        secp256k1_gej_add_ge(rj, rj, &add);
+    }
+    bits = 0;
+    secp256k1_ge_clear(&add);
+}
+
 /* Generates a pedersen commitment: *commit = blind * G + value * G2. The blinding factor is 32 bytes.*/
 int secp256k1_pedersen_commit(const secp256k1_context* ctx, secp256k1_pedersen_commitment *commit, const unsigned char *blind, uint64_t value, const secp256k1_generator* value_gen, const secp256k1_generator* blind_gen) {
     secp256k1_ge value_genp;
@@ -95,7 +133,55 @@ int secp256k1_pedersen_commit(const secp256k1_context* ctx, secp256k1_pedersen_c
     secp256k1_generator_load(&blind_genp, blind_gen);
     secp256k1_scalar_set_b32(&sec, blind, &overflow);
     if (!overflow) {
-        secp256k1_pedersen_ecmult(&rj, &sec, value, &value_genp, &blind_genp);
+        if (memcmp(blind_gen, &secp256k1_generator_const_g, sizeof(*blind_gen)) == 0 && secp256k1_ecmult_gen_context_is_built(&ctx->ecmult_gen_ctx)) {
+            /* The blinding factor goes on G, which the context has precomputed. */
+            secp256k1_scalar vs;
+            secp256k1_scalar_set_u64(&vs, value);
+            secp256k1_ecmult_const(&rj, &value_genp, &vs, 64);
+            secp256k1_pedersen_ecmult_gen_add(ctx, &rj, &sec);
+            secp256k1_scalar_clear(&vs);
+        } else {
+            secp256k1_pedersen_ecmult(&rj, &sec, value, &value_genp, &blind_genp);
+        }
+        if (!secp256k1_gej_is_infinity(&rj)) {
+            secp256k1_ge_set_gej(&r, &rj);
+            secp256k1_pedersen_commitment_save(commit, &r);
+            ret = 1;
+        }
+        secp256k1_gej_clear(&rj);
+        secp256k1_ge_clear(&r);
+    }
+    secp256k1_scalar_clear(&sec);
+    return ret;
+}
+
+/* Generates a pedersen commitment on the generator of a table, blinded by value_gen_blind if given:
+ * *commit = blind * G + value * (T + value_gen_blind * G) = (blind + value * value_gen_blind) * G + value * T. */
+int secp256k1_pedersen_commit_table(const secp256k1_context* ctx, secp256k1_pedersen_commitment *commit, const unsigned char *blind, uint64_t value, const secp256k1_generator_table *value_table, const unsigned char *value_gen_blind) {
+    secp256k1_gej rj;
+    secp256k1_ge r;
+    secp256k1_scalar sec;
+    secp256k1_scalar gen_blind;
+    secp256k1_scalar vs;
+    int overflow;
+    int ret = 0;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_gen_context_is_built(&ctx->ecmult_gen_ctx));
+    ARG_CHECK(commit != NULL);
+    ARG_CHECK(blind != NULL);
+    ARG_CHECK(value_table != NULL);
+    secp256k1_scalar_set_b32(&sec, blind, &overflow);
+    if (!overflow && value_gen_blind != NULL) {
+        secp256k1_scalar_set_b32(&gen_blind, value_gen_blind, &overflow);
+        secp256k1_scalar_set_u64(&vs, value);
+        secp256k1_scalar_mul(&gen_blind, &gen_blind, &vs);
+        secp256k1_scalar_add(&sec, &sec, &gen_blind);
+        secp256k1_scalar_clear(&gen_blind);
+        secp256k1_scalar_clear(&vs);
+    }
+    if (!overflow) {
+        secp256k1_pedersen_ecmult_table(&rj, value_table, value);
+        secp256k1_pedersen_ecmult_gen_add(ctx, &rj, &sec);
         if (!secp256k1_gej_is_infinity(&rj)) {
             secp256k1_ge_set_gej(&r, &rj);
             secp256k1_pedersen_commitment_save(commit, &r);
@@ -335,12 +335,68 @@ void test_switch(void) {
     CHECK(memcmp(blind_switch_2, blind_switch, 32) == 0);
 }
 
+static void test_generator_table(void) {
+    unsigned char seed[32];
+    unsigned char blind[32];
+    unsigned char gen_blind[32];
+    const unsigned char zero[32] = {0};
+    secp256k1_generator gen;
+    secp256k1_generator blinded;
+    secp256k1_generator blinded_table;
+    secp256k1_generator_table *table;
+    secp256k1_pedersen_commitment commit;
+    secp256k1_pedersen_commitment commit_table;
+    secp256k1_scalar s;
+    uint64_t values[5];
+    int i;
+
+    secp256k1_rand256(seed);
+    CHECK(secp256k1_generator_generate(ctx, &gen, seed));
+    table = secp256k1_generator_table_create(ctx, &gen);
+    CHECK(table != NULL);
+    secp256k1_generator_table_generator(ctx, &blinded, table);
+    CHECK(memcmp(&blinded, &gen, sizeof(gen)) == 0);
+
+    random_scalar_order(&s);
+    secp256k1_scalar_get_b32(gen_blind, &s);
+    CHECK(secp256k1_generator_generate_blinded(ctx, &blinded, seed, gen_blind));
+    CHECK(secp256k1_generator_table_blind(ctx, &blinded_table, table, gen_blind));
+    CHECK(memcmp(&blinded, &blinded_table, sizeof(blinded)) == 0);
+
+    values[0] = 0;
+    values[1] = 1;
+    values[2] = UINT64_MAX;
+    values[3] = secp256k1_rands64(0, UINT64_MAX);
+    values[4] = secp256k1_rand32();
+    for (i = 0; i < 5; i++) {
+        random_scalar_order(&s);
+        secp256k1_scalar_get_b32(blind, &s);
+        CHECK(secp256k1_pedersen_commit(ctx, &commit, blind, values[i], &gen, &secp256k1_generator_const_g));
+        CHECK(secp256k1_pedersen_commit_table(ctx, &commit_table, blind, values[i], table, NULL));
+        CHECK(memcmp(commit.data, commit_table.data, 33) == 0);
+        CHECK(secp256k1_pedersen_commit(ctx, &commit, blind, values[i], &blinded, &secp256k1_generator_const_g));
+        CHECK(secp256k1_pedersen_commit_table(ctx, &commit_table, blind, values[i], table, gen_blind));
+        CHECK(memcmp(commit.data, commit_table.data, 33) == 0);
+        if (values[i] != 0) {
+            /* The explicit values of a transaction commit with a zero blinding factor. */
+            CHECK(secp256k1_pedersen_commit(ctx, &commit, zero, values[i], &gen, &secp256k1_generator_const_g));
+            CHECK(secp256k1_pedersen_commit_table(ctx, &commit_table, zero, values[i], table, NULL));
+            CHECK(memcmp(commit.data, commit_table.data, 33) == 0);
+        }
+    }
+    CHECK(!secp256k1_pedersen_commit_table(ctx, &commit_table, zero, 0, table, NULL));
+    secp256k1_generator_table_destroy(ctx, table);
+}
+
 void run_commitment_tests(void) {
     int i;
     test_commitment_api();
     for (i = 0; i < 10*count; i++) {
         test_pedersen();
     }
+    for (i = 0; i < count; i++) {
+        test_generator_table();
+    }
     test_multiple_generators();
     test_switch();
 }
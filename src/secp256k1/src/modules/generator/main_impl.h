@@ -244,4 +244,110 @@ int secp256k1_generator_generate_blinded(const secp256k1_context* ctx, secp256k1
     return secp256k1_generator_generate_internal(ctx, gen, key32, blind32);
 }
 
+/* The multiples of a generator in four bit windows over the 64 bits of a value. */
+#define SECP256K1_GENERATOR_TABLE_WINDOWS 16
+#define SECP256K1_GENERATOR_TABLE_POINTS 16
+
+struct secp256k1_generator_table {
+    secp256k1_ge_storage gen;
+    /* prec[w][i] = (i * 16^w) * gen + offset_w. The offsets are G in every window but the last,
+     * which holds -(WINDOWS - 1) * G; they cancel out in the sum over the windows, and keep
+     * the entries for i = 0 from being the point at infinity. */
+    secp256k1_ge_storage prec[SECP256K1_GENERATOR_TABLE_WINDOWS][SECP256K1_GENERATOR_TABLE_POINTS];
+};
+
+secp256k1_generator_table* secp256k1_generator_table_create(const secp256k1_context* ctx, const secp256k1_generator* gen) {
+    secp256k1_generator_table *ret;
+    secp256k1_gej *precj;
+    secp256k1_ge *prec;
+    secp256k1_gej basej;
+    secp256k1_gej offsetj;
+    secp256k1_gej last_offsetj;
+    secp256k1_ge genp;
+    int w, i;
+
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(gen != NULL);
+
+    ret = (secp256k1_generator_table *)checked_malloc(&ctx->error_callback, sizeof(*ret));
+    if (ret == NULL) {
+        return NULL;
+    }
+    precj = (secp256k1_gej *)checked_malloc(&ctx->error_callback, SECP256K1_GENERATOR_TABLE_WINDOWS * SECP256K1_GENERATOR_TABLE_POINTS * sizeof(*precj));
+    prec = (secp256k1_ge *)checked_malloc(&ctx->error_callback, SECP256K1_GENERATOR_TABLE_WINDOWS * SECP256K1_GENERATOR_TABLE_POINTS * sizeof(*prec));
+    if (precj == NULL || prec == NULL) {
+        free(precj);
+        free(prec);
+        free(ret);
+        return NULL;
+    }
+
+    secp256k1_generator_load(&genp, gen);
+    secp256k1_ge_to_storage(&ret->gen, &genp);
+    secp256k1_gej_set_ge(&basej, &genp);
+    secp256k1_gej_set_ge(&offsetj, &secp256k1_ge_const_g);
+    secp256k1_gej_set_infinity(&last_offsetj);
+    for (w = 0; w < SECP256K1_GENERATOR_TABLE_WINDOWS - 1; w++) {
+        secp256k1_gej_add_ge_var(&last_offsetj, &last_offsetj, &secp256k1_ge_const_g, NULL);
+    }
+    secp256k1_gej_neg(&last_offsetj, &last_offsetj);
+
+    /* The table only depends on the public generator, so it is built in variable time. */
+    for (w = 0; w < SECP256K1_GENERATOR_TABLE_WINDOWS; w++) {
+        secp256k1_gej *row = &precj[w * SECP256K1_GENERATOR_TABLE_POINTS];
+        row[0] = w == SECP256K1_GENERATOR_TABLE_WINDOWS - 1 ? last_offsetj : offsetj;
+        for (i = 1; i < SECP256K1_GENERATOR_TABLE_POINTS; i++) {
+            secp256k1_gej_add_var(&row[i], &row[i - 1], &basej, NULL);
+        }
+        for (i = 0; i < 4; i++) {
+            secp256k1_gej_double_var(&basej, &basej, NULL);
+        }
+    }
+    secp256k1_ge_set_all_gej_var(prec, precj, SECP256K1_GENERATOR_TABLE_WINDOWS * SECP256K1_GENERATOR_TABLE_POINTS, &ctx->error_callback);
+    for (w = 0; w < SECP256K1_GENERATOR_TABLE_WINDOWS; w++) {
+        for (i = 0; i < SECP256K1_GENERATOR_TABLE_POINTS; i++) {
+            VERIFY_CHECK(!secp256k1_ge_is_infinity(&prec[w * SECP256K1_GENERATOR_TABLE_POINTS + i]));
+            secp256k1_ge_to_storage(&ret->prec[w][i], &prec[w * SECP256K1_GENERATOR_TABLE_POINTS + i]);
+        }
+    }
+
+    free(precj);
+    free(prec);
+    return ret;
+}
+
+void secp256k1_generator_table_destroy(const secp256k1_context* ctx, secp256k1_generator_table* table) {
+    (void) ctx;
+    free(table);
+}
+
+void secp256k1_generator_table_generator(const secp256k1_context* ctx, secp256k1_generator* gen, const secp256k1_generator_table* table) {
+    secp256k1_ge genp;
+    (void) ctx;
+    secp256k1_ge_from_storage(&genp, &table->gen);
+    secp256k1_generator_save(gen, &genp);
+}
+
+int secp256k1_generator_table_blind(const secp256k1_context* ctx, secp256k1_generator* gen, const secp256k1_generator_table* table, const unsigned char *blind32) {
+    secp256k1_scalar blind;
+    secp256k1_gej accum;
+    secp256k1_ge add;
+    int overflow;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(gen != NULL);
+    ARG_CHECK(table != NULL);
+    ARG_CHECK(blind32 != NULL);
+    ARG_CHECK(secp256k1_ecmult_gen_context_is_built(&ctx->ecmult_gen_ctx));
+
+    secp256k1_scalar_set_b32(&blind, blind32, &overflow);
+    CHECK(!overflow);
+    secp256k1_ecmult_gen(&ctx->ecmult_gen_ctx, &accum, &blind);
+    secp256k1_ge_from_storage(&add, &table->gen);
+    secp256k1_gej_add_ge(&accum, &accum, &add);
+    secp256k1_ge_set_gej(&add, &accum);
+    secp256k1_generator_save(gen, &add);
+    secp256k1_scalar_clear(&blind);
+    return !overflow;
+}
+
 #endif
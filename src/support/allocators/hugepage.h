@@ -0,0 +1,40 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_SUPPORT_ALLOCATORS_HUGEPAGE_H
+#define LAVA_SUPPORT_ALLOCATORS_HUGEPAGE_H
+
+#include <support/hugepages.h>
+
+#include <cstddef>
+
+/**
+ * Allocator for the few large arrays a node keeps for its whole life, backed by huge pages
+ * when -hugepages asks for them, so walking them randomly costs fewer TLB misses.
+ */
+template <typename T>
+struct LargePageAllocator {
+    typedef T value_type;
+
+    LargePageAllocator() noexcept {}
+    template <typename U>
+    LargePageAllocator(const LargePageAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(AllocateLarge(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        FreeLarge(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const LargePageAllocator<T>&, const LargePageAllocator<U>&) noexcept { return true; }
+template <typename T, typename U>
+bool operator!=(const LargePageAllocator<T>&, const LargePageAllocator<U>&) noexcept { return false; }
+
+#endif // LAVA_SUPPORT_ALLOCATORS_HUGEPAGE_H
@@ -0,0 +1,190 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_SUPPORT_ALLOCATORS_POOL_H
+#define LAVA_SUPPORT_ALLOCATORS_POOL_H
+
+#include <support/hugepages.h>
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A memory resource for the many small, equally sized blocks of a node based container.
+ *
+ * Blocks of up to MAX_BLOCK_SIZE bytes are carved out of large chunks. A freed block goes
+ * on a free list for its size and is handed out again by the next allocation of that size;
+ * the chunks themselves are only given back to the heap when the resource is destroyed,
+ * all at once. Larger blocks, like the bucket array of a hash map, are allocated on their
+ * own. Chunks and large blocks come from AllocateLarge, so from huge pages under -hugepages.
+ *
+ * Not thread safe: a resource is used by the containers of one thread at a time.
+ */
+template <std::size_t MAX_BLOCK_SIZE, std::size_t ALIGN>
+class PoolResource
+{
+    static_assert(ALIGN > 0 && (ALIGN & (ALIGN - 1)) == 0, "ALIGN must be a power of two");
+    static_assert(ALIGN <= alignof(std::max_align_t), "chunks are only aligned for max_align_t");
+
+    //! A free block holds the link to the next free block of its size
+    struct ListNode {
+        ListNode* next;
+    };
+
+    //! The granularity of the blocks, large enough to hold a ListNode
+    static constexpr std::size_t ELEM_ALIGN = ALIGN >= sizeof(ListNode) ? ALIGN : sizeof(ListNode);
+
+    static std::size_t NumElems(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN - 1) / ELEM_ALIGN + (bytes == 0);
+    }
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<ListNode*> m_free_lists;
+    std::vector<char*> m_chunks;
+    char* m_available_begin = nullptr;
+    char* m_available_end = nullptr;
+
+    void PushFree(void* p, std::size_t num_elems)
+    {
+        ListNode* node = new (p) ListNode;
+        node->next = m_free_lists[num_elems];
+        m_free_lists[num_elems] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Whatever is left of the current chunk is still good for a block of its own size.
+        const std::size_t remaining = m_available_end - m_available_begin;
+        if (remaining > 0) {
+            PushFree(m_available_begin, remaining / ELEM_ALIGN);
+        }
+        m_chunks.push_back(static_cast<char*>(AllocateLarge(m_chunk_size_bytes)));
+        m_available_begin = m_chunks.back();
+        m_available_end = m_available_begin + m_chunk_size_bytes;
+    }
+
+public:
+    //! Chunks span a huge page when huge pages are in use.
+    static std::size_t DefaultChunkSize()
+    {
+        return GetHugePageMode() == HugePageMode::NONE ? 256 * 1024 : HUGE_PAGE_SIZE;
+    }
+
+    explicit PoolResource(std::size_t chunk_size_bytes = DefaultChunkSize())
+        : m_chunk_size_bytes(chunk_size_bytes / ELEM_ALIGN * ELEM_ALIGN), m_free_lists(MAX_BLOCK_SIZE / ELEM_ALIGN + 2)
+    {
+        static_assert(MAX_BLOCK_SIZE >= ELEM_ALIGN, "MAX_BLOCK_SIZE is smaller than a block");
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE + ELEM_ALIGN);
+    }
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_chunks) {
+            FreeLarge(chunk, m_chunk_size_bytes);
+        }
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (bytes > MAX_BLOCK_SIZE || alignment > ELEM_ALIGN) {
+            return AllocateLarge(bytes);
+        }
+        const std::size_t num_elems = NumElems(bytes);
+        ListNode* node = m_free_lists[num_elems];
+        if (node) {
+            m_free_lists[num_elems] = node->next;
+            return node;
+        }
+        const std::size_t round_bytes = num_elems * ELEM_ALIGN;
+        if (static_cast<std::size_t>(m_available_end - m_available_begin) < round_bytes) {
+            AllocateChunk();
+        }
+        void* p = m_available_begin;
+        m_available_begin += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (bytes > MAX_BLOCK_SIZE || alignment > ELEM_ALIGN) {
+            FreeLarge(p, bytes);
+            return;
+        }
+        PushFree(p, NumElems(bytes));
+    }
+
+    //! The number of chunks taken from the heap so far.
+    std::size_t NumAllocatedChunks() const { return m_chunks.size(); }
+
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+/**
+ * An allocator drawing from a shared PoolResource. A default constructed allocator makes a
+ * resource of its own, so a container gets a pool without further ado; a container moved
+ * from one still refers to that resource through its allocator, and the resource lives on
+ * for as long as one of them does.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE, std::size_t ALIGN = alignof(T)>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE, ALIGN> ResourceType;
+
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE, ALIGN> other;
+    };
+
+    PoolAllocator() : m_resource(std::make_shared<ResourceType>()) {}
+
+    explicit PoolAllocator(std::shared_ptr<ResourceType> resource) noexcept : m_resource(std::move(resource)) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE, ALIGN>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    const std::shared_ptr<ResourceType>& resource() const noexcept { return m_resource; }
+
+private:
+    std::shared_ptr<ResourceType> m_resource;
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE, std::size_t ALIGN>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE, ALIGN>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE, ALIGN>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE, std::size_t ALIGN>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE, ALIGN>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE, ALIGN>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // LAVA_SUPPORT_ALLOCATORS_POOL_H
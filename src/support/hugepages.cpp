@@ -0,0 +1,105 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <support/hugepages.h>
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+static std::atomic<HugePageMode> g_huge_page_mode{HugePageMode::NONE};
+
+bool ParseHugePageMode(const std::string& str, HugePageMode& mode)
+{
+    if (str == "none" || str == "0") {
+        mode = HugePageMode::NONE;
+    } else if (str == "transparent" || str == "" || str == "1") {
+        mode = HugePageMode::TRANSPARENT;
+    } else if (str == "explicit") {
+        mode = HugePageMode::EXPLICIT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool SetHugePageMode(HugePageMode mode)
+{
+#ifdef __linux__
+    g_huge_page_mode = mode;
+    return true;
+#else
+    return mode == HugePageMode::NONE;
+#endif
+}
+
+HugePageMode GetHugePageMode()
+{
+    return g_huge_page_mode;
+}
+
+static bool IsMapped(std::size_t bytes)
+{
+    return bytes >= HUGE_PAGE_SIZE && g_huge_page_mode != HugePageMode::NONE;
+}
+
+static std::size_t MappedSize(std::size_t bytes)
+{
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+void* AllocateLarge(std::size_t bytes)
+{
+    if (!IsMapped(bytes)) {
+        return ::operator new(bytes);
+    }
+#ifdef __linux__
+    const std::size_t len = MappedSize(bytes);
+#ifdef MAP_HUGETLB
+    if (g_huge_page_mode == HugePageMode::EXPLICIT) {
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            return p;
+        }
+    }
+#endif
+    // Over-allocate by a huge page and trim both ends, so the mapping is aligned for the
+    // kernel to back it with huge pages; it is unmapped with the same length either way.
+    char* base = static_cast<char*>(mmap(nullptr, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (base == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (p > base) {
+        munmap(base, p - base);
+    }
+    if (base + HUGE_PAGE_SIZE > p) {
+        munmap(p + len, base + HUGE_PAGE_SIZE - p);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+    return p;
+#else
+    return ::operator new(bytes);
+#endif
+}
+
+void FreeLarge(void* p, std::size_t bytes) noexcept
+{
+    if (!p) {
+        return;
+    }
+#ifdef __linux__
+    if (IsMapped(bytes)) {
+        munmap(p, MappedSize(bytes));
+        return;
+    }
+#endif
+    ::operator delete(p);
+}
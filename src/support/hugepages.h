@@ -0,0 +1,42 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_SUPPORT_HUGEPAGES_H
+#define LAVA_SUPPORT_HUGEPAGES_H
+
+#include <cstddef>
+#include <string>
+
+/** How large, long lived arrays (the coins cache, the signature caches, the plot scratch) are backed. */
+enum class HugePageMode {
+    NONE,           //!< plain heap memory
+    TRANSPARENT,    //!< 2 MiB aligned mappings the kernel is advised to back with transparent huge pages
+    EXPLICIT,       //!< pages from the reserved hugetlbfs pool, transparent ones when it is exhausted
+};
+
+/** The size of a huge page, and the smallest allocation backed by huge pages. */
+static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/** Parse the value of -hugepages. */
+bool ParseHugePageMode(const std::string& str, HugePageMode& mode);
+
+/**
+ * Select the backing of AllocateLarge. Must be called at startup, before the first
+ * allocation, as a block is given back the way the current mode says it was allocated.
+ * Returns false, and leaves the mode at NONE, where huge pages are not supported.
+ */
+bool SetHugePageMode(HugePageMode mode);
+HugePageMode GetHugePageMode();
+
+/**
+ * Allocate bytes of memory, from huge pages if the mode asks for it and the block is at
+ * least HUGE_PAGE_SIZE, from the heap otherwise. The pages of a mapping are only placed
+ * when first written to, on the NUMA node of the thread doing so. Throws std::bad_alloc.
+ */
+void* AllocateLarge(std::size_t bytes);
+
+/** Free a block of AllocateLarge, given the same number of bytes. */
+void FreeLarge(void* p, std::size_t bytes) noexcept;
+
+#endif // LAVA_SUPPORT_HUGEPAGES_H
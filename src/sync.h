@@ -8,7 +8,9 @@
 
 #include <threadsafety.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <stdint.h>
 #include <thread>
 #include <mutex>
 
@@ -114,14 +116,36 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Default for -lockprofile */
+static const bool DEFAULT_LOCK_PROFILE = false;
+
+/** Whether LOCK records wait and hold times per acquisition site (-lockprofile), see metrics.h. */
+extern std::atomic<bool> g_lock_profile;
+
+struct LockProfileSite;
+int64_t LockProfileClock();
+/**
+ * Record an acquisition at pszFile:nLine that waited since nWaitStart, or 0 if it did not wait.
+ * Returns the site if the hold time of this acquisition is sampled, starting at nHoldStart.
+ */
+LockProfileSite* LockProfileAcquired(const char* pszName, const char* pszFile, int nLine, int64_t nWaitStart, int64_t& nHoldStart);
+void LockProfileReleased(LockProfileSite* site, int64_t nHoldStart);
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    LockProfileSite* m_profile_site = nullptr;
+    int64_t m_profile_start = 0;
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        if (g_lock_profile.load(std::memory_order_relaxed)) {
+            ProfiledEnter(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -132,6 +156,19 @@ private:
 #endif
     }
 
+    void ProfiledEnter(const char* pszName, const char* pszFile, int nLine)
+    {
+        int64_t nWaitStart = 0;
+        if (!Base::try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
+            PrintLockContention(pszName, pszFile, nLine);
+#endif
+            nWaitStart = LockProfileClock();
+            Base::lock();
+        }
+        m_profile_site = LockProfileAcquired(pszName, pszFile, nLine, nWaitStart, m_profile_start);
+    }
+
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()), true);
@@ -163,6 +200,8 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
+        if (m_profile_site)
+            LockProfileReleased(m_profile_site, m_profile_start);
         if (Base::owns_lock())
             LeaveCritical();
     }
@@ -8,6 +8,7 @@
 #include <coins.h>
 #include <uint256.h>
 #include <secp256k1.h>
+#include <secp256k1_bulletproofs.h>
 
 #include <blind.h>
 #include <confidential_validation.h>
@@ -67,8 +68,8 @@ BOOST_AUTO_TEST_CASE(naive_blinding_test_from_elements)
 
         // Malleate the output and check for correct handling of bad commitments
         // These will fail IsValid checks
-        std::vector<unsigned char> asset_copy(tx3.vout[0].nAsset.vchCommitment);
-        std::vector<unsigned char> value_copy(tx3.vout[0].nValueCA.vchCommitment);
+        CCommitmentData asset_copy(tx3.vout[0].nAsset.vchCommitment);
+        CCommitmentData value_copy(tx3.vout[0].nValueCA.vchCommitment);
         tx3.vout[0].nAsset.vchCommitment[0] = 122;
         BOOST_CHECK(!VerifyAmounts(inputs, CTransaction(tx3), nullptr, false));
         tx3.vout[0].nAsset.vchCommitment = asset_copy;
@@ -359,4 +360,105 @@ BOOST_AUTO_TEST_CASE(naive_blinding_test_from_elements)
     }
 }
 
+BOOST_AUTO_TEST_CASE(parallel_blinding_test)
+{
+    // Blind more outputs than there are cores, so that the proofs are shared out between the threads.
+    const size_t nOutputs = 32;
+    CAsset bitcoinID(GetRandHash());
+    std::vector<CKey> vDummy;
+
+    std::vector<CTxOut> inputs;
+    inputs.push_back(CTxOut(bitcoinID, 1000, CScript()));
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = ArithToUint256(1);
+    tx.vin[0].prevout.n = 0;
+
+    std::vector<uint256> input_blinds(1), input_asset_blinds(1);
+    std::vector<CAsset> input_assets(1, bitcoinID);
+    std::vector<CAmount> input_amounts(1, 1000);
+    std::vector<uint256> output_blinds, output_asset_blinds;
+    std::vector<CPubKey> output_pubkeys;
+    for (size_t i = 0; i < nOutputs; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        tx.vout.push_back(CTxOut(bitcoinID, 10 + i, CScript() << OP_TRUE));
+        output_pubkeys.push_back(key.GetPubKey());
+    }
+    // Fee output
+    tx.vout.push_back(CTxOut(bitcoinID, 1000 - 10 * nOutputs - nOutputs * (nOutputs - 1) / 2, CScript()));
+    output_pubkeys.push_back(CPubKey());
+    BOOST_CHECK(VerifyAmounts(inputs, CTransaction(tx), nullptr, false));
+
+    BOOST_CHECK(BlindTransaction(input_blinds, input_asset_blinds, input_assets, input_amounts, output_blinds, output_asset_blinds, output_pubkeys, vDummy, vDummy, tx) == (int)nOutputs);
+    for (size_t i = 0; i < nOutputs; i++) {
+        BOOST_CHECK(!tx.vout[i].nValueCA.IsExplicit());
+        BOOST_CHECK(!tx.vout[i].vchRangeproof.empty());
+        BOOST_CHECK(!tx.vout[i].vchSurjectionproof.empty());
+    }
+    BOOST_CHECK(VerifyAmounts(inputs, CTransaction(tx), nullptr, false));
+}
+
+/* Prove value with min_value on an output of asset and script, and check the proof in the batch */
+static void AddBulletproof(CBulletproofCheck& check, std::vector<std::vector<unsigned char>>& proofs, const secp256k1_context* ctx, const secp256k1_bulletproof_generators* gens, const secp256k1_generator& gen, const uint64_t value, const uint64_t min_value, const CScript& script)
+{
+    unsigned char blind[32];
+    GetRandBytes(blind, sizeof(blind));
+    secp256k1_pedersen_commitment commit;
+    BOOST_CHECK(secp256k1_pedersen_commit(ctx, &commit, blind, value, &gen, &secp256k1_generator_const_g));
+    CCommitmentData vchCommitment;
+    vchCommitment.resize(CConfidentialValue::nCommittedSize);
+    secp256k1_pedersen_commitment_serialize(ctx, vchCommitment.data(), &commit);
+
+    std::vector<unsigned char> proof(SECP256K1_BULLETPROOF_MAX_PROOF);
+    size_t plen = proof.size();
+    const unsigned char* blind_ptr = blind;
+    unsigned char nonce[32];
+    GetRandBytes(nonce, sizeof(nonce));
+    secp256k1_scratch_space* scratch = secp256k1_scratch_space_create(ctx, 1 << 20);
+    BOOST_CHECK(secp256k1_bulletproof_rangeproof_prove(ctx, scratch, gens, proof.data(), &plen, NULL, NULL, NULL, &value, &min_value, &blind_ptr, NULL, 1, &gen, 64, nonce, NULL, script.data(), script.size(), NULL));
+    secp256k1_scratch_space_destroy(scratch);
+    proof.resize(plen);
+    BOOST_CHECK(IsBulletproof(proof));
+
+    // The check references the proofs, keep them in place.
+    proofs.push_back(proof);
+    check.Add(proofs.back(), vchCommitment, gen, script);
+}
+
+BOOST_AUTO_TEST_CASE(bulletproof_batch_check)
+{
+    secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    secp256k1_bulletproof_generators* gens = secp256k1_bulletproof_generators_create(ctx, &secp256k1_generator_const_g, 2 * 64);
+    secp256k1_generator gen1, gen2;
+    CAsset asset1(GetRandHash()), asset2(GetRandHash());
+    BOOST_CHECK(secp256k1_generator_generate(ctx, &gen1, asset1.begin()));
+    BOOST_CHECK(secp256k1_generator_generate(ctx, &gen2, asset2.begin()));
+    CScript op_true(OP_TRUE);
+    CScript op_return(OP_RETURN);
+
+    std::vector<std::vector<unsigned char>> proofs;
+    proofs.reserve(4);
+    {
+        // Proofs of different assets are verified together
+        CBulletproofCheck check(false);
+        AddBulletproof(check, proofs, ctx, gens, gen1, 100, 1, op_true);
+        AddBulletproof(check, proofs, ctx, gens, gen2, 5000, 1, op_true);
+        AddBulletproof(check, proofs, ctx, gens, gen1, 0, 0, op_return);
+        BOOST_CHECK(check());
+        // A proof whose byte was flipped fails the batch
+        proofs[1][100] ^= 1;
+        BOOST_CHECK(!check());
+    }
+    {
+        // A spendable output has to prove a value of at least 1
+        CBulletproofCheck check(false);
+        AddBulletproof(check, proofs, ctx, gens, gen1, 100, 0, op_true);
+        BOOST_CHECK(!check());
+    }
+
+    secp256k1_bulletproof_generators_destroy(ctx, gens);
+    secp256k1_context_destroy(ctx);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
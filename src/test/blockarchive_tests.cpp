@@ -0,0 +1,114 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockarchive.h>
+#include <crypto/common.h>
+#include <random.h>
+#include <test/test_bitcoin.h>
+
+#include <stdio.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockarchive_tests, BasicTestingSetup)
+
+static std::vector<uint8_t> ReadFile(const fs::path& path)
+{
+    std::vector<uint8_t> data;
+    FILE* file = fsbridge::fopen(path, "rb");
+    if (!file)
+        return data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(file);
+    return data;
+}
+
+static void WriteFile(const fs::path& path, const std::vector<uint8_t>& data)
+{
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+}
+
+BOOST_AUTO_TEST_CASE(blockarchive_roundtrip)
+{
+    if (!CanArchiveBlockFiles())
+        return;
+    const fs::path dir = SetDataDir("blockarchive");
+
+    // Records of repetitive data, then space allocated ahead and left unused.
+    std::vector<uint8_t> raw;
+    std::vector<uint64_t> records;
+    for (int i = 0; i < 20; i++) {
+        const uint32_t nSize = 1000 + InsecureRandRange(20000);
+        records.push_back(raw.size());
+        raw.resize(raw.size() + 8 + nSize);
+        uint8_t* record = raw.data() + records.back();
+        WriteLE32(record, 0xdab5bffa);
+        WriteLE32(record + 4, nSize);
+        for (uint32_t j = 0; j < nSize; j++) {
+            record[8 + j] = (j % 64 == 0) ? InsecureRandBits(8) : i;
+        }
+    }
+    raw.resize(raw.size() + 3 * 1000 * 1000);
+    WriteFile(dir / "blk00000.dat", raw);
+
+    BOOST_REQUIRE(ArchiveBlockFile(dir / "blk00000.dat", dir / "blk00000.zst"));
+    BOOST_CHECK(fs::file_size(dir / "blk00000.zst") < raw.size() / 4);
+    BOOST_CHECK(!fs::exists(dir / "blk00000.zst.new"));
+
+    // Every record is read from a frame of its own.
+    const CArchivedBlockFile archive(dir / "blk00000.zst");
+    BOOST_REQUIRE(!archive.IsNull());
+    BOOST_CHECK_EQUAL(archive.RawSize(), raw.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        const uint64_t nEnd = i + 1 < records.size() ? records[i + 1] : records.back() + 8 + ReadLE32(raw.data() + records.back() + 4);
+        std::vector<uint8_t> frame;
+        uint64_t nStart;
+        BOOST_REQUIRE(archive.ReadFrame(records[i], frame, nStart));
+        BOOST_CHECK_EQUAL(nStart, records[i]);
+        BOOST_CHECK(frame == std::vector<uint8_t>(raw.begin() + records[i], raw.begin() + nEnd));
+        // Any offset within the record finds the same frame.
+        BOOST_REQUIRE(archive.ReadFrame(records[i] + 9, frame, nStart));
+        BOOST_CHECK_EQUAL(nStart, records[i]);
+    }
+    std::vector<uint8_t> frame;
+    uint64_t nStart;
+    BOOST_CHECK(!archive.ReadFrame(raw.size(), frame, nStart));
+
+    // The original file is restored byte for byte.
+    BOOST_REQUIRE(RestoreBlockFile(dir / "blk00000.zst", dir / "blk00001.dat"));
+    BOOST_CHECK(ReadFile(dir / "blk00001.dat") == raw);
+}
+
+BOOST_AUTO_TEST_CASE(blockarchive_malformed)
+{
+    if (!CanArchiveBlockFiles())
+        return;
+    const fs::path dir = SetDataDir("blockarchive_malformed");
+
+    std::vector<uint8_t> raw(100000);
+    for (size_t i = 0; i < raw.size(); i++) {
+        raw[i] = i / 1000;
+    }
+    WriteFile(dir / "blk00000.dat", raw);
+    BOOST_REQUIRE(ArchiveBlockFile(dir / "blk00000.dat", dir / "blk00000.zst"));
+    std::vector<uint8_t> archived = ReadFile(dir / "blk00000.zst");
+
+    // A truncated archive, or one with a broken seek table, is not opened.
+    WriteFile(dir / "truncated.zst", std::vector<uint8_t>(archived.begin(), archived.end() - 1));
+    BOOST_CHECK(CArchivedBlockFile(dir / "truncated.zst").IsNull());
+    archived[archived.size() - 9] ^= 1;
+    WriteFile(dir / "table.zst", archived);
+    BOOST_CHECK(CArchivedBlockFile(dir / "table.zst").IsNull());
+    BOOST_CHECK(CArchivedBlockFile(dir / "missing.zst").IsNull());
+    BOOST_CHECK(!RestoreBlockFile(dir / "missing.zst", dir / "blk00001.dat"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,63 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilewriter.h>
+#include <test/test_bitcoin.h>
+
+#include <stdio.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilewriter_tests, BasicTestingSetup)
+
+static std::vector<uint8_t> ReadFile(const fs::path& path)
+{
+    std::vector<uint8_t> data;
+    FILE* file = fsbridge::fopen(path, "rb");
+    if (!file)
+        return data;
+    uint8_t buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(file);
+    return data;
+}
+
+BOOST_AUTO_TEST_CASE(blockfilewriter_coalesce)
+{
+    const fs::path path = SetDataDir("blockfilewriter") / "blk00000.dat";
+    CBlockFileWriter writer(1000);
+
+    // Records below the limit stay in memory, readable by their position.
+    BOOST_CHECK(writer.Append(0, path, 0, std::vector<uint8_t>(100, 1), false));
+    BOOST_CHECK(writer.Append(0, path, 100, std::vector<uint8_t>(200, 2), false));
+    BOOST_CHECK(!fs::exists(path));
+    std::vector<uint8_t> record;
+    BOOST_CHECK(writer.ReadPending(0, 100, record));
+    BOOST_CHECK(record == std::vector<uint8_t>(200, 2));
+    BOOST_CHECK(!writer.ReadPending(0, 50, record));
+    BOOST_CHECK(!writer.ReadPending(1, 0, record));
+
+    // Passing the limit writes them all at once.
+    BOOST_CHECK(writer.Append(0, path, 300, std::vector<uint8_t>(800, 3), false));
+    BOOST_CHECK(!writer.ReadPending(0, 0, record));
+    std::vector<uint8_t> expected(100, 1);
+    expected.insert(expected.end(), 200, 2);
+    expected.insert(expected.end(), 800, 3);
+    BOOST_CHECK(ReadFile(path) == expected);
+
+    // A record out of sequence writes the pending ones first.
+    BOOST_CHECK(writer.Append(0, path, 1100, std::vector<uint8_t>(10, 4), false));
+    BOOST_CHECK(writer.Append(0, path, 0, std::vector<uint8_t>(10, 5), false));
+    expected.insert(expected.end(), 10, 4);
+    BOOST_CHECK(ReadFile(path) == expected);
+    BOOST_CHECK(writer.Flush(0));
+    std::fill(expected.begin(), expected.begin() + 10, 5);
+    BOOST_CHECK(ReadFile(path) == expected);
+    BOOST_CHECK(writer.Flush());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -39,6 +39,33 @@ BOOST_AUTO_TEST_CASE(gcsfilter_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(gcsfilter_decode_test)
+{
+    // Elements of mixed sizes, as scripts are, hashed in groups of the same size.
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < 200; ++i) {
+        GCSFilter::Element element(20 + i % 15);
+        element[0] = i;
+        elements.insert(std::move(element));
+    }
+
+    // Large and zero remainders, so the quotients and remainders cross the reader's buffer.
+    for (uint8_t P : {0, 1, 19, 40}) {
+        GCSFilter filter({1, 2, P, 1}, elements);
+        GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+        BOOST_CHECK_EQUAL(decoded.GetN(), elements.size());
+        for (const auto& element : elements) {
+            BOOST_CHECK(decoded.Match(element));
+        }
+
+        std::vector<unsigned char> encoded = filter.GetEncoded();
+        encoded.push_back(0);
+        BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+        encoded.resize(encoded.size() - 2);
+        BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), encoded), std::ios_base::failure);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
 {
     GCSFilter filter;
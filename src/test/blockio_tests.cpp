@@ -0,0 +1,44 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockio.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockio_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockio_submit)
+{
+    CBlockIOQueue queue(3);
+
+    std::vector<std::function<int()>> reads;
+    for (int i = 0; i < 100; i++) {
+        reads.emplace_back([i] { return i * i; });
+    }
+    std::vector<std::future<int>> futures = queue.Submit(std::move(reads));
+    BOOST_CHECK_EQUAL(futures.size(), 100U);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(futures[i].get(), i * i);
+    }
+
+    // An exception thrown by a read is passed on to its future.
+    std::vector<std::function<int()>> failing{[]() -> int { throw std::runtime_error("read failed"); }};
+    std::future<int> failed = std::move(queue.Submit(std::move(failing))[0]);
+    BOOST_CHECK_THROW(failed.get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(blockio_drop)
+{
+    std::vector<std::future<int>> futures;
+    {
+        CBlockIOQueue queue(0);
+        std::vector<std::function<int()>> reads{[] { return 1; }};
+        futures = queue.Submit(std::move(reads));
+    }
+    // Without threads the read stays queued, and is dropped with the queue.
+    BOOST_CHECK_THROW(futures[0].get(), std::future_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
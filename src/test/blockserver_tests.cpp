@@ -0,0 +1,80 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockserver.h>
+#include <test/test_bitcoin.h>
+
+#include <atomic>
+#include <future>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockserver_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockserver_order)
+{
+    std::atomic<int> nDone{0};
+    CBlockServer server(4, [&nDone] { nDone++; });
+
+    // The jobs of one peer run one after the other, in order, whatever the number of threads.
+    std::vector<int> served[3];
+    for (int i = 0; i < 50; i++) {
+        for (NodeId id = 0; id < 3; id++) {
+            server.Submit(id, [&served, id, i] { served[id].push_back(i); });
+        }
+    }
+    while (nDone < 150) {
+        MilliSleep(1);
+    }
+    for (NodeId id = 0; id < 3; id++) {
+        BOOST_CHECK(!server.IsBusy(id));
+        BOOST_REQUIRE_EQUAL(served[id].size(), 50U);
+        for (int i = 0; i < 50; i++) {
+            BOOST_CHECK_EQUAL(served[id][i], i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockserver_turns)
+{
+    std::vector<NodeId> order;
+    std::promise<void> release;
+    std::shared_future<void> released(release.get_future());
+    {
+        CBlockServer server(1, nullptr);
+        // The thread is held by the first job of peer 0 while the others are queued.
+        server.Submit(0, [released] { released.wait(); });
+        for (int i = 0; i < 3; i++) {
+            server.Submit(0, [&order] { order.push_back(0); });
+        }
+        server.Submit(1, [&order] { order.push_back(1); });
+        server.Submit(2, [&order] { order.push_back(2); });
+        BOOST_CHECK(server.IsBusy(0));
+        BOOST_CHECK(server.IsBusy(1));
+        BOOST_CHECK(!server.IsBusy(3));
+        release.set_value();
+        while (server.IsBusy(0) || server.IsBusy(1) || server.IsBusy(2)) {
+            MilliSleep(1);
+        }
+    }
+    // A peer with many jobs does not keep the others waiting for all of them.
+    const std::vector<NodeId> expected{1, 2, 0, 0, 0};
+    BOOST_CHECK(order == expected);
+}
+
+BOOST_AUTO_TEST_CASE(blockserver_stop)
+{
+    std::atomic<int> nRun{0};
+    CBlockServer server(0, nullptr);
+    server.Submit(0, [&nRun] { nRun++; });
+    BOOST_CHECK(server.IsBusy(0));
+    // Without threads the job stays queued, and is dropped when the server stops.
+    server.Stop();
+    BOOST_CHECK(!server.IsBusy(0));
+    server.Submit(0, [&nRun] { nRun++; });
+    BOOST_CHECK(!server.IsBusy(0));
+    BOOST_CHECK_EQUAL(nRun, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -73,6 +73,22 @@ struct UniqueCheck {
     void swap(UniqueCheck& x) { std::swap(x.check_id, check_id); };
 };
 
+struct CostedCheck {
+    static std::mutex m;
+    static std::unordered_multiset<size_t> results;
+    size_t check_id;
+    unsigned int cost;
+    CostedCheck(size_t check_id_in, unsigned int cost_in) : check_id(check_id_in), cost(cost_in){};
+    CostedCheck() : check_id(0), cost(0){};
+    bool operator()()
+    {
+        std::lock_guard<std::mutex> l(m);
+        results.insert(check_id);
+        return true;
+    }
+    unsigned int GetCost() const { return cost; }
+    void swap(CostedCheck& x) { std::swap(x.check_id, check_id); std::swap(x.cost, cost); };
+};
 
 struct MemoryCheck {
     static std::atomic<size_t> fake_allocated_memory;
@@ -131,6 +147,8 @@ std::atomic<uint64_t> FrozenCleanupCheck::nFrozen{0};
 std::condition_variable FrozenCleanupCheck::cv{};
 std::mutex UniqueCheck::m;
 std::unordered_multiset<size_t> UniqueCheck::results;
+std::mutex CostedCheck::m;
+std::unordered_multiset<size_t> CostedCheck::results;
 std::atomic<size_t> FakeCheckCheckCompletion::n_calls{0};
 std::atomic<size_t> MemoryCheck::fake_allocated_memory{0};
 
@@ -139,6 +157,7 @@ typedef CCheckQueue<FakeCheckCheckCompletion> Correct_Queue;
 typedef CCheckQueue<FakeCheck> Standard_Queue;
 typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
+typedef CCheckQueue<CostedCheck> Costed_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
 
@@ -302,6 +321,37 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
     tg.join_all();
 }
 
+// Test that checks reporting their cost, including a zero one, are all called
+// exactly once, however the workers split them.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_CostedCheck)
+{
+    auto queue = MakeUnique<Costed_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    size_t COUNT = 100000;
+    size_t total = COUNT;
+    {
+        CCheckQueueControl<CostedCheck> control(queue.get());
+        while (total) {
+            size_t r = InsecureRandRange(10);
+            std::vector<CostedCheck> vChecks;
+            for (size_t k = 0; k < r && total; k++)
+                vChecks.emplace_back(--total, InsecureRandBool() ? 1 : InsecureRandRange(1000));
+            control.Add(vChecks);
+        }
+    }
+    bool r = true;
+    BOOST_REQUIRE_EQUAL(CostedCheck::results.size(), COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+        r = r && CostedCheck::results.count(i) == 1;
+    BOOST_REQUIRE(r);
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 
 // Test that blocks which might allocate lots of memory free their memory aggressively.
 //
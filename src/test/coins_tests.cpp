@@ -7,12 +7,18 @@
 #include <consensus/validation.h>
 #include <script/standard.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
+#include <utxostats.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -858,4 +864,284 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_confidential)
+{
+    // A confidential output keeps its commitments in the cache, inline, but not its proofs.
+    CTxOut txout(0, CScript() << OP_TRUE);
+    txout.flags = 1;
+    txout.nValueCA.vchCommitment.assign(CConfidentialValue::nCommittedSize, 0x08);
+    txout.nAsset.vchCommitment.assign(CConfidentialAsset::nCommittedSize, 0x0a);
+    txout.vchRangeproof.assign(2500, 0x42);
+    txout.vchSurjectionproof.assign(100, 0x42);
+
+    const CTxOut stripped = txout.WithoutProofs();
+    BOOST_CHECK(stripped == txout);
+    BOOST_CHECK(stripped.vchRangeproof.empty() && stripped.vchSurjectionproof.empty());
+
+    for (const Coin& coin : {Coin(txout, 1, false), Coin(CTxOut(txout), 1, false)}) {
+        BOOST_CHECK(coin.out == txout);
+        BOOST_CHECK(coin.out.vchRangeproof.empty());
+        BOOST_CHECK(coin.out.vchSurjectionproof.empty());
+        BOOST_CHECK_EQUAL(coin.DynamicMemoryUsage(), memusage::DynamicUsage(txout.scriptPubKey));
+    }
+}
+
+/** A view that counts its reads, which may come from several threads. */
+class CCoinsViewCounting : public CCoinsView
+{
+public:
+    std::map<COutPoint, Coin> map;
+    mutable std::atomic<int> reads{0};
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override
+    {
+        auto it = map.find(outpoint);
+        bool found = it != map.end();
+        if (found)
+            coin = it->second;
+        reads++;
+        return found;
+    }
+};
+
+/** Wait until pred holds, false if it did not within 5 seconds. */
+static bool WaitFor(std::function<bool()> pred)
+{
+    for (int i = 0; i < 500 && !pred(); i++) {
+        MilliSleep(10);
+    }
+    return pred();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewCounting base;
+    const COutPoint outpoint(InsecureRand256(), 0);
+    const Coin coin(CTxOut(1000, CScript() << OP_TRUE), 1, false);
+    base.map[outpoint] = coin;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.emplace_back();
+    CMutableTransaction spend;
+    spend.vin.emplace_back(outpoint);
+    spend.vout.emplace_back(1000, CScript() << OP_TRUE);
+    CMutableTransaction child;
+    child.vin.emplace_back(spend.GetHash(), 0);
+    CBlock block;
+    block.vtx = {MakeTransactionRef(coinbase), MakeTransactionRef(spend), MakeTransactionRef(child)};
+
+    CCoinsViewPrefetch prefetch(&base, 2);
+
+    // Only the coin of an earlier block is read, the output of the block itself is not.
+    prefetch.Prefetch(block);
+    BOOST_CHECK(WaitFor([&] { return base.reads == 1; }));
+    MilliSleep(50);
+    BOOST_CHECK_EQUAL(base.reads, 1);
+
+    // Served from memory, once.
+    base.map.erase(outpoint);
+    BOOST_CHECK(WaitFor([&] { return prefetch.HaveCoin(outpoint); }));
+    Coin fetched;
+    BOOST_CHECK(prefetch.GetCoin(outpoint, fetched));
+    BOOST_CHECK(fetched.out == coin.out);
+    BOOST_CHECK(!prefetch.GetCoin(outpoint, fetched));
+
+    // Dropped by a write, after which it may be stale.
+    base.map[outpoint] = coin;
+    const int reads = base.reads;
+    prefetch.Prefetch(block);
+    BOOST_CHECK(WaitFor([&] { return base.reads == reads + 1; }));
+    base.map.erase(outpoint);
+    BOOST_CHECK(WaitFor([&] { return prefetch.HaveCoin(outpoint); }));
+    CCoinsMap mapCoins;
+    BOOST_CHECK(prefetch.BatchWrite(mapCoins, InsecureRand256()));
+    BOOST_CHECK(!prefetch.HaveCoin(outpoint));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_warm)
+{
+    CCoinsViewCounting base;
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 100; i++) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        base.map[outpoints.back()] = Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false);
+    }
+    const COutPoint missing(InsecureRand256(), 0);
+
+    // Once the queue is read, the cache above is filled without reading the base again.
+    CCoinsViewPrefetch prefetch(&base, 2);
+    for (const COutPoint& outpoint : outpoints) {
+        prefetch.Prefetch(outpoint);
+    }
+    prefetch.Prefetch(missing);
+    prefetch.WaitForQueue();
+    BOOST_CHECK_EQUAL(base.reads, 101);
+    CCoinsViewCache cache(&prefetch);
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(cache.HaveCoin(outpoint));
+    }
+    BOOST_CHECK_EQUAL(base.reads, 101);
+
+    // The outpoints of the unspent coins of the cache are listed, up to the limit.
+    cache.SpendCoin(outpoints[0]);
+    std::vector<COutPoint> cached;
+    cache.GetCachedOutPoints(cached, 1000);
+    BOOST_CHECK_EQUAL(cached.size(), 99U);
+    BOOST_CHECK(std::find(cached.begin(), cached.end(), outpoints[0]) == cached.end());
+    cached.clear();
+    cache.GetCachedOutPoints(cached, 10);
+    BOOST_CHECK_EQUAL(cached.size(), 10U);
+}
+
+static uint256 UTXOStatsDigest(const CUTXOStats& stats)
+{
+    uint256 out;
+    stats.muhash.Finalize(out);
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_utxostats)
+{
+    const COutPoint prevout(InsecureRand256(), 0);
+    const Coin spent(CTxOut(5000, CScript() << OP_TRUE), 1, false);
+    CUTXOStats before;
+    before.AddCoin(prevout, spent);
+
+    // A block spending the coin to LV, an issued asset, a blinded output and an unspendable one.
+    CMutableTransaction coinbase;
+    coinbase.vin.emplace_back();
+    coinbase.vout.emplace_back(100, CScript() << OP_TRUE);
+    CMutableTransaction tx;
+    tx.vin.emplace_back(prevout);
+    tx.vout.emplace_back(3000, CScript() << OP_TRUE);
+    const CAsset asset(InsecureRand256());
+    tx.vout.emplace_back(CConfidentialAsset(asset), CConfidentialValue(700), CScript() << OP_TRUE);
+    CTxOut blinded(0, CScript() << OP_TRUE);
+    blinded.flags = 1;
+    blinded.nValueCA.vchCommitment.assign(CConfidentialValue::nCommittedSize, 0x08);
+    blinded.nAsset.vchCommitment.assign(CConfidentialAsset::nCommittedSize, 0x0a);
+    tx.vout.push_back(blinded);
+    tx.vout.emplace_back(1000, CScript() << OP_RETURN);
+    CBlock block;
+    block.vtx = {MakeTransactionRef(coinbase), MakeTransactionRef(tx)};
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    blockundo.vtxundo[0].vprevout.push_back(spent);
+
+    CUTXOStats delta;
+    delta.ConnectBlock(block, blockundo, 2);
+    delta.hashBlock = block.GetHash();
+    CUTXOStats after = before;
+    after += delta;
+
+    // The same as the statistics of the set the block leaves, in which the coins are the
+    // same once read back from the chainstate.
+    CUTXOStats expected;
+    std::vector<std::pair<COutPoint, Coin>> created{{COutPoint(coinbase.GetHash(), 0), Coin(coinbase.vout[0], 2, true)}};
+    for (uint32_t o = 0; o < 3; o++) {
+        created.emplace_back(COutPoint(tx.GetHash(), o), Coin(tx.vout[o], 2, false));
+    }
+    for (const auto& entry : created) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << entry.second;
+        Coin read;
+        ss >> read;
+        BOOST_CHECK(SerializeUTXOStatsElement(entry.first, read) == SerializeUTXOStatsElement(entry.first, entry.second));
+        expected.AddCoin(entry.first, read);
+    }
+    BOOST_CHECK(after.hashBlock == block.GetHash());
+    BOOST_CHECK(UTXOStatsDigest(after) == UTXOStatsDigest(expected));
+    BOOST_CHECK_EQUAL(after.nTransactionOutputs, 4U);
+    BOOST_CHECK_EQUAL(after.nBogoSize, expected.nBogoSize);
+    BOOST_CHECK_EQUAL(after.nTotalAmount, 3100);
+    BOOST_CHECK_EQUAL(after.assetAmounts.size(), 1U);
+    BOOST_CHECK_EQUAL(after.assetAmounts[asset], 700);
+    BOOST_CHECK_EQUAL(after.nConfidentialOutputs, 1U);
+
+    // Written and read back with the chainstate.
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << after;
+    CUTXOStats read;
+    ss >> read;
+    BOOST_CHECK(read.hashBlock == after.hashBlock);
+    BOOST_CHECK(UTXOStatsDigest(read) == UTXOStatsDigest(after));
+    BOOST_CHECK(read.assetAmounts == after.assetAmounts);
+    BOOST_CHECK_EQUAL(read.nBogoSize, after.nBogoSize);
+
+    // Disconnecting the block gives back the statistics from before it.
+    for (const auto& entry : created) {
+        after.RemoveCoin(entry.first, entry.second);
+    }
+    after.AddCoin(prevout, spent);
+    BOOST_CHECK(UTXOStatsDigest(after) == UTXOStatsDigest(before));
+    BOOST_CHECK_EQUAL(after.nTransactionOutputs, 1U);
+    BOOST_CHECK_EQUAL(after.nBogoSize, before.nBogoSize);
+    BOOST_CHECK_EQUAL(after.nTotalAmount, 5000);
+    BOOST_CHECK(after.assetAmounts.empty());
+    BOOST_CHECK_EQUAL(after.nConfidentialOutputs, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_overlay)
+{
+    CCoinsView root;
+    CCoinsViewCacheTest base(&root);
+    WriteCoinsViewEntry(base, VALUE1, DIRTY);
+    CCoinsViewOverlay overlay(&base);
+
+    // Coins read are the entries of the parent, not copies.
+    BOOST_CHECK_EQUAL(&overlay.AccessCoin(OUTPOINT), &base.AccessCoin(OUTPOINT));
+    BOOST_CHECK(overlay.HaveCoin(OUTPOINT));
+    BOOST_CHECK_EQUAL(overlay.GetCacheSize(), 0U);
+
+    // Changes stay in the overlay.
+    Coin spent;
+    BOOST_CHECK(overlay.SpendCoin(OUTPOINT, &spent));
+    BOOST_CHECK_EQUAL(spent.out.nValue, VALUE1);
+    BOOST_CHECK(!overlay.HaveCoin(OUTPOINT));
+    BOOST_CHECK(overlay.AccessCoin(OUTPOINT).IsSpent());
+    BOOST_CHECK(base.HaveCoin(OUTPOINT));
+    const COutPoint added(InsecureRand256(), 0);
+    Coin coin;
+    SetCoinsValue(VALUE2, coin);
+    overlay.AddCoin(added, std::move(coin), false);
+    BOOST_CHECK(overlay.HaveCoin(added));
+    BOOST_CHECK(!base.HaveCoin(added));
+
+    // And are forgotten by a reset.
+    overlay.Reset();
+    BOOST_CHECK_EQUAL(overlay.GetCacheSize(), 0U);
+    BOOST_CHECK(overlay.HaveCoin(OUTPOINT));
+    BOOST_CHECK(!overlay.HaveCoin(added));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_cursor)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewCache cache(&db);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 100; i++) {
+        outpoints.emplace_back(InsecureRand256(), i % 3);
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false), false);
+    }
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Flush());
+    std::sort(outpoints.begin(), outpoints.end());
+
+    // A cursor from a txid starts at its first coin, or at the first coin of the next txid,
+    // so cursors from txid prefixes split the set into ranges.
+    const COutPoint& middle = outpoints[50];
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor(middle.hash));
+    std::vector<COutPoint> read;
+    for (; cursor->Valid(); cursor->Next()) {
+        COutPoint key;
+        BOOST_CHECK(cursor->GetKey(key));
+        read.push_back(key);
+    }
+    BOOST_CHECK(std::vector<COutPoint>(outpoints.begin() + 50, outpoints.end()) == read);
+    cursor.reset(db.Cursor(uint256()));
+    COutPoint first;
+    BOOST_CHECK(cursor->GetKey(first));
+    BOOST_CHECK(first == outpoints[0]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,9 +8,12 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
+#include <crypto/shabal256.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <random.h>
+#include <streams.h>
 #include <util/strencodings.h>
 #include <test/test_bitcoin.h>
 
@@ -20,6 +23,10 @@
 #include <openssl/aes.h>
 #include <openssl/evp.h>
 
+extern "C" {
+#include <crypto/sph_shabal.h>
+}
+
 BOOST_FIXTURE_TEST_SUITE(crypto_tests, BasicTestingSetup)
 
 template<typename Hasher, typename In, typename Out>
@@ -562,4 +569,92 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(shabal256_multi)
+{
+    static const size_t lens[] = {0, 1, 31, 32, 63, 64, 65, 96, 4096, 4127};
+    for (size_t len : lens) {
+        for (size_t lanes = 1; lanes <= SHABAL256_MAX_LANES + 1; ++lanes) {
+            std::vector<std::vector<unsigned char>> msgs(lanes, std::vector<unsigned char>(len + 1));
+            std::vector<std::vector<unsigned char>> out1(lanes, std::vector<unsigned char>(32)), out2 = out1;
+            std::vector<const unsigned char*> in(lanes);
+            std::vector<unsigned char*> out(lanes);
+            for (size_t l = 0; l < lanes; ++l) {
+                for (size_t j = 0; j < len; ++j) msgs[l][j] = InsecureRandBits(8);
+                sph_shabal256_context ctx;
+                sph_shabal256_init(&ctx);
+                sph_shabal256(&ctx, msgs[l].data(), len);
+                sph_shabal256_close(&ctx, out1[l].data());
+                in[l] = msgs[l].data();
+                out[l] = out2[l].data();
+            }
+            Shabal256Multi(out.data(), in.data(), len, lanes);
+            BOOST_CHECK(out1 == out2);
+        }
+    }
+}
+
+static MuHash3072 MuHashFromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp, sizeof(tmp));
+}
+
+static uint256 MuHashDigest(const MuHash3072& muhash)
+{
+    uint256 out;
+    muhash.Finalize(out);
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // The set {0, 1} with 2 removed from it.
+    MuHash3072 acc = MuHashFromInt(0);
+    acc *= MuHashFromInt(1);
+    acc /= MuHashFromInt(2);
+    BOOST_CHECK_EQUAL(MuHashDigest(acc).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    // The hash of a set depends neither on the order its elements are added and removed
+    // in, nor on how the changes are grouped.
+    std::vector<std::vector<unsigned char>> elements(8, std::vector<unsigned char>(40));
+    for (auto& element : elements) {
+        for (unsigned char& byte : element) {
+            byte = InsecureRandBits(8);
+        }
+    }
+    MuHash3072 inOrder, reversed, grouped, removed;
+    for (size_t i = 0; i < elements.size(); i++) {
+        const std::vector<unsigned char>& last = elements[elements.size() - 1 - i];
+        inOrder.Insert(elements[i].data(), elements[i].size());
+        reversed.Insert(last.data(), last.size());
+        removed.Insert(elements[i].data(), elements[i].size());
+    }
+    MuHash3072 half;
+    for (size_t i = 0; i < elements.size(); i++) {
+        MuHash3072& group = i < elements.size() / 2 ? grouped : half;
+        group.Insert(elements[i].data(), elements[i].size());
+    }
+    grouped *= half;
+    BOOST_CHECK(MuHashDigest(inOrder) == MuHashDigest(reversed));
+    BOOST_CHECK(MuHashDigest(inOrder) == MuHashDigest(grouped));
+
+    // Removing elements gives the hash of the set without them, down to the empty set.
+    removed.Remove(elements[3].data(), elements[3].size());
+    BOOST_CHECK(MuHashDigest(removed) != MuHashDigest(inOrder));
+    MuHash3072 without = inOrder;
+    without /= MuHash3072(elements[3].data(), elements[3].size());
+    BOOST_CHECK(MuHashDigest(removed) == MuHashDigest(without));
+    removed.Insert(elements[3].data(), elements[3].size());
+    BOOST_CHECK(MuHashDigest(removed) == MuHashDigest(inOrder));
+    removed /= inOrder;
+    BOOST_CHECK(MuHashDigest(removed) == MuHashDigest(MuHash3072()));
+
+    // The pending removals survive serialization.
+    CDataStream ss(SER_DISK, 0);
+    ss << without;
+    MuHash3072 read;
+    ss >> read;
+    BOOST_CHECK(MuHashDigest(read) == MuHashDigest(without));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,10 +2,12 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include <boost/test/unit_test.hpp>
+
 #include <cuckoocache.h>
 #include <script/sigcache.h>
 #include <test/test_bitcoin.h>
 #include <random.h>
+#include <set>
 #include <thread>
 
 /** Test Suite for CuckooCache
@@ -362,4 +364,29 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+/** Check that for_each lists exactly the elements the cache holds and has not
+ * marked for erasure, in a cache too large for any of them to be evicted.
+ */
+BOOST_AUTO_TEST_CASE(cuckoocache_for_each)
+{
+    SeedInsecureRand(true);
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    cc.setup_bytes(4 << 20);
+    std::vector<uint256> hashes;
+    for (int x = 0; x < 20000; ++x) {
+        hashes.push_back(InsecureRand256());
+        cc.insert(hashes.back());
+    }
+    for (int x = 0; x < 1000; ++x) {
+        BOOST_CHECK(cc.contains(hashes[x], true));
+    }
+
+    std::set<uint256> listed;
+    cc.for_each([&listed](const uint256& h) { listed.insert(h); });
+    BOOST_CHECK_EQUAL(listed.size(), 19000U);
+    for (int x = 0; x < 20000; ++x) {
+        BOOST_CHECK_EQUAL(listed.count(hashes[x]), x < 1000 ? 0U : 1U);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
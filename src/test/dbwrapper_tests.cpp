@@ -7,6 +7,7 @@
 #include <random.h>
 #include <test/test_bitcoin.h>
 
+#include <limits>
 #include <memory>
 
 #include <boost/test/unit_test.hpp>
@@ -317,6 +318,45 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_subcompactions)
+{
+    // Small memtables and tables make many level-0 and level-1 files, whose
+    // compactions are split over four threads.
+    DBOptions options;
+    options.write_buffer_size = 64 << 10;
+    options.max_file_size = 64 << 10;
+    options.l0_compaction_trigger = 2;
+    options.max_subcompactions = 4;
+    fs::path ph = SetDataDir("dbwrapper_subcompactions");
+    CDBWrapper dbw(ph, (1 << 20), false, true, false, options);
+
+    std::vector<uint256> values(20000);
+    for (int round = 0; round < 4; round++) {
+        CDBBatch batch(dbw);
+        for (uint32_t i = 0; i < values.size(); i++) {
+            if (round == 3 && i % 3 == 0) {
+                batch.Erase(i);
+                values[i].SetNull();
+                continue;
+            }
+            values[i] = InsecureRand256();
+            batch.Write(i, values[i]);
+            if (batch.SizeEstimate() > (256 << 10)) {
+                BOOST_CHECK(dbw.WriteBatch(batch));
+                batch.Clear();
+            }
+        }
+        BOOST_CHECK(dbw.WriteBatch(batch));
+    }
+    dbw.CompactRange(uint32_t(0), std::numeric_limits<uint32_t>::max());
 
+    for (uint32_t i = 0; i < values.size(); i++) {
+        uint256 res;
+        BOOST_CHECK_EQUAL(dbw.Read(i, res), !values[i].IsNull());
+        if (!values[i].IsNull()) {
+            BOOST_CHECK_EQUAL(res.ToString(), values[i].ToString());
+        }
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
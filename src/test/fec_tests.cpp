@@ -0,0 +1,95 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockencodings.h>
+#include <consensus/merkle.h>
+#include <fec.h>
+#include <random.h>
+#include <streams.h>
+#include <udprelay.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(fec_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(fec_erasures)
+{
+    for (int n = 0; n < 50; n++) {
+        const size_t nData = 1 + InsecureRandRange(40);
+        const size_t nParity = InsecureRandRange(20);
+        const size_t nChunkSize = 1 + InsecureRandRange(100);
+        const CFECCode code(nData, nParity, nChunkSize);
+        std::vector<uint8_t> data(nData * nChunkSize - InsecureRandRange(nChunkSize));
+        for (uint8_t& byte : data) {
+            byte = InsecureRandBits(8);
+        }
+        const std::vector<std::vector<uint8_t>> chunks = code.Encode(data);
+        BOOST_REQUIRE_EQUAL(chunks.size(), nData + nParity);
+
+        // Lose as many chunks as there are parity chunks, any of them.
+        std::vector<size_t> order(nData + nParity);
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        Shuffle(order.begin(), order.end(), g_insecure_rand_ctx);
+        std::map<size_t, std::vector<uint8_t>> received;
+        for (size_t i = 0; i < nData; i++) {
+            received.emplace(order[i], chunks[order[i]]);
+        }
+        std::vector<uint8_t> decoded;
+        BOOST_REQUIRE(code.Decode(received, data.size(), decoded));
+        BOOST_CHECK(decoded == data);
+
+        // One chunk short of the data chunks is not enough.
+        received.erase(received.begin());
+        BOOST_CHECK(!code.Decode(received, data.size(), decoded));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(udprelay_packets)
+{
+    CBlock block;
+    block.nTime = 1234;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey.resize(5000);
+    tx.vout[0].nValue = 42;
+    block.vtx.push_back(MakeTransactionRef(tx));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    const uint256 hash = block.GetHash();
+    const CBlockHeaderAndShortTxIDs cmpctblock(block, true);
+
+    CUDPRelay sender({}, 0, "secret");
+    std::vector<std::vector<uint8_t>> packets = sender.MakePackets(hash, cmpctblock);
+    BOOST_REQUIRE(packets.size() > MIN_UDP_RELAY_PARITY);
+
+    // Packets signed with another key or altered are dropped.
+    CUDPRelay receiver({}, 0, "secret");
+    uint256 hashOut;
+    std::vector<uint8_t> data;
+    BOOST_CHECK(!CUDPRelay({}, 0, "other").ProcessPacket(packets[0].data(), packets[0].size(), hashOut, data));
+    std::vector<uint8_t> altered = packets[0];
+    altered[100] ^= 1;
+    BOOST_CHECK(!receiver.ProcessPacket(altered.data(), altered.size(), hashOut, data));
+
+    // The compact block is rebuilt with the first data chunk lost.
+    bool fDone = false;
+    for (size_t i = 1; i < packets.size() && !fDone; i++) {
+        fDone = receiver.ProcessPacket(packets[i].data(), packets[i].size(), hashOut, data);
+    }
+    BOOST_REQUIRE(fDone);
+    BOOST_CHECK(hashOut == hash);
+    CBlockHeaderAndShortTxIDs cmpctblockOut;
+    CDataStream(data, SER_NETWORK, PROTOCOL_VERSION) >> cmpctblockOut;
+    BOOST_CHECK(cmpctblockOut.header.GetHash() == hash);
+    BOOST_CHECK_EQUAL(cmpctblockOut.BlockTxCount(), 1U);
+
+    // Its late chunks are dropped.
+    BOOST_CHECK(!receiver.ProcessPacket(packets[0].data(), packets[0].size(), hashOut, data));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -146,6 +146,41 @@ BOOST_AUTO_TEST_CASE(siphash)
         BOOST_CHECK_EQUAL(SipHashUint256(k1, k2, x), sip256.Finalize());
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }
+
+    // Check consistency between SipHashUint256 and SipHashUint256Multi, for counts around the lane widths.
+    for (size_t n = 0; n < 20; n++) {
+        uint64_t k1 = ctx.rand64();
+        uint64_t k2 = ctx.rand64();
+        std::vector<uint256> vals(n);
+        std::vector<const uint256*> ptrs(n);
+        for (size_t i = 0; i < n; i++) {
+            vals[i] = InsecureRand256();
+            ptrs[i] = &vals[i];
+        }
+        std::vector<uint64_t> out(n);
+        SipHashUint256Multi(k1, k2, ptrs.data(), out.data(), n);
+        for (size_t i = 0; i < n; i++) {
+            BOOST_CHECK_EQUAL(out[i], SipHashUint256(k1, k2, vals[i]));
+        }
+    }
+
+    // Check consistency between CSipHasher and SipHashMulti, for every tail length of a message.
+    for (size_t len = 0; len < 40; len++) {
+        uint64_t k1 = ctx.rand64();
+        uint64_t k2 = ctx.rand64();
+        const size_t n = 8 + len % 8;
+        std::vector<std::vector<unsigned char>> msgs(n);
+        std::vector<const unsigned char*> ptrs(n);
+        for (size_t i = 0; i < n; i++) {
+            msgs[i] = ctx.randbytes(len);
+            ptrs[i] = msgs[i].data();
+        }
+        std::vector<uint64_t> out(n);
+        SipHashMulti(k1, k2, ptrs.data(), len, out.data(), n);
+        for (size_t i = 0; i < n; i++) {
+            BOOST_CHECK_EQUAL(out[i], CSipHasher(k1, k2).Write(msgs[i].data(), len).Finalize());
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
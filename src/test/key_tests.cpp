@@ -188,4 +188,30 @@ BOOST_AUTO_TEST_CASE(key_signature_tests)
     BOOST_CHECK(found_small);
 }
 
+BOOST_AUTO_TEST_CASE(key_schnorr_tests)
+{
+    std::vector<std::vector<unsigned char>> sigs;
+    std::vector<uint256> hashes;
+    std::vector<CPubKey> pubkeys;
+    for (const std::string& secret : {strSecret1, strSecret2, strSecret1C, strSecret2C}) {
+        CKey key = DecodeSecret(secret);
+        std::string msg = "A message to be signed by " + secret;
+        uint256 msg_hash = Hash(msg.begin(), msg.end());
+        std::vector<unsigned char> sig;
+        BOOST_CHECK(key.SignSchnorr(msg_hash, sig));
+        BOOST_CHECK_EQUAL(sig.size(), CPubKey::SCHNORR_SIGNATURE_SIZE);
+        BOOST_CHECK(key.GetPubKey().VerifySchnorr(msg_hash, sig));
+        BOOST_CHECK(!key.GetPubKey().Verify(msg_hash, sig));
+        sigs.push_back(sig);
+        hashes.push_back(msg_hash);
+        pubkeys.push_back(key.GetPubKey());
+    }
+    BOOST_CHECK(CPubKey::VerifySchnorrBatch(sigs, hashes, pubkeys));
+
+    // A single bad signature fails the whole batch.
+    std::swap(hashes[0], hashes[1]);
+    BOOST_CHECK(!pubkeys[0].VerifySchnorr(hashes[0], sigs[0]));
+    BOOST_CHECK(!CPubKey::VerifySchnorrBatch(sigs, hashes, pubkeys));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,8 +3,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <policy/policy.h>
+#include <policy/rbf.h>
+#include <ticket.h>
 #include <txmempool.h>
 #include <util/system.h>
+#include <validation.h>
 
 #include <test/test_bitcoin.h>
 
@@ -749,4 +752,231 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolTicketIndexTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+
+    // Firestone purchases in the layout buyfirestone creates, two locked until 2047 and one until 4095.
+    auto makeTicketTx = [](int lockHeight, unsigned char n) {
+        const CScript redeemScript = GenerateTicketScript(CKeyID(uint160(std::vector<unsigned char>(20, n))), lockHeight);
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(uint256(std::vector<unsigned char>(32, n)), 0);
+        tx.vout.emplace_back(0, CScript() << OP_RETURN << CTicket::VERSION << ToByteVector(redeemScript));
+        tx.vout.emplace_back(3000 * COIN, GetScriptForDestination(CScriptID(redeemScript)));
+        return MakeTransactionRef(tx);
+    };
+    const CTransactionRef ticket1 = makeTicketTx(2047, 1);
+    const CTransactionRef ticket2 = makeTicketTx(2047, 2);
+    const CTransactionRef ticket3 = makeTicketTx(4095, 3);
+    BOOST_CHECK(ticket1->IsTicketTx() && ticket2->IsTicketTx() && ticket3->IsTicketTx());
+
+    CMutableTransaction txOther;
+    txOther.vin.resize(1);
+    txOther.vout.emplace_back(10 * COIN, CScript() << OP_11 << OP_EQUAL);
+    pool.addUnchecked(entry.FromTx(txOther));
+    for (const auto& tx : {ticket1, ticket2, ticket3}) {
+        pool.addUnchecked(entry.FromTx(tx));
+    }
+    BOOST_CHECK_EQUAL(pool.TicketTxCount(), 3U);
+    BOOST_CHECK_EQUAL(pool.GetTicketTxs(2047).size(), 2U);
+    BOOST_CHECK_EQUAL(pool.GetTicketTxs(4095).size(), 1U);
+    BOOST_CHECK(pool.GetTicketTxs(6143).empty());
+    BOOST_CHECK(pool.GetTicketTx(ticket3->Ticket()->out) == ticket3);
+
+    pool.removeRecursive(*ticket1);
+    BOOST_CHECK_EQUAL(pool.TicketTxCount(), 2U);
+    BOOST_CHECK_EQUAL(pool.GetTicketTxs(2047).size(), 1U);
+    BOOST_CHECK(pool.GetTicketTx(ticket1->Ticket()->out) == nullptr);
+
+    pool.removeRecursive(*ticket3);
+    BOOST_CHECK(pool.GetTicketTxs(4095).empty());
+    BOOST_CHECK_EQUAL(pool.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+
+    auto makeTx = [](const COutPoint& prevout, opcodetype op) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << op;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << op << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        return tx;
+    };
+    // A child paying for its parent, a parent paying more than its child, and a lone transaction.
+    const CMutableTransaction tx1 = makeTx(COutPoint(), OP_1);
+    const CMutableTransaction tx2 = makeTx(COutPoint(tx1.GetHash(), 0), OP_2);
+    const CMutableTransaction tx3 = makeTx(COutPoint(), OP_3);
+    const CMutableTransaction tx4 = makeTx(COutPoint(tx3.GetHash(), 0), OP_4);
+    const CMutableTransaction tx5 = makeTx(COutPoint(), OP_5);
+    pool.addUnchecked(entry.Fee(100LL).FromTx(tx1));
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx2));
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(tx3));
+    pool.addUnchecked(entry.Fee(100LL).FromTx(tx4));
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(tx5));
+
+    CTxMemPool::setEntries setCluster;
+    pool.CalculateCluster(*pool.GetIter(tx2.GetHash()), setCluster);
+    BOOST_CHECK_EQUAL(setCluster.size(), 2U);
+    BOOST_CHECK(setCluster.count(*pool.GetIter(tx1.GetHash())));
+
+    // tx3 alone, then tx1 with tx2, tx5 and last tx4.
+    const std::vector<CTxMemPool::Chunk> chunks = pool.GetChunks();
+    BOOST_CHECK_EQUAL(chunks.size(), 4U);
+    BOOST_CHECK(chunks[0].txs.size() == 1 && chunks[0].txs[0]->GetTx().GetHash() == tx3.GetHash());
+    BOOST_CHECK(chunks[1].txs.size() == 2 && chunks[1].txs[0]->GetTx().GetHash() == tx1.GetHash());
+    BOOST_CHECK_EQUAL(chunks[1].nFee, 10100);
+    BOOST_CHECK(chunks[2].txs.size() == 1 && chunks[2].txs[0]->GetTx().GetHash() == tx5.GetHash());
+    BOOST_CHECK(chunks[3].txs.size() == 1 && chunks[3].txs[0]->GetTx().GetHash() == tx4.GetHash());
+
+    // Trimming takes the last chunk first, leaving its parent.
+    fClusterMempool = true;
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    fClusterMempool = DEFAULT_CLUSTER_MEMPOOL;
+    BOOST_CHECK(!pool.exists(tx4.GetHash()));
+    BOOST_CHECK(pool.exists(tx3.GetHash()));
+    BOOST_CHECK_EQUAL(pool.size(), 4U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+
+    auto makeTx = [](const COutPoint& prevout, opcodetype op) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << op;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << op << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        return tx;
+    };
+    // A chain tx1 <- tx2 <- tx3, and tx4 <- tx5 spending an output the block spends too.
+    const COutPoint outpoint(InsecureRand256(), 0);
+    const CMutableTransaction tx1 = makeTx(COutPoint(), OP_1);
+    const CMutableTransaction tx2 = makeTx(COutPoint(tx1.GetHash(), 0), OP_2);
+    const CMutableTransaction tx3 = makeTx(COutPoint(tx2.GetHash(), 0), OP_3);
+    const CMutableTransaction tx4 = makeTx(outpoint, OP_4);
+    const CMutableTransaction tx5 = makeTx(COutPoint(tx4.GetHash(), 0), OP_5);
+    const CMutableTransaction txBlock = makeTx(outpoint, OP_6);
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(tx1));
+    pool.addUnchecked(entry.Fee(2000LL).FromTx(tx2));
+    pool.addUnchecked(entry.Fee(3000LL).FromTx(tx3));
+    pool.addUnchecked(entry.Fee(4000LL).FromTx(tx4));
+    pool.addUnchecked(entry.Fee(5000LL).FromTx(tx5));
+
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeTransactionRef(tx1));
+    vtx.push_back(MakeTransactionRef(tx2));
+    vtx.push_back(MakeTransactionRef(txBlock));
+    pool.removeForBlock(vtx, 1);
+
+    // tx3 is left on its own, the conflict goes with its child.
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    CTxMemPool::txiter it = pool.mapTx.find(tx3.GetHash());
+    BOOST_REQUIRE(it != pool.mapTx.end());
+    BOOST_CHECK_EQUAL(it->GetCountWithAncestors(), 1U);
+    BOOST_CHECK_EQUAL(it->GetSizeWithAncestors(), it->GetTxSize());
+    BOOST_CHECK_EQUAL(it->GetModFeesWithAncestors(), 3000);
+    BOOST_CHECK(pool.GetMemPoolParents(it).empty());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vin[0].nSequence = MAX_BIP125_RBF_SEQUENCE;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(tx1));
+    }
+
+    const MempoolSnapshotRef snapshot1 = pool.GetSnapshot();
+    BOOST_CHECK_EQUAL(snapshot1->entries.size(), 1U);
+    BOOST_CHECK(pool.GetSnapshot() == snapshot1);
+
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(2000LL).FromTx(tx2));
+    }
+
+    // A change publishes a new snapshot, the old one stays as it was.
+    const MempoolSnapshotRef snapshot2 = pool.GetSnapshot();
+    BOOST_CHECK(snapshot2 != snapshot1);
+    BOOST_CHECK_EQUAL(snapshot1->entries.size(), 1U);
+    BOOST_CHECK_EQUAL(snapshot2->entries.size(), 2U);
+    BOOST_CHECK(snapshot1->Find(tx2.GetHash()) == nullptr);
+
+    const TxMempoolSnapshotEntry* e1 = snapshot2->Find(tx1.GetHash());
+    const TxMempoolSnapshotEntry* e2 = snapshot2->Find(tx2.GetHash());
+    BOOST_REQUIRE(e1 && e2);
+    BOOST_CHECK(snapshot2->entries[0].tx->GetHash() == tx1.GetHash());
+    BOOST_CHECK(e1->vChildren == std::vector<uint256>{tx2.GetHash()});
+    BOOST_CHECK(e2->vParents == std::vector<uint256>{tx1.GetHash()});
+    BOOST_CHECK_EQUAL(e1->nModFeesWithDescendants, 3000);
+    BOOST_CHECK_EQUAL(e2->nCountWithAncestors, 2U);
+    // tx2 inherits the replaceability of its parent.
+    BOOST_CHECK(e1->fReplaceable && e2->fReplaceable);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolTxDataTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(1, 1));
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    const PrecomputedTransactionData txdata(tx);
+    BOOST_REQUIRE(txdata.ready);
+    {
+        LOCK2(cs_main, pool.cs);
+        CTxMemPoolEntry e = entry.FromTx(tx);
+        e.SetTxData(txdata);
+        pool.addUnchecked(e);
+    }
+
+    PrecomputedTransactionData found;
+    BOOST_CHECK(pool.GetTxData(CTransaction(tx), found));
+    BOOST_CHECK(found.ready);
+    BOOST_CHECK(found.hashPrevouts == txdata.hashPrevouts);
+    BOOST_CHECK(found.hashOutputs == txdata.hashOutputs);
+
+    // The same transaction with another witness is not the one in the mempool.
+    CMutableTransaction malleated = tx;
+    malleated.vin[0].scriptWitness.stack[0][0] = 2;
+    PrecomputedTransactionData notfound;
+    BOOST_CHECK(!pool.GetTxData(CTransaction(malleated), notfound));
+    BOOST_CHECK(!notfound.ready);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <metrics.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(metrics_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(histogram_buckets)
+{
+    // Values below SUB_BUCKETS have a bucket each.
+    for (uint64_t v = 0; v < (uint64_t)CMetricHistogram::SUB_BUCKETS; v++) {
+        BOOST_CHECK_EQUAL(CMetricHistogram::BucketIndex(v), (int)v);
+        BOOST_CHECK_EQUAL(CMetricHistogram::BucketUpperBound((int)v), v);
+    }
+    // Every value is at most its bucket's upper bound, within 1/SUB_BUCKETS of it.
+    for (uint64_t v : {8ULL, 9ULL, 15ULL, 16ULL, 17ULL, 1000ULL, 123456789ULL, 0xffffffffffffffffULL}) {
+        const int index = CMetricHistogram::BucketIndex(v);
+        BOOST_CHECK(index < CMetricHistogram::BUCKETS);
+        const uint64_t upper = CMetricHistogram::BucketUpperBound(index);
+        BOOST_CHECK(v <= upper);
+        BOOST_CHECK(upper - v <= v / CMetricHistogram::SUB_BUCKETS);
+        BOOST_CHECK(index == 0 || CMetricHistogram::BucketUpperBound(index - 1) < v);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(histogram_percentiles)
+{
+    CMetricHistogram histogram("test", "");
+    BOOST_CHECK_EQUAL(histogram.GetSummary().Percentile(0.5), 0U);
+
+    for (uint64_t v = 1; v <= 1000; v++)
+        histogram.Record(v);
+    const CMetricHistogram::Summary summary = histogram.GetSummary();
+    BOOST_CHECK_EQUAL(summary.count, 1000U);
+    BOOST_CHECK_EQUAL(summary.sum, 500500U);
+    BOOST_CHECK_EQUAL(summary.max, 1000U);
+
+    const uint64_t p50 = summary.Percentile(0.5);
+    BOOST_CHECK(p50 >= 500 && p50 <= 500 + 500 / CMetricHistogram::SUB_BUCKETS);
+    const uint64_t p99 = summary.Percentile(0.99);
+    BOOST_CHECK(p99 >= 990 && p99 <= 1000);
+    BOOST_CHECK_EQUAL(summary.Percentile(1.0), 1000U);
+
+    BOOST_CHECK_EQUAL(summary.CountAtOrBelow(7), 7U);
+    BOOST_CHECK_EQUAL(summary.CountAtOrBelow(100000), 1000U);
+}
+
+BOOST_AUTO_TEST_CASE(registry_prometheus)
+{
+    CMetricsRegistry registry;
+    CMetricHistogram& histogram = registry.Histogram("test_latency", "A test");
+    BOOST_CHECK_EQUAL(&registry.Histogram("test_latency", "A test"), &histogram);
+    histogram.Record(20);
+    histogram.Record(2000);
+    registry.Counter("test_events", "Events").Add(3);
+
+    const std::string text = registry.ToPrometheus();
+    BOOST_CHECK(text.find("# TYPE lava_test_events_total counter\nlava_test_events_total 3\n") != std::string::npos);
+    BOOST_CHECK(text.find("# TYPE lava_test_latency_seconds histogram\n") != std::string::npos);
+    BOOST_CHECK(text.find("lava_test_latency_seconds_bucket{le=\"1e-05\"} 0\n") != std::string::npos);
+    BOOST_CHECK(text.find("lava_test_latency_seconds_bucket{le=\"2.5e-05\"} 1\n") != std::string::npos);
+    BOOST_CHECK(text.find("lava_test_latency_seconds_bucket{le=\"+Inf\"} 2\n") != std::string::npos);
+    BOOST_CHECK(text.find("lava_test_latency_seconds_count 2\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
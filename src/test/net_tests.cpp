@@ -165,6 +165,44 @@ BOOST_AUTO_TEST_CASE(caddrdb_read_corrupted)
     BOOST_CHECK(addrman2.size() == 0);
 }
 
+BOOST_AUTO_TEST_CASE(caddrdb_journal)
+{
+    SetDataDir("caddrdb_journal");
+    CAddrMan addrman1;
+    addrman1.EnableJournal();
+
+    CService addr1, addr2, addr3, source;
+    BOOST_CHECK(Lookup("250.7.1.1", addr1, 8333, false));
+    BOOST_CHECK(Lookup("250.7.2.2", addr2, 9999, false));
+    BOOST_CHECK(Lookup("250.7.3.3", addr3, 9999, false));
+    BOOST_CHECK(Lookup("252.5.1.1", source, 8333, false));
+    BOOST_CHECK(addrman1.Add(CAddress(addr1, NODE_NONE), source));
+    BOOST_CHECK(addrman1.Add(CAddress(addr2, NODE_NONE), source));
+
+    // The snapshot holds the changes journaled so far.
+    CAddrDB adb;
+    std::vector<unsigned char> records;
+    BOOST_CHECK(adb.WriteSnapshot(addrman1, records));
+    BOOST_CHECK(!records.empty());
+    BOOST_CHECK(addrman1.TakeJournal().empty());
+    adb.ResetJournal();
+
+    // Later changes go to the journal, whose last record a crash cut short.
+    BOOST_CHECK(addrman1.Add(CAddress(addr3, NODE_NONE), source));
+    addrman1.Good(CAddress(addr3, NODE_NONE));
+    BOOST_CHECK(adb.AppendJournal(addrman1.TakeJournal()));
+    BOOST_CHECK(adb.AppendJournal({CAddrMan::JOURNAL_ADD, 0x01}));
+
+    CAddrMan addrman2;
+    BOOST_CHECK(adb.Read(addrman2));
+    BOOST_CHECK_EQUAL(addrman2.size(), 2U);
+    BOOST_CHECK_EQUAL(adb.ReadJournal(addrman2), 2U);
+    BOOST_CHECK_EQUAL(addrman2.size(), 3U);
+
+    adb.ResetJournal();
+    BOOST_CHECK_EQUAL(adb.JournalSize(), 0U);
+}
+
 BOOST_AUTO_TEST_CASE(cnode_simple_test)
 {
     SOCKET hSocket = INVALID_SOCKET;
@@ -303,4 +341,75 @@ BOOST_AUTO_TEST_CASE(LocalAddress_BasicLifecycle)
 }
 
 
+BOOST_AUTO_TEST_CASE(cnetmessage_receive_in_place)
+{
+    // A message longer than the 256 KiB read ahead, received alternately in place and copied.
+    std::vector<unsigned char> payload(1000 * 1000);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = i * 7;
+    }
+    const uint256 hash = Hash(payload.begin(), payload.end());
+    CMessageHeader hdr(Params().MessageStart(), NetMsgType::BLOCK, payload.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream hdrStream(SER_NETWORK, INIT_PROTO_VERSION);
+    hdrStream << hdr;
+
+    CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    BOOST_CHECK_EQUAL(msg.readHeader(hdrStream.data(), hdrStream.size()), (int)hdrStream.size());
+    bool fInPlace = true;
+    for (size_t pos = 0; pos < payload.size(); fInPlace = !fInPlace) {
+        unsigned int nBytes = 0x10000;
+        const char* pch = reinterpret_cast<const char*>(&payload[pos]);
+        if (fInPlace) {
+            char* dest = msg.PrepareData(nBytes);
+            memcpy(dest, pch, nBytes);
+            pch = dest;
+        } else {
+            nBytes = std::min<size_t>(nBytes, payload.size() - pos);
+        }
+        BOOST_CHECK_EQUAL(msg.readData(pch, nBytes), (int)nBytes);
+        pos += nBytes;
+    }
+
+    BOOST_CHECK(msg.complete());
+    BOOST_CHECK_EQUAL(msg.vRecv.size(), payload.size());
+    BOOST_CHECK(std::equal(payload.begin(), payload.end(), reinterpret_cast<const unsigned char*>(msg.vRecv.data())));
+    BOOST_CHECK(msg.GetMessageHash() == hash);
+}
+
+BOOST_AUTO_TEST_CASE(csendqueue_priority)
+{
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::CMPCTBLOCK), SEND_PRIORITY_BLOCK);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::HEADERS), SEND_PRIORITY_HEADERS);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::PING), SEND_PRIORITY_HEADERS);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::INV), SEND_PRIORITY_TX);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::ADDR), SEND_PRIORITY_ADDR);
+
+    CSendQueue queue;
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(queue.Front() == nullptr);
+    queue.push_back(SEND_PRIORITY_TX, std::vector<unsigned char>(24, 't'), std::vector<unsigned char>(100, 't'));
+    queue.push_back(SEND_PRIORITY_ADDR, std::vector<unsigned char>(24, 'a'), {});
+    BOOST_CHECK_EQUAL(queue.size(), 2U);
+    BOOST_CHECK_EQUAL(queue.Bytes(SEND_PRIORITY_TX), 124U);
+
+    // A block queued later goes out first.
+    queue.push_back(SEND_PRIORITY_BLOCK, std::vector<unsigned char>(24, 'b'), std::vector<unsigned char>(1000, 'b'));
+    BOOST_CHECK_EQUAL(queue.Front()->header[0], 'b');
+    BOOST_CHECK(queue.Advance(1024));
+
+    // But it does not cut into a transaction that started going out.
+    BOOST_CHECK(!queue.Advance(30));
+    queue.push_back(SEND_PRIORITY_BLOCK, std::vector<unsigned char>(24, 'b'), std::vector<unsigned char>(1000, 'b'));
+    BOOST_CHECK_EQUAL(queue.Front()->header[0], 't');
+    BOOST_CHECK_EQUAL(queue.Offset(), 30U);
+    BOOST_CHECK(queue.Advance(94));
+    BOOST_CHECK_EQUAL(queue.Bytes(SEND_PRIORITY_TX), 0U);
+    BOOST_CHECK_EQUAL(queue.Front()->header[0], 'b');
+    BOOST_CHECK(queue.Advance(1024));
+    BOOST_CHECK_EQUAL(queue.Front()->header[0], 'a');
+    BOOST_CHECK(queue.Advance(24));
+    BOOST_CHECK(queue.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
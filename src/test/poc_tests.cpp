@@ -2,12 +2,15 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <assember.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <pow.h>
 #include <poc.h>
 #include <random.h>
+#include <streams.h>
 #include <util/system.h>
+#include <validation.h>
 #include <test/test_bitcoin.h>
 
 #include <boost/test/unit_test.hpp>
@@ -58,6 +61,297 @@ BOOST_AUTO_TEST_CASE(get_last_basetarget)
     BOOST_CHECK_EQUAL(AdjustBaseTarget(&blocks[23], nLastRetargetTime), 10000);
 }
 
+/* Test deadlines and generation signatures against fixed vectors */
+BOOST_AUTO_TEST_CASE(calc_deadline_vectors)
+{
+    const uint256 genSig = uint256S("5f6e7d8c9bab0a1b2c3d4e5f60718293a4b5c6d7e8f90a1b2c3d4e5f60718293");
+    uint160 keyID;
+    keyID.SetHex("00112233445566778899aabbccddeeff01234567");
+    BOOST_CHECK_EQUAL(CalcDeadline(genSig, 123456, keyID, 987654321), 3306445292031202644ULL);
+    BOOST_CHECK_EQUAL(CalcDeadlinePoc2(genSig, 2016, 0x1234567890abcdefULL, 42), 14975487567163936732ULL);
+    BOOST_CHECK_EQUAL(CalcGenerationSignature(genSig, keyID).GetHex(), "a3bce8b73ac81520306eaebc2e75237a610ab3995022511374ce473765465a9b");
+    BOOST_CHECK_EQUAL(CalcGenerationSignaturePoc2(genSig, 0x1234567890abcdefULL).GetHex(), "d1ab075cdabc59f524822283fb620780ecc09846027b788372288f92b9c496ec");
+}
+
+/* Test lane-parallel deadlines against the one-nonce path */
+BOOST_AUTO_TEST_CASE(calc_deadlines_match_single)
+{
+    const uint256 genSig = InsecureRand256();
+    const uint160 keyID = uint160(std::vector<unsigned char>(20, 0x5a));
+    std::vector<uint64_t> nonces(19);
+    for (auto& nonce : nonces) nonce = InsecureRand32();
+
+    std::vector<uint64_t> deadlines(nonces.size());
+    CalcDeadlines(genSig, 1234, keyID, nonces.data(), deadlines.data(), nonces.size());
+    for (size_t i = 0; i < nonces.size(); i++) {
+        BOOST_CHECK_EQUAL(deadlines[i], CalcDeadline(genSig, 1234, keyID, nonces[i]));
+    }
+}
+
+/* Test the per-tip mining info against direct computation */
+BOOST_AUTO_TEST_CASE(poc_tip_info)
+{
+    const uint256 hash = InsecureRand256();
+    CBlockIndex tip;
+    tip.phashBlock = &hash;
+    tip.nHeight = 99;
+    tip.genSign = InsecureRand256();
+    tip.nPlotID = 1234567;
+    tip.nPublicKeyID = uint160(std::vector<unsigned char>(20, 0x42));
+    tip.nBaseTarget = 18325193796L;
+
+    for (const int nLVIP05Height : {50, 150}) {
+        const PoCTipInfo info = GetPoCTipInfo(&tip, nLVIP05Height);
+        BOOST_CHECK(info.hashTip == hash);
+        BOOST_CHECK_EQUAL(info.height, 100);
+        BOOST_CHECK_EQUAL(info.fPoc2, nLVIP05Height == 150);
+        BOOST_CHECK_EQUAL(info.baseTarget, tip.nBaseTarget);
+        const uint256 genSig = info.fPoc2 ? CalcGenerationSignaturePoc2(tip.genSign, tip.nPlotID) : CalcGenerationSignature(tip.genSign, tip.nPublicKeyID);
+        BOOST_CHECK(info.genSig == genSig);
+        const uint64_t nonce = InsecureRand32();
+        const uint64_t deadline = info.fPoc2 ? CalcDeadlinePoc2(genSig, 100, tip.nPlotID, nonce) : CalcDeadline(genSig, 100, tip.nPublicKeyID, nonce);
+        BOOST_CHECK_EQUAL(CalcDeadline(info, tip.nPublicKeyID, tip.nPlotID, nonce), deadline);
+
+        // A different tip must not be served from the cache.
+        tip.genSign = InsecureRand256();
+        const uint256 hash2 = InsecureRand256();
+        tip.phashBlock = &hash2;
+        BOOST_CHECK(GetPoCTipInfo(&tip, nLVIP05Height).hashTip == hash2);
+        tip.phashBlock = &hash;
+    }
+}
+
+/* Test generated plot columns against the deadlines of the nonces they hold */
+BOOST_AUTO_TEST_CASE(generate_nonce_scoops)
+{
+    const uint256 hash = InsecureRand256();
+    CBlockIndex tip;
+    tip.phashBlock = &hash;
+    tip.nHeight = 99;
+    tip.genSign = InsecureRand256();
+    tip.nPublicKeyID = uint160(std::vector<unsigned char>(20, 0x42));
+    const PoCTipInfo info = GetPoCTipInfo(&tip, 50);
+    BOOST_CHECK(!info.fPoc2);
+
+    // An odd count leaves the last lane group of the engine partly empty.
+    const uint160 keyID = uint160(std::vector<unsigned char>(20, 0x5a));
+    const uint64_t startNonce = InsecureRand32();
+    const size_t count = 11;
+    const size_t columnStride = count * POC_SCOOP_SIZE;
+    std::vector<uint8_t> scoops(POC_SCOOP_COUNT * columnStride);
+    GenerateNonceScoops(keyID, startNonce, count, scoops.data(), columnStride);
+
+    std::vector<uint64_t> deadlines(count);
+    CalcScoopDeadlines(info.genSig, &scoops[info.scoop * columnStride], deadlines.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        BOOST_CHECK_EQUAL(deadlines[i], CalcDeadline(info, keyID, 0, startNonce + i));
+    }
+}
+
+/* Test batch verification of mixed poc2 and poc2.x proofs against the single checks */
+BOOST_AUTO_TEST_CASE(check_poc_batch)
+{
+    const uint64_t targetDeadline = 60 * 60 * 24;
+    std::vector<PoCItem> items(21);
+    for (size_t i = 0; i < items.size(); i++) {
+        PoCItem& item = items[i];
+        item.genSig = InsecureRand256();
+        item.height = 1000 + i;
+        item.fPoc2 = i % 3 == 0;
+        item.plotID = InsecureRandBits(63);
+        item.publicKeyID = uint160(std::vector<unsigned char>(20, (unsigned char)i));
+        item.nonce = InsecureRand32();
+        item.baseTarget = 18325193796L;
+        item.deadline = item.fPoc2 ? CalcDeadlinePoc2(item.genSig, item.height, item.plotID, item.nonce) : CalcDeadline(item.genSig, item.height, item.publicKeyID, item.nonce);
+        // Corrupt every fifth proof.
+        if (i % 5 == 4) item.deadline ^= 1;
+    }
+
+    BOOST_CHECK(!CheckProofOfCapacityBatch(MakeSpan(items), targetDeadline));
+    for (const PoCItem& item : items) {
+        const bool expected = item.fPoc2 ?
+            CheckProofOfCapacityPoc2(item.genSig, item.height, item.plotID, item.nonce, item.baseTarget, item.deadline, targetDeadline) :
+            CheckProofOfCapacity(item.genSig, item.height, item.publicKeyID, item.nonce, item.baseTarget, item.deadline, targetDeadline);
+        BOOST_CHECK_EQUAL(item.fValid, expected);
+    }
+
+    std::vector<PoCItem> valid;
+    for (const PoCItem& item : items) {
+        if (item.fValid) valid.push_back(item);
+    }
+    BOOST_CHECK(CheckProofOfCapacityBatch(MakeSpan(valid), targetDeadline));
+}
+
+/* Test deadlines read from the nonce tables of fast PoC test chains match generated nonces */
+BOOST_AUTO_TEST_CASE(nonce_tables)
+{
+    const uint160 publicKeyID = uint160(std::vector<unsigned char>(20, 0x5a));
+    std::vector<PoCItem> items(2 * FAST_POC_NONCES);
+    for (size_t i = 0; i < items.size(); i++) {
+        PoCItem& item = items[i];
+        item.genSig = InsecureRand256();
+        item.height = 1000 + i;
+        item.publicKeyID = publicKeyID;
+        item.nonce = i % (FAST_POC_NONCES + 4);
+        item.baseTarget = 18325193796L;
+        item.deadline = CalcDeadline(item.genSig, item.height, item.publicKeyID, item.nonce);
+    }
+
+    SetNonceTableSize(FAST_POC_NONCES);
+    for (const PoCItem& item : items) {
+        BOOST_CHECK_EQUAL(CalcDeadline(item.genSig, item.height, item.publicKeyID, item.nonce), item.deadline);
+    }
+    items[3].deadline ^= 1;
+    BOOST_CHECK(!CheckProofOfCapacityBatch(MakeSpan(items), std::numeric_limits<uint64_t>::max()));
+    for (size_t i = 0; i < items.size(); i++) {
+        BOOST_CHECK_EQUAL(items[i].fValid, i != 3);
+    }
+    SetNonceTableSize(0);
+
+    const auto regtestParams = CreateChainParams(CBaseChainParams::REGTEST);
+    BOOST_CHECK(!regtestParams->GetConsensus().fFastPoC);
+    BOOST_CHECK_EQUAL(DeadlineWait(1000 * 18325193796L, 18325193796L, regtestParams->GetConsensus()), 1000U);
+    Consensus::Params consensus = regtestParams->GetConsensus();
+    consensus.fFastPoC = true;
+    BOOST_CHECK_EQUAL(DeadlineWait(1000 * 18325193796L, 18325193796L, consensus), 0U);
+}
+
+/** A batch device that verifies on the CPU, or fails, counting the proofs it was handed. */
+class TestPoCBatchVerifier : public PoCBatchVerifier
+{
+public:
+    bool fFail;
+    size_t nVerified;
+
+    explicit TestPoCBatchVerifier(bool fFailIn) : fFail(fFailIn), nVerified(0) {}
+
+    std::string Name() const override { return "test"; }
+    size_t MinBatchSize() const override { return 8; }
+    bool Verify(Span<PoCItem> items, const uint64_t targetDeadline) override
+    {
+        if (fFail) return false;
+        nVerified += items.size();
+        CheckProofOfCapacityBatch(items, targetDeadline);
+        return true;
+    }
+};
+
+/* Test submitted proofs go to the batch device when the batch is large enough, and to the CPU otherwise or when it fails */
+BOOST_AUTO_TEST_CASE(check_poc_batch_device)
+{
+    const uint64_t targetDeadline = 60 * 60 * 24;
+    std::vector<PoCItem> items(12);
+    for (size_t i = 0; i < items.size(); i++) {
+        PoCItem& item = items[i];
+        item.genSig = InsecureRand256();
+        item.height = 1000 + i;
+        item.publicKeyID = uint160(std::vector<unsigned char>(20, (unsigned char)i));
+        item.nonce = InsecureRand32();
+        item.baseTarget = 18325193796L;
+        item.deadline = CalcDeadline(item.genSig, item.height, item.publicKeyID, item.nonce);
+        if (i % 4 == 3) item.deadline ^= 1;
+    }
+
+    for (const bool fFail : {false, true}) {
+        auto verifier = std::make_shared<TestPoCBatchVerifier>(fFail);
+        SetPoCBatchVerifier(verifier);
+        // Too small for the device.
+        std::vector<PoCItem> small(items.begin(), items.begin() + 4);
+        CheckSubmittedProofsOfCapacity(MakeSpan(small), targetDeadline);
+        BOOST_CHECK_EQUAL(verifier->nVerified, 0U);
+        for (size_t i = 0; i < small.size(); i++) {
+            BOOST_CHECK_EQUAL(small[i].fValid, i % 4 != 3);
+        }
+
+        std::vector<PoCItem> large(items);
+        CheckSubmittedProofsOfCapacity(MakeSpan(large), targetDeadline);
+        BOOST_CHECK_EQUAL(verifier->nVerified, fFail ? 0U : large.size());
+        for (size_t i = 0; i < large.size(); i++) {
+            BOOST_CHECK_EQUAL(large[i].fValid, i % 4 != 3);
+        }
+    }
+    SetPoCBatchVerifier(nullptr);
+}
+
+/* Test both header layouts against field by field serialization, on the wire and on disk */
+BOOST_AUTO_TEST_CASE(header_layouts)
+{
+    for (int poc2x = 0; poc2x < 2; poc2x++) {
+        CBlockHeader header;
+        header.nVersion = -2;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = InsecureRand32();
+        header.nNonce = InsecureRandBits(64);
+        header.genSign = InsecureRand256();
+        header.nPlotID = poc2x ? 0 : InsecureRandBits(63) + 1;
+        header.nPublicKeyID = poc2x ? uint160(std::vector<unsigned char>(20, 0x42)) : uint160();
+        header.nBaseTarget = InsecureRandBits(64);
+        header.nDeadline = InsecureRandBits(64);
+
+        CDataStream expected(SER_NETWORK, PROTOCOL_VERSION);
+        expected << header.nVersion << header.hashPrevBlock << header.hashMerkleRoot << header.nTime << header.nNonce << header.genSign << header.nPlotID;
+        if (poc2x) expected << header.nPublicKeyID;
+        expected << header.nBaseTarget << header.nDeadline;
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << header;
+        BOOST_CHECK_EQUAL(ss.size(), poc2x ? CBlockHeader::MAX_SERIALIZED_SIZE : CBlockHeader::MAX_SERIALIZED_SIZE - 20);
+        BOOST_CHECK(ss.str() == expected.str());
+        BOOST_CHECK(header.GetHash() == Hash(expected.begin(), expected.end()));
+
+        CBlockHeader read;
+        read.nPublicKeyID = uint160(std::vector<unsigned char>(20, 0x01));
+        ss >> read;
+        BOOST_CHECK(ss.empty());
+        BOOST_CHECK(read.GetHash() == header.GetHash());
+        BOOST_CHECK(read.nPublicKeyID == header.nPublicKeyID);
+
+        CBlockIndex index(header);
+        CBlockIndex prev;
+        uint256 hashPrev = header.hashPrevBlock;
+        prev.phashBlock = &hashPrev;
+        index.pprev = &prev;
+        index.nHeight = 7;
+        index.nStatus = BLOCK_HAVE_DATA;
+        const CDiskBlockIndex disk(&index);
+        CDataStream ssDisk(SER_DISK, CLIENT_VERSION);
+        ssDisk << disk;
+        CDiskBlockIndex readDisk;
+        ssDisk >> readDisk;
+        BOOST_CHECK(ssDisk.empty());
+        BOOST_CHECK_EQUAL(readDisk.nHeight, 7);
+        BOOST_CHECK(readDisk.hashPrev == header.hashPrevBlock);
+        BOOST_CHECK(readDisk.GetBlockHash() == header.GetHash());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(publish_deadline_order, TestingSetup)
+{
+    CPOCBlockAssember assember;
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    const int height = tip->nHeight + 1;
+    const CKeyID keyid;
+
+    // A slower caller publishing for an earlier height does not replace the later one.
+    BOOST_CHECK(assember.PublishDeadline(tip, height + 1, keyid, 1, 100, uint256()));
+    BOOST_CHECK(!assember.PublishDeadline(tip, height, keyid, 2, 50, uint256()));
+    BOOST_CHECK_EQUAL(assember.GetBestDeadline(height + 1), 100U);
+    BOOST_CHECK_EQUAL(assember.GetBestDeadline(height), std::numeric_limits<uint64_t>::max());
+
+    // Nor does one verified against a block that is no longer the tip.
+    assember.SetNull();
+    CBlockIndex stale(*tip);
+    BOOST_CHECK(!assember.PublishDeadline(&stale, height, keyid, 3, 50, uint256()));
+    BOOST_CHECK_EQUAL(assember.GetBestDeadline(height), std::numeric_limits<uint64_t>::max());
+    BOOST_CHECK(assember.PublishDeadline(tip, height, keyid, 4, 50, uint256()));
+    BOOST_CHECK_EQUAL(assember.GetBestDeadline(height), 50U);
+}
+
 //BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
 //{
 //    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
@@ -0,0 +1,80 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <support/allocators/pool.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <unordered_map>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_resource_reuse)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    void* a = resource.Allocate(24, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // A freed block is handed out again for the same size, not for another one.
+    resource.Deallocate(a, 24, 8);
+    void* c = resource.Allocate(40, 8);
+    BOOST_CHECK(c != a);
+    BOOST_CHECK_EQUAL(resource.Allocate(24, 8), a);
+
+    // Blocks larger than the pool's come from the heap.
+    void* big = resource.Allocate(65, 8);
+    resource.Deallocate(big, 65, 8);
+    resource.Deallocate(b, 24, 8);
+    resource.Deallocate(c, 40, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // Filling the chunk takes another one.
+    for (int i = 0; i < 1024 / 64; i++) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map)
+{
+    typedef PoolAllocator<std::pair<const int, uint64_t>, 64> Alloc;
+    typedef std::unordered_map<int, uint64_t, std::hash<int>, std::equal_to<int>, Alloc> Map;
+
+    Map map;
+    for (int i = 0; i < 100000; i++) {
+        map[i] = i;
+    }
+    const auto resource = map.get_allocator().resource();
+    const size_t chunks = resource->NumAllocatedChunks();
+    BOOST_CHECK(chunks > 0);
+    BOOST_CHECK(memusage::DynamicUsage(map) >= chunks * resource->ChunkSizeBytes());
+
+    // Erased nodes are reused rather than taking more chunks.
+    for (int i = 0; i < 50000; i++) {
+        map.erase(i);
+    }
+    for (int i = 100000; i < 150000; i++) {
+        map[i] = i;
+    }
+    BOOST_CHECK_EQUAL(resource->NumAllocatedChunks(), chunks);
+
+    // A map moved from shares the pool with the one moved to.
+    Map moved(std::move(map));
+    BOOST_CHECK(moved.get_allocator() == Alloc(resource));
+    BOOST_CHECK_EQUAL(moved.size(), 100000U);
+    BOOST_CHECK_EQUAL(moved.at(149999), 149999U);
+
+    // Another map gets its own.
+    Map other;
+    BOOST_CHECK(other.get_allocator() != moved.get_allocator());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
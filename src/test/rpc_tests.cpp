@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <rpc/server.h>
+#include <rpc/cbor.h>
 #include <rpc/client.h>
 #include <rpc/util.h>
 
@@ -236,6 +237,34 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+static std::string CBORHex(const std::string& json)
+{
+    std::string out;
+    EncodeCBOR(ParseNonRFCJSONValue(json), out);
+    return HexStr(out);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_cbor_encode)
+{
+    // Vectors of RFC 7049 appendix A
+    BOOST_CHECK_EQUAL(CBORHex("0"), "00");
+    BOOST_CHECK_EQUAL(CBORHex("23"), "17");
+    BOOST_CHECK_EQUAL(CBORHex("24"), "1818");
+    BOOST_CHECK_EQUAL(CBORHex("1000"), "1903e8");
+    BOOST_CHECK_EQUAL(CBORHex("1000000"), "1a000f4240");
+    BOOST_CHECK_EQUAL(CBORHex("1000000000000"), "1b000000e8d4a51000");
+    BOOST_CHECK_EQUAL(CBORHex("18446744073709551615"), "1bffffffffffffffff");
+    BOOST_CHECK_EQUAL(CBORHex("-1"), "20");
+    BOOST_CHECK_EQUAL(CBORHex("-1000"), "3903e7");
+    BOOST_CHECK_EQUAL(CBORHex("1.1"), "fb3ff199999999999a");
+    BOOST_CHECK_EQUAL(CBORHex("false"), "f4");
+    BOOST_CHECK_EQUAL(CBORHex("true"), "f5");
+    BOOST_CHECK_EQUAL(CBORHex("null"), "f6");
+    BOOST_CHECK_EQUAL(CBORHex("\"IETF\""), "6449455446");
+    BOOST_CHECK_EQUAL(CBORHex("[1,[2,3],[4,5]]"), "8301820203820405");
+    BOOST_CHECK_EQUAL(CBORHex("{\"a\":1,\"b\":[2,3]}"), "a26161016162820203");
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(std::string("clearbanned")));
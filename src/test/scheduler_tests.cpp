@@ -7,6 +7,8 @@
 
 #include <test/test_bitcoin.h>
 
+#include <atomic>
+
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -155,4 +157,37 @@ BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
     BOOST_CHECK_EQUAL(counter2, 100);
 }
 
+BOOST_AUTO_TEST_CASE(timinglane)
+{
+    CScheduler scheduler;
+    boost::thread_group threads;
+    threads.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    threads.create_thread(std::bind(&CScheduler::serviceTimingQueue, &scheduler));
+
+    // A slow task of the normal lane holds its thread until the timing task ran.
+    std::atomic<bool> fTimingRan(false);
+    std::atomic<bool> fSlowDone(false);
+    scheduler.schedule([&] {
+        for (int i = 0; i < 1000 && !fTimingRan; i++)
+            MicroSleep(1000);
+        fSlowDone = fTimingRan.load();
+    });
+    scheduler.scheduleFromNow([&] { fTimingRan = true; }, 10, SchedulerLane::TIMING);
+
+    scheduler.stop(true);
+    threads.join_all();
+    BOOST_CHECK(fTimingRan);
+    BOOST_CHECK(fSlowDone);
+
+    // Without a timing thread, the threads of serviceQueue run the timing tasks too.
+    CScheduler single;
+    int counter = 0;
+    single.schedule([&] { counter++; }, boost::chrono::system_clock::now(), SchedulerLane::TIMING);
+    single.schedule([&] { counter++; });
+    boost::thread thread(std::bind(&CScheduler::serviceQueue, &single));
+    single.stop(true);
+    thread.join();
+    BOOST_CHECK_EQUAL(counter, 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
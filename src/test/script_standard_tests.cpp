@@ -9,6 +9,7 @@
 #include <script/script_error.h>
 #include <script/standard.h>
 #include <test/test_bitcoin.h>
+#include <ticket.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -732,4 +733,73 @@ BOOST_AUTO_TEST_CASE(script_standard_IsMine)
     }
 }
 
+BOOST_AUTO_TEST_CASE(script_standard_GetOp_span)
+{
+    CScript s;
+    s << OP_RETURN << std::vector<unsigned char>(20, 1) << std::vector<unsigned char>(80, 2) << std::vector<unsigned char>(300, 3) << OP_0 << OP_CHECKSIG;
+    CScript::const_iterator pc = s.begin(), pcSpan = s.begin();
+    opcodetype opcode, opcodeSpan;
+    std::vector<unsigned char> data;
+    Span<const unsigned char> span;
+    while (s.GetOp(pc, opcode, data)) {
+        BOOST_CHECK(s.GetOp(pcSpan, opcodeSpan, span));
+        BOOST_CHECK(pc == pcSpan);
+        BOOST_CHECK_EQUAL(opcode, opcodeSpan);
+        BOOST_CHECK(span == Span<const unsigned char>(data.data(), data.size()));
+    }
+    BOOST_CHECK(!s.GetOp(pcSpan, opcodeSpan, span));
+    BOOST_CHECK_EQUAL(span.size(), 0);
+
+    // A push running past the end of the script fails.
+    CScript truncated(s.begin(), s.begin() + 30);
+    pcSpan = truncated.begin();
+    BOOST_CHECK(truncated.GetOp(pcSpan, opcodeSpan, span));
+    BOOST_CHECK(truncated.GetOp(pcSpan, opcodeSpan, span));
+    BOOST_CHECK_EQUAL(span.size(), 20);
+    BOOST_CHECK(!truncated.GetOp(pcSpan, opcodeSpan, span));
+}
+
+BOOST_AUTO_TEST_CASE(script_standard_ticket_scripts)
+{
+    const CKeyID keyID(uint160(std::vector<unsigned char>(20, 0x5a)));
+    for (int height : {1, 127, 128, 255, 256, 32767, 32768, 8388608, 2147483647}) {
+        const CScript script = GenerateTicketScript(keyID, height);
+        CKeyID keyIDOut;
+        int heightOut = 0;
+        BOOST_CHECK(MatchTicketScript(script, keyIDOut, heightOut));
+        BOOST_CHECK(keyIDOut == keyID);
+        BOOST_CHECK_EQUAL(heightOut, height);
+        BOOST_CHECK(DecodeTicketScript(script, keyIDOut, heightOut));
+        CPubKey pubkey;
+        BOOST_CHECK(GetPublicKeyFromScript(script, pubkey));
+
+        // The redeem script is found in the OP_RETURN output of a purchase.
+        CScript redeemScript;
+        BOOST_CHECK(GetRedeemFromScript(CScript() << OP_RETURN << CTicket::VERSION << ToByteVector(script), redeemScript));
+        BOOST_CHECK(redeemScript == script);
+
+        // Anything else is left to the generic decode, which still takes trailing ops.
+        CScript trailing = script;
+        trailing << OP_NOP;
+        BOOST_CHECK(!MatchTicketScript(trailing, keyIDOut, heightOut));
+        keyIDOut.SetNull();
+        BOOST_CHECK(DecodeTicketScript(trailing, keyIDOut, heightOut));
+        BOOST_CHECK(keyIDOut == keyID);
+        BOOST_CHECK_EQUAL(heightOut, height);
+    }
+
+    // A lock height that is not minimally encoded is not matched, and the decode rejects it as before.
+    CScript nonMinimal;
+    nonMinimal << std::vector<unsigned char>{5, 0} << OP_CHECKLOCKTIMEVERIFY << OP_DROP << OP_DUP << OP_HASH160 << ToByteVector(keyID) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CKeyID keyIDOut;
+    int heightOut;
+    BOOST_CHECK(!MatchTicketScript(nonMinimal, keyIDOut, heightOut));
+    BOOST_CHECK_THROW(DecodeTicketScript(nonMinimal, keyIDOut, heightOut), scriptnum_error);
+    CScript negative;
+    negative << CScriptNum(-5) << OP_CHECKLOCKTIMEVERIFY << OP_DROP << OP_DUP << OP_HASH160 << ToByteVector(keyID) << OP_EQUALVERIFY << OP_CHECKSIG;
+    BOOST_CHECK(!MatchTicketScript(negative, keyIDOut, heightOut));
+    BOOST_CHECK(DecodeTicketScript(negative, keyIDOut, heightOut));
+    BOOST_CHECK_EQUAL(heightOut, -5);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -176,4 +176,22 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(!chain.FindEarliestAtLeast(int64_t(std::numeric_limits<unsigned int>::max()) + 1));
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_arena)
+{
+    CBlockIndexArena arena;
+    CBlockIndex* pindexA = arena.New();
+    CBlockIndex* pindexB = arena.New();
+    BOOST_CHECK(pindexA != pindexB);
+    pindexA->nHeight = 7;
+    pindexA->pprev = pindexB;
+
+    // A freed entry comes back null for the next one.
+    arena.Free(pindexA);
+    CBlockIndex* pindexC = arena.New();
+    BOOST_CHECK(pindexC == pindexA);
+    BOOST_CHECK_EQUAL(pindexC->nHeight, 0);
+    BOOST_CHECK(pindexC->pprev == nullptr);
+    BOOST_CHECK(arena.New() != pindexA);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
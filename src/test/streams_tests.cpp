@@ -113,6 +113,28 @@ BOOST_AUTO_TEST_CASE(streams_vector_reader)
     BOOST_CHECK_THROW(new_reader >> d, std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const unsigned char data[] = {1, 255, 3, 4, 5, 6};
+
+    // Read from the middle of the memory.
+    SpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, Span<const unsigned char>(data + 1, 5));
+    BOOST_CHECK_EQUAL(reader.size(), 5);
+
+    signed char b;
+    reader >> b;
+    BOOST_CHECK_EQUAL(b, -1);
+    BOOST_CHECK_EQUAL(reader.size(), 4);
+
+    unsigned int c;
+    reader >> c;
+    BOOST_CHECK_EQUAL(c, 100992003); // 3,4,5,6 in little-endian base-256
+    BOOST_CHECK(reader.empty());
+
+    // Reading past the end of the span throws an error.
+    BOOST_CHECK_THROW(reader >> b, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
 {
     CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
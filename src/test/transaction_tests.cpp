@@ -54,6 +54,7 @@ static std::map<std::string, unsigned int> mapFlagNames = {
     {std::string("DISCOURAGE_UPGRADABLE_WITNESS_PROGRAM"), (unsigned int)SCRIPT_VERIFY_DISCOURAGE_UPGRADABLE_WITNESS_PROGRAM},
     {std::string("WITNESS_PUBKEYTYPE"), (unsigned int)SCRIPT_VERIFY_WITNESS_PUBKEYTYPE},
     {std::string("CONST_SCRIPTCODE"), (unsigned int)SCRIPT_VERIFY_CONST_SCRIPTCODE},
+    {std::string("SCHNORR"), (unsigned int)SCRIPT_VERIFY_SCHNORR},
 };
 
 unsigned int ParseScriptFlags(std::string strFlags)
@@ -503,6 +504,41 @@ SignatureData CombineSignatures(const CMutableTransaction& input1, const CMutabl
     return sigdata;
 }
 
+BOOST_AUTO_TEST_CASE(test_sign_inputs_parallel)
+{
+    CBasicKeyStore keystore;
+    CMutableTransaction mtx;
+    std::vector<CScript> scriptPubKeys;
+    for (uint32_t i = 0; i < 3 * PARALLEL_SIGN_INPUTS_MIN_COUNT; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        BOOST_CHECK(keystore.AddKey(key));
+        const CKeyID keyid = key.GetPubKey().GetID();
+        scriptPubKeys.push_back(i % 2 ? GetScriptForDestination(WitnessV0KeyHash(keyid)) : GetScriptForDestination(keyid));
+        mtx.vin.emplace_back(COutPoint(InsecureRand256(), i));
+    }
+    mtx.vout.emplace_back(1000, CScript() << OP_1);
+
+    // Signing in parallel with the shared signature hash data gives what signing in turn does.
+    CMutableTransaction serial = mtx;
+    for (size_t i = 0; i < serial.vin.size(); i++) {
+        SignatureData sigdata;
+        BOOST_CHECK(ProduceSignature(keystore, MutableTransactionSignatureCreator(&serial, i, 1000), scriptPubKeys[i], sigdata));
+        UpdateInput(serial.vin[i], sigdata);
+    }
+
+    const PrecomputedTransactionData txdata(mtx, true);
+    std::vector<SignatureData> sigdatas(mtx.vin.size());
+    SignInputsParallel(mtx.vin.size(), [&](size_t i) {
+        ProduceSignature(keystore, MutableTransactionSignatureCreator(&mtx, i, 1000, SIGHASH_ALL, &txdata), scriptPubKeys[i], sigdatas[i]);
+    });
+    for (size_t i = 0; i < mtx.vin.size(); i++) {
+        BOOST_CHECK(sigdatas[i].complete);
+        UpdateInput(mtx.vin[i], sigdatas[i]);
+    }
+    BOOST_CHECK(CTransaction(mtx).GetWitnessHash() == CTransaction(serial).GetWitnessHash());
+}
+
 BOOST_AUTO_TEST_CASE(test_witness)
 {
     CBasicKeyStore keystore, keystore2;
@@ -764,4 +800,56 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(CTransaction(t), reason));
 }
 
+/* Check the hashes of tx read back from bytes are the ones computed from the transaction */
+static void CheckReadHashes(const CMutableTransaction& mtx, const std::vector<unsigned char>& bytes)
+{
+    CDataStream ss(bytes, SER_NETWORK, PROTOCOL_VERSION);
+    const CTransaction tx(deserialize, ss);
+    BOOST_CHECK(ss.empty());
+    const CTransaction expected(mtx);
+    BOOST_CHECK_EQUAL(tx.GetHash(), expected.GetHash());
+    BOOST_CHECK_EQUAL(tx.GetWitnessHash(), expected.GetWitnessHash());
+}
+
+BOOST_AUTO_TEST_CASE(test_read_hashes)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout.n = 1;
+    mtx.vout.emplace_back(5 * CENT, CScript() << OP_TRUE);
+
+    std::vector<unsigned char> bytes;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, bytes, 0, mtx);
+    CheckReadHashes(mtx, bytes);
+
+    mtx.vin[0].scriptWitness.stack.push_back({1, 2, 3});
+    bytes.clear();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, bytes, 0, mtx);
+    CheckReadHashes(mtx, bytes);
+
+    // Confidential, with and without witness or proofs.
+    mtx.nVersion = CTransaction::CONFIDENTIAL_VERSION;
+    mtx.vout[0].flags = 1;
+    mtx.vout[0].nAsset.vchCommitment.assign(CConfidentialAsset::nCommittedSize, 0x0a);
+    mtx.vout[0].nValueCA = CConfidentialValue(5 * CENT);
+    mtx.vout[0].vchRangeproof.assign(100, 0x42);
+    for (int i = 0; i < 3; i++) {
+        bytes.clear();
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, bytes, 0, mtx);
+        CheckReadHashes(mtx, bytes);
+        if (i == 0)
+            mtx.vin[0].scriptWitness.SetNull();
+        else
+            mtx.vout[0].vchRangeproof.clear();
+    }
+
+    // A witness flag with empty witnesses is not how the transaction serializes.
+    mtx = CMutableTransaction();
+    mtx.vin.resize(1);
+    mtx.vout.emplace_back(5 * CENT, CScript() << OP_TRUE);
+    bytes.clear();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, bytes, 0, mtx.nVersion, std::vector<CTxIn>(), (unsigned char)1, mtx.vin, mtx.vout, std::vector<std::vector<unsigned char>>(), mtx.nLockTime);
+    CheckReadHashes(mtx, bytes);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,95 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txreconciliation.h>
+#include <streams.h>
+#include <version.h>
+
+#include <test/test_bitcoin.h>
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sketch_decode)
+{
+    // Two sets sharing 500 ids, with 20 ids only in ours and 15 only in theirs.
+    std::vector<uint32_t> vShared, vOurs, vTheirs;
+    for (int i = 0; i < 500; i++) vShared.push_back(InsecureRand32());
+    for (int i = 0; i < 20; i++) vOurs.push_back(InsecureRand32());
+    for (int i = 0; i < 15; i++) vTheirs.push_back(InsecureRand32());
+
+    const size_t nCells = EstimateSketchCells(vShared.size() + vOurs.size(), vShared.size() + vTheirs.size());
+    CTxReconSketch ours(nCells), theirs(nCells);
+    for (const uint32_t id : vShared) {
+        ours.Add(id);
+        theirs.Add(id);
+    }
+    for (const uint32_t id : vOurs) ours.Add(id);
+    for (const uint32_t id : vTheirs) theirs.Add(id);
+
+    // The sketch survives the trip to the peer.
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << theirs;
+    CTxReconSketch received;
+    stream >> received;
+    BOOST_CHECK(received.IsValid());
+    BOOST_CHECK_EQUAL(received.CellCount(), ours.CellCount());
+
+    BOOST_CHECK(ours.Subtract(received));
+    std::vector<uint32_t> vOnlyOurs, vOnlyTheirs;
+    BOOST_CHECK(ours.Decode(vOnlyOurs, vOnlyTheirs));
+    std::sort(vOurs.begin(), vOurs.end());
+    std::sort(vTheirs.begin(), vTheirs.end());
+    std::sort(vOnlyOurs.begin(), vOnlyOurs.end());
+    std::sort(vOnlyTheirs.begin(), vOnlyTheirs.end());
+    BOOST_CHECK(vOnlyOurs == vOurs);
+    BOOST_CHECK(vOnlyTheirs == vTheirs);
+
+    // A difference far larger than the sketch cannot be listed.
+    CTxReconSketch small(12);
+    for (int i = 0; i < 100; i++) small.Add(InsecureRand32());
+    vOnlyOurs.clear();
+    vOnlyTheirs.clear();
+    BOOST_CHECK(!small.Decode(vOnlyOurs, vOnlyTheirs));
+
+    // Sketches of different sizes cannot be subtracted.
+    BOOST_CHECK(!small.Subtract(received));
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_state)
+{
+    // Both sides of a connection agree on the short ids.
+    TxReconciliationState initiator(true, 1, 2);
+    TxReconciliationState responder(false, 2, 1);
+    const uint256 txid = InsecureRand256();
+    BOOST_CHECK_EQUAL(initiator.GetShortID(txid), responder.GetShortID(txid));
+
+    BOOST_CHECK(initiator.AddToSet(txid));
+    BOOST_CHECK(initiator.AddToSet(txid));
+    initiator.Snapshot();
+    BOOST_CHECK(initiator.mapSet.empty());
+    BOOST_CHECK_EQUAL(initiator.mapSnapshot.size(), 1U);
+
+    // A transaction arriving during a round waits for the next one.
+    const uint256 txid2 = InsecureRand256();
+    BOOST_CHECK(initiator.AddToSet(txid2));
+    BOOST_CHECK(initiator.LookupSnapshot({initiator.GetShortID(txid), initiator.GetShortID(txid2)}) == std::vector<uint256>{txid});
+
+    // An unfinished round is merged into the next one.
+    initiator.Snapshot();
+    BOOST_CHECK_EQUAL(initiator.mapSnapshot.size(), 2U);
+    BOOST_CHECK_EQUAL(initiator.TakeSnapshot().size(), 2U);
+    BOOST_CHECK(initiator.mapSnapshot.empty());
+
+    // A full set floods the transactions beyond it.
+    for (size_t i = 0; i < MAX_RECON_SET_SIZE; i++) {
+        initiator.AddToSet(InsecureRand256());
+    }
+    BOOST_CHECK(!initiator.AddToSet(InsecureRand256()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1245,4 +1245,18 @@ BOOST_AUTO_TEST_CASE(test_Capitalize)
     BOOST_CHECK_EQUAL(Capitalize("\x00\xfe\xff"), "\x00\xfe\xff");
 }
 
+BOOST_AUTO_TEST_CASE(test_ParseCPUList)
+{
+    std::vector<int> cpus;
+    BOOST_CHECK(ParseCPUList("3", cpus));
+    BOOST_CHECK(cpus == std::vector<int>({3}));
+    BOOST_CHECK(ParseCPUList("0-3,8,10-11", cpus));
+    BOOST_CHECK(cpus == std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    BOOST_CHECK(!ParseCPUList("", cpus));
+    BOOST_CHECK(!ParseCPUList("3-1", cpus));
+    BOOST_CHECK(!ParseCPUList("-1", cpus));
+    BOOST_CHECK(!ParseCPUList("1,,2", cpus));
+    BOOST_CHECK(!ParseCPUList("a-b", cpus));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
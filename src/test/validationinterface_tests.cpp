@@ -0,0 +1,73 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationinterface.h>
+
+#include <test/test_bitcoin.h>
+
+#include <atomic>
+#include <future>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
+
+/** Counts the tips it is told of, each after waiting for its gate to open. */
+class GatedSubscriber : public CValidationInterface
+{
+public:
+    std::shared_future<void> gate;
+    std::atomic<int> nTips{0};
+    std::atomic<bool> fOutOfOrder{false};
+
+    explicit GatedSubscriber(std::shared_future<void> gateIn) : gate(gateIn) {}
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override
+    {
+        gate.wait();
+        // The tips are numbered by the fork pointer, so each must follow the one before.
+        if ((intptr_t)pindexFork != nTips + 1) fOutOfOrder = true;
+        nTips++;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(subscribers_run_side_by_side)
+{
+    // A second thread, so a subscriber blocked in its callback leaves one to run the others.
+    threadGroup.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+
+    std::promise<void> blocked;
+    std::promise<void> open;
+    open.set_value();
+    GatedSubscriber slow(blocked.get_future().share());
+    GatedSubscriber fast(open.get_future().share());
+    RegisterValidationInterface(&slow, "slow");
+    RegisterValidationInterface(&fast, "fast");
+
+    for (intptr_t i = 1; i <= 100; i++) {
+        GetMainSignals().UpdatedBlockTip(nullptr, (const CBlockIndex*)i, false);
+    }
+    // The fast subscriber catches up while the slow one is stuck in its first callback.
+    for (int n = 0; n < 1000 && fast.nTips < 100; n++) {
+        MilliSleep(10);
+    }
+    BOOST_CHECK_EQUAL(fast.nTips, 100);
+    BOOST_CHECK_EQUAL(slow.nTips, 0);
+    BOOST_CHECK(GetMainSignals().CallbacksPending() >= 99);
+
+    // Waiting on the queue waits for every subscriber.
+    blocked.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(slow.nTips, 100);
+    BOOST_CHECK(!slow.fOutOfOrder);
+    BOOST_CHECK(!fast.fOutOfOrder);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0U);
+
+    UnregisterValidationInterface(&slow);
+    UnregisterValidationInterface(&fast);
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <key.h>
 #include <logging.h>
 
+#include <set>
 #include <vector>
 
 using namespace std;
@@ -18,8 +19,44 @@ CScript GenerateTicketScript(const CKeyID keyid, const int lockHeight)
     return std::move(script);
 }
 
-bool DecodeTicketScript(const CScript redeemScript, CKeyID& keyID, int &lockHeight)
+/** Decode a minimally encoded positive script number of up to 4 bytes, which CScriptNum reads the same. */
+static bool DecodePositiveScriptNum(const unsigned char* p, size_t size, int& n)
 {
+    // The top bit of the last byte is the sign, and only it may make a zero last byte necessary.
+    if (size == 0 || size > 4 || (p[size - 1] & 0x80))
+        return false;
+    if ((p[size - 1] & 0x7f) == 0 && (size == 1 || !(p[size - 2] & 0x80)))
+        return false;
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value |= (uint32_t)p[i] << (8 * i);
+    }
+    n = (int)value;
+    return true;
+}
+
+bool MatchTicketScript(const CScript& script, CKeyID& keyID, int& lockHeight)
+{
+    if (script.empty())
+        return false;
+    const size_t n = script[0];
+    if (n < 1 || n > 4 || script.size() != n + 28)
+        return false;
+    const unsigned char* p = script.data() + 1 + n;
+    if (p[0] != OP_CHECKLOCKTIMEVERIFY || p[1] != OP_DROP || p[2] != OP_DUP || p[3] != OP_HASH160 ||
+        p[4] != 20 || p[25] != OP_EQUALVERIFY || p[26] != OP_CHECKSIG)
+        return false;
+    if (!DecodePositiveScriptNum(script.data() + 1, n, lockHeight))
+        return false;
+    memcpy(keyID.begin(), p + 5, 20);
+    return true;
+}
+
+bool DecodeTicketScript(const CScript& redeemScript, CKeyID& keyID, int &lockHeight)
+{
+    if (MatchTicketScript(redeemScript, keyID, lockHeight))
+        return true;
+
     CScriptBase::const_iterator pc = redeemScript.begin();
     opcodetype opcodeRet;
     vector<unsigned char> vchRet;
@@ -39,8 +76,13 @@ bool DecodeTicketScript(const CScript redeemScript, CKeyID& keyID, int &lockHeig
     return false;
 }
 
-bool GetPublicKeyFromScript(const CScript script, CPubKey &pubkey)
+bool GetPublicKeyFromScript(const CScript& script, CPubKey &pubkey)
 {
+    CKeyID keyID;
+    int lockHeight;
+    if (MatchTicketScript(script, keyID, lockHeight))
+        return true;
+
     CScriptBase::const_iterator pc = script.begin();
     opcodetype opcodeRet;
     vector<unsigned char> vchRet;
@@ -71,8 +113,15 @@ bool GetPublicKeyFromScript(const CScript script, CPubKey &pubkey)
     return false;
 }
 
-bool GetRedeemFromScript(const CScript script, CScript& redeemscript)
+bool GetRedeemFromScript(const CScript& script, CScript& redeemscript)
 {
+	// OP_RETURN <CTicket::VERSION> <redeemScript>, as the wallet makes it
+	if (script.size() >= 3 && script[0] == OP_RETURN && script[1] == OP_1 && script[2] < OP_PUSHDATA1 &&
+		script.size() == 3u + script[2]) {
+		redeemscript = CScript(script.begin() + 3, script.end());
+		return true;
+	}
+
 	CScriptBase::const_iterator pc = script.begin();
 	opcodetype opcodeRet;
 	vector<unsigned char> vchRet;
@@ -90,44 +139,37 @@ bool GetRedeemFromScript(const CScript script, CScript& redeemscript)
 }
 
 CTicket::CTicket(const COutPoint& out, const CAmount nValue, const CScript& redeemScript, const CScript &scriptPubkey)
-    :out(new COutPoint(out)), redeemScript(redeemScript), scriptPubkey(scriptPubkey), nValue(nValue)
+    :out(out), nValue(nValue), redeemScript(redeemScript), scriptPubkey(scriptPubkey)
 {
-	CScriptBase::const_iterator pc = scriptPubkey.begin();
-	opcodetype opcodeRet;
-	vector<unsigned char> vchRet;
 	CScriptID scriptID;
-	if (scriptPubkey.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_HASH160) {
-		vchRet.clear();
-		if (scriptPubkey.GetOp(pc, opcodeRet, vchRet)) {
-			scriptID = CScriptID(uint160(vchRet));
+	if (scriptPubkey.IsPayToScriptHash()) {
+		memcpy(scriptID.begin(), scriptPubkey.data() + 2, 20);
+	} else {
+		CScriptBase::const_iterator pc = scriptPubkey.begin();
+		opcodetype opcodeRet;
+		vector<unsigned char> vchRet;
+		if (scriptPubkey.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_HASH160) {
+			vchRet.clear();
+			if (scriptPubkey.GetOp(pc, opcodeRet, vchRet)) {
+				scriptID = CScriptID(uint160(vchRet));
+			}
 		}
 	}
 	// check the redeemScript and scriptPubkey, if unmatch throw
 	if (scriptID!=CScriptID(redeemScript))
 		throw error("error: unmatched redeemScript and scriptPubkey!");
+	parse();
 }
 
-CTicket::CTicket(const CTicket& other) : out(new COutPoint(*(other.out)))
-{
-    nValue = other.nValue;
-    redeemScript = other.redeemScript;
-    scriptPubkey = other.scriptPubkey;
-}
-
-CTicket::CTicket():out(new COutPoint) {
-
-}
-
-CTicket::~CTicket()
+CTicket::CTicket() : nValue(0), lockTime(0), invalid(true)
 {
-    if (out) delete out;
 }
 
 template <typename Stream>
 void CTicket::Serialize(Stream& s) const
 {
-    s << out->hash;
-    s << out->n;
+    s << out.hash;
+    s << out.n;
     s << nValue;
     s << redeemScript;
     s << scriptPubkey;
@@ -136,11 +178,49 @@ void CTicket::Serialize(Stream& s) const
 template <typename Stream>
 void CTicket::Unserialize(Stream& s) 
 {
-    s >> out->hash;
-    s >> out->n;
+    s >> out.hash;
+    s >> out.n;
     s >> nValue;
     s >> redeemScript;
     s >> scriptPubkey;
+    parse();
+}
+
+void CTicket::parse()
+{
+	lockTime = 0;
+	keyID = CKeyID();
+	invalid = true;
+	if (MatchTicketScript(redeemScript, keyID, lockTime)) {
+		// The decodes below find nothing more in a script of this shape.
+		return;
+	}
+	try {
+		CScriptBase::const_iterator pc = redeemScript.begin();
+		opcodetype opcodeRet;
+		vector<unsigned char> vchRet;
+		if (redeemScript.GetOp(pc, opcodeRet, vchRet) && CScriptNum(vchRet,true)> 0) {
+			lockTime = CScriptNum(vchRet, false).getint();
+		}
+
+		int lockHeight = 0;
+		DecodeTicketScript(redeemScript, keyID, lockHeight);
+
+		pc = redeemScript.begin();
+		if (redeemScript.GetOp(pc, opcodeRet, vchRet) && CScriptNum(vchRet,true)> 0) {
+			if (redeemScript.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_CHECKLOCKTIMEVERIFY) {
+				if (redeemScript.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_DROP) {
+					if (redeemScript.GetOp(pc, opcodeRet, vchRet) && vchRet.size() == 33) {
+						if (redeemScript.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_CHECKSIG) {
+							invalid = false;
+						}
+					}
+				}
+			}
+		}
+	} catch (const scriptnum_error&) {
+		// a lock height out of range leaves the firestone unparsed.
+	}
 }
 
 CTicket::CTicketState CTicket::State(int activeHeight) const
@@ -158,112 +238,251 @@ CTicket::CTicketState CTicket::State(int activeHeight) const
 	return CTicketState::UNKNOW;
 }
 
-int CTicket::LockTime() const
-{
-	CScriptBase::const_iterator pc = redeemScript.begin();
-	opcodetype opcodeRet;
-	vector<unsigned char> vchRet;
-	if (redeemScript.GetOp(pc, opcodeRet, vchRet) && CScriptNum(vchRet,true)> 0) {
-		auto height = CScriptNum(vchRet, false).getint();
-		return height;
-	}
-	return 0;
-}
-
-CKeyID CTicket::KeyID() const
-{
-    CKeyID keyID;
-    int lockHeight = 0;
-    DecodeTicketScript(redeemScript, keyID, lockHeight);
-    return keyID;
-}
-
-bool CTicket::Invalid() const 
-{
-	CScriptBase::const_iterator pc = redeemScript.begin();
-	opcodetype opcodeRet;
-	vector<unsigned char> vchRet;
-	if (redeemScript.GetOp(pc, opcodeRet, vchRet) && CScriptNum(vchRet,true)> 0) {
-		vchRet.clear();
-		if (redeemScript.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_CHECKLOCKTIMEVERIFY) {
-			vchRet.clear();
-			if (redeemScript.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_DROP) {
-				vchRet.clear();
-				if (redeemScript.GetOp(pc, opcodeRet, vchRet) && vchRet.size() == 33) {
-					vchRet.clear();
-					if (redeemScript.GetOp(pc, opcodeRet, vchRet) && opcodeRet == OP_CHECKSIG) {
-						return false;
-					}   
-				}
-			}
-		}
-	}
-	return true;
-}
-
 CAmount CTicketView::BaseTicketPrice = 3000 * COIN;
 static const char DB_TICKET_SYNCED_KEY = 'S';
 static const char DB_TICKET_SLOT_KEY = 'L';
 static const char DB_TICKET_ADDR_KEY = 'A';
 static const char DB_TICKET_HEIGHT_KEY = 'H';
+static const char DB_TICKET_COMPACTED_KEY = 'C';
+static const char DB_TICKET_PAGED_KEY = 'P';
 
-void CTicketView::ConnectBlock(const int height, const CBlock &blk, CheckTicketFunc checkTicket)
+void CTicketView::ConnectBlock(const int height, const CBlock &blk, CheckTicketFunc checkTicket, std::vector<CTicketRef>* connected)
+{
+    std::vector<CTicketRef> candidates;
+    for (const auto& tx : blk.vtx) {
+        if (tx->IsTicketTx())
+            candidates.push_back(tx->Ticket());
+    }
+    ConnectBlock(height, candidates, checkTicket, connected);
+}
+
+void CTicketView::ConnectBlock(const int height, const std::vector<CTicketRef>& candidates, CheckTicketFunc checkTicket, std::vector<CTicketRef>* connected)
 {
     LogPrint(BCLog::FIRESTONE, "%s: height:%d\n", __func__, height);
+    LOCK(cs);
+    auto prevSlotIndex = slotIndex;
     updateTicketPrice(height);
-    std::vector<CTicket> tickets;
-    for (auto tx : blk.vtx) {        
-        if (!tx->IsTicketTx())
-            continue;
-        auto ticket = tx->Ticket();
+    std::vector<CTicketRef> tickets;
+    tickets.reserve(candidates.size());
+    for (const auto& ticket : candidates) {
         if( !checkTicket(height, ticket)) {
-            LogPrint(BCLog::FIRESTONE, "%s: CheckTicket failure, hash:%s:%d\n", __func__, ticket->out->hash.ToString(), ticket->out->n);
+            LogPrint(BCLog::FIRESTONE, "%s: CheckTicket failure, hash:%s:%d\n", __func__, ticket->out.hash.ToString(), ticket->out.n);
             continue;
         }
-        tickets.emplace_back(*ticket);
-        ticketsInSlot[slotIndex].emplace_back(ticket);
-        ticketsInAddr[ticket->KeyID()].emplace_back(ticket);
-        LogPrint(BCLog::FIRESTONE, "%s: detected a new firestone, height:%d, hash:%s:%d\n", __func__, height, ticket->out->hash.ToString(), ticket->out->n);
-    } 
-    if (tickets.size() > 0) {
-        if (!WriteTicketsToDisk(height, tickets)) {
-            LogPrint(BCLog::FIRESTONE, "%s: WriteTicketsToDisk retrun false, height:%d\n", __func__, height);
-        }
+        tickets.push_back(ticket);
+        addTicket(slotIndex, ticket);
+        if (connected)
+            connected->push_back(ticket);
+        LogPrint(BCLog::FIRESTONE, "%s: detected a new firestone, height:%d, hash:%s:%d\n", __func__, height, ticket->out.hash.ToString(), ticket->out.n);
+    }
+
+    if (slotIndex != prevSlotIndex) {
+        // The previous slot is closed, keep its summary so startup does not replay its heights.
+        writeSlot(prevSlotIndex);
+        compactSlots();
     }
+    // An empty record erases one left above the flushed tip by an unclean shutdown.
+    writeHeight(height, tickets);
+    Write(DB_TICKET_SYNCED_KEY, height);
 }
 
 void CTicketView::DisconnectBlock(const int height, const CBlock &blk)
 {
     LogPrint(BCLog::FIRESTONE, "%s: height:%d, block:%s\n", __func__, height, blk.GetHash().ToString());
+    LOCK(cs);
+    // Only the firestones of this block are undone, they are the last ones connected.
+    auto removeTicket = [](std::vector<CTicketRef>& refs, const COutPoint& out) {
+        for (auto it = refs.rbegin(); it != refs.rend(); ++it) {
+            if ((*it)->out == out) {
+                refs.erase(std::next(it).base());
+                return;
+            }
+        }
+    };
+    size_t nRemoved = 0;
+    for (auto& tx : blk.vtx) {
+        if (!tx->IsTicketTx() || !GetTicket(slotIndex, tx->Ticket()->out))
+            continue;
+        auto out = tx->Ticket()->out;
+        auto keyID = tx->Ticket()->KeyID();
+        ticketsByOut.erase(out.hash);
+        removeTicket(ticketsInSlot[slotIndex], out);
+        removeTicket(ticketsInAddr[keyID], out);
+        if (ticketsInAddr[keyID].empty())
+            ticketsInAddr.erase(keyID);
+        nRemoved++;
+    }
+
+    const auto firstHeight = slotIndex * SlotLength();
     auto key = std::make_pair(DB_TICKET_HEIGHT_KEY, height);
-    Erase(key, true);
-    ticketsInSlot.clear();
-    ticketsInAddr.clear();
-    slotIndex = 0;
-    ticketPrice = BaseTicketPrice;
-    for (auto i = 0; i < height; i++) {
-        LoadTicketFromDisk(i);
+    if (Exists(key)) {
+        Erase(key);
+    } else if (nRemoved > 0 && height != firstHeight) {
+        // The slot was opened again by a disconnect, its older firestones share one record.
+        writeHeight(firstHeight, ticketsInSlot[slotIndex]);
     }
+
+    // This height opened the current slot, rewind to the previous slot and its price.
+    if (height % SlotLength() == 0 && height != 0 && slotIndex == height / SlotLength()) {
+        ticketsInSlot.erase(slotIndex);
+        slotTable.pop_back();
+        slotIndex--;
+        ticketPrice = slotTable[slotIndex].price;
+        // The previous slot is open again, its summary is rewritten when it closes.
+        Erase(std::make_pair(DB_TICKET_SLOT_KEY, slotIndex));
+        // Its per-height records may be compacted already, so its firestones are kept in one
+        // record at its first height, which a restart replays as the open slot.
+        const auto reopenedHeight = slotIndex * SlotLength();
+        for (auto i = reopenedHeight; i < height; i++) {
+            Erase(std::make_pair(DB_TICKET_HEIGHT_KEY, i));
+        }
+        writeHeight(reopenedHeight, ticketsInSlot[slotIndex]);
+        // The firestones of the slot before are used again by the blocks of this one.
+        if (slotIndex > 0 && !ticketsInSlot.count(slotIndex - 1) && !restoreSlot(slotIndex - 1)) {
+            LogPrintf("%s: failed to restore the firestones of slot %d\n", __func__, slotIndex - 1);
+        }
+        LogPrint(BCLog::FIRESTONE, "%s: rewind ticket slot, index:%d, price:%d\n", __func__, slotIndex, ticketPrice);
+    }
+    Write(DB_TICKET_SYNCED_KEY, height - 1);
 }
 
 CAmount CTicketView::CurrentTicketPrice() const
 {
+    LOCK(cs);
     return ticketPrice;
 }
 
-std::vector<CTicketRef> CTicketView::CurrentSlotTicket()
+static const std::vector<CTicketRef> noTickets;
+
+std::vector<CTicketRef> CTicketView::CurrentSlotTicket() const
+{
+    LOCK(cs);
+    return GetTicketsBySlotIndex(slotIndex);
+}
+
+std::vector<CTicketRef> CTicketView::GetTicketsBySlotIndex(const int slotIndex) const
+{
+    LOCK(cs);
+    auto it = ticketsInSlot.find(slotIndex);
+    return it != ticketsInSlot.end() ? it->second : noTickets;
+}
+
+std::vector<CTicketRef> CTicketView::FindeTickets(const CKeyID key) const
+{
+    LOCK(cs);
+    auto it = ticketsInAddr.find(key);
+    return readOwner(key, it != ticketsInAddr.end() ? &it->second : nullptr);
+}
+
+std::map<CKeyID, std::vector<CTicketRef>> CTicketView::TicketsByAddress()
+{
+    LOCK(cs);
+    std::set<CKeyID> paged;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_TICKET_ADDR_KEY, CKeyID()));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, CKeyID> key;
+        if (!pcursor->GetKey(key) || key.first != DB_TICKET_ADDR_KEY)
+            break;
+        paged.insert(key.second);
+    }
+    for (auto& key : PendingKeys<std::pair<char, CKeyID>>(DB_TICKET_ADDR_KEY)) {
+        paged.insert(key.second);
+    }
+
+    std::map<CKeyID, std::vector<CTicketRef>> tickets;
+    for (auto& key : paged) {
+        auto it = ticketsInAddr.find(key);
+        tickets[key] = readOwner(key, it != ticketsInAddr.end() ? &it->second : nullptr);
+    }
+    for (auto& owner : ticketsInAddr) {
+        if (!tickets.count(owner.first))
+            tickets[owner.first] = owner.second;
+    }
+    return tickets;
+}
+
+std::vector<CTicketRef> CTicketView::readOwner(const CKeyID& key, const std::vector<CTicketRef>* refs) const
 {
-    return ticketsInSlot[slotIndex];
+    std::vector<CTicket> paged;
+    if (!Read(std::make_pair(DB_TICKET_ADDR_KEY, key), paged))
+        return refs ? *refs : noTickets;
+
+    std::vector<CTicketRef> tickets;
+    std::set<COutPoint> outs;
+    tickets.reserve(paged.size() + (refs ? refs->size() : 0));
+    for (auto& ticket : paged) {
+        outs.insert(ticket.out);
+        tickets.emplace_back(std::make_shared<const CTicket>(ticket));
+    }
+    // A snapshot published before its slots were paged holds some of them still.
+    if (refs) {
+        for (auto& ticket : *refs) {
+            if (!outs.count(ticket->out))
+                tickets.emplace_back(ticket);
+        }
+    }
+    return tickets;
 }
 
-std::vector<CTicketRef> CTicketView::GetTicketsBySlotIndex(const int slotIndex) 
+const std::vector<CTicketRef>& CTicketSnapshot::GetTicketsBySlotIndex(const int index) const
 {
-    return ticketsInSlot[slotIndex];
+    auto it = ticketsInSlot.find(index);
+    return it != ticketsInSlot.end() ? it->second : noTickets;
+}
+
+std::vector<CTicketRef> CTicketSnapshot::FindeTickets(const CKeyID& key) const
+{
+    auto it = ticketsInAddr.find(key);
+    const std::vector<CTicketRef>* refs = it != ticketsInAddr.end() ? &it->second : nullptr;
+    if (!view)
+        return refs ? *refs : noTickets;
+    return view->readOwner(key, refs);
+}
+
+std::vector<CTicketRef> CTicketView::ListTicketsInSlot(const int slotIndex) const
+{
+    LOCK(cs);
+    auto it = ticketsInSlot.find(slotIndex);
+    if (it != ticketsInSlot.end() || slotIndex >= this->slotIndex)
+        return GetTicketsBySlotIndex(slotIndex);
+
+    std::vector<CTicketRef> refs;
+    std::pair<CAmount, std::vector<CTicket>> slot;
+    if (!Read(std::make_pair(DB_TICKET_SLOT_KEY, slotIndex), slot)) {
+        LogPrint(BCLog::FIRESTONE, "%s: missing slot summary, index:%d\n", __func__, slotIndex);
+        return refs;
+    }
+    refs.reserve(slot.second.size());
+    for (auto& ticket : slot.second) {
+        refs.emplace_back(std::make_shared<const CTicket>(ticket));
+    }
+    return refs;
 }
 
-std::vector<CTicketRef> CTicketView::FindeTickets(const CKeyID key)
+size_t CTicketView::TicketCountInSlot(const int slotIndex) const
 {
-    return ticketsInAddr[key];
+    LOCK(cs);
+    if (slotIndex >= 0 && slotIndex < this->slotIndex)
+        return slotTable[slotIndex].count;
+    auto it = ticketsInSlot.find(slotIndex);
+    return it != ticketsInSlot.end() ? it->second.size() : 0;
+}
+
+CTicketRef CTicketView::GetTicket(const int slotIndex, const COutPoint& out) const
+{
+    LOCK(cs);
+    auto it = ticketsByOut.find(out.hash);
+    if (it == ticketsByOut.end() || it->second.first != slotIndex || it->second.second->out != out)
+        return nullptr;
+    return it->second.second;
+}
+
+void CTicketView::addTicket(const int index, const CTicketRef& ticket)
+{
+    ticketsInSlot[index].emplace_back(ticket);
+    ticketsInAddr[ticket->KeyID()].emplace_back(ticket);
+    ticketsByOut[ticket->out.hash] = std::make_pair(index, ticket);
 }
 
 int CTicketView::SlotLength() const
@@ -274,6 +493,7 @@ int CTicketView::SlotLength() const
 
 int CTicketView::LockTime() const
 {
+    LOCK(cs);
     return (slotIndex + 1) * SlotLength() - 1;
 }
 
@@ -283,19 +503,250 @@ int CTicketView::LockTime(const int index) const
 }
 
 CTicketView::CTicketView(size_t nCacheSize, bool fMemory, bool fWipe) 
-    :CDBWrapper(GetDataDir() / "ticket", nCacheSize, fMemory, fWipe),
+    :CDBBufferedWrapper(GetDataDir() / "ticket", nCacheSize, fMemory, fWipe),
+    pagedSlots(0),
+    nRetainedSlots(DEFAULT_FIRESTONE_SLOTS),
     ticketPrice(BaseTicketPrice),
     slotIndex(0) 
 {
+    slotTable.emplace_back(BaseTicketPrice);
+    PublishSnapshot();
+}
+
+void CTicketView::PublishSnapshot()
+{
+    auto next = std::make_shared<CTicketSnapshot>();
+    LOCK(cs);
+    next->view = this;
+    next->slotIndex = slotIndex;
+    next->slotLength = SlotLength();
+    next->ticketPrice = ticketPrice;
+    next->slotPrices.reserve(slotTable.size());
+    next->slotCounts.reserve(slotTable.size());
+    for (const auto& entry : slotTable) {
+        next->slotPrices.push_back(entry.price);
+        next->slotCounts.push_back(entry.count);
+    }
+    next->ticketsInSlot = ticketsInSlot;
+    next->ticketsInAddr = ticketsInAddr;
+    std::atomic_store(&snapshot, CTicketSnapshotRef(std::move(next)));
+}
+
+int CTicketSnapshot::LockTime(const int index) const
+{
+    return std::max((index + 1) * slotLength - 1, slotLength - 1);
+}
+
+CAmount CTicketSnapshot::TicketPriceInSlot(const int index) const
+{
+    // Slot 0 is at the base price, as are slots not opened yet.
+    return index >= 0 && index < (int)slotPrices.size() ? slotPrices[index] : slotPrices.front();
+}
+
+size_t CTicketSnapshot::TicketCountInSlot(const int index) const
+{
+    if (index >= 0 && index < slotIndex)
+        return slotCounts[index];
+    return GetTicketsBySlotIndex(index).size();
+}
+
+void CTicketView::writeSlot(const int index)
+{
+    std::vector<CTicket> tickets;
+    auto& refs = ticketsInSlot[index];
+    tickets.reserve(refs.size());
+    for (auto& ticket : refs) {
+        tickets.emplace_back(*ticket);
+    }
+    Write(std::make_pair(DB_TICKET_SLOT_KEY, index), std::make_pair(slotTable[index].price, tickets));
+}
+
+void CTicketView::writeHeight(const int height, const std::vector<CTicketRef>& refs)
+{
+    auto key = std::make_pair(DB_TICKET_HEIGHT_KEY, height);
+    if (refs.empty()) {
+        Erase(key);
+        return;
+    }
+    // The references serialize as the vector of firestones LoadTicketFromDisk reads, without copying them.
+    Write(key, refs);
+}
+
+void CTicketView::SetRetainedSlots(const int nSlots)
+{
+    LOCK(cs);
+    nRetainedSlots = std::max(nSlots, MIN_FIRESTONE_SLOTS);
+}
+
+void CTicketView::compactSlots()
+{
+    const auto firstRetained = slotIndex - nRetainedSlots + 1;
+    for (auto it = ticketsInSlot.begin(); it != ticketsInSlot.end() && it->first < firstRetained;) {
+        for (auto& ticket : it->second) {
+            ticketsByOut.erase(ticket->out.hash);
+        }
+        it = ticketsInSlot.erase(it);
+    }
+    pageOwners(firstRetained);
+    const auto compactedHeight = (slotIndex - 1) * SlotLength();
+    if (compactedHeight > 0) {
+        eraseHeightsBelow(compactedHeight);
+        Write(DB_TICKET_COMPACTED_KEY, compactedHeight);
+    }
+}
+
+void CTicketView::pageOwners(const int index)
+{
+    if (index <= pagedSlots)
+        return;
+    // A firestone bought in a slot is locked to its end, see TestTicket.
+    const auto lockTime = LockTime(index);
+    size_t nPaged = 0;
+    for (auto it = ticketsInAddr.begin(); it != ticketsInAddr.end();) {
+        std::vector<CTicketRef> kept;
+        std::vector<CTicket> paged;
+        for (auto& ticket : it->second) {
+            if (ticket->LockTime() < lockTime) {
+                paged.emplace_back(*ticket);
+            } else {
+                kept.emplace_back(ticket);
+            }
+        }
+        if (!paged.empty()) {
+            auto key = std::make_pair(DB_TICKET_ADDR_KEY, it->first);
+            std::vector<CTicket> record;
+            Read(key, record);
+            // A replay of the heights indexes the owners again, a firestone is only paged once.
+            std::set<COutPoint> outs;
+            for (auto& ticket : record) {
+                outs.insert(ticket.out);
+            }
+            for (auto& ticket : paged) {
+                if (outs.insert(ticket.out).second)
+                    record.emplace_back(std::move(ticket));
+            }
+            Write(key, record);
+            nPaged += paged.size();
+            it->second.swap(kept);
+        }
+        it = it->second.empty() ? ticketsInAddr.erase(it) : std::next(it);
+    }
+    pagedSlots = index;
+    Write(DB_TICKET_PAGED_KEY, pagedSlots);
+    LogPrint(BCLog::FIRESTONE, "%s: paged %u firestones of the slots below %d to their owners\n", __func__, nPaged, index);
+}
+
+bool CTicketView::HeightsCompacted() const
+{
+    return Exists(DB_TICKET_COMPACTED_KEY);
+}
+
+void CTicketView::eraseHeightsBelow(const int height)
+{
+    // Once compacted, only the records of the last slots are left to visit.
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_TICKET_HEIGHT_KEY, 0));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        std::pair<char, int> key;
+        if (!pcursor->GetKey(key) || key.first != DB_TICKET_HEIGHT_KEY)
+            break;
+        if (key.second < height)
+            Erase(key);
+    }
+}
+
+bool CTicketView::restoreSlot(const int index)
+{
+    std::pair<CAmount, std::vector<CTicket>> slot;
+    if (!Read(std::make_pair(DB_TICKET_SLOT_KEY, index), slot))
+        return false;
+    // The owners still list these firestones, only the slot and the outpoints are indexed again.
+    auto& refs = ticketsInSlot[index];
+    refs.reserve(slot.second.size());
+    for (auto& ticket : slot.second) {
+        auto ref = std::make_shared<const CTicket>(ticket);
+        refs.emplace_back(ref);
+        ticketsByOut[ref->out.hash] = std::make_pair(index, ref);
+    }
+    return true;
+}
+
+void CTicketView::reset()
+{
+    ticketsInSlot.clear();
+    ticketsInAddr.clear();
+    ticketsByOut.clear();
+    pagedSlots = 0;
+    slotTable.assign(1, SlotEntry(BaseTicketPrice));
+    slotIndex = 0;
+    ticketPrice = BaseTicketPrice;
 }
 
-bool CTicketView::WriteTicketsToDisk(const int height, const std::vector<CTicket> &tickets)
+void CTicketView::WriteSlotsToDisk(const int height)
 {
-    return Write(std::make_pair(DB_TICKET_HEIGHT_KEY, height), tickets);
+    LOCK(cs);
+    for (auto i = 0; i < slotIndex; i++) {
+        writeSlot(i);
+    }
+    compactSlots();
+    Write(DB_TICKET_SYNCED_KEY, height);
+}
+
+bool CTicketView::LoadSlotsFromDisk(const int height, const bool fAhead)
+{
+    // Flushed ahead, the per-height records of the open slot are only left if no slot after the next one was opened.
+    int synced = -1;
+    if (height < 0 || !Read(DB_TICKET_SYNCED_KEY, synced) || synced < height || (synced != height && !fAhead)
+        || synced / SlotLength() > height / SlotLength() + 1) {
+        LogPrint(BCLog::FIRESTONE, "%s: firestone database is not synced to height:%d\n", __func__, height);
+        return false;
+    }
+
+    LOCK(cs);
+    reset();
+    Read(DB_TICKET_PAGED_KEY, pagedSlots);
+    auto tipSlotIndex = height / SlotLength();
+    const auto firstRetained = tipSlotIndex - nRetainedSlots + 1;
+    for (auto i = 0; i < tipSlotIndex; i++) {
+        std::pair<CAmount, std::vector<CTicket>> slot;
+        if (!Read(std::make_pair(DB_TICKET_SLOT_KEY, i), slot)) {
+            LogPrint(BCLog::FIRESTONE, "%s: missing slot summary, index:%d\n", __func__, i);
+            reset();
+            return false;
+        }
+        slotTable.resize(i + 1);
+        slotTable[i] = SlotEntry(slot.first, slot.second.size());
+        if (i < firstRetained) {
+            // Only the owners of the firestones of older slots are indexed, unless paged already.
+            for (auto& ticket : slot.second) {
+                if (i >= pagedSlots)
+                    ticketsInAddr[ticket.KeyID()].emplace_back(std::make_shared<const CTicket>(ticket));
+            }
+        } else {
+            ticketsInSlot[i].reserve(slot.second.size());
+            for (auto& ticket : slot.second) {
+                addTicket(i, std::make_shared<const CTicket>(ticket));
+            }
+        }
+        slotIndex = i;
+        ticketPrice = slot.first;
+    }
+
+    // Only the open slot is replayed height by height.
+    for (auto i = tipSlotIndex * SlotLength(); i <= height; i++) {
+        if (!LoadTicketFromDisk(i)) {
+            reset();
+            return false;
+        }
+    }
+    // A database written before the owners were paged, or a smaller retention, pages them now.
+    pageOwners(firstRetained);
+    return true;
 }
 
 bool CTicketView::LoadTicketFromDisk(const int height)
 {
+    LOCK(cs);
     updateTicketPrice(height);
     auto key = std::make_pair(DB_TICKET_HEIGHT_KEY, height);
     if (Exists(key)) {
@@ -307,40 +758,35 @@ bool CTicketView::LoadTicketFromDisk(const int height)
         for (auto ticket : tickets) {
             CTicketRef t;
             t.reset(new CTicket(ticket));
-            ticketsInSlot[slotIndex].emplace_back(t);
-            ticketsInAddr[ticket.KeyID()].emplace_back(t);
+            addTicket(slotIndex, t);
         }
     }
     return true;
 }
 
-CAmount CTicketView::TicketPriceInSlot(const int index)
+CAmount CTicketView::TicketPriceInSlot(const int index) const
 {
-    CAmount price = BaseTicketPrice;
-    for (auto i = 0; i < index; i++) {
-        if (ticketsInSlot[i].size() > SlotLength()) {
-            price *= 1.05;
-        }
-        else if (ticketsInSlot[i].size() < SlotLength()) {
-            price *= 0.95;
-        }
-    }
-    return price;
+    LOCK(cs);
+    return index >= 0 && index < (int)slotTable.size() ? slotTable[index].price : BaseTicketPrice;
 }
 
 void CTicketView::updateTicketPrice(const int height)
 {
     const auto len = Params().SlotLength();
     if (height % len == 0 && height != 0) { //update ticket price
-        auto prevSlotTicketSize = ticketsInSlot[slotIndex].size();
+        auto it = ticketsInSlot.find(slotIndex);
+        auto prevSlotTicketSize = it != ticketsInSlot.end() ? it->second.size() : 0;
         if (prevSlotTicketSize > len) {
             ticketPrice *= 1.05;
         }
         else if (prevSlotTicketSize < len) {
             ticketPrice *= 0.95;
         }
+        slotTable[slotIndex].count = prevSlotTicketSize;
         slotIndex = int(height / len);
         ticketPrice = std::max(ticketPrice, 1 * COIN);
+        assert(slotTable.size() == (size_t)slotIndex);
+        slotTable.emplace_back(ticketPrice);
         LogPrint(BCLog::FIRESTONE, "%s: updata ticket slot, index:%d, price:%d, prevSlotTicketCount:%d\n", __func__, slotIndex, ticketPrice, prevSlotTicketSize);
     }
 }
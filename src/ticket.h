@@ -3,21 +3,38 @@
 
 #include <config/bitcoin-config.h>
 #include <script/script.h>
+#include <script/standard.h>
 #include <pubkey.h>
 #include <amount.h>
 #include <dbwrapper.h>
+#include <primitives/transaction.h>
+#include <sync.h>
 
 #include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+/** Default for -firestoneslots, the slots whose firestones and fstx are kept in memory. */
+static const int DEFAULT_FIRESTONE_SLOTS = 3;
+/** The current slot, the previous one its blocks use, and the one before, which a disconnect may need again. */
+static const int MIN_FIRESTONE_SLOTS = 3;
 
 CScript GenerateTicketScript(const CKeyID keyid, const int lockHeight);
 
-bool DecodeTicketScript(const CScript redeemScript, CKeyID& keyID, int &lockHeight);
+bool DecodeTicketScript(const CScript& redeemScript, CKeyID& keyID, int &lockHeight);
+
+/**
+ * Match script against the exact shape GenerateTicketScript makes, on its bytes:
+ * <lockHeight> OP_CHECKLOCKTIMEVERIFY OP_DROP OP_DUP OP_HASH160 <keyID> OP_EQUALVERIFY OP_CHECKSIG,
+ * with a minimally encoded positive lock height. Other scripts are left to the decoders.
+ */
+bool MatchTicketScript(const CScript& script, CKeyID& keyID, int& lockHeight);
 
-bool GetPublicKeyFromScript(const CScript script, CPubKey& pubkey);
+bool GetPublicKeyFromScript(const CScript& script, CPubKey& pubkey);
 
-bool GetRedeemFromScript(const CScript script, CScript& redeemscript);
+bool GetRedeemFromScript(const CScript& script, CScript& redeemscript);
 
-class COutPoint;
 /**
  * A firestone entry.
  * One firestone is mapping into one transaction, which has redeemScript.
@@ -36,42 +53,113 @@ public:
         UNKNOW
     };
 
-    COutPoint* out;
+    COutPoint out;
     CAmount nValue;
     CScript redeemScript;
     CScript scriptPubkey;
 
     CTicket(const COutPoint& out, const CAmount nValue, const CScript& redeemScript, const CScript &scriptPubkey);
 
-    CTicket(const CTicket& other);
-
     CTicket();
 
-    ~CTicket();
-
     CTicketState State(int activeHeight) const;
 
-    int LockTime()const;
+    int LockTime() const { return lockTime; }
 
-    CKeyID KeyID() const;
+    CKeyID KeyID() const { return keyID; }
 
-    bool Invalid() const;
+    bool Invalid() const { return invalid; }
 
     template <typename Stream>
     void Serialize(Stream& s) const;
 
     template <typename Stream>
     void Unserialize(Stream& s);
+
+private:
+    /** Parse the lock height and the owner out of redeemScript, once it is set.*/
+    void parse();
+
+    int lockTime;
+    CKeyID keyID;
+    bool invalid;
 };
 
-typedef std::shared_ptr<const CTicket> CTicketRef;
 class CBlock;
+class CTicketView;
 typedef std::function<bool(const int, const CTicketRef&)> CheckTicketFunc;
 
+/** The firestone and relation changes of a connected block, as the views accepted them. */
+struct CPoCBlockChanges
+{
+    std::vector<CTicketRef> boughtTickets;  //!< the firestones bought
+    std::vector<CTicketRef> spentTickets;   //!< the firestones spent
+    std::vector<std::pair<uint256, std::pair<CKeyID, CKeyID>>> actions;  //!< the txid and the relation of each bind (from, to) and unbind (from, null)
+    int slotIndex = 0;         //!< the slot of the block
+    bool fSlotOpened = false;  //!< whether the block opened the slot
+    CAmount ticketPrice = 0;   //!< the firestone price of the slot
+};
+
+/** 
+ * An immutable copy of what CTicketView keeps in memory: the firestones of the slots it retains,
+ * by slot and by owner, and the price and count of every slot. It is published once the chain
+ * moved, so RPC and the GUI read it without cs_main; a reader keeps the snapshot it loaded, which
+ * is never modified, while the next one replaces it. The firestones of older slots are read from
+ * the owner records of the view.
+ */
+class CTicketSnapshot
+{
+public:
+    int SlotIndex() const { return slotIndex; }
+
+    int SlotLength() const { return slotLength; }
+
+    int LockTime() const { return LockTime(slotIndex); }
+
+    int LockTime(const int index) const;
+
+    CAmount CurrentTicketPrice() const { return ticketPrice; }
+
+    CAmount TicketPriceInSlot(const int index) const;
+
+    size_t TicketCountInSlot(const int index) const;
+
+    /** Whether the firestones of the slot at index are held, older ones are only in the slot summaries on disk.*/
+    bool HasSlot(const int index) const { return ticketsInSlot.count(index) || index >= slotIndex; }
+
+    const std::vector<CTicketRef>& GetTicketsBySlotIndex(const int index) const;
+
+    /** The firestones of the owner, those of the slots no longer retained read from disk.*/
+    std::vector<CTicketRef> FindeTickets(const CKeyID& key) const;
+
+private:
+    friend class CTicketView;
+
+    const CTicketView* view = nullptr;
+    int slotIndex = 0;
+    int slotLength = 0;
+    CAmount ticketPrice = 0;
+    /** The price of every slot up to the current one, and the count of every closed slot.*/
+    std::vector<CAmount> slotPrices;
+    std::vector<size_t> slotCounts;
+    std::map<int, std::vector<CTicketRef>> ticketsInSlot;
+    std::map<CKeyID, std::vector<CTicketRef>> ticketsInAddr;
+};
+
+typedef std::shared_ptr<const CTicketSnapshot> CTicketSnapshotRef;
+
+struct CTicketTxidHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.GetUint64(0); }
+};
+
 /** 
- * Abstract view on the firestone dataset. 
+ * Abstract view on the firestone dataset. Its writes are buffered until the chain state
+ * is flushed, see CDBBufferedWrapper. The firestones in memory are guarded by the view's
+ * own lock, so they are read without cs_main; the chain connects and disconnects blocks
+ * with cs_main held, so a reader holding cs_main sees them consistent with the tip.
  */
-class CTicketView : public CDBWrapper {
+class CTicketView : public CDBBufferedWrapper {
 public: 
     CTicketView(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -82,9 +170,25 @@ public:
      * @param[in]    height       the block height, at which this firestone appears.
      * @param[out]   blk          the block, at which this firestone appears.
      * @param[in]    checkTicket  the function, which is used to check the firestone whether valid.
+     * @param[out]   connected    the firestones accepted, if not null.
+     */
+    void ConnectBlock(const int height, const CBlock &blk, CheckTicketFunc checkTicket, std::vector<CTicketRef>* connected = nullptr);
+
+    /** 
+     * ConnectBlock for the firestones of the ticket transactions of a block, in block order,
+     * as collected by the caller while it checks the transactions anyway.
+     * @param[in]    height       the block height, at which this firestone appears.
+     * @param[in]    candidates   the firestones of the block, checked with checkTicket in turn.
+     * @param[in]    checkTicket  the function, which is used to check the firestone whether valid.
+     * @param[out]   connected    the firestones accepted, if not null.
      */
-    void ConnectBlock(const int height, const CBlock &blk, CheckTicketFunc checkTicket);
+    void ConnectBlock(const int height, const std::vector<CTicketRef>& candidates, CheckTicketFunc checkTicket, std::vector<CTicketRef>* connected = nullptr);
 
+    /** 
+     * DisconnectBlock undoes the firestones of the block at height, which must be the tip.
+     * @param[in]    height       the block height, at which this firestone appears.
+     * @param[in]    blk          the block to disconnect.
+     */
     void DisconnectBlock(const int height, const CBlock &blk);
     
     /** 
@@ -93,16 +197,41 @@ public:
      */
     CAmount CurrentTicketPrice() const;
 
-    std::vector<CTicketRef> CurrentSlotTicket();
+    std::vector<CTicketRef> CurrentSlotTicket() const;
     
     /** 
-     * Find all firestone owned by the KeyID.
+     * Find all firestone owned by the KeyID, those of the slots no longer retained in memory
+     * are read from the owner's record on disk.
      */
-    std::vector<CTicketRef> FindeTickets(const CKeyID key);
+    std::vector<CTicketRef> FindeTickets(const CKeyID key) const;
 
-    std::vector<CTicketRef> GetTicketsBySlotIndex(const int slotIndex);
+    /** The firestones of every owner, as FindeTickets finds them. This reads all owner records. */
+    std::map<CKeyID, std::vector<CTicketRef>> TicketsByAddress();
 
-    int SlotIndex() const { return slotIndex; }
+    /** 
+     * The firestones bought in a slot, as far as they are kept in memory: the current slot
+     * and the ones before it up to the retained slots, see compactSlots.
+     */
+    std::vector<CTicketRef> GetTicketsBySlotIndex(const int slotIndex) const;
+
+    /** 
+     * The firestones bought in any slot up to the current one, read from the slot summary
+     * once the slot is no longer kept in memory.
+     */
+    std::vector<CTicketRef> ListTicketsInSlot(const int slotIndex) const;
+
+    /** The count of firestones bought in any slot up to the current one.*/
+    size_t TicketCountInSlot(const int slotIndex) const;
+
+    /** 
+     * Find the firestone at the outpoint.
+     * @param[in]   slotIndex  the slot, in which the firestone is bought.
+     * @param[in]   out        the outpoint of the firestone.
+     * @return      the firestone, or nullptr if it is not bought in slotIndex.
+     */
+    CTicketRef GetTicket(const int slotIndex, const COutPoint& out) const;
+
+    int SlotIndex() const { LOCK(cs); return slotIndex; }
     
     /** 
      * Slotlenth is 2048 each slot.
@@ -125,10 +254,77 @@ public:
      */
     bool LoadTicketFromDisk(const int height);
 
-    CAmount TicketPriceInSlot(const int index);
+    /** 
+     * Load the firestone set up to height from the per-slot summaries,
+     * only the heights of the open slot are read one by one.
+     * @param[in]   height, the synced tip height.
+     * @param[in]   fAhead, the database may be flushed ahead of height, by up to the next slot.
+     * @return      false if the database is not synced to height, the view is left empty then.
+     */
+    bool LoadSlotsFromDisk(const int height, const bool fAhead = false);
+
+    /** 
+     * Write the summaries of all closed slots and mark the database synced at height.
+     * Used after a full replay, so the next startup can use LoadSlotsFromDisk once flushed.
+     */
+    void WriteSlotsToDisk(const int height);
+
+    /** Whether the per-height records of closed slots were erased, so the firestones cannot be replayed from height 0.*/
+    bool HeightsCompacted() const;
+
+    /** The firestone price of the slot at index, which is up to the current one.*/
+    CAmount TicketPriceInSlot(const int index) const;
+
+    /** Replace the snapshot with a copy of the view, called with cs_main held once the chain moved.*/
+    void PublishSnapshot();
+
+    /** 
+     * Keep the firestones of nSlots slots in memory, at least MIN_FIRESTONE_SLOTS. Set before
+     * the view is loaded, the slots no longer retained are dropped when the next one opens.
+     */
+    void SetRetainedSlots(const int nSlots);
+
+    /** The snapshot published last, read without cs_main.*/
+    CTicketSnapshotRef GetSnapshot() const { return std::atomic_load(&snapshot); }
 
 private:
-    bool WriteTicketsToDisk(const int height, const std::vector<CTicket> &tickets);
+    friend class CTicketSnapshot;
+
+    /** Write the firestones and the starting price of the slot at index.*/
+    void writeSlot(const int index) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Write the firestones as the record of height, or erase the record if there are none.*/
+    void writeHeight(const int height, const std::vector<CTicketRef>& refs);
+
+    /** Index the firestone, bought in the slot at index.*/
+    void addTicket(const int index, const CTicketRef& ticket) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** 
+     * Called when a slot opens, once the previous one is summarized. The per-height records
+     * are only kept from the previous slot on, which a disconnect may open again, and the
+     * firestones of slots no longer retained are dropped from memory, their owners' included,
+     * see pageOwners.
+     */
+    void compactSlots() EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** 
+     * Move the firestones of the slots below index out of the owners in memory into the
+     * owner records, so wallets still find their overdue firestones while memory does not
+     * grow with every firestone ever bought.
+     */
+    void pageOwners(const int index) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** The firestones of the owner record of key, merged with refs, those in both once.*/
+    std::vector<CTicketRef> readOwner(const CKeyID& key, const std::vector<CTicketRef>* refs) const;
+
+    /** Erase the per-height records below height, whose firestones are in the slot summaries.*/
+    void eraseHeightsBelow(const int height);
+
+    /** Read the firestones of the slot at index back from its summary, for a disconnect reaching it.*/
+    bool restoreSlot(const int index) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Drop all in-memory firestones and restart from slot 0 at the base price.*/
+    void reset() EXCLUSIVE_LOCKS_REQUIRED(cs);
     
     /** 
      * Update the firestone price, by +5% or -5% one slot.
@@ -141,14 +337,35 @@ private:
      * On the other hand:
      *                      Price *= 0.95;
      */
-    void updateTicketPrice(const int height);
+    void updateTicketPrice(const int height) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 private:
+    mutable CCriticalSection cs;
     /** This map records firestones in each slot, one slot is 2048 blocks.*/
-    std::map<int, std::vector<CTicketRef>> ticketsInSlot;
-    std::map<CKeyID, std::vector<CTicketRef>> ticketsInAddr;
-    CAmount ticketPrice;
-    int slotIndex;
+    std::map<int, std::vector<CTicketRef>> ticketsInSlot GUARDED_BY(cs);
+    /** The firestones of each owner from slot pagedSlots on, in the order they were bought.*/
+    std::map<CKeyID, std::vector<CTicketRef>> ticketsInAddr GUARDED_BY(cs);
+    /** The owners of the firestones of the slots below are in the owner records on disk.*/
+    int pagedSlots GUARDED_BY(cs);
+    /** The slots whose firestones are kept in memory, the current one included.*/
+    int nRetainedSlots GUARDED_BY(cs);
+    /** The firestones by txid, with the slot they are bought in. A firestone tx holds one firestone.*/
+    std::unordered_map<uint256, std::pair<int, CTicketRef>, CTicketTxidHasher> ticketsByOut GUARDED_BY(cs);
+    struct SlotEntry {
+        CAmount price;  //!< the firestone price of the slot
+        size_t count;   //!< the firestones bought in the slot, once it is closed
+        explicit SlotEntry(CAmount priceIn = 0, size_t countIn = 0) : price(priceIn), count(countIn) {}
+    };
+    /** 
+     * Every slot up to the current one by index, so the price and count of any slot are
+     * looked up directly. Grows as slots open, and shrinks as a disconnect reopens one,
+     * which rewinds the price.
+     */
+    std::vector<SlotEntry> slotTable GUARDED_BY(cs);
+    CAmount ticketPrice GUARDED_BY(cs);
+    int slotIndex GUARDED_BY(cs);
+    /** Read and replaced with the atomic shared_ptr operations.*/
+    CTicketSnapshotRef snapshot;
     /** Base firestone price is 3000 LV.*/
     static CAmount BaseTicketPrice;
 };
@@ -12,10 +12,14 @@
 #include <shutdown.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <utxostats.h>
 #include <ui_interface.h>
 
 #include <stdint.h>
 
+#include <set>
+#include <thread>
+
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
@@ -25,6 +29,7 @@ static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
+static const char DB_UTXO_STATS = 'U';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
@@ -53,25 +58,94 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+/**
+ * The chainstate is read one coin at a time at random: small blocks, compressed to cut the bytes read per lookup.
+ * Its flushes write far more than the small cache of the database, so the memtable is larger than the cache
+ * share, tables are cut larger, and level-0 files pile up further before writes stall, while the compactions
+ * into level-1 run on several threads.
+ */
+static DBOptions ChainstateDBOptions()
+{
+    DBOptions options;
+    options.compression = true;
+    options.write_buffer_size = 16 << 20;
+    options.max_file_size = 32 << 20;
+    options.l0_slowdown_writes_trigger = 20;
+    options.l0_stop_writes_trigger = 36;
+    options.max_subcompactions = std::max<int64_t>(gArgs.GetArg("-dbsubcompactions", DEFAULT_DB_SUBCOMPACTIONS), 1);
+    return options;
+}
+
+/** The block index is read whole at startup, then rarely: larger compressed blocks suit the scan. */
+static DBOptions BlockTreeDBOptions()
+{
+    DBOptions options;
+    options.compression = true;
+    options.block_size = 16 * 1024;
+    return options;
+}
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, ChainstateDBOptions())
+{
+}
+
+CCoinsViewDB::~CCoinsViewDB()
 {
+    if (!threadWriteBack.joinable())
+        return;
+    {
+        LOCK(cs_writeback);
+        fStopWriteBack = true;
+    }
+    cond_writeback.notify_all();
+    // The pending map, if any, is written before the thread exits.
+    threadWriteBack.join();
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        LOCK(cs_writeback);
+        if (mapWriting) {
+            CCoinsMap::const_iterator it = mapWriting->find(outpoint);
+            if (it != mapWriting->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    {
+        LOCK(cs_writeback);
+        if (mapWriting) {
+            CCoinsMap::const_iterator it = mapWriting->find(outpoint);
+            if (it != mapWriting->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
-uint256 CCoinsViewDB::GetBestBlock() const {
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
     return hashBestChain;
 }
 
+uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        LOCK(cs_writeback);
+        if (!hashWriting.IsNull())
+            return hashWriting;
+    }
+    return ReadBestBlock();
+}
+
 std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     std::vector<uint256> vhashHeadBlocks;
     if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks)) {
@@ -80,15 +154,48 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
+bool CCoinsViewDB::ReadUTXOStats(CUTXOStats& stats) const {
+    return db.Read(DB_UTXO_STATS, stats);
+}
+
+void CCoinsViewDB::SetUTXOStats(const CUTXOStats& stats) {
+    LOCK(cs_writeback);
+    statsNext.reset(new CUTXOStats(stats));
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    assert(!hashBlock.IsNull());
+    if (!threadWriteBack.joinable()) {
+        std::unique_ptr<CUTXOStats> stats;
+        {
+            LOCK(cs_writeback);
+            stats = std::move(statsNext);
+        }
+        bool ret = WriteCoins(mapCoins, hashBlock, stats.get());
+        mapCoins.clear();
+        return ret;
+    }
+
+    WAIT_LOCK(cs_writeback, lock);
+    cond_writeback.wait(lock, [this] { return hashWriting.IsNull() || fWriteFailed; });
+    if (fWriteFailed)
+        return false;
+    mapWriting.reset(new CCoinsMap(std::move(mapCoins)));
+    mapCoins.clear();
+    statsWriting = std::move(statsNext);
+    hashWriting = hashBlock;
+    cond_writeback.notify_all();
+    return true;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CUTXOStats* stats) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
-    assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -105,7 +212,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -115,8 +222,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -134,6 +239,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    // Statistics of another block are left as they are, they are told apart by their block.
+    if (stats && stats->hashBlock == hashBlock)
+        batch.Write(DB_UTXO_STATS, *stats);
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -141,12 +249,194 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+void CCoinsViewDB::StartWriteBack()
+{
+    assert(!threadWriteBack.joinable());
+    threadWriteBack = std::thread(&TraceThread<std::function<void()>>, "coinswrite", std::function<void()>(std::bind(&CCoinsViewDB::ThreadWriteBack, this)));
+}
+
+void CCoinsViewDB::ThreadWriteBack()
+{
+    while (true) {
+        uint256 hashBlock;
+        {
+            WAIT_LOCK(cs_writeback, lock);
+            cond_writeback.wait(lock, [this] { return !hashWriting.IsNull() || fStopWriteBack; });
+            if (hashWriting.IsNull())
+                return;
+            hashBlock = hashWriting;
+        }
+
+        // mapWriting and statsWriting are not changed before hashWriting is reset, so they are
+        // read without the lock.
+        bool ret;
+        try {
+            ret = WriteCoins(*mapWriting, hashBlock, statsWriting.get());
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            ret = false;
+        }
+
+        {
+            LOCK(cs_writeback);
+            mapWriting.reset();
+            statsWriting.reset();
+            hashWriting.SetNull();
+            if (!ret)
+                fWriteFailed = true;
+        }
+        cond_writeback.notify_all();
+    }
+}
+
+bool CCoinsViewDB::WaitForWriteBack() const
+{
+    WAIT_LOCK(cs_writeback, lock);
+    cond_writeback.wait(lock, [this] { return hashWriting.IsNull(); });
+    return !fWriteFailed;
+}
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* view, int nThreads) : CCoinsViewBacked(view)
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()>>, "coinsprefetch", std::function<void()>(std::bind(&CCoinsViewPrefetch::ThreadPrefetch, this)));
+    }
+}
+
+CCoinsViewPrefetch::~CCoinsViewPrefetch()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    condIdle.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        LOCK(cs);
+        auto it = coins.find(outpoint);
+        if (it != coins.end()) {
+            coin = std::move(it->second);
+            coins.erase(it);
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        LOCK(cs);
+        if (coins.count(outpoint))
+            return true;
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    {
+        LOCK(cs);
+        coins.clear();
+        nGeneration++;
+    }
+    bool ret = base->BatchWrite(mapCoins, hashBlock);
+    // A read that started while the database was being changed is not kept either.
+    LOCK(cs);
+    nGeneration++;
+    return ret;
+}
+
+void CCoinsViewPrefetch::Prefetch(const CBlock& block)
+{
+    std::set<uint256> txids;
+    for (const auto& tx : block.vtx) {
+        txids.insert(tx->GetHash());
+    }
+    {
+        LOCK(cs);
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase())
+                continue;
+            for (const auto& txin : tx->vin) {
+                // Outputs of the block itself are not in the database yet.
+                if (txids.count(txin.prevout.hash))
+                    continue;
+                if (coins.size() + queue.size() >= MAX_PREFETCH_COINS)
+                    break;
+                queue.push_back(txin.prevout);
+            }
+        }
+    }
+    cond.notify_all();
+}
+
+void CCoinsViewPrefetch::Prefetch(const COutPoint& outpoint)
+{
+    {
+        LOCK(cs);
+        if (coins.count(outpoint) || coins.size() + queue.size() >= MAX_PREFETCH_COINS)
+            return;
+        queue.push_back(outpoint);
+    }
+    cond.notify_all();
+}
+
+void CCoinsViewPrefetch::WaitForQueue()
+{
+    WAIT_LOCK(cs, lock);
+    condIdle.wait(lock, [this] { return (queue.empty() && nReading == 0) || fStop; });
+}
+
+void CCoinsViewPrefetch::ThreadPrefetch()
+{
+    while (true) {
+        COutPoint outpoint;
+        uint64_t generation;
+        bool fHave;
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait(lock, [this] { return !queue.empty() || fStop; });
+            if (fStop)
+                return;
+            outpoint = queue.front();
+            queue.pop_front();
+            fHave = coins.count(outpoint) > 0;
+            generation = nGeneration;
+            nReading++;
+        }
+
+        Coin coin;
+        bool fFound = false;
+        if (!fHave) {
+            try {
+                fFound = base->GetCoin(outpoint, coin);
+            } catch (const std::runtime_error&) {
+                // Left to the read of ConnectBlock, which reports it.
+            }
+        }
+
+        LOCK(cs);
+        if (fFound && generation == nGeneration)
+            coins.emplace(outpoint, std::move(coin));
+        if (--nReading == 0 && queue.empty())
+            condIdle.notify_all();
+    }
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe, false, BlockTreeDBOptions()) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,11 +460,19 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
+    return Cursor(uint256());
+}
+
+CCoinsViewCursor *CCoinsViewDB::Cursor(const uint256& hashStart) const
+{
+    // The cursor walks the database alone, so the map being written must be on disk first.
+    WaitForWriteBack();
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
+    const COutPoint start(hashStart, 0);
+    i->pcursor->Seek(CoinEntry(&start));
     // Cache key of first record
     if (i->pcursor->Valid()) {
         CoinEntry entry(&i->keyTmp.second);
@@ -234,6 +532,14 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
+bool CBlockTreeDB::EraseBlockIndex(const std::vector<uint256>& vHash) {
+    CDBBatch batch(*this);
+    for (const uint256& hash : vHash) {
+        batch.Erase(std::make_pair(DB_BLOCK_INDEX, hash));
+    }
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -246,21 +552,80 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/** The block index is read in this many shards, split by the first byte of the block hash. */
+static const unsigned int BLOCK_INDEX_LOAD_SHARDS = 64;
+
+/** The block index entries whose hash starts with a byte in [nBegin, nEnd), read by one loader thread. */
+struct BlockIndexShard
 {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    unsigned int nBegin;
+    unsigned int nEnd;
+    std::vector<std::pair<uint256, CDiskBlockIndex>> entries;
+    std::string strError;
+};
 
-    pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
+/** Read and check the entries of one shard, with a cursor of its own. */
+static void ReadBlockIndexShard(CBlockTreeDB& db, BlockIndexShard& shard)
+{
+    try {
+        std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+        uint256 hashStart;
+        *hashStart.begin() = shard.nBegin;
+        pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, hashStart));
+        while (pcursor->Valid()) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= shard.nEnd)
+                break;
+            CDiskBlockIndex diskindex;
+            if (!pcursor->GetValue(diskindex)) {
+                shard.strError = "failed to read value";
+                return;
+            }
+            // An entry is written under the hash of its header, anything else is a corrupted entry.
+            if (diskindex.GetBlockHash() != key.second) {
+                shard.strError = strprintf("block hash mismatch: %s", key.second.ToString());
+                return;
+            }
+            shard.entries.emplace_back(key.second, diskindex);
+            pcursor->Next();
+        }
+    } catch (const std::exception& e) {
+        shard.strError = e.what();
+    }
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+{
+    // The shards are read and hashed a wave at a time across the cores, then inserted into
+    // mapBlockIndex on this thread. Only one wave of entries is held in memory at once.
+    const size_t nThreads = std::max(GetNumCores(), 1);
+    std::vector<BlockIndexShard> shards(BLOCK_INDEX_LOAD_SHARDS);
+    for (size_t i = 0; i < shards.size(); i++) {
+        shards[i].nBegin = i * 256 / shards.size();
+        shards[i].nEnd = (i + 1) * 256 / shards.size();
+    }
 
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    for (size_t first = 0; first < shards.size(); first += nThreads) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
+        const size_t last = std::min(first + nThreads, shards.size());
+        std::vector<std::thread> threads;
+        for (size_t i = first + 1; i < last; i++) {
+            threads.emplace_back(ReadBlockIndexShard, std::ref(*this), std::ref(shards[i]));
+        }
+        ReadBlockIndexShard(*this, shards[first]);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (size_t i = first; i < last; i++) {
+            BlockIndexShard& shard = shards[i];
+            if (!shard.strError.empty())
+                return error("%s: %s", __func__, shard.strError);
+            for (const auto& entry : shard.entries) {
+                const CDiskBlockIndex& diskindex = entry.second;
                 // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+                CBlockIndex* pindexNew = insertBlockIndex(entry.first);
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
                 pindexNew->nHeight        = diskindex.nHeight;
                 pindexNew->nFile          = diskindex.nFile;
@@ -278,17 +643,9 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nBaseTarget    = diskindex.nBaseTarget;
                 pindexNew->nDeadline      = diskindex.nDeadline;
 
-                auto params = Params();
-                //TODO: fix genesis block
-                //if (pindexNew->nHeight != 0 && !CheckProofOfCapacity(pindexNew->genSign, pindexNew->nHeight, pindexNew->nPlotID, pindexNew->nNonce, pindexNew->nBaseTarget, pindexNew->nDeadline, params.TargetDeadline()))
-                 //   return error("%s: CheckProofOfCapacity failed: %s", __func__, pindexNew->ToString());
-                
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+                // The proofs of capacity are not checked here, see -checkpocindex.
             }
-        } else {
-            break;
+            std::vector<std::pair<uint256, CDiskBlockIndex>>().swap(shard.entries);
         }
     }
 
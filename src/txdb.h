@@ -10,15 +10,20 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CUTXOStats;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
@@ -27,6 +32,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbsubcompactions default
+static const int DEFAULT_DB_SUBCOMPACTIONS = 4;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -37,16 +44,49 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to the block filter index DB specific cache, if -blockfilterindex (MiB)
+static const int64_t nMaxFilterIndexCache = 1024;
+//! Max memory allocated to the address index DB specific cache, if -addressindex (MiB)
+static const int64_t nMaxAddressIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to the firestone, relation, fspool and issuance DB caches together, if no -lavadbcache (MiB)
+static const int64_t nMaxLavaDBCache = 64;
+//! Threads reading the coins of incoming blocks ahead of their connection
+static const int COINS_PREFETCH_THREADS = 4;
+//! Most coins held or queued by the prefetcher, beyond which inputs are not prefetched
+static const size_t MAX_PREFETCH_COINS = 1 << 17;
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    /**
+     * Write-back state, see StartWriteBack. The map handed over by the last BatchWrite is
+     * written by threadWriteBack while hashWriting is set; it is only read meanwhile, so
+     * lookups go to it before the database. It is moved rather than swapped, as the salted
+     * hasher of a CCoinsMap cannot be swapped.
+     */
+    mutable Mutex cs_writeback;
+    mutable std::condition_variable cond_writeback;
+    std::unique_ptr<CCoinsMap> mapWriting GUARDED_BY(cs_writeback);
+    //! The UTXO statistics written along with mapWriting, if any
+    std::unique_ptr<CUTXOStats> statsWriting GUARDED_BY(cs_writeback);
+    uint256 hashWriting GUARDED_BY(cs_writeback);
+    //! The UTXO statistics to write along with the next BatchWrite, see SetUTXOStats
+    std::unique_ptr<CUTXOStats> statsNext GUARDED_BY(cs_writeback);
+    bool fWriteFailed GUARDED_BY(cs_writeback) = false;
+    bool fStopWriteBack GUARDED_BY(cs_writeback) = false;
+    std::thread threadWriteBack;
+
+    uint256 ReadBestBlock() const;
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CUTXOStats* stats);
+    void ThreadWriteBack();
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -54,10 +94,77 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    //! A cursor starting at the first coin of the given txid, or the next one after it.
+    CCoinsViewCursor *Cursor(const uint256& hashStart) const;
+
+    //! Read the last UTXO statistics written, which may be of an earlier block than the best one.
+    bool ReadUTXOStats(CUTXOStats& stats) const;
+    /**
+     * Write stats along with the coins given to the next BatchWrite, in the same batch as
+     * the best block, if they are of that block.
+     */
+    void SetUTXOStats(const CUTXOStats& stats);
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    /**
+     * Write the maps given to BatchWrite in a background thread from now on, so a flush
+     * of the coins cache only hands its entries over instead of waiting for the disk.
+     * One map is written at a time: a BatchWrite arriving while the last one is still
+     * being written waits for it. The cache refilling meanwhile may take up to twice
+     * the memory of a flush.
+     */
+    void StartWriteBack();
+
+    /**
+     * Wait until the map given to the last BatchWrite is on disk.
+     * @return      false if writing it in the background failed.
+     */
+    bool WaitForWriteBack() const;
+};
+
+/**
+ * CCoinsView between the coins cache and the database that reads the inputs of incoming
+ * blocks on a pool of threads, so ConnectBlock finds them in memory instead of reading
+ * them one at a time. Blocks held until their deadline give the pool plenty of time.
+ *
+ * A prefetched coin is handed out once, the cache above keeps it from then on. The coins
+ * read before a BatchWrite may be stale after it, so they are dropped, and so are those
+ * still being read.
+ */
+class CCoinsViewPrefetch final : public CCoinsViewBacked
+{
+public:
+    CCoinsViewPrefetch(CCoinsView* view, int nThreads);
+    ~CCoinsViewPrefetch();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+
+    /** Queue the inputs of block that spend coins of earlier blocks. */
+    void Prefetch(const CBlock& block);
+    /** Queue one coin, such as the firestone of an announced block. */
+    void Prefetch(const COutPoint& outpoint);
+    /** Wait until the coins queued so far are read. */
+    void WaitForQueue();
+
+private:
+    void ThreadPrefetch();
+
+    mutable Mutex cs;
+    std::condition_variable cond;
+    std::condition_variable condIdle;
+    mutable std::map<COutPoint, Coin> coins GUARDED_BY(cs);
+    std::deque<COutPoint> queue GUARDED_BY(cs);
+    //! Coins taken off the queue and still being read
+    int nReading GUARDED_BY(cs) = 0;
+    //! Bumped by BatchWrite, a coin read across a change is not kept
+    uint64_t nGeneration GUARDED_BY(cs) = 0;
+    bool fStop GUARDED_BY(cs) = false;
+    std::vector<std::thread> threads;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -89,6 +196,7 @@ public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
+    bool EraseBlockIndex(const std::vector<uint256>& vHash);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
@@ -8,15 +8,19 @@
 #include <consensus/consensus.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/siphash.h>
 #include <validation.h>
 #include <policy/policy.h>
 #include <policy/fees.h>
+#include <policy/rbf.h>
 #include <reverse_iterator.h>
 #include <streams.h>
+#include <ticket.h>
 #include <timedata.h>
 #include <util/system.h>
 #include <util/moneystr.h>
 #include <util/time.h>
+#include <util/trace.h>
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
@@ -303,6 +307,62 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
     }
 }
 
+void CTxMemPool::UpdateForBlockRemoval(const setEntries &stage)
+{
+    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string dummy;
+
+    // Walk the in-mempool descendants of the block once, then take all of a descendant's
+    // confirmed ancestors off its ancestor state in one update, rather than walking the
+    // descendants of every confirmed transaction in turn.
+    setEntries setDescendants;
+    for (txiter removeIt : stage) {
+        for (txiter childIt : GetMemPoolChildren(removeIt)) {
+            if (!stage.count(childIt)) {
+                CalculateDescendants(childIt, setDescendants);
+            }
+        }
+    }
+    for (txiter dit : setDescendants) {
+        if (stage.count(dit)) continue;
+        setEntries setAncestors;
+        CalculateMemPoolAncestors(*dit, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        int64_t modifySize = 0;
+        CAmount modifyFee = 0;
+        int64_t modifyCount = 0;
+        int modifySigOps = 0;
+        for (txiter ancestorIt : setAncestors) {
+            if (stage.count(ancestorIt)) {
+                modifySize -= ancestorIt->GetTxSize();
+                modifyFee -= ancestorIt->GetModifiedFee();
+                modifyCount--;
+                modifySigOps -= ancestorIt->GetSigOpCost();
+            }
+        }
+        mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, modifyCount, modifySigOps));
+    }
+
+    // A confirmed transaction has no ancestors left in the mempool, unless this is called
+    // in the middle of a reorg (see UpdateForRemoveFromMempool).
+    for (txiter removeIt : stage) {
+        bool fRemainingParent = false;
+        for (txiter parentIt : GetMemPoolParents(removeIt)) {
+            if (!stage.count(parentIt)) {
+                fRemainingParent = true;
+                break;
+            }
+        }
+        if (fRemainingParent) {
+            setEntries setAncestors;
+            CalculateMemPoolAncestors(*removeIt, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+            UpdateAncestorsOf(false, removeIt, setAncestors);
+        }
+    }
+    for (txiter removeIt : stage) {
+        UpdateChildrenForRemoval(removeIt);
+    }
+}
+
 void CTxMemPoolEntry::UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount)
 {
     nSizeWithDescendants += modifySize;
@@ -355,6 +415,7 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
 void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAncestors, bool validFeeEstimate)
 {
     NotifyEntryAdded(entry.GetSharedTx());
+    TRACE3(mempool, added, entry.GetTx().GetHash().begin(), entry.GetTxSize(), entry.GetFee());
     // Add to memory pool without checking anything.
     // Used by AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
@@ -401,12 +462,21 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
+    for (WitnessSipHashes& sipHashes : vWitnessSipHashes) {
+        sipHashes.hashes.push_back(SipHashUint256(sipHashes.k0, sipHashes.k1, vTxHashes.back().first));
+    }
+
+    if (tx.IsTicketTx()) {
+        mapTicketsByLockTime[tx.Ticket()->LockTime()].insert(newit);
+        mapTicketsByOut.emplace(tx.Ticket()->out, newit);
+    }
 }
 
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     NotifyEntryRemoved(it->GetSharedTx(), reason);
     const uint256 hash = it->GetTx().GetHash();
+    TRACE4(mempool, removed, hash.begin(), (int)reason, it->GetTxSize(), it->GetFee());
     for (const CTxIn& txin : it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
 
@@ -418,6 +488,19 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
             vTxHashes.shrink_to_fit();
     } else
         vTxHashes.clear();
+    for (WitnessSipHashes& sipHashes : vWitnessSipHashes) {
+        sipHashes.hashes[it->vTxHashesIdx] = sipHashes.hashes.back();
+        sipHashes.hashes.resize(vTxHashes.size());
+    }
+
+    if (it->GetTx().IsTicketTx()) {
+        const CTicketRef& ticket = it->GetTx().Ticket();
+        auto slot = mapTicketsByLockTime.find(ticket->LockTime());
+        slot->second.erase(it);
+        if (slot->second.empty())
+            mapTicketsByLockTime.erase(slot);
+        mapTicketsByOut.erase(ticket->out);
+    }
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
@@ -546,31 +629,44 @@ void CTxMemPool::removeConflicts(const CTransaction &tx)
 /**
  * Called when a block is connected. Removes from mempool and updates the miner fee estimator.
  */
-void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight)
+void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight, int64_t nBlockTime)
 {
     LOCK(cs);
     std::vector<const CTxMemPoolEntry*> entries;
+    setEntries stage;
     for (const auto& tx : vtx)
     {
         uint256 hash = tx->GetHash();
 
         indexed_transaction_set::iterator i = mapTx.find(hash);
-        if (i != mapTx.end())
+        if (i != mapTx.end()) {
             entries.push_back(&*i);
+            stage.insert(i);
+        }
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
-    if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries, nBlockTime);}
+
+    // Remove the confirmed transactions all at once, then whatever spent the same inputs.
+    UpdateForBlockRemoval(stage);
+    for (txiter it : stage) {
+        removeUnchecked(it, MemPoolRemovalReason::BLOCK);
+    }
+    setEntries setConflicts;
     for (const auto& tx : vtx)
     {
-        txiter it = mapTx.find(tx->GetHash());
-        if (it != mapTx.end()) {
-            setEntries stage;
-            stage.insert(it);
-            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+        for (const CTxIn& txin : tx->vin) {
+            auto it = mapNextTx.find(txin.prevout);
+            if (it != mapNextTx.end()) {
+                txiter conflictIt = mapTx.find(it->second->GetHash());
+                assert(conflictIt != mapTx.end());
+                CalculateDescendants(conflictIt, setConflicts);
+                mapDeltas.erase(conflictIt->GetTx().GetHash());
+            }
         }
-        removeConflicts(*tx);
-        ClearPrioritisation(tx->GetHash());
+        mapDeltas.erase(tx->GetHash());
     }
+    RemoveStaged(setConflicts, false, MemPoolRemovalReason::CONFLICT);
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
 }
@@ -580,6 +676,9 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    mapTicketsByLockTime.clear();
+    mapTicketsByOut.clear();
+    vWitnessSipHashes.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -594,6 +693,34 @@ void CTxMemPool::clear()
     _clear();
 }
 
+const std::vector<uint64_t>& CTxMemPool::GetWitnessSipHashes(uint64_t k0, uint64_t k1)
+{
+    AssertLockHeld(cs);
+    auto it = std::find_if(vWitnessSipHashes.begin(), vWitnessSipHashes.end(),
+        [k0, k1](const WitnessSipHashes& sipHashes) { return sipHashes.k0 == k0 && sipHashes.k1 == k1; });
+    if (it == vWitnessSipHashes.end()) {
+        if (vWitnessSipHashes.size() >= MAX_WITNESS_SIPHASH_KEYS)
+            vWitnessSipHashes.pop_back();
+        WitnessSipHashes sipHashes;
+        sipHashes.k0 = k0;
+        sipHashes.k1 = k1;
+        sipHashes.hashes.resize(vTxHashes.size());
+        // Hash by batches, for the multi-lane kernel.
+        const uint256* vals[256];
+        for (size_t i = 0; i < vTxHashes.size(); i += 256) {
+            const size_t n = std::min<size_t>(vTxHashes.size() - i, 256);
+            for (size_t j = 0; j < n; j++) {
+                vals[j] = &vTxHashes[i + j].first;
+            }
+            SipHashUint256Multi(k0, k1, vals, &sipHashes.hashes[i], n);
+        }
+        vWitnessSipHashes.insert(vWitnessSipHashes.begin(), std::move(sipHashes));
+    } else if (it != vWitnessSipHashes.begin()) {
+        std::rotate(vWitnessSipHashes.begin(), it, it + 1);
+    }
+    return vWitnessSipHashes.front().hashes;
+}
+
 static void CheckInputsAndUpdateCoins(const CTransaction& tx, CCoinsViewCache& mempoolDuplicate, const int64_t spendheight)
 {
     CValidationState state;
@@ -616,6 +743,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
+    size_t nTicketTxs = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
@@ -626,6 +754,13 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
+        if (tx.IsTicketTx()) {
+            ++nTicketTxs;
+            auto slot = mapTicketsByLockTime.find(tx.Ticket()->LockTime());
+            assert(slot != mapTicketsByLockTime.end() && slot->second.count(it));
+            auto out = mapTicketsByOut.find(tx.Ticket()->out);
+            assert(out != mapTicketsByOut.end() && out->second == it);
+        }
         txlinksMap::const_iterator linksiter = mapLinks.find(it);
         assert(linksiter != mapLinks.end());
         const TxLinks &links = linksiter->second;
@@ -717,6 +852,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+    assert(mapTicketsByOut.size() == nTicketTxs);
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb)
@@ -795,6 +931,77 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
+const TxMempoolSnapshotEntry* CTxMemPoolSnapshot::Find(const uint256& txid) const
+{
+    auto it = mapIndex.find(txid);
+    return it == mapIndex.end() ? nullptr : &entries[it->second];
+}
+
+void CTxMemPoolSnapshot::BuildIndex()
+{
+    mapIndex.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        mapIndex.emplace(entries[i].tx->GetHash(), i);
+    }
+}
+
+MempoolSnapshotRef CTxMemPool::GetSnapshot() const
+{
+    {
+        LOCK(cs_snapshot);
+        if (snapshot && snapshot->nTransactionsUpdated == nTransactionsUpdated)
+            return snapshot;
+    }
+
+    LOCK(cs_snapshot_build);
+    {
+        // Another reader may have built it meanwhile.
+        LOCK(cs_snapshot);
+        if (snapshot && snapshot->nTransactionsUpdated == nTransactionsUpdated)
+            return snapshot;
+    }
+
+    std::shared_ptr<CTxMemPoolSnapshot> fresh;
+    {
+        LOCK(cs);
+        fresh = std::make_shared<CTxMemPoolSnapshot>(nTransactionsUpdated);
+        fresh->entries.reserve(mapTx.size());
+        std::unordered_map<uint256, bool, SaltedTxidHasher> mapReplaceable;
+        for (txiter it : GetSortedDepthAndScore()) {
+            TxMempoolSnapshotEntry e;
+            e.tx = it->GetSharedTx();
+            e.wtxid = vTxHashes[it->vTxHashesIdx].first;
+            e.nFee = it->GetFee();
+            e.nModFee = it->GetModifiedFee();
+            e.nTxSize = it->GetTxSize();
+            e.nTime = it->GetTime();
+            e.nHeight = it->GetHeight();
+            e.nCountWithDescendants = it->GetCountWithDescendants();
+            e.nSizeWithDescendants = it->GetSizeWithDescendants();
+            e.nModFeesWithDescendants = it->GetModFeesWithDescendants();
+            e.nCountWithAncestors = it->GetCountWithAncestors();
+            e.nSizeWithAncestors = it->GetSizeWithAncestors();
+            e.nModFeesWithAncestors = it->GetModFeesWithAncestors();
+            // Parents come first, so theirs is known already.
+            e.fReplaceable = SignalsOptInRBF(it->GetTx());
+            for (txiter parent : GetMemPoolParents(it)) {
+                e.vParents.push_back(parent->GetTx().GetHash());
+                e.fReplaceable |= mapReplaceable[parent->GetTx().GetHash()];
+            }
+            for (txiter child : GetMemPoolChildren(it)) {
+                e.vChildren.push_back(child->GetTx().GetHash());
+            }
+            mapReplaceable[e.tx->GetHash()] = e.fReplaceable;
+            fresh->entries.push_back(std::move(e));
+        }
+    }
+    fresh->BuildIndex();
+
+    LOCK(cs_snapshot);
+    snapshot = fresh;
+    return snapshot;
+}
+
 CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -804,6 +1011,16 @@ CTransactionRef CTxMemPool::get(const uint256& hash) const
     return i->GetSharedTx();
 }
 
+bool CTxMemPool::GetTxData(const CTransaction& tx, PrecomputedTransactionData& txdata) const
+{
+    LOCK(cs);
+    indexed_transaction_set::const_iterator i = mapTx.find(tx.GetHash());
+    if (i == mapTx.end() || !i->GetTxData().ready || i->GetTx().GetWitnessHash() != tx.GetWitnessHash())
+        return false;
+    txdata = i->GetTxData();
+    return true;
+}
+
 TxMempoolInfo CTxMemPool::info(const uint256& hash) const
 {
     LOCK(cs);
@@ -908,10 +1125,32 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return base->GetCoin(outpoint, coin);
 }
 
+std::vector<CTxMemPool::txiter> CTxMemPool::GetTicketTxs(int lockTime) const
+{
+    AssertLockHeld(cs);
+    auto slot = mapTicketsByLockTime.find(lockTime);
+    if (slot == mapTicketsByLockTime.end())
+        return {};
+    return std::vector<txiter>(slot->second.begin(), slot->second.end());
+}
+
+CTransactionRef CTxMemPool::GetTicketTx(const COutPoint& out) const
+{
+    LOCK(cs);
+    auto it = mapTicketsByOut.find(out);
+    if (it == mapTicketsByOut.end())
+        return nullptr;
+    return it->second->GetSharedTx();
+}
+
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
+    size_t nSipHashesUsage = memusage::DynamicUsage(vWitnessSipHashes);
+    for (const WitnessSipHashes& sipHashes : vWitnessSipHashes) {
+        nSipHashesUsage += memusage::DynamicUsage(sipHashes.hashes);
+    }
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + memusage::DynamicUsage(mapTicketsByLockTime) + memusage::DynamicUsage(mapTicketsByOut) + cachedInnerUsage + nSipHashesUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -1027,13 +1266,23 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        CFeeRate removed;
+        setEntries stage;
+        if (fClusterMempool) {
+            // The last chunk of a cluster holds the descendants of all its transactions.
+            setEntries setCluster;
+            CalculateCluster(mapTx.project<0>(it), setCluster);
+            const std::vector<Chunk> chunks = LinearizeCluster(setCluster);
+            removed = CFeeRate(chunks.back().nFee, chunks.back().nSize);
+            stage.insert(chunks.back().txs.begin(), chunks.back().txs.end());
+        } else {
+            removed = CFeeRate(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+            CalculateDescendants(mapTx.project<0>(it), stage);
+        }
         removed += incrementalRelayFee;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -1058,6 +1307,103 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     }
 }
 
+void CTxMemPool::CalculateCluster(txiter entryit, setEntries& setCluster) const
+{
+    setEntries stage;
+    if (setCluster.count(entryit) == 0) {
+        stage.insert(entryit);
+    }
+    while (!stage.empty()) {
+        txiter it = *stage.begin();
+        setCluster.insert(it);
+        stage.erase(it);
+
+        for (txiter parentiter : GetMemPoolParents(it)) {
+            if (!setCluster.count(parentiter)) {
+                stage.insert(parentiter);
+            }
+        }
+        for (txiter childiter : GetMemPoolChildren(it)) {
+            if (!setCluster.count(childiter)) {
+                stage.insert(childiter);
+            }
+        }
+    }
+}
+
+std::vector<CTxMemPool::Chunk> CTxMemPool::LinearizeCluster(const setEntries& setCluster) const
+{
+    std::vector<Chunk> chunks;
+    setEntries remaining(setCluster);
+    while (!remaining.empty()) {
+        // Find the transaction whose ancestors left in the cluster pay the best feerate.
+        Chunk best;
+        for (txiter it : remaining) {
+            Chunk candidate;
+            setEntries ancestors;
+            setEntries stage{it};
+            while (!stage.empty()) {
+                txiter ancestor = *stage.begin();
+                stage.erase(stage.begin());
+                ancestors.insert(ancestor);
+                candidate.nFee += ancestor->GetModifiedFee();
+                candidate.nSize += ancestor->GetTxSize();
+                for (txiter parentiter : GetMemPoolParents(ancestor)) {
+                    if (remaining.count(parentiter) && !ancestors.count(parentiter)) {
+                        stage.insert(parentiter);
+                    }
+                }
+            }
+            const double f1 = (double)candidate.nFee * best.nSize;
+            const double f2 = (double)best.nFee * candidate.nSize;
+            if (best.txs.empty() || f1 > f2 || (f1 == f2 && candidate.nSize < best.nSize)) {
+                candidate.txs.assign(ancestors.begin(), ancestors.end());
+                best = std::move(candidate);
+            }
+        }
+        // A transaction has more ancestors than any of its ancestors.
+        std::sort(best.txs.begin(), best.txs.end(), [](txiter a, txiter b) {
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        });
+        for (txiter it : best.txs) {
+            remaining.erase(it);
+        }
+
+        // A group paying at least as much as the chunk before it is mined with it.
+        while (!chunks.empty() && (double)chunks.back().nFee * best.nSize <= (double)best.nFee * chunks.back().nSize) {
+            Chunk& prev = chunks.back();
+            prev.txs.insert(prev.txs.end(), best.txs.begin(), best.txs.end());
+            prev.nFee += best.nFee;
+            prev.nSize += best.nSize;
+            best = std::move(prev);
+            chunks.pop_back();
+        }
+        chunks.push_back(std::move(best));
+    }
+    return chunks;
+}
+
+std::vector<CTxMemPool::Chunk> CTxMemPool::GetChunks() const
+{
+    std::vector<Chunk> chunks;
+    setEntries setDone;
+    for (txiter it = mapTx.begin(); it != mapTx.end(); ++it) {
+        if (setDone.count(it))
+            continue;
+        setEntries setCluster;
+        CalculateCluster(it, setCluster);
+        setDone.insert(setCluster.begin(), setCluster.end());
+        for (Chunk& chunk : LinearizeCluster(setCluster)) {
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    // The stable sort keeps the chunks of a cluster, whose feerates strictly decrease, in order.
+    std::stable_sort(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) {
+        return (double)a.nFee * b.nSize > (double)b.nFee * a.nSize;
+    });
+    return chunks;
+}
+
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
     std::vector<txiter> candidates;
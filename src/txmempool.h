@@ -6,12 +6,14 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <atomic>
 #include <memory>
 #include <set>
 #include <map>
 #include <vector>
 #include <utility>
 #include <string>
+#include <unordered_map>
 
 #include <amount.h>
 #include <coins.h>
@@ -19,6 +21,7 @@
 #include <indirectmap.h>
 #include <policy/feerate.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <sync.h>
 #include <random.h>
 
@@ -34,6 +37,9 @@ extern CCriticalSection cs_main;
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
 
+/** Number of keys the mempool keeps the SipHash of its witness hashes under, one per compact block being reconstructed. */
+static const size_t MAX_WITNESS_SIPHASH_KEYS = 3;
+
 struct LockPoints
 {
     // Will be set to the blockchain height and median time past
@@ -76,6 +82,7 @@ private:
     const int64_t sigOpCost;        //!< Total sigop cost
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
+    PrecomputedTransactionData txdata; //!< Signature hash data computed when the inputs were checked, reused when connecting a block
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -107,6 +114,8 @@ public:
     int64_t GetModifiedFee() const { return nFee + feeDelta; }
     size_t DynamicMemoryUsage() const { return nUsageSize; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
+    const PrecomputedTransactionData& GetTxData() const { return txdata; }
+    void SetTxData(const PrecomputedTransactionData& txdataIn) { txdata = txdataIn; }
 
     // Adjusts the descendant state.
     void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
@@ -367,6 +376,58 @@ public:
     }
 };
 
+/**
+ * A copy of a mempool entry and of the state the mempool keeps for it, see
+ * CTxMemPool::GetSnapshot.
+ */
+struct TxMempoolSnapshotEntry
+{
+    CTransactionRef tx;
+    uint256 wtxid;
+    CAmount nFee;
+    CAmount nModFee;
+    size_t nTxSize;
+    int64_t nTime;
+    unsigned int nHeight;
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    //! Whether it or one of its in-mempool ancestors signals BIP 125 replaceability
+    bool fReplaceable;
+    //! The in-mempool transactions it spends and that spend it
+    std::vector<uint256> vParents;
+    std::vector<uint256> vChildren;
+};
+
+/**
+ * An immutable copy of the mempool, which readers keep as long as they need it
+ * without holding up the mempool itself.
+ */
+class CTxMemPoolSnapshot
+{
+public:
+    //! The value of CTxMemPool::GetTransactionsUpdated the copy was taken at
+    const unsigned int nTransactionsUpdated;
+    //! The entries sorted by depth and score, so parents come before their children
+    std::vector<TxMempoolSnapshotEntry> entries;
+
+    explicit CTxMemPoolSnapshot(unsigned int nTransactionsUpdatedIn) : nTransactionsUpdated(nTransactionsUpdatedIn) {}
+
+    /** The entry of txid, or nullptr if it was not in the mempool. */
+    const TxMempoolSnapshotEntry* Find(const uint256& txid) const;
+
+    /** Index the entries; called once they are all in. */
+    void BuildIndex();
+
+private:
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> mapIndex;
+};
+
+typedef std::shared_ptr<const CTxMemPoolSnapshot> MempoolSnapshotRef;
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -443,7 +504,7 @@ class CTxMemPool
 {
 private:
     uint32_t nCheckFrequency GUARDED_BY(cs); //!< Value n means that n times in 2^32 we check.
-    unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
+    std::atomic<unsigned int> nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation, and to tell snapshots current
     CBlockPolicyEstimator* minerPolicyEstimator;
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
@@ -537,6 +598,16 @@ public:
     const setEntries & GetMemPoolParents(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
     const setEntries & GetMemPoolChildren(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
     uint64_t CalculateDescendantMaximum(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** A run of transactions of a linearized cluster, mined or evicted together at their combined feerate. */
+    struct Chunk {
+        //! The transactions, parents before children
+        std::vector<txiter> txs;
+        //! Sum of the modified fees of the transactions
+        CAmount nFee = 0;
+        //! Sum of the virtual sizes of the transactions
+        int64_t nSize = 0;
+    };
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
@@ -553,6 +624,26 @@ private:
 
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Serializes the builders of snapshots, so a batch of changes is copied once
+    mutable Mutex cs_snapshot_build;
+    mutable Mutex cs_snapshot;
+    mutable MempoolSnapshotRef snapshot GUARDED_BY(cs_snapshot);
+
+    /** The firestone purchases (CTransaction::IsTicketTx), by the lock height of their firestone,
+     *  which tells the slot they must be mined in to buy it. */
+    std::map<int, setEntries> mapTicketsByLockTime GUARDED_BY(cs);
+    /** The firestone purchases, by the outpoint of their firestone. */
+    std::map<COutPoint, txiter> mapTicketsByOut GUARDED_BY(cs);
+
+    /** The SipHash of the witness hashes of vTxHashes under one key, in the same order. */
+    struct WitnessSipHashes {
+        uint64_t k0;
+        uint64_t k1;
+        std::vector<uint64_t> hashes;
+    };
+    //! The hashes under the last keys asked for, most recently used first
+    std::vector<WitnessSipHashes> vWitnessSipHashes GUARDED_BY(cs);
+
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas;
@@ -583,10 +674,19 @@ public:
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
     void removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     void removeConflicts(const CTransaction &tx) EXCLUSIVE_LOCKS_REQUIRED(cs);
-    void removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight);
+    void removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight, int64_t nBlockTime = 0);
 
     void clear();
     void _clear() EXCLUSIVE_LOCKS_REQUIRED(cs); //lock free
+
+    /**
+     * SipHashUint256 of the witness hashes of vTxHashes under the key (k0, k1), in the same
+     * order, as compact blocks derive their short IDs. The hashes under the last
+     * MAX_WITNESS_SIPHASH_KEYS keys are kept up to date as transactions come and go, so
+     * asking again for one of them does not hash the mempool again. The reference is
+     * valid until the mempool changes.
+     */
+    const std::vector<uint64_t>& GetWitnessSipHashes(uint64_t k0, uint64_t k1) EXCLUSIVE_LOCKS_REQUIRED(cs);
     bool CompareDepthAndScore(const uint256& hasha, const uint256& hashb);
     void queryHashes(std::vector<uint256>& vtxid);
     bool isSpent(const COutPoint& outpoint) const;
@@ -649,6 +749,21 @@ public:
      *  already in it.  */
     void CalculateDescendants(txiter it, setEntries& setDescendants) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Populate setCluster with the cluster of it: the transactions connected to it through
+     *  parents and children, itself included. Assumes that setCluster includes the whole
+     *  cluster of anything already in it. */
+    void CalculateCluster(txiter it, setEntries& setCluster) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Linearize a cluster: repeatedly take the transaction whose ancestors left in the cluster
+     *  pay the best feerate, together with those ancestors, and merge each such group into the
+     *  chunks before it that pay no more. The chunks come out in strictly decreasing feerate,
+     *  parents before children. Quadratic in the cluster size, which -limitclustercount bounds. */
+    std::vector<Chunk> LinearizeCluster(const setEntries& setCluster) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** The chunks of all clusters, best feerate first, the order cluster mode mines them in.
+     *  The chunks of one cluster keep their linearization order. */
+    std::vector<Chunk> GetChunks() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** The minimum fee to get into the mempool, which may itself not be enough
       *  for larger-sized transactions.
       *  The incrementalRelayFee policy variable is used to bound the time it
@@ -660,6 +775,8 @@ public:
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
+      *  In cluster mode the last chunk of the cluster of the worst package goes
+      *  first, so transactions leave in the reverse of the order they are mined.
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining=nullptr);
 
@@ -684,13 +801,33 @@ public:
         return totalTxSize;
     }
 
+    /** The number of firestone purchases. */
+    size_t TicketTxCount() const
+    {
+        LOCK(cs);
+        return mapTicketsByOut.size();
+    }
+
+    /** The firestone purchases whose firestone is locked until lockTime, i.e. that buy it in the slot ending at lockTime. */
+    std::vector<txiter> GetTicketTxs(int lockTime) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** The firestone purchase of the firestone at out, or nullptr if there is none. */
+    CTransactionRef GetTicketTx(const COutPoint& out) const;
+
     bool exists(const uint256& hash) const
     {
         LOCK(cs);
         return (mapTx.count(hash) != 0);
     }
 
+    /** A copy of the mempool as of its last change, for readers that only look at it:
+     *  only the first of them after a batch of changes takes cs, to build the copy. */
+    MempoolSnapshotRef GetSnapshot() const;
+
     CTransactionRef get(const uint256& hash) const;
+    /** Copy the signature hash data of tx, if the same transaction, witness included, is in the
+     *  mempool and its data was computed. */
+    bool GetTxData(const CTransaction& tx, PrecomputedTransactionData& txdata) const;
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
@@ -724,6 +861,9 @@ private:
       * If updateDescendants is true, then also update in-mempool descendants'
       * ancestor state. */
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Update the state of the rest of the mempool for removing the transactions of a block,
+      * stage, all at once. */
+    void UpdateForBlockRemoval(const setEntries &stage) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -0,0 +1,165 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txreconciliation.h>
+
+#include <crypto/sha256.h>
+#include <crypto/siphash.h>
+
+#include <algorithm>
+
+/** The finalizer of MurmurHash3, spreading the bits of a short id over the whole word. */
+static uint32_t Mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t CheckSum(uint32_t id)
+{
+    return Mix(id ^ 0x5bd1e995);
+}
+
+CTxReconSketch::CTxReconSketch(size_t nCells) : vCells((std::max<size_t>(nCells, 3) + 2) / 3 * 3)
+{
+}
+
+void CTxReconSketch::Toggle(std::vector<Cell>& cells, uint32_t id, int32_t count) const
+{
+    const size_t nPart = cells.size() / 3;
+    const uint32_t check = CheckSum(id);
+    for (uint32_t i = 0; i < 3; i++) {
+        Cell& cell = cells[i * nPart + Mix(id + i * 0x9e3779b9) % nPart];
+        cell.count += count;
+        cell.idSum ^= id;
+        cell.checkSum ^= check;
+    }
+}
+
+void CTxReconSketch::Add(uint32_t id)
+{
+    Toggle(vCells, id, 1);
+}
+
+bool CTxReconSketch::Subtract(const CTxReconSketch& other)
+{
+    if (other.vCells.size() != vCells.size())
+        return false;
+    for (size_t i = 0; i < vCells.size(); i++) {
+        vCells[i].count -= other.vCells[i].count;
+        vCells[i].idSum ^= other.vCells[i].idSum;
+        vCells[i].checkSum ^= other.vCells[i].checkSum;
+    }
+    return true;
+}
+
+bool CTxReconSketch::Decode(std::vector<uint32_t>& vOnlyOurs, std::vector<uint32_t>& vOnlyTheirs) const
+{
+    if (!IsValid())
+        return false;
+    std::vector<Cell> cells(vCells);
+    // Peel the cells holding a single id until none is left.
+    bool fProgress = true;
+    while (fProgress) {
+        fProgress = false;
+        for (const Cell& cell : cells) {
+            if ((cell.count != 1 && cell.count != -1) || cell.checkSum != CheckSum(cell.idSum))
+                continue;
+            const uint32_t id = cell.idSum;
+            const int32_t count = cell.count;
+            (count == 1 ? vOnlyOurs : vOnlyTheirs).push_back(id);
+            Toggle(cells, id, -count);
+            fProgress = true;
+        }
+    }
+    for (const Cell& cell : cells) {
+        if (cell.count != 0 || cell.idSum != 0 || cell.checkSum != 0)
+            return false;
+    }
+    return true;
+}
+
+TxReconciliationState::TxReconciliationState(bool fInitiatorIn, uint64_t nLocalSalt, uint64_t nRemoteSalt) :
+    fInitiator(fInitiatorIn), nNextRequest(0), nRequestTime(0)
+{
+    // Both sides key the short ids the same way, whichever salt is theirs.
+    static const unsigned char TAG[] = "Lava tx reconciliation";
+    const uint64_t nSalt1 = std::min(nLocalSalt, nRemoteSalt);
+    const uint64_t nSalt2 = std::max(nLocalSalt, nRemoteSalt);
+    unsigned char salts[16];
+    for (int i = 0; i < 8; i++) {
+        salts[i] = nSalt1 >> (8 * i);
+        salts[8 + i] = nSalt2 >> (8 * i);
+    }
+    uint256 key;
+    CSHA256().Write(TAG, sizeof(TAG) - 1).Write(salts, sizeof(salts)).Finalize(key.begin());
+    k0 = key.GetUint64(0);
+    k1 = key.GetUint64(1);
+}
+
+uint32_t TxReconciliationState::GetShortID(const uint256& txid) const
+{
+    return (uint32_t)SipHashUint256(k0, k1, txid);
+}
+
+bool TxReconciliationState::AddToSet(const uint256& txid)
+{
+    if (mapSet.size() >= MAX_RECON_SET_SIZE)
+        return false;
+    // A short id taken by another transaction cannot be reconciled.
+    auto ret = mapSet.emplace(GetShortID(txid), txid);
+    return ret.second || ret.first->second == txid;
+}
+
+void TxReconciliationState::Snapshot()
+{
+    for (const auto& entry : mapSnapshot) {
+        mapSet.insert(entry);
+    }
+    mapSnapshot.clear();
+    mapSnapshot.swap(mapSet);
+}
+
+CTxReconSketch TxReconciliationState::SketchSnapshot(size_t nCells) const
+{
+    CTxReconSketch sketch(nCells);
+    for (const auto& entry : mapSnapshot) {
+        sketch.Add(entry.first);
+    }
+    return sketch;
+}
+
+std::vector<uint256> TxReconciliationState::LookupSnapshot(const std::vector<uint32_t>& vShortIDs) const
+{
+    std::vector<uint256> vTxid;
+    for (const uint32_t id : vShortIDs) {
+        auto it = mapSnapshot.find(id);
+        if (it != mapSnapshot.end())
+            vTxid.push_back(it->second);
+    }
+    return vTxid;
+}
+
+std::vector<uint256> TxReconciliationState::TakeSnapshot()
+{
+    std::vector<uint256> vTxid;
+    vTxid.reserve(mapSnapshot.size());
+    for (const auto& entry : mapSnapshot) {
+        vTxid.push_back(entry.second);
+    }
+    mapSnapshot.clear();
+    return vTxid;
+}
+
+size_t EstimateSketchCells(size_t nLocalSize, size_t nRemoteSize)
+{
+    // Expect the sets to differ by their size difference plus a quarter of the smaller one,
+    // and give the table half again as many cells, which it needs to be listed reliably.
+    const size_t nDiff = std::max(nLocalSize, nRemoteSize) - std::min(nLocalSize, nRemoteSize) + std::min(nLocalSize, nRemoteSize) / 4 + 4;
+    return std::min(nDiff * 3 / 2 + 6, MAX_SKETCH_CELLS);
+}
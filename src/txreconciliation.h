@@ -0,0 +1,138 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_TXRECONCILIATION_H
+#define LAVA_TXRECONCILIATION_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+/** Version of the transaction reconciliation protocol announced in "sendrecon". */
+static const uint32_t TXRECON_PROTOCOL_VERSION = 1;
+/** Default for -txreconciliation. */
+static const bool DEFAULT_TXRECONCILIATION = false;
+/** Average delay between two reconciliations requested from the same outbound peer, in seconds. */
+static const int64_t RECON_REQUEST_INTERVAL = 2;
+/** Time after which an unanswered reconciliation is given up and its set flooded, in seconds. */
+static const int64_t RECON_TIMEOUT = 30;
+/** Most transactions waiting for the next reconciliation with a peer, the others are flooded. */
+static const size_t MAX_RECON_SET_SIZE = 4000;
+/** Most cells of a sketch, enough for the difference of two full sets. */
+static const size_t MAX_SKETCH_CELLS = 3 * MAX_RECON_SET_SIZE;
+
+/**
+ * An invertible Bloom lookup table of 32-bit short transaction ids. Subtracting the
+ * sketch of one set from the sketch of another leaves the symmetric difference of
+ * the two sets, which can be listed as long as it is small compared to the number
+ * of cells. Every id is added to one cell in each of the three thirds of the table.
+ */
+class CTxReconSketch
+{
+public:
+    struct Cell
+    {
+        int32_t count;
+        uint32_t idSum;
+        uint32_t checkSum;
+
+        Cell() : count(0), idSum(0), checkSum(0) {}
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(count);
+            READWRITE(idSum);
+            READWRITE(checkSum);
+        }
+    };
+
+    CTxReconSketch() {}
+    /** An empty sketch of nCells cells, rounded up to a multiple of three. */
+    explicit CTxReconSketch(size_t nCells);
+
+    size_t CellCount() const { return vCells.size(); }
+    /** Whether the sketch has a shape we can work with, to be checked on sketches received from peers. */
+    bool IsValid() const { return !vCells.empty() && vCells.size() % 3 == 0 && vCells.size() <= MAX_SKETCH_CELLS; }
+
+    void Add(uint32_t id);
+
+    /** Remove the ids of other from this sketch. Both must have the same number of cells. */
+    bool Subtract(const CTxReconSketch& other);
+
+    /**
+     * List the ids left in a sketch after Subtract: those only in this sketch go to vOnlyOurs,
+     * those only in the subtracted one to vOnlyTheirs. Returns false if the difference is too
+     * large to be listed, in which case the output vectors are incomplete.
+     */
+    bool Decode(std::vector<uint32_t>& vOnlyOurs, std::vector<uint32_t>& vOnlyTheirs) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vCells);
+    }
+
+private:
+    std::vector<Cell> vCells;
+
+    void Toggle(std::vector<Cell>& cells, uint32_t id, int32_t count) const;
+};
+
+/**
+ * The reconciliation of the transactions announced on one connection. The outbound side
+ * initiates: it sends its set size in "reqrecon", the other side answers with a sketch
+ * of its set in "sketch", and the initiator lists the difference and sends the short ids
+ * it misses in "reconcildiff". Both sides then announce the transactions the other one
+ * misses with regular invs. Each round works on a snapshot of the set, so transactions
+ * arriving meanwhile wait for the next round.
+ */
+struct TxReconciliationState
+{
+    //! Whether we are the outbound side, which requests the reconciliations.
+    const bool fInitiator;
+    //! Transactions waiting for the next round, by short id.
+    std::map<uint32_t, uint256> mapSet;
+    //! Transactions of the round in progress, by short id.
+    std::map<uint32_t, uint256> mapSnapshot;
+    //! Transactions to announce with a regular inv instead of adding them to the set.
+    std::set<uint256> setAnnounce;
+    //! When we may request the next reconciliation (initiator only), in microseconds.
+    int64_t nNextRequest;
+    //! When we requested the reconciliation in progress (initiator only), in microseconds, or 0.
+    int64_t nRequestTime;
+
+    TxReconciliationState(bool fInitiatorIn, uint64_t nLocalSalt, uint64_t nRemoteSalt);
+
+    uint32_t GetShortID(const uint256& txid) const;
+
+    /** Add a transaction to the set of the next round. Returns false if it should be flooded instead. */
+    bool AddToSet(const uint256& txid);
+
+    /** Start a round with the current set, giving back the snapshot of an unfinished one first. */
+    void Snapshot();
+
+    /** A sketch of the snapshot with nCells cells. */
+    CTxReconSketch SketchSnapshot(size_t nCells) const;
+
+    /** The transactions of the snapshot with the given short ids. */
+    std::vector<uint256> LookupSnapshot(const std::vector<uint32_t>& vShortIDs) const;
+
+    /** End the round, returning the transactions of the snapshot. */
+    std::vector<uint256> TakeSnapshot();
+
+private:
+    uint64_t k0, k1;
+};
+
+/** The number of cells of a sketch for sets of nLocalSize and nRemoteSize transactions. */
+size_t EstimateSketchCells(size_t nLocalSize, size_t nRemoteSize);
+
+#endif // LAVA_TXRECONCILIATION_H
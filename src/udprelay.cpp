@@ -0,0 +1,361 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <udprelay.h>
+
+#include <blockencodings.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <crypto/siphash.h>
+#include <fec.h>
+#include <metrics.h>
+#include <netbase.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <validation.h>
+#include <version.h>
+
+#include <algorithm>
+
+std::unique_ptr<CUDPRelay> g_udp_relay;
+
+/** Version of the packet format, sent in every packet */
+static const uint8_t UDP_RELAY_VERSION = 1;
+/** Message start, version, data and parity chunk counts, chunk index, compact block size and hash */
+static const size_t UDP_RELAY_HEADER_SIZE = 4 + 1 + 1 + 1 + 1 + 4 + 32;
+/** A packet: its header, a chunk and the tag authenticating them */
+static const size_t UDP_RELAY_PACKET_SIZE = UDP_RELAY_HEADER_SIZE + UDP_RELAY_CHUNK_SIZE + 8;
+/** Size of the socket receive buffers, to take in the chunks of a few blocks at once */
+static const int UDP_RELAY_RECEIVE_BUFFER = 4 * 1024 * 1024;
+
+CUDPRelay::CUDPRelay(const std::vector<CService>& peersIn, uint16_t nPortIn, const std::string& strKey) : peers(peersIn), nPort(nPortIn)
+{
+    uint8_t key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write((const uint8_t*)strKey.data(), strKey.size()).Finalize(key);
+    nKey0 = ReadLE64(key);
+    nKey1 = ReadLE64(key + 8);
+}
+
+CUDPRelay::~CUDPRelay()
+{
+    Stop();
+}
+
+/** Open a UDP socket of family bound to port on every address, or INVALID_SOCKET. */
+static SOCKET BindRelaySocket(int family, uint16_t nPort)
+{
+    SOCKET sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET)
+        return sock;
+    int nOne = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (sockopt_arg_type)&nOne, sizeof(int));
+#ifdef IPV6_V6ONLY
+    if (family == AF_INET6)
+        setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, (sockopt_arg_type)&nOne, sizeof(int));
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (sockopt_arg_type)&UDP_RELAY_RECEIVE_BUFFER, sizeof(int));
+
+    const CService addrBind = family == AF_INET6 ? CService(in6addr_any, nPort) : CService(in_addr{INADDR_ANY}, nPort);
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!addrBind.GetSockAddr((struct sockaddr*)&sockaddr, &len) || bind(sock, (struct sockaddr*)&sockaddr, len) == SOCKET_ERROR) {
+        LogPrintf("UDP relay: unable to bind to %s: %s\n", addrBind.ToString(), NetworkErrorString(WSAGetLastError()));
+        CloseSocket(sock);
+    }
+    return sock;
+}
+
+bool CUDPRelay::Start(std::string& strError)
+{
+    sock4 = BindRelaySocket(AF_INET, nPort);
+    sock6 = BindRelaySocket(AF_INET6, nPort);
+    if (sock4 == INVALID_SOCKET && sock6 == INVALID_SOCKET) {
+        strError = strprintf("Unable to bind to UDP port %u for -udprelay", nPort);
+        return false;
+    }
+    for (const CService& peer : peers) {
+        if ((peer.IsIPv4() ? sock4 : sock6) == INVALID_SOCKET) {
+            strError = strprintf("No UDP socket to reach -udprelay peer %s", peer.ToString());
+            Stop();
+            return false;
+        }
+    }
+    fStop = false;
+    threadReceive = std::thread(&TraceThread<std::function<void()>>, "udprelay", std::function<void()>(std::bind(&CUDPRelay::ThreadReceive, this)));
+    threadSend = std::thread(&TraceThread<std::function<void()>>, "udpsend", std::function<void()>(std::bind(&CUDPRelay::ThreadSend, this)));
+    LogPrintf("UDP relay: listening on port %u, relaying to %u peers\n", nPort, peers.size());
+    return true;
+}
+
+void CUDPRelay::Stop()
+{
+    {
+        LOCK(cs_send);
+        fStop = true;
+    }
+    condSend.notify_all();
+    if (threadReceive.joinable())
+        threadReceive.join();
+    if (threadSend.joinable())
+        threadSend.join();
+    if (sock4 != INVALID_SOCKET)
+        CloseSocket(sock4);
+    if (sock6 != INVALID_SOCKET)
+        CloseSocket(sock6);
+}
+
+uint64_t CUDPRelay::PacketTag(const uint8_t* packet, size_t nSize) const
+{
+    return CSipHasher(nKey0, nKey1).Write(packet, nSize).Finalize();
+}
+
+bool CUDPRelay::IsPeer(const CService& addr) const
+{
+    return std::any_of(peers.begin(), peers.end(), [&addr](const CService& peer) {
+        return static_cast<const CNetAddr&>(peer) == static_cast<const CNetAddr&>(addr);
+    });
+}
+
+std::vector<std::vector<uint8_t>> CUDPRelay::MakePackets(const uint256& hash, const CBlockHeaderAndShortTxIDs& cmpctblock) const
+{
+    std::vector<uint8_t> data;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, data, 0, cmpctblock);
+    const size_t nData = std::max<size_t>(1, (data.size() + UDP_RELAY_CHUNK_SIZE - 1) / UDP_RELAY_CHUNK_SIZE);
+    if (nData > MAX_UDP_RELAY_DATA_CHUNKS)
+        return {};
+    const size_t nParity = std::max(MIN_UDP_RELAY_PARITY, (nData * UDP_RELAY_FEC_OVERHEAD + 99) / 100);
+    const CFECCode code(nData, nParity, UDP_RELAY_CHUNK_SIZE);
+    const std::vector<std::vector<uint8_t>> chunks = code.Encode(data);
+
+    std::vector<std::vector<uint8_t>> packets;
+    packets.reserve(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        std::vector<uint8_t> packet(UDP_RELAY_PACKET_SIZE);
+        memcpy(packet.data(), Params().MessageStart(), 4);
+        packet[4] = UDP_RELAY_VERSION;
+        packet[5] = nData;
+        packet[6] = nParity;
+        packet[7] = i;
+        WriteLE32(packet.data() + 8, data.size());
+        memcpy(packet.data() + 12, hash.begin(), 32);
+        memcpy(packet.data() + UDP_RELAY_HEADER_SIZE, chunks[i].data(), UDP_RELAY_CHUNK_SIZE);
+        WriteLE64(packet.data() + UDP_RELAY_HEADER_SIZE + UDP_RELAY_CHUNK_SIZE, PacketTag(packet.data(), UDP_RELAY_HEADER_SIZE + UDP_RELAY_CHUNK_SIZE));
+        packets.push_back(std::move(packet));
+    }
+    return packets;
+}
+
+bool CUDPRelay::ProcessPacket(const uint8_t* packet, size_t nSize, uint256& hash, std::vector<uint8_t>& data)
+{
+    static CMetricCounter& metricBad = GetMetrics().Counter("udprelay_bad_packets", "UDP relay packets dropped as malformed or not authenticated");
+    static CMetricCounter& metricRecovered = GetMetrics().Counter("udprelay_chunks_recovered", "Data chunks of compact blocks recovered from parity over UDP");
+    static CMetricHistogram& metricAssembly = GetMetrics().Histogram("udprelay_assembly_us", "Time from the first chunk of a compact block received over UDP to its reassembly, in microseconds");
+
+    if (nSize != UDP_RELAY_PACKET_SIZE || memcmp(packet, Params().MessageStart(), 4) || packet[4] != UDP_RELAY_VERSION ||
+        ReadLE64(packet + UDP_RELAY_HEADER_SIZE + UDP_RELAY_CHUNK_SIZE) != PacketTag(packet, UDP_RELAY_HEADER_SIZE + UDP_RELAY_CHUNK_SIZE)) {
+        metricBad.Add();
+        return false;
+    }
+    const size_t nData = packet[5], nParity = packet[6], nIndex = packet[7];
+    const uint32_t nBlockSize = ReadLE32(packet + 8);
+    if (nData == 0 || nData > MAX_UDP_RELAY_DATA_CHUNKS || nData + nParity > MAX_FEC_CHUNKS || nIndex >= nData + nParity ||
+        nBlockSize > nData * UDP_RELAY_CHUNK_SIZE) {
+        metricBad.Add();
+        return false;
+    }
+    memcpy(hash.begin(), packet + 12, 32);
+    if (setRecentBlocks.count(hash))
+        return false;
+
+    auto it = mapPartial.find(hash);
+    if (it == mapPartial.end()) {
+        if (mapPartial.size() >= MAX_UDP_RELAY_PARTIAL_BLOCKS) {
+            mapPartial.erase(std::min_element(mapPartial.begin(), mapPartial.end(), [](const std::pair<const uint256, PartialBlock>& a, const std::pair<const uint256, PartialBlock>& b) {
+                return a.second.nFirstTime < b.second.nFirstTime;
+            }));
+        }
+        PartialBlock partial;
+        partial.nData = nData;
+        partial.nParity = nParity;
+        partial.nSize = nBlockSize;
+        partial.nFirstTime = GetTimeMicros();
+        it = mapPartial.emplace(hash, std::move(partial)).first;
+    }
+    PartialBlock& partial = it->second;
+    if (partial.nData != nData || partial.nParity != nParity || partial.nSize != nBlockSize) {
+        metricBad.Add();
+        return false;
+    }
+    partial.chunks.emplace(nIndex, std::vector<uint8_t>(packet + UDP_RELAY_HEADER_SIZE, packet + UDP_RELAY_HEADER_SIZE + UDP_RELAY_CHUNK_SIZE));
+    if (partial.chunks.size() < nData)
+        return false;
+
+    const CFECCode code(nData, nParity, UDP_RELAY_CHUNK_SIZE);
+    const bool fDecoded = code.Decode(partial.chunks, nBlockSize, data);
+    if (fDecoded) {
+        const size_t nReceived = std::distance(partial.chunks.begin(), partial.chunks.lower_bound(nData));
+        metricRecovered.Add(nData - nReceived);
+        metricAssembly.Record(GetTimeMicros() - partial.nFirstTime);
+    }
+    mapPartial.erase(it);
+    recentBlocks.push_back(hash);
+    setRecentBlocks.insert(hash);
+    if (recentBlocks.size() > MAX_UDP_RELAY_RECENT_BLOCKS) {
+        setRecentBlocks.erase(recentBlocks.front());
+        recentBlocks.pop_front();
+    }
+    return fDecoded;
+}
+
+void CUDPRelay::ProcessCompactBlock(const uint256& hash, const std::vector<uint8_t>& data)
+{
+    static CMetricCounter& metricBlocks = GetMetrics().Counter("udprelay_blocks_received", "Blocks rebuilt from their compact block received over UDP");
+    static CMetricCounter& metricMissing = GetMetrics().Counter("udprelay_blocks_incomplete", "Compact blocks received over UDP missing transactions from the mempool, left to TCP");
+
+    CBlockHeaderAndShortTxIDs cmpctblock;
+    try {
+        CDataStream(data, SER_NETWORK, PROTOCOL_VERSION) >> cmpctblock;
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::NET, "UDP relay: malformed compact block %s: %s\n", hash.ToString(), e.what());
+        return;
+    }
+    if (cmpctblock.header.GetHash() != hash)
+        return;
+
+    {
+        LOCK(cs_main);
+        // A block that does not connect is fetched with its ancestors over TCP.
+        if (!LookupBlockIndex(cmpctblock.header.hashPrevBlock))
+            return;
+        const CBlockIndex* pindex = LookupBlockIndex(hash);
+        if (pindex && (pindex->nStatus & BLOCK_HAVE_DATA))
+            return;
+    }
+
+    const CBlockIndex* pindex = nullptr;
+    CValidationState state;
+    if (!ProcessNewBlockHeaders({cmpctblock.header}, state, Params(), &pindex)) {
+        LogPrint(BCLog::NET, "UDP relay: invalid header %s: %s\n", hash.ToString(), FormatStateMessage(state));
+        return;
+    }
+    if (fHeadersOnly)
+        return;
+
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    {
+        LOCK(cs_main);
+        PartiallyDownloadedBlock partialBlock(&mempool);
+        if (partialBlock.InitData(cmpctblock, {}) != READ_STATUS_OK)
+            return;
+        for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+            if (!partialBlock.IsTxAvailable(i)) {
+                metricMissing.Add();
+                LogPrint(BCLog::NET, "UDP relay: compact block %s misses transactions, left to TCP\n", hash.ToString());
+                return;
+            }
+        }
+        std::vector<CTransactionRef> vMissing;
+        if (partialBlock.FillBlock(*pblock, vMissing) != READ_STATUS_OK)
+            return;
+    }
+
+    // Like a block received over TCP, one early for its deadline waits in the block cache.
+    bool fNewBlock = false;
+    ProcessNewBlock(Params(), pblock, true, &fNewBlock);
+    if (fNewBlock) {
+        metricBlocks.Add();
+        LogPrint(BCLog::NET, "UDP relay: received block %s\n", hash.ToString());
+    }
+}
+
+void CUDPRelay::ThreadReceive()
+{
+    static CMetricCounter& metricPackets = GetMetrics().Counter("udprelay_packets_received", "Packets received from UDP relay peers");
+
+    std::vector<uint8_t> buffer(UDP_RELAY_PACKET_SIZE + 1);
+    while (!fStop) {
+        fd_set setRecv;
+        FD_ZERO(&setRecv);
+        SOCKET sockMax = 0;
+        for (SOCKET sock : {sock4, sock6}) {
+            if (sock != INVALID_SOCKET) {
+                FD_SET(sock, &setRecv);
+                sockMax = std::max(sockMax, sock);
+            }
+        }
+        struct timeval timeout = MillisToTimeval(200);
+        if (select(sockMax + 1, &setRecv, nullptr, nullptr, &timeout) <= 0)
+            continue;
+
+        for (SOCKET sock : {sock4, sock6}) {
+            if (sock == INVALID_SOCKET || !FD_ISSET(sock, &setRecv))
+                continue;
+            struct sockaddr_storage sockaddr;
+            socklen_t len = sizeof(sockaddr);
+            const int nRecv = recvfrom(sock, (char*)buffer.data(), buffer.size(), 0, (struct sockaddr*)&sockaddr, &len);
+            CService from;
+            if (nRecv <= 0 || !from.SetSockAddr((const struct sockaddr*)&sockaddr) || !IsPeer(from))
+                continue;
+            metricPackets.Add();
+            if (fImporting || fReindex || IsInitialBlockDownload())
+                continue;
+            uint256 hash;
+            std::vector<uint8_t> data;
+            if (ProcessPacket(buffer.data(), nRecv, hash, data))
+                ProcessCompactBlock(hash, data);
+        }
+    }
+}
+
+void CUDPRelay::ThreadSend()
+{
+    static CMetricCounter& metricPackets = GetMetrics().Counter("udprelay_packets_sent", "Packets sent to UDP relay peers");
+
+    while (true) {
+        std::vector<std::vector<uint8_t>> packets;
+        {
+            WAIT_LOCK(cs_send, lock);
+            while (!fStop && queueSend.empty())
+                condSend.wait(lock);
+            if (fStop)
+                return;
+            packets = std::move(queueSend.front());
+            queueSend.pop_front();
+        }
+        for (const CService& peer : peers) {
+            struct sockaddr_storage sockaddr;
+            socklen_t len = sizeof(sockaddr);
+            if (!peer.GetSockAddr((struct sockaddr*)&sockaddr, &len))
+                continue;
+            const SOCKET sock = peer.IsIPv4() ? sock4 : sock6;
+            for (const std::vector<uint8_t>& packet : packets) {
+                if (sendto(sock, (const char*)packet.data(), packet.size(), MSG_NOSIGNAL, (const struct sockaddr*)&sockaddr, len) == (int)packet.size())
+                    metricPackets.Add();
+            }
+        }
+    }
+}
+
+void CUDPRelay::NewPoWValidBlock(const CBlockIndex* pindex, const std::shared_ptr<const CBlock>& block)
+{
+    static CMetricCounter& metricBlocks = GetMetrics().Counter("udprelay_blocks_sent", "Blocks sent to UDP relay peers");
+    static CMetricCounter& metricTooLarge = GetMetrics().Counter("udprelay_blocks_too_large", "Blocks whose compact block is too large to relay over UDP");
+
+    const CBlockHeaderAndShortTxIDs cmpctblock(*block, true);
+    std::vector<std::vector<uint8_t>> packets = MakePackets(pindex->GetBlockHash(), cmpctblock);
+    if (packets.empty()) {
+        metricTooLarge.Add();
+        return;
+    }
+    metricBlocks.Add();
+    {
+        LOCK(cs_send);
+        queueSend.push_back(std::move(packets));
+    }
+    condSend.notify_one();
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_UDPRELAY_H
+#define LAVA_UDPRELAY_H
+
+#include <compat.h>
+#include <netaddress.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CBlockHeaderAndShortTxIDs;
+
+/** Bytes of a compact block carried by a packet, so a packet fits the minimum IPv6 MTU */
+static const size_t UDP_RELAY_CHUNK_SIZE = 1152;
+/** Parity chunks sent along with a compact block, in percent of its data chunks */
+static const unsigned int UDP_RELAY_FEC_OVERHEAD = 25;
+/** Fewest parity chunks sent along with a compact block */
+static const size_t MIN_UDP_RELAY_PARITY = 2;
+/** Most data chunks of a compact block relayed over UDP, larger ones are left to TCP */
+static const size_t MAX_UDP_RELAY_DATA_CHUNKS = 200;
+/** Most compact blocks reassembled at once, the oldest one is dropped first */
+static const size_t MAX_UDP_RELAY_PARTIAL_BLOCKS = 16;
+/** Blocks remembered as reconstructed, so their late chunks are dropped unread */
+static const size_t MAX_UDP_RELAY_RECENT_BLOCKS = 64;
+
+/**
+ * Relay of new blocks over UDP between trusted peers (-udprelay), for forgers racing to
+ * have their block accepted first. A block is sent as its compact block, cut into chunks
+ * with forward error correction: a peer rebuilds it from any of them as many as there
+ * are data chunks, without waiting for lost packets to be sent again or for a TCP window
+ * to open. Blocks are sent as soon as their header and merkle root are checked, before
+ * they are connected, so one waiting for its deadline reaches the other peers' block
+ * caches during the wait.
+ *
+ * A rebuilt compact block is filled from the mempool and processed like a block received
+ * over TCP. When transactions are missing, only its header is processed, and the block
+ * is left to be fetched over TCP. Packets are authenticated with a key shared by the mesh
+ * (-udprelaykey) and only accepted from the addresses of the configured peers.
+ */
+class CUDPRelay final : public CValidationInterface
+{
+public:
+    CUDPRelay(const std::vector<CService>& peersIn, uint16_t nPortIn, const std::string& strKey);
+    ~CUDPRelay();
+
+    /** Bind the relay port and start the threads. */
+    bool Start(std::string& strError);
+    /** Stop the threads and close the sockets. */
+    void Stop();
+
+    /** Build the packets relaying the compact block of hash, empty if it is too large for UDP. */
+    std::vector<std::vector<uint8_t>> MakePackets(const uint256& hash, const CBlockHeaderAndShortTxIDs& cmpctblock) const;
+
+    /**
+     * Take in a packet received from a configured peer. Once enough of its chunks are in,
+     * the serialized compact block is returned in data, with its hash.
+     */
+    bool ProcessPacket(const uint8_t* packet, size_t nSize, uint256& hash, std::vector<uint8_t>& data);
+
+protected:
+    void NewPoWValidBlock(const CBlockIndex* pindex, const std::shared_ptr<const CBlock>& block) override;
+
+private:
+    /** The chunks of a compact block received so far */
+    struct PartialBlock
+    {
+        size_t nData;
+        size_t nParity;
+        uint32_t nSize;
+        int64_t nFirstTime;         //!< when its first chunk arrived, in microseconds
+        std::map<size_t, std::vector<uint8_t>> chunks;
+    };
+
+    uint64_t PacketTag(const uint8_t* packet, size_t nSize) const;
+    bool IsPeer(const CService& addr) const;
+    void ThreadReceive();
+    void ThreadSend();
+    void ProcessCompactBlock(const uint256& hash, const std::vector<uint8_t>& data);
+
+    const std::vector<CService> peers;
+    const uint16_t nPort;
+    uint64_t nKey0, nKey1;
+
+    SOCKET sock4 = INVALID_SOCKET;
+    SOCKET sock6 = INVALID_SOCKET;
+    std::atomic<bool> fStop{false};
+    std::thread threadReceive;
+    std::thread threadSend;
+
+    //! Reassembly state, only touched by the receive thread
+    std::map<uint256, PartialBlock> mapPartial;
+    std::deque<uint256> recentBlocks;
+    std::set<uint256> setRecentBlocks;
+
+    //! The packets of the blocks to send, to every peer
+    Mutex cs_send;
+    std::condition_variable condSend;
+    std::deque<std::vector<std::vector<uint8_t>>> queueSend GUARDED_BY(cs_send);
+};
+
+/** The UDP block relay, if -udprelay is set */
+extern std::unique_ptr<CUDPRelay> g_udp_relay;
+
+#endif // LAVA_UDPRELAY_H
@@ -68,6 +68,7 @@
 #include <malloc.h>
 #endif
 
+#include <sstream>
 #include <thread>
 
 // Application startup time (used for uptime calculation)
@@ -1203,6 +1204,43 @@ int GetNumCores()
     return std::thread::hardware_concurrency();
 }
 
+bool ParseCPUList(const std::string& str, std::vector<int>& cpus)
+{
+    cpus.clear();
+    std::stringstream ss(str);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        const size_t dash = range.find('-');
+        int32_t first, last;
+        if (!ParseInt32(range.substr(0, dash), &first)) return false;
+        if (dash == std::string::npos) {
+            last = first;
+        } else if (!ParseInt32(range.substr(dash + 1), &last)) {
+            return false;
+        }
+        if (first < 0 || last < first) return false;
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return !cpus.empty();
+}
+
+bool SetThreadAffinity(int cpu)
+{
+#if defined(__linux__) && defined(CPU_SET)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // On Linux pid 0 stands for the calling thread, not the whole process.
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
 std::string CopyrightHolders(const std::string& strPrefix)
 {
     std::string strCopyrightHolders = strPrefix + strprintf(_(COPYRIGHT_HOLDERS), _(COPYRIGHT_HOLDERS_SUBSTITUTION));
@@ -317,6 +317,18 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
  */
 int GetNumCores();
 
+/**
+ * Parse a list of CPU numbers like "0-3,8,10-11" into cpus, in order.
+ * @return false if the list is empty or malformed
+ */
+bool ParseCPUList(const std::string& str, std::vector<int>& cpus);
+
+/**
+ * Pin the calling thread to one CPU, so the memory it first touches stays on the NUMA node
+ * of that CPU. Returns false, and leaves the thread alone, where not supported.
+ */
+bool SetThreadAffinity(int cpu);
+
 void RenameThread(const char* name);
 
 /**
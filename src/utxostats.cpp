@@ -0,0 +1,85 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxostats.h>
+
+#include <coins.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <undo.h>
+#include <version.h>
+
+std::vector<unsigned char> SerializeUTXOStatsElement(const COutPoint& outpoint, const Coin& coin)
+{
+    // Only what the chainstate keeps of a coin is committed to, so a scan of the chainstate
+    // gives the same hash.
+    std::vector<unsigned char> data;
+    CVectorWriter writer(SER_DISK, PROTOCOL_VERSION, data, 0);
+    writer << outpoint << uint32_t(coin.nHeight * 2 + coin.fCoinBase) << coin.out.nValue << coin.out.scriptPubKey << coin.out.flags;
+    if (coin.out.IsCA())
+        writer << coin.out.nAsset << coin.out.nValueCA;
+    return data;
+}
+
+static void ApplyCoin(CUTXOStats& stats, const Coin& coin, int sign)
+{
+    stats.nTransactionOutputs += sign;
+    stats.nBogoSize += sign * int64_t(32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+                                      2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */);
+    if (!coin.out.IsCA()) {
+        stats.nTotalAmount += sign * coin.out.nValue;
+    } else if (coin.out.nAsset.IsExplicit() && coin.out.nValueCA.IsExplicit()) {
+        const CAsset& asset = coin.out.nAsset.GetAsset();
+        if ((stats.assetAmounts[asset] += sign * coin.out.nValueCA.GetAmount()) == 0)
+            stats.assetAmounts.erase(asset);
+    } else {
+        stats.nConfidentialOutputs += sign;
+    }
+}
+
+void CUTXOStats::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    const std::vector<unsigned char> element = SerializeUTXOStatsElement(outpoint, coin);
+    muhash.Insert(element.data(), element.size());
+    ApplyCoin(*this, coin, 1);
+}
+
+void CUTXOStats::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    const std::vector<unsigned char> element = SerializeUTXOStatsElement(outpoint, coin);
+    muhash.Remove(element.data(), element.size());
+    ApplyCoin(*this, coin, -1);
+}
+
+void CUTXOStats::ConnectBlock(const CBlock& block, const CBlockUndo& blockundo, int nHeight)
+{
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        if (i > 0) {
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                RemoveCoin(tx.vin[j].prevout, blockundo.vtxundo[i - 1].vprevout[j]);
+            }
+        }
+        // Like AddCoins, leave out the outputs that can never be spent.
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            if (!tx.vout[o].scriptPubKey.IsUnspendable())
+                AddCoin(COutPoint(tx.GetHash(), o), Coin(tx.vout[o], nHeight, tx.IsCoinBase()));
+        }
+    }
+}
+
+CUTXOStats& CUTXOStats::operator+=(const CUTXOStats& delta)
+{
+    hashBlock = delta.hashBlock;
+    muhash *= delta.muhash;
+    nTransactionOutputs += delta.nTransactionOutputs;
+    nBogoSize += delta.nBogoSize;
+    nTotalAmount += delta.nTotalAmount;
+    nConfidentialOutputs += delta.nConfidentialOutputs;
+    for (const CAssetAmount& entry : delta.assetAmounts) {
+        if ((assetAmounts[entry.first] += entry.second) == 0)
+            assetAmounts.erase(entry.first);
+    }
+    return *this;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2019 The Lava Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LAVA_UTXOSTATS_H
+#define LAVA_UTXOSTATS_H
+
+#include <amount.h>
+#include <asset.h>
+#include <crypto/muhash.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+class Coin;
+class COutPoint;
+
+/**
+ * Statistics of the UTXO set that are kept up to date block by block, so gettxoutsetinfo
+ * answers at once instead of reading the whole chainstate. The set itself is committed
+ * to by a MuHash of its coins. As all the statistics add up, a CUTXOStats also stands for
+ * the changes made by some blocks, and adding those to the statistics of the set before
+ * them gives the statistics after them.
+ */
+class CUTXOStats
+{
+public:
+    //! The block the set is up to, or the last block of the changes
+    uint256 hashBlock;
+    MuHash3072 muhash;
+    uint64_t nTransactionOutputs = 0;
+    uint64_t nBogoSize = 0;
+    //! The LV of the outputs
+    CAmount nTotalAmount = 0;
+    //! The explicit amounts of the outputs of issued assets, by asset
+    CAmountMap assetAmounts;
+    //! Outputs of issued assets whose asset or amount is blinded, left out of assetAmounts
+    uint64_t nConfidentialOutputs = 0;
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+
+    /** Apply the changes of a block connected at the given height, given its undo data. */
+    void ConnectBlock(const CBlock& block, const CBlockUndo& blockundo, int nHeight);
+
+    /** Add the changes of delta, and move on to its last block. */
+    CUTXOStats& operator+=(const CUTXOStats& delta);
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << hashBlock << muhash << nTransactionOutputs << nBogoSize << nTotalAmount << nConfidentialOutputs;
+        WriteCompactSize(s, assetAmounts.size());
+        for (const CAssetAmount& entry : assetAmounts) {
+            s << entry.first << entry.second;
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s >> hashBlock >> muhash >> nTransactionOutputs >> nBogoSize >> nTotalAmount >> nConfidentialOutputs;
+        assetAmounts.clear();
+        for (uint64_t n = ReadCompactSize(s); n > 0; n--) {
+            CAssetAmount entry;
+            s >> entry.first >> entry.second;
+            assetAmounts[entry.first] = entry.second;
+        }
+    }
+};
+
+/** The bytes of a coin that go into the MuHash of the UTXO set. */
+std::vector<unsigned char> SerializeUTXOStatsElement(const COutPoint& outpoint, const Coin& coin);
+
+#endif // LAVA_UTXOSTATS_H
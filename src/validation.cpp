@@ -6,6 +6,10 @@
 #include <validation.h>
 #include <key_io.h>
 #include <arith_uint256.h>
+#include <blockarchive.h>
+#include <blockfilemap.h>
+#include <blockfilewriter.h>
+#include <blockio.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -14,9 +18,13 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/shabal256.h>
 #include <cuckoocache.h>
+#include <forgetrace.h>
 #include <hash.h>
 #include <index/txindex.h>
+#include <mempooljournal.h>
+#include <metrics.h>
 #include <poc.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
@@ -40,13 +48,21 @@
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <util/trace.h>
+#include <utxostats.h>
 #include <validationinterface.h>
 #include <warnings.h>
 //#include <actiondb.h>
 #include <blockcache.h>
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <future>
+#include <limits>
 #include <sstream>
+#include <thread>
+#include <tuple>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -92,6 +108,56 @@ enum DisconnectResult {
 
 class ConnectTrace;
 
+/** The number of blocks read ahead of the one being connected or disconnected. */
+static const size_t BLOCK_READ_AHEAD = 8;
+
+/**
+ * Blocks about to be connected or disconnected, read on the block I/O threads while the
+ * ones before them are. Reads are taken in the order they were asked for; those asked for
+ * and no longer wanted, as the chain to (dis)connect changed, are dropped.
+ */
+class CBlockReadAhead
+{
+public:
+    explicit CBlockReadAhead(bool fUndoIn) : fUndo(fUndoIn) {}
+
+    /** Make sure the first BLOCK_READ_AHEAD of blocks, in the order they will be taken, are being read. */
+    void Request(const std::vector<const CBlockIndex*>& blocks, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        size_t nKeep = 0;
+        while (nKeep < reads.size() && nKeep < blocks.size() && reads[nKeep].first == blocks[nKeep]) {
+            nKeep++;
+        }
+        reads.resize(nKeep);
+        std::vector<const CBlockIndex*> vRead(blocks.begin() + nKeep, blocks.begin() + std::max(nKeep, std::min(blocks.size(), BLOCK_READ_AHEAD)));
+        std::vector<std::future<BlockRead>> futures = ReadBlocksFromDiskAsync(vRead, fUndo, consensusParams);
+        for (size_t i = 0; i < vRead.size(); i++) {
+            reads.emplace_back(vRead[i], std::move(futures[i]));
+        }
+    }
+
+    /** The read of pindex, if it was asked for next; nothing otherwise. */
+    BlockRead Take(const CBlockIndex* pindex)
+    {
+        BlockRead read;
+        if (reads.empty() || reads.front().first != pindex) {
+            reads.clear();
+            return read;
+        }
+        try {
+            read = reads.front().second.get();
+        } catch (const std::future_error&) {
+            // The read was dropped as the I/O threads were stopped.
+        }
+        reads.pop_front();
+        return read;
+    }
+
+private:
+    const bool fUndo;
+    std::deque<std::pair<const CBlockIndex*, std::future<BlockRead>>> reads;
+};
+
 /**
  * CChainState stores and provides an API to update our local knowledge of the
  * current best chain and header tree.
@@ -154,10 +220,25 @@ private:
      */
     CCriticalSection m_cs_chainstate;
 
+    /** The blocks next to be connected by ActivateBestChainStep, read ahead across its calls. */
+    CBlockReadAhead m_connect_read_ahead GUARDED_BY(cs_main){false};
+
+    /**
+     * The statistics of the UTXO set at the tip. While they are rebuilt from a scan of the
+     * chainstate, they only hold the changes made to it since the scan began.
+     */
+    CUTXOStats m_utxo_stats GUARDED_BY(cs_main);
+    //! Whether the blocks connected and disconnected are applied to m_utxo_stats
+    bool m_utxo_stats_tracked GUARDED_BY(cs_main) = false;
+    //! Whether m_utxo_stats are of the whole UTXO set rather than changes to it
+    bool m_utxo_stats_complete GUARDED_BY(cs_main) = false;
+
 public:
     CChain chainActive;
     CPOCBlockAssember blockAssember;
     BlockMap mapBlockIndex GUARDED_BY(cs_main);
+    //! Owns the entries of mapBlockIndex
+    CBlockIndexArena blockIndexArena GUARDED_BY(cs_main);
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
     CBlockIndex* pindexBestInvalid = nullptr;
 
@@ -169,21 +250,28 @@ public:
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPoc = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
-    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
-    bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, CBlockUndo* pundo = nullptr, CUTXOStats* pstats = nullptr);
+    bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false, CPoCBlockChanges* pocChanges = nullptr, CUTXOStats* pstats = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block disconnection on our pcoinsTip:
-    bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool, BlockRead* pread = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Manual block validity manipulation:
     bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex* pindex) LOCKS_EXCLUDED(cs_main);
     bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindex);
     void ResetBlockFailureFlags(CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    size_t PruneStaleHeaders(const std::set<const CBlockIndex*>& setKeep, int nDepth, int64_t nMinAge) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    // Statistics of the UTXO set at the tip, see CUTXOStats:
+    bool LoadUTXOStats() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool RebuildUTXOStats() LOCKS_EXCLUDED(cs_main);
+    bool GetUTXOStats(CUTXOStats& stats) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
     bool RewindBlockIndex(const CChainParams& params);
     bool LoadGenesisBlock(const CChainParams& chainparams);
@@ -240,6 +328,7 @@ std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
 bool fPruneMode = false;
+bool fHeadersOnly = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
@@ -248,8 +337,10 @@ size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
+bool fClusterMempool = DEFAULT_CLUSTER_MEMPOOL;
 
 uint256 hashAssumeValid;
+uint256 hashAssumePoC;
 arith_uint256 nMinimumCumulativeDiff;
 
 CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE);
@@ -309,9 +400,11 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
+std::unique_ptr<CCoinsViewPrefetch> pcoinsprefetch;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CTicketView> pticketview;
 std::unique_ptr<CRelationView> prelationview;
+std::unique_ptr<CIssuanceView> pissuanceview;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
 enum class FlushStateMode {
@@ -325,9 +418,14 @@ enum class FlushStateMode {
 static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState& state, FlushStateMode mode, int nManualPruneHeight = 0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
-bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks = nullptr);
+bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks = nullptr, CSchnorrBatch* schnorrBatch = nullptr);
+static bool CheckMempoolInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, unsigned int flags, PrecomputedTransactionData& txdata) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 static FILE* OpenUndoFile(const CDiskBlockPos& pos, bool fReadOnly = false);
 
+/** The records of new blocks and of their undo data, held while syncing until they are written together. */
+static CBlockFileWriter g_block_writer(MAX_PENDING_BLOCK_FILE_BYTES);
+static CBlockFileWriter g_undo_writer(MAX_PENDING_BLOCK_FILE_BYTES);
+
 bool CheckFinalTx(const CTransaction& tx, int flags)
 {
     AssertLockHeld(cs_main);
@@ -759,6 +857,20 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
         }
 
+        // In cluster mode the cluster the transaction joins is bounded too, which bounds
+        // the cost of linearizing it when mining or trimming the mempool.
+        if (fClusterMempool) {
+            CTxMemPool::setEntries setCluster;
+            for (CTxMemPool::txiter ancestorIt : setAncestors) {
+                pool.CalculateCluster(ancestorIt, setCluster);
+            }
+            const size_t nLimitCluster = gArgs.GetArg("-limitclustercount", DEFAULT_CLUSTER_LIMIT);
+            if (setCluster.size() + 1 > nLimitCluster) {
+                return state.DoS(0, false, REJECT_NONSTANDARD, "too-large-mempool-cluster", false,
+                    strprintf("%u transactions in cluster, limit %u", setCluster.size() + 1, nLimitCluster));
+            }
+        }
+
         // A transaction that spends outputs that would be replaced by it is invalid. Now
         // that we have the set of all ancestors we can detect this
         // pathological case by making sure setConflicts and setAncestors don't
@@ -889,7 +1001,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+        if (!CheckMempoolInputs(tx, state, view, scriptVerifyFlags, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
@@ -947,7 +1059,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // - the transaction is not dependent on any other transactions in the mempool
         bool validForFeeEstimation = !fReplacementTransaction && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
 
-        // Store transaction in memory
+        // Store transaction in memory, with its signature hash data for when it is mined
+        entry.SetTxData(txdata);
         pool.addUnchecked(entry, setAncestors, validForFeeEstimation);
 
         // trim mempool and check if tx was trimmed
@@ -980,10 +1093,106 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
 
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransactionRef& tx, bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced, bool bypass_limits, const CAmount nAbsurdFee, bool test_accept)
 {
+    static CMetricHistogram& metric = GetMetrics().Histogram("mempool_accept", "Time to accept a transaction to the mempool, or reject it");
+    CMetricTimer timer(metric);
     const CChainParams& chainparams = Params();
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, test_accept);
 }
 
+bool AcceptPackageToMemoryPool(CTxMemPool& pool, CValidationState& state, const std::vector<CTransactionRef>& package, bool* pfMissingInputs, const CAmount nAbsurdFee)
+{
+    AssertLockHeld(cs_main);
+    LOCK(pool.cs);
+    if (pfMissingInputs) {
+        *pfMissingInputs = false;
+    }
+
+    if (package.empty() || package.size() > MAX_PACKAGE_COUNT)
+        return state.DoS(0, false, REJECT_NONSTANDARD, "package-too-many-transactions");
+    int64_t nPackageSize = 0;
+    std::set<uint256> setLater;
+    for (const CTransactionRef& ptx : package) {
+        nPackageSize += GetVirtualTransactionSize(*ptx);
+        if (!setLater.insert(ptx->GetHash()).second)
+            return state.DoS(100, false, REJECT_INVALID, "package-duplicate-transaction");
+    }
+    if (nPackageSize > MAX_PACKAGE_SIZE * 1000)
+        return state.DoS(0, false, REJECT_NONSTANDARD, "package-too-large");
+
+    // The transactions new to the mempool, with their fees, spending the chain, the mempool or the ones before them.
+    std::vector<CTransactionRef> vNew;
+    CAmount nNewFees = 0;
+    int64_t nNewSize = 0;
+    {
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        CCoinsViewCache view(&viewMemPool);
+        std::set<COutPoint> setSpent;
+        for (const CTransactionRef& ptx : package) {
+            setLater.erase(ptx->GetHash());
+            for (const CTxIn& txin : ptx->vin) {
+                if (setLater.count(txin.prevout.hash))
+                    return state.DoS(100, false, REJECT_INVALID, "package-not-sorted");
+                if (!setSpent.insert(txin.prevout).second)
+                    return state.DoS(100, false, REJECT_INVALID, "package-conflict");
+            }
+            if (pool.exists(ptx->GetHash()))
+                continue;
+
+            CAmount nValueIn = 0;
+            for (const CTxIn& txin : ptx->vin) {
+                // Replacing mempool transactions is left to the transactions alone, a package cannot be undone after it.
+                if (pool.GetConflictTx(txin.prevout))
+                    return state.Invalid(false, REJECT_DUPLICATE, "package-mempool-conflict");
+                const Coin& coin = view.AccessCoin(txin.prevout);
+                if (coin.IsSpent()) {
+                    if (pfMissingInputs) {
+                        *pfMissingInputs = true;
+                    }
+                    return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
+                }
+                nValueIn += coin.out.nValue;
+            }
+            CAmount nFee = nValueIn - ptx->GetValueOut();
+            pool.ApplyDelta(ptx->GetHash(), nFee);
+            nNewFees += nFee;
+            nNewSize += GetVirtualTransactionSize(*ptx);
+            AddCoins(view, *ptx, MEMPOOL_HEIGHT);
+            vNew.push_back(ptx);
+        }
+    }
+    if (vNew.empty())
+        return state.Invalid(false, REJECT_DUPLICATE, "txn-already-in-mempool");
+
+    CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nNewSize);
+    if (mempoolRejectFee > 0 && nNewFees < mempoolRejectFee) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "package mempool min fee not met", false, strprintf("%d < %d", nNewFees, mempoolRejectFee));
+    }
+    if (nNewFees < ::minRelayTxFee.GetFee(nNewSize)) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "package min relay fee not met", false, strprintf("%d < %d", nNewFees, ::minRelayTxFee.GetFee(nNewSize)));
+    }
+
+    // The fee of each transaction was judged with the package, add them past the fee limits and trim the mempool once.
+    const CChainParams& chainparams = Params();
+    for (size_t i = 0; i < vNew.size(); i++) {
+        if (!AcceptToMemoryPoolWithTime(chainparams, pool, state, vNew[i], pfMissingInputs, GetTime(), nullptr, true /* bypass_limits */, nAbsurdFee, false)) {
+            for (size_t j = i; j-- > 0;) {
+                pool.removeRecursive(*vNew[j]);
+            }
+            return false;
+        }
+    }
+    LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    for (const CTransactionRef& ptx : vNew) {
+        if (!pool.exists(ptx->GetHash())) {
+            for (const CTransactionRef& ptxRemove : vNew) {
+                pool.removeRecursive(*ptxRemove);
+            }
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+        }
+    }
+    return true;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1026,42 +1235,84 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
 
 static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
-    // Open history file to append
-    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("WriteBlockToDisk: OpenBlockFile failed");
+    // Serialize index header and block
+    unsigned int nSize = GetSerializeSize(block, CLIENT_VERSION);
+    std::vector<uint8_t> record;
+    record.reserve(8 + nSize);
+    CVectorWriter writer(SER_DISK, CLIENT_VERSION, record, 0);
+    writer << messageStart << nSize << block;
 
-    // Write index header
-    unsigned int nSize = GetSerializeSize(block, fileout.GetVersion());
-    fileout << messageStart << nSize;
-
-    // Write block
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("WriteBlockToDisk: ftell failed");
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    // Append to history file; while syncing, the records of several blocks are written at once
+    if (!g_block_writer.Append(pos.nFile, GetBlockPosFilename(pos, "blk"), pos.nPos, std::move(record), !IsInitialBlockDownload()))
+        return error("WriteBlockToDisk: write failed at %s", pos.ToString());
+    pos.nPos += 8;
 
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const int height, const Consensus::Params& consensusParams)
+static CBlockFileMap g_block_file_map(MAX_MAPPED_BLOCK_FILES);
+
+/** Map block file nFile for reading, unless it is still being written to. */
+static std::shared_ptr<const CMappedFile> MapBlockFile(int nFile)
 {
-    block.SetNull();
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile >= nLastBlockFile)
+            return nullptr;
+    }
+    return g_block_file_map.Get(nFile, GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"));
+}
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+static CBlockFileCache<CArchivedBlockFile> g_block_archive_map(MAX_MAPPED_BLOCK_FILES);
 
-    // Read block
+/** Path of the archive of block file nFile (blk?????.zst) */
+static fs::path GetBlockArchiveFilename(int nFile)
+{
+    return fs::path(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk")).replace_extension(".zst");
+}
+
+/** Open the archive of block file nFile, if it was archived. */
+static std::shared_ptr<const CArchivedBlockFile> OpenBlockArchive(int nFile)
+{
+    if (!CanArchiveBlockFiles())
+        return nullptr;
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile >= nLastBlockFile)
+            return nullptr;
+    }
+    return g_block_archive_map.Get(nFile, GetBlockArchiveFilename(nFile));
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const int height, const Consensus::Params& consensusParams, bool fCheckPoc)
+{
+    block.SetNull();
+
+    // The block is always decoded from memory: from its mapped block file, or else from a
+    // buffer the whole record is read into at once, rather than reading the file field by field.
+    std::shared_ptr<const CMappedFile> mapped = MapBlockFile(pos.nFile);
+    std::vector<uint8_t> buffer;
     try {
-        filein >> block;
+        Span<const uint8_t> data;
+        if (mapped) {
+            data = mapped->Data();
+            if (pos.nPos > (uint64_t)data.size())
+                throw std::ios_base::failure("position beyond the end of the file");
+            data = data.subspan(pos.nPos);
+        } else {
+            if (!ReadRawBlockFromDisk(buffer, pos, Params().MessageStart()))
+                return error("ReadBlockFromDisk: Failed to read block at %s", pos.ToString());
+            data = Span<const uint8_t>(buffer.data(), buffer.size());
+        }
+        SpanReader reader(SER_DISK, CLIENT_VERSION, data);
+        reader >> block;
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
+    if (!fCheckPoc)
+        return true;
     auto params = Params();
     bool pocxFlag = false;
     if (height >= consensusParams.LVIP05Height){
@@ -1078,24 +1329,148 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const int height
     return true;
 }
 
+/**
+ * Whether the proof of capacity of pindex is trusted without verifying it, as -assumevalid
+ * does for scripts: pindex is an ancestor of the -assumepoc block and of a best header with
+ * the minimum cumulative difficulty, buried under two weeks of it. The trust is never written
+ * to the block index, so setting -assumepoc=0 verifies every block again. Headers are always
+ * verified, as those of the assumed chain arrive before the assumed block is known.
+ */
+static bool IsPoCAssumed(const CBlockIndex* pindex, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    if (hashAssumePoC.IsNull() || pindex == nullptr || pindexBestHeader == nullptr)
+        return false;
+    const CBlockIndex* pindexAssumed = LookupBlockIndex(hashAssumePoC);
+    return pindexAssumed && pindexAssumed->GetAncestor(pindex->nHeight) == pindex &&
+        pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
+        pindexBestHeader->nCumulativeDiff >= nMinimumCumulativeDiff &&
+        GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) > 60 * 60 * 24 * 7 * 2;
+}
+
+/** Remember that the proof of capacity of pindex was verified, on a block read back from disk. */
+static void SetPoCValid(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    CBlockIndex* pindexVerified = LookupBlockIndex(pindex->GetBlockHash());
+    if (pindexVerified && !(pindexVerified->nStatus & BLOCK_POC_VALID)) {
+        pindexVerified->nStatus |= BLOCK_POC_VALID;
+        setDirtyBlockIndex.insert(pindexVerified);
+    }
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
+    bool fCheckPoc;
     {
         LOCK(cs_main);
         blockPos = pindex->GetBlockPos();
+        fCheckPoc = !(pindex->nStatus & BLOCK_POC_VALID) && !IsPoCAssumed(pindex, consensusParams);
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, pindex->nHeight, consensusParams))
+    // Once the proof of capacity of a block has been verified, matching the hash of the
+    // index is enough to know the header read back is the one verified.
+    if (!ReadBlockFromDisk(block, blockPos, pindex->nHeight, consensusParams, fCheckPoc))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
             pindex->ToString(), pindex->GetBlockPos().ToString());
+    if (fCheckPoc) {
+        LOCK(cs_main);
+        SetPoCValid(pindex);
+    }
+    return true;
+}
+
+/** Check the magic and size stored in front of the block at pos. */
+static bool CheckBlockFileRecord(const CMessageHeader::MessageStartChars& blk_start, unsigned int blk_size, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE) && memcmp(blk_start, Params().MessageStartForDisk(), CMessageHeader::MESSAGE_START_SIZE)) {
+        return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+            HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
+            HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+    }
+
+    if (blk_size > MAX_SIZE) {
+        return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
+            blk_size, MAX_SIZE);
+    }
+    return true;
+}
+
+/** Point block at the block stored at pos in the mapped block file. */
+static bool ReadRawBlockFromMappedFile(Span<const uint8_t>& block, const CMappedFile& mapped, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    try {
+        const Span<const uint8_t> data = mapped.Data();
+        if (pos.nPos < 8 || pos.nPos > (uint64_t)data.size())
+            throw std::ios_base::failure("position beyond the end of the file");
+        SpanReader reader(SER_DISK, CLIENT_VERSION, data.subspan(pos.nPos - 8)); // Seek back 8 bytes for meta header
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+
+        reader >> blk_start >> blk_size;
+
+        if (!CheckBlockFileRecord(blk_start, blk_size, pos, message_start))
+            return false;
+        if (blk_size > reader.size())
+            throw std::ios_base::failure("block beyond the end of the file");
+        block = data.subspan(pos.nPos, blk_size);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+
     return true;
 }
 
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
+    std::shared_ptr<const CMappedFile> mapped = MapBlockFile(pos.nFile);
+    if (mapped) {
+        Span<const uint8_t> data;
+        if (!ReadRawBlockFromMappedFile(data, *mapped, pos, message_start))
+            return false;
+        block.assign(data.begin(), data.end());
+        return true;
+    }
+
+    // A block of an archived file is read from its frame, which holds its record alone.
+    std::shared_ptr<const CArchivedBlockFile> archive = OpenBlockArchive(pos.nFile);
+    if (archive) {
+        uint64_t nStart;
+        if (pos.nPos < 8 || !archive->ReadFrame(pos.nPos - 8, block, nStart))
+            return error("%s: Read from block archive failed for %s", __func__, pos.ToString());
+        try {
+            const Span<const uint8_t> record = Span<const uint8_t>(block.data(), block.size()).subspan(pos.nPos - 8 - nStart);
+            SpanReader reader(SER_DISK, CLIENT_VERSION, record);
+            CMessageHeader::MessageStartChars blk_start;
+            unsigned int blk_size;
+            reader >> blk_start >> blk_size;
+            if (!CheckBlockFileRecord(blk_start, blk_size, pos, message_start))
+                return false;
+            if (blk_size > reader.size())
+                throw std::ios_base::failure("block beyond the end of the frame");
+            block.erase(block.begin(), block.begin() + (pos.nPos - nStart));
+            block.resize(blk_size);
+        } catch (const std::exception& e) {
+            return error("%s: Read from block archive failed: %s for %s", __func__, e.what(), pos.ToString());
+        }
+        return true;
+    }
+
+    // A block not written yet is read from its pending record.
+    if (pos.nPos >= 8 && g_block_writer.ReadPending(pos.nFile, pos.nPos - 8, block)) {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        SpanReader reader(SER_DISK, CLIENT_VERSION, Span<const uint8_t>(block.data(), block.size()));
+        reader >> blk_start >> blk_size;
+        if (!CheckBlockFileRecord(blk_start, blk_size, pos, message_start) || blk_size != block.size() - 8)
+            return error("%s: Pending block record does not match %s", __func__, pos.ToString());
+        block.erase(block.begin(), block.begin() + 8);
+        return true;
+    }
+
     CDiskBlockPos hpos = pos;
     hpos.nPos -= 8; // Seek back 8 bytes for meta header
     CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
@@ -1109,16 +1484,8 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos,
 
         filein >> blk_start >> blk_size;
 
-        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE) && memcmp(blk_start, Params().MessageStartForDisk(), CMessageHeader::MESSAGE_START_SIZE)) {
-            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
-                HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
-                HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
-        }
-
-        if (blk_size > MAX_SIZE) {
-            return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
-                blk_size, MAX_SIZE);
-        }
+        if (!CheckBlockFileRecord(blk_start, blk_size, pos, message_start))
+            return false;
 
         block.resize(blk_size); // Zeroing of memory is intentional here
         filein.read((char*)block.data(), blk_size);
@@ -1140,6 +1507,23 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex
     return ReadRawBlockFromDisk(block, block_pos, message_start);
 }
 
+bool ReadRawBlockFromDisk(RawBlockData& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos block_pos;
+    {
+        LOCK(cs_main);
+        block_pos = pindex->GetBlockPos();
+    }
+
+    block.file = MapBlockFile(block_pos.nFile);
+    if (block.file)
+        return ReadRawBlockFromMappedFile(block.data, *block.file, block_pos, message_start);
+    if (!ReadRawBlockFromDisk(block.buffer, block_pos, message_start))
+        return false;
+    block.data = Span<const uint8_t>(block.buffer.data(), block.buffer.size());
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1166,11 +1550,13 @@ bool IsInitialBlockDownload()
         return false;
     if (fImporting || fReindex)
         return true;
-    if (chainActive.Tip() == nullptr)
+    // A headers only node is as current as its best header, its chain never leaves the genesis block.
+    const CBlockIndex* tip = fHeadersOnly ? pindexBestHeader : chainActive.Tip();
+    if (tip == nullptr)
         return true;
-    if (chainActive.Tip()->nCumulativeDiff < nMinimumCumulativeDiff)
+    if (tip->nCumulativeDiff < nMinimumCumulativeDiff)
         return true;
-    if (chainActive.Tip()->GetBlockTime() < (GetTime() - nMaxTipAge))
+    if (tip->GetBlockTime() < (GetTime() - nMaxTipAge))
         return true;
     LogPrintf("Leaving InitialBlockDownload (latching to false)\n");
     latchToFalse.store(true, std::memory_order_relaxed);
@@ -1315,7 +1701,20 @@ bool CScriptCheck::operator()()
     const CScript& scriptSig = ptxTo->vin[nIn].scriptSig;
     const CScriptWitness* witness = &ptxTo->vin[nIn].scriptWitness;
 
-    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.IsCA() ? m_tx_out.nValueCA : m_tx_out.nValue , cacheStore, *txdata), &error);
+    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.IsCA() ? m_tx_out.nValueCA : m_tx_out.nValue , cacheStore, *txdata, schnorrBatch), &error);
+}
+
+unsigned int CScriptCheck::GetCost() const
+{
+    // A signature with its hash type takes up to 73 bytes of the spending script or witness.
+    static const size_t SIGNATURE_SIZE = 73;
+    if (!ptxTo)
+        return 1;
+    size_t nSize = ptxTo->vin[nIn].scriptSig.size();
+    for (const auto& item : ptxTo->vin[nIn].scriptWitness.stack) {
+        nSize += item.size();
+    }
+    return 1 + nSize / SIGNATURE_SIZE;
 }
 
 int GetSpendHeight(const CCoinsViewCache& inputs)
@@ -1351,9 +1750,12 @@ void InitScriptExecutionCache()
  * which are matched. This is useful for checking blocks where we will likely never need the cache
  * entry again.
  *
+ * If schnorrBatch is not nullptr, the Schnorr signatures of the checks pushed onto pvChecks are
+ * collected into it, and the caller has to verify it once the checks have passed.
+ *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
-bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck>* pvChecks, CSchnorrBatch* schnorrBatch) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (!tx.IsCoinBase()) {
         if (pvChecks)
@@ -1396,7 +1798,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
                 // spent being checked as a part of CScriptCheck.
 
                 // Verify signature
-                CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &txdata);
+                CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &txdata, pvChecks ? schnorrBatch : nullptr);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1439,35 +1841,34 @@ namespace {
 
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
-    // Open history file to append
-    CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Write index header
-    unsigned int nSize = GetSerializeSize(blockundo, fileout.GetVersion());
-    fileout << messageStart << nSize;
-    fileout.SetExtra(1);
-    // Write undo data
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("%s: ftell failed", __func__);
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    // Serialize index header and undo data
+    unsigned int nSize = GetSerializeSize(blockundo, CLIENT_VERSION);
+    std::vector<uint8_t> record;
+    CVectorWriter writer(SER_DISK, CLIENT_VERSION, record, 0);
+    writer << messageStart << nSize;
+    writer.SetExtra(1);
+    writer << blockundo;
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher.SetExtra(1);
     hasher << hashBlock;
     hasher << blockundo;
-    fileout << hasher.GetHash();
+    writer << hasher.GetHash();
+
+    // Append to history file; while syncing, the records of several blocks are written at once
+    if (!g_undo_writer.Append(pos.nFile, GetBlockPosFilename(pos, "rev"), pos.nPos, std::move(record), !IsInitialBlockDownload()))
+        return error("%s: write failed at %s", __func__, pos.ToString());
+    pos.nPos += 8;
 
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+} // namespace
+
+/** Read the undo data at pos of a block whose parent is hashPrev. */
+static bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashPrev)
 {
-    CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
@@ -1493,7 +1894,7 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
             verifier.SetExtra(1);
         }
 
-        verifier << pindex->pprev->GetBlockHash();
+        verifier << hashPrev;
         verifier >> blockundo;
         filein >> hashChecksum;
     } catch (const std::exception& e) {
@@ -1507,6 +1908,77 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    return UndoReadFromDisk(blockundo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash());
+}
+
+std::vector<std::future<BlockRead>> ReadBlocksFromDiskAsync(const std::vector<const CBlockIndex*>& blocks, bool fUndo, const Consensus::Params& consensusParams)
+{
+    AssertLockHeld(cs_main);
+
+    std::vector<std::function<BlockRead()>> reads;
+    reads.reserve(blocks.size());
+    for (const CBlockIndex* pindex : blocks) {
+        const CDiskBlockPos pos = pindex->GetBlockPos();
+        const CDiskBlockPos undoPos = fUndo && pindex->pprev ? pindex->GetUndoPos() : CDiskBlockPos();
+        const uint256 hash = pindex->GetBlockHash();
+        const uint256 hashPrev = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+        const int nHeight = pindex->nHeight;
+        const bool fCheckPoc = !(pindex->nStatus & BLOCK_POC_VALID) && !IsPoCAssumed(pindex, consensusParams);
+        reads.emplace_back([=, &consensusParams] {
+            BlockRead read;
+            auto block = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*block, pos, nHeight, consensusParams, fCheckPoc) && block->GetHash() == hash) {
+                read.block = std::move(block);
+                read.fPoCChecked = fCheckPoc;
+            }
+            if (!undoPos.IsNull()) {
+                auto undo = std::make_shared<CBlockUndo>();
+                if (UndoReadFromDisk(*undo, undoPos, hashPrev))
+                    read.undo = std::move(undo);
+            }
+            return read;
+        });
+    }
+    if (g_block_io)
+        return g_block_io->Submit(std::move(reads));
+
+    std::vector<std::future<BlockRead>> futures;
+    for (auto& read : reads) {
+        futures.push_back(std::async(std::launch::deferred, std::move(read)));
+    }
+    return futures;
+}
+
+void PrefetchBlocksFromDisk(const std::vector<const CBlockIndex*>& blocks)
+{
+    AssertLockHeld(cs_main);
+
+    if (!g_block_io)
+        return;
+    std::vector<std::function<bool()>> reads;
+    for (const CBlockIndex* pindex : blocks) {
+        const CDiskBlockPos pos = pindex->GetBlockPos();
+        reads.emplace_back([pos] {
+            // The file being written to is not mapped, its records are recent enough to be cached.
+            std::shared_ptr<const CMappedFile> mapped = MapBlockFile(pos.nFile);
+            Span<const uint8_t> data;
+            if (!mapped || !ReadRawBlockFromMappedFile(data, *mapped, pos, Params().MessageStart()))
+                return false;
+            // Touch a byte of every page, for the kernel to read them in.
+            volatile uint8_t sum = 0;
+            for (size_t i = 0; i < data.size(); i += 4096) {
+                sum += data[i];
+            }
+            return true;
+        });
+    }
+    g_block_io->Submit(std::move(reads));
+}
+
+namespace {
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, const std::string& userMessage = "")
 {
@@ -1560,12 +2032,14 @@ static bool TxOutDBEntryIsSame(const CTxOut& block_txout, const CTxOut& txdb_txo
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, CBlockUndo* pundo, CUTXOStats* pstats)
 {
     bool fClean = true;
 
-    CBlockUndo blockUndo;
-    if (!UndoReadFromDisk(blockUndo, pindex)) {
+    // The undo data may have been read ahead; its coins are moved out of it either way.
+    CBlockUndo blockUndoRead;
+    CBlockUndo& blockUndo = pundo ? *pundo : blockUndoRead;
+    if (!pundo && !UndoReadFromDisk(blockUndo, pindex)) {
         error("DisconnectBlock(): failure reading undo data");
         return DISCONNECT_FAILED;
     }
@@ -1591,6 +2065,8 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 if (!is_spent || !TxOutDBEntryIsSame(tx.vout[o], coin.out) || pindex->nHeight != coin.nHeight || is_coinbase != coin.fCoinBase) {
                     fClean = false; // transaction output mismatch
                 }
+                if (is_spent && pstats)
+                    pstats->RemoveCoin(out, coin);
             }
         }
 
@@ -1603,6 +2079,8 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint& out = tx.vin[j].prevout;
+                if (pstats)
+                    pstats->AddCoin(out, txundo.vprevout[j]);
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
@@ -1624,6 +2102,10 @@ void static FlushBlockFile(bool fFinalize = false)
     CDiskBlockPos posOld(nLastBlockFile, 0);
     bool status = true;
 
+    // Write the records still held in memory, of this and of older files.
+    status &= g_block_writer.Flush();
+    status &= g_undo_writer.Flush();
+
     FILE* fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
@@ -1668,12 +2150,110 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
+/**
+ * Compute the signature hash data of every transaction of a block into txdata. It depends
+ * on the transaction alone, so that of transactions from the mempool is copied from their
+ * entries, and for blocks of at least PARALLEL_TXDATA_MIN_TXS transactions the rest is
+ * computed on as many threads as the script checks, ahead of the connect loop.
+ */
+static void PrecomputeBlockTransactionData(const CBlock& block, std::vector<PrecomputedTransactionData>& txdata)
+{
+    txdata.resize(block.vtx.size());
+    std::vector<bool> fromMempool(block.vtx.size());
+    {
+        LOCK(mempool.cs);
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            fromMempool[i] = mempool.GetTxData(*block.vtx[i], txdata[i]);
+        }
+    }
+    auto compute = [&block, &txdata, &fromMempool](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!fromMempool[i]) {
+                txdata[i] = PrecomputedTransactionData(*block.vtx[i]);
+            }
+        }
+    };
+
+    const size_t nThreads = block.vtx.size() < PARALLEL_TXDATA_MIN_TXS ? 1 : nScriptCheckThreads + 1;
+    const size_t nChunk = (block.vtx.size() + nThreads - 1) / nThreads;
+    std::vector<std::future<void>> computing;
+    for (size_t begin = nChunk; begin < block.vtx.size(); begin += nChunk) {
+        computing.push_back(std::async(std::launch::async, compute, begin, std::min(begin + nChunk, block.vtx.size())));
+    }
+    compute(0, std::min(nChunk, block.vtx.size()));
+    for (auto& done : computing) {
+        done.get();
+    }
+}
+
 void ThreadScriptCheck()
 {
     RenameThread("bitcoin-scriptch");
     scriptcheckqueue.Thread();
 }
 
+/**
+ * CheckInputs for a transaction entering the mempool, with its input scripts verified on the
+ * script check threads like those of a block, so a large transaction holds cs_main for less.
+ * The queue is free while cs_main is held, ConnectBlock only uses it under cs_main too.
+ */
+static bool CheckMempoolInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    if (nScriptCheckThreads == 0 || tx.vin.size() < 2)
+        return CheckInputs(tx, state, inputs, true, flags, true, false, txdata);
+
+    std::vector<CScriptCheck> vChecks;
+    if (!CheckInputs(tx, state, inputs, true, flags, true, false, txdata, &vChecks))
+        return false;
+    // Nothing to verify if the script execution cache knew the transaction.
+    if (vChecks.empty())
+        return true;
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    if (!control.Wait()) {
+        // The queue does not tell which input failed, verify them again in line to fill in state.
+        return CheckInputs(tx, state, inputs, true, flags, true, false, txdata);
+    }
+    return true;
+}
+
+/**
+ * A run of header proofs of capacity verified together by one check queue
+ * worker. The verdict of every proof is recorded in its PoCItem, so a check
+ * always succeeds and the queue never skips the remaining runs.
+ */
+class CPoCCheck
+{
+private:
+    Span<PoCItem> items;
+    uint64_t targetDeadline;
+
+public:
+    CPoCCheck() : targetDeadline(0) {}
+    CPoCCheck(Span<PoCItem> itemsIn, uint64_t targetDeadlineIn) : items(itemsIn), targetDeadline(targetDeadlineIn) {}
+
+    bool operator()()
+    {
+        CheckProofOfCapacityBatch(items, targetDeadline);
+        return true;
+    }
+
+    void swap(CPoCCheck& check)
+    {
+        std::swap(items, check.items);
+        std::swap(targetDeadline, check.targetDeadline);
+    }
+};
+
+static CCheckQueue<CPoCCheck> poccheckqueue(1);
+
+void ThreadPoCCheck()
+{
+    RenameThread("bitcoin-poccheck");
+    poccheckqueue.Thread();
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -1769,6 +2349,11 @@ static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consens
         flags |= SCRIPT_VERIFY_NULLDUMMY;
     }
 
+    // Start enforcing OP_CHECKSCHNORRVERIFY using versionbits logic.
+    if (VersionBitsState(pindex->pprev, consensusparams, Consensus::DEPLOYMENT_SCHNORR, versionbitscache) == ThresholdState::ACTIVE) {
+        flags |= SCRIPT_VERIFY_SCHNORR;
+    }
+
     return flags;
 }
 
@@ -1785,7 +2370,23 @@ static int64_t nBlocksTotal = 0;
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
-bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+/** Get the redeem script an input spends, if it is the script of a firestone: the last push of its scriptSig. */
+static bool GetSpentTicketScript(const CTxIn& txin, CScript& redeemScript)
+{
+    CScript::const_iterator pc = txin.scriptSig.begin();
+    opcodetype opcode;
+    Span<const unsigned char> data;
+    while (pc < txin.scriptSig.end()) {
+        if (!txin.scriptSig.GetOp(pc, opcode, data))
+            return false;
+    }
+    CKeyID keyID;
+    int lockHeight;
+    redeemScript = CScript(data.begin(), data.end());
+    return data.size() > 0 && DecodeTicketScript(redeemScript, keyID, lockHeight);
+}
+
+bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, CPoCBlockChanges* pocChanges, CUTXOStats* pstats)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -1805,7 +2406,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // GetAdjustedTime() to go backward).
-    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck)) {
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck && !IsPoCAssumed(pindex, chainparams.GetConsensus()), !fJustCheck)) {
         if (state.CorruptionPossible()) {
             // We don't write down blocks to disk if they may have been
             // corrupted, so this should be impossible unless we're having hardware
@@ -1857,6 +2458,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime1 = GetTimeMicros();
     nTimeCheck += nTime1 - nTimeStart;
+    static CMetricHistogram& metricChecks = GetMetrics().Histogram("connectblock_checks", "Time of the sanity checks of ConnectBlock");
+    metricChecks.Record(nTime1 - nTimeStart);
     LogPrint(BCLog::BENCH, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -1965,24 +2568,35 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    // Schnorr signatures of the queued checks are verified at once after them.
+    CSchnorrBatch schnorrBatch(fJustCheck);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
     int64_t nSigOpsCost = 0;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
+    // Sized up front, so that pointers to individual PrecomputedTransactionData don't get invalidated
     std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    PrecomputeBlockTransactionData(block, txdata);
+    // The firestones bought in the block, picked up while the scripts are checked, so the ticket view
+    // only inserts them in order.
+    std::vector<CTicketRef> blockTickets;
+    int64_t nTimeAmounts = 0;
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = *(block.vtx[i]);
 
         nInputs += tx.vin.size();
+        if (tx.IsTicketTx())
+            blockTickets.push_back(tx.Ticket());
 
         if (!tx.IsCoinBase()) {
             CAmount txfee = 0;
+            const int64_t nTimeInputs = GetTimeMicros();
             if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee)) {
                 return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
             }
+            nTimeAmounts += GetTimeMicros() - nTimeInputs;
             nFees += txfee;
             if (!MoneyRange(nFees)) {
                 return state.DoS(100, error("%s: accumulated fee in the block out of range.", __func__),
@@ -2012,11 +2626,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                 REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
         if (!tx.IsCoinBase()) {
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr, &schnorrBatch))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -2030,6 +2643,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
     int64_t nTime3 = GetTimeMicros();
     nTimeConnect += nTime3 - nTime2;
+    static CMetricHistogram& metricConnect = GetMetrics().Histogram("connectblock_connect", "Time ConnectBlock takes to connect the transactions");
+    metricConnect.Record(nTime3 - nTime2);
+    static CMetricHistogram& metricAmounts = GetMetrics().Histogram("connectblock_amounts", "Time ConnectBlock takes to check the explicit and confidential amounts of the inputs");
+    metricAmounts.Record(nTimeAmounts);
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs - 1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
 
     CAmount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, chainparams.GetConsensus());
@@ -2039,18 +2656,17 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             LogPrint(BCLog::FIRESTONE, "%s: coinbase with firestone:%s:%d\n", __func__, out.hash.ToString(), out.n);
             //check ticket
             auto index = (pindex->nHeight / pticketview->SlotLength()) - 1;
-            for (auto ticket : pticketview->GetTicketsBySlotIndex(index)) {
-                if (*(ticket->out) == out) {
-                    auto ticketInHeight = pcoinsTip->AccessCoin(COutPoint(out)).nHeight;
-                    auto index = pindex->nHeight / pticketview->SlotLength();
-                    auto beg = std::max((index - 1) * pticketview->SlotLength(), 0);
-                    auto end = index * pticketview->SlotLength() - 1;
-                    if (ticketInHeight >= beg && ticketInHeight <= end) {
-                        blockReward += GetBlockSubsidy(pindex->nHeight, chainparams.GetConsensus());
-                        LogPrint(BCLog::FIRESTONE, "%s: coinbase with firestone:%s:%d\n", __func__, ticket->out->hash.ToString(), ticket->out->n);
-                    } else {
-                        LogPrint(BCLog::FIRESTONE, "%s: firestone locktime error firestone:%s:%d\n", __func__, ticket->out->hash.ToString(), ticket->out->n);
-                    }
+            auto ticket = pticketview->GetTicket(index, out);
+            if (ticket) {
+                auto ticketInHeight = pcoinsTip->AccessCoin(COutPoint(out)).nHeight;
+                auto index = pindex->nHeight / pticketview->SlotLength();
+                auto beg = std::max((index - 1) * pticketview->SlotLength(), 0);
+                auto end = index * pticketview->SlotLength() - 1;
+                if (ticketInHeight >= beg && ticketInHeight <= end) {
+                    blockReward += GetBlockSubsidy(pindex->nHeight, chainparams.GetConsensus());
+                    LogPrint(BCLog::FIRESTONE, "%s: coinbase with firestone:%s:%d\n", __func__, ticket->out.hash.ToString(), ticket->out.n);
+                } else {
+                    LogPrint(BCLog::FIRESTONE, "%s: firestone locktime error firestone:%s:%d\n", __func__, ticket->out.hash.ToString(), ticket->out.n);
                 }
             }
         }
@@ -2063,8 +2679,14 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
+    if (!schnorrBatch.Verify())
+        return state.DoS(100, error("%s: Schnorr signature batch failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros();
     nTimeVerify += nTime4 - nTime2;
+    static CMetricHistogram& metricScripts = GetMetrics().Histogram("connectblock_scripts", "Time ConnectBlock waits for the queued script checks and the Schnorr batch");
+    metricScripts.Record(nTime4 - nTime3);
+    static CMetricHistogram& metricVerify = GetMetrics().Histogram("connectblock_verify", "Time ConnectBlock takes to connect and verify the inputs");
+    metricVerify.Record(nTime4 - nTime2);
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs - 1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
     if (fJustCheck)
@@ -2084,6 +2706,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime5 = GetTimeMicros();
     nTimeIndex += nTime5 - nTime4;
+    static CMetricHistogram& metricIndex = GetMetrics().Histogram("connectblock_index", "Time ConnectBlock takes to write the undo data and index");
+    metricIndex.Record(nTime5 - nTime4);
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
     int64_t nTime6 = GetTimeMicros();
@@ -2116,15 +2740,43 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     //accept action
-    prelationview->ConnectBlock(pindex->nHeight, block, pocxFlag);
-    pticketview->ConnectBlock(pindex->nHeight, block, TestTicket);
-    return true;
-}
+    {
+        static CMetricHistogram& metric = GetMetrics().Histogram("connectblock_poc", "Time ConnectBlock takes to connect the bindings, firestones and issuances");
+        CMetricTimer timer(metric);
+        prelationview->ConnectBlock(pindex->nHeight, block, blockundo, pocxFlag, pocChanges ? &pocChanges->actions : nullptr);
+        pticketview->ConnectBlock(pindex->nHeight, blockTickets, TestTicket, pocChanges ? &pocChanges->boughtTickets : nullptr);
+        pissuanceview->ConnectBlock(pindex->nHeight, block);
+    }
 
-/**
- * Update the on-disk chain state.
- * The caches and indexes are flushed depending on the mode we're called with
- * if they're too large, if it's been a while since the last write,
+    if (pocChanges) {
+        // The firestones spent are known from the inputs redeeming their scripts.
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                CScript redeemScript;
+                if (!GetSpentTicketScript(tx.vin[j], redeemScript))
+                    continue;
+                const CTxOut& spent = blockundo.vtxundo[i - 1].vprevout[j].out;
+                pocChanges->spentTickets.push_back(std::make_shared<const CTicket>(tx.vin[j].prevout, spent.nValue, redeemScript, spent.scriptPubKey));
+            }
+        }
+        pocChanges->slotIndex = pticketview->SlotIndex();
+        pocChanges->fSlotOpened = pindex->nHeight % pticketview->SlotLength() == 0;
+        pocChanges->ticketPrice = pticketview->CurrentTicketPrice();
+    }
+
+    if (pstats) {
+        static CMetricHistogram& metric = GetMetrics().Histogram("connectblock_utxostats", "Time ConnectBlock takes to apply the block to the UTXO set statistics");
+        CMetricTimer timer(metric);
+        pstats->ConnectBlock(block, blockundo, pindex->nHeight);
+    }
+    return true;
+}
+
+/**
+ * Update the on-disk chain state.
+ * The caches and indexes are flushed depending on the mode we're called with
+ * if they're too large, if it's been a while since the last write,
  * or always and in all cases if we're in prune mode and are deleting files.
  *
  * If FlushStateMode::NONE is used, then FlushStateToDisk(...) won't do anything
@@ -2218,9 +2870,27 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState&
                 // overwrite one. Still, use a conservative safety factor of 2.
                 if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                     return state.Error("out of disk space");
-                // Flush the chainstate (which may refer to block index entries).
+                // Flush the firestone and relation views first, at the block the chainstate is flushed at.
+                // Should the chainstate write not complete, startup finds them ahead of it and rebuilds.
+                const uint256 hashBestBlock = pcoinsTip->GetBestBlock();
+                if (pticketview && !pticketview->Flush(hashBestBlock))
+                    return AbortNode(state, "Failed to write to firestone database");
+                if (prelationview && !prelationview->Flush(hashBestBlock))
+                    return AbortNode(state, "Failed to write to relation database");
+                // Flush the chainstate (which may refer to block index entries), and the UTXO statistics with it.
+                CUTXOStats utxoStats;
+                if (g_chainstate.GetUTXOStats(utxoStats))
+                    pcoinsdbview->SetUTXOStats(utxoStats);
+                const int64_t nFlushStart = GetTimeMicros();
+                const size_t nFlushCoins = pcoinsTip->GetCacheSize();
                 if (!pcoinsTip->Flush())
                     return AbortNode(state, "Failed to write to coin database");
+                const int64_t nFlushTime = GetTimeMicros() - nFlushStart;
+                LogPrint(BCLog::BENCH, "%s: flushed %u coins: %.2fms\n", __func__, nFlushCoins, nFlushTime * MILLI);
+                TRACE4(coins, flush, nFlushTime, (int)mode, nFlushCoins, cacheSize);
+                // Periodic and cache size flushes finish in the background; forced ones are on disk when this returns.
+                if (mode == FlushStateMode::ALWAYS && !pcoinsdbview->WaitForWriteBack())
+                    return AbortNode(state, "Failed to write to coin database");
                 nLastFlush = nNow;
                 full_flush_completed = true;
             }
@@ -2329,33 +2999,50 @@ void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainPar
   * disconnectpool (note that the caller is responsible for mempool consistency
   * in any case).
   */
-bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool)
+bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool, BlockRead* pread)
 {
     CBlockIndex* pindexDelete = chainActive.Tip();
     assert(pindexDelete);
-    // Read block from disk.
-    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-    CBlock& block = *pblock;
-    if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
-        return AbortNode(state, "Failed to read block");
+    // Read block from disk, unless it was read ahead.
+    std::shared_ptr<const CBlock> pblock = pread ? pread->block : nullptr;
+    if (!pblock) {
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblockRead, pindexDelete, chainparams.GetConsensus()))
+            return AbortNode(state, "Failed to read block");
+        pblock = pblockRead;
+    }
+    const CBlock& block = *pblock;
 
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
+    CUTXOStats statsDelta;
     {
         CCoinsViewCache view(pcoinsTip.get());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        pticketview->DisconnectBlock(pindexDelete->nHeight, block);
-        // check poc21
-        bool pocxFlag = false;
-        if (pindexDelete->nHeight >= chainparams.GetConsensus().LVIP05Height){
-            pocxFlag = true;
-        }
-        prelationview->DisconnectBlock(pindexDelete->nHeight, block, pocxFlag);
-        if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
+        {
+            static CMetricHistogram& metric = GetMetrics().Histogram("disconnectblock_poc", "Time DisconnectTip takes to disconnect the bindings, firestones and issuances");
+            CMetricTimer timer(metric);
+            pticketview->DisconnectBlock(pindexDelete->nHeight, block);
+            // check poc21
+            bool pocxFlag = false;
+            if (pindexDelete->nHeight >= chainparams.GetConsensus().LVIP05Height){
+                pocxFlag = true;
+            }
+            prelationview->DisconnectBlock(pindexDelete->nHeight, block, pocxFlag);
+            pissuanceview->DisconnectBlock(pindexDelete->nHeight, block);
+        }
+        if (DisconnectBlock(block, pindexDelete, view, pread ? pread->undo.get() : nullptr, m_utxo_stats_tracked ? &statsDelta : nullptr) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
     }
+    if (m_utxo_stats_tracked) {
+        statsDelta.hashBlock = pindexDelete->pprev->GetBlockHash();
+        m_utxo_stats += statsDelta;
+    }
+    TRACE3(validation, block_disconnected, pindexDelete->GetBlockHash().begin(), pindexDelete->nHeight, GetTimeMicros() - nStart);
+    static CMetricHistogram& metricDisconnect = GetMetrics().Histogram("disconnecttip", "Time DisconnectTip takes to disconnect a block from the coins, excluding reading it");
+    metricDisconnect.Record(GetTimeMicros() - nStart);
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * MILLI);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
@@ -2470,12 +3157,18 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
+        BlockRead read = m_connect_read_ahead.Take(pindexNew);
+        if (read.block && read.fPoCChecked)
+            SetPoCValid(pindexNew);
+        pthisBlock = read.block;
+    } else {
+        pthisBlock = pblock;
+    }
+    if (!pthisBlock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
             return AbortNode(state, "Failed to read block");
         pthisBlock = pblockNew;
-    } else {
-        pthisBlock = pblock;
     }
     const CBlock& blockConnecting = *pthisBlock;
     // Apply the block atomically to the chain state.
@@ -2483,9 +3176,11 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    auto pocChanges = std::make_shared<CPoCBlockChanges>();
+    CUTXOStats statsDelta;
     {
         CCoinsViewCache view(pcoinsTip.get());
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, pocChanges.get(), m_utxo_stats_tracked ? &statsDelta : nullptr);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -2495,10 +3190,15 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
 
         nTime3 = GetTimeMicros();
         nTimeConnectTotal += nTime3 - nTime2;
+        TRACE4(validation, block_connected, pindexNew->GetBlockHash().begin(), pindexNew->nHeight, blockConnecting.vtx.size(), nTime3 - nTime2);
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
     }
+    if (m_utxo_stats_tracked) {
+        statsDelta.hashBlock = pindexNew->GetBlockHash();
+        m_utxo_stats += statsDelta;
+    }
     int64_t nTime4 = GetTimeMicros();
     nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
@@ -2507,9 +3207,11 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         return false;
     int64_t nTime5 = GetTimeMicros();
     nTimeChainState += nTime5 - nTime4;
+    static CMetricHistogram& metricFlush = GetMetrics().Histogram("connecttip_flush", "Time ConnectTip takes to flush the block's coins and, if needed, the chain state");
+    metricFlush.Record(nTime5 - nTime3);
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
     // Remove conflicting transactions from the mempool.;
-    mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
+    mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight, pindexNew->GetBlockTime());
     disconnectpool.removeForBlock(blockConnecting.vtx);
     // Update chainActive & related variables.
     chainActive.SetTip(pindexNew);
@@ -2518,10 +3220,13 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
     nTimeTotal += nTime6 - nTime1;
+    static CMetricHistogram& metricTotal = GetMetrics().Histogram("connecttip", "Time to connect a block to the tip, from reading it to updating the tip");
+    metricTotal.Record(nTime6 - nTime1);
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
 
+    GetMainSignals().PoCBlockConnected(pindexNew, pocChanges);
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     blockAssember.SetNull();
     return true;
@@ -2613,8 +3318,15 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
+    CBlockReadAhead disconnectReadAhead(true);
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+        std::vector<const CBlockIndex*> vpindexAhead;
+        for (const CBlockIndex* pindex = chainActive.Tip(); pindex && pindex != pindexFork && vpindexAhead.size() < BLOCK_READ_AHEAD; pindex = pindex->pprev) {
+            vpindexAhead.push_back(pindex);
+        }
+        disconnectReadAhead.Request(vpindexAhead, chainparams.GetConsensus());
+        BlockRead read = disconnectReadAhead.Take(chainActive.Tip());
+        if (!DisconnectTip(state, chainparams, &disconnectpool, &read)) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
             UpdateMempoolForReorg(disconnectpool, false);
@@ -2640,8 +3352,15 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
-        // Connect new blocks.
+        // Connect new blocks, reading the next ones meanwhile. The block handed in is not read.
         for (CBlockIndex* pindexConnect : reverse_iterate(vpindexToConnect)) {
+            std::vector<const CBlockIndex*> vpindexAhead;
+            const size_t nConnected = pindexConnect->nHeight - vpindexToConnect.back()->nHeight;
+            for (auto it = vpindexToConnect.rbegin() + nConnected; it != vpindexToConnect.rend() && vpindexAhead.size() < BLOCK_READ_AHEAD; ++it) {
+                if (!(*it == pindexMostWork && pblock))
+                    vpindexAhead.push_back(*it);
+            }
+            m_connect_read_ahead.Request(vpindexAhead, chainparams.GetConsensus());
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
@@ -2707,6 +3426,12 @@ static void NotifyHeaderTip() LOCKS_EXCLUDED(cs_main)
     // Send block tip changed notifications without cs_main
     if (fNotify) {
         uiInterface.NotifyHeaderTip(fInitialBlockDownload, pindexHeader);
+        // The best header is the tip that getmininginfo long-polls for on a headers only node.
+        if (fHeadersOnly) {
+            LOCK(g_best_block_mutex);
+            g_best_block = pindexHeader->GetBlockHash();
+            g_best_block_cv.notify_all();
+        }
     }
 }
 
@@ -2745,6 +3470,7 @@ bool CChainState::ActivateBestChain(CValidationState& state, const CChainParams&
     CBlockIndex* pindexMostWork = nullptr;
     CBlockIndex* pindexNewTip = nullptr;
     int nStopAtHeight = gArgs.GetArg("-stopatheight", DEFAULT_STOPATHEIGHT);
+    const uint256 block_hash = pblock ? pblock->GetHash() : uint256();
     do {
         boost::this_thread::interruption_point();
 
@@ -2776,7 +3502,7 @@ bool CChainState::ActivateBestChain(CValidationState& state, const CChainParams&
 
                 bool fInvalidFound = false;
                 std::shared_ptr<const CBlock> nullBlockPtr;
-                if (!ActivateBestChainStep(state, chainparams, pindexMostWork, pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() ? pblock : nullBlockPtr, fInvalidFound, connectTrace))
+                if (!ActivateBestChainStep(state, chainparams, pindexMostWork, pblock && block_hash == pindexMostWork->GetBlockHash() ? pblock : nullBlockPtr, fInvalidFound, connectTrace))
                     return false;
                 blocks_connected = true;
 
@@ -2796,6 +3522,15 @@ bool CChainState::ActivateBestChain(CValidationState& state, const CChainParams&
             const CBlockIndex* pindexFork = chainActive.FindFork(starting_tip);
             bool fInitialDownload = IsInitialBlockDownload();
 
+            // Hand RPC and the GUI the firestones and bindings of the new tip, at most once a second while syncing.
+            static int64_t nLastSnapshot = 0;
+            const int64_t nNow = GetTimeMicros();
+            if (!fInitialDownload || nNow > nLastSnapshot + 1000000) {
+                pticketview->PublishSnapshot();
+                prelationview->PublishSnapshot(chainActive.Height());
+                nLastSnapshot = nNow;
+            }
+
             // Notify external listeners about the new tip.
             // Enqueue while holding cs_main to ensure that UpdatedBlockTip is called in the order in which blocks are connected
             if (pindexFork != pindexNewTip) {
@@ -2995,6 +3730,94 @@ void ResetBlockFailureFlags(CBlockIndex* pindex)
     return g_chainstate.ResetBlockFailureFlags(pindex);
 }
 
+size_t CChainState::PruneStaleHeaders(const std::set<const CBlockIndex*>& setKeep, int nDepth, int64_t nMinAge)
+{
+    AssertLockHeld(cs_main);
+    static CMetricCounter& metricPruned = GetMetrics().Counter("staleheaders_pruned", "Header-only side branch entries removed from the block index");
+
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (pindexTip == nullptr || nDepth <= 0)
+        return 0;
+    const arith_uint256 nMargin = GetBlockProof(*pindexTip) * nDepth;
+    if (pindexTip->nCumulativeDiff <= nMargin)
+        return 0;
+    const arith_uint256 nMaxDiff = pindexTip->nCumulativeDiff - nMargin;
+    const int64_t nMaxTime = GetAdjustedTime() - nMinAge;
+
+    // The entries still referenced, and their ancestors, stay. Those with data stay anyway.
+    std::set<const CBlockIndex*> setKept;
+    std::vector<const CBlockIndex*> vRoots(setKeep.begin(), setKeep.end());
+    vRoots.push_back(pindexBestHeader);
+    vRoots.push_back(pindexBestInvalid);
+    vRoots.push_back(pindexBestForkTip);
+    vRoots.push_back(pindexBestForkBase);
+    for (const CBlockIndex* pindex : vRoots) {
+        while (pindex != nullptr && pindex->nTx == 0 && setKept.insert(pindex).second) {
+            pindex = pindex->pprev;
+        }
+    }
+    auto fnPrunable = [&](const CBlockIndex* pindex) {
+        return pindex->pprev != nullptr && pindex->nTx == 0 && !(pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO)) &&
+            !chainActive.Contains(pindex) && !setKept.count(pindex);
+    };
+
+    // A branch is removed from its leaves down, so no entry left ever points to a removed one.
+    std::unordered_map<const CBlockIndex*, int> mapChildren;
+    for (const auto& entry : mapBlockIndex) {
+        const CBlockIndex* pindex = entry.second;
+        if (pindex->pprev != nullptr && pindex->pprev->nTx == 0)
+            mapChildren[pindex->pprev]++;
+    }
+    std::vector<CBlockIndex*> vLeaves;
+    for (const auto& entry : mapBlockIndex) {
+        CBlockIndex* pindex = entry.second;
+        if (pindex->nTx == 0 && !mapChildren.count(pindex) && pindex->nCumulativeDiff < nMaxDiff && pindex->GetBlockTime() < nMaxTime)
+            vLeaves.push_back(pindex);
+    }
+    std::vector<CBlockIndex*> vPrune;
+    for (CBlockIndex* pindex : vLeaves) {
+        while (fnPrunable(pindex)) {
+            auto it = mapChildren.find(pindex);
+            if (it != mapChildren.end() && it->second > 0)
+                break;
+            vPrune.push_back(pindex);
+            pindex = pindex->pprev;
+            it = mapChildren.find(pindex);
+            if (it != mapChildren.end())
+                it->second--;
+        }
+    }
+    if (vPrune.empty())
+        return 0;
+
+    std::vector<uint256> vHash;
+    vHash.reserve(vPrune.size());
+    for (const CBlockIndex* pindex : vPrune) {
+        vHash.push_back(pindex->GetBlockHash());
+    }
+    pblocktree->EraseBlockIndex(vHash);
+    for (size_t i = 0; i < vPrune.size(); i++) {
+        setDirtyBlockIndex.erase(vPrune[i]);
+        m_failed_blocks.erase(vPrune[i]);
+        mapBlockIndex.erase(vHash[i]);
+        blockIndexArena.Free(vPrune[i]);
+    }
+    // The freed entries are reused, so nothing may stay cached under their address.
+    versionbitscache.Clear();
+    for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
+        warningcache[b].clear();
+    }
+
+    metricPruned.Add(vPrune.size());
+    LogPrintf("Pruned %u stale header-only entries from the block index\n", vPrune.size());
+    return vPrune.size();
+}
+
+size_t PruneStaleHeaders(const std::set<const CBlockIndex*>& setKeep, int nDepth, int64_t nMinAge)
+{
+    return g_chainstate.PruneStaleHeaders(setKeep, nDepth, nMinAge);
+}
+
 CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
 {
     AssertLockHeld(cs_main);
@@ -3006,7 +3829,8 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexArena.New();
+    *pindexNew = CBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3163,6 +3987,15 @@ static bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos,
     return true;
 }
 
+/** The height of the block following hashPrevBlock if it is on the active chain, otherwise 0. */
+static int ActiveChainHeightAfter(const uint256& hashPrevBlock)
+{
+    // CheckBlock may be called without cs_main.
+    LOCK(cs_main);
+    const CBlockIndex* pindexPrev = hashPrevBlock.IsNull() ? nullptr : LookupBlockIndex(hashPrevBlock);
+    return pindexPrev && chainActive.Contains(pindexPrev) ? pindexPrev->nHeight + 1 : 0;
+}
+
 static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, int height, bool fCheckPoc = true)
 {
     auto params = Params();
@@ -3184,7 +4017,8 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPoc, bool fCheckMerkleRoot)
+/** CheckBlock for a block whose height is known, which does not take cs_main. */
+static bool CheckBlockAtHeight(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, int height, bool fCheckPoc, bool fCheckMerkleRoot)
 {
     // These are checks that are independent of context.
 
@@ -3193,15 +4027,6 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    auto height = 0;
-    if (!block.hashPrevBlock.IsNull()) {
-        for (auto i = 0; i <= chainActive.Height(); i++) {
-            if (chainActive[i]->GetBlockHash() == block.hashPrevBlock) {
-                height = chainActive[i]->nHeight + 1;
-                break;
-            }
-        }
-    }
     if (!CheckBlockHeader(block, state, consensusParams, height, fCheckPoc))
         return false;
 
@@ -3262,6 +4087,13 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     return true;
 }
 
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPoc, bool fCheckMerkleRoot)
+{
+    if (block.fChecked)
+        return true;
+    return CheckBlockAtHeight(block, state, consensusParams, ActiveChainHeightAfter(block.hashPrevBlock), fCheckPoc, fCheckMerkleRoot);
+}
+
 bool IsWitnessEnabled(const CBlockIndex* pindexPrev, const Consensus::Params& params)
 {
     return true;
@@ -3422,7 +4254,7 @@ static bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationSta
         return state.Invalid(false, REJECT_INVALID, "block-sig-err", "block genSign error");
     }
 
-    auto dl = block.nDeadline / pindexPrev->nBaseTarget;
+    auto dl = DeadlineWait(block.nDeadline, pindexPrev->nBaseTarget, consensusParams);
     if (pindexPrev->nTime + dl > block.nTime) {
         return state.Invalid(false, REJECT_INVALID, "time-too-new", "block deadline too far in the future");
     }
@@ -3515,7 +4347,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPoc)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3533,16 +4365,8 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        auto height = 0;
-        if (!block.hashPrevBlock.IsNull()) {
-            for (auto i = 0; i <= chainActive.Height(); i++) {
-                if (chainActive[i]->GetBlockHash() == block.hashPrevBlock) {
-                    height = chainActive[i]->nHeight + 1; 
-                    break;
-                }
-            }
-        }
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), height))
+        const int height = ActiveChainHeightAfter(block.hashPrevBlock);
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), height, fCheckPoc))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3605,15 +4429,214 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+/**
+ * The checks of a new header that need no Shabal work, made before its proof of capacity:
+ * the generation signature follows the parent, the claimed deadline is within the target at
+ * the base target of the header and, when the parent is indexed, that base target is the one
+ * retargeted from it. prev is the parent header, pindexPrev its index or nullptr.
+ */
+static bool PreScreenHeader(const CBlockHeader& header, const int nHeight, const CBlockHeader& prev, const CBlockIndex* pindexPrev, const CChainParams& chainparams, std::string& strReason)
+{
+    const uint256 genSig = nHeight >= chainparams.GetConsensus().LVIP05Height
+        ? CalcGenerationSignature(prev.genSign, prev.nPublicKeyID)
+        : CalcGenerationSignaturePoc2(prev.genSign, prev.nPlotID);
+    if (header.genSign != genSig) {
+        strReason = "block-sig-err";
+        return false;
+    }
+    if (header.nBaseTarget == 0 || header.nDeadline / header.nBaseTarget > chainparams.TargetDeadline()) {
+        strReason = "deadline-too-high";
+        return false;
+    }
+    if (pindexPrev && header.nBaseTarget != AdjustBaseTarget(pindexPrev, header.nTime)) {
+        strReason = "base-target-error";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Collect the proofs of capacity of the new headers of a headers message whose
+ * height is known, either from the block index or from an earlier header of
+ * the same message. vItemOf[i] is set to the index of header i's item, or -1.
+ * Collection stops at the first header that fails PreScreenHeader, whose item
+ * index is set in nScreenedOut with the reason, so no proof after it is verified.
+ */
+static void CollectHeadersProofOfCapacity(const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, std::vector<PoCItem>& vItems, std::vector<int>& vItemOf, int& nScreenedOut, std::string& strReason) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+    vItemOf.assign(headers.size(), -1);
+    nScreenedOut = -1;
+    uint256 hashLast;
+    int nLastHeight = -1;
+    for (size_t i = 0; i < headers.size(); i++) {
+        const CBlockHeader& header = headers[i];
+        const uint256 hash = header.GetHash();
+        int nHeight = -1;
+        // The parent is indexed unless it is a new header of this message.
+        const CBlockIndex* pindexPrev = LookupBlockIndex(header.hashPrevBlock);
+        CBlockHeader prev;
+        if (pindexPrev) {
+            nHeight = pindexPrev->nHeight + 1;
+            prev = pindexPrev->GetBlockHeader();
+        } else if (nLastHeight >= 0 && header.hashPrevBlock == hashLast) {
+            nHeight = nLastHeight + 1;
+            prev = headers[i - 1];
+        }
+        hashLast = hash;
+        nLastHeight = nHeight;
+        // Known headers are not checked again by AcceptBlockHeader.
+        if (nHeight <= 0 || LookupBlockIndex(hash)) continue;
+
+        if (!PreScreenHeader(header, nHeight, prev, pindexPrev, chainparams, strReason)) {
+            vItemOf[i] = vItems.size();
+            nScreenedOut = vItems.size();
+            vItems.emplace_back();
+            return;
+        }
+
+        PoCItem item;
+        item.genSig = header.genSign;
+        item.height = nHeight;
+        item.fPoc2 = nHeight < consensusParams.LVIP05Height;
+        item.plotID = header.nPlotID;
+        item.publicKeyID = header.nPublicKeyID;
+        item.nonce = header.nNonce;
+        item.baseTarget = header.nBaseTarget;
+        item.deadline = header.nDeadline;
+        vItemOf[i] = vItems.size();
+        vItems.push_back(item);
+    }
+}
+
+/** Verify the collected proofs of capacity in runs of one multi-lane kernel width, spread over the PoC check threads. */
+static void CheckProofsOfCapacity(Span<PoCItem> items, const uint64_t targetDeadline)
+{
+    const size_t nRun = std::max<size_t>(Shabal256Lanes(), 1);
+    std::vector<CPoCCheck> vChecks;
+    for (size_t first = 0; first < items.size(); first += nRun) {
+        const size_t count = std::min(nRun, items.size() - first);
+        vChecks.emplace_back(Span<PoCItem>(items.data() + first, count), targetDeadline);
+    }
+    if (nScriptCheckThreads) {
+        CCheckQueueControl<CPoCCheck> control(&poccheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (CPoCCheck& check : vChecks) check();
+    }
+}
+
+void CheckSubmittedProofsOfCapacity(Span<PoCItem> items, const uint64_t targetDeadline)
+{
+    static CMetricCounter& metricDevice = GetMetrics().Counter("poc_device_verified", "Submitted proofs of capacity verified on the PoC batch device");
+    static CMetricCounter& metricFailed = GetMetrics().Counter("poc_device_failures", "Batches the PoC batch device failed to verify");
+    const std::shared_ptr<PoCBatchVerifier> verifier = GetPoCBatchVerifier();
+    if (verifier && items.size() >= verifier->MinBatchSize()) {
+        if (verifier->Verify(items, targetDeadline)) {
+            metricDevice.Add(items.size());
+            return;
+        }
+        metricFailed.Add();
+        LogPrintf("%s: %s failed to verify %u proofs of capacity, verifying them on the CPU\n", __func__, verifier->Name(), items.size());
+    }
+    CheckProofsOfCapacity(items, targetDeadline);
+}
+
+/** The proof of capacity of a block index entry, to be verified with CheckProofsOfCapacity. */
+static PoCItem PoCItemOf(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    PoCItem item;
+    item.genSig = pindex->genSign;
+    item.height = pindex->nHeight;
+    item.fPoc2 = pindex->nHeight < consensusParams.LVIP05Height;
+    item.plotID = pindex->nPlotID;
+    item.publicKeyID = pindex->nPublicKeyID;
+    item.nonce = pindex->nNonce;
+    item.baseTarget = pindex->nBaseTarget;
+    item.deadline = pindex->nDeadline;
+    return item;
+}
+
+void ThreadCheckPoCIndex(const int nDepth)
+{
+    RenameThread("lava-pocindex");
+    const CChainParams& chainparams = Params();
+    std::vector<PoCItem> vItems;
+    std::vector<const CBlockIndex*> vIndex;
+    {
+        LOCK(cs_main);
+        // The genesis block carries no proof of capacity.
+        for (const CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->nHeight > 0 && (int)vItems.size() < nDepth; pindex = pindex->pprev) {
+            vItems.push_back(PoCItemOf(pindex, chainparams.GetConsensus()));
+            vIndex.push_back(pindex);
+        }
+    }
+    LogPrintf("%s: verifying the proofs of capacity of the last %u blocks\n", __func__, vItems.size());
+
+    // Hold the check queue one chunk at a time, so header validation is not kept waiting.
+    const int64_t nStart = GetTimeMillis();
+    for (size_t first = 0; first < vItems.size(); first += POC_INDEX_CHECK_CHUNK) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return;
+        const size_t count = std::min(POC_INDEX_CHECK_CHUNK, vItems.size() - first);
+        CheckProofsOfCapacity(Span<PoCItem>(vItems.data() + first, count), chainparams.TargetDeadline());
+        for (size_t i = first; i < first + count; i++) {
+            if (!vItems[i].fValid) {
+                AbortNode(strprintf("Proof of capacity of the block index failed: %s", vIndex[i]->ToString()),
+                          _("Corrupted block database detected. Please restart with -reindex."));
+                return;
+            }
+        }
+    }
+    LogPrintf("%s: verified the proofs of capacity of the last %u blocks in %dms\n", __func__, vItems.size(), GetTimeMillis() - nStart);
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader* first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+    // The proofs of capacity dominate header validation and only depend on the
+    // header and its height, so check them all in parallel without cs_main.
+    // Cheap checks come first, and the proofs are verified one round of the check threads at a
+    // time, so a message of bad headers costs at most one round of Shabal work.
+    std::vector<PoCItem> vItems;
+    std::vector<int> vItemOf;
+    int nScreenedOut;
+    std::string strReason;
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        CollectHeadersProofOfCapacity(headers, chainparams, vItems, vItemOf, nScreenedOut, strReason);
+    }
+    const size_t nVerify = nScreenedOut >= 0 ? nScreenedOut : vItems.size();
+    const size_t nRound = std::max<size_t>(Shabal256Lanes(), 1) * std::max(nScriptCheckThreads, 1);
+    for (size_t first = 0; first < nVerify; first += nRound) {
+        Span<PoCItem> round(vItems.data() + first, std::min(nRound, nVerify - first));
+        CheckProofsOfCapacity(round, chainparams.TargetDeadline());
+        if (std::any_of(round.begin(), round.end(), [](const PoCItem& item) { return !item.fValid; }))
+            break;
+    }
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            const PoCItem* pitem = vItemOf[i] >= 0 ? &vItems[vItemOf[i]] : nullptr;
             CBlockIndex* pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (pitem && vItemOf[i] == nScreenedOut) {
+                state.DoS(50, false, REJECT_INVALID, strReason, false, "proof of capacity pre-screen failed");
+                error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, header.GetHash().ToString(), FormatStateMessage(state));
+                if (first_invalid) *first_invalid = header;
+                return false;
+            }
+            if (pitem && !pitem->fValid) {
+                state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of capacity failed");
+                error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, header.GetHash().ToString(), FormatStateMessage(state));
+                if (first_invalid) *first_invalid = header;
+                return false;
+            }
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, pitem == nullptr)) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3692,7 +4715,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
         if (pindex->nCumulativeDiff < nMinimumCumulativeDiff) return true;
     }
 
-    if (!CheckBlock(block, state, chainparams.GetConsensus()) ||
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), !IsPoCAssumed(pindex, chainparams.GetConsensus())) ||
         !ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindex->pprev)) {
         if (state.IsInvalid() && !state.CorruptionPossible()) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -3729,9 +4752,11 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
 bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock)
 {
     AssertLockNotHeld(cs_main);
+    const int64_t nArrivalTime = GetTimeMicros();
 
+    // The index of the block, which holds its hash, so the header is not hashed again below.
+    CBlockIndex* pindex = nullptr;
     {
-        CBlockIndex* pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
         CValidationState state;
 
@@ -3741,7 +4766,7 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
-        bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
+        bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus(), !IsPoCAssumed(LookupBlockIndex(pblock->GetHash()), chainparams.GetConsensus()));
         if (ret) {
             // Store to disk
             ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
@@ -3750,48 +4775,66 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED (%s)", __func__, FormatStateMessage(state));
         }
+        // Read its inputs while it waits for its deadline or for the blocks before it.
+        if (pcoinsprefetch)
+            pcoinsprefetch->Prefetch(*pblock);
     }
 
     NotifyHeaderTip();
 
-    auto activateBestChain = [chainparams, pblock]()->bool {
+    auto activateBestChain = [chainparams, pblock, pindex]()->bool {
         CValidationState state; // Only used to report errors, not invalidity - ignore it
         if (!g_chainstate.ActivateBestChain(state, chainparams, pblock))
             return error("%s: ActivateBestChain failed (%s)\n", __func__, FormatStateMessage(state));
-        uint256 hash = pblock->GetHash();
-        BlockMap::iterator miSelf = mapBlockIndex.find(hash);
-        auto blockIndex = miSelf->second;
-	    g_blockCache->UpdateBestBlockIndex(blockIndex);
+        g_blockCache->UpdateBestBlockIndex(pindex);
         return true;
     };
 
-    uint256 prevhash = pblock->hashPrevBlock;
-    BlockMap::iterator miSelf = mapBlockIndex.find(prevhash);
-    if (miSelf == mapBlockIndex.end()) {
+    // Validate a block building on the tip while it waits for its deadline, without connecting it.
+    // The script, signature and proof caches then make its activation a fast connect.
+    auto preValidate = [chainparams, pblock, pindex]() {
+        LOCK(cs_main);
+        CBlockIndex* tip = chainActive.Tip();
+        if (tip == nullptr || tip->GetBlockHash() != pblock->hashPrevBlock)
+            return;
+        int64_t nStart = GetTimeMicros();
+        CValidationState state;
+        bool valid = TestBlockValidity(state, chainparams, *pblock, tip, false, false);
+        LogPrint(BCLog::BENCH, "%s: prevalidated block %s (%s): %.2fms\n", __func__, pindex->GetBlockHash().ToString(),
+            valid ? "valid" : FormatStateMessage(state), MILLI * (GetTimeMicros() - nStart));
+    };
+
+    const CBlockIndex* prevIndex = pindex->pprev;
+    if (prevIndex == nullptr) {
         return error("%s: ActivateBestChain failed: new block ancestor is not in mapBlock.\n", __func__);
     }
-    //auto prevIndex = chainActive.Tip();
-    auto prevIndex = miSelf->second;
-    if (pblock->nDeadline / prevIndex->nBaseTarget + prevIndex->nTime > GetSystemTimeInSeconds()) {
-        LogPrintf("%s: deadline in feature, add to cache, block:%s, time:%d\n", __func__, pblock->GetHash().ToString(), pblock->nTime);
-        g_blockCache->AddBlock(pblock, activateBestChain);
+    const bool fEarly = DeadlineWait(pblock->nDeadline, prevIndex->nBaseTarget, chainparams.GetConsensus()) + prevIndex->nTime > GetSystemTimeInSeconds();
+    const uint256 blockHash = pindex->GetBlockHash();
+    g_forge_trace.BlockArrived(prevIndex->nHeight + 1, blockHash, pblock->nDeadline / prevIndex->nBaseTarget, nArrivalTime, fEarly);
+    TRACE4(validation, block_received, blockHash.begin(), prevIndex->nHeight + 1, pblock->nDeadline / prevIndex->nBaseTarget, fEarly);
+    if (fEarly) {
+        LogPrintf("%s: deadline in feature, add to cache, block:%s, time:%d\n", __func__, blockHash.ToString(), pblock->nTime);
+        g_blockCache->AddBlock(pblock, prevIndex, activateBestChain, preValidate);
         return true;
     }
     CValidationState state; // Only used to report errors, not invalidity - ignore it
     if (!g_chainstate.ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed (%s)\n", __func__, FormatStateMessage(state));
-    uint256 hash = pblock->GetHash();
-    miSelf = mapBlockIndex.find(hash);
-    auto blockIndex = miSelf->second;
-    g_blockCache->UpdateBestBlockIndex(blockIndex);
+    g_blockCache->UpdateBestBlockIndex(pindex);
     return true;
 }
 
+/** The view TestBlockValidity checks blocks against, reset before each check so its pool is reused. */
+static std::unique_ptr<CCoinsViewOverlay> pcoinsTest GUARDED_BY(cs_main);
+
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot)
 {
     AssertLockHeld(cs_main);
     assert(pindexPrev && pindexPrev == chainActive.Tip());
-    CCoinsViewCache viewNew(pcoinsTip.get());
+    if (!pcoinsTest || pcoinsTest->Parent() != pcoinsTip.get())
+        pcoinsTest.reset(new CCoinsViewOverlay(pcoinsTip.get()));
+    CCoinsViewOverlay& viewNew = *pcoinsTest;
+    viewNew.Reset();
     uint256 block_hash(block.GetHash());
     CBlockIndex indexDummy(block);
     indexDummy.pprev = pindexPrev;
@@ -3867,12 +4910,57 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        g_block_file_map.Forget(*it);
+        g_block_archive_map.Forget(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
+        fs::remove(GetBlockArchiveFilename(*it));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
     }
 }
 
+void ArchiveBlockFiles()
+{
+    static CMetricCounter& metricFiles = GetMetrics().Counter("blockarchive_files", "Block files recompressed into archives");
+    static CMetricCounter& metricSaved = GetMetrics().Counter("blockarchive_saved_bytes", "Bytes saved by archiving block files");
+    // Only run from the scheduler, one pass at a time: the files before it are archived.
+    static int nNextFile = 0;
+
+    if (fImporting || fReindex)
+        return;
+    int nLastFile;
+    {
+        LOCK(cs_LastBlockFile);
+        nLastFile = nLastBlockFile;
+    }
+    while (nNextFile < nLastFile && !fs::exists(GetBlockPosFilename(CDiskBlockPos(nNextFile, 0), "blk")))
+        nNextFile++;
+    if (nNextFile >= nLastFile)
+        return;
+
+    const int nFile = nNextFile;
+    const fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+    const fs::path archivePath = GetBlockArchiveFilename(nFile);
+    // Records still held in memory are written first, then the file is left as it is for good.
+    if (!g_block_writer.Flush(nFile) || !ArchiveBlockFile(path, archivePath))
+        return;
+    nNextFile++;
+    const CArchivedBlockFile archive(archivePath);
+    const uint64_t nRawSize = fs::file_size(path);
+    if (archive.IsNull() || archive.RawSize() != nRawSize) {
+        fs::remove(archivePath);
+        LogPrintf("%s: Archive of blk%05u.dat does not match it, left as it is\n", __func__, nFile);
+        return;
+    }
+    // The archive is in place before the file goes, a reader missing one finds the other.
+    const uint64_t nSize = fs::file_size(archivePath);
+    g_block_file_map.Forget(nFile);
+    fs::remove(path);
+    metricFiles.Add();
+    metricSaved.Add(nRawSize > nSize ? nRawSize - nSize : 0);
+    LogPrintf("Archived blk%05u.dat: %u -> %u bytes\n", nFile, nRawSize, nSize);
+}
+
 /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight)
 {
@@ -4012,12 +5100,17 @@ static FILE* OpenDiskFile(const CDiskBlockPos& pos, const char* prefix, bool fRe
 
 FILE* OpenBlockFile(const CDiskBlockPos& pos, bool fReadOnly)
 {
+    // A file is only read once its pending records are written.
+    if (fReadOnly && !pos.IsNull() && !g_block_writer.Flush(pos.nFile))
+        return nullptr;
     return OpenDiskFile(pos, "blk", fReadOnly);
 }
 
 /** Open an undo file (rev?????.dat) */
 static FILE* OpenUndoFile(const CDiskBlockPos& pos, bool fReadOnly)
 {
+    if (fReadOnly && !pos.IsNull() && !g_undo_writer.Flush(pos.nFile))
+        return nullptr;
     return OpenDiskFile(pos, "rev", fReadOnly);
 }
 
@@ -4039,7 +5132,7 @@ CBlockIndex* CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = blockIndexArena.New();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4127,6 +5220,8 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     }
     for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++) {
         CDiskBlockPos pos(*it, 0);
+        if (fs::exists(GetBlockArchiveFilename(*it)))
+            continue;
         if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
             return false;
         }
@@ -4188,6 +5283,39 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100, false);
 }
 
+/** Where a block to verify and its undo data are, read under cs_main for the verification threads. */
+struct VerifyDBJob
+{
+    CDiskBlockPos pos;
+    CDiskBlockPos undoPos;
+    uint256 hash;
+    uint256 hashPrev;
+    int nHeight;
+};
+
+/**
+ * Check levels 0 to 2 of one block without cs_main: read it, check it and read its undo data.
+ * Its proof of capacity is verified apart, in one batch with the others. Return the failure, if any.
+ */
+static std::string VerifyStoredBlock(const VerifyDBJob& job, int nCheckLevel, const Consensus::Params& consensusParams)
+{
+    CBlock block;
+    // check level 0: read from disk
+    if (!ReadBlockFromDisk(block, job.pos, job.nHeight, consensusParams, false) || block.GetHash() != job.hash)
+        return strprintf("ReadBlockFromDisk failed at %d, hash=%s", job.nHeight, job.hash.ToString());
+    // check level 1: verify block validity
+    CValidationState state;
+    if (nCheckLevel >= 1 && !CheckBlockAtHeight(block, state, consensusParams, job.nHeight, false, true))
+        return strprintf("found bad block at %d, hash=%s (%s)", job.nHeight, job.hash.ToString(), FormatStateMessage(state));
+    // check level 2: verify undo validity
+    if (nCheckLevel >= 2 && !job.undoPos.IsNull()) {
+        CBlockUndo undo;
+        if (!UndoReadFromDisk(undo, job.undoPos, job.hashPrev))
+            return strprintf("found bad undo data at %d, hash=%s", job.nHeight, job.hash.ToString());
+    }
+    return "";
+}
+
 bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView* coinsview, int nCheckLevel, int nCheckDepth)
 {
     LOCK(cs_main);
@@ -4199,22 +5327,11 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView* coinsview,
         nCheckDepth = chainActive.Height();
     nCheckLevel = std::max(0, std::min(4, nCheckLevel));
     LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
-    CCoinsViewCache coins(coinsview);
-    CBlockIndex* pindex;
-    CBlockIndex* pindexFailure = nullptr;
-    int nGoodTransactions = 0;
-    CValidationState state;
-    int reportDone = 0;
-    LogPrintf("[0%%]..."); /* Continued */
-    for (pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        boost::this_thread::interruption_point();
-        const int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
-        if (reportDone < percentageDone / 10) {
-            // report every 10% step
-            LogPrintf("[%d%%]...", percentageDone); /* Continued */
-            reportDone = percentageDone / 10;
-        }
-        uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
+    const Consensus::Params& consensusParams = chainparams.GetConsensus();
+
+    // The blocks to verify, from the tip down.
+    std::vector<CBlockIndex*> vIndex;
+    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
         if (pindex->nHeight <= chainActive.Height() - nCheckDepth)
             break;
         if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
@@ -4222,27 +5339,112 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView* coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            if (!pindex->GetUndoPos().IsNull()) {
-                if (!UndoReadFromDisk(undo, pindex)) {
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-                }
+        vIndex.push_back(pindex);
+    }
+
+    // Levels 0 to 3 take the first half of the progress when level 4 follows, levels 0 to 2
+    // the first half of that when level 3 follows.
+    int reportDone = 0;
+    auto fnProgress = [&](double fraction, int nFrom, int nTo) {
+        const int percentageDone = std::max(1, std::min(99, nFrom + (int)(fraction * (nTo - nFrom))));
+        if (reportDone < percentageDone / 10) {
+            // report every 10% step
+            LogPrintf("[%d%%]...", percentageDone); /* Continued */
+            reportDone = percentageDone / 10;
+        }
+        uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
+    };
+    const int nLevel3From = nCheckLevel >= 3 ? (nCheckLevel >= 4 ? 25 : 50) : 100;
+    const int nLevel4From = nCheckLevel >= 4 ? 50 : 100;
+    LogPrintf("[0%%]..."); /* Continued */
+
+    // Levels 0 to 2 check every block on its own, so the blocks are verified side by side
+    // on a thread per core, while the proofs of capacity are verified in one batch on the
+    // PoC check threads. Level 0 verifies the proofs a read would, level 1 all of them.
+    std::vector<VerifyDBJob> vJobs;
+    std::vector<PoCItem> vItems;
+    std::vector<size_t> vItemOf;
+    for (const CBlockIndex* pindex : vIndex) {
+        vJobs.push_back(VerifyDBJob{pindex->GetBlockPos(), pindex->GetUndoPos(), pindex->GetBlockHash(), pindex->pprev->GetBlockHash(), pindex->nHeight});
+        if (nCheckLevel >= 1 || (!(pindex->nStatus & BLOCK_POC_VALID) && !IsPoCAssumed(pindex, consensusParams))) {
+            vItemOf.push_back(vItems.size());
+            vItems.push_back(PoCItemOf(pindex, consensusParams));
+        } else {
+            vItemOf.push_back(std::numeric_limits<size_t>::max());
+        }
+    }
+    std::vector<std::string> vErrors(vJobs.size());
+    std::atomic<size_t> nNext{0};
+    std::atomic<size_t> nDone{0};
+    std::atomic<bool> fStop{false};
+    auto fnVerify = [&](bool fReport) {
+        while (!fStop) {
+            const size_t i = nNext++;
+            if (i >= vJobs.size())
+                return;
+            vErrors[i] = VerifyStoredBlock(vJobs[i], nCheckLevel, consensusParams);
+            if (!vErrors[i].empty())
+                fStop = true;
+            nDone++;
+            if (fReport) {
+                fnProgress((double)nDone / vJobs.size(), 0, nLevel3From);
+                if (ShutdownRequested() || boost::this_thread::interruption_requested())
+                    fStop = true;
             }
         }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+    };
+    std::vector<std::thread> threads;
+    const size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), vJobs.size());
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.emplace_back(fnVerify, false);
+    }
+    for (size_t first = 0; first < vItems.size() && !fStop; first += POC_INDEX_CHECK_CHUNK) {
+        CheckProofsOfCapacity(Span<PoCItem>(vItems.data() + first, std::min(POC_INDEX_CHECK_CHUNK, vItems.size() - first)), chainparams.TargetDeadline());
+    }
+    fnVerify(true);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    boost::this_thread::interruption_point();
+    if (ShutdownRequested())
+        return true;
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        if (vItemOf[i] != std::numeric_limits<size_t>::max()) {
+            if (!vItems[vItemOf[i]].fValid)
+                return error("VerifyDB(): *** proof of capacity failed at %d, hash=%s", vIndex[i]->nHeight, vIndex[i]->GetBlockHash().ToString());
+            SetPoCValid(vIndex[i]);
+        }
+        if (!vErrors[i].empty())
+            return error("VerifyDB(): *** %s", vErrors[i]);
+    }
+
+    // check level 3: check for inconsistencies during memory-only disconnect of tip blocks,
+    // reading the next blocks and their undo data meanwhile
+    CCoinsViewCache coins(coinsview);
+    CValidationState state;
+    CBlockIndex* pindexFailure = nullptr;
+    int nGoodTransactions = 0;
+    bool fSkippedLevel3 = false;
+    if (nCheckLevel >= 3) {
+        CBlockReadAhead readAhead(true);
+        for (size_t i = 0; i < vIndex.size(); i++) {
+            boost::this_thread::interruption_point();
+            fnProgress((double)i / vIndex.size(), nLevel3From, nLevel4From);
+            if (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage) {
+                fSkippedLevel3 = true;
+                break;
+            }
+            CBlockIndex* pindex = vIndex[i];
+            readAhead.Request(std::vector<const CBlockIndex*>(vIndex.begin() + i, vIndex.begin() + std::min(vIndex.size(), i + BLOCK_READ_AHEAD)), consensusParams);
+            BlockRead read = readAhead.Take(pindex);
+            if (!read.block) {
+                auto pblock = std::make_shared<CBlock>();
+                if (!ReadBlockFromDisk(*pblock, pindex, consensusParams))
+                    return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                read.block = std::move(pblock);
+            }
             assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            DisconnectResult res = g_chainstate.DisconnectBlock(block, pindex, coins);
+            DisconnectResult res = g_chainstate.DisconnectBlock(*read.block, pindex, coins, read.undo.get());
             if (res == DISCONNECT_FAILED) {
                 return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
@@ -4250,40 +5452,43 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView* coinsview,
                 nGoodTransactions = 0;
                 pindexFailure = pindex;
             } else {
-                nGoodTransactions += block.vtx.size();
+                nGoodTransactions += read.block->vtx.size();
             }
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
+    if (fSkippedLevel3)
+        LogPrintf("VerifyDB(): skipped level 3 and up for the lower blocks, the coins cache is too small for them. Consider increasing -dbcache.\n");
 
-    // store block count as we move pindex at check level >= 4
-    int block_count = chainActive.Height() - pindex->nHeight;
-
-    // check level 4: try reconnecting blocks
-    if (nCheckLevel >= 4) {
-        while (pindex != chainActive.Tip()) {
+    // check level 4: try reconnecting blocks, reading the next ones meanwhile
+    if (nCheckLevel >= 4 && !fSkippedLevel3) {
+        CBlockReadAhead readAhead(false);
+        for (size_t i = vIndex.size(); i-- > 0;) {
             boost::this_thread::interruption_point();
-            const int percentageDone = std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50)));
-            if (reportDone < percentageDone / 10) {
-                // report every 10% step
-                LogPrintf("[%d%%]...", percentageDone); /* Continued */
-                reportDone = percentageDone / 10;
+            fnProgress((double)(vIndex.size() - i) / vIndex.size(), nLevel4From, 100);
+            CBlockIndex* pindex = vIndex[i];
+            std::vector<const CBlockIndex*> vAhead;
+            for (size_t j = i + 1; j-- > 0 && vAhead.size() < BLOCK_READ_AHEAD;) {
+                vAhead.push_back(vIndex[j]);
             }
-            uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
-            pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!g_chainstate.ConnectBlock(block, state, pindex, coins, chainparams))
+            readAhead.Request(vAhead, consensusParams);
+            BlockRead read = readAhead.Take(pindex);
+            if (!read.block) {
+                auto pblock = std::make_shared<CBlock>();
+                if (!ReadBlockFromDisk(*pblock, pindex, consensusParams))
+                    return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+                read.block = std::move(pblock);
+            }
+            if (!g_chainstate.ConnectBlock(*read.block, state, pindex, coins, chainparams))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
         }
     }
 
     LogPrintf("[DONE].\n");
-    LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", block_count, nGoodTransactions);
+    LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", vIndex.size(), nGoodTransactions);
 
     return true;
 }
@@ -4534,6 +5739,7 @@ void CChainState::UnloadBlockIndex()
     nBlockSequenceId = 1;
     m_failed_blocks.clear();
     setBlockIndexCandidates.clear();
+    blockIndexArena.Clear();
 }
 
 // May NOT be used after any connections are up as much
@@ -4556,9 +5762,7 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (const BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
+    // The entries are freed with the arena by g_chainstate.UnloadBlockIndex.
     mapBlockIndex.clear();
     fHavePruned = false;
 
@@ -4617,19 +5821,19 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos* dbp)
-{
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+/** Map of disk positions for blocks with unknown parent (only used for reindex) */
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
 
-    int nLoaded = 0;
+bool ScanBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos* dbp, const std::function<bool(const std::shared_ptr<CBlock>& pblock)>& fn)
+{
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
         while (!blkdat.eof()) {
             boost::this_thread::interruption_point();
+            if (ShutdownRequested())
+                break;
 
             blkdat.SetPos(nRewind);
             nRewind++;         // start one byte further next time, in case of failure
@@ -4659,83 +5863,204 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                blkdat >> *pblock;
                 nRewind = blkdat.GetPos();
 
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
+                if (!fn(pblock))
+                    break;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+        return false;
+    }
+    return true;
+}
 
-                    // process in case the block isn't known yet
-                    CBlockIndex* pindex = LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                        CValidationState state;
-                        if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
-                            nLoaded++;
-                        }
-                        if (state.IsError()) {
-                            break;
-                        }
-                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
-                }
+/**
+ * Accept a block read from a block file, and then any blocks stored before it that were
+ * waiting for it as their parent. The hashes of the blocks accepted are added to vAccepted.
+ * Returns false if the import cannot go on.
+ */
+static bool ProcessExternalBlock(const CChainParams& chainparams, const std::shared_ptr<CBlock>& pblock, CDiskBlockPos* dbp, std::vector<uint256>& vAccepted)
+{
+    const CBlock& block = *pblock;
+    uint256 hash = block.GetHash();
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
+            LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+            if (dbp)
+                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+            return true;
+        }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
+        // process in case the block isn't known yet
+        CBlockIndex* pindex = LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+            CValidationState state;
+            if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
+                vAccepted.push_back(hash);
+            }
+            if (state.IsError()) {
+                return false;
+            }
+        } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+            LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        auto height = chainActive.Height();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, height, chainparams.GetConsensus())) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr)) {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            // Its height is not known yet; the proof of capacity is verified once it is.
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, 0, chainparams.GetConsensus(), false)) {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                    head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr)) {
+                    vAccepted.push_back(pblockrecursive->GetHash());
+                    queue.push_back(pblockrecursive->GetHash());
                 }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
+bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos* dbp)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<uint256> vAccepted;
+    ScanBlockFile(chainparams, fileIn, dbp, [&](const std::shared_ptr<CBlock>& pblock) {
+        return ProcessExternalBlock(chainparams, pblock, dbp, vAccepted);
+    });
+    if (!vAccepted.empty())
+        LogPrintf("Loaded %i blocks from external file in %dms\n", vAccepted.size(), GetTimeMillis() - nStart);
+    return !vAccepted.empty();
+}
+
+/** The blocks found in a block file by a reindex scanner, in the order they are stored. */
+struct ScannedBlockFile
+{
+    bool fFound = false;
+    std::vector<std::pair<std::shared_ptr<CBlock>, CDiskBlockPos>> vBlocks;
+};
+
+static ScannedBlockFile ScanBlockFileForReindex(const CChainParams& chainparams, int nFile)
+{
+    ScannedBlockFile scanned;
+    CDiskBlockPos pos(nFile, 0);
+    // An archived file is scanned as it was written, it is archived again once the reindex is done.
+    if (!fs::exists(GetBlockPosFilename(pos, "blk")) && fs::exists(GetBlockArchiveFilename(nFile))) {
+        LogPrintf("Restoring archived block file blk%05u.dat for reindexing\n", nFile);
+        if (!RestoreBlockFile(GetBlockArchiveFilename(nFile), GetBlockPosFilename(pos, "blk")))
+            return scanned;
+    }
+    if (!fs::exists(GetBlockPosFilename(pos, "blk")))
+        return scanned; // No block files left to reindex
+    FILE* file = OpenBlockFile(pos, true);
+    if (!file)
+        return scanned; // This error is logged in OpenBlockFile
+    scanned.fFound = true;
+    ScanBlockFile(chainparams, file, &pos, [&](const std::shared_ptr<CBlock>& pblock) {
+        scanned.vBlocks.emplace_back(pblock, pos);
+        return true;
+    });
+    return scanned;
+}
+
+/**
+ * Verify the proofs of capacity of the blocks a reindex accepted, now that their heights
+ * are known, and mark them so connecting them does not verify them again. A block whose
+ * proof fails is left unmarked, to be rejected when it is connected.
+ */
+static void VerifyReindexedProofsOfCapacity(const CChainParams& chainparams, const std::vector<uint256>& vAccepted)
+{
+    std::vector<PoCItem> vItems;
+    std::vector<uint256> vHashes;
+    {
+        LOCK(cs_main);
+        for (const uint256& hash : vAccepted) {
+            const CBlockIndex* pindex = LookupBlockIndex(hash);
+            if (!pindex || pindex->nHeight == 0 || (pindex->nStatus & BLOCK_POC_VALID))
+                continue;
+            vItems.push_back(PoCItemOf(pindex, chainparams.GetConsensus()));
+            vHashes.push_back(hash);
+        }
+    }
+    CheckProofsOfCapacity(MakeSpan(vItems), chainparams.TargetDeadline());
+    LOCK(cs_main);
+    for (size_t i = 0; i < vItems.size(); i++) {
+        CBlockIndex* pindex = LookupBlockIndex(vHashes[i]);
+        if (pindex && vItems[i].fValid) {
+            pindex->nStatus |= BLOCK_POC_VALID;
+            setDirtyBlockIndex.insert(pindex);
+        }
+    }
+}
+
+bool ReindexBlockFiles(const CChainParams& chainparams)
+{
+    // Keep REINDEX_SCAN_AHEAD block files being scanned while the blocks of the one before are accepted.
+    std::deque<std::future<ScannedBlockFile>> scans;
+    int nNextScan = 0;
+    for (int nFile = 0; ; nFile++) {
+        while ((int)scans.size() < REINDEX_SCAN_AHEAD) {
+            scans.push_back(std::async(std::launch::async, ScanBlockFileForReindex, std::cref(chainparams), nNextScan++));
+        }
+        ScannedBlockFile scanned = scans.front().get();
+        scans.pop_front();
+        // A scan cut short by a shutdown must not pass for the end of the block file.
+        if (ShutdownRequested())
+            return false;
+        if (!scanned.fFound)
+            return true;
+        LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+
+        int64_t nStart = GetTimeMillis();
+        std::vector<uint256> vAccepted;
+        for (auto& entry : scanned.vBlocks) {
+            boost::this_thread::interruption_point();
+            try {
+                if (!ProcessExternalBlock(chainparams, entry.first, &entry.second, vAccepted))
+                    break;
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
+        // Release the blocks before they are verified, to bound the memory the scans ahead take.
+        scanned.vBlocks.clear();
+        VerifyReindexedProofsOfCapacity(chainparams, vAccepted);
+        if (!vAccepted.empty())
+            LogPrintf("Loaded %i blocks from external file in %dms\n", vAccepted.size(), GetTimeMillis() - nStart);
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
 }
 
 void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
@@ -4960,7 +6285,8 @@ bool LoadMempool()
     int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
     FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
     CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
-    if (file.IsNull()) {
+    const bool fJournal = gArgs.GetBoolArg("-mempooljournal", DEFAULT_MEMPOOL_JOURNAL) && fs::exists(GetMempoolJournalPath());
+    if (file.IsNull() && !fJournal) {
         LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
         return false;
     }
@@ -4971,29 +6297,73 @@ bool LoadMempool()
     int64_t already_there = 0;
     int64_t nNow = GetTime();
 
-    try {
-        uint64_t version;
-        file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+    // The transactions to accept with their time and fee delta, in order,
+    // and where to find each of them, which the journal needs to remove them.
+    std::vector<std::tuple<CTransactionRef, int64_t, int64_t>> vTx;
+    std::map<uint256, size_t> mapTxIndex;
+    std::map<uint256, CAmount> mapDeltas;
+
+    if (!file.IsNull()) {
+        try {
+            uint64_t version;
+            file >> version;
+            if (version != MEMPOOL_DUMP_VERSION) {
+                return false;
+            }
+            uint64_t num;
+            file >> num;
+            while (num--) {
+                CTransactionRef tx;
+                int64_t nTime;
+                int64_t nFeeDelta;
+                file >> tx;
+                file >> nTime;
+                file >> nFeeDelta;
+                mapTxIndex[tx->GetHash()] = vTx.size();
+                vTx.emplace_back(tx, nTime, nFeeDelta);
+            }
+            file >> mapDeltas;
+        } catch (const std::exception& e) {
+            LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
             return false;
         }
-        uint64_t num;
-        file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
+    }
+
+    // Replay the changes made since mempool.dat was written.
+    if (fJournal) {
+        size_t nRecords = 0;
+        ReadMempoolJournal(GetMempoolJournalPath(), [&](CMempoolJournal::RecordType type, const CTransactionRef& tx, const uint256& txid, int64_t nTime) {
+            ++nRecords;
+            auto it = mapTxIndex.find(txid);
+            if (it != mapTxIndex.end()) {
+                std::get<0>(vTx[it->second]) = nullptr;
+                mapTxIndex.erase(it);
+            }
+            if (type == CMempoolJournal::ADD) {
+                mapTxIndex[txid] = vTx.size();
+                vTx.emplace_back(tx, nTime, 0);
+            }
+        });
+        LogPrintf("Replayed %u mempool journal records\n", nRecords);
+    }
+
+    // Take cs_main once per batch rather than once per transaction; the input
+    // scripts of each transaction are checked on the script check threads.
+    static const size_t LOAD_BATCH_SIZE = 100;
+    for (size_t i = 0; i < vTx.size();) {
+        LOCK(cs_main);
+        for (const size_t end = std::min(i + LOAD_BATCH_SIZE, vTx.size()); i < end; i++) {
+            const CTransactionRef& tx = std::get<0>(vTx[i]);
+            const int64_t nTime = std::get<1>(vTx[i]);
+            if (!tx)
+                continue;
+
+            CAmount amountdelta = std::get<2>(vTx[i]);
             if (amountdelta) {
                 mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
                 AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
                     nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
                     false /* test_accept */);
@@ -5013,18 +6383,13 @@ bool LoadMempool()
             } else {
                 ++expired;
             }
-            if (ShutdownRequested())
-                return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
+        if (ShutdownRequested())
+            return false;
+    }
 
-        for (const auto& i : mapDeltas) {
-            mempool.PrioritiseTransaction(i.first, i.second);
-        }
-    } catch (const std::exception& e) {
-        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
-        return false;
+    for (const auto& i : mapDeltas) {
+        mempool.PrioritiseTransaction(i.first, i.second);
     }
 
     LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
@@ -5047,6 +6412,9 @@ bool DumpMempool()
             mapDeltas[i.first] = i.second;
         }
         vinfo = mempool.infoAll();
+        if (g_mempool_journal) {
+            g_mempool_journal->BeginCompaction();
+        }
     }
 
     int64_t mid = GetTimeMicros();
@@ -5054,6 +6422,9 @@ bool DumpMempool()
     try {
         FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat.new", "wb");
         if (!filestr) {
+            if (g_mempool_journal) {
+                g_mempool_journal->EndCompaction(false);
+            }
             return false;
         }
 
@@ -5074,16 +6445,215 @@ bool DumpMempool()
         if (!FileCommit(file.Get()))
             throw std::runtime_error("FileCommit failed");
         file.fclose();
-        RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+        const bool fRenamed = RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+        // The journal starts over once mempool.dat holds what it recorded.
+        if (g_mempool_journal) {
+            g_mempool_journal->EndCompaction(fRenamed);
+        }
         int64_t last = GetTimeMicros();
         LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n", (mid - start) * MICRO, (last - mid) * MICRO);
     } catch (const std::exception& e) {
+        if (g_mempool_journal) {
+            g_mempool_journal->EndCompaction(false);
+        }
         LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
         return false;
     }
     return true;
 }
 
+static const uint64_t COINS_CACHE_DUMP_VERSION = 1;
+/** Outpoints read from coinscache.dat and moved into the coins cache at a time */
+static const size_t COINS_CACHE_LOAD_BATCH = 4096;
+/** Set once coinscache.dat is read, so a cache only partly filled from it does not replace it */
+static std::atomic_bool g_coins_cache_loaded{false};
+
+bool DumpCoinsCache()
+{
+    if (!g_coins_cache_loaded)
+        return false;
+    int64_t start = GetTimeMicros();
+
+    std::vector<COutPoint> outpoints;
+    {
+        LOCK2(cs_main, mempool.cs);
+        // The coins the mempool spends come first, the next blocks are made of them.
+        for (const CTxMemPoolEntry& entry : mempool.mapTx) {
+            for (const CTxIn& txin : entry.GetTx().vin) {
+                if (outpoints.size() < MAX_COINS_CACHE_DUMP && !mempool.exists(txin.prevout.hash))
+                    outpoints.push_back(txin.prevout);
+            }
+        }
+        pcoinsTip->GetCachedOutPoints(outpoints, MAX_COINS_CACHE_DUMP);
+    }
+
+    try {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "coinscache.dat.new", "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return false;
+        }
+        file << COINS_CACHE_DUMP_VERSION;
+        file << (uint64_t)outpoints.size();
+        for (const COutPoint& outpoint : outpoints) {
+            file << outpoint;
+        }
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        RenameOver(GetDataDir() / "coinscache.dat.new", GetDataDir() / "coinscache.dat");
+        LogPrintf("Dumped %u coins cache entries in %.3fs\n", outpoints.size(), (GetTimeMicros() - start) * MICRO);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump coins cache: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
+/** Move the coins of the outpoints in file into the coins cache, a batch at a time. Return how many were found. */
+static size_t LoadCoinsCache(CAutoFile& file)
+{
+    uint64_t version;
+    file >> version;
+    if (version != COINS_CACHE_DUMP_VERSION) {
+        return 0;
+    }
+    uint64_t nEntries;
+    file >> nEntries;
+
+    size_t nLoaded = 0;
+    std::vector<COutPoint> batch;
+    while (nEntries > 0) {
+        boost::this_thread::interruption_point();
+        batch.clear();
+        for (; nEntries > 0 && batch.size() < COINS_CACHE_LOAD_BATCH; nEntries--) {
+            COutPoint outpoint;
+            file >> outpoint;
+            batch.push_back(outpoint);
+        }
+        // The coins are read by the prefetch threads without cs_main, and only moved up
+        // into the cache under it.
+        for (const COutPoint& outpoint : batch) {
+            pcoinsprefetch->Prefetch(outpoint);
+        }
+        pcoinsprefetch->WaitForQueue();
+
+        LOCK(cs_main);
+        // Leave room for the coins of the next blocks, a full cache is flushed and emptied.
+        if (pcoinsTip->DynamicMemoryUsage() >= nCoinCacheUsage / 4 * 3) {
+            break;
+        }
+        for (const COutPoint& outpoint : batch) {
+            if (pcoinsTip->HaveCoin(outpoint))
+                nLoaded++;
+        }
+    }
+    return nLoaded;
+}
+
+void ThreadLoadCoinsCache()
+{
+    RenameThread("lava-coinsload");
+    int64_t start = GetTimeMicros();
+    CAutoFile file(fsbridge::fopen(GetDataDir() / "coinscache.dat", "rb"), SER_DISK, CLIENT_VERSION);
+    if (!file.IsNull()) {
+        try {
+            const size_t nLoaded = LoadCoinsCache(file);
+            LogPrintf("Loaded %u coins into the coins cache in %.3fs\n", nLoaded, (GetTimeMicros() - start) * MICRO);
+        } catch (const std::exception& e) {
+            LogPrintf("Failed to load coins cache: %s. Continuing anyway.\n", e.what());
+        }
+    }
+    g_coins_cache_loaded = true;
+}
+
+bool CChainState::LoadUTXOStats()
+{
+    AssertLockHeld(cs_main);
+    const uint256 hashBestBlock = pcoinsTip->GetBestBlock();
+    CUTXOStats stats;
+    if (hashBestBlock.IsNull()) {
+        // Before the genesis block, the only coins are those put in the cache at startup.
+        std::vector<COutPoint> outpoints;
+        pcoinsTip->GetCachedOutPoints(outpoints, std::numeric_limits<size_t>::max());
+        for (const COutPoint& outpoint : outpoints) {
+            stats.AddCoin(outpoint, pcoinsTip->AccessCoin(outpoint));
+        }
+    } else if (!pcoinsdbview->ReadUTXOStats(stats) || stats.hashBlock != hashBestBlock) {
+        return false;
+    }
+    m_utxo_stats = std::move(stats);
+    m_utxo_stats_tracked = true;
+    m_utxo_stats_complete = true;
+    return true;
+}
+
+bool CChainState::RebuildUTXOStats()
+{
+    // The chainstate is written out and scanned as of then, meanwhile the blocks connected
+    // and disconnected are tracked as changes and added to the scan once it is done.
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    {
+        LOCK(cs_main);
+        ::FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        if (pcursor->GetBestBlock() != pcoinsTip->GetBestBlock())
+            return error("%s: the chainstate was not written", __func__);
+        m_utxo_stats = CUTXOStats();
+        m_utxo_stats.hashBlock = pcursor->GetBestBlock();
+        m_utxo_stats_tracked = true;
+        m_utxo_stats_complete = false;
+    }
+
+    CUTXOStats stats;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            LOCK(cs_main);
+            m_utxo_stats_tracked = false;
+            return error("%s: unable to read value", __func__);
+        }
+        stats.AddCoin(key, coin);
+    }
+
+    LOCK(cs_main);
+    stats += m_utxo_stats;
+    m_utxo_stats = std::move(stats);
+    m_utxo_stats_complete = true;
+    return true;
+}
+
+bool CChainState::GetUTXOStats(CUTXOStats& stats)
+{
+    AssertLockHeld(cs_main);
+    if (!m_utxo_stats_complete)
+        return false;
+    stats = m_utxo_stats;
+    return true;
+}
+
+bool LoadUTXOStats()
+{
+    LOCK(cs_main);
+    return g_chainstate.LoadUTXOStats();
+}
+
+void ThreadRebuildUTXOStats()
+{
+    RenameThread("lava-utxostats");
+    int64_t start = GetTimeMicros();
+    LogPrintf("Rebuilding the UTXO set statistics...\n");
+    if (g_chainstate.RebuildUTXOStats())
+        LogPrintf("Rebuilt the UTXO set statistics in %.3fs\n", (GetTimeMicros() - start) * MICRO);
+}
+
+bool GetUTXOStatsAtTip(CUTXOStats& stats)
+{
+    LOCK(cs_main);
+    return g_chainstate.GetUTXOStats(stats);
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex* pindex)
@@ -5110,10 +6680,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup()
     {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+        // block headers, their entries are owned by the arena of g_chainstate
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
@@ -5134,6 +6701,21 @@ bool TestTicket(const int height, const CTicketRef ticket)
 bool LoadTicketView()
 {
     LogPrintf("%s: Load FireStones from block database...\n", __func__);
+    // The database is flushed before the chainstate, so it may be found ahead of it after a crash.
+    const uint256 hashBestBlock = pticketview->GetBestBlock();
+    const bool fConsistent = hashBestBlock.IsNull() || hashBestBlock == pcoinsTip->GetBestBlock();
+    try {
+        if (pticketview->LoadSlotsFromDisk(chainActive.Height(), !fConsistent))
+            return true;
+    } catch (const std::runtime_error& e) {
+        return error("%s: failure: %s", __func__, e.what());
+    }
+
+    // The slot summaries are missing, replay every height once and rewrite them. The heights of the
+    // closed slots are compacted into their summaries, so this only rebuilds a database written before.
+    if (chainActive.Height() >= 0 && pticketview->HeightsCompacted())
+        return error("%s: the firestone database is too far from the chainstate, restart with -reindex-chainstate", __func__);
+    LogPrintf("%s: Rebuild FireStone slots from block database...\n", __func__);
     for (auto i = 0; i <= chainActive.Height(); i++) {
         try {
             if (!pticketview->LoadTicketFromDisk(i))
@@ -5142,31 +6724,67 @@ bool LoadTicketView()
             return error("%s: failure: %s", __func__, e.what());
         }
     }
+    if (chainActive.Height() >= 0) {
+        pticketview->WriteSlotsToDisk(chainActive.Height());
+        if (!pticketview->Flush(pcoinsTip->GetBestBlock()))
+            return error("%s: failed to write ticket slots to disk", __func__);
+    }
+    return true;
+}
+
+bool LoadIssuanceView()
+{
+    const CBlockIndex* tip = chainActive.Tip();
+    if (tip != nullptr && pissuanceview->SyncedBlock() == tip->GetBlockHash())
+        return true;
+
+    // The index is new, or it was left on another chain by a reindex or an unclean shutdown.
+    LogPrintf("%s: Rebuild issuance index from block database...\n", __func__);
+    try {
+        if (!pissuanceview->Clear())
+            return error("%s: failed to clear issuance index", __func__);
+        for (int i = 0; tip != nullptr && i <= tip->nHeight; i++) {
+            const CBlockIndex* pindex = chainActive[i];
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrintf("%s: block %d is pruned, the issuance index misses its issuances\n", __func__, i);
+                continue;
+            }
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+                return error("%s: failed to read block from disk, height: %d", __func__, i);
+            pissuanceview->ConnectBlock(i, block);
+        }
+    } catch (const std::runtime_error& e) {
+        return error("%s: failure: %s", __func__, e.what());
+    }
     return true;
 }
 
 bool LoadRelationView()
 {
     LogPrintf("%s: Load Relations from block database...\n", __func__);
+    const uint256 hashBestBlock = prelationview->GetBestBlock();
+    if (!hashBestBlock.IsNull() && hashBestBlock != pcoinsTip->GetBestBlock()) {
+        // Ahead of the chainstate after an unclean shutdown, the records above the tip are skipped and rewritten.
+        LogPrintf("%s: relation database was flushed at %s, chainstate at %s\n", __func__, hashBestBlock.ToString(), pcoinsTip->GetBestBlock().ToString());
+    }
     if (chainActive.Tip()==nullptr){
         // new chain
         return true;
     }else{
-        // assember relationMap index.
-        CBlockIndex *currentIndex = chainActive.Genesis();
-        for (auto i = 0; i <= chainActive.Height(); i++) {
-            try {
+        // assember relationMap index, only the heights carrying actions are read.
+        try {
+            for (auto height : prelationview->ActionHeights(chainActive.Height())) {
                 bool pocxFlag = false;
-                if (currentIndex->nHeight >= Params().GetConsensus().LVIP05Height){
+                if (height >= Params().GetConsensus().LVIP05Height){
                     pocxFlag = true;
                 }
 
-                if (!prelationview->LoadRelationFromDisk(i, pocxFlag))
-                    return error("%s: failed to read relation from disk, height: %s", __func__, i);
-                currentIndex = chainActive.Next(currentIndex);
-            } catch (const std::runtime_error& e) {
-                return error("%s: failure: %s", __func__, e.what());
+                if (!prelationview->LoadRelationFromDisk(height, pocxFlag))
+                    return error("%s: failed to read relation from disk, height: %s", __func__, height);
             }
+        } catch (const std::runtime_error& e) {
+            return error("%s: failure: %s", __func__, e.what());
         }
         return true;
     }
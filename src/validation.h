@@ -17,12 +17,17 @@
 #include <policy/feerate.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <script/script_error.h>
+#include <span.h>
 #include <sync.h>
 #include <versionbits.h>
 #include <assember.h>
 #include <actiondb.h>
+#include <issuancedb.h>
+#include <ticket.h>
 #include <algorithm>
 #include <exception>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <set>
@@ -35,18 +40,24 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
 class CCoinsViewDB;
+class CCoinsViewPrefetch;
 class CInv;
+class CMappedFile;
 class CConnman;
+class CSchnorrBatch;
 class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
+class CUTXOStats;
 class CValidationState;
 struct ChainTxData;
 
 struct PrecomputedTransactionData;
 struct LockPoints;
+struct PoCItem;
 
 /** Default for -whitelistrelay. */
 static const bool DEFAULT_WHITELISTRELAY = true;
@@ -68,6 +79,8 @@ static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 /** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Default for -limitclustercount, max number of transactions in a cluster of the mempool in cluster mode */
+static const unsigned int DEFAULT_CLUSTER_LIMIT = 100;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
 /** Maximum kilobytes for transactions to store for processing during reorg */
@@ -79,12 +92,16 @@ static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 
+/** Blocks with at least this many transactions have their signature hash data computed in parallel */
+static const size_t PARALLEL_TXDATA_MIN_TXS = 256;
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Number of blocks that can be requested at any given time from a single peer that delivers them fast. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER_FAST = 64;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -121,8 +138,16 @@ static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistcoinscache */
+static const bool DEFAULT_PERSIST_COINS_CACHE = true;
+/** Most outpoints written to coinscache.dat, 36 bytes each */
+static const size_t MAX_COINS_CACHE_DUMP = 1 << 21;
+/** Default for -headersonly */
+static const bool DEFAULT_HEADERSONLY = false;
 /** Default for -mempoolreplacement */
 static const bool DEFAULT_ENABLE_REPLACEMENT = true;
+/** Default for -clustermempool */
+static const bool DEFAULT_CLUSTER_MEMPOOL = false;
 /** Default for using fee filter */
 static const bool DEFAULT_FEEFILTER = true;
 
@@ -137,6 +162,11 @@ static const bool DEFAULT_PEERBLOOMFILTERS = true;
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 
+/** Default for -prunestaleheaders, the blocks worth of work below our tip past which header-only side branches are removed */
+static const int DEFAULT_PRUNE_STALE_HEADERS = 1000;
+/** Age in seconds past which a header-only side branch far enough below our tip is removed */
+static const int64_t STALE_HEADERS_MIN_AGE = 24 * 60 * 60;
+
 struct BlockHasher
 {
     // this used to call `GetCheapHash()` in uint256, which was later moved; the
@@ -171,10 +201,15 @@ extern CAmount maxTxFee;
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 extern int64_t nMaxTipAge;
 extern bool fEnableReplacement;
+/** Whether the mempool is mined and trimmed by the chunks of its clusters (see CTxMemPool::LinearizeCluster). */
+extern bool fClusterMempool;
 
 /** Block hash whose ancestors we will assume to have valid scripts without checking them. */
 extern uint256 hashAssumeValid;
 
+/** Block hash whose ancestors we will assume to have valid proofs of capacity without checking them. */
+extern uint256 hashAssumePoC;
+
 /** Minimum work we will assume exists on some valid chain. */
 extern arith_uint256 nMinimumCumulativeDiff;
 
@@ -192,6 +227,8 @@ static const uint64_t nMinDiskSpace = 52428800;
 extern bool fHavePruned;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
+/** True if we're running in -headersonly mode: headers are synced and checked, blocks are never downloaded. */
+extern bool fHeadersOnly;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
@@ -201,6 +238,12 @@ static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+/** Number of tip blocks whose proofs of capacity are verified in the background at startup, 0 = none */
+static const int DEFAULT_CHECKPOCINDEX = 0;
+/** Proofs of capacity verified per hold of the check queue by -checkpocindex */
+static const size_t POC_INDEX_CHECK_CHUNK = 1024;
+/** Number of block files a reindex reads and deserializes ahead of the one whose blocks it accepts */
+static const int REINDEX_SCAN_AHEAD = 2;
 
 // Require that user allocate at least 550 MiB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -256,6 +299,14 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
+/**
+ * Find the blocks stored in fileIn and pass each one to fn, with its position in dbp if given.
+ * Stops early when fn returns false. Returns false on a system error.
+ */
+bool ScanBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos* dbp, const std::function<bool(const std::shared_ptr<CBlock>& pblock)>& fn);
+/** Rebuild the block index from the block files, scanning the next files while the blocks of one are accepted.
+ *  Returns false if it was cut short by a shutdown. */
+bool ReindexBlockFiles(const CChainParams& chainparams);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk,
@@ -267,6 +318,14 @@ bool LoadChainTip(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_m
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof of capacity checking thread */
+void ThreadPoCCheck();
+/** Verify the proofs of capacity of the last nDepth blocks of the active chain, aborting the node if one fails */
+void ThreadCheckPoCIndex(const int nDepth);
+/** Verify the proofs of capacity of submitted nonces, setting fValid of every item: on the device set by
+ *  SetPoCBatchVerifier when the batch is large enough for it, otherwise, or should the device fail, in
+ *  runs spread over the PoC check threads. */
+void CheckSubmittedProofsOfCapacity(Span<PoCItem> items, const uint64_t targetDeadline);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -296,6 +355,12 @@ void PruneOneBlockFile(const int fileNumber) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
  */
 void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
+/**
+ * Archive the oldest block file that is no longer written to and not archived yet,
+ * if any, for -archiveblocks. Blocks are read back from archives transparently.
+ */
+void ArchiveBlockFiles();
+
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
@@ -309,6 +374,19 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** Most transactions in a package */
+static const unsigned int MAX_PACKAGE_COUNT = 25;
+/** Most virtual size of the transactions of a package together, in kvB */
+static const unsigned int MAX_PACKAGE_SIZE = 101;
+
+/** (try to) add a package of transactions to memory pool, all of them or none
+ * The package is sorted so that transactions only spend the ones before them, the
+ * chain or the mempool. Its fee is judged for the transactions together, so a parent
+ * paying too little on its own is accepted along with a child paying for it. The
+ * transactions already in the mempool are skipped. **/
+bool AcceptPackageToMemoryPool(CTxMemPool& pool, CValidationState &state, const std::vector<CTransactionRef>& package,
+                               bool* pfMissingInputs, const CAmount nAbsurdFee) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -356,6 +434,8 @@ bool CheckSequenceLocks(const CTxMemPool& pool, const CTransaction& tx, int flag
 
 bool LoadTicketView();
 bool LoadRelationView();
+/** Rebuild the issuance index from the block files if it is not synced to the active chain. */
+bool LoadIssuanceView();
 /**
  * Closure representing one script verification
  * Note that this stores references to the spending transaction
@@ -370,14 +450,18 @@ private:
     bool cacheStore;
     ScriptError error;
     PrecomputedTransactionData *txdata;
+    CSchnorrBatch *schnorrBatch;
 
 public:
-    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn) :
-        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), schnorrBatch(nullptr) {}
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn, CSchnorrBatch* schnorrBatchIn = nullptr) :
+        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), schnorrBatch(schnorrBatchIn) { }
 
     bool operator()();
 
+    /** An estimate of the work of the check for CCheckQueue, about one per signature it carries. */
+    unsigned int GetCost() const;
+
     void swap(CScriptCheck &check) {
         std::swap(ptxTo, check.ptxTo);
         std::swap(m_tx_out, check.m_tx_out);
@@ -386,6 +470,7 @@ public:
         std::swap(cacheStore, check.cacheStore);
         std::swap(error, check.error);
         std::swap(txdata, check.txdata);
+        std::swap(schnorrBatch, check.schnorrBatch);
     }
 
     ScriptError GetScriptError() const { return error; }
@@ -396,11 +481,46 @@ void InitScriptExecutionCache();
 
 
 /** Functions for disk access for blocks */
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const int height, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const int height, const Consensus::Params& consensusParams, bool fCheckPoc = true);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
+/**
+ * A serialized block as stored on disk. It points into its mapped block file where the
+ * file can be mapped, otherwise into a buffer it was read into.
+ */
+struct RawBlockData
+{
+    std::shared_ptr<const CMappedFile> file;
+    std::vector<uint8_t> buffer;
+    Span<const uint8_t> data;
+};
+bool ReadRawBlockFromDisk(RawBlockData& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+/** A block read in the background, with its undo data if asked for. A part that could not be read is null. */
+struct BlockRead
+{
+    std::shared_ptr<const CBlock> block;
+    std::shared_ptr<CBlockUndo> undo;
+    bool fPoCChecked = false;   //!< the proof of capacity of the block was verified by the read
+};
+
+/**
+ * Read blocks, and their undo data if fUndo, on the block I/O threads, all submitted at
+ * once. Their positions are taken under cs_main, the reads do not take it, so the caller
+ * may wait for them holding it. A part that failed to read is left null, for the caller
+ * to read again and report the error. Without I/O threads, a block is read when waited for.
+ */
+std::vector<std::future<BlockRead>> ReadBlocksFromDiskAsync(const std::vector<const CBlockIndex*>& blocks, bool fUndo, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/**
+ * Have the block I/O threads fault in the records of blocks in mapped block files, so
+ * serving them does not wait for the disk. Nothing is done without I/O threads.
+ */
+void PrefetchBlocksFromDisk(const std::vector<const CBlockIndex*>& blocks) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
@@ -461,6 +581,14 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
 /** Remove invalidity status from a block and its descendants. */
 void ResetBlockFailureFlags(CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Remove the header-only side branches whose tip is more than nDepth blocks worth of work
+ * below our tip and older than nMinAge seconds, from memory and from the block tree DB.
+ * The entries in setKeep, still referenced by the caller, and their ancestors are kept.
+ * Return the number of entries removed.
+ */
+size_t PruneStaleHeaders(const std::set<const CBlockIndex*>& setKeep, int nDepth, int64_t nMinAge) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain& chainActive;
 
@@ -473,15 +601,21 @@ extern CPOCBlockAssember& blockAssember;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
+/** Global variable that points to the prefetching layer over pcoinsdbview */
+extern std::unique_ptr<CCoinsViewPrefetch> pcoinsprefetch;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 
-/** Global variable that points to the active CTicketView (protected by cs_main) */
+/** Global variable that points to the active CTicketView (set with cs_main held, the view has its own lock) */
 extern std::unique_ptr<CTicketView> pticketview;
 
-/** Global variable that points to the active CRelationView (protected by cs_main) */
+/** Global variable that points to the active CRelationView (set with cs_main held, the view has its own lock) */
 extern std::unique_ptr<CRelationView> prelationview;
 
+/** Global variable that points to the active CIssuanceView (protected by cs_main) */
+extern std::unique_ptr<CIssuanceView> pissuanceview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern std::unique_ptr<CBlockTreeDB> pblocktree;
 
@@ -518,6 +652,27 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/**
+ * Write the outpoints of the coins the mempool spends, then of the unspent coins in the
+ * coins cache, to coinscache.dat. To be called before the cache is flushed at shutdown.
+ */
+bool DumpCoinsCache();
+
+/** Read the coins of coinscache.dat back into the coins cache, in the background at startup. */
+void ThreadLoadCoinsCache();
+
+/**
+ * Start keeping the statistics of the UTXO set up to date, from those written with the
+ * chainstate. Return false if there are none of its best block, they must be rebuilt then.
+ */
+bool LoadUTXOStats();
+
+/** Rebuild the statistics of the UTXO set from a scan of the chainstate, in the background at startup. */
+void ThreadRebuildUTXOStats();
+
+/** The statistics of the UTXO set at the tip, false while they are not known. */
+bool GetUTXOStatsAtTip(CUTXOStats& stats);
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
@@ -5,12 +5,14 @@
 
 #include <validationinterface.h>
 
+#include <metrics.h>
 #include <primitives/block.h>
 #include <scheduler.h>
 #include <txmempool.h>
 #include <util/system.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <list>
 #include <atomic>
 #include <future>
@@ -19,35 +21,68 @@
 #include <boost/signals2/signal.hpp>
 
 struct ValidationInterfaceConnections {
-    boost::signals2::scoped_connection UpdatedBlockTip;
-    boost::signals2::scoped_connection TransactionAddedToMempool;
-    boost::signals2::scoped_connection BlockConnected;
-    boost::signals2::scoped_connection BlockDisconnected;
-    boost::signals2::scoped_connection TransactionRemovedFromMempool;
-    boost::signals2::scoped_connection ChainStateFlushed;
     boost::signals2::scoped_connection Broadcast;
     boost::signals2::scoped_connection BlockChecked;
     boost::signals2::scoped_connection NewPoWValidBlock;
 };
 
+/**
+ * A registered subscriber. Its queued callbacks run in order on a queue of its own, so
+ * the subscribers are called in parallel by the threads of the scheduler, each of them
+ * still one callback at a time.
+ */
+struct ValidationInterfaceSubscriber {
+    //! Cleared on unregistering; callbacks still queued for the subscriber are dropped.
+    std::shared_ptr<std::atomic<bool>> connected;
+    SingleThreadedSchedulerClient* queue;
+    ValidationInterfaceConnections conns;
+    CMetricCounter* queued;
+    CMetricCounter* run;
+    CMetricHistogram* lag;
+};
+
 struct MainSignalsInstance {
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionRemovedFromMempool;
-    boost::signals2::signal<void (const CBlockLocator &)> ChainStateFlushed;
+    // The callbacks called on the thread of the caller.
     boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
     boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
 
+    CScheduler* const m_scheduler;
     // We are not allowed to assume the scheduler only runs in one thread,
     // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
+    // our own queues here :(
+    // This one only carries the functions of CallFunctionInValidationInterfaceQueue,
+    // so they run even with no subscriber registered.
     SingleThreadedSchedulerClient m_schedulerClient;
-    std::unordered_map<CValidationInterface*, ValidationInterfaceConnections> m_connMainSignals;
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    Mutex m_mutex;
+    std::unordered_map<CValidationInterface*, ValidationInterfaceSubscriber> m_subscribers GUARDED_BY(m_mutex);
+    // The scheduler refers to a queue until its last callback ran, so the queues of
+    // unregistered subscribers are kept and handed to the next subscriber registering.
+    std::vector<std::unique_ptr<SingleThreadedSchedulerClient>> m_queues GUARDED_BY(m_mutex);
+    std::vector<SingleThreadedSchedulerClient*> m_idle_queues GUARDED_BY(m_mutex);
+
+    explicit MainSignalsInstance(CScheduler *pscheduler) : m_scheduler(pscheduler), m_schedulerClient(pscheduler) {}
+
+    /** Queue func on the queue of every subscriber registered now, in the order of the calls. */
+    void Dispatch(std::function<void (CValidationInterface*)> func)
+    {
+        LOCK(m_mutex);
+        const int64_t nQueued = GetTimeMicros();
+        for (auto& entry : m_subscribers) {
+            CValidationInterface* pcallbacks = entry.first;
+            const ValidationInterfaceSubscriber& subscriber = entry.second;
+            std::shared_ptr<std::atomic<bool>> connected = subscriber.connected;
+            CMetricCounter* run = subscriber.run;
+            CMetricHistogram* lag = subscriber.lag;
+            subscriber.queued->Add();
+            subscriber.queue->AddToProcessQueue([func, pcallbacks, connected, run, lag, nQueued] {
+                lag->Record(GetTimeMicros() - nQueued);
+                run->Add();
+                if (*connected) func(pcallbacks);
+            });
+        }
+    }
 };
 
 static CMainSignals g_signals;
@@ -68,13 +103,28 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
+        std::vector<SingleThreadedSchedulerClient*> queues;
+        {
+            LOCK(m_internals->m_mutex);
+            for (const auto& queue : m_internals->m_queues) {
+                queues.push_back(queue.get());
+            }
+        }
+        for (SingleThreadedSchedulerClient* queue : queues) {
+            queue->EmptyQueue();
+        }
         m_internals->m_schedulerClient.EmptyQueue();
     }
 }
 
 size_t CMainSignals::CallbacksPending() {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    LOCK(m_internals->m_mutex);
+    size_t pending = m_internals->m_schedulerClient.CallbacksPending();
+    for (const auto& queue : m_internals->m_queues) {
+        pending = std::max(pending, queue->CallbacksPending());
+    }
+    return pending;
 }
 
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
@@ -93,22 +143,44 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    ValidationInterfaceConnections& conns = g_signals.m_internals->m_connMainSignals[pwalletIn];
-    conns.UpdatedBlockTip = g_signals.m_internals->UpdatedBlockTip.connect(std::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    conns.TransactionAddedToMempool = g_signals.m_internals->TransactionAddedToMempool.connect(std::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, std::placeholders::_1));
-    conns.BlockConnected = g_signals.m_internals->BlockConnected.connect(std::bind(&CValidationInterface::BlockConnected, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    conns.BlockDisconnected = g_signals.m_internals->BlockDisconnected.connect(std::bind(&CValidationInterface::BlockDisconnected, pwalletIn, std::placeholders::_1));
-    conns.TransactionRemovedFromMempool = g_signals.m_internals->TransactionRemovedFromMempool.connect(std::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, std::placeholders::_1));
-    conns.ChainStateFlushed = g_signals.m_internals->ChainStateFlushed.connect(std::bind(&CValidationInterface::ChainStateFlushed, pwalletIn, std::placeholders::_1));
-    conns.Broadcast = g_signals.m_internals->Broadcast.connect(std::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, std::placeholders::_1, std::placeholders::_2));
-    conns.BlockChecked = g_signals.m_internals->BlockChecked.connect(std::bind(&CValidationInterface::BlockChecked, pwalletIn, std::placeholders::_1, std::placeholders::_2));
-    conns.NewPoWValidBlock = g_signals.m_internals->NewPoWValidBlock.connect(std::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& name) {
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_mutex);
+    assert(!internals.m_subscribers.count(pwalletIn));
+    ValidationInterfaceSubscriber& subscriber = internals.m_subscribers[pwalletIn];
+    subscriber.connected = std::make_shared<std::atomic<bool>>(true);
+    if (internals.m_idle_queues.empty()) {
+        internals.m_queues.emplace_back(new SingleThreadedSchedulerClient(internals.m_scheduler));
+        subscriber.queue = internals.m_queues.back().get();
+    } else {
+        subscriber.queue = internals.m_idle_queues.back();
+        internals.m_idle_queues.pop_back();
+    }
+    // The callbacks queued minus the callbacks run is the backlog of the subscriber.
+    subscriber.queued = &GetMetrics().Counter("validationinterface_" + name + "_queued", "Callbacks queued for the " + name + " validation interface subscriber");
+    subscriber.run = &GetMetrics().Counter("validationinterface_" + name + "_run", "Callbacks of the " + name + " validation interface subscriber run");
+    subscriber.lag = &GetMetrics().Histogram("validationinterface_" + name + "_lag", "Time callbacks of the " + name + " validation interface subscriber wait in its queue");
+    ValidationInterfaceConnections& conns = subscriber.conns;
+    conns.Broadcast = internals.Broadcast.connect(std::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+    conns.BlockChecked = internals.BlockChecked.connect(std::bind(&CValidationInterface::BlockChecked, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+    conns.NewPoWValidBlock = internals.NewPoWValidBlock.connect(std::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+}
+
+static void DisconnectSubscriber(MainSignalsInstance& internals, ValidationInterfaceSubscriber& subscriber) EXCLUSIVE_LOCKS_REQUIRED(internals.m_mutex)
+{
+    *subscriber.connected = false;
+    internals.m_idle_queues.push_back(subscriber.queue);
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     if (g_signals.m_internals) {
-        g_signals.m_internals->m_connMainSignals.erase(pwalletIn);
+        MainSignalsInstance& internals = *g_signals.m_internals;
+        LOCK(internals.m_mutex);
+        auto it = internals.m_subscribers.find(pwalletIn);
+        if (it != internals.m_subscribers.end()) {
+            DisconnectSubscriber(internals, it->second);
+            internals.m_subscribers.erase(it);
+        }
     }
 }
 
@@ -116,11 +188,29 @@ void UnregisterAllValidationInterfaces() {
     if (!g_signals.m_internals) {
         return;
     }
-    g_signals.m_internals->m_connMainSignals.clear();
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_mutex);
+    for (auto& entry : internals.m_subscribers) {
+        DisconnectSubscriber(internals, entry.second);
+    }
+    internals.m_subscribers.clear();
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_mutex);
+    // func runs on whichever queue drains up to it last, so after the callbacks queued
+    // before it on every queue, including the idle ones, which may still be running the
+    // last callback of a subscriber that just unregistered.
+    auto remaining = std::make_shared<std::atomic<size_t>>(internals.m_queues.size() + 1);
+    auto shared_func = std::make_shared<std::function<void ()>>(std::move(func));
+    auto arrive = [remaining, shared_func] {
+        if (--*remaining == 0) (*shared_func)();
+    };
+    for (const auto& queue : internals.m_queues) {
+        queue->AddToProcessQueue(arrive);
+    }
+    internals.m_schedulerClient.AddToProcessQueue(arrive);
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -135,8 +225,8 @@ void SyncWithValidationInterfaceQueue() {
 
 void CMainSignals::MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
     if (reason != MemPoolRemovalReason::BLOCK && reason != MemPoolRemovalReason::CONFLICT) {
-        m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
-            m_internals->TransactionRemovedFromMempool(ptx);
+        m_internals->Dispatch([ptx](CValidationInterface* pcallbacks) {
+            pcallbacks->TransactionRemovedFromMempool(ptx);
         });
     }
 }
@@ -146,32 +236,32 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    m_internals->Dispatch([pindexNew, pindexFork, fInitialDownload](CValidationInterface* pcallbacks) {
+        pcallbacks->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     });
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
-    m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
-        m_internals->TransactionAddedToMempool(ptx);
+    m_internals->Dispatch([ptx](CValidationInterface* pcallbacks) {
+        pcallbacks->TransactionAddedToMempool(ptx);
     });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
-        m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
+    m_internals->Dispatch([pblock, pindex, pvtxConflicted](CValidationInterface* pcallbacks) {
+        pcallbacks->BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, this] {
-        m_internals->BlockDisconnected(pblock);
+    m_internals->Dispatch([pblock](CValidationInterface* pcallbacks) {
+        pcallbacks->BlockDisconnected(pblock);
     });
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
-    m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
-        m_internals->ChainStateFlushed(locator);
+    m_internals->Dispatch([locator](CValidationInterface* pcallbacks) {
+        pcallbacks->ChainStateFlushed(locator);
     });
 }
 
@@ -186,3 +276,15 @@ void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& sta
 void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) {
     m_internals->NewPoWValidBlock(pindex, block);
 }
+
+void CMainSignals::PoCBlockConnected(const CBlockIndex *pindex, const std::shared_ptr<const CPoCBlockChanges> &changes) {
+    m_internals->Dispatch([pindex, changes](CValidationInterface* pcallbacks) {
+        pcallbacks->PoCBlockConnected(pindex, changes);
+    });
+}
+
+void CMainSignals::NewBestDeadline(const std::shared_ptr<const CPOCDeadline> &deadline) {
+    m_internals->Dispatch([deadline](CValidationInterface* pcallbacks) {
+        pcallbacks->NewBestDeadline(deadline);
+    });
+}
@@ -11,6 +11,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 extern CCriticalSection cs_main;
 class CBlock;
@@ -24,12 +25,18 @@ class CValidationState;
 class uint256;
 class CScheduler;
 class CTxMemPool;
+struct CPoCBlockChanges;
+struct CPOCDeadline;
 enum class MemPoolRemovalReason;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. The queued callbacks of every subscriber
+ * run on a queue of its own, in parallel to those of the others; name labels the metrics
+ * of its queue.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& name = "other");
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -147,7 +154,22 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    /**
+     * Notifies listeners of the firestones bought and spent by a block being connected, the
+     * bind and unbind actions accepted from it, and the slot it is in. Generated before the
+     * BlockConnected of the block.
+     *
+     * Called on a background thread.
+     */
+    virtual void PoCBlockConnected(const CBlockIndex *pindex, const std::shared_ptr<const CPoCBlockChanges>& changes) {}
+    /**
+     * Notifies listeners of a new best deadline submitted for the next block.
+     *
+     * Called on a background thread.
+     */
+    virtual void NewBestDeadline(const std::shared_ptr<const CPOCDeadline>& deadline) {}
+    friend class CMainSignals;
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -157,7 +179,7 @@ class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
@@ -172,6 +194,7 @@ public:
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** The callbacks waiting in the longest of the subscriber queues. */
     size_t CallbacksPending();
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
@@ -187,6 +210,8 @@ public:
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     void BlockChecked(const CBlock&, const CValidationState&);
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
+    void PoCBlockConnected(const CBlockIndex *, const std::shared_ptr<const CPoCBlockChanges>&);
+    void NewBestDeadline(const std::shared_ptr<const CPOCDeadline>&);
 };
 
 CMainSignals& GetMainSignals();
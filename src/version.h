@@ -9,7 +9,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 90023;
+static const int PROTOCOL_VERSION = 90027;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -42,4 +42,16 @@ static const int SHORT_IDS_BLOCKS_VERSION = 70014;
 //! not banning for invalid compact blocks starts with this version
 static const int INVALID_CB_NO_BAN_VERSION = 70015;
 
+//! "sendrecon" and the reconciliation of transaction announcements start with this version
+static const int TXRECON_VERSION = 90024;
+
+//! "pkgtxns" and the relay of transaction packages start with this version
+static const int PACKAGE_RELAY_VERSION = 90025;
+
+//! "deadline" and the announcement of the best deadlines of the forgers start with this version
+static const int DEADLINE_ANNOUNCE_VERSION = 90026;
+
+//! "compressed" and the compression of block and transaction messages, with NODE_COMPRESS, start with this version
+static const int COMPRESS_VERSION = 90027;
+
 #endif // BITCOIN_VERSION_H
@@ -70,7 +70,8 @@ CInputCoin::CInputCoin(const CWalletTx* wtx, unsigned int i) {
         throw std::out_of_range("The output index is out of range");
 
     outpoint = COutPoint(wtx->tx->GetHash(), i);
-    txout = wtx->tx->vout[i];
+    // The proofs stay in the transaction, selecting and signing only need the commitments.
+    txout = wtx->tx->vout[i].WithoutProofs();
     effective_value = txout.nValue;
     value = txout.nValue;
     if (! txout.IsCA()){
@@ -242,7 +243,7 @@ bool KnapsackSolver(const CAmountMap& mapTargetValue, std::vector<OutputGroup>&
     std::vector<OutputGroup> inner_groups;
     std::set<CInputCoin> inner_coinsret;
     // Perform the standard Knapsack solver for every asset individually.
-    for(std::map<CAsset, CAmount>::const_iterator it = mapTargetValue.begin(); it != mapTargetValue.end(); ++it) {
+    for(CAmountMap::const_iterator it = mapTargetValue.begin(); it != mapTargetValue.end(); ++it) {
         inner_groups.clear();
         inner_coinsret.clear();
 
@@ -48,6 +48,7 @@
 #include <univalue.h>
 
 #include <functional>
+#include <future>
 
 #include <blind.h>
 #include <issuance.h>
@@ -1676,6 +1677,37 @@ static void ListTransactions(interfaces::Chain::Lock& locked_chain, CWallet* con
     }
 }
 
+/** Default page size of listunspent with a cursor */
+static const uint64_t DEFAULT_LIST_PAGE_SIZE = 1000;
+
+/** Encode the position a listing stopped at as the opaque cursor its next page starts from. */
+template <typename T>
+static std::string EncodeListCursor(const T& position)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << position;
+    return HexStr(ss.begin(), ss.end());
+}
+
+template <typename T>
+static T DecodeListCursor(const std::string& cursor)
+{
+    T position;
+    if (!IsHex(cursor)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    CDataStream ss(ParseHex(cursor), SER_NETWORK, PROTOCOL_VERSION);
+    try {
+        ss >> position;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!ss.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    return position;
+}
+
 UniValue listtransactions(const JSONRPCRequest& request)
 {
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
@@ -1685,17 +1717,20 @@ UniValue listtransactions(const JSONRPCRequest& request)
         return NullUniValue;
     }
 
-    if (request.fHelp || request.params.size() > 4)
+    if (request.fHelp || request.params.size() > 5)
         throw std::runtime_error(
             RPCHelpMan{"listtransactions",
                 "\nIf a label name is provided, this will return only incoming transactions paying to addresses with the specified label.\n"
-                "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions.\n",
+                "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions.\n"
+                "\nWith a cursor, returns the page of up to 'count' transactions older than the previous page, and the cursor of the next one.\n",
                 {
                     {"label", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "If set, should be a valid label name to return only incoming transactions\n"
             "              with the specified label, or \"*\" to disable filtering and return all transactions."},
                     {"count", RPCArg::Type::NUM, /* default */ "10", "The number of transactions to return"},
                     {"skip", RPCArg::Type::NUM, /* default */ "0", "The number of transactions to skip"},
                     {"include_watchonly", RPCArg::Type::BOOL, /* default */ "false", "Include transactions to watch-only addresses (see 'importaddress')"},
+                    {"cursor", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "The cursor a previous page returned, or \"\" for the first page.\n"
+            "              The result is then an object {\"transactions\":[...], \"cursor\":\"cursor\"}, the cursor being null after the last page."},
                 },
                 RPCResult{
             "[\n"
@@ -1736,7 +1771,9 @@ UniValue listtransactions(const JSONRPCRequest& request)
             "\nList transactions 100 to 120\n"
             + HelpExampleCli("listtransactions", "\"*\" 20 100") +
             "\nAs a JSON-RPC call\n"
-            + HelpExampleRpc("listtransactions", "\"*\", 20, 100")
+            + HelpExampleRpc("listtransactions", "\"*\", 20, 100") +
+            "\nList the most recent transactions a page of 1000 at a time\n"
+            + HelpExampleCli("listtransactions", "\"*\" 1000 0 false \"\"")
                 },
             }.ToString());
 
@@ -1769,6 +1806,39 @@ UniValue listtransactions(const JSONRPCRequest& request)
 
     UniValue ret(UniValue::VARR);
 
+    if (!request.params[4].isNull()) {
+        if (nFrom > 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot skip transactions with a cursor");
+        const std::string& cursor = request.params[4].get_str();
+        // The cursor is the order position of the last transaction listed; a page only
+        // walks the transactions it returns, so the wallet is locked as briefly.
+        bool fMore = false;
+        int64_t nOrderPos = 0;
+        {
+            auto locked_chain = pwallet->chain().lock();
+            LOCK(pwallet->cs_wallet);
+
+            const CWallet::TxItems& txOrdered = pwallet->wtxOrdered;
+            auto it = cursor.empty() ? txOrdered.end() : txOrdered.lower_bound(DecodeListCursor<int64_t>(cursor));
+            for (CWallet::TxItems::const_reverse_iterator rit(it); rit != txOrdered.rend() && (int)ret.size() < nCount; ++rit) {
+                ListTransactions(*locked_chain, pwallet, *rit->second, 0, true, ret, filter, filter_label);
+                nOrderPos = rit->first;
+                fMore = std::next(rit) != txOrdered.rend();
+            }
+        }
+
+        // ret is newest to oldest
+        std::vector<UniValue> arrTmp = ret.getValues();
+        std::reverse(arrTmp.begin(), arrTmp.end());
+        UniValue transactions(UniValue::VARR);
+        transactions.push_backV(arrTmp);
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("transactions", transactions);
+        result.pushKV("cursor", fMore ? UniValue(EncodeListCursor(nOrderPos)) : NullUniValue);
+        return result;
+    }
+
     {
         auto locked_chain = pwallet->chain().lock();
         LOCK(pwallet->cs_wallet);
@@ -3041,6 +3111,9 @@ static UniValue listunspent(const JSONRPCRequest& request)
                             {"maximumCount", RPCArg::Type::NUM, /* default */ "unlimited", "Maximum number of UTXOs"},
                             {"minimumSumAmount", RPCArg::Type::AMOUNT, /* default */ "unlimited", "Minimum sum value of all UTXOs in " + CURRENCY_UNIT + ""},
                             {"asset", RPCArg::Type::STR, /* default */ "", "Asset to filter outputs for."},
+                            {"cursor", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The cursor a previous page returned, or \"\" for the first page of\n"
+            "                              maximumCount (default " + std::to_string(DEFAULT_LIST_PAGE_SIZE) + ") outputs. The result is then an object\n"
+            "                              {\"unspents\":[...], \"cursor\":\"cursor\"}, the cursor being null after the last page."},
                         },
                         "query_options"},
                 },
@@ -3077,6 +3150,7 @@ static UniValue listunspent(const JSONRPCRequest& request)
             + HelpExampleRpc("listunspent", "6, 9999999 \"[\\\"1PGFqEzfmQch1gKD3ra4k18PNj3tTUUSqg\\\",\\\"1LtvqCaApEdUGFkpKMM4MstjcaL4dKg8SP\\\"]\"")
             + HelpExampleCli("listunspent", "6 9999999 '[]' true '{ \"minimumAmount\": 0.005 }'")
             + HelpExampleRpc("listunspent", "6, 9999999, [] , true, { \"minimumAmount\": 0.005 } ")
+            + HelpExampleCli("listunspent", "1 9999999 '[]' true '{ \"maximumCount\": 1000, \"cursor\": \"\" }'")
                 },
             }.ToString());
 
@@ -3119,6 +3193,8 @@ static UniValue listunspent(const JSONRPCRequest& request)
     CAmount nMinimumSumAmount = MAX_MONEY;
     uint64_t nMaximumCount = 0;
     std::string asset_str;
+    bool fPaged = false;
+    COutPoint cursor;
 
     if (!request.params[4].isNull()) {
         const UniValue& options = request.params[4].get_obj();
@@ -3137,6 +3213,14 @@ static UniValue listunspent(const JSONRPCRequest& request)
 
         if (options.exists("asset"))
             asset_str = options["asset"].get_str();
+
+        if (options.exists("cursor")) {
+            fPaged = true;
+            if (!options["cursor"].get_str().empty())
+                cursor = DecodeListCursor<COutPoint>(options["cursor"].get_str());
+            if (nMaximumCount == 0)
+                nMaximumCount = DEFAULT_LIST_PAGE_SIZE;
+        }
     }
 
     CAsset asset_filter;
@@ -3156,7 +3240,7 @@ static UniValue listunspent(const JSONRPCRequest& request)
     {
         auto locked_chain = pwallet->chain().lock();
         LOCK(pwallet->cs_wallet);
-        pwallet->AvailableCoins(*locked_chain, vecOutputs, !include_unsafe, nullptr, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount, nMinDepth, nMaxDepth, asset_filter.IsNull() ? nullptr : &asset_filter);
+        pwallet->AvailableCoins(*locked_chain, vecOutputs, !include_unsafe, nullptr, nMinimumAmount, nMaximumAmount, nMinimumSumAmount, nMaximumCount, nMinDepth, nMaxDepth, asset_filter.IsNull() ? nullptr : &asset_filter, cursor.IsNull() ? nullptr : &cursor);
     }
 
     LOCK(pwallet->cs_wallet);
@@ -3248,6 +3332,20 @@ static UniValue listunspent(const JSONRPCRequest& request)
         results.push_back(entry);
     }
 
+    if (fPaged) {
+        // A page cut short by maximumCount continues after its last output; the
+        // address filter drops outputs after the cut, so it does not count.
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("unspents", results);
+        if (vecOutputs.size() >= nMaximumCount) {
+            const COutput& last = vecOutputs.back();
+            result.pushKV("cursor", EncodeListCursor(COutPoint(last.tx->GetHash(), last.i)));
+        } else {
+            result.pushKV("cursor", NullUniValue);
+        }
+        return result;
+    }
+
     return results;
 }
 
@@ -3383,25 +3481,38 @@ static UniValue getfirestone(const JSONRPCRequest& request)
         showAll = request.params[1].get_bool();
     }
 	UniValue results(UniValue::VARR);
-    LOCK(cs_main);
-	std::vector<CTicketRef> alltickets = pticketview->FindeTickets(boost::get<CKeyID>(destination));
-    std::vector<CTicketRef> tickets;
-    for(auto ticket : alltickets){
-        if (!pcoinsTip->AccessCoin(COutPoint(ticket->out->hash, ticket->out->n)).IsSpent() || showAll){
-            tickets.push_back(ticket);
+
+    // The firestones of the keys of the wallet are cached, those of other keys are looked up.
+    const CKeyID keyID = boost::get<CKeyID>(destination);
+    std::vector<CWalletTicket> tickets;
+    int activeHeight;
+    bool fCached;
+    {
+        LOCK(pwallet->cs_wallet);
+        fCached = pwallet->GetCachedTickets(keyID, tickets, activeHeight);
+    }
+    if (!fCached) {
+        auto locked_chain = pwallet->chain().lock();
+        LOCK(pwallet->cs_wallet);
+        pwallet->RebuildTicketCache();
+        for (const auto& ticket : pticketview->FindeTickets(keyID)) {
+            tickets.emplace_back(ticket, pcoinsTip->AccessCoin(ticket->out).IsSpent());
         }
+        activeHeight = chainActive.Height();
     }
 
 	for (auto iter = tickets.begin();iter!=tickets.end();iter++){
+        if (iter->fSpent && !showAll)
+            continue;
 		UniValue entry(UniValue::VOBJ);
-        auto ticket = *iter;
+        auto ticket = iter->ticket;
 		int height = ticket->LockTime();
 		auto keyid = ticket->KeyID();
         auto out = ticket->out;
 		if (keyid.size() == 0 || height == 0)
 			continue;
 		std::string state;
-		switch (ticket->State(chainActive.Tip()->nHeight)){
+		switch (ticket->State(activeHeight)){
         case CTicket::CTicketState::IMMATURATE:
 			state="IMMATURATE";
 			break;
@@ -3415,11 +3526,11 @@ static UniValue getfirestone(const JSONRPCRequest& request)
 			state= "UNKNOW";
 			break;
 		}
-        entry.pushKV("outpoint", out->hash.ToString() + ":" + itostr(out->n));
+        entry.pushKV("outpoint", out.hash.ToString() + ":" + itostr(out.n));
 		entry.pushKV("address", EncodeDestination(keyid));
 		entry.pushKV("lockheight", height);
 		entry.pushKV("state",state);
-        entry.pushKV("isSpent", pcoinsTip->AccessCoin(*out).IsSpent());
+        entry.pushKV("isSpent", iter->fSpent);
 		results.push_back(entry);
 	}
 
@@ -3463,12 +3574,12 @@ static UniValue listslotfs(const JSONRPCRequest& request)
         },
         }.ToString());
 
-    LOCK(cs_main);
-    int slotIndex = pticketview->SlotIndex();
+    const CTicketSnapshotRef snapshot = pticketview->GetSnapshot();
+    int slotIndex = snapshot->SlotIndex();
     if (!request.params[0].isNull()){
         slotIndex = request.params[0].get_int();
     }
-    if (slotIndex < 0 || slotIndex > pticketview->SlotIndex()) {
+    if (slotIndex < 0 || slotIndex > snapshot->SlotIndex()) {
         throw JSONRPCError(RPC_TYPE_ERROR, "Invalid slot index");
     }
     
@@ -3480,10 +3591,16 @@ static UniValue listslotfs(const JSONRPCRequest& request)
     }
     UniValue results(UniValue::VARR);
     
-    std::vector<CTicketRef> alltickets = pticketview->GetTicketsBySlotIndex(slotIndex);
+    // The firestones of older slots are read from their summary on disk, under the lock.
+    std::vector<CTicketRef> alltickets;
+    if (snapshot->HasSlot(slotIndex))
+        alltickets = snapshot->GetTicketsBySlotIndex(slotIndex);
+    LOCK(cs_main);
+    if (!snapshot->HasSlot(slotIndex))
+        alltickets = pticketview->ListTicketsInSlot(slotIndex);
     std::vector<CTicketRef> tickets;
     for(auto ticket : alltickets){
-        if (!pcoinsTip->AccessCoin(COutPoint(ticket->out->hash, ticket->out->n)).IsSpent() || showAll){
+        if (!pcoinsTip->AccessCoin(COutPoint(ticket->out.hash, ticket->out.n)).IsSpent() || showAll){
             tickets.push_back(ticket);
         }
     }
@@ -3511,11 +3628,11 @@ static UniValue listslotfs(const JSONRPCRequest& request)
             break;
         }
         auto out = ticket->out;
-        entry.pushKV("outpoint", out->hash.ToString() + ":" + itostr(out->n));
+        entry.pushKV("outpoint", out.hash.ToString() + ":" + itostr(out.n));
         entry.pushKV("address", EncodeDestination(keyid));
         entry.pushKV("lockheight", height);
         entry.pushKV("state",state);
-        entry.pushKV("isSpent", pcoinsTip->AccessCoin(*out).IsSpent());
+        entry.pushKV("isSpent", pcoinsTip->AccessCoin(out).IsSpent());
         results.push_back(entry);
     }
     return results;
@@ -5323,7 +5440,7 @@ UniValue spendticket(const JSONRPCRequest& request)
 		}
     }
 
-	auto n = ticket->out->n;
+	auto n = ticket->out.n;
     if (n < 0 || n >= prevTx->vout.size()) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid params");
     }
@@ -5356,6 +5473,30 @@ UniValue spendticket(const JSONRPCRequest& request)
     return spendTxID.GetHex();
 }
 
+/** Firestone inputs or transactions below this count are signed on the calling thread only. */
+static const size_t PARALLEL_SIGN_MIN_COUNT = 16;
+
+/** Run sign(i) for each i below count, split in chunks between the cores. An exception of any chunk is rethrown. */
+static void SignInParallel(size_t count, const std::function<void(size_t)>& sign)
+{
+    auto signRange = [&sign](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            sign(i);
+        }
+    };
+
+    const size_t nThreads = count < PARALLEL_SIGN_MIN_COUNT ? 1 : std::max(GetNumCores(), 1);
+    const size_t nChunk = (count + nThreads - 1) / nThreads;
+    std::vector<std::future<void>> signing;
+    for (size_t begin = nChunk; begin < count; begin += nChunk) {
+        signing.push_back(std::async(std::launch::async, signRange, begin, std::min(begin + nChunk, count)));
+    }
+    signRange(0, std::min(nChunk, count));
+    for (auto& done : signing) {
+        done.get();
+    }
+}
+
 CTransactionRef CreateTicketAllSpendTx(CWallet* const pwallet, std::map<uint256,std::pair<int,CScript>> txScriptInputs, std::vector<CTxOut> outs, CTxDestination& dest, CKey& key)
 {
 	CMutableTransaction mtx;
@@ -5363,8 +5504,10 @@ CTransactionRef CreateTicketAllSpendTx(CWallet* const pwallet, std::map<uint256,
 	// add vin into mtx
 	int index=0;
 	unsigned int pubKeySizeSum = 0;
+	std::vector<CScript> redeemScripts;
 	for(auto iter=txScriptInputs.begin(); iter!=txScriptInputs.end(); iter++){
 		mtx.vin.push_back(CTxIn(iter->first, iter->second.first, iter->second.second, index)); 
+		redeemScripts.push_back(iter->second.second);
 		pubKeySizeSum += CPubKey::SIGNATURE_SIZE + CPubKey::PUBLIC_KEY_SIZE;
 		index++;
 	}
@@ -5400,76 +5543,30 @@ CTransactionRef CreateTicketAllSpendTx(CWallet* const pwallet, std::map<uint256,
 	  mtx.vout[0].nValue -= nFeeNeeded;
 	}
 
-	size_t nIn = 0;
-	for(auto iter=txScriptInputs.begin(); iter!=txScriptInputs.end(); iter++){
-		CScript redeemScript = iter->second.second;
-		CMutableTransaction txcopy(mtx); 
-		CHashWriter ss(SER_GETHASH, 0);
-
-		// Serialize nVersion
-		::Serialize(ss, txcopy.nVersion);
-		// Serialize vin
-		::WriteCompactSize(ss, txcopy.vin.size());
-		for (size_t nInput = 0; nInput < txcopy.vin.size(); nInput++){
-			::Serialize(ss, txcopy.vin[nInput].prevout);
-			// Serialize the script
-			if (nInput != nIn){
-				::Serialize(ss, CScript());
-			}else{
-				CScript::const_iterator it = redeemScript.begin();
-				CScript::const_iterator itBegin = it;
-				opcodetype opcode;
-				unsigned int nCodeSeparators = 0;
-				while (redeemScript.GetOp(it, opcode)) {
-					if (opcode == OP_CODESEPARATOR)
-						nCodeSeparators++;
-				}
-				::WriteCompactSize(ss, redeemScript.size() - nCodeSeparators);
-				it = itBegin;
-				while (redeemScript.GetOp(it, opcode)) {
-					if (opcode == OP_CODESEPARATOR) {
-						ss.write((char*)&itBegin[0], it-itBegin-1);
-						itBegin = it;
-					}
-				}
-				if (itBegin != redeemScript.end())
-					ss.write((char*)&itBegin[0], it-itBegin);
-			}
-			::Serialize(ss, txcopy.vin[nInput].nSequence);
-		}
-
-		// Serialize vout
-		unsigned int nOutputs = txcopy.vout.size();
-		::WriteCompactSize(ss, nOutputs);
-		for (unsigned int nOutput = 0; nOutput < nOutputs; nOutput++){
-			::Serialize(ss, txcopy.vout[nOutput]);
-		}
-
-		// Serialize nLockTime
-		::Serialize(ss, txcopy.nLockTime);
-		ss << 1;
-
-		// Hash the serialization to be signed.
-		auto hash = ss.GetHash();
+	// The legacy signature hash of an input covers the redeemScript as its script code, not the
+	// amount, and leaves out the scripts of the other inputs, so the inputs are signed independently.
+	// When checkSig is called, there are three parts inside of the stack:
+	//	1.top of the stack is the 29-bytes redeemScript, which is on the right of vin.scriptSig
+	//	2.middle is the 33-bytes Pubkey, which is in the middle of vin.scriptSig
+	//  3.bottom is the 71-bytes vchSig, which is on the left of vin.scriptSig
+	std::vector<CScript> scriptSigs(mtx.vin.size());
+	std::atomic<bool> fSigned(true);
+	SignInParallel(mtx.vin.size(), [&](size_t nIn) {
+		auto hash = SignatureHash(redeemScripts[nIn], mtx, nIn, SIGHASH_ALL, CConfidentialValue(), SigVersion::BASE);
 		std::vector<unsigned char> vchSig;
 		if (!key.Sign(hash, vchSig)) {
-			//TODO: error catch 
-			return MakeTransactionRef();
+			fSigned = false;
+			return;
 		}
 		vchSig.push_back((unsigned char)SIGHASH_ALL);
-		// vchsig is related to ss above.
-		// ss ==> Hash ==> vchSig
-		// checkSig compares the vchSig with Hash,
-		// the sig Hash in the consensus checkSig is generated by a given process with arguments of scriptCode, *txTo and nIn,
-		// so we should generate the vchSig be fit to that sig Hash, in the way that we do the same process to generate the same sig Hash!
-
-		// different input on the right of ss operator <<, then the different vchsig. 
-		// when checkSig is called, there are three parts inside of the stack:
-		//	1.top of the stack is the 29-bytes redeemScript, which is on the right of vin.scriptSig
-		//	2.middle is the 33-bytes Pubkey, which is in the middle of vin.scriptSig
-		//  3.bottom is the 71-bytes vchSig, which is on the left of vin.scriptSig
-		mtx.vin[nIn].scriptSig = CScript() << vchSig << ToByteVector(key.GetPubKey()) << ToByteVector(redeemScript);
-		nIn++;
+		scriptSigs[nIn] = CScript() << vchSig << ToByteVector(key.GetPubKey()) << ToByteVector(redeemScripts[nIn]);
+	});
+	if (!fSigned) {
+		//TODO: error catch 
+		return MakeTransactionRef();
+	}
+	for (size_t nIn = 0; nIn < mtx.vin.size(); nIn++) {
+		mtx.vin[nIn].scriptSig = scriptSigs[nIn];
 	}
 	
 	CTransaction tx(mtx);
@@ -5533,20 +5630,22 @@ UniValue freefirestone(const JSONRPCRequest& request){
 	}
 
 	// listtickets 
-    std::vector<CTicketRef> alltickets;
-    {
-        LOCK(cs_main);
-        alltickets = pticketview->FindeTickets(boost::get<CKeyID>(destination));
-    }
+    const CTicketSnapshotRef snapshot = pticketview->GetSnapshot();
+    const std::vector<CTicketRef>& alltickets = snapshot->FindeTickets(boost::get<CKeyID>(destination));
     
     std::vector<CTicketRef> tickets;
-    for(size_t i=0; i<alltickets.size(); i++){
-        auto ticket = alltickets[i];
-        auto out = *(ticket->out);
-        if (!pcoinsTip->AccessCoin(out).IsSpent() && !mempool.isSpent(out)){
-            tickets.push_back(ticket);
-            if (tickets.size() > 4)
-                break;
+    int nHeight;
+    {
+        LOCK2(cs_main, mempool.cs);
+        nHeight = chainActive.Height();
+        for(size_t i=0; i<alltickets.size(); i++){
+            auto ticket = alltickets[i];
+            auto out = ticket->out;
+            if (!pcoinsTip->AccessCoin(out).IsSpent() && !mempool.isSpent(out)){
+                tickets.push_back(ticket);
+                if (tickets.size() > 4)
+                    break;
+            }
         }
     }
 
@@ -5562,11 +5661,11 @@ UniValue freefirestone(const JSONRPCRequest& request){
 	std::vector<CTxOut> outs;
 	UniValue ticketids(UniValue::VARR);
 	for(auto iter = tickets.begin(); iter!=tickets.end(); iter++){
-		auto state = (*iter)->State(chainActive.Height());
+		auto state = (*iter)->State(nHeight);
 		if (state == CTicket::CTicketState::OVERDUE){
             auto ticket = (*iter);
-            uint256 txid = ticket->out->hash;
-            uint32_t n = ticket->out->n;
+            uint256 txid = ticket->out.hash;
+            uint32_t n = ticket->out.n;
             CScript redeemScript = ticket->redeemScript;
 			ticketids.push_back(txid.ToString() + ":" + itostr(n));
 
@@ -5605,6 +5704,296 @@ UniValue freefirestone(const JSONRPCRequest& request){
 	return results;
 }
 
+/** Most firestones bought by one buyfirestones call. */
+static const int MAX_BUY_FIRESTONES = 1000;
+/** Most firestones freed by one transaction of freefirestones, which keeps it below the standard weight. */
+static const size_t MAX_FREE_FIRESTONE_INPUTS = 400;
+
+static UniValue buyfirestones(const JSONRPCRequest& request)
+{
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() != 3)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "buyfirestones",
+                "\nFreeze some funds to get count miner fs at once. A funding transaction pays the price and the fee\n"
+                "of each firestone to changeAddr, the firestone transactions spend its outputs. The funding transactions\n"
+                "are limited by -limitdescendantcount, so several are made for a large count.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to recvie fs(only keyid)."},
+                    {"changeAddr", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to recvie LV change(only keyid)."},
+                    {"count", RPCArg::Type::NUM, RPCArg::Optional::NO, strprintf("The count of fs to buy, at most %d.", MAX_BUY_FIRESTONES)},
+                },
+                RPCResult{
+                    "{\n"
+                    "  \"funding\" : [\"txid\",...],   (array of string) The funding tx ids.\n"
+                    "  \"txids\" : [\"txid\",...],     (array of string) The fs tx ids.\n"
+                    "  \"error\" : \"error\"           (string, optional) Why fewer fs than count were bought.\n"
+                    "}\n"},
+                RPCExamples{
+                    HelpExampleCli("buyfirestones", "\"1M72Sfpbz1BPpXFHz9m3CdqATR44Jvaydd\" \"1M72Sfpbz1BPpXFHz9m3CdqATR44Jvaydd\" 100")},
+            }
+    .ToString());
+
+    pwallet->BlockUntilSyncedToCurrentChain();
+
+    auto locked_chain = pwallet->chain().lock();
+    LOCK(pwallet->cs_wallet);
+
+    EnsureWalletIsUnlocked(pwallet);
+
+    CTxDestination dest = DecodeDestination(request.params[0].get_str());
+    CTxDestination changedest = DecodeDestination(request.params[1].get_str());
+    if (!IsValidDestination(dest)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid buyer address");
+    }
+
+    if (!IsValidDestination(changedest)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid changer address");
+    }
+
+    if (dest.type() != typeid(CKeyID) || changedest.type() != typeid(CKeyID)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Only support PUBKEYHASH");
+    }
+
+    const int count = request.params[2].get_int();
+    if (count <= 0 || count > MAX_BUY_FIRESTONES) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid count, must be between 1 and %d", MAX_BUY_FIRESTONES));
+    }
+
+    auto keyID = boost::get<CKeyID>(dest);
+    auto changekeyID = boost::get<CKeyID>(changedest);
+    // The firestone transactions spend the outputs paid to the changer.
+    CKey changeKey;
+    if (!pwallet->GetKey(changekeyID, changeKey)) {
+        throw JSONRPCError(RPC_WALLET_ERROR, "Private key for changer address is not known");
+    }
+    const CScript changeScript = GetScriptForDestination(changedest);
+
+    LOCK(cs_main);
+    auto locktime = pticketview->LockTime();
+    if (locktime == chainActive.Height()) {
+        throw JSONRPCError(RPC_VERIFY_REJECTED, "Can't buy firestone on slot's last block.");
+    }
+
+    auto nAmount = pticketview->CurrentTicketPrice();
+    auto redeemScript = GenerateTicketScript(keyID, locktime);
+    auto scriptPubkey = GetScriptForDestination(CTxDestination(CScriptID(redeemScript)));
+    auto opRetScript = CScript() << OP_RETURN << CTicket::VERSION << ToByteVector(redeemScript);
+
+    // Every firestone transaction has the same size, a fee paid once per firestone covers it.
+    CAmount nTicketFee;
+    {
+        CMutableTransaction txcopyforfee;
+        txcopyforfee.vin.push_back(CTxIn(COutPoint(), changeScript));
+        txcopyforfee.vout.push_back(CTxOut(nAmount, scriptPubkey));
+        txcopyforfee.vout.push_back(CTxOut(0, opRetScript));
+        auto nBytes = GetVirtualTransactionSize(CTransaction(txcopyforfee)) + CPubKey::SIGNATURE_SIZE + CPubKey::PUBLIC_KEY_SIZE;
+
+        FeeCalculation feeCalc;
+        CCoinControl coin_control;
+        nTicketFee = GetMinimumFee(*pwallet, nBytes, coin_control, ::mempool, ::feeEstimator, &feeCalc);
+        if (feeCalc.reason == FeeReason::FALLBACK && !pwallet->m_allow_fallback_fee) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Fee estimation failed. Fallbackfee is disabled. Wait a few blocks or enable -fallbackfee.");
+        }
+    }
+    LogPrint(BCLog::FIRESTONE, "%s: locktime:%d, nAmount:%d, count:%d, fee:%d\n", __func__, locktime, nAmount, count, nTicketFee);
+
+    CCoinControl coin_control;
+    coin_control.destChange = { {::policyAsset, changedest} };
+    const int nPerFunding = std::max(1, (int)gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT) - 1);
+
+    UniValue fundingids(UniValue::VARR);
+    UniValue txids(UniValue::VARR);
+    UniValue result(UniValue::VOBJ);
+    for (int nBought = 0; nBought < count;) {
+        const int nFunding = std::min(nPerFunding, count - nBought);
+        std::vector<CRecipient> vecSend(nFunding, CRecipient{changeScript, nAmount + nTicketFee, false, ::policyAsset});
+        std::vector<std::unique_ptr<CReserveKey>> reservekeys;
+        reservekeys.push_back(std::unique_ptr<CReserveKey>(new CReserveKey(pwallet)));
+        CTransactionRef fundingTx;
+        CAmount nFeeRequired;
+        int nChangePosRet = -1;
+        std::string strError;
+        CValidationState state;
+        if (!pwallet->CreateTransaction(*locked_chain, vecSend, fundingTx, reservekeys, nFeeRequired, nChangePosRet, strError, coin_control)) {
+            if (nBought == 0)
+                throw JSONRPCError(RPC_WALLET_ERROR, strError);
+            result.pushKV("error", strError);
+            break;
+        }
+        if (!pwallet->CommitTransaction(fundingTx, mapValue_t{}, {}, reservekeys, g_connman.get(), state)) {
+            strError = strprintf("Error: The transaction was rejected! Reason given: %s", FormatStateMessage(state));
+            if (nBought == 0)
+                throw JSONRPCError(RPC_WALLET_ERROR, strError);
+            result.pushKV("error", strError);
+            break;
+        }
+        fundingids.push_back(fundingTx->GetHash().GetHex());
+
+        std::vector<CMutableTransaction> mtxs;
+        for (size_t n = 0; n < fundingTx->vout.size(); n++) {
+            const CTxOut& out = fundingTx->vout[n];
+            if ((int)n == nChangePosRet || out.scriptPubKey != changeScript || out.nValue != nAmount + nTicketFee)
+                continue;
+            CMutableTransaction mtx;
+            mtx.vin.push_back(CTxIn(COutPoint(fundingTx->GetHash(), n)));
+            mtx.vout.push_back(CTxOut(nAmount, scriptPubkey));
+            mtx.vout.push_back(CTxOut(0, opRetScript));
+            mtxs.push_back(std::move(mtx));
+        }
+
+        if (mtxs.empty()) {
+            throw JSONRPCError(RPC_WALLET_ERROR, "Funding transaction has no firestone outputs");
+        }
+
+        std::atomic<bool> fSigned(true);
+        SignInParallel(mtxs.size(), [&](size_t i) {
+            auto hash = SignatureHash(changeScript, mtxs[i], 0, SIGHASH_ALL, CConfidentialValue(nAmount + nTicketFee), SigVersion::BASE);
+            std::vector<unsigned char> vchSig;
+            if (!changeKey.Sign(hash, vchSig)) {
+                fSigned = false;
+                return;
+            }
+            vchSig.push_back((unsigned char)SIGHASH_ALL);
+            mtxs[i].vin[0].scriptSig = CScript() << vchSig << ToByteVector(changeKey.GetPubKey());
+        });
+        if (!fSigned) {
+            throw JSONRPCError(RPC_WALLET_ERROR, "Private key sign error");
+        }
+
+        std::vector<std::unique_ptr<CReserveKey>> noKeys;
+        for (auto& mtx : mtxs) {
+            auto tx = MakeTransactionRef(CTransaction(mtx));
+            if (!pwallet->CommitTransaction(tx, mapValue_t{}, {}, noKeys, g_connman.get(), state)) {
+                throw JSONRPCError(RPC_WALLET_ERROR, strprintf("Error: The transaction was rejected! Reason given: %s", FormatStateMessage(state)));
+            }
+            txids.push_back(tx->GetHash().GetHex());
+        }
+        nBought += mtxs.size();
+    }
+    ImportScript(pwallet, redeemScript, "tickets", true);
+
+    result.pushKV("funding", fundingids);
+    result.pushKV("txids", txids);
+    return result;
+}
+
+static UniValue freefirestones(const JSONRPCRequest& request)
+{
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "freefirestones",
+                strprintf("\nSpend all overdue frozen tickets of address to receiver, in transactions of at most %u tickets.\n", MAX_FREE_FIRESTONE_INPUTS),
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address who wants to free tickets."},
+                    {"receiver", RPCArg::Type::STR, /* default */ "address", "The address received."},
+                },
+                RPCResult{
+                    "[\n"
+                    "  {\n"
+                    "    \"txid\" : \"txid\",             (string) The tx id.\n"
+                    "    \"OutPoint\" : [\"txid:n\",...]  (array of string) The tickets it frees.\n"
+                    "  }\n"
+                    "  ,...\n"
+                    "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("freefirestones", "\"1M72Sfpbz1BPpXFHz9m3CdqATR44Jvaydd\" \"1M72Sfpbz1BPpXFHz9m3CdqATR44Jvaydd\"")},
+            }
+    .ToString());
+
+    CTxDestination destination = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(destination)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+    if (destination.type() != typeid(CKeyID)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Only support PUBKEYHASH");
+    }
+
+    CTxDestination receiver = destination;
+    if (!request.params[1].isNull()) {
+        receiver = DecodeDestination(request.params[1].get_str());
+    }
+    if (!IsValidDestination(receiver)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid receiver");
+    }
+    if (receiver.type() != typeid(CKeyID)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Only support PUBKEYHASH");
+    }
+
+    CKeyID keyID = boost::get<CKeyID>(destination);
+    CKey key;
+    if (!pwallet->GetKey(keyID, key)) {
+        throw JSONRPCError(RPC_WALLET_ERROR, "Private key for address is not known");
+    }
+
+    // The state of a firestone is known without a coin lookup, only the overdue ones are looked up,
+    // and their coins give the outputs to spend.
+    std::vector<CTransactionRef> txs;
+    std::vector<UniValue> outpoints;
+    {
+        LOCK(cs_main);
+        const int height = chainActive.Height();
+        std::vector<std::pair<CTicketRef, CTxOut>> overdue;
+        for (auto& ticket : pticketview->FindeTickets(keyID)) {
+            if (ticket->State(height) != CTicket::CTicketState::OVERDUE)
+                continue;
+            const Coin& coin = pcoinsTip->AccessCoin(ticket->out);
+            if (coin.IsSpent() || mempool.isSpent(ticket->out))
+                continue;
+            overdue.emplace_back(ticket, coin.out);
+        }
+
+        for (size_t begin = 0; begin < overdue.size(); begin += MAX_FREE_FIRESTONE_INPUTS) {
+            std::map<uint256, std::pair<int, CScript>> txScriptInputs;
+            std::vector<CTxOut> outs;
+            UniValue ticketids(UniValue::VARR);
+            for (size_t i = begin; i < std::min(begin + MAX_FREE_FIRESTONE_INPUTS, overdue.size()); i++) {
+                const CTicketRef& ticket = overdue[i].first;
+                txScriptInputs.insert(std::make_pair(ticket->out.hash, std::make_pair(ticket->out.n, ticket->redeemScript)));
+                outs.push_back(overdue[i].second);
+                ticketids.push_back(ticket->out.hash.ToString() + ":" + itostr(ticket->out.n));
+            }
+            auto tx = CreateTicketAllSpendTx(pwallet, txScriptInputs, outs, receiver, key);
+            if (tx->vin.empty()) {
+                throw JSONRPCError(RPC_WALLET_ERROR, "Private key sign error");
+            }
+            txs.push_back(tx);
+            outpoints.push_back(ticketids);
+        }
+    }
+
+    UniValue results(UniValue::VARR);
+    const CAmount highfee{ ::maxTxFee };
+    for (size_t i = 0; i < txs.size(); i++) {
+        std::string errStr;
+        uint256 spendTxID;
+        if (TransactionError::OK != BroadcastTransaction(txs[i], spendTxID, errStr, 50*highfee)) {
+            throw JSONRPCError(RPC_TRANSACTION_REJECTED, errStr);
+        }
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", spendTxID.GetHex());
+        entry.pushKV("OutPoint", outpoints[i]);
+        results.push_back(entry);
+    }
+    return results;
+}
+
 uint256 SendAction(CWallet *const pwallet, const CAction& action, const CKey &key, const CTxDestination& destChange)
 {
     auto locked_chain = pwallet->chain().lock();
@@ -5778,19 +6167,35 @@ static UniValue getbindinginfo(const JSONRPCRequest& request)
             }.ToString()
         );
     }
-    LOCK(cs_main);
     auto strAddress = request.params[0].get_str();
     CTxDestination dest = DecodeDestination(strAddress);
     if (!IsValidDestination(dest) || dest.type() != typeid(CKeyID)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
-    // check poc21
-    bool pocxFlag = false;
-    if (chainActive.Tip()->nHeight >= Params().GetConsensus().LVIP05Height){
-        pocxFlag = true;
-    }
     auto from = boost::get<CKeyID>(dest);
-    auto to = prelationview->To(from, from.GetPlotID(), pocxFlag);
+    CKeyID to;
+    // The bindings of the keys of the wallet, if there is one, are cached.
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    bool fCached = false;
+    if (wallet) {
+        LOCK(wallet->cs_wallet);
+        fCached = wallet->GetCachedBindingTarget(from, to);
+    }
+    if (!fCached) {
+        // Once poc21 is active the bindings are all in the snapshot, the plot id bindings of poc2 are read from disk.
+        const CRelationSnapshotRef relations = prelationview->GetSnapshot();
+        if (relations->Height() >= Params().GetConsensus().LVIP05Height) {
+            to = relations->To(from);
+        } else {
+            LOCK(cs_main);
+            // check poc21
+            bool pocxFlag = false;
+            if (chainActive.Tip()->nHeight >= Params().GetConsensus().LVIP05Height){
+                pocxFlag = true;
+            }
+            to = prelationview->To(from, from.GetPlotID(), pocxFlag);
+        }
+    }
     if (to == CKeyID()) {
         return UniValue(UniValue::VOBJ);
     }
@@ -5851,9 +6256,8 @@ static UniValue listbindings(const JSONRPCRequest& request)
             }.ToString()
         );
     }
-    LOCK(cs_main);
     UniValue results(UniValue::VARR);
-    for (auto relation : prelationview->ListRelations()) {
+    for (auto relation : prelationview->GetSnapshot()->ListRelations()) {
         auto from = relation.first;
         auto to = relation.second;
         UniValue fromVal(UniValue::VOBJ);
@@ -5878,7 +6282,7 @@ CTransactionRef makeSpentTicketTx(const CTicketRef& ticket, const int height, co
 {
     CMutableTransaction mtx;
     auto redeemScript = ticket->redeemScript;
-    mtx.vin.push_back(CTxIn(ticket->out->hash, ticket->out->n, redeemScript, 0));
+    mtx.vin.push_back(CTxIn(ticket->out.hash, ticket->out.n, redeemScript, 0));
     mtx.vout.push_back(CTxOut(ticket->nValue, GetScriptForDestination(dest)));
     mtx.nLockTime = height - 1;
 
@@ -5971,6 +6375,58 @@ UniValue createfstxwithwallet(const JSONRPCRequest& request){
     return EncodeHexTx(*fstx, RPCSerializationFlags());
 }
 
+static UniValue presignfstx(const JSONRPCRequest& request)
+{
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+        RPCHelpMan{
+            "presignfstx",
+            "\nSign a fstx for each unspent firestone of the wallet usable at the slot, and import them into the fspool.\n"
+            "The wallet does this by itself when a slot starts, unless -presignfstx=0. The returned transactions can\n"
+            "be imported by a forging node with importfstx, so the firestones of a cold wallet are staged in bulk.\n",
+        {
+            {"slotindex", RPCArg::Type::NUM, /* default */ "the current slot", "The slot, at which the firestones are USABLE."},
+        },
+        RPCResult{
+            "[\n"
+            "  \"data\"      (string) The serialized, hex-encoded data of a fstx.\n"
+            "  ,...\n"
+            "]\n"},
+            RPCExamples{
+            HelpExampleCli("presignfstx", "") + HelpExampleCli("presignfstx", "12")},
+        }
+    .ToString());
+
+    pwallet->BlockUntilSyncedToCurrentChain();
+    EnsureWalletIsUnlocked(pwallet);
+
+    const int nSlotIndex = pticketview->GetSnapshot()->SlotIndex();
+    int slotIndex = nSlotIndex;
+    if (!request.params[0].isNull()) {
+        slotIndex = request.params[0].get_int();
+    }
+    if (slotIndex < 1 || slotIndex > nSlotIndex + 1) {
+        throw JSONRPCError(RPC_TYPE_ERROR, "Invalid slot index");
+    }
+
+    std::vector<CTransactionRef> fstxs;
+    if (!pwallet->PreSignFstx(slotIndex, &fstxs)) {
+        throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED, "Error: Please enter the wallet passphrase with walletpassphrase first.");
+    }
+    UniValue results(UniValue::VARR);
+    for (const auto& fstx : fstxs) {
+        results.push_back(EncodeHexTx(*fstx, RPCSerializationFlags()));
+    }
+    return results;
+}
+
 UniValue importfstx(const JSONRPCRequest& request){
     if (request.fHelp || request.params.size() != 1)
         throw std::runtime_error(
@@ -6243,7 +6699,7 @@ void FillBlinds(CWallet* pwallet, CMutableTransaction& tx, std::vector<uint256>&
     for (size_t nOut = 0; nOut < tx.vout.size(); ++nOut) {
         CTxOut& out = tx.vout[nOut];
         if (out.nValueCA.IsExplicit()) {
-            CPubKey pubkey(out.nNonce.vchCommitment);
+            CPubKey pubkey(out.nNonce.vchCommitment.begin(), out.nNonce.vchCommitment.end());
             if (!pubkey.IsFullyValid()) {
                 output_pubkeys.push_back(CPubKey());
             } else {
@@ -6638,9 +7094,24 @@ UniValue listissuances(const JSONRPCRequest& request)
 
     auto asset_filter = AssetFromReqParam(request.params, 0);
 
+    // The issuance index knows the confirmed transactions issuing the asset,
+    // only the unconfirmed ones of the wallet need their issuances hashed.
+    CIssuanceInfo indexed;
+    std::set<uint256> indexed_txids;
+    const bool use_index = !asset_filter.IsNull() && pissuanceview->GetIssuance(asset_filter, indexed);
+    if (use_index) {
+        indexed_txids.insert(indexed.txid);
+        for (const uint256& txid : pissuanceview->GetReissuances(asset_filter)) {
+            indexed_txids.insert(txid);
+        }
+    }
+
     UniValue issuancelist(UniValue::VARR);
     for (const auto& it : pwallet->mapWallet) {
         const CWalletTx* pcoin = &it.second;
+        if (use_index && !indexed_txids.count(it.first) && pcoin->GetDepthInMainChain(*locked_chain) > 0) {
+            continue;
+        }
         CAsset asset;
         CAsset token;
         uint256 entropy;
@@ -6651,10 +7122,16 @@ UniValue listissuances(const JSONRPCRequest& request)
                 continue;
             }
             if (issuance.assetBlindingNonce.IsNull()) {
-                GenerateAssetEntropy(entropy, pcoin->tx->vin[vinIndex].prevout, issuance.assetEntropy);
-                CalculateAsset(asset, entropy);
-                // Null is considered explicit
-                CalculateReissuanceToken(token, entropy, issuance.nAmount.IsCommitment());
+                if (use_index && it.first == indexed.txid && vinIndex == indexed.nIn) {
+                    entropy = indexed.entropy;
+                    asset = asset_filter;
+                    token = indexed.token;
+                } else {
+                    GenerateAssetEntropy(entropy, pcoin->tx->vin[vinIndex].prevout, issuance.assetEntropy);
+                    CalculateAsset(asset, entropy);
+                    // Null is considered explicit
+                    CalculateReissuanceToken(token, entropy, issuance.nAmount.IsCommitment());
+                }
                 item.pushKV("isreissuance", false);
                 item.pushKV("token", token.GetHex());
                 CAmount itamount = pcoin->GetIssuanceAmount(vinIndex, true);
@@ -6799,7 +7276,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "listreceivedbyaddress",            &listreceivedbyaddress,         {"minconf","include_empty","include_watchonly","address_filter","assetlabel"} },
     { "wallet",             "listreceivedbylabel",              &listreceivedbylabel,           {"minconf","include_empty","include_watchonly"} },
     { "wallet",             "listsinceblock",                   &listsinceblock,                {"blockhash","target_confirmations","include_watchonly","include_removed"} },
-    { "wallet",             "listtransactions",                 &listtransactions,              {"label|dummy","count","skip","include_watchonly"} },
+    { "wallet",             "listtransactions",                 &listtransactions,              {"label|dummy","count","skip","include_watchonly","cursor"} },
     { "wallet",             "listunspent",                      &listunspent,                   {"minconf","maxconf","addresses","include_unsafe","query_options"} },
     { "wallet",             "getfirestone",                     &getfirestone,                  {"addresses","all"} },
     { "wallet",             "listslotfs",                       &listslotfs,                    {"index","all"} },
@@ -6824,17 +7301,20 @@ static const CRPCCommand commands[] =
     { "wallet",             "walletpassphrasechange",           &walletpassphrasechange,        {"oldpassphrase","newpassphrase"} },
     //{ "wallet",             "walletprocesspsbt",                &walletprocesspsbt,             {"psbt","sign","sighashtype","bip32derivs"} },
     { "wallet",             "buyfirestone",                     &buyfirestone,                  {"address","changer"} },
+    { "wallet",             "buyfirestones",                    &buyfirestones,                 {"address","changer","count"} },
     { "poc",                "bindplotid",                       &bindplotid,                    {"address", "target"} },
     { "poc",                "unbindplotid",                     &unbindplotid,                  {"address"} },
     { "poc",                "listbindings",                     &listbindings,                  {""} },
     { "poc",                "getbindinginfo",                   &getbindinginfo,                {"address"} },
     { "poc",                "createfstxwithwallet",             &createfstxwithwallet,          {"txid","address"} },
+    { "poc",                "presignfstx",                      &presignfstx,                   {"slotindex"} },
     { "poc",                "importfstx",                       &importfstx,                    {"hexstring","slotindex"} },
     { "poc",                "cleanfstx",                        &cleanfstx,                     {"slotindex"} },
     { "poc",                "listfstx",                         &listfstx,                      {""} },
     { "wallet",             "wallethaskey",                     &wallethaskey,                  {"address"} },
     { "wallet",             "spendticket",                      &spendticket,                   {"txid", "address"} },
 	{ "wallet",             "freefirestone",					&freefirestone,				    {"address", "receiver"} },
+    { "wallet",             "freefirestones",                   &freefirestones,                {"address", "receiver"} },
     // CA:
     { "wallet",             "importblindingkey",                &importblindingkey,             {"address", "hexkey"}},
     { "wallet",             "importmasterblindingkey",          &importmasterblindingkey,       {"hexkey"}},
@@ -4,6 +4,7 @@
 
 #include <wallet/wallet.h>
 
+#include <list>
 #include <memory>
 #include <set>
 #include <stdint.h>
@@ -43,7 +44,10 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     if (blockTime > 0) {
         LockAnnotation lock(::cs_main);
         auto locked_chain = wallet.chain().lock();
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        // The entry is owned here, UnloadBlockIndex only frees the ones it allocated.
+        static std::list<CBlockIndex> blocks;
+        blocks.emplace_back();
+        auto inserted = mapBlockIndex.emplace(GetRandHash(), &blocks.back());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
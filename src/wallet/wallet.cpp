@@ -30,9 +30,14 @@
 #include <util/bip32.h>
 #include <util/moneystr.h>
 #include <wallet/fees.h>
+#include <wallet/rpcwallet.h>
+#include <actiondb.h>
+#include <fspool.h>
+#include <ticket.h>
 
 #include <algorithm>
 #include <assert.h>
+#include <deque>
 #include <future>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -40,6 +45,7 @@
 #include <blind.h>
 #include <issuance.h>
 #include <crypto/hmac_sha256.h>
+#include <crypto/siphash.h>
 #include <random.h>
 
 static const size_t OUTPUT_GROUP_MAX_ENTRIES = 10;
@@ -100,7 +106,7 @@ static void ReleaseWallet(CWallet* wallet)
     wallet->WalletLogPrintf("Releasing wallet\n");
     wallet->BlockUntilSyncedToCurrentChain();
     wallet->Flush();
-    UnregisterValidationInterface(wallet);
+    wallet->UnregisterNotifications();
     delete wallet;
     // Wallet is now released, notify UnloadWallet, if any.
     {
@@ -226,9 +232,14 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, bool internal)
     mapKeyMetadata[pubkey.GetID()] = metadata;
     UpdateTimeFirstKey(nCreationTime);
 
+    // No transaction the wallet has can pay a key just generated, nor a firestone be owned by it.
+    const bool fStale = fAvailableCoinsStale;
+    const bool fTicketsStale = m_ticket_cache_stale;
     if (!AddKeyPubKeyWithDB(batch, secret, pubkey)) {
         throw std::runtime_error(std::string(__func__) + ": AddKey failed");
     }
+    fAvailableCoinsStale = fStale;
+    m_ticket_cache_stale = fTicketsStale;
     return pubkey;
 }
 
@@ -308,6 +319,83 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
+std::vector<CPubKey> CWallet::GenerateNewKeys(WalletBatch& batch, bool internal, int64_t count)
+{
+    assert(!IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS));
+    assert(IsHDEnabled());
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+    assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
+
+    // for now we use a fixed keypath scheme of m/0'/0'/k, see DeriveNewChildKey
+    CKey seed;
+    if (!GetKey(hdChain.seed_id, seed))
+        throw std::runtime_error(std::string(__func__) + ": seed not found");
+    CExtKey masterKey, accountKey, chainChildKey;
+    masterKey.SetSeed(seed.begin(), seed.size());
+    masterKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
+    accountKey.Derive(chainChildKey, BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+    const CKeyID master_id = masterKey.key.GetPubKey().GetID();
+    uint32_t& counter = internal ? hdChain.nInternalChainCounter : hdChain.nExternalChainCounter;
+
+    // No transaction the wallet has can pay a key just generated, nor a firestone be owned by it.
+    const bool fStale = fAvailableCoinsStale;
+    const bool fTicketsStale = m_ticket_cache_stale;
+    const int64_t nCreationTime = GetTime();
+    std::vector<CPubKey> pubkeys;
+    while ((int64_t)pubkeys.size() < count) {
+        const uint32_t first = counter;
+        const size_t nDerive = count - pubkeys.size();
+        std::vector<CKey> secrets(nDerive);
+        std::vector<CPubKey> derived(nDerive);
+        auto deriveRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                CExtKey childKey;
+                chainChildKey.Derive(childKey, (first + i) | BIP32_HARDENED_KEY_LIMIT);
+                secrets[i] = childKey.key;
+                derived[i] = childKey.key.GetPubKey();
+                assert(secrets[i].VerifyPubKey(derived[i]));
+            }
+        };
+        const size_t nThreads = nDerive < PARALLEL_DERIVE_MIN_COUNT ? 1 : std::max(GetNumCores(), 1);
+        const size_t nChunk = (nDerive + nThreads - 1) / nThreads;
+        std::vector<std::future<void>> deriving;
+        for (size_t begin = nChunk; begin < nDerive; begin += nChunk) {
+            deriving.push_back(std::async(std::launch::async, deriveRange, begin, std::min(begin + nChunk, nDerive)));
+        }
+        deriveRange(0, std::min(nChunk, nDerive));
+        for (auto& done : deriving) {
+            done.get();
+        }
+        counter += nDerive;
+
+        for (size_t i = 0; i < nDerive; i++) {
+            // skip keys already known to the wallet
+            if (HaveKey(derived[i].GetID())) continue;
+            CKeyMetadata metadata(nCreationTime);
+            metadata.hdKeypath = std::string(internal ? "m/0'/1'/" : "m/0'/0'/") + std::to_string(first + i) + "'";
+            metadata.key_origin.path.push_back(0 | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back((internal ? 1 : 0) | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back((first + i) | BIP32_HARDENED_KEY_LIMIT);
+            metadata.hd_seed_id = hdChain.seed_id;
+            std::copy(master_id.begin(), master_id.begin() + 4, metadata.key_origin.fingerprint);
+            metadata.has_key_origin = true;
+            mapKeyMetadata[derived[i].GetID()] = metadata;
+            if (!AddKeyPubKeyWithDB(batch, secrets[i], derived[i])) {
+                throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+            }
+            pubkeys.push_back(derived[i]);
+        }
+    }
+    UpdateTimeFirstKey(nCreationTime);
+    fAvailableCoinsStale = fStale;
+    m_ticket_cache_stale = fTicketsStale;
+
+    // update the chain model in the database
+    if (!batch.WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
+    return pubkeys;
+}
+
 bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -327,6 +415,8 @@ bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const C
         return false;
     }
     if (needsDB) encrypted_batch = nullptr;
+    fAvailableCoinsStale = true;
+    m_ticket_cache_stale = true;
 
     // check if we need to remove from watch-only
     CScript script;
@@ -459,6 +549,10 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    {
+        LOCK(cs_wallet);
+        fAvailableCoinsStale = true;
+    }
     if (WalletBatch(*database).WriteCScript(Hash160(redeemScript), redeemScript)) {
         UnsetWalletFlag(WALLET_FLAG_BLANK_WALLET);
         return true;
@@ -485,6 +579,10 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    {
+        LOCK(cs_wallet);
+        fAvailableCoinsStale = true;
+    }
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -910,12 +1008,48 @@ int64_t CWallet::IncOrderPosNext(WalletBatch *batch)
     int64_t nRet = nOrderPosNext++;
     if (batch) {
         batch->WriteOrderPosNext(nOrderPosNext);
+    } else if (m_tx_write_depth > 0) {
+        m_pending_order_pos_write = true;
     } else {
         WalletBatch(*database).WriteOrderPosNext(nOrderPosNext);
     }
     return nRet;
 }
 
+void CWallet::WritePendingTxs()
+{
+    AssertLockHeld(cs_wallet);
+    if (m_pending_tx_writes.empty() && !m_pending_order_pos_write) {
+        return;
+    }
+
+    WalletBatch batch(*database, "r+", false);
+    // Without a database transaction, as for a dummy database, the writes are made one by one.
+    const bool fTxn = batch.TxnBegin();
+    bool fWritten = true;
+    for (const uint256& hash : m_pending_tx_writes) {
+        const auto it = mapWallet.find(hash);
+        if (it != mapWallet.end() && !batch.WriteTx(it->second)) {
+            fWritten = false;
+        }
+    }
+    if (m_pending_order_pos_write && !batch.WriteOrderPosNext(nOrderPosNext)) {
+        fWritten = false;
+    }
+    if (fTxn) {
+        if (fWritten) {
+            fWritten = batch.TxnCommit();
+        } else {
+            batch.TxnAbort();
+        }
+    }
+    if (!fWritten) {
+        WalletLogPrintf("%s: Failed to write %u wallet transactions\n", __func__, m_pending_tx_writes.size());
+    }
+    m_pending_tx_writes.clear();
+    m_pending_order_pos_write = false;
+}
+
 void CWallet::MarkDirty()
 {
     {
@@ -958,7 +1092,11 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
-    WalletBatch batch(*database, "r+", fFlushOnClose);
+    // While the writes are batched they are left to the WalletTxWriteBatch.
+    std::unique_ptr<WalletBatch> batch;
+    if (m_tx_write_depth == 0) {
+        batch = MakeUnique<WalletBatch>(*database, "r+", fFlushOnClose);
+    }
 
     uint256 hash = wtxIn.GetHash();
 
@@ -969,10 +1107,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     bool fInsertedNew = ret.second;
     if (fInsertedNew) {
         wtx.nTimeReceived = GetAdjustedTime();
-        wtx.nOrderPos = IncOrderPosNext(&batch);
+        wtx.nOrderPos = IncOrderPosNext(batch.get());
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            setAvailableCoins.insert(COutPoint(hash, i));
+        }
     }
 
     bool fUpdated = false;
@@ -1015,9 +1156,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     WalletLogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
     // Write to disk
-    if (fInsertedNew || fUpdated)
-        if (!batch.WriteTx(wtx))
+    if (fInsertedNew || fUpdated) {
+        if (!batch) {
+            m_pending_tx_writes.insert(hash);
+        } else if (!batch->WriteTx(wtx)) {
             return false;
+        }
+    }
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
@@ -1130,6 +1275,7 @@ void CWallet::MarkInputsDirty(const CTransactionRef& tx)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            setAvailableCoins.insert(txin.prevout);
         }
     }
 }
@@ -1251,6 +1397,35 @@ void CWallet::SyncTransaction(const CTransactionRef& ptx, const uint256& block_h
     MarkInputsDirty(ptx);
 }
 
+SaltedScriptHasher::SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t SaltedScriptHasher::operator()(const CScript& script) const
+{
+    return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+}
+
+RescanScriptSet CWallet::GetRescanScripts() const
+{
+    RescanScriptSet scripts;
+    LOCK(cs_KeyStore);
+    for (const CKeyID& keyID : GetKeys()) {
+        scripts.insert(GetScriptForDestination(keyID));
+        scripts.insert(GetScriptForDestination(WitnessV0KeyHash(keyID)));
+    }
+    for (const auto& entry : mapScripts) {
+        scripts.insert(GetScriptForDestination(CScriptID(entry.second)));
+        scripts.insert(GetScriptForDestination(WitnessV0ScriptHash(entry.second)));
+    }
+    scripts.insert(setWatchOnly.begin(), setWatchOnly.end());
+    return scripts;
+}
+
+size_t CWallet::KeyStoreSize() const
+{
+    LOCK(cs_KeyStore);
+    return mapKeys.size() + mapCryptedKeys.size() + mapScripts.size() + setWatchOnly.size();
+}
+
 void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
@@ -1273,6 +1448,7 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    WalletTxWriteBatch write_batch(*this);
     // TODO: Temporarily ensure that mempool removals are notified before
     // connected transactions.  This shouldn't matter, but the abandoned
     // state of transactions in our wallet is currently cleared when we
@@ -1289,17 +1465,168 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         SyncTransaction(pblock->vtx[i], pindex->GetBlockHash(), i);
         TransactionRemovedFromMempool(pblock->vtx[i]);
     }
+    UpdateTicketCache(*pblock, pindex->nHeight, true);
 
     m_last_block_processed = pindex->GetBlockHash();
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (!m_presign_fstx || fInitialDownload || !pticketview || !pfspool)
+        return;
+    // Runs on the thread of the wallet notifications with no lock held, once per slot.
+    const int slotIndex = pindexNew->nHeight / Params().SlotLength();
+    if (slotIndex == m_fstx_signed_slot || slotIndex == 0)
+        return;
+    PreSignFstx(slotIndex);
+}
+
+bool CWallet::PreSignFstx(const int slotIndex, std::vector<CTransactionRef>* fstxs)
+{
+    LOCK(cs_fstx);
+    if (IsLocked()) {
+        WalletLogPrintf("%s: wallet is locked, fstx of slot %d are not pre-signed\n", __func__, slotIndex);
+        return false;
+    }
+
+    std::vector<CTicketRef> tickets;
+    {
+        LOCK(cs_main);
+        for (const auto& ticket : pticketview->GetTicketsBySlotIndex(slotIndex - 1)) {
+            if (HaveKey(ticket->KeyID()) && !pcoinsTip->AccessCoin(ticket->out).IsSpent()) {
+                tickets.push_back(ticket);
+            }
+        }
+    }
+
+    size_t nSigned = 0;
+    for (const auto& ticket : tickets) {
+        CKey key;
+        if (!GetKey(ticket->KeyID(), key))
+            continue;
+        auto fstx = makeSpentTicketTx(ticket, ticket->LockTime() + 1, CTxDestination(ticket->KeyID()), key);
+        if (fstx->vin.empty())
+            continue;
+        // The signature is deterministic, a fstx signed before is found in the fspool and kept.
+        if (!pfspool->WriteFstx(*fstx, slotIndex, fstx->GetHash())) {
+            WalletLogPrintf("%s: failed to write fstx %s\n", __func__, fstx->GetHash().ToString());
+            continue;
+        }
+        if (fstxs)
+            fstxs->push_back(fstx);
+        nSigned++;
+    }
+    m_fstx_signed_slot = slotIndex;
+    if (nSigned > 0)
+        WalletLogPrintf("%s: pre-signed %u fstx for slot %d\n", __func__, nSigned, slotIndex);
+    return true;
+}
+
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    WalletTxWriteBatch write_batch(*this);
 
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx, {} /* block hash */, 0 /* position in block */);
     }
+    const CBlockIndex* pindex = LookupBlockIndex(pblock->GetHash());
+    if (pindex) {
+        UpdateTicketCache(*pblock, pindex->nHeight - 1, false);
+    }
+}
+
+void CWallet::UpdateTicketCache(const CBlock& block, int height, bool fConnected)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    if (m_ticket_cache_stale)
+        return;
+
+    bool fActions = false;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                auto it = m_tickets.find(txin.prevout);
+                if (it != m_tickets.end()) {
+                    it->second.fSpent = fConnected;
+                }
+            }
+        }
+        if (tx->IsTicketTx() && !tx->Ticket()->Invalid() && HaveKey(tx->Ticket()->KeyID())) {
+            if (fConnected) {
+                m_tickets.emplace(tx->Ticket()->out, CWalletTicket(tx->Ticket(), false));
+            } else {
+                m_tickets.erase(tx->Ticket()->out);
+            }
+        }
+        fActions |= IsActionTx(*tx);
+    }
+    m_ticket_cache_height = height;
+
+    // The relation view is at the tip, which may be ahead of the block.
+    if (fActions || !m_bindings_cached) {
+        RefreshBindingTargets();
+    }
+}
+
+void CWallet::RefreshBindingTargets()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    m_binding_targets.clear();
+    // ListRelations only holds the relations of poc2+, those before are looked up by plot id.
+    m_bindings_cached = prelationview && chainActive.Tip() && chainActive.Tip()->nHeight >= Params().GetConsensus().LVIP05Height;
+    if (!m_bindings_cached)
+        return;
+    for (const CRelation& relation : prelationview->ListRelations()) {
+        if (HaveKey(relation.first)) {
+            m_binding_targets.emplace(relation.first, relation.second);
+        }
+    }
+}
+
+void CWallet::RebuildTicketCache()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    if (!m_ticket_cache_stale || !pticketview || !chainActive.Tip())
+        return;
+
+    m_tickets.clear();
+    std::set<CKeyID> keys = GetKeys();
+    for (const CKeyID& keyID : keys) {
+        for (const CTicketRef& ticket : pticketview->FindeTickets(keyID)) {
+            m_tickets.emplace(ticket->out, CWalletTicket(ticket, pcoinsTip->AccessCoin(ticket->out).IsSpent()));
+        }
+    }
+    m_ticket_cache_height = chainActive.Height();
+    m_ticket_cache_stale = false;
+    RefreshBindingTargets();
+}
+
+bool CWallet::GetCachedTickets(const CKeyID& keyID, std::vector<CWalletTicket>& tickets, int& height) const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_ticket_cache_stale || !HaveKey(keyID))
+        return false;
+    for (const auto& entry : m_tickets) {
+        if (entry.second.ticket->KeyID() == keyID) {
+            tickets.push_back(entry.second);
+        }
+    }
+    height = m_ticket_cache_height;
+    return true;
+}
+
+bool CWallet::GetCachedBindingTarget(const CKeyID& from, CKeyID& to) const
+{
+    AssertLockHeld(cs_wallet);
+    if (m_ticket_cache_stale || !m_bindings_cached || !HaveKey(from))
+        return false;
+    auto it = m_binding_targets.find(from);
+    to = it != m_binding_targets.end() ? it->second : CKeyID();
+    return true;
 }
 
 
@@ -1325,6 +1652,129 @@ void CWallet::BlockUntilSyncedToCurrentChain() {
     // for the queue to drain enough to execute it (indicating we are caught up
     // at least with the time we entered this function).
     SyncWithValidationInterfaceQueue();
+    // The notifications then passed to the wallet's own queue are processed too.
+    if (m_notification_queue) {
+        m_notification_queue->Sync();
+    }
+}
+
+void CWallet::RegisterNotifications()
+{
+    m_notification_queue = MakeUnique<CWalletNotificationQueue>(*this);
+    RegisterValidationInterface(m_notification_queue.get(), "wallet");
+}
+
+void CWallet::UnregisterNotifications()
+{
+    if (!m_notification_queue) {
+        UnregisterValidationInterface(this);
+        return;
+    }
+    UnregisterValidationInterface(m_notification_queue.get());
+    m_notification_queue->Stop();
+    m_notification_queue.reset();
+}
+
+CWalletNotificationQueue::CWalletNotificationQueue(CWallet& wallet, size_t max_size) : m_wallet(wallet), m_max_size(max_size)
+{
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "wallet", std::function<void()>(std::bind(&CWalletNotificationQueue::ThreadProcess, this)));
+}
+
+CWalletNotificationQueue::~CWalletNotificationQueue()
+{
+    Stop();
+}
+
+void CWalletNotificationQueue::Push(std::function<void()> fn)
+{
+    WAIT_LOCK(m_mutex, lock);
+    // Backpressure: the validation queue waits for a wallet that is far behind.
+    m_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_queue.size() < m_max_size || m_stop; });
+    if (m_stop) {
+        return;
+    }
+    m_queue.push_back(std::move(fn));
+    m_cv.notify_all();
+}
+
+void CWalletNotificationQueue::ThreadProcess()
+{
+    while (true) {
+        std::function<void()> fn;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return !m_queue.empty() || m_stop; });
+            if (m_queue.empty()) {
+                return;
+            }
+            fn = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_processing++;
+            m_cv.notify_all();
+        }
+        fn();
+        {
+            LOCK(m_mutex);
+            m_processing--;
+        }
+        m_cv.notify_all();
+    }
+}
+
+void CWalletNotificationQueue::Sync()
+{
+    if (std::this_thread::get_id() == m_thread.get_id()) {
+        return;
+    }
+    WAIT_LOCK(m_mutex, lock);
+    m_cv.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) { return m_queue.empty() && m_processing == 0; });
+}
+
+void CWalletNotificationQueue::Stop()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void CWalletNotificationQueue::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    Push([this, pindexNew, pindexFork, fInitialDownload] { m_wallet.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+}
+
+void CWalletNotificationQueue::TransactionAddedToMempool(const CTransactionRef& tx)
+{
+    Push([this, tx] { m_wallet.TransactionAddedToMempool(tx); });
+}
+
+void CWalletNotificationQueue::TransactionRemovedFromMempool(const CTransactionRef& tx)
+{
+    Push([this, tx] { m_wallet.TransactionRemovedFromMempool(tx); });
+}
+
+void CWalletNotificationQueue::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted)
+{
+    Push([this, pblock, pindex, vtxConflicted] { m_wallet.BlockConnected(pblock, pindex, vtxConflicted); });
+}
+
+void CWalletNotificationQueue::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
+{
+    Push([this, pblock] { m_wallet.BlockDisconnected(pblock); });
+}
+
+void CWalletNotificationQueue::ChainStateFlushed(const CBlockLocator& locator)
+{
+    Push([this, locator] { m_wallet.ChainStateFlushed(locator); });
+}
+
+void CWalletNotificationQueue::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman)
+{
+    m_wallet.ResendWalletTransactions(nBestBlockTime, connman);
 }
 
 
@@ -1783,6 +2233,49 @@ void CWalletTx::GetAmounts(std::list<COutputEntry>& listReceived,
 
 }
 
+namespace {
+/** A block read ahead by a rescan, with the transactions that may be the wallet's marked. */
+struct RescanBlock
+{
+    bool found = false;
+    CBlock block;
+    //! The script set the transactions were matched against
+    std::shared_ptr<const RescanScriptSet> scripts;
+    std::vector<bool> vMatch;
+};
+
+bool IsPayToPubKey(const CScript& script)
+{
+    return (script.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE + 2 && script[0] == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE && script.back() == OP_CHECKSIG) ||
+           (script.size() == CPubKey::PUBLIC_KEY_SIZE + 2 && script[0] == CPubKey::PUBLIC_KEY_SIZE && script.back() == OP_CHECKSIG);
+}
+
+/** Mark the transactions of the block with an output paying one of the scripts, or a public key. */
+void MatchRescanBlock(RescanBlock& rescan, const std::shared_ptr<const RescanScriptSet>& scripts)
+{
+    rescan.scripts = scripts;
+    rescan.vMatch.assign(rescan.block.vtx.size(), false);
+    for (size_t i = 0; i < rescan.block.vtx.size(); i++) {
+        for (const CTxOut& txout : rescan.block.vtx[i]->vout) {
+            if (scripts->count(txout.scriptPubKey) || IsPayToPubKey(txout.scriptPubKey)) {
+                rescan.vMatch[i] = true;
+                break;
+            }
+        }
+    }
+}
+
+RescanBlock ReadRescanBlock(interfaces::Chain& chain, const uint256& block_hash, const std::shared_ptr<const RescanScriptSet>& scripts)
+{
+    RescanBlock rescan;
+    rescan.found = chain.findBlock(block_hash, &rescan.block) && !rescan.block.IsNull();
+    if (rescan.found) {
+        MatchRescanBlock(rescan, scripts);
+    }
+    return rescan;
+}
+} // namespace
+
 /**
  * Scan active chain for relevant transactions after importing keys. This should
  * be called whenever new keys are added to the wallet, with the oldest key
@@ -1868,6 +2361,31 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
         }
         double progress_current = progress_begin;
+        // Transactions found are unblinded in batches, rather than output by output once their balance is needed.
+        std::vector<uint256> vUnblind;
+        // The next blocks are read and matched against the wallet's scripts on worker threads,
+        // so only the transactions that may be ours are synced under cs_wallet. The set is
+        // taken again once the key store grows, as the keypool is topped up.
+        size_t nKeyStoreSize = KeyStoreSize();
+        std::shared_ptr<const RescanScriptSet> scripts = std::make_shared<const RescanScriptSet>(GetRescanScripts());
+        std::deque<std::pair<uint256, std::future<RescanBlock>>> prefetch;
+        auto prefetch_blocks = [&](interfaces::Chain::Lock& locked_chain) {
+            if (!prefetch.empty() && prefetch.front().first != block_hash) {
+                // A reorg replaced the blocks read ahead.
+                prefetch.clear();
+            }
+            Optional<int> tip_height = locked_chain.getHeight();
+            while (prefetch.size() < RESCAN_PREFETCH_BLOCKS && (prefetch.empty() || prefetch.back().first != stop_block)) {
+                const int height = *block_height + (int)prefetch.size();
+                if (!tip_height || height > *tip_height) break;
+                const uint256 hash = prefetch.empty() ? block_hash : locked_chain.getBlockHash(height);
+                prefetch.emplace_back(hash, std::async(std::launch::async, ReadRescanBlock, std::ref(chain()), hash, scripts));
+            }
+        };
+        if (block_height) {
+            auto locked_chain = chain().lock();
+            prefetch_blocks(*locked_chain);
+        }
         while (block_height && !fAbortRescan && !ShutdownRequested()) {
             if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
                 ShowProgress(strprintf("%s " + _("Rescanning..."), GetDisplayName()), std::max(1, std::min(99, (int)((progress_current - progress_begin) / (progress_end - progress_begin) * 100))));
@@ -1877,10 +2395,18 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
             }
 
-            CBlock block;
-            if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+            RescanBlock rescan;
+            if (!prefetch.empty() && prefetch.front().first == block_hash) {
+                rescan = prefetch.front().second.get();
+                prefetch.pop_front();
+            } else {
+                rescan = ReadRescanBlock(chain(), block_hash, scripts);
+            }
+            if (rescan.found) {
+                const CBlock& block = rescan.block;
                 auto locked_chain = chain().lock();
                 LOCK(cs_wallet);
+                WalletTxWriteBatch write_batch(*this);
                 if (!locked_chain->getBlockHeight(block_hash)) {
                     // Abort scan if current block is no longer active, to prevent
                     // marking transactions as coming from the wrong block.
@@ -1891,7 +2417,29 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                     break;
                 }
                 for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
+                    if (rescan.scripts != scripts) {
+                        MatchRescanBlock(rescan, scripts);
+                    }
+                    const CTransaction& tx = *block.vtx[posInBlock];
+                    // Besides paying us, a transaction is ours if it spends our outputs, and is synced
+                    // if it is known or conflicts with a wallet transaction.
+                    bool fCandidate = rescan.vMatch[posInBlock] || mapWallet.count(tx.GetHash());
+                    for (size_t i = 0; !fCandidate && i < tx.vin.size(); i++) {
+                        fCandidate = mapWallet.count(tx.vin[i].prevout.hash) || mapTxSpends.count(tx.vin[i].prevout);
+                    }
+                    if (!fCandidate) continue;
                     SyncTransaction(block.vtx[posInBlock], block_hash, posInBlock, fUpdate);
+                    if (mapWallet.count(tx.GetHash())) {
+                        vUnblind.push_back(tx.GetHash());
+                    }
+                    if (KeyStoreSize() != nKeyStoreSize) {
+                        nKeyStoreSize = KeyStoreSize();
+                        scripts = std::make_shared<const RescanScriptSet>(GetRescanScripts());
+                    }
+                }
+                if (vUnblind.size() >= RESCAN_UNBLIND_BATCH) {
+                    PrecomputeBlindingData(vUnblind);
+                    vUnblind.clear();
                 }
                 // scan succeeded, record block as most recent successfully scanned
                 result.last_scanned_block = block_hash;
@@ -1916,6 +2464,7 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 // increment block and verification progress
                 block_hash = locked_chain->getBlockHash(++*block_height);
                 progress_current = chain().guessVerificationProgress(block_hash);
+                prefetch_blocks(*locked_chain);
 
                 // handle updated tip hash
                 const uint256 prev_tip_hash = tip_hash;
@@ -1926,6 +2475,11 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 }
             }
         }
+        if (!vUnblind.empty()) {
+            auto locked_chain = chain().lock();
+            LOCK(cs_wallet);
+            PrecomputeBlindingData(vUnblind);
+        }
         ShowProgress(strprintf("%s " + _("Rescanning..."), GetDisplayName()), 100); // hide progress dialog in GUI
         if (block_height && fAbortRescan) {
             WalletLogPrintf("Rescan aborted at block %d. Progress=%f\n", *block_height, progress_current);
@@ -2420,7 +2974,7 @@ CAmountMap CWallet::GetAvailableBalance(const CCoinControl* coinControl) const
     return balance;
 }
 
-void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutput> &vCoins, bool fOnlySafe, const CCoinControl *coinControl, const CAmount &nMinimumAmount, const CAmount &nMaximumAmount, const CAmount &nMinimumSumAmount, const uint64_t nMaximumCount, const int nMinDepth, const int nMaxDepth, const CAsset* asset_filter) const
+void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutput> &vCoins, bool fOnlySafe, const CCoinControl *coinControl, const CAmount &nMinimumAmount, const CAmount &nMaximumAmount, const CAmount &nMinimumSumAmount, const uint64_t nMaximumCount, const int nMinDepth, const int nMaxDepth, const CAsset* asset_filter, const COutPoint* start_after) const
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(cs_wallet);
@@ -2428,10 +2982,33 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     vCoins.clear();
     CAmount nTotal = 0;
 
-    for (const auto& entry : mapWallet)
+    if (fAvailableCoinsStale) {
+        setAvailableCoins.clear();
+        for (const auto& entry : mapWallet) {
+            for (unsigned int i = 0; i < entry.second.tx->vout.size(); i++) {
+                setAvailableCoins.emplace_hint(setAvailableCoins.end(), entry.first, i);
+            }
+        }
+        fAvailableCoinsStale = false;
+    }
+
+    // The outputs are in the order of their transaction, whose checks are made once.
+    auto coin_it = start_after ? setAvailableCoins.upper_bound(*start_after) : setAvailableCoins.begin();
+    while (coin_it != setAvailableCoins.end())
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx* pcoin = &entry.second;
+        const uint256 wtxid = coin_it->hash;
+        auto next_tx = coin_it;
+        while (next_tx != setAvailableCoins.end() && next_tx->hash == wtxid) {
+            ++next_tx;
+        }
+        const auto entry = mapWallet.find(wtxid);
+        if (entry == mapWallet.end()) {
+            coin_it = setAvailableCoins.erase(coin_it, next_tx);
+            continue;
+        }
+        const CWalletTx* pcoin = &entry->second;
+        auto outputs_begin = coin_it;
+        coin_it = next_tx;
 
         if (!CheckFinalTx(*pcoin->tx))
             continue;
@@ -2488,7 +3065,15 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
         if (nDepth < nMinDepth || nDepth > nMaxDepth)
             continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
+        for (auto out_it = outputs_begin; out_it != next_tx; ) {
+            const unsigned int i = out_it->n;
+            const isminetype mine = i < pcoin->tx->vout.size() && !IsSpent(locked_chain, wtxid, i) ? IsMine(pcoin->tx->vout[i]) : ISMINE_NO;
+            if (mine == ISMINE_NO) {
+                out_it = setAvailableCoins.erase(out_it);
+                continue;
+            }
+            ++out_it;
+
             CAmount outValue = pcoin->GetOutputValueOut(i);
             CAsset asset = pcoin->GetOutputAsset(i);
             if (asset_filter && asset != *asset_filter) {
@@ -2497,20 +3082,11 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
             if (outValue < nMinimumAmount || outValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
-                continue;
-
-            if (IsLockedCoin(entry.first, i))
-                continue;
-
-            if (IsSpent(locked_chain, wtxid, i))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
-
-            if (mine == ISMINE_NO) {
+            if (IsLockedCoin(wtxid, i))
                 continue;
-            }
 
             bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
             bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
@@ -2589,6 +3165,39 @@ const CTxOut& CWallet::FindNonChangeParentOutput(const CTransaction& tx, int out
     return ptx->vout[n];
 }
 
+namespace {
+/** The coins picked for one asset of a multi-asset selection. */
+struct AssetSelection
+{
+    bool success = false;
+    std::set<CInputCoin> coins;
+    CAmount value = 0;
+    bool change = false; //!< the coins exceed the target, so the asset needs a change output
+};
+
+/**
+ * Select coins for an asset that does not pay the fee. An exact match by Branch and Bound
+ * needs no change output in the asset; the knapsack solver is the fallback.
+ */
+AssetSelection SelectAssetCoins(std::vector<OutputGroup> groups, const CAmount& target)
+{
+    AssetSelection selection;
+    for (OutputGroup& group : groups) {
+        group.effective_value = group.m_value;
+        group.fee = 0;
+        group.long_term_fee = 0;
+    }
+    if (SelectCoinsBnB(groups, target, 0 /* cost_of_change */, selection.coins, selection.value, 0 /* not_input_fees */)) {
+        selection.success = true;
+        return selection;
+    }
+    selection.coins.clear();
+    selection.success = KnapsackSolver(target, groups, selection.coins, selection.value);
+    selection.change = selection.success && selection.value > target;
+    return selection;
+}
+} // namespace
+
 bool CWallet::SelectCoinsMinConf(const CAmountMap& mapTargetValue, const CoinEligibilityFilter& eligibility_filter, const std::vector<OutputGroup>& groups,
                                  std::set<CInputCoin>& setCoinsRet, CAmountMap& mapValueRet, const CoinSelectionParams& coin_selection_params, bool& bnb_used) const
 {
@@ -2596,26 +3205,65 @@ bool CWallet::SelectCoinsMinConf(const CAmountMap& mapTargetValue, const CoinEli
     mapValueRet.clear();
 
     std::vector<OutputGroup> utxo_pool;
-    if (coin_selection_params.use_bnb && mapTargetValue.size() == 1) {
-        // CA:
-        CAsset asset = mapTargetValue.begin()->first;
-        CAmount nTargetValue = mapTargetValue.begin()->second;
-        // Get output groups that only contain this asset.
-        std::vector<OutputGroup> asset_groups;
-        for (OutputGroup g : groups) {
+    // CA: Branch and Bound runs for a single asset, or for several when the policy asset,
+    // which pays the fee of all inputs and outputs, is among them.
+    if (coin_selection_params.use_bnb && (mapTargetValue.size() == 1 || mapTargetValue.count(::policyAsset))) {
+        // Get the output groups that only contain one of the assets, split by asset in one pass.
+        std::map<CAsset, std::vector<OutputGroup>> asset_groups;
+        for (const OutputGroup& g : groups) {
+            if (g.m_outputs.empty() || !mapTargetValue.count(g.m_outputs[0].asset)) continue;
+            const CAsset& asset = g.m_outputs[0].asset;
             bool add = true;
-            for (CInputCoin c : g.m_outputs) {
+            for (const CInputCoin& c : g.m_outputs) {
                 if (c.asset != asset) {
                     add = false;
                     break;
                 }
             }
 
-            if (add) {
-                asset_groups.push_back(g);
+            if (add && g.EligibleForSpending(eligibility_filter)) {
+                asset_groups[asset].push_back(g);
             }
         }
-        // END CA
+        const std::vector<OutputGroup> no_groups;
+        auto groups_of = [&](const CAsset& asset) -> const std::vector<OutputGroup>& {
+            auto it = asset_groups.find(asset);
+            return it == asset_groups.end() ? no_groups : it->second;
+        };
+        // The asset whose coins pay the fee: the policy asset, or the only one.
+        const CAsset fee_asset = mapTargetValue.size() == 1 ? mapTargetValue.begin()->first : ::policyAsset;
+
+        // Calculate the fees for things that aren't inputs
+        CAmount not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
+
+        // The other assets are selected first, in parallel, as the fee asset pays for their
+        // inputs and change outputs.
+        std::vector<std::pair<CAsset, std::future<AssetSelection>>> other_selections;
+        for (const auto& target : mapTargetValue) {
+            if (target.first == fee_asset || target.second == 0) continue;
+            const bool parallel = mapTargetValue.size() > 2;
+            other_selections.emplace_back(target.first, std::async(parallel ? std::launch::async : std::launch::deferred, SelectAssetCoins, std::cref(groups_of(target.first)), target.second));
+        }
+        bool success = true;
+        for (auto& other : other_selections) {
+            const AssetSelection selection = other.second.get();
+            if (!selection.success) {
+                success = false;
+                continue;
+            }
+            setCoinsRet.insert(selection.coins.begin(), selection.coins.end());
+            mapValueRet[other.first] = selection.value;
+            for (const CInputCoin& coin : selection.coins) {
+                not_input_fees += coin.m_input_bytes < 0 ? 0 : coin_selection_params.effective_fee.GetFee(coin.m_input_bytes);
+            }
+            if (selection.change) {
+                not_input_fees += coin_selection_params.effective_fee.GetFee(coin_selection_params.change_output_size);
+            }
+        }
+        bnb_used = true;
+        if (!success) {
+            return false;
+        }
 
         // Get long term estimate
         FeeCalculation feeCalc;
@@ -2626,10 +3274,8 @@ bool CWallet::SelectCoinsMinConf(const CAmountMap& mapTargetValue, const CoinEli
         // Calculate cost of change
         CAmount cost_of_change = GetDiscardRate(*this, ::feeEstimator).GetFee(coin_selection_params.change_spend_size) + coin_selection_params.effective_fee.GetFee(coin_selection_params.change_output_size);
 
-        // Filter by the min conf specs and add to utxo_pool and calculate effective value
-        for (OutputGroup& group : asset_groups) {
-            if (!group.EligibleForSpending(eligibility_filter)) continue;
-
+        // Add to utxo_pool and calculate effective value
+        for (OutputGroup group : groups_of(fee_asset)) {
             group.fee = 0;
             group.long_term_fee = 0;
             group.effective_value = 0;
@@ -2648,12 +3294,12 @@ bool CWallet::SelectCoinsMinConf(const CAmountMap& mapTargetValue, const CoinEli
             }
             if (group.effective_value > 0) utxo_pool.push_back(group);
         }
-        // Calculate the fees for things that aren't inputs
-        CAmount not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
-        bnb_used = true;
+        std::set<CInputCoin> fee_coins;
         CAmount nValueRet;
-        bool ret = SelectCoinsBnB(utxo_pool, nTargetValue, cost_of_change, setCoinsRet, nValueRet, not_input_fees);
-        mapValueRet[asset] = nValueRet;
+        const auto fee_target = mapTargetValue.find(fee_asset);
+        bool ret = SelectCoinsBnB(utxo_pool, fee_target == mapTargetValue.end() ? 0 : fee_target->second, cost_of_change, fee_coins, nValueRet, not_input_fees);
+        setCoinsRet.insert(fee_coins.begin(), fee_coins.end());
+        mapValueRet[fee_asset] = nValueRet;
         return ret;
     } else {
         // Filter by the min conf specs and add to utxo_pool
@@ -2786,28 +3432,46 @@ bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAm
     return res;
 }
 
+bool CWallet::SignInputs(CMutableTransaction& tx, const std::vector<const CTxOut*>& coins) const
+{
+    assert(coins.size() == tx.vin.size());
+
+    // The inputs are signed in parallel, sharing the signature hash data of tx, and updated in
+    // order once all are signed. The key origins are not needed, and looking them up takes
+    // cs_wallet, which the caller holds.
+    const PrecomputedTransactionData txdata(tx, true);
+    const HidingSigningProvider provider(this, false, true);
+    std::vector<SignatureData> sigdatas(tx.vin.size());
+    std::vector<char> signed_ok(tx.vin.size(), false);
+    SignInputsParallel(tx.vin.size(), [&](size_t i) {
+        const CTxOut& coin = *coins[i];
+        signed_ok[i] = ProduceSignature(provider, MutableTransactionSignatureCreator(&tx, i, coin.IsCA() ? coin.nValueCA : coin.nValue, SIGHASH_ALL, &txdata), coin.scriptPubKey, sigdatas[i]);
+    });
+
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        if (!signed_ok[i]) {
+            return false;
+        }
+        UpdateInput(tx.vin[i], sigdatas[i]);
+    }
+    return true;
+}
+
 bool CWallet::SignTransaction(CMutableTransaction &tx)
 {
     AssertLockHeld(cs_wallet); // mapWallet
 
-    // sign the new tx
-    int nIn = 0;
-    for (auto& input : tx.vin) {
+    std::vector<const CTxOut*> coins;
+    for (const auto& input : tx.vin) {
         std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(input.prevout.hash);
         if(mi == mapWallet.end() || input.prevout.n >= mi->second.tx->vout.size()) {
             return false;
         }
-        const CScript& scriptPubKey = mi->second.tx->vout[input.prevout.n].scriptPubKey;
-        const CTxOut& coin = mi->second.tx->vout[input.prevout.n];
-        const CAmount& amount = mi->second.tx->vout[input.prevout.n].nValue;
-        SignatureData sigdata;
-        if (!ProduceSignature(*this, MutableTransactionSignatureCreator(&tx, nIn, coin.IsCA() ? coin.nValueCA : coin.nValue, SIGHASH_ALL), scriptPubKey, sigdata)) {
-            return false;
-        }
-        UpdateInput(input, sigdata);
-        nIn++;
+        coins.push_back(&mi->second.tx->vout[input.prevout.n]);
     }
-    return true;
+
+    // sign the new tx
+    return SignInputs(tx, coins);
 }
 
 bool CWallet::FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl coinControl)
@@ -2829,7 +3493,7 @@ bool CWallet::FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nC
         // Account for the asset in the possible change destinations.
         if (txOut.IsCA()) {
             setAssets.insert(txOut.nAsset.GetAsset());
-            CRecipient recipient = {txOut.scriptPubKey, txOut.nValueCA.GetAmount(), setSubtractFeeFromOutputs.count(idx) == 1, txOut.nAsset.GetAsset(), CPubKey(txOut.nNonce.vchCommitment)};
+            CRecipient recipient = {txOut.scriptPubKey, txOut.nValueCA.GetAmount(), setSubtractFeeFromOutputs.count(idx) == 1, txOut.nAsset.GetAsset(), CPubKey(txOut.nNonce.vchCommitment.begin(), txOut.nNonce.vchCommitment.end())};
             vecSend.push_back(recipient);
         } else {
             CRecipient recipient = {txOut.scriptPubKey, txOut.nValue, setSubtractFeeFromOutputs.count(idx) == 1, ::policyAsset};
@@ -3274,7 +3938,7 @@ bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std
                 for (const auto& recipient : vecSend)
                 {
                     CTxOut txout(recipient.asset, recipient.nAmount, recipient.scriptPubKey);
-                    txout.nNonce.vchCommitment = std::vector<unsigned char>(recipient.confidentiality_key.begin(), recipient.confidentiality_key.end());
+                    txout.nNonce.vchCommitment.assign(recipient.confidentiality_key.begin(), recipient.confidentiality_key.end());
 
                     if (recipient.fSubtractFeeFromAmount)
                     {
@@ -3416,7 +4080,7 @@ bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std
                                 blind_details->change_to_blind++;
                                 blind_details->only_change_pos = vChangePosInOut[assetChange.first];
                                 // Place the blinding pubkey here in case of fundraw calls
-                                newTxOut.nNonce.vchCommitment = std::vector<unsigned char>(blind_pub.begin(), blind_pub.end());
+                                newTxOut.nNonce.vchCommitment.assign(blind_pub.begin(), blind_pub.end());
                             }
                         }
                         txNew.vout.insert(position, newTxOut);
@@ -3759,22 +4423,15 @@ bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std
 
         if (sign)
         {
-            int nIn = 0;
-            for (const auto& coin : selected_coins)
-            {
-                const CScript& scriptPubKey = coin.txout.scriptPubKey;
-                SignatureData sigdata;
-
-                assert(txNew.IsVersionCA() == isCA);
-                if (!ProduceSignature(*this, MutableTransactionSignatureCreator(&txNew, nIn, coin.txout.IsCA() ? coin.txout.nValueCA : coin.txout.nValue, SIGHASH_ALL), scriptPubKey, sigdata))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                } else {
-                    UpdateInput(txNew.vin.at(nIn), sigdata);
-                }
+            std::vector<const CTxOut*> coins;
+            for (const auto& coin : selected_coins) {
+                coins.push_back(&coin.txout);
+            }
 
-                nIn++;
+            assert(txNew.IsVersionCA() == isCA);
+            if (!SignInputs(txNew, coins)) {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
         } else if (blind_details) {
             // "sign" also means blind for the purposes of making a complete tx
@@ -4110,10 +4767,14 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
 
         // Top up key pool
         unsigned int nTargetSize;
-        if (kpSize > 0)
+        // By default the pool is topped up once it is -keypoolbatch keys short, or empty.
+        int64_t nBatchSize = 1;
+        if (kpSize > 0) {
             nTargetSize = kpSize;
-        else
+        } else {
             nTargetSize = std::max(gArgs.GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
+            nBatchSize = std::max(std::min(gArgs.GetArg("-keypoolbatch", DEFAULT_KEYPOOL_BATCH), (int64_t) nTargetSize), (int64_t) 1);
+        }
 
         // count amount of available keys (internal, external)
         // make sure the keypool of external and internal keys fits the user selected target (-keypool)
@@ -4125,16 +4786,40 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             // don't create extra internal keys
             missingInternal = 0;
         }
+        if (missingExternal < nBatchSize && !setExternalKeyPool.empty()) {
+            missingExternal = 0;
+        }
+        if (missingInternal < nBatchSize && !setInternalKeyPool.empty()) {
+            missingInternal = 0;
+        }
         bool internal = false;
         WalletBatch batch(*database);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            if (i < missingInternal) {
-                internal = true;
+        if (IsHDEnabled()) {
+            // The keys are written in one database transaction, unless writes of other
+            // handles may come along: the crypted keys unset the blank flag, and a key
+            // that was watched is erased from the watch-only scripts.
+            const bool fTxn = !IsCrypted() && !HaveWatchOnly() && batch.TxnBegin();
+            for (const CPubKey& pubkey : GenerateNewKeys(batch, false, missingExternal)) {
+                AddKeypoolPubkeyWithDB(pubkey, false, batch);
+            }
+            if (missingInternal > 0) {
+                for (const CPubKey& pubkey : GenerateNewKeys(batch, true, missingInternal)) {
+                    AddKeypoolPubkeyWithDB(pubkey, true, batch);
+                }
+            }
+            if (fTxn && !batch.TxnCommit()) {
+                throw std::runtime_error(std::string(__func__) + ": committing the keypool failed");
             }
+        } else {
+            for (int64_t i = missingInternal + missingExternal; i--;)
+            {
+                if (i < missingInternal) {
+                    internal = true;
+                }
 
-            CPubKey pubkey(GenerateNewKey(batch, internal));
-            AddKeypoolPubkeyWithDB(pubkey, internal, batch);
+                CPubKey pubkey(GenerateNewKey(batch, internal));
+                AddKeypoolPubkeyWithDB(pubkey, internal, batch);
+            }
         }
         if (missingInternal + missingExternal > 0) {
             WalletLogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size() + set_pre_split_keypool.size(), setInternalKeyPool.size());
@@ -5013,6 +5698,7 @@ std::shared_ptr<CWallet> CWallet::CreateWalletFromFile(interfaces::Chain& chain,
     walletInstance->m_confirm_target = gArgs.GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     walletInstance->m_spend_zero_conf_change = gArgs.GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     walletInstance->m_signal_rbf = gArgs.GetBoolArg("-walletrbf", DEFAULT_WALLET_RBF);
+    walletInstance->m_presign_fstx = gArgs.GetBoolArg("-presignfstx", DEFAULT_PRESIGN_FSTX);
 
     walletInstance->WalletLogPrintf("Wallet completed loading in %15dms\n", GetTimeMillis() - nStart);
 
@@ -5110,7 +5796,7 @@ std::shared_ptr<CWallet> CWallet::CreateWalletFromFile(interfaces::Chain& chain,
     uiInterface.LoadWallet(walletInstance);
 
     // Register with the validation interface. It's ok to do this after rescan since we're still holding cs_main.
-    RegisterValidationInterface(walletInstance.get());
+    walletInstance->RegisterNotifications();
 
     walletInstance->SetBroadcastTransactions(gArgs.GetBoolArg("-walletbroadcast", DEFAULT_WALLETBROADCAST));
 
@@ -5504,6 +6190,62 @@ void CWallet::ComputeBlindingData(const CConfidentialValue& conf_value, const CC
     asset_factor.SetNull();
 }
 
+void CWallet::PrecomputeBlindingData(const std::vector<uint256>& txids)
+{
+    AssertLockHeld(cs_wallet);
+
+    struct UnblindJob {
+        CWalletTx* wtx;
+        unsigned int n;
+        BlindingDataInfo data;
+    };
+    std::vector<UnblindJob> jobs;
+    for (const uint256& txid : txids) {
+        auto it = mapWallet.find(txid);
+        if (it == mapWallet.end()) {
+            continue;
+        }
+        CWalletTx& wtx = it->second;
+        if (wtx.blindingData.size() < wtx.tx->vout.size()) {
+            wtx.blindingData.resize(wtx.tx->vout.size() + GetNumIssuances(*wtx.tx));
+        }
+        for (unsigned int n = 0; n < wtx.tx->vout.size(); n++) {
+            const CTxOut& out = wtx.tx->vout[n];
+            if (!out.IsCA() || wtx.blindingData[n].computed == 1 || IsMine(out) == ISMINE_NO) {
+                continue;
+            }
+            jobs.push_back({&wtx, n, BlindingDataInfo()});
+        }
+    }
+    if (jobs.empty()) {
+        return;
+    }
+
+    // The rangeproof rewinds only read the wallet's blinding keys, which cs_wallet keeps from changing.
+    std::vector<std::function<bool()>> unblinds;
+    for (UnblindJob& job : jobs) {
+        unblinds.push_back([this, &job] {
+            const CTxOut& out = job.wtx->tx->vout[job.n];
+            ComputeBlindingData(out.nValueCA, out.nAsset, out.nNonce, out.scriptPubKey, out.vchRangeproof, job.data.value, job.data.blinding_pubkey, job.data.amount_blinding_factor, job.data.asset, job.data.asset_blinding_factor);
+            return job.data.value != -1;
+        });
+    }
+    int nUnblinded = RunBlindingJobs(unblinds);
+
+    WalletBatch batch(*database);
+    CWalletTx* last = nullptr;
+    for (const UnblindJob& job : jobs) {
+        job.wtx->SetBlindingData(job.n, job.data.blinding_pubkey, job.data.value, job.data.amount_blinding_factor, job.data.asset, job.data.asset_blinding_factor);
+        // Jobs of a transaction are next to each other, write it once its last one is in.
+        if (last && last != job.wtx) {
+            batch.WriteTx(*last);
+        }
+        last = job.wtx;
+    }
+    batch.WriteTx(*last);
+    WalletLogPrintf("Unblinded %d of %u confidential outputs\n", nUnblinded, jobs.size());
+}
+
 void CWalletTx::WipeUnknownBlindingData()
 {
     for (unsigned int n = 0; n < tx->vout.size(); n++) {
@@ -26,12 +26,17 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -71,6 +76,10 @@ std::shared_ptr<CWallet> LoadWallet(interfaces::Chain& chain, const WalletLocati
 
 //! Default for -keypool
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 100;
+//! Default for -keypoolbatch
+static const unsigned int DEFAULT_KEYPOOL_BATCH = 1;
+//! Keys derived at least at once before the derivation is spread over threads
+static const size_t PARALLEL_DERIVE_MIN_COUNT = 64;
 //! -paytxfee default
 constexpr CAmount DEFAULT_PAY_TX_FEE = 0;
 //! -fallbackfee default
@@ -92,13 +101,34 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 //! -walletrbf default
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
+//! Default for -presignfstx
+static const bool DEFAULT_PRESIGN_FSTX = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! Transactions found by a rescan that are unblinded at once
+static const size_t RESCAN_UNBLIND_BATCH = 256;
+//! Blocks a rescan reads and filters ahead on worker threads
+static const size_t RESCAN_PREFETCH_BLOCKS = 16;
+//! Notifications a wallet has queued at most before the validation queue waits for it
+static const size_t WALLET_NOTIFICATION_QUEUE_SIZE = 1000;
 
 //! Pre-calculated constants for input size estimation in *virtual size*
 static constexpr size_t DUMMY_NESTED_P2WPKH_INPUT_SIZE = 91;
 
 class CCoinControl;
 class COutput;
+
+/** Hashes a script with a salted SipHash, for the script set a rescan filters outputs with. */
+class SaltedScriptHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher();
+    size_t operator()(const CScript& script) const;
+};
+
+typedef std::unordered_set<CScript, SaltedScriptHasher> RescanScriptSet;
 class CReserveKey;
 class CScript;
 class CTxMemPool;
@@ -723,6 +753,14 @@ struct IssuanceDetails {
     uint256 entropy;
 };
 
+/** A firestone owned by a key of the wallet, as the ticket cache of the wallet holds it. */
+struct CWalletTicket {
+    CTicketRef ticket;
+    bool fSpent;
+
+    CWalletTicket(const CTicketRef& ticketIn, bool fSpentIn) : ticket(ticketIn), fSpent(fSpentIn) {}
+};
+
 struct BlindDetails {
     bool ignore_blind_failure = true; // Certain corner-cases are hard to avoid
 
@@ -749,6 +787,52 @@ struct BlindDetails {
 };
 
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
+class WalletTxWriteBatch;
+class CWallet;
+
+/**
+ * Takes the validation notifications of a wallet off the shared validation interface
+ * queue. It is registered in the wallet's place, and the notifications are queued and
+ * passed to the wallet in order, on a thread of its own, so a large wallet syncing its
+ * transactions, unblinding them and finding its firestones does not delay the other
+ * subscribers. Once WALLET_NOTIFICATION_QUEUE_SIZE are queued the validation queue waits,
+ * so a wallet falling behind holds a bounded backlog.
+ */
+class CWalletNotificationQueue final : public CValidationInterface
+{
+public:
+    explicit CWalletNotificationQueue(CWallet& wallet, size_t max_size = WALLET_NOTIFICATION_QUEUE_SIZE);
+    ~CWalletNotificationQueue();
+
+    /** Wait until the notifications queued so far are processed. */
+    void Sync();
+    /** Process the queued notifications, then stop the thread. */
+    void Stop();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& tx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
+    void ChainStateFlushed(const CBlockLocator& locator) override;
+    //! Passed on at once, as the wallet needs cs_main held by the caller
+    void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
+
+private:
+    void Push(std::function<void()> fn);
+    void ThreadProcess();
+
+    CWallet& m_wallet;
+    const size_t m_max_size;
+    Mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_queue GUARDED_BY(m_mutex);
+    //! Notifications taken but not yet processed
+    int m_processing GUARDED_BY(m_mutex) = 0;
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    std::thread m_thread;
+};
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -763,6 +847,18 @@ private:
 
     WalletBatch *encrypted_batch GUARDED_BY(cs_wallet) = nullptr;
 
+    //! The queue the validation notifications of the wallet go through, once registered
+    std::unique_ptr<CWalletNotificationQueue> m_notification_queue;
+
+    friend class WalletTxWriteBatch;
+    //! Number of WalletTxWriteBatch alive; while non-zero, AddToWallet leaves its writes to them
+    int m_tx_write_depth GUARDED_BY(cs_wallet) = 0;
+    //! Transactions added or updated while writes are batched, written when the last batch ends
+    std::set<uint256> m_pending_tx_writes GUARDED_BY(cs_wallet);
+    bool m_pending_order_pos_write GUARDED_BY(cs_wallet) = false;
+    /** Write the pending transactions, and nOrderPosNext, in one database transaction. */
+    void WritePendingTxs() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion = FEATURE_BASE;
 
@@ -783,6 +879,31 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * The outputs of wallet transactions that may be available to spend, so AvailableCoins
+     * does not walk all of mapWallet. It holds a superset: the outputs of new transactions
+     * are added, as are the inputs of transactions whose state changes. AvailableCoins drops
+     * the outputs it finds spent or not ours. Rebuilt from mapWallet once stale, as after
+     * keys or scripts are imported and outputs the wallet already has may become ours.
+     */
+    mutable std::set<COutPoint> setAvailableCoins GUARDED_BY(cs_wallet);
+    mutable bool fAvailableCoinsStale GUARDED_BY(cs_wallet) = true;
+
+    /**
+     * The firestones owned by the keys of the wallet and the binding targets of its keys,
+     * kept up to date from the blocks connected and disconnected, so the firestone RPCs
+     * answer without cs_main. Rebuilt from the ticket and relation views once stale, as
+     * after keys are imported. The bindings are only cached once poc2+ is active.
+     */
+    std::map<COutPoint, CWalletTicket> m_tickets GUARDED_BY(cs_wallet);
+    std::map<CKeyID, CKeyID> m_binding_targets GUARDED_BY(cs_wallet);
+    bool m_ticket_cache_stale GUARDED_BY(cs_wallet) = true;
+    bool m_bindings_cached GUARDED_BY(cs_wallet) = false;
+    //! The height the states of the cached firestones are given at
+    int m_ticket_cache_height GUARDED_BY(cs_wallet) = 0;
+    void UpdateTicketCache(const CBlock& block, int height, bool fConnected) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_wallet);
+    void RefreshBindingTargets() EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -810,11 +931,27 @@ private:
      * Should be called with non-zero block_hash and posInBlock if this is for a transaction that is included in a block. */
     void SyncTransaction(const CTransactionRef& tx, const uint256& block_hash, int posInBlock = 0, bool update_tx = true) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * The output scripts IsMine may accept, so a rescan can skip the outputs of others
+     * without asking it: the P2PKH and P2WPKH scripts of the keys, the P2SH and P2WSH
+     * scripts of the scripts, firestone redeemScripts included, and the watch-only
+     * scripts. Pay-to-pubkey outputs are not in the set and are always checked.
+     */
+    RescanScriptSet GetRescanScripts() const;
+    /** The number of keys and scripts in the key store, telling when GetRescanScripts is stale. */
+    size_t KeyStoreSize() const;
+
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey& secret, bool internal = false) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * Derive and add count new HD keys of a chain, as GenerateNewKey does one by one: the
+     * seed and chain keys are derived once, the child keys in parallel, and the chain
+     * model is written once.
+     */
+    std::vector<CPubKey> GenerateNewKeys(WalletBatch& batch, bool internal, int64_t count) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool GUARDED_BY(cs_wallet);
@@ -938,9 +1075,10 @@ public:
     bool CanSupportFeature(enum WalletFeature wf) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) { AssertLockHeld(cs_wallet); return nWalletMaxVersion >= wf; }
 
     /**
-     * populate vCoins with vector of available COutputs.
+     * populate vCoins with vector of available COutputs, in the order of their outpoints,
+     * starting after start_after if given.
      */
-    void AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutput>& vCoins, bool fOnlySafe=true, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t nMaximumCount = 0, const int nMinDepth = 0, const int nMaxDepth = 9999999, const CAsset* = nullptr) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<COutput>& vCoins, bool fOnlySafe=true, const CCoinControl *coinControl = nullptr, const CAmount& nMinimumAmount = 1, const CAmount& nMaximumAmount = MAX_MONEY, const CAmount& nMinimumSumAmount = MAX_MONEY, const uint64_t nMaximumCount = 0, const int nMinDepth = 0, const int nMaxDepth = 9999999, const CAsset* = nullptr, const COutPoint* start_after = nullptr) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     /**
      * Return list of available coins and locked coins grouped by non-change output address.
@@ -1044,6 +1182,28 @@ public:
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
+    /** Pre-sign the fstx of a slot once the tip enters it, see PreSignFstx. */
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    /**
+     * Sign a fstx for each unspent firestone of the wallet that is USABLE at slotIndex, those
+     * bought in the slot before, and write them into the fspool, so forging finds them ready
+     * rather than signing under cs_main. Returns false if the wallet is locked.
+     * @param[out]  fstxs  the fstx signed, if not null.
+     */
+    bool PreSignFstx(const int slotIndex, std::vector<CTransactionRef>* fstxs = nullptr);
+
+    /** Rebuild the ticket cache from the ticket and relation views, if it is stale. */
+    void RebuildTicketCache() EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_wallet);
+    /**
+     * Get the cached firestones of a key of the wallet and the height their states are
+     * given at. Returns false if the key is not the wallet's or the cache is stale.
+     */
+    bool GetCachedTickets(const CKeyID& keyID, std::vector<CWalletTicket>& tickets, int& height) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * Get the cached binding target of a key of the wallet, null if it is not bound.
+     * Returns false if the key is not the wallet's or the bindings are not cached.
+     */
+    bool GetCachedBindingTarget(const CKeyID& from, CKeyID& to) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
 
     struct ScanResult {
@@ -1083,6 +1243,8 @@ public:
      */
     bool FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl);
     bool SignTransaction(CMutableTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Sign every input i of tx, spending coins[i], with SIGHASH_ALL, several inputs at once. */
+    bool SignInputs(CMutableTransaction& tx, const std::vector<const CTxOut*>& coins) const;
 
     /**
      * Create a new transaction paying the recipients with a set of coins
@@ -1106,6 +1268,10 @@ public:
     unsigned int m_confirm_target{DEFAULT_TX_CONFIRM_TARGET};
     bool m_spend_zero_conf_change{DEFAULT_SPEND_ZEROCONF_CHANGE};
     bool m_signal_rbf{DEFAULT_WALLET_RBF};
+    bool m_presign_fstx{DEFAULT_PRESIGN_FSTX};
+    //! The last slot whose fstx were pre-signed, and the lock serializing the signers
+    std::atomic<int> m_fstx_signed_slot{-1};
+    CCriticalSection cs_fstx;
     bool m_allow_fallback_fee{true}; //!< will be defined via chainparams
     CFeeRate m_min_fee{DEFAULT_TRANSACTION_MINFEE}; //!< Override with -mintxfee
     /**
@@ -1304,6 +1470,11 @@ public:
      */
     void BlockUntilSyncedToCurrentChain() LOCKS_EXCLUDED(cs_main, cs_wallet);
 
+    /** Register the wallet for validation notifications, through a CWalletNotificationQueue. */
+    void RegisterNotifications();
+    /** Unregister the wallet, processing the notifications still queued for it. */
+    void UnregisterNotifications();
+
     /**
      * Explicitly make the wallet learn the related scripts for outputs to the
      * given key. This is purely to make the wallet file compatible with older
@@ -1351,6 +1522,12 @@ public:
 
     void ComputeBlindingData(const CConfidentialValue& conf_value, const CConfidentialAsset& conf_asset, const CConfidentialNonce& nonce, const CScript& scriptPubKey, const std::vector<unsigned char>& vchRangeproof, CAmount& value, CPubKey& blinding_pubkey, uint256& value_factor, CAsset& asset, uint256& asset_factor) const;
 
+    /**
+     * Unblind the confidential outputs of ours in these transactions that are not unblinded yet,
+     * across the cores, and write the transactions to the wallet database with their blinding data.
+     */
+    void PrecomputeBlindingData(const std::vector<uint256>& txids) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     // First looks in imported blinding key store, then derives on its own
     CKey GetBlindingKey(const CScript* script) const;
     // Pubkey accessor for GetBlindingKey
@@ -1440,6 +1617,31 @@ public:
     }
 };
 
+/**
+ * Batches the wallet transaction writes made while it is alive, as by the transactions of
+ * a connected block, into one database transaction written when the outermost batch ends,
+ * rather than one per transaction. The state written is the one the transactions have then.
+ */
+class WalletTxWriteBatch
+{
+private:
+    CWallet& m_wallet;
+public:
+    explicit WalletTxWriteBatch(CWallet& wallet) : m_wallet(wallet)
+    {
+        LOCK(m_wallet.cs_wallet);
+        ++m_wallet.m_tx_write_depth;
+    }
+
+    ~WalletTxWriteBatch()
+    {
+        LOCK(m_wallet.cs_wallet);
+        if (--m_wallet.m_tx_write_depth == 0) {
+            m_wallet.WritePendingTxs();
+        }
+    }
+};
+
 // Calculate the size of the transaction assuming all signatures are max size
 // Use DummySignatureCreator, which inserts 71 byte signatures everywhere.
 // NOTE: this requires that all inputs must be in mapWallet (eg the tx should
@@ -3,14 +3,29 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <base58.h>
+#include <blind.h>
+#include <consensus/consensus.h>
+#include <dbwrapper.h>
 #include <fs.h>
+#include <hash.h>
 #include <interfaces/chain.h>
+#include <txdb.h>
+#include <util/moneystr.h>
+#include <util/strencodings.h>
 #include <util/system.h>
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
 
 namespace WalletTool {
 
+/** First line of a wallet dump, followed by the format version. */
+static const std::string WALLET_DUMP_MAGIC = "LAVA_WALLET_DUMP";
+static const int WALLET_DUMP_VERSION = 1;
+/** Wallet outputs looked up in the chainstate by one job of rebuild-utxo. */
+static const size_t REBUILD_UTXO_BATCH = 1024;
+/** Cache of the chainstate database opened by rebuild-utxo. */
+static const size_t REBUILD_UTXO_DB_CACHE = 64 << 20;
+
 // The standard wallet deleter function blocks on the validation interface
 // queue, which doesn't exist for the bitcoin-wallet. Define our own
 // deleter here.
@@ -104,6 +119,221 @@ static void WalletShowInfo(CWallet* wallet_instance)
     fprintf(stdout, "Address Book: %zu\n", wallet_instance->mapAddressBook.size());
 }
 
+/** Size of the data file of the wallet at path, a wallet directory or a file of the wallet directory. */
+static uint64_t WalletFileSize(const fs::path& path)
+{
+    std::string filename;
+    std::shared_ptr<BerkeleyEnvironment> env = GetWalletEnv(path, filename);
+    boost::system::error_code ec;
+    const uintmax_t size = fs::file_size(env->Directory() / filename, ec);
+    return ec ? 0 : size;
+}
+
+/**
+ * Write every record of the wallet database as a line KEY,VALUE in hex to dump_path, after a
+ * header line and before a line with the checksum of all lines before it. The database is read
+ * as it is, without loading the wallet, so a wallet the node fails to load can still be dumped.
+ */
+static bool DumpWallet(const fs::path& path, const fs::path& dump_path)
+{
+    if (fs::exists(dump_path)) {
+        fprintf(stderr, "Error: dump file %s exists already\n", dump_path.string().c_str());
+        return false;
+    }
+    FILE* file = fsbridge::fopen(dump_path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: cannot open %s\n", dump_path.string().c_str());
+        return false;
+    }
+
+    CHashWriter hasher(0, 0);
+    auto write_line = [file, &hasher](const std::string& line) {
+        hasher.write(line.data(), line.size());
+        fwrite(line.data(), 1, line.size(), file);
+    };
+    write_line(strprintf("%s,%d\n", WALLET_DUMP_MAGIC, WALLET_DUMP_VERSION));
+
+    std::unique_ptr<WalletDatabase> database = WalletDatabase::Create(path);
+    size_t records = 0;
+    bool ok = true;
+    {
+        BerkeleyBatch batch(*database, "r");
+        Dbc* cursor = batch.GetCursor();
+        if (!cursor) {
+            fprintf(stderr, "Error: cannot read the wallet database\n");
+            ok = false;
+        }
+        while (ok) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            const int ret = batch.ReadAtCursor(cursor, ssKey, ssValue);
+            if (ret == DB_NOTFOUND) {
+                break;
+            } else if (ret != 0) {
+                fprintf(stderr, "Error: cannot read record %u of the wallet database, try salvage\n", records);
+                ok = false;
+                break;
+            }
+            write_line(HexStr(ssKey.begin(), ssKey.end()) + "," + HexStr(ssValue.begin(), ssValue.end()) + "\n");
+            records++;
+        }
+        if (cursor) cursor->close();
+    }
+    database->Flush(true);
+
+    const std::string checksum = strprintf("checksum,%s\n", hasher.GetHash().GetHex());
+    fwrite(checksum.data(), 1, checksum.size(), file);
+    ok = ok && !ferror(file) && FileCommit(file);
+    fclose(file);
+    if (!ok) {
+        fs::remove(dump_path);
+        return false;
+    }
+    fprintf(stdout, "Dumped %zu records to %s\n", records, dump_path.string().c_str());
+    return true;
+}
+
+/** Rewrite the wallet database to a fresh file, leaving out the pages freed by deleted records. */
+static bool CompactWallet(const fs::path& path)
+{
+    const uint64_t size_before = WalletFileSize(path);
+    std::unique_ptr<WalletDatabase> database = WalletDatabase::Create(path);
+    if (!database->Rewrite()) {
+        fprintf(stderr, "Error: cannot rewrite the wallet database\n");
+        return false;
+    }
+    database->Flush(true);
+    fprintf(stdout, "Compacted %u bytes to %u bytes\n", size_before, WalletFileSize(path));
+    return true;
+}
+
+/** An output of the wallet, and the coin of the chainstate it is if still unspent. */
+struct CRebuildOutput
+{
+    const CWalletTx* wtx;
+    unsigned int n;
+    isminetype mine;
+    bool fWalletSpent;  //!< spent by a transaction of the wallet
+    bool fUnspent;      //!< found in the chainstate
+    Coin coin;
+};
+
+/**
+ * Recompute which outputs of the wallet are unspent, and the balances, from the chainstate of
+ * the data directory instead of the blocks: the outputs are looked up across the cores, the
+ * confidential ones still unspent are unblinded and written back with their blinding data, and
+ * the outputs on which the wallet and the chainstate disagree are counted, as they call for a
+ * rescan or abandoning a transaction on the node.
+ */
+static bool RebuildUTXO(CWallet* wallet_instance)
+{
+    std::unique_ptr<CCoinsViewDB> view;
+    try {
+        view.reset(new CCoinsViewDB(REBUILD_UTXO_DB_CACHE));
+    } catch (const dbwrapper_error& e) {
+        fprintf(stderr, "Error opening the chainstate: %s. Is the node running?\n", e.what());
+        return false;
+    }
+    const uint256 best_block = view->GetBestBlock();
+    if (best_block.IsNull()) {
+        fprintf(stderr, "Error: no chainstate in %s\n", GetDataDir().string().c_str());
+        return false;
+    }
+
+    auto locked_chain = wallet_instance->chain().lock();
+    LOCK(wallet_instance->cs_wallet);
+
+    std::vector<CRebuildOutput> outputs;
+    for (const auto& entry : wallet_instance->mapWallet) {
+        const CWalletTx& wtx = entry.second;
+        for (unsigned int n = 0; n < wtx.tx->vout.size(); n++) {
+            const isminetype mine = wallet_instance->IsMine(wtx.tx->vout[n]);
+            if (mine == ISMINE_NO) continue;
+            outputs.push_back({&wtx, n, mine, wallet_instance->IsSpent(*locked_chain, entry.first, n), false, Coin()});
+        }
+    }
+
+    // The chainstate database is only read, by any number of threads.
+    std::vector<std::function<bool()>> lookups;
+    for (size_t begin = 0; begin < outputs.size(); begin += REBUILD_UTXO_BATCH) {
+        const size_t end = std::min(begin + REBUILD_UTXO_BATCH, outputs.size());
+        lookups.push_back([&view, &outputs, begin, end] {
+            for (size_t i = begin; i < end; i++) {
+                CRebuildOutput& output = outputs[i];
+                output.fUnspent = view->GetCoin(COutPoint(output.wtx->GetHash(), output.n), output.coin);
+            }
+            return true;
+        });
+    }
+    RunBlindingJobs(lookups);
+
+    std::vector<uint256> unblind;
+    for (const CRebuildOutput& output : outputs) {
+        if (output.fUnspent && output.wtx->tx->vout[output.n].IsCA() && (unblind.empty() || unblind.back() != output.wtx->GetHash())) {
+            unblind.push_back(output.wtx->GetHash());
+        }
+    }
+    wallet_instance->PrecomputeBlindingData(unblind);
+
+    CAmountMap balance, watch_balance, coinbase_balance;
+    size_t unspent = 0, spent_by_wallet = 0, spent_elsewhere = 0, unknown_value = 0;
+    for (const CRebuildOutput& output : outputs) {
+        const CWalletTx& wtx = *output.wtx;
+        if (!output.fUnspent) {
+            // Outputs of transactions the wallet holds as confirmed are in the chainstate until spent.
+            if (!output.fWalletSpent && !wtx.hashUnset() && wtx.nIndex >= 0) spent_elsewhere++;
+            continue;
+        }
+        unspent++;
+        if (output.fWalletSpent) spent_by_wallet++;
+        const CAmount value = wtx.GetOutputValueOut(output.n);
+        if (value < 0) {
+            unknown_value++;
+            continue;
+        }
+        const CAsset asset = wtx.GetOutputAsset(output.n);
+        if (output.mine & ISMINE_SPENDABLE) {
+            balance[asset] += value;
+            if (output.coin.IsCoinBase()) coinbase_balance[asset] += value;
+        } else {
+            watch_balance[asset] += value;
+        }
+    }
+
+    fprintf(stdout, "Chainstate at block %s\n", best_block.GetHex().c_str());
+    fprintf(stdout, "Wallet outputs: %zu, unspent: %zu\n", outputs.size(), unspent);
+    for (const auto& entry : balance) {
+        fprintf(stdout, "Balance %s: %s, of which coinbase: %s\n", entry.first.GetHex().c_str(), FormatMoney(entry.second).c_str(), FormatMoney(coinbase_balance[entry.first]).c_str());
+    }
+    for (const auto& entry : watch_balance) {
+        fprintf(stdout, "Watch-only balance %s: %s\n", entry.first.GetHex().c_str(), FormatMoney(entry.second).c_str());
+    }
+    if (unknown_value > 0) {
+        fprintf(stdout, "Unspent outputs the wallet cannot unblind: %zu\n", unknown_value);
+    }
+    if (spent_by_wallet > 0) {
+        fprintf(stdout, "Unspent outputs spent by unconfirmed wallet transactions: %zu, abandon them to spend the outputs again\n", spent_by_wallet);
+    }
+    if (spent_elsewhere > 0) {
+        fprintf(stdout, "Outputs spent by transactions the wallet does not hold: %zu, rescan to pick them up\n", spent_elsewhere);
+    }
+    return true;
+}
+
+static bool VerifyWalletFile(const std::string& name, const fs::path& path)
+{
+    if (!fs::exists(path)) {
+        fprintf(stderr, "Error: no wallet file at %s\n", name.c_str());
+        return false;
+    }
+    std::string error;
+    if (!WalletBatch::VerifyEnvironment(path, error)) {
+        fprintf(stderr, "Error loading %s. Is wallet being used by other process?\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
 bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
 {
     fs::path path = fs::absolute(name, GetWalletDir());
@@ -115,18 +345,34 @@ bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
             wallet_instance->Flush(true);
         }
     } else if (command == "info") {
-        if (!fs::exists(path)) {
-            fprintf(stderr, "Error: no wallet file at %s\n", name.c_str());
+        if (!VerifyWalletFile(name, path)) return false;
+        std::shared_ptr<CWallet> wallet_instance = LoadWallet(name, path);
+        if (!wallet_instance) return false;
+        WalletShowInfo(wallet_instance.get());
+        wallet_instance->Flush(true);
+    } else if (command == "dump") {
+        if (!gArgs.IsArgSet("-dumpfile")) {
+            fprintf(stderr, "Error: the dump command requires -dumpfile\n");
             return false;
         }
-        std::string error;
-        if (!WalletBatch::VerifyEnvironment(path, error)) {
-            fprintf(stderr, "Error loading %s. Is wallet being used by other process?\n", name.c_str());
+        if (!VerifyWalletFile(name, path)) return false;
+        return DumpWallet(path, fs::absolute(gArgs.GetArg("-dumpfile", "")));
+    } else if (command == "compact") {
+        if (!VerifyWalletFile(name, path)) return false;
+        return CompactWallet(path);
+    } else if (command == "salvage") {
+        if (!VerifyWalletFile(name, path)) return false;
+        std::string backup_filename;
+        if (!WalletBatch::Recover(path, backup_filename)) {
+            fprintf(stderr, "Error: cannot salvage %s\n", name.c_str());
             return false;
         }
+        fprintf(stdout, "Salvaged %s, the damaged file is kept as %s\n", name.c_str(), backup_filename.c_str());
+    } else if (command == "rebuild-utxo") {
+        if (!VerifyWalletFile(name, path)) return false;
         std::shared_ptr<CWallet> wallet_instance = LoadWallet(name, path);
         if (!wallet_instance) return false;
-        WalletShowInfo(wallet_instance.get());
+        if (!RebuildUTXO(wallet_instance.get())) return false;
         wallet_instance->Flush(true);
     } else {
         fprintf(stderr, "Invalid command: %s\n", command.c_str());
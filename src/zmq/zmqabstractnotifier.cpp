@@ -12,7 +12,7 @@ CZMQAbstractNotifier::~CZMQAbstractNotifier()
     assert(!psocket);
 }
 
-bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/)
+bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/, const std::shared_ptr<const CBlock>& /*pblock*/)
 {
     return true;
 }
@@ -21,3 +21,13 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyPoCBlock(const CBlockIndex * /*pindex*/, const CPoCBlockChanges &/*changes*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyDeadline(const CPOCDeadline &/*deadline*/)
+{
+    return true;
+}
@@ -7,8 +7,13 @@
 
 #include <zmq/zmqconfig.h>
 
+#include <memory>
+
+class CBlock;
 class CBlockIndex;
 class CZMQAbstractNotifier;
+struct CPoCBlockChanges;
+struct CPOCDeadline;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -40,8 +45,13 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    /** Notify of a new tip. pblock is its block when still in memory, null otherwise. */
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    /** Notify of the firestones, bindings and slot of a block connected. */
+    virtual bool NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes);
+    /** Notify of a new best deadline for the next block. */
+    virtual bool NotifyDeadline(const CPOCDeadline &deadline);
 
 protected:
     void *psocket;
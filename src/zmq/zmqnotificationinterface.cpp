@@ -48,6 +48,11 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubmininginfo"] = CZMQAbstractNotifier::Create<CZMQPublishMiningInfoNotifier>;
+    factories["pubfirestone"] = CZMQAbstractNotifier::Create<CZMQPublishFirestoneNotifier>;
+    factories["pubbinding"] = CZMQAbstractNotifier::Create<CZMQPublishBindingNotifier>;
+    factories["pubslot"] = CZMQAbstractNotifier::Create<CZMQPublishSlotNotifier>;
+    factories["pubdeadline"] = CZMQAbstractNotifier::Create<CZMQPublishDeadlineNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -140,13 +145,18 @@ void CZMQNotificationInterface::Shutdown()
 
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
 {
+    std::shared_ptr<const CBlock> pblock;
+    pblock.swap(m_last_connected_block);
     if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
         return;
 
+    if (pblock && pblock->GetHash() != pindexNew->GetBlockHash())
+        pblock.reset();
+
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notifier->NotifyBlock(pindexNew, pblock))
         {
             i++;
         }
@@ -185,6 +195,7 @@ void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBloc
         // Do a normal notify for each transaction added in the block
         TransactionAddedToMempool(ptx);
     }
+    m_last_connected_block = pblock;
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
@@ -195,4 +206,32 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
     }
 }
 
+template <typename F>
+void CZMQNotificationInterface::ForEachNotifier(F notify)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notify(notifier))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::PoCBlockConnected(const CBlockIndex *pindex, const std::shared_ptr<const CPoCBlockChanges>& changes)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifyPoCBlock(pindex, *changes); });
+}
+
+void CZMQNotificationInterface::NewBestDeadline(const std::shared_ptr<const CPOCDeadline>& deadline)
+{
+    ForEachNotifier([&](CZMQAbstractNotifier *notifier) { return notifier->NotifyDeadline(*deadline); });
+}
+
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
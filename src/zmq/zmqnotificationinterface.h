@@ -31,12 +31,20 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void PoCBlockConnected(const CBlockIndex *pindex, const std::shared_ptr<const CPoCBlockChanges>& changes) override;
+    void NewBestDeadline(const std::shared_ptr<const CPOCDeadline>& deadline) override;
 
 private:
     CZMQNotificationInterface();
 
+    /** Call notify for each notifier, shutting down those it fails for. */
+    template <typename F>
+    void ForEachNotifier(F notify);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! The block last connected, the block of the tip UpdatedBlockTip is called for next
+    std::shared_ptr<const CBlock> m_last_connected_block;
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
@@ -2,9 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <assember.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <crypto/common.h>
+#include <poc.h>
 #include <streams.h>
+#include <ticket.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util/system.h>
@@ -16,6 +20,17 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_MININGINFO = "mininginfo";
+static const char *MSG_FIRESTONE = "firestone";
+static const char *MSG_BINDING   = "binding";
+static const char *MSG_SLOT      = "slot";
+static const char *MSG_DEADLINE  = "deadline";
+
+/** The kinds of firestone and binding notifications, the first byte of their body. */
+static const unsigned char ZMQ_FIRESTONE_BOUGHT = 1;
+static const unsigned char ZMQ_FIRESTONE_SPENT  = 2;
+static const unsigned char ZMQ_BINDING_BIND     = 1;
+static const unsigned char ZMQ_BINDING_UNBIND   = 2;
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -60,6 +75,38 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+// Releases the owner of the data of a zero-copy message once ZMQ has sent it
+static void zmq_release_owner(void* /* data */, void* hint)
+{
+    delete static_cast<std::shared_ptr<const void>*>(hint);
+}
+
+// Internal function to send one part of a multipart message without copying its data
+static int zmq_send_zerocopy(void *sock, const std::shared_ptr<const void>& owner, const void* data, size_t size, int flags)
+{
+    zmq_msg_t msg;
+
+    auto hint = new std::shared_ptr<const void>(owner);
+    int rc = zmq_msg_init_data(&msg, const_cast<void*>(data), size, zmq_release_owner, hint);
+    if (rc != 0)
+    {
+        delete hint;
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+
+    rc = zmq_msg_send(&msg, sock, flags);
+    if (rc == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msg);
+        return -1;
+    }
+
+    zmq_msg_close(&msg);
+    return 0;
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -157,7 +204,33 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const std::shared_ptr<const void>& owner, const void* data, size_t size)
+{
+    assert(psocket);
+
+    /* send the same three parts, only the command and the sequence number are copied */
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequence);
+    if (zmq_send(psocket, command, strlen(command), ZMQ_SNDMORE) == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        return false;
+    }
+    if (zmq_send_zerocopy(psocket, owner, data, size, ZMQ_SNDMORE) == -1)
+        return false;
+    if (zmq_send(psocket, msgseq, sizeof(msgseq), 0) == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        return false;
+    }
+
+    /* increment memory only sequence number after sending */
+    nSequence++;
+
+    return true;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& /*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -177,25 +250,35 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    {
-        LOCK(cs_main);
+    // A block is stored the way it is sent with witnesses, so its bytes on disk are sent as
+    // they are, from the mapped block file where it can be mapped.
+    const int nSerializationFlags = RPCSerializationFlags();
+    if (nSerializationFlags == 0) {
+        auto raw = std::make_shared<RawBlockData>();
+        if (ReadRawBlockFromDisk(*raw, pindex, Params().MessageStart())) {
+            return SendMessage(MSG_RAWBLOCK, raw, raw->data.data(), raw->data.size());
+        }
+    }
+
+    auto ss = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION | nSerializationFlags);
+    if (pblock) {
+        *ss << *pblock;
+    } else {
         CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
         {
             zmqError("Can't read block from disk");
             return false;
         }
 
-        ss << block;
+        *ss << block;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, ss, &(*ss->begin()), ss->size());
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -206,3 +289,90 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishMiningInfoNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& /*pblock*/)
+{
+    const PoCTipInfo info = GetPoCTipInfo(pindex, Params().GetConsensus().LVIP05Height);
+    LogPrint(BCLog::ZMQ, "zmq: Publish mininginfo %d %s\n", info.height, info.genSig.GetHex());
+    // height (LE32) | generation signature (32 bytes, same order as getmininginfo) | base target (LE64)
+    unsigned char data[4 + 32 + 8];
+    WriteLE32(data, info.height);
+    for (unsigned int i = 0; i < 32; i++)
+        data[4 + i] = info.genSig.begin()[i];
+    WriteLE64(data + 4 + 32, info.baseTarget);
+    return SendMessage(MSG_MININGINFO, data, sizeof(data));
+}
+
+/** Publish one firestone: kind (1) | txid (32, reversed) | n (LE32) | height (LE32) | lock height (LE32) | value (LE64) | key id (20) */
+static bool SendFirestone(CZMQAbstractPublishNotifier& notifier, unsigned char kind, int height, const CTicket& ticket)
+{
+    unsigned char data[1 + 32 + 4 + 4 + 4 + 8 + 20];
+    data[0] = kind;
+    for (unsigned int i = 0; i < 32; i++)
+        data[1 + i] = ticket.out.hash.begin()[31 - i];
+    WriteLE32(data + 33, ticket.out.n);
+    WriteLE32(data + 37, height);
+    WriteLE32(data + 41, ticket.LockTime());
+    WriteLE64(data + 45, ticket.nValue);
+    const CKeyID keyID = ticket.KeyID();
+    memcpy(data + 53, keyID.begin(), 20);
+    return notifier.SendMessage(MSG_FIRESTONE, data, sizeof(data));
+}
+
+bool CZMQPublishFirestoneNotifier::NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish firestone %d bought %u spent %u\n", pindex->nHeight, changes.boughtTickets.size(), changes.spentTickets.size());
+    for (const CTicketRef& ticket : changes.boughtTickets) {
+        if (!SendFirestone(*this, ZMQ_FIRESTONE_BOUGHT, pindex->nHeight, *ticket))
+            return false;
+    }
+    for (const CTicketRef& ticket : changes.spentTickets) {
+        if (!SendFirestone(*this, ZMQ_FIRESTONE_SPENT, pindex->nHeight, *ticket))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishBindingNotifier::NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish binding %d actions %u\n", pindex->nHeight, changes.actions.size());
+    // kind (1) | txid (32, reversed) | height (LE32) | from (20) | to (20, zero for an unbind)
+    for (const auto& action : changes.actions) {
+        unsigned char data[1 + 32 + 4 + 20 + 20];
+        data[0] = action.second.second.IsNull() ? ZMQ_BINDING_UNBIND : ZMQ_BINDING_BIND;
+        for (unsigned int i = 0; i < 32; i++)
+            data[1 + i] = action.first.begin()[31 - i];
+        WriteLE32(data + 33, pindex->nHeight);
+        memcpy(data + 37, action.second.first.begin(), 20);
+        memcpy(data + 57, action.second.second.begin(), 20);
+        if (!SendMessage(MSG_BINDING, data, sizeof(data)))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishSlotNotifier::NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes)
+{
+    if (!changes.fSlotOpened)
+        return true;
+    LogPrint(BCLog::ZMQ, "zmq: Publish slot %d at %d\n", changes.slotIndex, pindex->nHeight);
+    // slot index (LE32) | height (LE32) | firestone price (LE64)
+    unsigned char data[4 + 4 + 8];
+    WriteLE32(data, changes.slotIndex);
+    WriteLE32(data + 4, pindex->nHeight);
+    WriteLE64(data + 8, changes.ticketPrice);
+    return SendMessage(MSG_SLOT, data, sizeof(data));
+}
+
+bool CZMQPublishDeadlineNotifier::NotifyDeadline(const CPOCDeadline &deadline)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish deadline %d %llu\n", deadline.height, deadline.deadline);
+    // height (LE32) | key id (20) | nonce (LE64) | deadline (LE64) | time the block may be produced (LE64)
+    unsigned char data[4 + 20 + 8 + 8 + 8];
+    WriteLE32(data, deadline.height);
+    memcpy(data + 4, deadline.keyid.begin(), 20);
+    WriteLE64(data + 24, deadline.nonce);
+    WriteLE64(data + 32, deadline.deadline);
+    WriteLE64(data + 40, deadline.dl);
+    return SendMessage(MSG_DEADLINE, data, sizeof(data));
+}
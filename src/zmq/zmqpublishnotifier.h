@@ -24,6 +24,10 @@ public:
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
+    /* send the same message, the data without a copy: owner keeps it alive
+       until ZMQ is done sending it */
+    bool SendMessage(const char *command, const std::shared_ptr<const void>& owner, const void* data, size_t size);
+
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
 };
@@ -31,7 +35,7 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -43,7 +47,7 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +56,34 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishMiningInfoNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
+};
+
+class CZMQPublishFirestoneNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes) override;
+};
+
+class CZMQPublishBindingNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes) override;
+};
+
+class CZMQPublishSlotNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPoCBlock(const CBlockIndex *pindex, const CPoCBlockChanges &changes) override;
+};
+
+class CZMQPublishDeadlineNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyDeadline(const CPOCDeadline &deadline) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
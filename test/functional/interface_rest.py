@@ -264,6 +264,17 @@ class RESTTest (BitcoinTestFramework):
         assert_equal(resp.read().decode('utf-8').rstrip(), "Invalid height: -1")
         self.test_rest_request("/blockhashbyheight/", ret_type=RetType.OBJ, status=400)
 
+        # Check the block range, which ends at the tip
+        tip_height = block_json_obj['height']
+        prev_bytes = self.test_rest_request("/block/{}".format(block_json_obj['previousblockhash']), req_type=ReqType.BIN, ret_type=RetType.BYTES)
+        range_bytes = self.test_rest_request("/blocks/{}/5".format(tip_height - 1), req_type=ReqType.BIN, ret_type=RetType.BYTES)
+        assert_equal(range_bytes, prev_bytes + response_bytes)
+        range_hex = self.test_rest_request("/blocks/{}/1".format(tip_height), req_type=ReqType.HEX, ret_type=RetType.OBJ)
+        assert_equal(range_hex.read().strip(b'\n'), binascii.hexlify(response_bytes))
+        self.test_rest_request("/blocks/{}/1".format(tip_height + 1), req_type=ReqType.BIN, ret_type=RetType.OBJ, status=404)
+        self.test_rest_request("/blocks/0/0", req_type=ReqType.BIN, ret_type=RetType.OBJ, status=400)
+        self.test_rest_request("/blocks/0/1", ret_type=RetType.OBJ, status=404)
+
         # Compare with json block header
         json_obj = self.test_rest_request("/headers/1/{}".format(bb_hash))
         assert_equal(len(json_obj), 1)  # ensure that there is one header in the json response
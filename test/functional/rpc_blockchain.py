@@ -178,7 +178,7 @@ class BlockchainTest(BitcoinTestFramework):
 
     def _test_gettxoutsetinfo(self):
         node = self.nodes[0]
-        res = node.gettxoutsetinfo()
+        res = node.gettxoutsetinfo('hash_serialized_2')
 
         assert_equal(res['total_amount'], Decimal('8725.00000000'))
         assert_equal(res['transactions'], 200)
@@ -192,11 +192,18 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(len(res['bestblock']), 64)
         assert_equal(len(res['hash_serialized_2']), 64)
 
+        self.log.info("Test that the statistics kept block by block match those of a scan")
+        res_muhash = node.gettxoutsetinfo()
+        assert 'transactions' not in res_muhash
+        for key in ['height', 'bestblock', 'txouts', 'bogosize', 'muhash', 'total_amount', 'amounts', 'confidential_txouts']:
+            assert_equal(res_muhash[key], res[key])
+        assert_raises_rpc_error(-8, "foo is not a valid hash_type", node.gettxoutsetinfo, "foo")
+
         self.log.info("Test that gettxoutsetinfo() works for blockchain with just the genesis block")
         b1hash = node.getblockhash(1)
         node.invalidateblock(b1hash)
 
-        res2 = node.gettxoutsetinfo()
+        res2 = node.gettxoutsetinfo('hash_serialized_2')
         assert_equal(res2['transactions'], 0)
         assert_equal(res2['total_amount'], Decimal('0'))
         assert_equal(res2['height'], 0)
@@ -208,7 +215,8 @@ class BlockchainTest(BitcoinTestFramework):
         self.log.info("Test that gettxoutsetinfo() returns the same result after invalidate/reconsider block")
         node.reconsiderblock(b1hash)
 
-        res3 = node.gettxoutsetinfo()
+        res3 = node.gettxoutsetinfo('hash_serialized_2')
+        assert_equal(res3['muhash'], node.gettxoutsetinfo()['muhash'])
         # The field 'disk_size' is non-deterministic and can thus not be
         # compared between res and res3.  Everything else should be the same.
         del res['disk_size'], res3['disk_size']
@@ -3,11 +3,12 @@
 # Distributed under the MIT software license, see the accompanying
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
 """Test bitcoin-wallet."""
+import os
 import subprocess
 import textwrap
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal
+from test_framework.util import assert_equal, assert_greater_than
 
 class ToolWalletTest(BitcoinTestFramework):
     def set_test_params(self):
@@ -63,6 +64,7 @@ class ToolWalletTest(BitcoinTestFramework):
         # mutate the wallet to check the info command output changes accordingly
         self.start_node(0)
         self.nodes[0].generate(1)
+        best_block = self.nodes[0].getbestblockhash()
         self.stop_node(0)
 
         out = textwrap.dedent('''\
@@ -76,6 +78,10 @@ class ToolWalletTest(BitcoinTestFramework):
         ''')
         self.assert_tool_output(out, '-wallet=wallet.dat', 'info')
 
+        self.test_dump()
+        self.test_compact()
+        self.test_rebuild_utxo(best_block)
+
         out = textwrap.dedent('''\
             Topping up keypool...
             Wallet info
@@ -97,5 +103,40 @@ class ToolWalletTest(BitcoinTestFramework):
         assert_equal(1000, out['keypoolsize_hd_internal'])
         assert_equal(True, 'hdseedid' in out)
 
+    def test_dump(self):
+        dump_path = os.path.join(self.options.tmpdir, 'wallet.dump')
+        self.assert_raises_tool_error('Error: the dump command requires -dumpfile', '-wallet=wallet.dat', 'dump')
+        p = self.bitcoin_wallet_process('-wallet=wallet.dat', '-dumpfile={}'.format(dump_path), 'dump')
+        stdout, stderr = p.communicate()
+        assert_equal(p.poll(), 0)
+        assert_equal(stderr, '')
+        with open(dump_path, 'r', encoding='utf8') as f:
+            lines = f.read().splitlines()
+        assert_equal(lines[0], 'LAVA_WALLET_DUMP,1')
+        assert lines[-1].startswith('checksum,')
+        assert_equal(stdout, 'Dumped {} records to {}\n'.format(len(lines) - 2, dump_path))
+        self.assert_raises_tool_error('Error: dump file {} exists already'.format(dump_path), '-wallet=wallet.dat', '-dumpfile={}'.format(dump_path), 'dump')
+
+    def test_compact(self):
+        p = self.bitcoin_wallet_process('-wallet=wallet.dat', 'compact')
+        stdout, stderr = p.communicate()
+        assert_equal(p.poll(), 0)
+        assert_equal(stderr, '')
+        assert stdout.startswith('Compacted ')
+        # The wallet still loads after its rewrite
+        p = self.bitcoin_wallet_process('-wallet=wallet.dat', 'info')
+        stdout, stderr = p.communicate()
+        assert_equal(p.poll(), 0)
+        assert 'Transactions: 1\n' in stdout
+
+    def test_rebuild_utxo(self, best_block):
+        p = self.bitcoin_wallet_process('-wallet=wallet.dat', 'rebuild-utxo')
+        stdout, stderr = p.communicate()
+        assert_equal(p.poll(), 0)
+        assert_equal(stderr, '')
+        lines = stdout.splitlines()
+        assert_equal(lines[0], 'Chainstate at block {}'.format(best_block))
+        assert_greater_than(len([line for line in lines if line.startswith('Balance ')]), 0)
+
 if __name__ == '__main__':
     ToolWalletTest().main()
@@ -103,8 +103,30 @@ class ListTransactionsTest(BitcoinTestFramework):
                             {"category": "receive", "amount": Decimal("0.1")},
                             {"txid": txid, "label": "watchonly"})
 
+        self.run_cursor_test()
         self.run_rbf_opt_in_test()
 
+    # Check that the pages of a cursor list the same entries as a single call.
+    def run_cursor_test(self):
+        node = self.nodes[0]
+        expected = node.listtransactions(count=1000)
+        listed = []
+        cursor = ""
+        while cursor is not None:
+            page = node.listtransactions(count=2, cursor=cursor)
+            listed = page["transactions"] + listed
+            cursor = page["cursor"]
+        assert_equal(listed, expected)
+
+        expected = node.listunspent()
+        listed = []
+        cursor = ""
+        while cursor is not None:
+            page = node.listunspent(query_options={"maximumCount": 3, "cursor": cursor})
+            listed += page["unspents"]
+            cursor = page["cursor"]
+        assert_equal(sorted(listed, key=lambda u: (u["txid"], u["vout"])), sorted(expected, key=lambda u: (u["txid"], u["vout"])))
+
     # Check that the opt-in-rbf flag works properly, for sent and received
     # transactions.
     def run_rbf_opt_in_test(self):